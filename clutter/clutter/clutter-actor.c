@@ -1500,6 +1500,20 @@ queue_update_stage_views (ClutterActor *actor)
 
 static void queue_update_paint_volume (ClutterActor *actor);
 
+/* The stage retains what it picked until something that can change the
+ * outcome of a pick happens: a change of transformation, allocation, clip,
+ * visibility, reactivity or effects of an actor.
+ */
+static void
+invalidate_stage_pick (ClutterActor *self)
+{
+  ClutterActor *stage;
+
+  stage = _clutter_actor_get_stage_internal (self);
+  if (stage)
+    clutter_stage_invalidate_pick (CLUTTER_STAGE (stage));
+}
+
 static void
 queue_update_paint_volume_on_clones (ClutterActor *self)
 {
@@ -1540,6 +1554,8 @@ clutter_actor_real_map (ClutterActor *self)
 
   CLUTTER_ACTOR_SET_FLAGS (self, CLUTTER_ACTOR_MAPPED);
 
+  invalidate_stage_pick (self);
+
   if (priv->unmapped_paint_branch_counter == 0)
     {
       /* We skip unmapped actors when updating the stage-views list, so if
@@ -1679,6 +1695,8 @@ clutter_actor_real_unmap (ClutterActor *self)
 
   CLUTTER_ACTOR_UNSET_FLAGS (self, CLUTTER_ACTOR_MAPPED);
 
+  invalidate_stage_pick (self);
+
   if (priv->unmapped_paint_branch_counter == 0)
     {
       /* clear the contents of the last paint volume, so that hiding + moving +
@@ -2515,6 +2533,8 @@ transform_changed (ClutterActor *actor)
 {
   actor->priv->transform_valid = FALSE;
 
+  invalidate_stage_pick (actor);
+
   if (actor->priv->parent)
     queue_update_paint_volume (actor->priv->parent);
 
@@ -11154,6 +11174,7 @@ clutter_actor_set_clip (ClutterActor *self,
   priv->has_clip = TRUE;
 
   queue_update_paint_volume (self);
+  invalidate_stage_pick (self);
   clutter_actor_queue_redraw (self);
 
   g_object_notify_by_pspec (obj, obj_props[PROP_CLIP_RECT]);
@@ -11177,6 +11198,7 @@ clutter_actor_remove_clip (ClutterActor *self)
   self->priv->has_clip = FALSE;
 
   queue_update_paint_volume (self);
+  invalidate_stage_pick (self);
   clutter_actor_queue_redraw (self);
 
   g_object_notify_by_pspec (G_OBJECT (self), obj_props[PROP_HAS_CLIP]);
@@ -12448,6 +12470,7 @@ clutter_actor_set_reactive (ClutterActor *actor,
                             gboolean      reactive)
 {
   ClutterActorPrivate *priv;
+  ClutterActor *stage;
 
   g_return_if_fail (CLUTTER_IS_ACTOR (actor));
 
@@ -12463,12 +12486,12 @@ clutter_actor_set_reactive (ClutterActor *actor,
 
   g_object_notify_by_pspec (G_OBJECT (actor), obj_props[PROP_REACTIVE]);
 
-  if (!CLUTTER_ACTOR_IS_REACTIVE (actor) && priv->has_pointer)
-    {
-      ClutterActor *stage = _clutter_actor_get_stage_internal (actor);
+  stage = _clutter_actor_get_stage_internal (actor);
+  if (stage)
+    clutter_stage_invalidate_pick (CLUTTER_STAGE (stage));
 
-      clutter_stage_invalidate_focus (CLUTTER_STAGE (stage), actor);
-    }
+  if (!CLUTTER_ACTOR_IS_REACTIVE (actor) && priv->has_pointer)
+    clutter_stage_invalidate_focus (CLUTTER_STAGE (stage), actor);
 }
 
 /**
@@ -15249,6 +15272,7 @@ clutter_actor_set_clip_to_allocation (ClutterActor *self,
       priv->clip_to_allocation = clip_set;
 
       queue_update_paint_volume (self);
+      invalidate_stage_pick (self);
       clutter_actor_queue_redraw (self);
 
       g_object_notify_by_pspec (G_OBJECT (self), obj_props[PROP_CLIP_TO_ALLOCATION]);
@@ -15296,6 +15320,7 @@ clutter_actor_add_effect (ClutterActor  *self,
 
   _clutter_actor_add_effect_internal (self, effect);
 
+  invalidate_stage_pick (self);
   clutter_actor_queue_redraw (self);
 
   g_object_notify_by_pspec (G_OBJECT (self), obj_props[PROP_EFFECT]);
@@ -15352,6 +15377,7 @@ clutter_actor_remove_effect (ClutterActor  *self,
 
   _clutter_actor_remove_effect_internal (self, effect);
 
+  invalidate_stage_pick (self);
   clutter_actor_queue_redraw (self);
 
   g_object_notify_by_pspec (G_OBJECT (self), obj_props[PROP_EFFECT]);
@@ -15462,6 +15488,7 @@ clutter_actor_clear_effects (ClutterActor *self)
 
   _clutter_meta_group_clear_metas_no_internal (self->priv->effects);
 
+  invalidate_stage_pick (self);
   clutter_actor_queue_redraw (self);
 }
 
@@ -22,19 +22,49 @@
 
 #include <cogl/cogl.h>
 
+#include "clutter-macros.h"
+
 G_BEGIN_DECLS
 
 typedef struct _ClutterBlur ClutterBlur;
 
+typedef enum _ClutterBlurMode
+{
+  CLUTTER_BLUR_MODE_GAUSSIAN,
+  CLUTTER_BLUR_MODE_DUAL_KAWASE,
+} ClutterBlurMode;
+
+CLUTTER_EXPORT
 ClutterBlur * clutter_blur_new (CoglTexture *texture,
                                 float        sigma);
 
+CLUTTER_EXPORT
+ClutterBlur * clutter_blur_new_full (CoglTexture     *texture,
+                                     float            sigma,
+                                     ClutterBlurMode  mode);
+
+CLUTTER_EXPORT
 void clutter_blur_apply (ClutterBlur *blur);
 
+CLUTTER_EXPORT
 CoglTexture * clutter_blur_get_texture (ClutterBlur *blur);
 
+CLUTTER_EXPORT
 void clutter_blur_free (ClutterBlur *blur);
 
+CLUTTER_EXPORT
+int clutter_blur_calculate_dual_kawase_levels (float  sigma,
+                                               int    width,
+                                               int    height,
+                                               float *offset);
+
+CLUTTER_EXPORT
+float clutter_blur_get_dual_kawase_sigma (int   n_levels,
+                                          float offset);
+
+CoglPipeline * clutter_blur_create_prewarm_pipeline (CoglContext *cogl_context,
+                                                     const char  *variant);
+
 G_END_DECLS
 
 #endif /* CLUTTER_BLUR_PRIVATE_H */
@@ -17,13 +17,19 @@
 
 #include "clutter-blur-private.h"
 
+#include <math.h>
+
 #include "clutter-backend.h"
+#include "clutter-debug.h"
+#include "clutter-pipeline-prewarm.h"
 
 /**
  * SECTION:clutter-blur
  * @short_description: Blur textures
  *
- * #ClutterBlur is a moderately fast gaussian blur implementation.
+ * #ClutterBlur is a moderately fast gaussian blur implementation. It can
+ * alternatively approximate a gaussian blur using a dual Kawase filter, which
+ * is considerably cheaper at large radii.
  *
  * # Optimizations
  *
@@ -64,6 +70,21 @@
  *
  * https://developer.nvidia.com/gpugems/GPUGems3/gpugems3_ch40.html
  *
+ * ## Dual Kawase filter
+ *
+ * With %CLUTTER_BLUR_MODE_DUAL_KAWASE, the texture is repeatedly downsampled
+ * by a factor of 2 using a 5-tap filter, and then upsampled back to its
+ * original size using an 8-tap filter, as described by Marius Bjørge in
+ * "Bandwidth-Efficient Rendering" (SIGGRAPH 2015). The number of levels and
+ * the sampling offset are derived from the blur sigma, see
+ * clutter_blur_calculate_dual_kawase_levels().
+ *
+ * ## Framebuffer pool
+ *
+ * Intermediate framebuffers are taken from the #CoglOffscreenPool of the
+ * context, so that blurs created every frame don't need to allocate new
+ * textures.
+ *
  */
 
 static const char *gaussian_blur_glsl_declarations =
@@ -105,15 +126,66 @@ static const char *gaussian_blur_glsl =
 "                                                                          \n"
 "  cogl_texel = ret / gauss_coefficient_total;                             \n";
 
+static const char *dual_kawase_glsl_declarations =
+"uniform vec2 pixel_offset;                                                \n";
+
+static const char *dual_kawase_down_glsl =
+"  vec2 uv = vec2 (cogl_tex_coord.st);                                     \n"
+"  vec2 diagonal = vec2 (pixel_offset.x, -pixel_offset.y);                 \n"
+"                                                                          \n"
+"  vec4 ret = texture2D (cogl_sampler, uv) * 4.0;                          \n"
+"  ret += texture2D (cogl_sampler, uv - pixel_offset);                     \n"
+"  ret += texture2D (cogl_sampler, uv + pixel_offset);                     \n"
+"  ret += texture2D (cogl_sampler, uv - diagonal);                         \n"
+"  ret += texture2D (cogl_sampler, uv + diagonal);                         \n"
+"                                                                          \n"
+"  cogl_texel = ret / 8.0;                                                 \n";
+
+static const char *dual_kawase_up_glsl =
+"  vec2 uv = vec2 (cogl_tex_coord.st);                                     \n"
+"  vec2 dx = vec2 (pixel_offset.x, 0.0);                                   \n"
+"  vec2 dy = vec2 (0.0, pixel_offset.y);                                   \n"
+"                                                                          \n"
+"  vec4 ret = texture2D (cogl_sampler, uv - 2.0 * dx);                     \n"
+"  ret += texture2D (cogl_sampler, uv + 2.0 * dx);                         \n"
+"  ret += texture2D (cogl_sampler, uv - 2.0 * dy);                         \n"
+"  ret += texture2D (cogl_sampler, uv + 2.0 * dy);                         \n"
+"  ret += texture2D (cogl_sampler, uv - dx + dy) * 2.0;                    \n"
+"  ret += texture2D (cogl_sampler, uv + dx + dy) * 2.0;                    \n"
+"  ret += texture2D (cogl_sampler, uv - dx - dy) * 2.0;                    \n"
+"  ret += texture2D (cogl_sampler, uv + dx - dy) * 2.0;                    \n"
+"                                                                          \n"
+"  cogl_texel = ret / 12.0;                                                \n";
+
+
 #define MIN_DOWNSCALE_SIZE 256.f
 #define MAX_SIGMA 6.f
 
+#define DUAL_KAWASE_MAX_LEVELS 6
+#define DUAL_KAWASE_MAX_OFFSET 2.5f
+#define DUAL_KAWASE_MIN_LEVEL_SIZE 8
+
 enum
 {
   VERTICAL,
   HORIZONTAL,
 };
 
+typedef enum
+{
+  BLUR_SHADER_GAUSSIAN,
+  BLUR_SHADER_DUAL_KAWASE_DOWN,
+  BLUR_SHADER_DUAL_KAWASE_UP,
+
+  N_BLUR_SHADERS
+} BlurShader;
+
+static const char *blur_shader_variants[N_BLUR_SHADERS] = {
+  [BLUR_SHADER_GAUSSIAN] = "gaussian",
+  [BLUR_SHADER_DUAL_KAWASE_DOWN] = "dual-kawase-down",
+  [BLUR_SHADER_DUAL_KAWASE_UP] = "dual-kawase-up",
+};
+
 typedef struct
 {
   CoglFramebuffer *framebuffer;
@@ -126,26 +198,58 @@ struct _ClutterBlur
 {
   CoglTexture *source_texture;
   float sigma;
+
+  /* CLUTTER_BLUR_MODE_GAUSSIAN */
   float downscale_factor;
 
-  BlurPass pass[2];
+  /* CLUTTER_BLUR_MODE_DUAL_KAWASE */
+  int n_levels;
+  float offset;
+
+  BlurPass *passes;
+  int n_passes;
 };
 
 static CoglPipeline*
-create_blur_pipeline (void)
+create_blur_pipeline (CoglContext *ctx,
+                      BlurShader   shader)
 {
-  static CoglPipelineKey blur_pipeline_key = "clutter-blur-pipeline-private";
-  CoglContext *ctx =
-    clutter_backend_get_cogl_context (clutter_get_default_backend ());
+  static CoglPipelineKey blur_pipeline_keys[N_BLUR_SHADERS] = {
+    [BLUR_SHADER_GAUSSIAN] = "clutter-blur-pipeline-private",
+    [BLUR_SHADER_DUAL_KAWASE_DOWN] =
+      "clutter-blur-dual-kawase-down-pipeline-private",
+    [BLUR_SHADER_DUAL_KAWASE_UP] =
+      "clutter-blur-dual-kawase-up-pipeline-private",
+  };
   CoglPipeline *blur_pipeline;
 
   blur_pipeline =
-    cogl_context_get_named_pipeline (ctx, &blur_pipeline_key);
+    cogl_context_get_named_pipeline (ctx, &blur_pipeline_keys[shader]);
 
   if (G_UNLIKELY (blur_pipeline == NULL))
     {
+      const char *declarations = NULL;
+      const char *code = NULL;
       CoglSnippet *snippet;
 
+      switch (shader)
+        {
+        case BLUR_SHADER_GAUSSIAN:
+          declarations = gaussian_blur_glsl_declarations;
+          code = gaussian_blur_glsl;
+          break;
+        case BLUR_SHADER_DUAL_KAWASE_DOWN:
+          declarations = dual_kawase_glsl_declarations;
+          code = dual_kawase_down_glsl;
+          break;
+        case BLUR_SHADER_DUAL_KAWASE_UP:
+          declarations = dual_kawase_glsl_declarations;
+          code = dual_kawase_up_glsl;
+          break;
+        case N_BLUR_SHADERS:
+          g_assert_not_reached ();
+        }
+
       blur_pipeline = cogl_pipeline_new (ctx);
       cogl_pipeline_set_layer_null_texture (blur_pipeline, 0);
       cogl_pipeline_set_layer_filters (blur_pipeline,
@@ -157,18 +261,69 @@ create_blur_pipeline (void)
                                          COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
 
       snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
-                                  gaussian_blur_glsl_declarations,
+                                  declarations,
                                   NULL);
-      cogl_snippet_set_replace (snippet, gaussian_blur_glsl);
+      cogl_snippet_set_replace (snippet, code);
       cogl_pipeline_add_layer_snippet (blur_pipeline, 0, snippet);
       cogl_object_unref (snippet);
 
-      cogl_context_set_named_pipeline (ctx, &blur_pipeline_key, blur_pipeline);
+      cogl_context_set_named_pipeline (ctx,
+                                       &blur_pipeline_keys[shader],
+                                       blur_pipeline);
+
+      clutter_pipeline_prewarm_record_default ("clutter-blur",
+                                               blur_shader_variants[shader]);
     }
 
   return cogl_pipeline_copy (blur_pipeline);
 }
 
+CoglPipeline *
+clutter_blur_create_prewarm_pipeline (CoglContext *cogl_context,
+                                      const char  *variant)
+{
+  BlurShader shader;
+
+  for (shader = 0; shader < N_BLUR_SHADERS; shader++)
+    {
+      if (g_str_equal (variant, blur_shader_variants[shader]))
+        return create_blur_pipeline (cogl_context, shader);
+    }
+
+  return NULL;
+}
+
+static CoglFramebuffer *
+acquire_framebuffer (CoglContext *ctx,
+                     int          width,
+                     int          height)
+{
+  CoglOffscreenPool *pool = cogl_context_get_offscreen_pool (ctx);
+  g_autoptr (GError) error = NULL;
+  CoglOffscreen *offscreen;
+
+  offscreen = cogl_offscreen_pool_acquire (pool, width, height,
+                                           COGL_TEXTURE_COMPONENTS_RGBA,
+                                           &error);
+  if (!offscreen)
+    {
+      g_warning ("%s: Unable to create an Offscreen buffer: %s",
+                 G_STRLOC, error->message);
+      return NULL;
+    }
+
+  return COGL_FRAMEBUFFER (offscreen);
+}
+
+static void
+release_framebuffer (CoglFramebuffer *framebuffer)
+{
+  CoglContext *ctx = cogl_framebuffer_get_context (framebuffer);
+
+  cogl_offscreen_pool_release (cogl_context_get_offscreen_pool (ctx),
+                               COGL_OFFSCREEN (framebuffer));
+}
+
 static void
 update_blur_uniforms (ClutterBlur *blur,
                       BlurPass    *pass)
@@ -219,61 +374,48 @@ update_blur_uniforms (ClutterBlur *blur,
     }
 }
 
-static gboolean
-create_fbo (ClutterBlur *blur,
-            BlurPass    *pass)
+static void
+update_dual_kawase_uniforms (ClutterBlur *blur,
+                             BlurPass    *pass)
 {
-  CoglContext *ctx =
-    clutter_backend_get_cogl_context (clutter_get_default_backend ());
-  float scaled_height;
-  float scaled_width;
-  float height;
-  float width;
-
-  g_clear_pointer (&pass->texture, cogl_object_unref);
-  g_clear_object (&pass->framebuffer);
-
-  width = cogl_texture_get_width (blur->source_texture);
-  height = cogl_texture_get_height (blur->source_texture);
-  scaled_width = floorf (width / blur->downscale_factor);
-  scaled_height = floorf (height / blur->downscale_factor);
-
-  pass->texture = COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx,
-                                                               scaled_width,
-                                                               scaled_height));
-  if (!pass->texture)
-    return FALSE;
+  int pixel_offset_uniform;
 
-  pass->framebuffer =
-    COGL_FRAMEBUFFER (cogl_offscreen_new_with_texture (pass->texture));
-  if (!pass->framebuffer)
+  pixel_offset_uniform =
+    cogl_pipeline_get_uniform_location (pass->pipeline, "pixel_offset");
+  if (pixel_offset_uniform > -1)
     {
-      g_warning ("%s: Unable to create an Offscreen buffer", G_STRLOC);
-      return FALSE;
-    }
+      float pixel_offset[2] = {
+        0.5f * blur->offset / cogl_texture_get_width (pass->texture),
+        0.5f * blur->offset / cogl_texture_get_height (pass->texture),
+      };
 
-  cogl_framebuffer_orthographic (pass->framebuffer,
-                                 0.0, 0.0,
-                                 scaled_width,
-                                 scaled_height,
-                                 0.0, 1.0);
-  return TRUE;
+      cogl_pipeline_set_uniform_float (pass->pipeline,
+                                       pixel_offset_uniform,
+                                       2, 1,
+                                       pixel_offset);
+    }
 }
 
 static gboolean
-setup_blur_pass (ClutterBlur *blur,
-                 BlurPass    *pass,
-                 int          orientation,
-                 CoglTexture *texture)
+setup_blur_pass (BlurPass    *pass,
+                 BlurShader   shader,
+                 CoglTexture *texture,
+                 int          width,
+                 int          height)
 {
-  pass->orientation = orientation;
-  pass->pipeline = create_blur_pipeline ();
+  CoglContext *ctx =
+    clutter_backend_get_cogl_context (clutter_get_default_backend ());
+  CoglOffscreen *offscreen;
+
+  pass->pipeline = create_blur_pipeline (ctx, shader);
   cogl_pipeline_set_layer_texture (pass->pipeline, 0, texture);
 
-  if (!create_fbo (blur, pass))
+  pass->framebuffer = acquire_framebuffer (ctx, width, height);
+  if (!pass->framebuffer)
     return FALSE;
 
-  update_blur_uniforms (blur, pass);
+  offscreen = COGL_OFFSCREEN (pass->framebuffer);
+  pass->texture = cogl_object_ref (cogl_offscreen_get_texture (offscreen));
   return TRUE;
 }
 
@@ -305,6 +447,96 @@ calculate_downscale_factor (float width,
   return downscale_factor;
 }
 
+static gboolean
+setup_gaussian_passes (ClutterBlur *blur)
+{
+  BlurPass *hpass;
+  BlurPass *vpass;
+  float width;
+  float height;
+  int scaled_width;
+  int scaled_height;
+
+  width = cogl_texture_get_width (blur->source_texture);
+  height = cogl_texture_get_height (blur->source_texture);
+  blur->downscale_factor = calculate_downscale_factor (width,
+                                                       height,
+                                                       blur->sigma);
+
+  scaled_width = floorf (width / blur->downscale_factor);
+  scaled_height = floorf (height / blur->downscale_factor);
+
+  blur->n_passes = 2;
+  blur->passes = g_new0 (BlurPass, blur->n_passes);
+
+  vpass = &blur->passes[VERTICAL];
+  vpass->orientation = VERTICAL;
+  if (!setup_blur_pass (vpass, BLUR_SHADER_GAUSSIAN, blur->source_texture,
+                        scaled_width, scaled_height))
+    return FALSE;
+
+  update_blur_uniforms (blur, vpass);
+
+  hpass = &blur->passes[HORIZONTAL];
+  hpass->orientation = HORIZONTAL;
+  if (!setup_blur_pass (hpass, BLUR_SHADER_GAUSSIAN, vpass->texture,
+                        scaled_width, scaled_height))
+    return FALSE;
+
+  update_blur_uniforms (blur, hpass);
+  return TRUE;
+}
+
+static int
+get_level_size (int size,
+                int level)
+{
+  return MAX (size >> level, 1);
+}
+
+static gboolean
+setup_dual_kawase_passes (ClutterBlur *blur)
+{
+  CoglTexture *texture = blur->source_texture;
+  int width;
+  int height;
+  int i;
+
+  width = cogl_texture_get_width (blur->source_texture);
+  height = cogl_texture_get_height (blur->source_texture);
+
+  blur->n_passes = 2 * blur->n_levels;
+  blur->passes = g_new0 (BlurPass, blur->n_passes);
+
+  /* Downsample into levels 1 to n_levels, then upsample back into levels
+   * n_levels - 1 to 0. The upsampling passes can't draw into the framebuffers
+   * of the downsampling ones, as clearing them would discard the rendering
+   * the next level still has to sample from.
+   */
+  for (i = 0; i < blur->n_passes; i++)
+    {
+      BlurPass *pass = &blur->passes[i];
+      gboolean downsample = i < blur->n_levels;
+      int level = downsample ? i + 1 : blur->n_passes - i - 1;
+      BlurShader shader;
+
+      if (downsample)
+        shader = BLUR_SHADER_DUAL_KAWASE_DOWN;
+      else
+        shader = BLUR_SHADER_DUAL_KAWASE_UP;
+
+      if (!setup_blur_pass (pass, shader, texture,
+                            get_level_size (width, level),
+                            get_level_size (height, level)))
+        return FALSE;
+
+      update_dual_kawase_uniforms (blur, pass);
+      texture = pass->texture;
+    }
+
+  return TRUE;
+}
+
 static void
 apply_blur_pass (BlurPass *pass)
 {
@@ -328,27 +560,111 @@ clear_blur_pass (BlurPass *pass)
 {
   g_clear_pointer (&pass->pipeline, cogl_object_unref);
   g_clear_pointer (&pass->texture, cogl_object_unref);
-  g_clear_object (&pass->framebuffer);
+  g_clear_pointer (&pass->framebuffer, release_framebuffer);
 }
 
 /**
- * clutter_blur_new:
+ * clutter_blur_get_dual_kawase_sigma:
+ * @n_levels: number of downsampled levels
+ * @offset: the sampling offset
+ *
+ * Estimates the sigma of the gaussian blur approximated by a dual Kawase
+ * filter going down @n_levels levels with a sampling offset of @offset. Each
+ * level is treated as a gaussian blur with a radius of @offset times half a
+ * texel of that level, and the variances of all levels add up.
+ *
+ * Returns: the approximated sigma, in pixels of the source texture
+ */
+float
+clutter_blur_get_dual_kawase_sigma (int   n_levels,
+                                    float offset)
+{
+  float variance = 0.f;
+  int i;
+
+  for (i = 1; i <= n_levels; i++)
+    {
+      float radius = offset * (1 << i) * 0.5f;
+
+      variance += radius * radius;
+    }
+
+  return sqrtf (variance);
+}
+
+/**
+ * clutter_blur_calculate_dual_kawase_levels:
+ * @sigma: blur sigma
+ * @width: width of the texture to blur
+ * @height: height of the texture to blur
+ * @offset: (out): return location for the sampling offset
+ *
+ * Maps @sigma to the parameters of a dual Kawase filter. The least number of
+ * levels that can reach @sigma without exceeding the maximum sampling offset
+ * is used, as long as the smallest level of a @width by @height texture
+ * doesn't get too small; the offset is then chosen to match @sigma, or
+ * clamped to the maximum if @sigma can't be reached.
+ *
+ * Returns: the number of levels, or 0 if @sigma is 0 or the texture is too
+ *   small to be downsampled
+ */
+int
+clutter_blur_calculate_dual_kawase_levels (float  sigma,
+                                           int    width,
+                                           int    height,
+                                           float *offset)
+{
+  int max_levels = 0;
+  int n_levels;
+
+  g_return_val_if_fail (offset != NULL, 0);
+
+  *offset = 0.f;
+
+  if (G_APPROX_VALUE (sigma, 0.0, FLT_EPSILON))
+    return 0;
+
+  while (max_levels < DUAL_KAWASE_MAX_LEVELS &&
+         MIN (width, height) >> (max_levels + 1) >= DUAL_KAWASE_MIN_LEVEL_SIZE)
+    max_levels++;
+
+  if (max_levels == 0)
+    return 0;
+
+  for (n_levels = 1; n_levels < max_levels; n_levels++)
+    {
+      float max_sigma =
+        clutter_blur_get_dual_kawase_sigma (n_levels, DUAL_KAWASE_MAX_OFFSET);
+
+      if (sigma <= max_sigma)
+        break;
+    }
+
+  *offset = MIN (sigma / clutter_blur_get_dual_kawase_sigma (n_levels, 1.f),
+                 DUAL_KAWASE_MAX_OFFSET);
+  return n_levels;
+}
+
+/**
+ * clutter_blur_new_full:
  * @texture: a #CoglTexture
  * @sigma: blur sigma
+ * @mode: the #ClutterBlurMode
  *
- * Creates a new #ClutterBlur.
+ * Creates a new #ClutterBlur using @mode. If @texture is too small to be
+ * blurred using a dual Kawase filter, a gaussian blur is used instead.
  *
  * Returns: (transfer full) (nullable): A newly created #ClutterBlur
  */
 ClutterBlur *
-clutter_blur_new (CoglTexture *texture,
-                  float        sigma)
+clutter_blur_new_full (CoglTexture     *texture,
+                       float            sigma,
+                       ClutterBlurMode  mode)
 {
   ClutterBlur *blur;
   unsigned int height;
   unsigned int width;
-  BlurPass *hpass;
-  BlurPass *vpass;
+  gboolean success = FALSE;
 
   g_return_val_if_fail (texture != NULL, NULL);
   g_return_val_if_fail (sigma >= 0.0, NULL);
@@ -359,16 +675,31 @@ clutter_blur_new (CoglTexture *texture,
   blur = g_new0 (ClutterBlur, 1);
   blur->sigma = sigma;
   blur->source_texture = cogl_object_ref (texture);
-  blur->downscale_factor = calculate_downscale_factor (width, height, sigma);
 
   if (G_APPROX_VALUE (sigma, 0.0, FLT_EPSILON))
     goto out;
 
-  vpass = &blur->pass[VERTICAL];
-  hpass = &blur->pass[HORIZONTAL];
+  if (mode == CLUTTER_BLUR_MODE_DUAL_KAWASE)
+    {
+      blur->n_levels = clutter_blur_calculate_dual_kawase_levels (sigma,
+                                                                  width,
+                                                                  height,
+                                                                  &blur->offset);
+      if (blur->n_levels == 0)
+        mode = CLUTTER_BLUR_MODE_GAUSSIAN;
+    }
 
-  if (!setup_blur_pass (blur, vpass, VERTICAL, texture) ||
-      !setup_blur_pass (blur, hpass, HORIZONTAL, vpass->texture))
+  switch (mode)
+    {
+    case CLUTTER_BLUR_MODE_GAUSSIAN:
+      success = setup_gaussian_passes (blur);
+      break;
+    case CLUTTER_BLUR_MODE_DUAL_KAWASE:
+      success = setup_dual_kawase_passes (blur);
+      break;
+    }
+
+  if (!success)
     {
       clutter_blur_free (blur);
       return NULL;
@@ -378,6 +709,30 @@ out:
   return g_steal_pointer (&blur);
 }
 
+/**
+ * clutter_blur_new:
+ * @texture: a #CoglTexture
+ * @sigma: blur sigma
+ *
+ * Creates a new #ClutterBlur. A gaussian blur is used, unless the
+ * `dual-kawase-blur` paint debug flag is set.
+ *
+ * Returns: (transfer full) (nullable): A newly created #ClutterBlur
+ */
+ClutterBlur *
+clutter_blur_new (CoglTexture *texture,
+                  float        sigma)
+{
+  ClutterBlurMode mode;
+
+  if (G_UNLIKELY (clutter_paint_debug_flags & CLUTTER_DEBUG_DUAL_KAWASE_BLUR))
+    mode = CLUTTER_BLUR_MODE_DUAL_KAWASE;
+  else
+    mode = CLUTTER_BLUR_MODE_GAUSSIAN;
+
+  return clutter_blur_new_full (texture, sigma, mode);
+}
+
 /**
  * clutter_blur_apply:
  * @blur: a #ClutterBlur
@@ -388,11 +743,10 @@ out:
 void
 clutter_blur_apply (ClutterBlur *blur)
 {
-  if (G_APPROX_VALUE (blur->sigma, 0.0, FLT_EPSILON))
-    return;
+  int i;
 
-  apply_blur_pass (&blur->pass[VERTICAL]);
-  apply_blur_pass (&blur->pass[HORIZONTAL]);
+  for (i = 0; i < blur->n_passes; i++)
+    apply_blur_pass (&blur->passes[i]);
 }
 
 /**
@@ -407,25 +761,29 @@ clutter_blur_apply (ClutterBlur *blur)
 CoglTexture *
 clutter_blur_get_texture (ClutterBlur *blur)
 {
-  if (G_APPROX_VALUE (blur->sigma, 0.0, FLT_EPSILON))
+  if (blur->n_passes == 0)
     return blur->source_texture;
   else
-    return blur->pass[HORIZONTAL].texture;
+    return blur->passes[blur->n_passes - 1].texture;
 }
 
 /**
  * clutter_blur_free:
  * @blur: A #ClutterBlur
  *
- * Frees @blur.
+ * Frees @blur. Its intermediate framebuffers are given back to the offscreen
+ * pool.
  */
 void
 clutter_blur_free (ClutterBlur *blur)
 {
+  int i;
+
   g_assert (blur);
 
-  clear_blur_pass (&blur->pass[VERTICAL]);
-  clear_blur_pass (&blur->pass[HORIZONTAL]);
+  for (i = 0; i < blur->n_passes; i++)
+    clear_blur_pass (&blur->passes[i]);
+  g_free (blur->passes);
   cogl_clear_object (&blur->source_texture);
   g_free (blur);
 }
@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ClutterDamageTiles finds which tiles of a damaged region actually changed
+ * between two CPU accessible buffers of the same layout, e.g. the two
+ * shadow framebuffers of a double buffered shadow framebuffer setup.
+ *
+ * Tiles are compared one pixel row at a time, walking each tile row of the
+ * buffer linearly, using SSE2 or AVX2 when available. Large comparisons are
+ * split into bands of tile rows that are processed in parallel.
+ */
+
+#include "clutter-build-config.h"
+
+#include "clutter-damage-tiles.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "clutter-parallel-private.h"
+#include "clutter-private.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_INTRINSICS 1
+#include <immintrin.h>
+#endif
+
+#define MIN_BYTES_PER_JOB (1024 * 1024)
+
+typedef enum _TileState
+{
+  TILE_STATE_SKIP = 0,
+  TILE_STATE_CANDIDATE,
+  TILE_STATE_DIRTY,
+} TileState;
+
+typedef gboolean (* SpanDiffersFunc) (const uint8_t *a,
+                                      const uint8_t *b,
+                                      size_t         length);
+
+typedef struct _TileJob
+{
+  ClutterDamageTiles *damage_tiles;
+
+  const uint8_t *current_data;
+  const uint8_t *prev_data;
+  int width;
+  int height;
+  int stride;
+  int bpp;
+  int n_columns;
+
+  int first_row;
+  int last_row;
+} TileJob;
+
+struct _ClutterDamageTiles
+{
+  int tile_size;
+  ClutterDamageTilesFlags flags;
+
+  SpanDiffersFunc span_differs;
+  const char *impl_name;
+
+  uint8_t *tiles;
+  size_t n_tiles;
+};
+
+static gboolean
+span_differs_scalar (const uint8_t *a,
+                     const uint8_t *b,
+                     size_t         length)
+{
+  return memcmp (a, b, length) != 0;
+}
+
+#ifdef HAVE_X86_INTRINSICS
+__attribute__ ((target ("sse2")))
+static gboolean
+span_differs_sse2 (const uint8_t *a,
+                   const uint8_t *b,
+                   size_t         length)
+{
+  __m128i acc = _mm_setzero_si128 ();
+  size_t i;
+
+  for (i = 0; i + 16 <= length; i += 16)
+    {
+      __m128i va = _mm_loadu_si128 ((const __m128i *) (a + i));
+      __m128i vb = _mm_loadu_si128 ((const __m128i *) (b + i));
+
+      acc = _mm_or_si128 (acc, _mm_xor_si128 (va, vb));
+    }
+
+  if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (acc, _mm_setzero_si128 ())) != 0xffff)
+    return TRUE;
+
+  return span_differs_scalar (a + i, b + i, length - i);
+}
+
+__attribute__ ((target ("avx2")))
+static gboolean
+span_differs_avx2 (const uint8_t *a,
+                   const uint8_t *b,
+                   size_t         length)
+{
+  __m256i acc = _mm256_setzero_si256 ();
+  size_t i;
+
+  for (i = 0; i + 32 <= length; i += 32)
+    {
+      __m256i va = _mm256_loadu_si256 ((const __m256i *) (a + i));
+      __m256i vb = _mm256_loadu_si256 ((const __m256i *) (b + i));
+
+      acc = _mm256_or_si256 (acc, _mm256_xor_si256 (va, vb));
+    }
+
+  if (!_mm256_testz_si256 (acc, acc))
+    return TRUE;
+
+  return span_differs_sse2 (a + i, b + i, length - i);
+}
+#endif /* HAVE_X86_INTRINSICS */
+
+static void
+diff_tile_rows (TileJob *job)
+{
+  ClutterDamageTiles *damage_tiles = job->damage_tiles;
+  SpanDiffersFunc span_differs = damage_tiles->span_differs;
+  int tile_size = damage_tiles->tile_size;
+  int tile_row;
+
+  for (tile_row = job->first_row; tile_row <= job->last_row; tile_row++)
+    {
+      uint8_t *row_tiles = damage_tiles->tiles + tile_row * job->n_columns;
+      int first_column = -1;
+      int last_column = -1;
+      int column;
+      int y_begin;
+      int y_end;
+      int y;
+
+      for (column = 0; column < job->n_columns; column++)
+        {
+          if (row_tiles[column] != TILE_STATE_CANDIDATE)
+            continue;
+
+          if (first_column < 0)
+            first_column = column;
+          last_column = column;
+        }
+
+      if (first_column < 0)
+        continue;
+
+      y_begin = tile_row * tile_size;
+      y_end = MIN (y_begin + tile_size, job->height);
+
+      /* Walk the buffer one pixel row at a time to keep memory access linear,
+       * and stop as soon as every candidate tile of the row is dirty. */
+      for (y = y_begin; y < y_end; y++)
+        {
+          size_t row_offset = (size_t) y * job->stride;
+          gboolean has_candidates = FALSE;
+
+          for (column = first_column; column <= last_column; column++)
+            {
+              int x;
+              int tile_width;
+              size_t offset;
+
+              if (row_tiles[column] != TILE_STATE_CANDIDATE)
+                continue;
+
+              has_candidates = TRUE;
+
+              x = column * tile_size;
+              tile_width = MIN (tile_size, job->width - x);
+              offset = row_offset + (size_t) x * job->bpp;
+
+              if (span_differs (job->current_data + offset,
+                                job->prev_data + offset,
+                                (size_t) tile_width * job->bpp))
+                row_tiles[column] = TILE_STATE_DIRTY;
+            }
+
+          if (!has_candidates)
+            break;
+        }
+    }
+}
+
+static void
+diff_tile_row_range (int      first,
+                     int      n_items,
+                     gpointer user_data)
+{
+  const TileJob *template_job = user_data;
+  TileJob job = *template_job;
+
+  job.first_row = template_job->first_row + first;
+  job.last_row = job.first_row + n_items - 1;
+
+  diff_tile_rows (&job);
+}
+
+static int
+calculate_n_jobs (ClutterDamageTiles *damage_tiles,
+                  int                 n_candidate_tiles,
+                  int                 bpp)
+{
+  size_t n_bytes;
+
+  if (damage_tiles->flags & CLUTTER_DAMAGE_TILES_FLAG_NO_THREADS)
+    return 1;
+
+  n_bytes = ((size_t) n_candidate_tiles *
+             damage_tiles->tile_size * damage_tiles->tile_size * bpp);
+
+  return (int) CLAMP (n_bytes / MIN_BYTES_PER_JOB,
+                      1, (size_t) clutter_parallel_get_max_tasks ());
+}
+
+static void
+diff_tiles (ClutterDamageTiles *damage_tiles,
+            const TileJob      *template_job,
+            int                 n_jobs)
+{
+  clutter_parallel_for (template_job->last_row - template_job->first_row + 1,
+                        n_jobs,
+                        diff_tile_row_range,
+                        (gpointer) template_job);
+}
+
+ClutterDamageTiles *
+clutter_damage_tiles_new (int                     tile_size,
+                          ClutterDamageTilesFlags flags)
+{
+  ClutterDamageTiles *damage_tiles;
+
+  g_return_val_if_fail (tile_size > 0, NULL);
+
+  damage_tiles = g_new0 (ClutterDamageTiles, 1);
+  damage_tiles->tile_size = tile_size;
+  damage_tiles->flags = flags;
+  damage_tiles->span_differs = span_differs_scalar;
+  damage_tiles->impl_name = "scalar";
+
+#ifdef HAVE_X86_INTRINSICS
+  if (!(flags & CLUTTER_DAMAGE_TILES_FLAG_NO_SIMD))
+    {
+      __builtin_cpu_init ();
+
+      if (__builtin_cpu_supports ("avx2"))
+        {
+          damage_tiles->span_differs = span_differs_avx2;
+          damage_tiles->impl_name = "avx2";
+        }
+      else if (__builtin_cpu_supports ("sse2"))
+        {
+          damage_tiles->span_differs = span_differs_sse2;
+          damage_tiles->impl_name = "sse2";
+        }
+    }
+#endif
+
+  return damage_tiles;
+}
+
+void
+clutter_damage_tiles_free (ClutterDamageTiles *damage_tiles)
+{
+  g_free (damage_tiles->tiles);
+  g_free (damage_tiles);
+}
+
+int
+clutter_damage_tiles_get_tile_size (ClutterDamageTiles *damage_tiles)
+{
+  return damage_tiles->tile_size;
+}
+
+const char *
+clutter_damage_tiles_get_impl_name (ClutterDamageTiles *damage_tiles)
+{
+  return damage_tiles->impl_name;
+}
+
+/**
+ * clutter_damage_tiles_find_changed:
+ * @damage_tiles: a #ClutterDamageTiles
+ * @current_data: the current buffer contents
+ * @prev_data: the previous buffer contents, with the same layout
+ * @width: width of the buffers in pixels
+ * @height: height of the buffers in pixels
+ * @stride: stride of the buffers in bytes
+ * @bpp: bytes per pixel
+ * @damage_region: the region that may have changed
+ *
+ * Returns: (transfer full): the part of @damage_region covered by tiles
+ * with any differing pixel.
+ */
+cairo_region_t *
+clutter_damage_tiles_find_changed (ClutterDamageTiles   *damage_tiles,
+                                   const uint8_t        *current_data,
+                                   const uint8_t        *prev_data,
+                                   int                   width,
+                                   int                   height,
+                                   int                   stride,
+                                   int                   bpp,
+                                   const cairo_region_t *damage_region)
+{
+  int tile_size = damage_tiles->tile_size;
+  cairo_region_t *tile_damage_region;
+  cairo_rectangle_int_t fb_rect;
+  int n_columns;
+  int n_rows;
+  size_t n_tiles;
+  int first_row = INT_MAX;
+  int last_row = -1;
+  int n_candidate_tiles = 0;
+  int n_rects;
+  int tile_row;
+  int i;
+  TileJob template_job;
+
+  tile_damage_region = cairo_region_create ();
+
+  if (width <= 0 || height <= 0)
+    return tile_damage_region;
+
+  n_columns = (width + tile_size - 1) / tile_size;
+  n_rows = (height + tile_size - 1) / tile_size;
+  n_tiles = (size_t) n_columns * n_rows;
+
+  if (n_tiles > damage_tiles->n_tiles)
+    {
+      g_free (damage_tiles->tiles);
+      damage_tiles->tiles = g_malloc (n_tiles);
+      damage_tiles->n_tiles = n_tiles;
+    }
+  memset (damage_tiles->tiles, TILE_STATE_SKIP, n_tiles);
+
+  fb_rect = (cairo_rectangle_int_t) {
+    .width = width,
+    .height = height,
+  };
+
+  n_rects = cairo_region_num_rectangles (damage_region);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+      int first_column, last_column;
+      int rect_first_row, rect_last_row;
+      int column;
+
+      cairo_region_get_rectangle (damage_region, i, &rect);
+      if (!_clutter_util_rectangle_intersection (&rect, &fb_rect, &rect))
+        continue;
+
+      first_column = rect.x / tile_size;
+      last_column = (rect.x + rect.width - 1) / tile_size;
+      rect_first_row = rect.y / tile_size;
+      rect_last_row = (rect.y + rect.height - 1) / tile_size;
+
+      for (tile_row = rect_first_row; tile_row <= rect_last_row; tile_row++)
+        {
+          uint8_t *row_tiles = damage_tiles->tiles + tile_row * n_columns;
+
+          for (column = first_column; column <= last_column; column++)
+            {
+              if (row_tiles[column] == TILE_STATE_CANDIDATE)
+                continue;
+
+              row_tiles[column] = TILE_STATE_CANDIDATE;
+              n_candidate_tiles++;
+            }
+        }
+
+      first_row = MIN (first_row, rect_first_row);
+      last_row = MAX (last_row, rect_last_row);
+    }
+
+  if (n_candidate_tiles == 0)
+    return tile_damage_region;
+
+  template_job = (TileJob) {
+    .damage_tiles = damage_tiles,
+    .current_data = current_data,
+    .prev_data = prev_data,
+    .width = width,
+    .height = height,
+    .stride = stride,
+    .bpp = bpp,
+    .n_columns = n_columns,
+    .first_row = first_row,
+    .last_row = last_row,
+  };
+  diff_tiles (damage_tiles,
+              &template_job,
+              MIN (calculate_n_jobs (damage_tiles, n_candidate_tiles, bpp),
+                   last_row - first_row + 1));
+
+  for (tile_row = first_row; tile_row <= last_row; tile_row++)
+    {
+      uint8_t *row_tiles = damage_tiles->tiles + tile_row * n_columns;
+      int column = 0;
+
+      while (column < n_columns)
+        {
+          cairo_rectangle_int_t rect;
+          int run_start;
+
+          if (row_tiles[column] != TILE_STATE_DIRTY)
+            {
+              column++;
+              continue;
+            }
+
+          run_start = column;
+          while (column < n_columns && row_tiles[column] == TILE_STATE_DIRTY)
+            column++;
+
+          rect = (cairo_rectangle_int_t) {
+            .x = run_start * tile_size,
+            .y = tile_row * tile_size,
+            .width = (column - run_start) * tile_size,
+            .height = tile_size,
+          };
+          _clutter_util_rectangle_intersection (&rect, &fb_rect, &rect);
+          cairo_region_union_rectangle (tile_damage_region, &rect);
+        }
+    }
+
+  cairo_region_intersect (tile_damage_region, damage_region);
+
+  return tile_damage_region;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLUTTER_DAMAGE_TILES_H
+#define CLUTTER_DAMAGE_TILES_H
+
+#include <cairo.h>
+#include <glib.h>
+#include <stdint.h>
+
+#include "clutter-macros.h"
+
+#define CLUTTER_DAMAGE_TILES_DEFAULT_TILE_SIZE 16
+
+typedef enum _ClutterDamageTilesFlags
+{
+  CLUTTER_DAMAGE_TILES_FLAG_NONE = 0,
+  CLUTTER_DAMAGE_TILES_FLAG_NO_SIMD = 1 << 0,
+  CLUTTER_DAMAGE_TILES_FLAG_NO_THREADS = 1 << 1,
+} ClutterDamageTilesFlags;
+
+typedef struct _ClutterDamageTiles ClutterDamageTiles;
+
+CLUTTER_EXPORT
+ClutterDamageTiles * clutter_damage_tiles_new (int                     tile_size,
+                                               ClutterDamageTilesFlags flags);
+
+CLUTTER_EXPORT
+void clutter_damage_tiles_free (ClutterDamageTiles *damage_tiles);
+
+CLUTTER_EXPORT
+int clutter_damage_tiles_get_tile_size (ClutterDamageTiles *damage_tiles);
+
+CLUTTER_EXPORT
+const char * clutter_damage_tiles_get_impl_name (ClutterDamageTiles *damage_tiles);
+
+CLUTTER_EXPORT
+cairo_region_t * clutter_damage_tiles_find_changed (ClutterDamageTiles   *damage_tiles,
+                                                    const uint8_t        *current_data,
+                                                    const uint8_t        *prev_data,
+                                                    int                   width,
+                                                    int                   height,
+                                                    int                   stride,
+                                                    int                   bpp,
+                                                    const cairo_region_t *damage_region);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ClutterDamageTiles, clutter_damage_tiles_free)
+
+#endif /* CLUTTER_DAMAGE_TILES_H */
@@ -19,6 +19,8 @@
 
 #include "clutter/clutter-frame-clock.h"
 
+#include <math.h>
+
 #include "clutter/clutter-debug.h"
 #include "clutter/clutter-main.h"
 #include "clutter/clutter-private.h"
@@ -47,6 +49,35 @@ typedef struct _EstimateQueue
 
 #define SYNC_DELAY_FALLBACK_FRACTION 0.875
 
+/* Weight of new samples in the exponentially weighted averages used by
+ * adaptive scheduling.
+ */
+#define COST_PREDICTOR_SMOOTHING 0.125
+/* Number of mean deviations added to the predicted render time. */
+#define COST_PREDICTOR_DEVIATION_FACTOR 3.0
+#define ADAPTIVE_MIN_MARGIN_US 500
+/* Number of frames to fall back to the fixed estimate after missing a
+ * deadline.
+ */
+#define MISSED_DEADLINE_BACKOFF_FRAMES ESTIMATE_QUEUE_LENGTH
+
+/* Predicts the cost of a frame phase as base + per_pixel * damage area,
+ * using an exponentially weighted least squares fit over past frames.
+ * Phases not depending on the damage are always sampled with an area of 0,
+ * which degrades the fit to an exponentially weighted average.
+ */
+typedef struct _CostPredictor
+{
+  double sum_w;
+  double sum_x;
+  double sum_y;
+  double sum_xx;
+  double sum_xy;
+
+  /* Exponentially weighted mean absolute prediction error. */
+  double deviation;
+} CostPredictor;
+
 typedef struct _ClutterFrameListener
 {
   const ClutterFrameListenerIface *iface;
@@ -105,6 +136,33 @@ struct _ClutterFrameClock
   /* If we got new measurements last frame. */
   gboolean got_measurements_last_frame;
 
+  ClutterFrameClockScheduling scheduling;
+  ClutterFrameClockMode mode;
+
+  /* Time the last dispatched frame was done with layout. */
+  int64_t last_layout_time_us;
+  /* Damage area, in pixels, of the last dispatched frame. */
+  int64_t last_damage_area;
+
+  /* Predictors of the duration between dispatch start and layout done,
+   * between layout done and buffer swap, between buffer swap and GPU
+   * rendering finish, and between buffer swap and KMS submission.
+   */
+  CostPredictor layout_cost;
+  CostPredictor paint_cost;
+  CostPredictor gpu_cost;
+  CostPredictor flip_cost;
+
+  /* Render time predicted when scheduling the last update, and when
+   * scheduling the last dispatched frame, or -1.
+   */
+  int64_t predicted_render_time_us;
+  int64_t dispatch_predicted_render_time_us;
+
+  int missed_deadline_backoff;
+
+  ClutterFrameClockStats stats;
+
   gboolean pending_reschedule;
   gboolean pending_reschedule_now;
 
@@ -124,6 +182,69 @@ estimate_queue_add_value (EstimateQueue *queue,
   queue->next_index = (queue->next_index + 1) % ESTIMATE_QUEUE_LENGTH;
 }
 
+static double
+cost_predictor_predict (CostPredictor *predictor,
+                        double         x)
+{
+  double det;
+  double slope = 0.0;
+  double intercept;
+
+  if (predictor->sum_w == 0.0)
+    return 0.0;
+
+  det = predictor->sum_w * predictor->sum_xx -
+        predictor->sum_x * predictor->sum_x;
+  if (det > 1e-6 * predictor->sum_w * predictor->sum_xx)
+    {
+      slope = (predictor->sum_w * predictor->sum_xy -
+               predictor->sum_x * predictor->sum_y) / det;
+      slope = MAX (slope, 0.0);
+    }
+
+  intercept = (predictor->sum_y - slope * predictor->sum_x) / predictor->sum_w;
+  intercept = MAX (intercept, 0.0);
+
+  return intercept + slope * x;
+}
+
+static void
+cost_predictor_add_sample (CostPredictor *predictor,
+                           double         x,
+                           double         y)
+{
+  const double alpha = COST_PREDICTOR_SMOOTHING;
+
+  if (predictor->sum_w > 0.0)
+    {
+      double error = fabs (y - cost_predictor_predict (predictor, x));
+
+      predictor->deviation = (1.0 - alpha) * predictor->deviation +
+                             alpha * error;
+    }
+
+  predictor->sum_w = (1.0 - alpha) * predictor->sum_w + 1.0;
+  predictor->sum_x = (1.0 - alpha) * predictor->sum_x + x;
+  predictor->sum_y = (1.0 - alpha) * predictor->sum_y + y;
+  predictor->sum_xx = (1.0 - alpha) * predictor->sum_xx + x * x;
+  predictor->sum_xy = (1.0 - alpha) * predictor->sum_xy + x * y;
+}
+
+static gboolean
+cost_predictor_has_samples (CostPredictor *predictor)
+{
+  return predictor->sum_w > 0.0;
+}
+
+/* Damage areas are handled in megapixels to keep the fitted sums in a
+ * reasonable range.
+ */
+static double
+damage_area_to_megapixels (int64_t damage_area)
+{
+  return damage_area / 1000000.0;
+}
+
 float
 clutter_frame_clock_get_refresh_rate (ClutterFrameClock *frame_clock)
 {
@@ -224,6 +345,74 @@ maybe_reschedule_update (ClutterFrameClock *frame_clock)
     }
 }
 
+static void
+update_cost_predictors (ClutterFrameClock *frame_clock,
+                        int64_t            dispatch_to_swap_us,
+                        int64_t            swap_to_rendering_done_us,
+                        int64_t            swap_to_flip_us,
+                        int64_t            swap_time_us)
+{
+  ClutterFrameClockStats *stats = &frame_clock->stats;
+  double damage_area;
+  int64_t layout_us, paint_us;
+  int64_t render_time_us;
+  int64_t predicted_render_time_us;
+
+  damage_area = damage_area_to_megapixels (frame_clock->last_damage_area);
+
+  if (frame_clock->last_layout_time_us >= frame_clock->last_dispatch_time_us &&
+      frame_clock->last_layout_time_us <= swap_time_us)
+    {
+      layout_us =
+        frame_clock->last_layout_time_us - frame_clock->last_dispatch_time_us;
+      paint_us = swap_time_us - frame_clock->last_layout_time_us;
+    }
+  else
+    {
+      layout_us = 0;
+      paint_us = dispatch_to_swap_us;
+    }
+
+  cost_predictor_add_sample (&frame_clock->layout_cost, 0.0, layout_us);
+  cost_predictor_add_sample (&frame_clock->paint_cost, damage_area, paint_us);
+  cost_predictor_add_sample (&frame_clock->gpu_cost, damage_area,
+                             swap_to_rendering_done_us);
+  cost_predictor_add_sample (&frame_clock->flip_cost, 0.0, swap_to_flip_us);
+
+  render_time_us = dispatch_to_swap_us +
+                   MAX (swap_to_rendering_done_us, swap_to_flip_us);
+  predicted_render_time_us = frame_clock->dispatch_predicted_render_time_us;
+
+  stats->n_measured_frames++;
+  stats->last_render_time_us = render_time_us;
+  stats->last_predicted_render_time_us = predicted_render_time_us;
+
+  if (predicted_render_time_us >= 0)
+    {
+      int64_t error_us = render_time_us - predicted_render_time_us;
+
+      if (error_us > 0)
+        {
+          stats->n_underpredicted_frames++;
+          stats->max_prediction_error_us =
+            MAX (stats->max_prediction_error_us, error_us);
+        }
+
+      stats->mean_prediction_error_us =
+        (int64_t) ((1.0 - COST_PREDICTOR_SMOOTHING) *
+                   stats->mean_prediction_error_us +
+                   COST_PREDICTOR_SMOOTHING * ABS (error_us));
+
+      CLUTTER_NOTE (FRAME_TIMINGS,
+                    "layout %ld µs, paint %ld µs, damage %ld px, "
+                    "render time %ld µs, predicted %ld µs",
+                    layout_us, paint_us,
+                    frame_clock->last_damage_area,
+                    render_time_us,
+                    predicted_render_time_us);
+    }
+}
+
 void
 clutter_frame_clock_notify_presented (ClutterFrameClock *frame_clock,
                                       ClutterFrameInfo  *frame_info)
@@ -270,6 +459,20 @@ clutter_frame_clock_notify_presented (ClutterFrameClock *frame_clock,
     }
 #endif
 
+  if (frame_info->presentation_time != 0 &&
+      frame_clock->is_next_presentation_time_valid &&
+      frame_info->presentation_time >
+      frame_clock->next_presentation_time_us +
+      frame_clock->refresh_interval_us / 2)
+    {
+      frame_clock->stats.n_missed_deadlines++;
+      frame_clock->missed_deadline_backoff = MISSED_DEADLINE_BACKOFF_FRAMES;
+    }
+  else if (frame_clock->missed_deadline_backoff > 0)
+    {
+      frame_clock->missed_deadline_backoff--;
+    }
+
   frame_clock->last_presentation_time_us = frame_info->presentation_time;
 
   frame_clock->got_measurements_last_frame = FALSE;
@@ -301,6 +504,12 @@ clutter_frame_clock_notify_presented (ClutterFrameClock *frame_clock,
       estimate_queue_add_value (&frame_clock->swap_to_flip_us,
                                 swap_to_flip_us);
 
+      update_cost_predictors (frame_clock,
+                              dispatch_to_swap_us,
+                              swap_to_rendering_done_us,
+                              swap_to_flip_us,
+                              frame_info->cpu_time_before_buffer_swap_us);
+
       frame_clock->got_measurements_last_frame = TRUE;
     }
 
@@ -346,7 +555,59 @@ clutter_frame_clock_notify_ready (ClutterFrameClock *frame_clock)
 }
 
 static int64_t
-clutter_frame_clock_compute_max_render_time_us (ClutterFrameClock *frame_clock)
+get_pending_damage_area (ClutterFrameClock *frame_clock)
+{
+  if (!frame_clock->listener.iface->get_pending_damage_area)
+    return 0;
+
+  return frame_clock->listener.iface->get_pending_damage_area (frame_clock,
+                                                               frame_clock->listener.user_data);
+}
+
+/* Predicts the duration from dispatch start until both GPU rendering is
+ * done and the buffer is submitted to KMS, and the margin to leave for
+ * errors in that prediction. Returns FALSE if there is nothing to base a
+ * prediction on yet.
+ */
+static gboolean
+predict_render_time_us (ClutterFrameClock *frame_clock,
+                        int64_t           *out_render_time_us,
+                        int64_t           *out_margin_us)
+{
+  double damage_area;
+  double layout_us, paint_us, gpu_us, flip_us;
+  double deviation_us;
+
+  if (!cost_predictor_has_samples (&frame_clock->paint_cost))
+    return FALSE;
+
+  damage_area =
+    damage_area_to_megapixels (get_pending_damage_area (frame_clock));
+
+  layout_us = cost_predictor_predict (&frame_clock->layout_cost, 0.0);
+  paint_us = cost_predictor_predict (&frame_clock->paint_cost, damage_area);
+  gpu_us = cost_predictor_predict (&frame_clock->gpu_cost, damage_area);
+  flip_us = cost_predictor_predict (&frame_clock->flip_cost, 0.0);
+
+  /* GPU rendering and KMS submission happen in parallel, as with the fixed
+   * estimate. Deviations are summed, assuming the worst case of them being
+   * correlated.
+   */
+  deviation_us = frame_clock->layout_cost.deviation +
+                 frame_clock->paint_cost.deviation +
+                 MAX (frame_clock->gpu_cost.deviation,
+                      frame_clock->flip_cost.deviation);
+
+  *out_render_time_us = (int64_t) (layout_us + paint_us +
+                                   MAX (gpu_us, flip_us));
+  *out_margin_us = (int64_t) (COST_PREDICTOR_DEVIATION_FACTOR * deviation_us) +
+                   ADAPTIVE_MIN_MARGIN_US;
+
+  return TRUE;
+}
+
+static int64_t
+clutter_frame_clock_compute_fixed_max_render_time_us (ClutterFrameClock *frame_clock)
 {
   int64_t refresh_interval_us;
   int64_t max_dispatch_to_swap_us = 0;
@@ -396,6 +657,91 @@ clutter_frame_clock_compute_max_render_time_us (ClutterFrameClock *frame_clock)
   return max_render_time_us;
 }
 
+static int64_t
+clutter_frame_clock_compute_max_render_time_us (ClutterFrameClock *frame_clock,
+                                                int64_t           *out_predicted_render_time_us)
+{
+  int64_t fixed_max_render_time_us;
+  int64_t render_time_us;
+  int64_t margin_us;
+  int64_t max_render_time_us;
+
+  fixed_max_render_time_us =
+    clutter_frame_clock_compute_fixed_max_render_time_us (frame_clock);
+
+  if (!predict_render_time_us (frame_clock, &render_time_us, &margin_us))
+    {
+      if (out_predicted_render_time_us)
+        *out_predicted_render_time_us = -1;
+      return fixed_max_render_time_us;
+    }
+
+  if (out_predicted_render_time_us)
+    *out_predicted_render_time_us = render_time_us;
+
+  if (frame_clock->scheduling != CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE ||
+      !frame_clock->got_measurements_last_frame ||
+      G_UNLIKELY (clutter_paint_debug_flags &
+                  CLUTTER_DEBUG_DISABLE_DYNAMIC_MAX_RENDER_TIME))
+    return fixed_max_render_time_us;
+
+  max_render_time_us = render_time_us +
+                       margin_us +
+                       frame_clock->vblank_duration_us;
+
+  /* Be conservative for a while after missing a deadline, the prediction
+   * evidently wasn't good enough.
+   */
+  if (frame_clock->missed_deadline_backoff > 0)
+    max_render_time_us = MAX (max_render_time_us, fixed_max_render_time_us);
+
+  return CLAMP (max_render_time_us, 0, frame_clock->refresh_interval_us);
+}
+
+static void
+calculate_next_variable_update_time_us (ClutterFrameClock *frame_clock,
+                                        int64_t           *out_next_update_time_us,
+                                        int64_t           *out_next_presentation_time_us)
+{
+  int64_t now_us;
+  int64_t max_render_time_allowed_us;
+  int64_t next_presentation_time_us;
+
+  now_us = g_get_monotonic_time ();
+
+  max_render_time_allowed_us =
+    clutter_frame_clock_compute_max_render_time_us (frame_clock,
+                                                    &frame_clock->predicted_render_time_us);
+
+  /*
+   * With a variable refresh rate, the display starts scanning out a new
+   * frame as soon as it is flipped, as long as the previous frame was shown
+   * for at least one refresh interval of the nominal (i.e. the highest)
+   * refresh rate. There is thus no grid of presentation times to align to;
+   * present as soon as possible, but not before the panel can take a new
+   * frame:
+   *
+   *        last_presentation_time_us
+   *       /       earliest next presentation
+   *      /       /
+   * |---|-------|---o-------x--> time
+   *                  \       \
+   *                   now_us  next_presentation_time_us =
+   *                           now_us + max_render_time_allowed_us
+   *
+   * Displays also have a lower bound for their refresh rate; when no new
+   * frame arrives in time, the driver repeats the last one, which the
+   * frame clock doesn't need to care about.
+   */
+  next_presentation_time_us = MAX (frame_clock->last_presentation_time_us +
+                                   frame_clock->refresh_interval_us,
+                                   now_us + max_render_time_allowed_us);
+
+  *out_next_update_time_us =
+    next_presentation_time_us - max_render_time_allowed_us;
+  *out_next_presentation_time_us = next_presentation_time_us;
+}
+
 static void
 calculate_next_update_time_us (ClutterFrameClock *frame_clock,
                                int64_t           *out_next_update_time_us,
@@ -427,9 +773,18 @@ calculate_next_update_time_us (ClutterFrameClock *frame_clock,
       return;
     }
 
+  if (frame_clock->mode == CLUTTER_FRAME_CLOCK_MODE_VARIABLE)
+    {
+      calculate_next_variable_update_time_us (frame_clock,
+                                              out_next_update_time_us,
+                                              out_next_presentation_time_us);
+      return;
+    }
+
   min_render_time_allowed_us = refresh_interval_us / 2;
   max_render_time_allowed_us =
-    clutter_frame_clock_compute_max_render_time_us (frame_clock);
+    clutter_frame_clock_compute_max_render_time_us (frame_clock,
+                                                    &frame_clock->predicted_render_time_us);
 
   if (min_render_time_allowed_us > max_render_time_allowed_us)
     min_render_time_allowed_us = max_render_time_allowed_us;
@@ -678,6 +1033,12 @@ clutter_frame_clock_dispatch (ClutterFrameClock *frame_clock,
   frame_clock->last_dispatch_time_us = time_us;
   g_source_set_ready_time (frame_clock->source, -1);
 
+  frame_clock->dispatch_predicted_render_time_us =
+    frame_clock->predicted_render_time_us;
+  frame_clock->predicted_render_time_us = -1;
+  frame_clock->last_layout_time_us = 0;
+  frame_clock->last_damage_area = 0;
+
   frame_clock->state = CLUTTER_FRAME_CLOCK_STATE_DISPATCHING;
 
   frame_count = frame_clock->frame_count++;
@@ -760,6 +1121,181 @@ clutter_frame_clock_record_flip_time (ClutterFrameClock *frame_clock,
   frame_clock->last_flip_time_us = flip_time_us;
 }
 
+void
+clutter_frame_clock_record_layout_time (ClutterFrameClock *frame_clock,
+                                        int64_t            layout_time_us)
+{
+  frame_clock->last_layout_time_us = layout_time_us;
+}
+
+void
+clutter_frame_clock_record_damage_area (ClutterFrameClock *frame_clock,
+                                        int64_t            damage_area)
+{
+  frame_clock->last_damage_area = damage_area;
+}
+
+void
+clutter_frame_clock_set_scheduling (ClutterFrameClock           *frame_clock,
+                                    ClutterFrameClockScheduling  scheduling)
+{
+  frame_clock->scheduling = scheduling;
+}
+
+ClutterFrameClockScheduling
+clutter_frame_clock_get_scheduling (ClutterFrameClock *frame_clock)
+{
+  return frame_clock->scheduling;
+}
+
+void
+clutter_frame_clock_set_mode (ClutterFrameClock     *frame_clock,
+                              ClutterFrameClockMode  mode)
+{
+  if (frame_clock->mode == mode)
+    return;
+
+  frame_clock->mode = mode;
+
+  /* The presentation time predicted in one mode means nothing in the other;
+   * don't let it skew the next schedule. An already scheduled update is
+   * left alone, the new mode takes effect from the next one.
+   */
+  frame_clock->is_next_presentation_time_valid = FALSE;
+}
+
+ClutterFrameClockMode
+clutter_frame_clock_get_mode (ClutterFrameClock *frame_clock)
+{
+  return frame_clock->mode;
+}
+
+/**
+ * clutter_frame_clock_get_stats: (skip)
+ * @frame_clock: a #ClutterFrameClock
+ * @stats: (out): return location for the statistics
+ *
+ * Retrieves statistics about how well the render time of frames was
+ * predicted. Predictions are made in both scheduling modes, but only
+ * used for scheduling with %CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE.
+ */
+void
+clutter_frame_clock_get_stats (ClutterFrameClock      *frame_clock,
+                               ClutterFrameClockStats *stats)
+{
+  *stats = frame_clock->stats;
+}
+
+/**
+ * clutter_frame_clock_get_next_update_time_us: (skip)
+ * @frame_clock: a #ClutterFrameClock
+ *
+ * Predicts when the frame clock will dispatch the next frame that isn't
+ * already being dispatched or waiting to be presented, i.e. the deadline
+ * for content to be ready to make it into that frame.
+ *
+ * Returns: the predicted dispatch time in the monotonic time base, or -1
+ *   if it can't be predicted, e.g. for a variable refresh rate or before
+ *   anything was presented.
+ */
+int64_t
+clutter_frame_clock_get_next_update_time_us (ClutterFrameClock *frame_clock)
+{
+  int64_t refresh_interval_us = frame_clock->refresh_interval_us;
+  int64_t now_us;
+  int64_t next_presentation_time_us;
+  int64_t max_render_time_us;
+
+  if (frame_clock->mode != CLUTTER_FRAME_CLOCK_MODE_FIXED ||
+      frame_clock->last_presentation_time_us == 0 ||
+      refresh_interval_us <= 0)
+    return -1;
+
+  switch (frame_clock->state)
+    {
+    case CLUTTER_FRAME_CLOCK_STATE_INIT:
+      return -1;
+    case CLUTTER_FRAME_CLOCK_STATE_SCHEDULED:
+      return g_source_get_ready_time (frame_clock->source);
+    case CLUTTER_FRAME_CLOCK_STATE_DISPATCHING:
+    case CLUTTER_FRAME_CLOCK_STATE_PENDING_PRESENTED:
+      if (!frame_clock->is_next_presentation_time_valid)
+        return -1;
+
+      next_presentation_time_us =
+        frame_clock->next_presentation_time_us + refresh_interval_us;
+      break;
+    case CLUTTER_FRAME_CLOCK_STATE_IDLE:
+    default:
+      next_presentation_time_us =
+        frame_clock->last_presentation_time_us + refresh_interval_us;
+      break;
+    }
+
+  /* Unlike when scheduling, don't store the predicted render time, this is
+   * only a peek at what the next schedule will likely be.
+   */
+  max_render_time_us =
+    clutter_frame_clock_compute_max_render_time_us (frame_clock, NULL);
+
+  /* After idling, the next frame is the first one still ahead of us. */
+  now_us = g_get_monotonic_time ();
+  if (next_presentation_time_us - max_render_time_us < now_us)
+    {
+      int64_t lateness_us;
+
+      lateness_us = now_us - (next_presentation_time_us - max_render_time_us);
+      next_presentation_time_us +=
+        (lateness_us / refresh_interval_us + 1) * refresh_interval_us;
+    }
+
+  return next_presentation_time_us - max_render_time_us;
+}
+
+static void
+append_adaptive_debug_info (ClutterFrameClock *frame_clock,
+                            GString           *string)
+{
+  ClutterFrameClockStats *stats = &frame_clock->stats;
+  int64_t damage_area;
+  int64_t render_time_us;
+  int64_t margin_us;
+
+  damage_area = get_pending_damage_area (frame_clock);
+
+  if (predict_render_time_us (frame_clock, &render_time_us, &margin_us))
+    {
+      double area = damage_area_to_megapixels (damage_area);
+
+      g_string_append_printf (string,
+                              "\nPredicted render time: %ld µs + %ld µs margin"
+                              " (%ld px damage)",
+                              render_time_us, margin_us, damage_area);
+      g_string_append_printf (string,
+                              "\nLayout %.0f µs, paint %.0f µs, "
+                              "GPU %.0f µs, flip %.0f µs",
+                              cost_predictor_predict (&frame_clock->layout_cost,
+                                                      0.0),
+                              cost_predictor_predict (&frame_clock->paint_cost,
+                                                      area),
+                              cost_predictor_predict (&frame_clock->gpu_cost,
+                                                      area),
+                              cost_predictor_predict (&frame_clock->flip_cost,
+                                                      0.0));
+    }
+
+  g_string_append_printf (string,
+                          "\nFrames: %ld, missed deadlines: %ld, "
+                          "underpredicted: %ld",
+                          stats->n_measured_frames,
+                          stats->n_missed_deadlines,
+                          stats->n_underpredicted_frames);
+  g_string_append_printf (string,
+                          "\nPrediction error: %ld µs mean, %ld µs max",
+                          stats->mean_prediction_error_us,
+                          stats->max_prediction_error_us);
+}
+
 GString *
 clutter_frame_clock_get_max_render_time_debug_info (ClutterFrameClock *frame_clock)
 {
@@ -771,7 +1307,8 @@ clutter_frame_clock_get_max_render_time_debug_info (ClutterFrameClock *frame_clo
 
   string = g_string_new (NULL);
   g_string_append_printf (string, "Max render time: %ld µs",
-                          clutter_frame_clock_compute_max_render_time_us (frame_clock));
+                          clutter_frame_clock_compute_max_render_time_us (frame_clock,
+                                                                          NULL));
 
   if (frame_clock->got_measurements_last_frame)
     g_string_append_printf (string, " =");
@@ -802,6 +1339,13 @@ clutter_frame_clock_get_max_render_time_debug_info (ClutterFrameClock *frame_clo
   g_string_append_printf (string, "\nConstant: %d µs",
                           clutter_max_render_time_constant_us);
 
+  if (frame_clock->scheduling == CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE)
+    g_string_append_printf (string, "\nAdaptive scheduling:");
+  else
+    g_string_append_printf (string, "\nAdaptive scheduling (inactive):");
+
+  append_adaptive_debug_info (frame_clock, string);
+
   return string;
 }
 
@@ -881,6 +1425,16 @@ static void
 clutter_frame_clock_init (ClutterFrameClock *frame_clock)
 {
   frame_clock->state = CLUTTER_FRAME_CLOCK_STATE_INIT;
+
+  if (G_UNLIKELY (clutter_paint_debug_flags &
+                  CLUTTER_DEBUG_ADAPTIVE_FRAME_SCHEDULING))
+    frame_clock->scheduling = CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE;
+  else
+    frame_clock->scheduling = CLUTTER_FRAME_CLOCK_SCHEDULING_FIXED;
+
+  frame_clock->predicted_render_time_us = -1;
+  frame_clock->dispatch_predicted_render_time_us = -1;
+  frame_clock->stats.last_predicted_render_time_us = -1;
 }
 
 static void
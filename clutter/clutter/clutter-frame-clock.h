@@ -34,6 +34,59 @@ typedef enum _ClutterFrameResult
   CLUTTER_FRAME_RESULT_IDLE,
 } ClutterFrameResult;
 
+/**
+ * ClutterFrameClockScheduling:
+ * @CLUTTER_FRAME_CLOCK_SCHEDULING_FIXED: Dispatch frames the maximum of the
+ *   recently measured render times before the next presentation.
+ * @CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE: Dispatch frames as late as the
+ *   predicted cost of the next frame allows, taking the size of the pending
+ *   damage into account.
+ */
+typedef enum _ClutterFrameClockScheduling
+{
+  CLUTTER_FRAME_CLOCK_SCHEDULING_FIXED,
+  CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE,
+} ClutterFrameClockScheduling;
+
+/**
+ * ClutterFrameClockMode:
+ * @CLUTTER_FRAME_CLOCK_MODE_FIXED: Frames are presented at a fixed refresh
+ *   rate, aligned to the display's vertical blanking.
+ * @CLUTTER_FRAME_CLOCK_MODE_VARIABLE: The display refresh rate follows the
+ *   frame rate; frames are dispatched as soon as they are scheduled, but not
+ *   more often than the nominal refresh rate of the display.
+ */
+typedef enum _ClutterFrameClockMode
+{
+  CLUTTER_FRAME_CLOCK_MODE_FIXED,
+  CLUTTER_FRAME_CLOCK_MODE_VARIABLE,
+} ClutterFrameClockMode;
+
+/**
+ * ClutterFrameClockStats: (skip)
+ * @n_measured_frames: number of presented frames with timing measurements
+ * @n_missed_deadlines: number of frames presented later than scheduled for
+ * @n_underpredicted_frames: number of frames that took longer to render
+ *   than predicted
+ * @mean_prediction_error_us: smoothed absolute difference between the
+ *   predicted and measured render time
+ * @max_prediction_error_us: largest amount a frame took longer to render
+ *   than predicted
+ * @last_predicted_render_time_us: predicted render time of the last frame,
+ *   or -1 if there was no prediction
+ * @last_render_time_us: measured render time of the last frame
+ */
+typedef struct _ClutterFrameClockStats
+{
+  int64_t n_measured_frames;
+  int64_t n_missed_deadlines;
+  int64_t n_underpredicted_frames;
+  int64_t mean_prediction_error_us;
+  int64_t max_prediction_error_us;
+  int64_t last_predicted_render_time_us;
+  int64_t last_render_time_us;
+} ClutterFrameClockStats;
+
 #define CLUTTER_TYPE_FRAME_CLOCK (clutter_frame_clock_get_type ())
 CLUTTER_EXPORT
 G_DECLARE_FINAL_TYPE (ClutterFrameClock, clutter_frame_clock,
@@ -51,6 +104,8 @@ typedef struct _ClutterFrameListenerIface
   ClutterFrameResult (* frame) (ClutterFrameClock *frame_clock,
                                 int64_t            frame_count,
                                 gpointer           user_data);
+  int64_t (* get_pending_damage_area) (ClutterFrameClock *frame_clock,
+                                       gpointer           user_data);
 } ClutterFrameListenerIface;
 
 CLUTTER_EXPORT
@@ -93,6 +148,33 @@ float clutter_frame_clock_get_refresh_rate (ClutterFrameClock *frame_clock);
 void clutter_frame_clock_record_flip_time (ClutterFrameClock *frame_clock,
                                            int64_t            flip_time_us);
 
+void clutter_frame_clock_record_layout_time (ClutterFrameClock *frame_clock,
+                                             int64_t            layout_time_us);
+
+void clutter_frame_clock_record_damage_area (ClutterFrameClock *frame_clock,
+                                             int64_t            damage_area);
+
+CLUTTER_EXPORT
+void clutter_frame_clock_set_scheduling (ClutterFrameClock           *frame_clock,
+                                         ClutterFrameClockScheduling  scheduling);
+
+CLUTTER_EXPORT
+ClutterFrameClockScheduling clutter_frame_clock_get_scheduling (ClutterFrameClock *frame_clock);
+
+CLUTTER_EXPORT
+void clutter_frame_clock_set_mode (ClutterFrameClock     *frame_clock,
+                                   ClutterFrameClockMode  mode);
+
+CLUTTER_EXPORT
+ClutterFrameClockMode clutter_frame_clock_get_mode (ClutterFrameClock *frame_clock);
+
+CLUTTER_EXPORT
+void clutter_frame_clock_get_stats (ClutterFrameClock      *frame_clock,
+                                    ClutterFrameClockStats *stats);
+
+CLUTTER_EXPORT
+int64_t clutter_frame_clock_get_next_update_time_us (ClutterFrameClock *frame_clock);
+
 GString * clutter_frame_clock_get_max_render_time_debug_info (ClutterFrameClock *frame_clock);
 
 #endif /* CLUTTER_FRAME_CLOCK_H */
@@ -119,6 +119,7 @@ static const GDebugKey clutter_debug_keys[] = {
 
 static const GDebugKey clutter_pick_debug_keys[] = {
   { "nop-picking", CLUTTER_DEBUG_NOP_PICKING },
+  { "disable-pick-index", CLUTTER_DEBUG_DISABLE_PICK_INDEX },
 };
 
 static const GDebugKey clutter_paint_debug_keys[] = {
@@ -133,6 +134,8 @@ static const GDebugKey clutter_paint_debug_keys[] = {
   { "damage-region", CLUTTER_DEBUG_PAINT_DAMAGE_REGION },
   { "disable-dynamic-max-render-time", CLUTTER_DEBUG_DISABLE_DYNAMIC_MAX_RENDER_TIME },
   { "max-render-time", CLUTTER_DEBUG_PAINT_MAX_RENDER_TIME },
+  { "adaptive-frame-scheduling", CLUTTER_DEBUG_ADAPTIVE_FRAME_SCHEDULING },
+  { "dual-kawase-blur", CLUTTER_DEBUG_DUAL_KAWASE_BLUR },
 };
 
 gboolean
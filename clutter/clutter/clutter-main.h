@@ -60,6 +60,7 @@ typedef enum
 typedef enum
 {
   CLUTTER_DEBUG_NOP_PICKING = 1 << 0,
+  CLUTTER_DEBUG_DISABLE_PICK_INDEX = 1 << 1,
 } ClutterPickDebugFlag;
 
 typedef enum
@@ -75,6 +76,8 @@ typedef enum
   CLUTTER_DEBUG_PAINT_DAMAGE_REGION             = 1 << 8,
   CLUTTER_DEBUG_DISABLE_DYNAMIC_MAX_RENDER_TIME = 1 << 9,
   CLUTTER_DEBUG_PAINT_MAX_RENDER_TIME           = 1 << 10,
+  CLUTTER_DEBUG_ADAPTIVE_FRAME_SCHEDULING       = 1 << 11,
+  CLUTTER_DEBUG_DUAL_KAWASE_BLUR                = 1 << 12,
 } ClutterDrawDebugFlag;
 
 /**
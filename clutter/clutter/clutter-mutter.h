@@ -28,6 +28,7 @@
 #include "clutter-backend.h"
 #include "clutter-backend-private.h"
 #include "clutter-damage-history.h"
+#include "clutter-damage-tiles.h"
 #include "clutter-event-private.h"
 #include "clutter-input-device-private.h"
 #include "clutter-input-pointer-a11y-private.h"
@@ -116,6 +117,9 @@ void clutter_stage_get_device_coords (ClutterStage         *stage,
                                       ClutterInputDevice   *device,
                                       ClutterEventSequence *sequence,
                                       graphene_point_t     *coords);
+CLUTTER_EXPORT
+void clutter_stage_invalidate_pick (ClutterStage *stage);
+
 CLUTTER_EXPORT
 void clutter_stage_repick_device (ClutterStage       *stage,
                                   ClutterInputDevice *device);
@@ -107,6 +107,10 @@
 struct _ClutterOffscreenEffectPrivate
 {
   CoglOffscreen *offscreen;
+  gboolean offscreen_pooled;
+  /* Whether the texture is larger than the target size, in which case only
+   * its top left target_width by target_height corner is painted */
+  gboolean texture_rounded;
   CoglPipeline *pipeline;
   CoglHandle texture;
 
@@ -130,6 +134,42 @@ G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (ClutterOffscreenEffect,
                                      clutter_offscreen_effect,
                                      CLUTTER_TYPE_EFFECT)
 
+static void clutter_offscreen_effect_real_paint_target (ClutterOffscreenEffect *effect,
+                                                        ClutterPaintNode       *node,
+                                                        ClutterPaintContext    *paint_context);
+
+static void
+clear_offscreen (ClutterOffscreenEffect *self)
+{
+  ClutterOffscreenEffectPrivate *priv = self->priv;
+  CoglContext *ctx;
+
+  if (!priv->offscreen)
+    return;
+
+  if (!priv->offscreen_pooled)
+    {
+      g_clear_object (&priv->offscreen);
+      return;
+    }
+
+  /* Once released, the framebuffer may be handed out to someone else, so
+   * don't keep its texture around; the next paint renders into a newly
+   * acquired one anyway. */
+  g_clear_pointer (&priv->texture, cogl_object_unref);
+  if (priv->pipeline)
+    cogl_pipeline_set_layer_null_texture (priv->pipeline, 0);
+
+  priv->target_width = 0;
+  priv->target_height = 0;
+
+  ctx = cogl_framebuffer_get_context (COGL_FRAMEBUFFER (priv->offscreen));
+  cogl_offscreen_pool_release (cogl_context_get_offscreen_pool (ctx),
+                               g_steal_pointer (&priv->offscreen));
+  priv->offscreen_pooled = FALSE;
+  priv->texture_rounded = FALSE;
+}
+
 static void
 clutter_offscreen_effect_set_actor (ClutterActorMeta *meta,
                                     ClutterActor     *actor)
@@ -142,7 +182,7 @@ clutter_offscreen_effect_set_actor (ClutterActorMeta *meta,
   meta_class->set_actor (meta, actor);
 
   /* clear out the previous state */
-  g_clear_object (&priv->offscreen);
+  clear_offscreen (self);
 
   /* we keep a back pointer here, to avoid going through the ActorMeta */
   priv->actor = clutter_actor_meta_get_actor (meta);
@@ -205,7 +245,7 @@ clutter_offscreen_effect_real_create_pipeline (ClutterOffscreenEffect *effect,
 static void
 video_memory_purged (ClutterOffscreenEffect *self)
 {
-  g_clear_object (&self->priv->offscreen);
+  clear_offscreen (self);
 }
 
 static gboolean
@@ -258,37 +298,88 @@ update_fbo (ClutterEffect *effect,
   }
 
   g_clear_pointer (&priv->texture, cogl_object_unref);
-  g_clear_object (&priv->offscreen);
+  clear_offscreen (self);
+
+  /* Unless a subclass needs a particular texture, draw from the offscreen
+   * pool, so that effects that come and go, or change size, reuse the
+   * framebuffers of each other. When we also paint the target ourselves,
+   * the texture may be larger than needed, which lets e.g. resizing actors
+   * keep using the same framebuffer. */
+  if (offscreen_class->create_texture ==
+      clutter_offscreen_effect_real_create_texture)
+    {
+      CoglContext *ctx =
+        clutter_backend_get_cogl_context (clutter_get_default_backend ());
+      CoglOffscreenPool *pool = cogl_context_get_offscreen_pool (ctx);
+      gboolean rounded;
 
-  priv->texture =
-    clutter_offscreen_effect_create_texture (self, target_width, target_height);
-  if (priv->texture == NULL)
-    return FALSE;
+      rounded = (offscreen_class->paint_target ==
+                 clutter_offscreen_effect_real_paint_target);
 
-  priv->target_width = target_width;
-  priv->target_height = target_height;
+      if (rounded)
+        {
+          offscreen =
+            cogl_offscreen_pool_acquire_rounded (pool,
+                                                 MAX (target_width, 1),
+                                                 MAX (target_height, 1),
+                                                 COGL_TEXTURE_COMPONENTS_RGBA,
+                                                 &error);
+        }
+      else
+        {
+          offscreen =
+            cogl_offscreen_pool_acquire (pool,
+                                         MAX (target_width, 1),
+                                         MAX (target_height, 1),
+                                         COGL_TEXTURE_COMPONENTS_RGBA,
+                                         &error);
+        }
+      if (!offscreen)
+        goto fail;
 
-  offscreen = cogl_offscreen_new_with_texture (priv->texture);
-  if (!cogl_framebuffer_allocate (COGL_FRAMEBUFFER (offscreen), &error))
+      priv->texture = cogl_object_ref (cogl_offscreen_get_texture (offscreen));
+      priv->offscreen = offscreen;
+      priv->offscreen_pooled = TRUE;
+      priv->texture_rounded = rounded;
+    }
+  else
     {
-      g_warning ("Failed to create offscreen effect framebuffer: %s",
-                 error->message);
-
-      g_object_unref (offscreen);
-      cogl_clear_object (&priv->pipeline);
-
-      priv->target_width = 0;
-      priv->target_height = 0;
+      priv->texture =
+        clutter_offscreen_effect_create_texture (self,
+                                                 target_width, target_height);
+      if (priv->texture == NULL)
+        return FALSE;
+
+      offscreen = cogl_offscreen_new_with_texture (priv->texture);
+      if (!cogl_framebuffer_allocate (COGL_FRAMEBUFFER (offscreen), &error))
+        {
+          g_object_unref (offscreen);
+          goto fail;
+        }
 
-      return FALSE;
+      priv->offscreen = offscreen;
+      priv->offscreen_pooled = FALSE;
+      priv->texture_rounded = FALSE;
     }
 
-  priv->offscreen = offscreen;
+  priv->target_width = target_width;
+  priv->target_height = target_height;
 
   cogl_clear_object (&priv->pipeline);
   priv->pipeline = offscreen_class->create_pipeline (self, priv->texture);
 
   return TRUE;
+
+fail:
+  g_warning ("Failed to create offscreen effect framebuffer: %s",
+             error->message);
+
+  cogl_clear_object (&priv->pipeline);
+
+  priv->target_width = 0;
+  priv->target_height = 0;
+
+  return FALSE;
 }
 
 static gboolean
@@ -404,7 +495,7 @@ clutter_offscreen_effect_pre_paint (ClutterEffect       *effect,
   return TRUE;
 
 disable_effect:
-  g_clear_object (&priv->offscreen);
+  clear_offscreen (self);
   return FALSE;
 }
 
@@ -415,6 +506,7 @@ clutter_offscreen_effect_real_paint_target (ClutterOffscreenEffect *effect,
 {
   ClutterOffscreenEffectPrivate *priv = effect->priv;
   ClutterPaintNode *pipeline_node;
+  float width, height;
   guint8 paint_opacity;
 
   paint_opacity = clutter_actor_get_paint_opacity (priv->actor);
@@ -435,12 +527,15 @@ clutter_offscreen_effect_real_paint_target (ClutterOffscreenEffect *effect,
    * box then we will overlay where the actor would have drawn if it
    * hadn't been redirected offscreen.
    */
-  clutter_paint_node_add_rectangle (pipeline_node,
-                                    &(ClutterActorBox) {
-                                        0.f, 0.f,
-                                        cogl_texture_get_width (priv->texture),
-                                        cogl_texture_get_height (priv->texture),
-                                    });
+  clutter_offscreen_effect_get_target_size (effect, &width, &height);
+  clutter_paint_node_add_texture_rectangle (pipeline_node,
+                                            &(ClutterActorBox) {
+                                              0.f, 0.f,
+                                              width, height,
+                                            },
+                                            0.f, 0.f,
+                                            width / cogl_texture_get_width (priv->texture),
+                                            height / cogl_texture_get_height (priv->texture));
 
   clutter_paint_node_unref (pipeline_node);
 }
@@ -543,7 +638,7 @@ clutter_offscreen_effect_paint (ClutterEffect           *effect,
   if (flags & CLUTTER_EFFECT_PAINT_BYPASS_EFFECT)
     {
       add_actor_node (self, node, -1);
-      g_clear_object (&priv->offscreen);
+      clear_offscreen (self);
       return;
     }
 
@@ -565,7 +660,7 @@ clutter_offscreen_effect_set_enabled (ClutterActorMeta *meta,
   ClutterOffscreenEffect *offscreen_effect = CLUTTER_OFFSCREEN_EFFECT (meta);
   ClutterOffscreenEffectPrivate *priv = offscreen_effect->priv;
 
-  g_clear_object (&priv->offscreen);
+  clear_offscreen (offscreen_effect);
 
   parent_class->set_enabled (meta, is_enabled);
 }
@@ -576,7 +671,7 @@ clutter_offscreen_effect_finalize (GObject *gobject)
   ClutterOffscreenEffect *self = CLUTTER_OFFSCREEN_EFFECT (gobject);
   ClutterOffscreenEffectPrivate *priv = self->priv;
 
-  g_clear_object (&priv->offscreen);
+  clear_offscreen (self);
   g_clear_pointer (&priv->texture, cogl_object_unref);
   g_clear_pointer (&priv->pipeline, cogl_object_unref);
 
@@ -721,7 +816,9 @@ clutter_offscreen_effect_create_texture (ClutterOffscreenEffect *effect,
  * @height: (out): return location for the target height, or %NULL
  *
  * Retrieves the size of the offscreen buffer used by @effect to
- * paint the actor to which it has been applied.
+ * paint the actor to which it has been applied. The texture returned by
+ * clutter_offscreen_effect_get_texture() may be larger than that, in which
+ * case only its top left corner of this size contains the actor.
  *
  * This function should only be called by #ClutterOffscreenEffect
  * implementations, from within the #ClutterOffscreenEffectClass.paint_target()
@@ -746,11 +843,22 @@ clutter_offscreen_effect_get_target_size (ClutterOffscreenEffect *effect,
   if (priv->texture == NULL)
     return FALSE;
 
-  if (width)
-    *width = cogl_texture_get_width (priv->texture);
+  if (priv->texture_rounded)
+    {
+      if (width)
+        *width = MAX (priv->target_width, 1);
+
+      if (height)
+        *height = MAX (priv->target_height, 1);
+    }
+  else
+    {
+      if (width)
+        *width = cogl_texture_get_width (priv->texture);
 
-  if (height)
-    *height = cogl_texture_get_height (priv->texture);
+      if (height)
+        *height = cogl_texture_get_height (priv->texture);
+    }
 
   return TRUE;
 }
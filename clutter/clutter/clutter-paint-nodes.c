@@ -1855,9 +1855,19 @@ static void
 clutter_blur_node_finalize (ClutterPaintNode *node)
 {
   ClutterBlurNode *blur_node = CLUTTER_BLUR_NODE (node);
+  ClutterLayerNode *layer_node = CLUTTER_LAYER_NODE (node);
 
   g_clear_pointer (&blur_node->blur, clutter_blur_free);
 
+  if (layer_node->offscreen)
+    {
+      CoglFramebuffer *offscreen = g_steal_pointer (&layer_node->offscreen);
+      CoglContext *context = cogl_framebuffer_get_context (offscreen);
+
+      cogl_offscreen_pool_release (cogl_context_get_offscreen_pool (context),
+                                   COGL_OFFSCREEN (offscreen));
+    }
+
   CLUTTER_PAINT_NODE_CLASS (clutter_blur_node_parent_class)->finalize (node);
 }
 
@@ -1914,11 +1924,11 @@ clutter_blur_node_new (unsigned int width,
                        unsigned int height,
                        float        sigma)
 {
-  g_autoptr (CoglOffscreen) offscreen = NULL;
   g_autoptr (GError) error = NULL;
   ClutterLayerNode *layer_node;
   ClutterBlurNode *blur_node;
-  CoglTexture2D *tex_2d;
+  CoglOffscreenPool *pool;
+  CoglOffscreen *offscreen;
   CoglContext *context;
   CoglTexture *texture;
   ClutterBlur *blur;
@@ -1927,32 +1937,38 @@ clutter_blur_node_new (unsigned int width,
 
   blur_node = _clutter_paint_node_create (CLUTTER_TYPE_BLUR_NODE);
   blur_node->sigma = sigma;
-  context = clutter_backend_get_cogl_context (clutter_get_default_backend ());
-  tex_2d = cogl_texture_2d_new_with_size (context, width, height);
 
-  texture = COGL_TEXTURE (tex_2d);
-  cogl_texture_set_premultiplied (texture, TRUE);
+  if (width == 0 || height == 0)
+    goto out;
 
-  offscreen = cogl_offscreen_new_with_texture (texture);
-  cogl_object_unref (tex_2d);
-  if (!cogl_framebuffer_allocate (COGL_FRAMEBUFFER (offscreen), &error))
+  /* Blur nodes are recreated on every frame, so reuse the layer framebuffer
+   * of the previous ones */
+  context = clutter_backend_get_cogl_context (clutter_get_default_backend ());
+  pool = cogl_context_get_offscreen_pool (context);
+  offscreen = cogl_offscreen_pool_acquire (pool, width, height,
+                                           COGL_TEXTURE_COMPONENTS_RGBA,
+                                           &error);
+  if (!offscreen)
     {
       g_warning ("Unable to allocate paint node offscreen: %s",
                  error->message);
       goto out;
     }
 
+  texture = cogl_offscreen_get_texture (offscreen);
+
   blur = clutter_blur_new (texture, sigma);
   blur_node->blur = blur;
 
   if (!blur)
     {
       g_warning ("Failed to create blur pipeline");
+      cogl_offscreen_pool_release (pool, offscreen);
       goto out;
     }
 
   layer_node = CLUTTER_LAYER_NODE (blur_node);
-  layer_node->offscreen = COGL_FRAMEBUFFER (g_steal_pointer (&offscreen));
+  layer_node->offscreen = COGL_FRAMEBUFFER (offscreen);
   layer_node->pipeline = cogl_pipeline_copy (default_texture_pipeline);
   cogl_pipeline_set_layer_filters (layer_node->pipeline, 0,
                                    COGL_PIPELINE_FILTER_LINEAR,
@@ -1961,11 +1977,6 @@ clutter_blur_node_new (unsigned int width,
                                    0,
                                    clutter_blur_get_texture (blur));
 
-  cogl_framebuffer_orthographic (layer_node->offscreen,
-                                 0.0, 0.0,
-                                 width, height,
-                                 0.0, 1.0);
-
 out:
   return (ClutterPaintNode *) blur_node;
 }
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLUTTER_PARALLEL_PRIVATE_H
+#define CLUTTER_PARALLEL_PRIVATE_H
+
+#include <glib.h>
+
+typedef void (* ClutterParallelFunc) (int      first,
+                                      int      n_items,
+                                      gpointer user_data);
+
+int clutter_parallel_get_max_tasks (void);
+
+void clutter_parallel_for (int                 n_items,
+                           int                 n_tasks,
+                           ClutterParallelFunc func,
+                           gpointer            user_data);
+
+#endif /* CLUTTER_PARALLEL_PRIVATE_H */
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "clutter-build-config.h"
+
+#include "clutter-parallel-private.h"
+
+#include <stdint.h>
+
+#define MAX_TASKS 5
+
+typedef struct
+{
+  ClutterParallelFunc func;
+  gpointer user_data;
+
+  GMutex mutex;
+  GCond cond;
+  int n_pending;
+} ParallelJob;
+
+typedef struct
+{
+  ParallelJob *job;
+  int first;
+  int n_items;
+} ParallelTask;
+
+static void
+run_task (gpointer data,
+          gpointer user_data)
+{
+  ParallelTask *task = data;
+  ParallelJob *job = task->job;
+
+  job->func (task->first, task->n_items, job->user_data);
+
+  g_mutex_lock (&job->mutex);
+  if (--job->n_pending == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->mutex);
+}
+
+static GThreadPool *
+get_thread_pool (void)
+{
+  static GThreadPool *thread_pool = NULL;
+
+  if (g_once_init_enter (&thread_pool))
+    {
+      GThreadPool *new_thread_pool;
+
+      new_thread_pool = g_thread_pool_new (run_task, NULL,
+                                           MAX_TASKS - 1, FALSE,
+                                           NULL);
+      g_once_init_leave (&thread_pool, new_thread_pool);
+    }
+
+  return thread_pool;
+}
+
+/*
+ * clutter_parallel_get_max_tasks:
+ *
+ * Returns: the number of tasks work can usefully be split into, including
+ *   the one run by the calling thread
+ */
+int
+clutter_parallel_get_max_tasks (void)
+{
+  return CLAMP ((int) g_get_num_processors (), 1, MAX_TASKS);
+}
+
+/*
+ * clutter_parallel_for:
+ * @n_items: the number of items
+ * @n_tasks: the number of tasks to split the items into
+ * @func: function called for each range of items
+ * @user_data: data passed to @func
+ *
+ * Splits @n_items into @n_tasks contiguous ranges and calls @func for
+ * each of them, the first one from the calling thread and the others from
+ * a shared thread pool. Returns once all the ranges are processed.
+ */
+void
+clutter_parallel_for (int                 n_items,
+                      int                 n_tasks,
+                      ClutterParallelFunc func,
+                      gpointer            user_data)
+{
+  ParallelTask tasks[MAX_TASKS];
+  ParallelJob job;
+  GThreadPool *thread_pool;
+  int i;
+
+  n_tasks = MIN (n_tasks, clutter_parallel_get_max_tasks ());
+  n_tasks = MIN (n_tasks, n_items);
+
+  if (n_tasks < 2)
+    {
+      if (n_items > 0)
+        func (0, n_items, user_data);
+      return;
+    }
+
+  job.func = func;
+  job.user_data = user_data;
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+  job.n_pending = n_tasks - 1;
+
+  thread_pool = get_thread_pool ();
+
+  for (i = 0; i < n_tasks; i++)
+    {
+      tasks[i].job = &job;
+      tasks[i].first = (int) (((int64_t) n_items * i) / n_tasks);
+      tasks[i].n_items =
+        (int) (((int64_t) n_items * (i + 1)) / n_tasks) - tasks[i].first;
+    }
+
+  /* The first task is run by the calling thread */
+  for (i = 1; i < n_tasks; i++)
+    g_thread_pool_push (thread_pool, &tasks[i], NULL);
+
+  func (tasks[0].first, tasks[0].n_items, user_data);
+
+  g_mutex_lock (&job.mutex);
+  while (job.n_pending > 0)
+    g_cond_wait (&job.cond, &job.mutex);
+  g_mutex_unlock (&job.mutex);
+
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+}
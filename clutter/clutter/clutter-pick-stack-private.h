@@ -39,6 +39,8 @@ void clutter_pick_stack_unref (ClutterPickStack *pick_stack);
 
 void clutter_pick_stack_seal (ClutterPickStack *pick_stack);
 
+void clutter_pick_stack_build_index (ClutterPickStack *pick_stack);
+
 void clutter_pick_stack_log_pick (ClutterPickStack      *pick_stack,
                                   const ClutterActorBox *box,
                                   ClutterActor          *actor);
@@ -41,6 +41,29 @@ typedef struct
   int prev;
 } PickClipRecord;
 
+#define MAX_INDEX_LEAF_ITEMS 4
+#define MAX_INDEX_DEPTH 64
+
+typedef struct
+{
+  graphene_box_t box;
+  int record;
+} PickIndexItem;
+
+/* A node of the bounding volume hierarchy over the pick records. The left
+ * child of an inner node directly follows it, while leaves refer to a range
+ * of items. max_record is the frontmost record below the node, so that the
+ * nodes that can't beat the current best hit can be skipped.
+ */
+typedef struct
+{
+  graphene_box_t box;
+  int first_item;
+  int n_items;
+  int right;
+  int max_record;
+} PickIndexNode;
+
 struct _ClutterPickStack
 {
   grefcount ref_count;
@@ -50,6 +73,10 @@ struct _ClutterPickStack
   GArray *clip_stack;
   int current_clip_stack_top;
 
+  GArray *index_items;
+  GArray *index_nodes;
+  GArray *unindexed_records;
+
   gboolean sealed : 1;
 };
 
@@ -250,6 +277,9 @@ clutter_pick_stack_dispose (ClutterPickStack *pick_stack)
   g_clear_pointer (&pick_stack->matrix_stack, cogl_object_unref);
   g_clear_pointer (&pick_stack->vertices_stack, g_array_unref);
   g_clear_pointer (&pick_stack->clip_stack, g_array_unref);
+  g_clear_pointer (&pick_stack->index_items, g_array_unref);
+  g_clear_pointer (&pick_stack->index_nodes, g_array_unref);
+  g_clear_pointer (&pick_stack->unindexed_records, g_array_unref);
 }
 
 static void
@@ -486,6 +516,9 @@ calculate_clear_area (ClutterPickStack  *pick_stack,
         &g_array_index (pick_stack->vertices_stack, PickRecord, i);
       ClutterActorBox paint_box;
 
+      if (!rec->actor)
+        continue;
+
       if (!rec->is_overlap &&
 	  (rec->base.rect.x1 == rec->base.rect.x2 ||
 	   rec->base.rect.y1 == rec->base.rect.y2))
@@ -509,6 +542,305 @@ calculate_clear_area (ClutterPickStack  *pick_stack,
   g_clear_pointer (&area, cairo_region_destroy);
 }
 
+/* Narrows the bounding box of a flat record down to its clip rectangles that
+ * are in the same plane. Returns FALSE if nothing of the record is left.
+ */
+static gboolean
+clip_index_box (ClutterPickStack *pick_stack,
+                PickRecord       *rec,
+                graphene_box_t   *box)
+{
+  graphene_point3d_t min, max;
+  int clip_index;
+
+  graphene_box_get_min (box, &min);
+  graphene_box_get_max (box, &max);
+
+  clip_index = rec->clip_index;
+  while (clip_index >= 0)
+    {
+      PickClipRecord *clip =
+        &g_array_index (pick_stack->clip_stack, PickClipRecord, clip_index);
+
+      maybe_project_record (&clip->base);
+
+      if (is_axis_aligned_2d_rectangle (clip->base.vertices) &&
+          G_APPROX_VALUE (clip->base.vertices[0].z,
+                          rec->base.vertices[0].z,
+                          FLT_EPSILON))
+        {
+          graphene_box_t clip_box;
+          graphene_point3d_t clip_min, clip_max;
+
+          graphene_box_init_from_points (&clip_box, 4, clip->base.vertices);
+          graphene_box_get_min (&clip_box, &clip_min);
+          graphene_box_get_max (&clip_box, &clip_max);
+
+          min.x = MAX (min.x, clip_min.x);
+          min.y = MAX (min.y, clip_min.y);
+          max.x = MIN (max.x, clip_max.x);
+          max.y = MIN (max.y, clip_max.y);
+
+          if (min.x > max.x || min.y > max.y)
+            return FALSE;
+        }
+
+      clip_index = clip->prev;
+    }
+
+  graphene_box_init (box, &min, &max);
+
+  return TRUE;
+}
+
+static int
+compare_index_items (gconstpointer a,
+                     gconstpointer b,
+                     gpointer      user_data)
+{
+  const PickIndexItem *item_a = a;
+  const PickIndexItem *item_b = b;
+  int axis = GPOINTER_TO_INT (user_data);
+  graphene_point3d_t center_a, center_b;
+  float value_a, value_b;
+
+  graphene_box_get_center (&item_a->box, &center_a);
+  graphene_box_get_center (&item_b->box, &center_b);
+
+  switch (axis)
+    {
+    case 0:
+      value_a = center_a.x;
+      value_b = center_b.x;
+      break;
+    case 1:
+      value_a = center_a.y;
+      value_b = center_b.y;
+      break;
+    default:
+      value_a = center_a.z;
+      value_b = center_b.z;
+      break;
+    }
+
+  if (value_a < value_b)
+    return -1;
+  else if (value_a > value_b)
+    return 1;
+  else
+    return 0;
+}
+
+static int
+build_index_node (ClutterPickStack *pick_stack,
+                  int               first_item,
+                  int               n_items,
+                  int               depth)
+{
+  PickIndexItem *items =
+    &g_array_index (pick_stack->index_items, PickIndexItem, first_item);
+  PickIndexNode node = { 0 };
+  graphene_box_t centers;
+  graphene_vec3_t size;
+  int node_index;
+  int right;
+  int axis;
+  int i;
+
+  node.box = items[0].box;
+  node.max_record = items[0].record;
+  graphene_box_init_from_box (&centers, graphene_box_empty ());
+  for (i = 0; i < n_items; i++)
+    {
+      graphene_point3d_t center;
+
+      graphene_box_union (&node.box, &items[i].box, &node.box);
+      node.max_record = MAX (node.max_record, items[i].record);
+
+      graphene_box_get_center (&items[i].box, &center);
+      graphene_box_expand (&centers, &center, &centers);
+    }
+
+  node_index = pick_stack->index_nodes->len;
+  g_array_append_val (pick_stack->index_nodes, node);
+
+  graphene_box_get_size (&centers, &size);
+  if (n_items <= MAX_INDEX_LEAF_ITEMS ||
+      depth >= MAX_INDEX_DEPTH / 2 ||
+      graphene_vec3_get_x (&size) + graphene_vec3_get_y (&size) +
+      graphene_vec3_get_z (&size) == 0.f)
+    {
+      PickIndexNode *leaf =
+        &g_array_index (pick_stack->index_nodes, PickIndexNode, node_index);
+
+      leaf->first_item = first_item;
+      leaf->n_items = n_items;
+      return node_index;
+    }
+
+  /* Split at the median along the axis where the records spread the most */
+  if (graphene_vec3_get_x (&size) >= graphene_vec3_get_y (&size) &&
+      graphene_vec3_get_x (&size) >= graphene_vec3_get_z (&size))
+    axis = 0;
+  else if (graphene_vec3_get_y (&size) >= graphene_vec3_get_z (&size))
+    axis = 1;
+  else
+    axis = 2;
+
+  g_qsort_with_data (items, n_items, sizeof (PickIndexItem),
+                     compare_index_items, GINT_TO_POINTER (axis));
+
+  build_index_node (pick_stack, first_item, n_items / 2, depth + 1);
+  right = build_index_node (pick_stack,
+                            first_item + n_items / 2,
+                            n_items - n_items / 2,
+                            depth + 1);
+
+  g_array_index (pick_stack->index_nodes, PickIndexNode, node_index).right =
+    right;
+
+  return node_index;
+}
+
+/**
+ * clutter_pick_stack_build_index:
+ * @pick_stack: A sealed #ClutterPickStack
+ *
+ * Builds a bounding volume hierarchy over the projected pick records of
+ * @pick_stack, making clutter_pick_stack_search_actor() only test the records
+ * near the searched point. This is worth it when @pick_stack is retained and
+ * searched many times.
+ */
+void
+clutter_pick_stack_build_index (ClutterPickStack *pick_stack)
+{
+  int i;
+
+  g_assert (pick_stack->sealed);
+  g_assert (!pick_stack->index_nodes);
+
+  pick_stack->index_items =
+    g_array_sized_new (FALSE, FALSE, sizeof (PickIndexItem),
+                       pick_stack->vertices_stack->len);
+  pick_stack->index_nodes =
+    g_array_sized_new (FALSE, FALSE, sizeof (PickIndexNode),
+                       pick_stack->vertices_stack->len / 2 + 1);
+  pick_stack->unindexed_records = g_array_new (FALSE, FALSE, sizeof (int));
+
+  for (i = 0; i < pick_stack->vertices_stack->len; i++)
+    {
+      PickRecord *rec =
+        &g_array_index (pick_stack->vertices_stack, PickRecord, i);
+      PickIndexItem item;
+
+      if (rec->is_overlap || !rec->actor)
+        continue;
+
+      maybe_project_record (&rec->base);
+
+      /* Transformed records can be hit away from their 2D bounds, since
+       * the ray is tested against their triangles, so those are always
+       * searched.
+       */
+      if (!is_axis_aligned_2d_rectangle (rec->base.vertices))
+        {
+          g_array_append_val (pick_stack->unindexed_records, i);
+          continue;
+        }
+
+      graphene_box_init_from_points (&item.box, 4, rec->base.vertices);
+      if (!clip_index_box (pick_stack, rec, &item.box))
+        continue;
+
+      item.record = i;
+      g_array_append_val (pick_stack->index_items, item);
+    }
+
+  if (pick_stack->index_items->len > 0)
+    build_index_node (pick_stack, 0, pick_stack->index_items->len, 0);
+}
+
+static inline gboolean
+box_may_intersect (const graphene_box_t     *box,
+                   const graphene_point3d_t *point,
+                   const graphene_ray_t     *ray)
+{
+  return graphene_box_contains_point (box, point) ||
+         graphene_ray_intersects_box (ray, box);
+}
+
+static inline gboolean
+record_is_hit (ClutterPickStack         *pick_stack,
+               int                       index,
+               const graphene_point3d_t *point,
+               const graphene_ray_t     *ray)
+{
+  PickRecord *rec =
+    &g_array_index (pick_stack->vertices_stack, PickRecord, index);
+
+  return !rec->is_overlap && rec->actor &&
+         ray_intersects_record (pick_stack, rec, point, ray);
+}
+
+static int
+search_index (ClutterPickStack         *pick_stack,
+              const graphene_point3d_t *point,
+              const graphene_ray_t     *ray)
+{
+  int stack[MAX_INDEX_DEPTH];
+  int stack_size = 0;
+  int best = -1;
+  int i;
+
+  if (pick_stack->index_nodes->len > 0)
+    stack[stack_size++] = 0;
+
+  while (stack_size > 0)
+    {
+      int node_index = stack[--stack_size];
+      PickIndexNode *node =
+        &g_array_index (pick_stack->index_nodes, PickIndexNode, node_index);
+
+      if (node->max_record <= best ||
+          !box_may_intersect (&node->box, point, ray))
+        continue;
+
+      if (node->n_items == 0)
+        {
+          stack[stack_size++] = node->right;
+          stack[stack_size++] = node_index + 1;
+          continue;
+        }
+
+      for (i = node->first_item; i < node->first_item + node->n_items; i++)
+        {
+          PickIndexItem *item =
+            &g_array_index (pick_stack->index_items, PickIndexItem, i);
+
+          if (item->record > best &&
+              box_may_intersect (&item->box, point, ray) &&
+              record_is_hit (pick_stack, item->record, point, ray))
+            best = item->record;
+        }
+    }
+
+  for (i = pick_stack->unindexed_records->len - 1; i >= 0; i--)
+    {
+      int record = g_array_index (pick_stack->unindexed_records, int, i);
+
+      if (record <= best)
+        break;
+
+      if (record_is_hit (pick_stack, record, point, ray))
+        {
+          best = record;
+          break;
+        }
+    }
+
+  return best;
+}
+
 ClutterActor *
 clutter_pick_stack_search_actor (ClutterPickStack          *pick_stack,
                                  const graphene_point3d_t  *point,
@@ -517,6 +849,20 @@ clutter_pick_stack_search_actor (ClutterPickStack          *pick_stack,
 {
   int i;
 
+  if (pick_stack->index_nodes)
+    {
+      PickRecord *rec;
+
+      i = search_index (pick_stack, point, ray);
+      if (i < 0)
+        return NULL;
+
+      rec = &g_array_index (pick_stack->vertices_stack, PickRecord, i);
+      if (clear_area)
+        calculate_clear_area (pick_stack, rec, i, clear_area);
+      return rec->actor;
+    }
+
   /* Search all "painted" pickable actors from front to back. A linear search
    * is required, and also performs fine since there is typically only
    * on the order of dozens of actors in the list (on screen) at a time.
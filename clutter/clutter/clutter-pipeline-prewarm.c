@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * ClutterPipelinePrewarm moves shader compilation out of the first frames
+ * after startup.
+ *
+ * Pipelines are described by a shape and a variant, e.g. a combination of
+ * snippets, each shape having a function able to create a pipeline from a
+ * variant. Users record the shapes they create pipelines for; the set of
+ * recorded shapes is stored on disk, and on the next startup, pipelines of
+ * each stored shape are created and drawn off screen from an idle callback,
+ * one per main loop iteration, so that the shaders are compiled and linked
+ * by the time they are needed.
+ */
+
+#include "clutter-build-config.h"
+
+#include "clutter-pipeline-prewarm.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "clutter-blur-private.h"
+#include "clutter-private.h"
+
+/* Upper bound of the startup work, in case something records shapes
+ * without bounds */
+#define MAX_SHAPES 256
+
+#define SAVE_TIMEOUT_S 10
+
+typedef struct _ShapeEntry
+{
+  char *shape;
+  char *variant;
+} ShapeEntry;
+
+struct _ClutterPipelinePrewarm
+{
+  CoglContext *cogl_context;
+  char *path;
+
+  GHashTable *shape_funcs;
+
+  /* Shapes stored by the previous session, followed by the ones recorded
+   * for the first time in this session */
+  GPtrArray *entries;
+  GHashTable *entry_keys;
+  unsigned int n_stored_entries;
+  gboolean is_dirty;
+
+  unsigned int next_entry;
+  CoglFramebuffer *framebuffer;
+  guint idle_id;
+
+  guint save_timeout_id;
+};
+
+static ClutterPipelinePrewarm *default_prewarm;
+
+static void
+shape_entry_free (ShapeEntry *entry)
+{
+  g_free (entry->shape);
+  g_free (entry->variant);
+  g_free (entry);
+}
+
+static gboolean
+is_valid_name (const char *name)
+{
+  return *name && !strpbrk (name, ":\n");
+}
+
+static gboolean
+add_entry (ClutterPipelinePrewarm *prewarm,
+           const char             *shape,
+           const char             *variant)
+{
+  ShapeEntry *entry;
+  char *key;
+
+  if (prewarm->entries->len >= MAX_SHAPES)
+    return FALSE;
+
+  key = g_strdup_printf ("%s:%s", shape, variant);
+  if (!g_hash_table_add (prewarm->entry_keys, key))
+    return FALSE;
+
+  entry = g_new0 (ShapeEntry, 1);
+  entry->shape = g_strdup (shape);
+  entry->variant = g_strdup (variant);
+  g_ptr_array_add (prewarm->entries, entry);
+
+  return TRUE;
+}
+
+static void
+load_entries (ClutterPipelinePrewarm *prewarm)
+{
+  g_autofree char *contents = NULL;
+  g_auto (GStrv) lines = NULL;
+  g_autoptr (GError) error = NULL;
+  int i;
+
+  if (!g_file_get_contents (prewarm->path, &contents, NULL, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("Failed to load pipeline shapes: %s", error->message);
+      return;
+    }
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    {
+      g_auto (GStrv) parts = NULL;
+
+      parts = g_strsplit (lines[i], ":", 2);
+      if (g_strv_length (parts) != 2 ||
+          !is_valid_name (parts[0]) ||
+          !is_valid_name (parts[1]))
+        continue;
+
+      add_entry (prewarm, parts[0], parts[1]);
+    }
+
+  prewarm->n_stored_entries = prewarm->entries->len;
+}
+
+ClutterPipelinePrewarm *
+clutter_pipeline_prewarm_new (CoglContext *cogl_context,
+                              const char  *path)
+{
+  ClutterPipelinePrewarm *prewarm;
+
+  prewarm = g_new0 (ClutterPipelinePrewarm, 1);
+  prewarm->cogl_context = cogl_context;
+  prewarm->path = g_strdup (path);
+  prewarm->shape_funcs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, NULL);
+  prewarm->entries =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) shape_entry_free);
+  prewarm->entry_keys = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
+
+  clutter_pipeline_prewarm_register_shape (prewarm,
+                                           "clutter-blur",
+                                           clutter_blur_create_prewarm_pipeline);
+
+  if (prewarm->path)
+    load_entries (prewarm);
+
+  return prewarm;
+}
+
+static void
+finish_prewarm (ClutterPipelinePrewarm *prewarm)
+{
+  prewarm->next_entry = prewarm->n_stored_entries;
+  g_clear_handle_id (&prewarm->idle_id, g_source_remove);
+  g_clear_object (&prewarm->framebuffer);
+}
+
+void
+clutter_pipeline_prewarm_free (ClutterPipelinePrewarm *prewarm)
+{
+  g_autoptr (GError) error = NULL;
+
+  if (default_prewarm == prewarm)
+    default_prewarm = NULL;
+
+  finish_prewarm (prewarm);
+  g_clear_handle_id (&prewarm->save_timeout_id, g_source_remove);
+
+  if (prewarm->path && prewarm->is_dirty &&
+      !clutter_pipeline_prewarm_save (prewarm, &error))
+    g_warning ("Failed to save pipeline shapes: %s", error->message);
+
+  g_hash_table_unref (prewarm->entry_keys);
+  g_ptr_array_unref (prewarm->entries);
+  g_hash_table_unref (prewarm->shape_funcs);
+  g_free (prewarm->path);
+  g_free (prewarm);
+}
+
+void
+clutter_pipeline_prewarm_register_shape (ClutterPipelinePrewarm   *prewarm,
+                                         const char               *shape,
+                                         ClutterPipelineShapeFunc  func)
+{
+  g_return_if_fail (is_valid_name (shape));
+
+  g_hash_table_insert (prewarm->shape_funcs, g_strdup (shape), func);
+}
+
+static gboolean
+save_timeout_cb (gpointer user_data)
+{
+  ClutterPipelinePrewarm *prewarm = user_data;
+  g_autoptr (GError) error = NULL;
+
+  prewarm->save_timeout_id = 0;
+
+  if (!clutter_pipeline_prewarm_save (prewarm, &error))
+    g_warning ("Failed to save pipeline shapes: %s", error->message);
+
+  return G_SOURCE_REMOVE;
+}
+
+void
+clutter_pipeline_prewarm_record (ClutterPipelinePrewarm *prewarm,
+                                 const char             *shape,
+                                 const char             *variant)
+{
+  g_return_if_fail (is_valid_name (shape));
+  g_return_if_fail (is_valid_name (variant));
+
+  if (!add_entry (prewarm, shape, variant))
+    return;
+
+  prewarm->is_dirty = TRUE;
+
+  /* Don't rely on being shut down cleanly to keep what was recorded */
+  if (prewarm->path && !prewarm->save_timeout_id)
+    {
+      prewarm->save_timeout_id =
+        g_timeout_add_seconds (SAVE_TIMEOUT_S, save_timeout_cb, prewarm);
+      g_source_set_name_by_id (prewarm->save_timeout_id,
+                               "[mutter] Save pipeline shapes");
+    }
+}
+
+static gboolean
+ensure_framebuffer (ClutterPipelinePrewarm *prewarm)
+{
+  g_autoptr (CoglOffscreen) offscreen = NULL;
+  g_autoptr (GError) error = NULL;
+  CoglTexture *texture;
+
+  if (prewarm->framebuffer)
+    return TRUE;
+
+  texture = COGL_TEXTURE (cogl_texture_2d_new_with_size (prewarm->cogl_context,
+                                                         1, 1));
+  offscreen = cogl_offscreen_new_with_texture (texture);
+  cogl_object_unref (texture);
+
+  if (!cogl_framebuffer_allocate (COGL_FRAMEBUFFER (offscreen), &error))
+    {
+      g_warning ("Failed to allocate pipeline prewarm framebuffer: %s",
+                 error->message);
+      return FALSE;
+    }
+
+  prewarm->framebuffer = COGL_FRAMEBUFFER (g_steal_pointer (&offscreen));
+  return TRUE;
+}
+
+static gboolean
+prewarm_next_entry (ClutterPipelinePrewarm *prewarm)
+{
+  while (prewarm->next_entry < prewarm->n_stored_entries)
+    {
+      ShapeEntry *entry = g_ptr_array_index (prewarm->entries,
+                                             prewarm->next_entry++);
+      ClutterPipelineShapeFunc func;
+      CoglPipeline *pipeline;
+
+      func = g_hash_table_lookup (prewarm->shape_funcs, entry->shape);
+      if (!func)
+        continue;
+
+      pipeline = func (prewarm->cogl_context, entry->variant);
+      if (!pipeline)
+        continue;
+
+      COGL_TRACE_BEGIN_SCOPED (ClutterPipelinePrewarmEntry,
+                               "Pipeline prewarm (entry)");
+      COGL_TRACE_DESCRIBE (ClutterPipelinePrewarmEntry, entry->shape);
+
+      /* Drawing the pipeline is what makes Cogl generate, compile and link
+       * the program; flushing makes sure it happens now. */
+      cogl_framebuffer_draw_rectangle (prewarm->framebuffer, pipeline,
+                                       -1, -1, 1, 1);
+      cogl_framebuffer_flush (prewarm->framebuffer);
+
+      cogl_object_unref (pipeline);
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+prewarm_idle_cb (gpointer user_data)
+{
+  ClutterPipelinePrewarm *prewarm = user_data;
+
+  if (prewarm_next_entry (prewarm))
+    return G_SOURCE_CONTINUE;
+
+  prewarm->idle_id = 0;
+  finish_prewarm (prewarm);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Creates and draws pipelines of the shapes stored by the previous session,
+ * one per main loop iteration.
+ */
+void
+clutter_pipeline_prewarm_start (ClutterPipelinePrewarm *prewarm)
+{
+  if (prewarm->idle_id || clutter_pipeline_prewarm_is_done (prewarm))
+    return;
+
+  if (!ensure_framebuffer (prewarm))
+    {
+      finish_prewarm (prewarm);
+      return;
+    }
+
+  prewarm->idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                      prewarm_idle_cb,
+                                      prewarm,
+                                      NULL);
+  g_source_set_name_by_id (prewarm->idle_id, "[mutter] Pipeline prewarm");
+}
+
+/*
+ * Synchronously creates and draws the remaining pipelines of the shapes
+ * stored by the previous session. Returns the number of pipelines drawn.
+ */
+int
+clutter_pipeline_prewarm_run (ClutterPipelinePrewarm *prewarm)
+{
+  int n_pipelines = 0;
+
+  COGL_TRACE_BEGIN_SCOPED (ClutterPipelinePrewarm, "Pipeline prewarm");
+
+  if (clutter_pipeline_prewarm_is_done (prewarm))
+    return 0;
+
+  if (!ensure_framebuffer (prewarm))
+    {
+      finish_prewarm (prewarm);
+      return 0;
+    }
+
+  while (prewarm_next_entry (prewarm))
+    n_pipelines++;
+
+  finish_prewarm (prewarm);
+
+  return n_pipelines;
+}
+
+gboolean
+clutter_pipeline_prewarm_is_done (ClutterPipelinePrewarm *prewarm)
+{
+  return prewarm->next_entry >= prewarm->n_stored_entries;
+}
+
+gboolean
+clutter_pipeline_prewarm_save (ClutterPipelinePrewarm  *prewarm,
+                               GError                 **error)
+{
+  g_autoptr (GString) contents = NULL;
+  g_autofree char *dir = NULL;
+  unsigned int i;
+
+  g_return_val_if_fail (prewarm->path, FALSE);
+
+  contents = g_string_new (NULL);
+
+  for (i = 0; i < prewarm->entries->len; i++)
+    {
+      ShapeEntry *entry = g_ptr_array_index (prewarm->entries, i);
+
+      /* Drop shapes nothing knows how to create anymore */
+      if (!g_hash_table_contains (prewarm->shape_funcs, entry->shape))
+        continue;
+
+      g_string_append_printf (contents, "%s:%s\n",
+                              entry->shape, entry->variant);
+    }
+
+  dir = g_path_get_dirname (prewarm->path);
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                   "Failed to create directory %s: %s",
+                   dir, g_strerror (errsv));
+      return FALSE;
+    }
+
+  if (!g_file_set_contents (prewarm->path,
+                            contents->str, contents->len,
+                            error))
+    return FALSE;
+
+  prewarm->is_dirty = FALSE;
+  return TRUE;
+}
+
+void
+clutter_pipeline_prewarm_set_default (ClutterPipelinePrewarm *prewarm)
+{
+  default_prewarm = prewarm;
+}
+
+ClutterPipelinePrewarm *
+clutter_pipeline_prewarm_get_default (void)
+{
+  return default_prewarm;
+}
+
+void
+clutter_pipeline_prewarm_record_default (const char *shape,
+                                         const char *variant)
+{
+  if (default_prewarm)
+    clutter_pipeline_prewarm_record (default_prewarm, shape, variant);
+}
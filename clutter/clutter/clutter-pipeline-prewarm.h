@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLUTTER_PIPELINE_PREWARM_H
+#define CLUTTER_PIPELINE_PREWARM_H
+
+#include <cogl/cogl.h>
+#include <glib.h>
+
+#include "clutter-macros.h"
+
+typedef struct _ClutterPipelinePrewarm ClutterPipelinePrewarm;
+
+/*
+ * Creates a pipeline of the given shape. Only the state affecting shader
+ * generation matters; textures can be left unset, and uniforms don't need to
+ * be initialized.
+ */
+typedef CoglPipeline * (* ClutterPipelineShapeFunc) (CoglContext *cogl_context,
+                                                     const char  *variant);
+
+CLUTTER_EXPORT
+ClutterPipelinePrewarm * clutter_pipeline_prewarm_new (CoglContext *cogl_context,
+                                                       const char  *path);
+
+CLUTTER_EXPORT
+void clutter_pipeline_prewarm_free (ClutterPipelinePrewarm *prewarm);
+
+CLUTTER_EXPORT
+void clutter_pipeline_prewarm_register_shape (ClutterPipelinePrewarm   *prewarm,
+                                              const char               *shape,
+                                              ClutterPipelineShapeFunc  func);
+
+CLUTTER_EXPORT
+void clutter_pipeline_prewarm_record (ClutterPipelinePrewarm *prewarm,
+                                      const char             *shape,
+                                      const char             *variant);
+
+CLUTTER_EXPORT
+void clutter_pipeline_prewarm_start (ClutterPipelinePrewarm *prewarm);
+
+CLUTTER_EXPORT
+int clutter_pipeline_prewarm_run (ClutterPipelinePrewarm *prewarm);
+
+CLUTTER_EXPORT
+gboolean clutter_pipeline_prewarm_is_done (ClutterPipelinePrewarm *prewarm);
+
+CLUTTER_EXPORT
+gboolean clutter_pipeline_prewarm_save (ClutterPipelinePrewarm  *prewarm,
+                                        GError                 **error);
+
+CLUTTER_EXPORT
+void clutter_pipeline_prewarm_set_default (ClutterPipelinePrewarm *prewarm);
+
+CLUTTER_EXPORT
+ClutterPipelinePrewarm * clutter_pipeline_prewarm_get_default (void);
+
+CLUTTER_EXPORT
+void clutter_pipeline_prewarm_record_default (const char *shape,
+                                              const char *variant);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ClutterPipelinePrewarm,
+                               clutter_pipeline_prewarm_free)
+
+#endif /* CLUTTER_PIPELINE_PREWARM_H */
@@ -22,8 +22,10 @@
 
 #include <cairo-gobject.h>
 #include <math.h>
+#include <stdlib.h>
 
 #include "clutter/clutter-damage-history.h"
+#include "clutter/clutter-damage-tiles.h"
 #include "clutter/clutter-frame-clock.h"
 #include "clutter/clutter-frame-private.h"
 #include "clutter/clutter-private.h"
@@ -69,6 +71,7 @@ typedef struct _ClutterStageViewPrivate
       CoglDmaBufHandle *handles[2];
       int current_idx;
       ClutterDamageHistory *damage_history;
+      ClutterDamageTiles *damage_tiles;
     } dma_buf;
 
     CoglOffscreen *framebuffer;
@@ -314,6 +317,26 @@ is_shadowfb_double_buffered (ClutterStageView *view)
   return priv->shadow.dma_buf.handles[0] && priv->shadow.dma_buf.handles[1];
 }
 
+static int
+get_shadowfb_tile_size (void)
+{
+  const char *tile_size_env;
+  int tile_size;
+
+  tile_size_env = g_getenv ("MUTTER_DEBUG_SHADOWFB_TILE_SIZE");
+  if (!tile_size_env)
+    return CLUTTER_DAMAGE_TILES_DEFAULT_TILE_SIZE;
+
+  tile_size = atoi (tile_size_env);
+  if (tile_size <= 0)
+    {
+      g_warning ("Invalid shadow fb tile size '%s'", tile_size_env);
+      return CLUTTER_DAMAGE_TILES_DEFAULT_TILE_SIZE;
+    }
+
+  return tile_size;
+}
+
 static gboolean
 init_dma_buf_shadowfbs (ClutterStageView  *view,
                         CoglContext       *cogl_context,
@@ -357,6 +380,9 @@ init_dma_buf_shadowfbs (ClutterStageView  *view,
     }
 
   priv->shadow.dma_buf.damage_history = clutter_damage_history_new ();
+  priv->shadow.dma_buf.damage_tiles =
+    clutter_damage_tiles_new (get_shadowfb_tile_size (),
+                              CLUTTER_DAMAGE_TILES_FLAG_NONE);
 
   initial_shadowfb =
     cogl_dma_buf_handle_get_framebuffer (priv->shadow.dma_buf.handles[0]);
@@ -486,26 +512,6 @@ clutter_stage_view_after_paint (ClutterStageView *view,
     }
 }
 
-static gboolean
-is_tile_dirty (cairo_rectangle_int_t *tile,
-               uint8_t               *current_data,
-               uint8_t               *prev_data,
-               int                    bpp,
-               int                    stride)
-{
-  int y;
-
-  for (y = tile->y; y < tile->y + tile->height; y++)
-    {
-      if (memcmp (prev_data + y * stride + tile->x * bpp,
-                  current_data + y * stride + tile->x * bpp,
-                  tile->width * bpp) != 0)
-        return TRUE;
-    }
-
-  return FALSE;
-}
-
 static int
 flip_dma_buf_idx (int idx)
 {
@@ -520,8 +526,6 @@ find_damaged_tiles (ClutterStageView      *view,
   ClutterStageViewPrivate *priv =
     clutter_stage_view_get_instance_private (view);
   cairo_region_t *tile_damage_region;
-  cairo_rectangle_int_t damage_extents;
-  cairo_rectangle_int_t fb_rect;
   int prev_dma_buf_idx;
   CoglDmaBufHandle *prev_dma_buf_handle;
   uint8_t *prev_data;
@@ -529,10 +533,6 @@ find_damaged_tiles (ClutterStageView      *view,
   CoglDmaBufHandle *current_dma_buf_handle;
   uint8_t *current_data;
   int width, height, stride, bpp;
-  int tile_x_min, tile_x_max;
-  int tile_y_min, tile_y_max;
-  int tile_x, tile_y;
-  const int tile_size = 16;
 
   prev_dma_buf_idx = flip_dma_buf_idx (priv->shadow.dma_buf.current_idx);
   prev_dma_buf_handle = priv->shadow.dma_buf.handles[prev_dma_buf_idx];
@@ -560,43 +560,17 @@ find_damaged_tiles (ClutterStageView      *view,
   if (!current_data)
     goto err_mmap_current;
 
-  fb_rect = (cairo_rectangle_int_t) {
-    .width = width,
-    .height = height,
-  };
+  COGL_TRACE_BEGIN (ClutterStageViewFindDamagedTiles,
+                    "Find damaged tiles");
 
-  cairo_region_get_extents (damage_region, &damage_extents);
+  tile_damage_region =
+    clutter_damage_tiles_find_changed (priv->shadow.dma_buf.damage_tiles,
+                                       current_data,
+                                       prev_data,
+                                       width, height, stride, bpp,
+                                       damage_region);
 
-  tile_x_min = damage_extents.x / tile_size;
-  tile_x_max = ((damage_extents.x + damage_extents.width + tile_size - 1) /
-                tile_size);
-  tile_y_min = damage_extents.y / tile_size;
-  tile_y_max = ((damage_extents.y + damage_extents.height + tile_size - 1) /
-                tile_size);
-
-  tile_damage_region = cairo_region_create ();
-
-  for (tile_y = tile_y_min; tile_y <= tile_y_max; tile_y++)
-    {
-      for (tile_x = tile_x_min; tile_x <= tile_x_max; tile_x++)
-        {
-          cairo_rectangle_int_t tile = {
-            .x = tile_x * tile_size,
-            .y = tile_y * tile_size,
-            .width = tile_size,
-            .height = tile_size,
-          };
-
-          if (cairo_region_contains_rectangle (damage_region, &tile) ==
-              CAIRO_REGION_OVERLAP_OUT)
-            continue;
-
-          _clutter_util_rectangle_intersection (&tile, &fb_rect, &tile);
-
-          if (is_tile_dirty (&tile, current_data, prev_data, bpp, stride))
-            cairo_region_union_rectangle (tile_damage_region, &tile);
-        }
-    }
+  COGL_TRACE_END (ClutterStageViewFindDamagedTiles);
 
   if (!cogl_dma_buf_handle_sync_read_end (prev_dma_buf_handle, error))
     {
@@ -615,8 +589,6 @@ find_damaged_tiles (ClutterStageView      *view,
   cogl_dma_buf_handle_munmap (prev_dma_buf_handle, prev_data, NULL);
   cogl_dma_buf_handle_munmap (current_dma_buf_handle, current_data, NULL);
 
-  cairo_region_intersect (tile_damage_region, damage_region);
-
   return tile_damage_region;
 
 err_mmap_current:
@@ -1068,6 +1040,37 @@ clutter_stage_view_get_frame_clock (ClutterStageView *view)
   return priv->frame_clock;
 }
 
+static int64_t
+get_redraw_clip_area (ClutterStageView *view)
+{
+  ClutterStageViewPrivate *priv =
+    clutter_stage_view_get_instance_private (view);
+  int64_t area = 0;
+
+  if (!priv->has_redraw_clip)
+    return 0;
+
+  if (!priv->redraw_clip)
+    {
+      area = (int64_t) priv->layout.width * priv->layout.height;
+    }
+  else
+    {
+      int n_rects, i;
+
+      n_rects = cairo_region_num_rectangles (priv->redraw_clip);
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_rectangle_int_t rect;
+
+          cairo_region_get_rectangle (priv->redraw_clip, i, &rect);
+          area += (int64_t) rect.width * rect.height;
+        }
+    }
+
+  return (int64_t) (area * priv->scale * priv->scale);
+}
+
 static void
 handle_frame_clock_before_frame (ClutterFrameClock *frame_clock,
                                  int64_t            frame_count,
@@ -1155,6 +1158,8 @@ handle_frame_clock_frame (ClutterFrameClock *frame_clock,
   ClutterStage *stage = priv->stage;
   ClutterStageWindow *stage_window = _clutter_stage_get_window (stage);
   g_autoptr (GSList) devices = NULL;
+  CoglOffscreenPool *offscreen_pool;
+  CoglContext *cogl_context;
   ClutterFrame frame;
 
   if (CLUTTER_ACTOR_IN_DESTRUCTION (stage))
@@ -1177,6 +1182,11 @@ handle_frame_clock_frame (ClutterFrameClock *frame_clock,
 
   clutter_stage_finish_layout (stage);
 
+  clutter_frame_clock_record_layout_time (frame_clock,
+                                          g_get_monotonic_time ());
+  clutter_frame_clock_record_damage_area (frame_clock,
+                                          get_redraw_clip_area (view));
+
   if (priv->needs_update_devices)
     devices = clutter_stage_find_updated_devices (stage, view);
 
@@ -1191,6 +1201,12 @@ handle_frame_clock_frame (ClutterFrameClock *frame_clock,
 
       _clutter_stage_window_redraw_view (stage_window, view, &frame);
 
+      /* The view has been flushed, so nothing can still be sampling from
+       * the offscreen framebuffers released while painting it. */
+      cogl_context = cogl_framebuffer_get_context (priv->framebuffer);
+      offscreen_pool = cogl_context_get_offscreen_pool (cogl_context);
+      cogl_offscreen_pool_end_frame (offscreen_pool);
+
       clutter_frame_clock_record_flip_time (frame_clock,
                                             g_get_monotonic_time ());
 
@@ -1211,9 +1227,19 @@ handle_frame_clock_frame (ClutterFrameClock *frame_clock,
   return clutter_frame_get_result (&frame);
 }
 
+static int64_t
+handle_frame_clock_get_pending_damage_area (ClutterFrameClock *frame_clock,
+                                            gpointer           user_data)
+{
+  ClutterStageView *view = user_data;
+
+  return get_redraw_clip_area (view);
+}
+
 static const ClutterFrameListenerIface frame_clock_listener_iface = {
   .before_frame = handle_frame_clock_before_frame,
   .frame = handle_frame_clock_frame,
+  .get_pending_damage_area = handle_frame_clock_get_pending_damage_area,
 };
 
 void
@@ -1396,6 +1422,8 @@ clutter_stage_view_dispose (GObject *object)
     }
   g_clear_pointer (&priv->shadow.dma_buf.damage_history,
                    clutter_damage_history_free);
+  g_clear_pointer (&priv->shadow.dma_buf.damage_tiles,
+                   clutter_damage_tiles_free);
 
   g_clear_object (&priv->offscreen);
   g_clear_pointer (&priv->offscreen_pipeline, cogl_object_unref);
@@ -132,6 +132,10 @@ struct _ClutterStagePrivate
   GHashTable *pointer_devices;
   GHashTable *touch_sequences;
 
+  /* Pick stacks of the whole scene, indexed by pick mode, reused for any
+   * point until something that may affect picking changes */
+  ClutterPickStack *pick_stacks[CLUTTER_PICK_ALL + 1];
+
   guint actor_needs_immediate_relayout : 1;
 };
 
@@ -762,6 +766,8 @@ clutter_stage_queue_actor_relayout (ClutterStage *stage,
 {
   ClutterStagePrivate *priv = stage->priv;
 
+  clutter_stage_invalidate_pick (stage);
+
   if (priv->pending_relayouts == NULL)
     clutter_stage_schedule_update (stage);
 
@@ -851,7 +857,10 @@ clutter_stage_maybe_relayout (ClutterActor *actor)
   CLUTTER_NOTE (ACTOR, "<<< Completed recomputing layout of %d subtrees", count);
 
   if (count)
-    clutter_stage_invalidate_views_devices (stage);
+    {
+      clutter_stage_invalidate_pick (stage);
+      clutter_stage_invalidate_views_devices (stage);
+    }
 }
 
 GSList *
@@ -1014,6 +1023,51 @@ setup_ray_for_coordinates (ClutterStage       *stage,
   graphene_point3d_init_from_point (point, &p);
 }
 
+/**
+ * clutter_stage_invalidate_pick: (skip)
+ * @stage: a #ClutterStage
+ *
+ * Drops the pick stacks retained by @stage, so that the next pick traverses
+ * the scene again. Queueing a redraw doesn't do this; actors changing what
+ * they pick without a change of transformation, allocation, clip, visibility,
+ * reactivity or effects must call this.
+ */
+void
+clutter_stage_invalidate_pick (ClutterStage *stage)
+{
+  ClutterStagePrivate *priv = stage->priv;
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (priv->pick_stacks); i++)
+    g_clear_pointer (&priv->pick_stacks[i], clutter_pick_stack_unref);
+}
+
+static ClutterPickStack *
+get_retained_pick_stack (ClutterStage     *stage,
+                         ClutterPickMode   mode,
+                         ClutterStageView *view)
+{
+  ClutterStagePrivate *priv = stage->priv;
+  ClutterPickContext *pick_context;
+
+  if (!priv->pick_stacks[mode])
+    {
+      COGL_TRACE_BEGIN_SCOPED (ClutterStageBuildPickIndex,
+                               "Build pick index");
+
+      pick_context = clutter_pick_context_new_for_view (view, mode,
+                                                        NULL, NULL);
+
+      clutter_actor_pick (CLUTTER_ACTOR (stage), pick_context);
+      priv->pick_stacks[mode] = clutter_pick_context_steal_stack (pick_context);
+      clutter_pick_context_destroy (pick_context);
+
+      clutter_pick_stack_build_index (priv->pick_stacks[mode]);
+    }
+
+  return clutter_pick_stack_ref (priv->pick_stacks[mode]);
+}
+
 static ClutterActor *
 _clutter_stage_do_pick_on_view (ClutterStage      *stage,
                                 float              x,
@@ -1032,11 +1086,19 @@ _clutter_stage_do_pick_on_view (ClutterStage      *stage,
 
   setup_ray_for_coordinates (stage, x, y, &p, &ray);
 
-  pick_context = clutter_pick_context_new_for_view (view, mode, &p, &ray);
+  if (G_LIKELY (!(clutter_pick_debug_flags &
+                  CLUTTER_DEBUG_DISABLE_PICK_INDEX)))
+    {
+      pick_stack = get_retained_pick_stack (stage, mode, view);
+    }
+  else
+    {
+      pick_context = clutter_pick_context_new_for_view (view, mode, &p, &ray);
 
-  clutter_actor_pick (CLUTTER_ACTOR (stage), pick_context);
-  pick_stack = clutter_pick_context_steal_stack (pick_context);
-  clutter_pick_context_destroy (pick_context);
+      clutter_actor_pick (CLUTTER_ACTOR (stage), pick_context);
+      pick_stack = clutter_pick_context_steal_stack (pick_context);
+      clutter_pick_context_destroy (pick_context);
+    }
 
   actor = clutter_pick_stack_search_actor (pick_stack, &p, &ray, clear_area);
   return actor ? actor : CLUTTER_ACTOR (stage);
@@ -1204,6 +1266,8 @@ clutter_stage_dispose (GObject *object)
 
   clutter_actor_destroy_all_children (CLUTTER_ACTOR (object));
 
+  clutter_stage_invalidate_pick (stage);
+
   g_hash_table_remove_all (priv->pending_queue_redraws);
 
   g_slist_free_full (priv->pending_relayouts,
@@ -2348,6 +2412,7 @@ clutter_stage_update_view_perspective (ClutterStage *stage)
                           priv->viewport[2],
                           priv->viewport[3]);
 
+  clutter_stage_invalidate_pick (stage);
   clutter_actor_invalidate_transform (CLUTTER_ACTOR (stage));
 }
 
@@ -3187,6 +3252,8 @@ clutter_stage_invalidate_focus (ClutterStage *self,
 
   g_assert (!clutter_actor_is_mapped (actor) || !clutter_actor_get_reactive (actor));
 
+  clutter_stage_invalidate_pick (self);
+
   g_hash_table_iter_init (&iter, priv->pointer_devices);
   while (g_hash_table_iter_next (&iter, NULL, &value))
     {
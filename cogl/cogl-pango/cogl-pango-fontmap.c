@@ -151,6 +151,16 @@ cogl_pango_font_map_clear_glyph_cache (CoglPangoFontMap *fm)
   _cogl_pango_renderer_clear_glyph_cache (COGL_PANGO_RENDERER (renderer));
 }
 
+void
+cogl_pango_font_map_get_glyph_cache_stats (CoglPangoFontMap         *fm,
+                                           CoglPangoGlyphCacheStats *stats)
+{
+  PangoRenderer *renderer = _cogl_pango_font_map_get_renderer (fm);
+
+  _cogl_pango_renderer_get_glyph_cache_stats (COGL_PANGO_RENDERER (renderer),
+                                              stats);
+}
+
 void
 cogl_pango_font_map_set_use_mipmapping (CoglPangoFontMap *fm,
                                         gboolean          value)
@@ -26,16 +26,52 @@
  * SOFTWARE.
  */
 
+
 #include "cogl-config.h"
 
 #include <glib.h>
+#include <pango/pangocairo.h>
+#include <cairo.h>
+#include <cairo-ft.h>
 
 #include "cogl-pango-glyph-cache.h"
 #include "cogl-pango-private.h"
-#include "cogl/cogl-atlas.h"
-#include "cogl/cogl-atlas-texture-private.h"
+#include "cogl/cogl-debug.h"
+#include "cogl/cogl-rectangle-map.h"
+#include "cogl/cogl-texture-2d.h"
+
+/* Size of the pages the glyphs are stored in. Glyphs that don't fit
+   in a page get a bigger page of their own */
+#define PAGE_SIZE 1024
+
+/* Number of pages after which the least recently used page is
+   evicted to make room for new glyphs */
+#define MAX_PAGES 8
+
+/* Space left between glyphs so that linear filtering doesn't pick up
+   the neighbouring glyphs */
+#define GLYPH_PADDING 1
 
 typedef struct _CoglPangoGlyphCacheKey     CoglPangoGlyphCacheKey;
+typedef struct _CoglPangoGlyphCacheDirtyGlyph CoglPangoGlyphCacheDirtyGlyph;
+
+struct _CoglPangoGlyphCachePage
+{
+  CoglTexture *texture;
+  CoglPixelFormat format;
+  gboolean has_color;
+
+  /* Free space of the page. Glyphs are never removed from a page on
+     their own; the whole page is dropped when it's evicted */
+  CoglRectangleMap *rectangle_map;
+
+  /* Glyphs added to the page that still need to be rasterized and
+     uploaded, as an array of CoglPangoGlyphCacheDirtyGlyph */
+  GArray *dirty_glyphs;
+
+  /* Generation of the cache when a glyph of this page was last used */
+  unsigned int last_used;
+};
 
 struct _CoglPangoGlyphCache
 {
@@ -45,25 +81,27 @@ struct _CoglPangoGlyphCache
      particular font is already cached */
   GHashTable       *hash_table;
 
-  /* List of CoglAtlases */
-  GSList           *atlases;
+  /* List of CoglPangoGlyphCachePages */
+  GList            *pages;
 
-  /* List of callbacks to invoke when an atlas is reorganized */
+  /* List of callbacks to invoke when glyphs are evicted */
   GHookList         reorganize_callbacks;
 
-  /* TRUE if we've ever stored a texture in the global atlas. This is
-     used to make sure we only register one callback to listen for
-     global atlas reorganizations */
-  gboolean          using_global_atlas;
-
   /* True if some of the glyphs are dirty. This is used as an
      optimization in _cogl_pango_glyph_cache_set_dirty_glyphs to avoid
      iterating the hash table if we know none of them are dirty */
   gboolean          has_dirty_glyphs;
 
-  /* Whether mipmapping is being used for this cache. This only
-     affects whether we decide to put the glyph in the global atlas */
-  gboolean          use_mipmapping;
+  /* Incremented every time the dirty glyphs are set, i.e. whenever a
+     layout has been prepared. Pages used by the current generation
+     are never evicted, since that would drop glyphs the layout
+     being prepared still needs */
+  unsigned int      generation;
+
+  uint64_t          n_evicted_pages;
+  uint64_t          n_evicted_glyphs;
+  uint64_t          n_uploads;
+  uint64_t          uploaded_bytes;
 };
 
 struct _CoglPangoGlyphCacheKey
@@ -72,6 +110,18 @@ struct _CoglPangoGlyphCacheKey
   PangoGlyph  glyph;
 };
 
+struct _CoglPangoGlyphCacheDirtyGlyph
+{
+  /* Owned by the hash table, which only drops them together with
+     their page */
+  CoglPangoGlyphCacheKey *key;
+  CoglPangoGlyphCacheValue *value;
+
+  /* Where the glyph is rasterized in the staging surface */
+  int staging_x;
+  int staging_y;
+};
+
 static void
 cogl_pango_glyph_cache_value_free (CoglPangoGlyphCacheValue *value)
 {
@@ -116,12 +166,11 @@ cogl_pango_glyph_cache_equal_func (const void *a, const void *b)
 }
 
 CoglPangoGlyphCache *
-cogl_pango_glyph_cache_new (CoglContext *ctx,
-                            gboolean use_mipmapping)
+cogl_pango_glyph_cache_new (CoglContext *ctx)
 {
   CoglPangoGlyphCache *cache;
 
-  cache = g_malloc (sizeof (CoglPangoGlyphCache));
+  cache = g_new0 (CoglPangoGlyphCache, 1);
 
   /* Note: as a rule we don't take references to a CoglContext
    * internally since */
@@ -133,47 +182,104 @@ cogl_pango_glyph_cache_new (CoglContext *ctx,
      (GDestroyNotify) cogl_pango_glyph_cache_key_free,
      (GDestroyNotify) cogl_pango_glyph_cache_value_free);
 
-  cache->atlases = NULL;
+  cache->pages = NULL;
   g_hook_list_init (&cache->reorganize_callbacks, sizeof (GHook));
 
   cache->has_dirty_glyphs = FALSE;
 
-  cache->using_global_atlas = FALSE;
-
-  cache->use_mipmapping = use_mipmapping;
-
   return cache;
 }
 
 static void
-cogl_pango_glyph_cache_reorganize_cb (void *user_data)
+cogl_pango_glyph_cache_page_free (CoglPangoGlyphCachePage *page)
 {
-  CoglPangoGlyphCache *cache = user_data;
+  g_array_unref (page->dirty_glyphs);
+  _cogl_rectangle_map_free (page->rectangle_map);
+  cogl_object_unref (page->texture);
+  g_free (page);
+}
 
-  g_hook_list_invoke (&cache->reorganize_callbacks, FALSE);
+static CoglPangoGlyphCachePage *
+cogl_pango_glyph_cache_page_new (CoglPangoGlyphCache *cache,
+                                 int width,
+                                 int height,
+                                 gboolean has_color)
+{
+  CoglPangoGlyphCachePage *page;
+  CoglPixelFormat format_cogl;
+  CoglTexture2D *texture;
+  GError *ignore_error = NULL;
+
+  if (has_color)
+    {
+      /* Cairo stores the data in native byte order as ARGB but Cogl's
+         pixel formats specify the actual byte order. Therefore we
+         need to use a different format depending on the
+         architecture */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+      format_cogl = COGL_PIXEL_FORMAT_BGRA_8888_PRE;
+#else
+      format_cogl = COGL_PIXEL_FORMAT_ARGB_8888_PRE;
+#endif
+    }
+  else
+    {
+      format_cogl = COGL_PIXEL_FORMAT_A_8;
+    }
+
+  /* The texture contents are left undefined. Only the areas covered
+     by glyphs and their padding are ever sampled, and those are
+     always uploaded before they are used */
+  texture = cogl_texture_2d_new_with_size (cache->ctx, width, height);
+  cogl_texture_set_components (COGL_TEXTURE (texture),
+                               has_color ?
+                               COGL_TEXTURE_COMPONENTS_RGBA :
+                               COGL_TEXTURE_COMPONENTS_A);
+  if (!cogl_texture_allocate (COGL_TEXTURE (texture), &ignore_error))
+    {
+      g_error_free (ignore_error);
+      cogl_object_unref (texture);
+      return NULL;
+    }
+
+  page = g_new0 (CoglPangoGlyphCachePage, 1);
+  page->texture = COGL_TEXTURE (texture);
+  page->format = format_cogl;
+  page->has_color = has_color;
+  page->rectangle_map = _cogl_rectangle_map_new (width, height, NULL);
+  page->dirty_glyphs =
+    g_array_new (FALSE, FALSE, sizeof (CoglPangoGlyphCacheDirtyGlyph));
+  page->last_used = cache->generation;
+
+  COGL_NOTE (PANGO, "Created %dx%d glyph cache page %p%s",
+             width, height, page, has_color ? " for color glyphs" : "");
+
+  return page;
+}
+
+static size_t
+cogl_pango_glyph_cache_page_get_size (CoglPangoGlyphCachePage *page)
+{
+  return (size_t) cogl_texture_get_width (page->texture) *
+         cogl_texture_get_height (page->texture) *
+         cogl_pixel_format_get_bytes_per_pixel (page->format, 0);
 }
 
 void
 cogl_pango_glyph_cache_clear (CoglPangoGlyphCache *cache)
 {
-  g_slist_foreach (cache->atlases, (GFunc) cogl_object_unref, NULL);
-  g_slist_free (cache->atlases);
-  cache->atlases = NULL;
   cache->has_dirty_glyphs = FALSE;
 
   g_hash_table_remove_all (cache->hash_table);
+
+  g_list_free_full (cache->pages,
+                    (GDestroyNotify) cogl_pango_glyph_cache_page_free);
+  cache->pages = NULL;
 }
 
 void
 cogl_pango_glyph_cache_free (CoglPangoGlyphCache *cache)
 {
-  if (cache->using_global_atlas)
-    {
-      _cogl_atlas_texture_remove_reorganize_callback (
-                                  cache->ctx,
-                                  cogl_pango_glyph_cache_reorganize_cb, cache);
-    }
-
   cogl_pango_glyph_cache_clear (cache);
 
   g_hash_table_unref (cache->hash_table);
@@ -183,128 +289,155 @@ cogl_pango_glyph_cache_free (CoglPangoGlyphCache *cache)
   g_free (cache);
 }
 
+static gboolean
+cogl_pango_glyph_cache_value_in_page (void *key,
+                                      void *value,
+                                      void *user_data)
+{
+  CoglPangoGlyphCacheValue *cache_value = value;
+
+  return cache_value->page == user_data;
+}
+
 static void
-cogl_pango_glyph_cache_update_position_cb (void *user_data,
-                                           CoglTexture *new_texture,
-                                           const CoglRectangleMapEntry *rect)
+cogl_pango_glyph_cache_evict_page (CoglPangoGlyphCache *cache,
+                                   CoglPangoGlyphCachePage *page)
 {
-  CoglPangoGlyphCacheValue *value = user_data;
-  float tex_width, tex_height;
+  unsigned int n_glyphs;
 
-  if (value->texture)
-    cogl_object_unref (value->texture);
-  value->texture = cogl_object_ref (new_texture);
+  n_glyphs = g_hash_table_foreach_remove (cache->hash_table,
+                                          cogl_pango_glyph_cache_value_in_page,
+                                          page);
 
-  tex_width = cogl_texture_get_width (new_texture);
-  tex_height = cogl_texture_get_height (new_texture);
+  COGL_NOTE (PANGO, "Evicting glyph cache page %p with %u glyphs, "
+             "last used %u generations ago",
+             page, n_glyphs, cache->generation - page->last_used);
 
-  value->tx1 = rect->x / tex_width;
-  value->ty1 = rect->y / tex_height;
-  value->tx2 = (rect->x + value->draw_width) / tex_width;
-  value->ty2 = (rect->y + value->draw_height) / tex_height;
+  /* Rendering that is already queued keeps its own reference on the
+     texture, so dropping the page doesn't affect it */
+  cache->pages = g_list_remove (cache->pages, page);
+  cogl_pango_glyph_cache_page_free (page);
 
-  value->tx_pixel = rect->x;
-  value->ty_pixel = rect->y;
+  cache->n_evicted_pages++;
+  cache->n_evicted_glyphs += n_glyphs;
 
-  /* The glyph has changed position so it will need to be redrawn */
-  value->dirty = TRUE;
+  /* Any display list using the evicted glyphs has to be rebuilt */
+  g_hook_list_invoke (&cache->reorganize_callbacks, FALSE);
 }
 
-static gboolean
-cogl_pango_glyph_cache_add_to_global_atlas (CoglPangoGlyphCache *cache,
-                                            PangoFont *font,
-                                            PangoGlyph glyph,
-                                            CoglPangoGlyphCacheValue *value)
+static CoglPangoGlyphCachePage *
+cogl_pango_glyph_cache_find_evictable_page (CoglPangoGlyphCache *cache)
 {
-  CoglAtlasTexture *texture;
-  GError *ignore_error = NULL;
+  CoglPangoGlyphCachePage *lru_page = NULL;
+  GList *l;
 
-  if (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_SHARED_ATLAS))
-    return FALSE;
+  for (l = cache->pages; l; l = l->next)
+    {
+      CoglPangoGlyphCachePage *page = l->data;
 
-  /* If the cache is using mipmapping then we can't use the global
-     atlas because it would just get migrated back out */
-  if (cache->use_mipmapping)
-    return FALSE;
+      if (page->last_used == cache->generation)
+        continue;
 
-  texture = cogl_atlas_texture_new_with_size (cache->ctx,
-                                              value->draw_width,
-                                              value->draw_height);
-  if (!cogl_texture_allocate (COGL_TEXTURE (texture), &ignore_error))
+      if (!lru_page ||
+          cache->generation - page->last_used >
+          cache->generation - lru_page->last_used)
+        lru_page = page;
+    }
+
+  return lru_page;
+}
+
+static gboolean
+cogl_pango_glyph_cache_add_to_page (CoglPangoGlyphCache *cache,
+                                    CoglPangoGlyphCacheValue *value)
+{
+  CoglPangoGlyphCachePage *page = NULL;
+  CoglRectangleMapEntry rect;
+  int width = value->draw_width + GLYPH_PADDING;
+  int height = value->draw_height + GLYPH_PADDING;
+  GList *l;
+
+  /* Look for a page that can store the glyph */
+  for (l = cache->pages; l; l = l->next)
     {
-      g_error_free (ignore_error);
-      return FALSE;
+      CoglPangoGlyphCachePage *candidate = l->data;
+
+      if (candidate->has_color == value->has_color &&
+          _cogl_rectangle_map_add (candidate->rectangle_map,
+                                   width, height,
+                                   value,
+                                   &rect))
+        {
+          page = candidate;
+          break;
+        }
     }
 
-  value->texture = COGL_TEXTURE (texture);
-  value->tx1 = 0;
-  value->ty1 = 0;
-  value->tx2 = 1;
-  value->ty2 = 1;
-  value->tx_pixel = 0;
-  value->ty_pixel = 0;
-
-  /* The first time we store a texture in the global atlas we'll
-     register for notifications when the global atlas is reorganized
-     so we can forward the notification on as a glyph
-     reorganization */
-  if (!cache->using_global_atlas)
+  /* If we couldn't find one then start a new page, making room for it
+     first if needed. If all the pages are used by the layout being
+     prepared, we go over the limit rather than evicting glyphs it
+     needs */
+  if (page == NULL)
     {
-      _cogl_atlas_texture_add_reorganize_callback
-        (cache->ctx,
-         cogl_pango_glyph_cache_reorganize_cb, cache);
-      cache->using_global_atlas = TRUE;
+      if (g_list_length (cache->pages) >= MAX_PAGES)
+        {
+          CoglPangoGlyphCachePage *lru_page;
+
+          lru_page = cogl_pango_glyph_cache_find_evictable_page (cache);
+          if (lru_page)
+            cogl_pango_glyph_cache_evict_page (cache, lru_page);
+        }
+
+      page = cogl_pango_glyph_cache_page_new (cache,
+                                              MAX (width, PAGE_SIZE),
+                                              MAX (height, PAGE_SIZE),
+                                              value->has_color);
+      if (!page)
+        return FALSE;
+
+      cache->pages = g_list_prepend (cache->pages, page);
+
+      /* If we still can't reserve space then something has gone
+         seriously wrong so we'll just give up */
+      if (!_cogl_rectangle_map_add (page->rectangle_map,
+                                    width, height,
+                                    value,
+                                    &rect))
+        return FALSE;
     }
 
+  value->page = page;
+  value->texture = cogl_object_ref (page->texture);
+
+  value->tx1 = rect.x / (float) cogl_texture_get_width (page->texture);
+  value->ty1 = rect.y / (float) cogl_texture_get_height (page->texture);
+  value->tx2 = ((rect.x + value->draw_width) /
+                (float) cogl_texture_get_width (page->texture));
+  value->ty2 = ((rect.y + value->draw_height) /
+                (float) cogl_texture_get_height (page->texture));
+
+  value->tx_pixel = rect.x;
+  value->ty_pixel = rect.y;
+
   return TRUE;
 }
 
 static gboolean
-cogl_pango_glyph_cache_add_to_local_atlas (CoglPangoGlyphCache *cache,
-                                           PangoFont *font,
-                                           PangoGlyph glyph,
-                                           CoglPangoGlyphCacheValue *value)
+font_has_color_glyphs (PangoFont *font)
 {
-  CoglAtlas *atlas = NULL;
-  GSList *l;
-
-  /* Look for an atlas that can reserve the space */
-  for (l = cache->atlases; l; l = l->next)
-    if (_cogl_atlas_reserve_space (l->data,
-                                   value->draw_width + 1,
-                                   value->draw_height + 1,
-                                   value))
-      {
-        atlas = l->data;
-        break;
-      }
-
-  /* If we couldn't find one then start a new atlas */
-  if (atlas == NULL)
-    {
-      atlas = _cogl_atlas_new (COGL_PIXEL_FORMAT_A_8,
-                               COGL_ATLAS_CLEAR_TEXTURE |
-                               COGL_ATLAS_DISABLE_MIGRATION,
-                               cogl_pango_glyph_cache_update_position_cb);
-      COGL_NOTE (ATLAS, "Created new atlas for glyphs: %p", atlas);
-      /* If we still can't reserve space then something has gone
-         seriously wrong so we'll just give up */
-      if (!_cogl_atlas_reserve_space (atlas,
-                                      value->draw_width + 1,
-                                      value->draw_height + 1,
-                                      value))
-        {
-          cogl_object_unref (atlas);
-          return FALSE;
-        }
+  cairo_scaled_font_t *scaled_font;
+  gboolean has_color = FALSE;
 
-      _cogl_atlas_add_reorganize_callback
-        (atlas, cogl_pango_glyph_cache_reorganize_cb, NULL, cache);
+  scaled_font = pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (font));
 
-      cache->atlases = g_slist_prepend (cache->atlases, atlas);
+  if (cairo_scaled_font_get_type (scaled_font) == CAIRO_FONT_TYPE_FT)
+    {
+      FT_Face ft_face = cairo_ft_scaled_font_lock_face (scaled_font);
+      has_color = (FT_HAS_COLOR (ft_face) != 0);
+      cairo_ft_scaled_font_unlock_face (scaled_font);
     }
 
-  return TRUE;
+  return has_color;
 }
 
 CoglPangoGlyphCacheValue *
@@ -343,16 +476,9 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
         value->dirty = FALSE;
       else
         {
-          /* Try adding the glyph to the global atlas... */
-          if (!cogl_pango_glyph_cache_add_to_global_atlas (cache,
-                                                           font,
-                                                           glyph,
-                                                           value) &&
-              /* If it fails try the local atlas */
-              !cogl_pango_glyph_cache_add_to_local_atlas (cache,
-                                                          font,
-                                                          glyph,
-                                                          value))
+          value->has_color = font_has_color_glyphs (font);
+
+          if (!cogl_pango_glyph_cache_add_to_page (cache, value))
             {
               cogl_pango_glyph_cache_value_free (value);
               return NULL;
@@ -367,44 +493,216 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
       key->glyph = glyph;
 
       g_hash_table_insert (cache->hash_table, key, value);
+
+      if (value->dirty)
+        {
+          CoglPangoGlyphCacheDirtyGlyph dirty_glyph = { 0 };
+
+          dirty_glyph.key = key;
+          dirty_glyph.value = value;
+          g_array_append_val (value->page->dirty_glyphs, dirty_glyph);
+        }
     }
 
+  if (value && value->page)
+    value->page->last_used = cache->generation;
+
   return value;
 }
 
 static void
-_cogl_pango_glyph_cache_set_dirty_glyphs_cb (void *key_ptr,
-                                             void *value_ptr,
-                                             void *user_data)
+cogl_pango_glyph_cache_draw_glyph (cairo_t *cr,
+                                   CoglPangoGlyphCacheDirtyGlyph *dirty_glyph)
+{
+  CoglPangoGlyphCacheValue *value = dirty_glyph->value;
+  cairo_scaled_font_t *scaled_font;
+  cairo_glyph_t cairo_glyph;
+  int x = dirty_glyph->staging_x;
+  int y = dirty_glyph->staging_y;
+
+  COGL_NOTE (PANGO, "redrawing glyph %i", dirty_glyph->key->glyph);
+
+  cairo_save (cr);
+
+  /* Keep whatever the glyph draws outside of its ink rectangle from
+     landing on the neighbouring glyphs */
+  cairo_rectangle (cr, x, y, value->draw_width, value->draw_height);
+  cairo_clip (cr);
+
+  scaled_font =
+    pango_cairo_font_get_scaled_font (PANGO_CAIRO_FONT (dirty_glyph->key->font));
+  cairo_set_scaled_font (cr, scaled_font);
+
+  cairo_glyph.x = x - value->draw_x;
+  cairo_glyph.y = y - value->draw_y;
+  /* The PangoCairo glyph numbers directly map to Cairo glyph
+     numbers */
+  cairo_glyph.index = dirty_glyph->key->glyph;
+  cairo_show_glyphs (cr, &cairo_glyph, 1);
+
+  cairo_restore (cr);
+}
+
+/* Packs the dirty glyphs of a page, including their padding, into rows
+   of a staging surface no wider than the page, and returns its size */
+static void
+cogl_pango_glyph_cache_page_pack_dirty_glyphs (CoglPangoGlyphCachePage *page,
+                                               int *staging_width,
+                                               int *staging_height)
+{
+  int max_width = cogl_texture_get_width (page->texture);
+  int row_x = 0, row_y = 0, row_height = 0;
+  int width = 0;
+  unsigned int i;
+
+  for (i = 0; i < page->dirty_glyphs->len; i++)
+    {
+      CoglPangoGlyphCacheDirtyGlyph *dirty_glyph =
+        &g_array_index (page->dirty_glyphs, CoglPangoGlyphCacheDirtyGlyph, i);
+      int glyph_width = dirty_glyph->value->draw_width + GLYPH_PADDING;
+      int glyph_height = dirty_glyph->value->draw_height + GLYPH_PADDING;
+
+      if (row_x > 0 && row_x + glyph_width > max_width)
+        {
+          row_x = 0;
+          row_y += row_height;
+          row_height = 0;
+        }
+
+      dirty_glyph->staging_x = row_x;
+      dirty_glyph->staging_y = row_y;
+
+      row_x += glyph_width;
+      row_height = MAX (row_height, glyph_height);
+      width = MAX (width, row_x);
+    }
+
+  *staging_width = width;
+  *staging_height = row_y + row_height;
+}
+
+static void
+cogl_pango_glyph_cache_page_upload_dirty_glyphs (CoglPangoGlyphCache *cache,
+                                                 CoglPangoGlyphCachePage *page)
 {
-  CoglPangoGlyphCacheKey *key = key_ptr;
-  CoglPangoGlyphCacheValue *value = value_ptr;
-  CoglPangoGlyphCacheDirtyFunc func = user_data;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  int width, height;
+  int bpp = cogl_pixel_format_get_bytes_per_pixel (page->format, 0);
+  unsigned int i;
+
+  if (page->dirty_glyphs->len == 0)
+    return;
+
+  cogl_pango_glyph_cache_page_pack_dirty_glyphs (page, &width, &height);
+
+  /* Only the new glyphs are rasterized, packed together so that the
+     staging surface stays small no matter where the glyphs landed in
+     the page. Image surfaces are cleared on creation, which also
+     clears the padding around the glyphs */
+  surface = cairo_image_surface_create (page->has_color ?
+                                        CAIRO_FORMAT_ARGB32 :
+                                        CAIRO_FORMAT_A8,
+                                        width, height);
+  cr = cairo_create (surface);
+  cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 1.0);
+
+  for (i = 0; i < page->dirty_glyphs->len; i++)
+    {
+      cogl_pango_glyph_cache_draw_glyph (cr,
+                                         &g_array_index (page->dirty_glyphs,
+                                                         CoglPangoGlyphCacheDirtyGlyph,
+                                                         i));
+    }
+
+  cairo_destroy (cr);
+  cairo_surface_flush (surface);
 
-  if (value->dirty)
+  if (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS)
     {
-      func (key->font, key->glyph, value);
+      int stride = cairo_image_surface_get_stride (surface);
+      uint8_t *data = cairo_image_surface_get_data (surface);
 
-      value->dirty = FALSE;
+      /* Copy each glyph to its own spot in the page */
+      for (i = 0; i < page->dirty_glyphs->len; i++)
+        {
+          CoglPangoGlyphCacheDirtyGlyph *dirty_glyph =
+            &g_array_index (page->dirty_glyphs,
+                            CoglPangoGlyphCacheDirtyGlyph,
+                            i);
+          CoglPangoGlyphCacheValue *value = dirty_glyph->value;
+          int glyph_width = value->draw_width + GLYPH_PADDING;
+          int glyph_height = value->draw_height + GLYPH_PADDING;
+
+          cogl_texture_set_region (page->texture,
+                                   dirty_glyph->staging_x, /* src_x */
+                                   dirty_glyph->staging_y, /* src_y */
+                                   value->tx_pixel, /* dst_x */
+                                   value->ty_pixel, /* dst_y */
+                                   glyph_width, /* dst_width */
+                                   glyph_height, /* dst_height */
+                                   width,
+                                   height,
+                                   page->format,
+                                   stride,
+                                   data);
+
+          cache->n_uploads++;
+          cache->uploaded_bytes += (uint64_t) glyph_width * glyph_height * bpp;
+        }
     }
+
+  cairo_surface_destroy (surface);
+
+  for (i = 0; i < page->dirty_glyphs->len; i++)
+    {
+      g_array_index (page->dirty_glyphs,
+                     CoglPangoGlyphCacheDirtyGlyph,
+                     i).value->dirty = FALSE;
+    }
+  g_array_set_size (page->dirty_glyphs, 0);
 }
 
 void
-_cogl_pango_glyph_cache_set_dirty_glyphs (CoglPangoGlyphCache *cache,
-                                          CoglPangoGlyphCacheDirtyFunc func)
+_cogl_pango_glyph_cache_set_dirty_glyphs (CoglPangoGlyphCache *cache)
 {
+  GList *l;
+
+  cache->generation++;
+
   /* If we know that there are no dirty glyphs then we can shortcut
      out early */
   if (!cache->has_dirty_glyphs)
     return;
 
-  g_hash_table_foreach (cache->hash_table,
-                        _cogl_pango_glyph_cache_set_dirty_glyphs_cb,
-                        func);
+  for (l = cache->pages; l; l = l->next)
+    cogl_pango_glyph_cache_page_upload_dirty_glyphs (cache, l->data);
 
   cache->has_dirty_glyphs = FALSE;
 }
 
+void
+cogl_pango_glyph_cache_get_stats (CoglPangoGlyphCache      *cache,
+                                  CoglPangoGlyphCacheStats *stats)
+{
+  GList *l;
+
+  stats->n_pages = 0;
+  stats->page_bytes = 0;
+
+  for (l = cache->pages; l; l = l->next)
+    {
+      stats->n_pages++;
+      stats->page_bytes += cogl_pango_glyph_cache_page_get_size (l->data);
+    }
+
+  stats->n_glyphs = g_hash_table_size (cache->hash_table);
+  stats->n_evicted_pages = cache->n_evicted_pages;
+  stats->n_evicted_glyphs = cache->n_evicted_glyphs;
+  stats->n_uploads = cache->n_uploads;
+  stats->uploaded_bytes = cache->uploaded_bytes;
+}
+
 void
 _cogl_pango_glyph_cache_add_reorganize_callback (CoglPangoGlyphCache *cache,
                                                  GHookFunc func,
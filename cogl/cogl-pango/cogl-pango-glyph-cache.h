@@ -33,16 +33,21 @@
 #include <pango/pango-font.h>
 
 #include "cogl/cogl-texture.h"
+#include "cogl-pango.h"
 
 G_BEGIN_DECLS
 
 typedef struct _CoglPangoGlyphCache      CoglPangoGlyphCache;
 typedef struct _CoglPangoGlyphCacheValue CoglPangoGlyphCacheValue;
+typedef struct _CoglPangoGlyphCachePage  CoglPangoGlyphCachePage;
 
 struct _CoglPangoGlyphCacheValue
 {
   CoglTexture *texture;
 
+  /* The page the glyph is stored in, or NULL if it is zero-sized */
+  CoglPangoGlyphCachePage *page;
+
   float tx1;
   float ty1;
   float tx2;
@@ -56,20 +61,15 @@ struct _CoglPangoGlyphCacheValue
   int draw_width;
   int draw_height;
 
-  /* This will be set to TRUE when the glyph atlas is reorganized
-     which means the glyph will need to be redrawn */
+  /* This will be set to TRUE when the glyph is added to a page and
+     it still needs to be rasterized into it */
   guint dirty : 1;
   /* Set to TRUE if the glyph has colors (eg. emoji) */
   guint has_color : 1;
 };
 
-typedef void (* CoglPangoGlyphCacheDirtyFunc) (PangoFont *font,
-                                               PangoGlyph glyph,
-                                               CoglPangoGlyphCacheValue *value);
-
 COGL_EXPORT CoglPangoGlyphCache *
-cogl_pango_glyph_cache_new (CoglContext *ctx,
-                            gboolean use_mipmapping);
+cogl_pango_glyph_cache_new (CoglContext *ctx);
 
 COGL_EXPORT void
 cogl_pango_glyph_cache_free (CoglPangoGlyphCache *cache);
@@ -83,6 +83,10 @@ cogl_pango_glyph_cache_lookup (CoglPangoGlyphCache *cache,
 COGL_EXPORT void
 cogl_pango_glyph_cache_clear (CoglPangoGlyphCache *cache);
 
+COGL_EXPORT void
+cogl_pango_glyph_cache_get_stats (CoglPangoGlyphCache      *cache,
+                                  CoglPangoGlyphCacheStats *stats);
+
 void
 _cogl_pango_glyph_cache_add_reorganize_callback (CoglPangoGlyphCache *cache,
                                                  GHookFunc func,
@@ -94,8 +98,7 @@ _cogl_pango_glyph_cache_remove_reorganize_callback (CoglPangoGlyphCache *cache,
                                                     void *user_data);
 
 void
-_cogl_pango_glyph_cache_set_dirty_glyphs (CoglPangoGlyphCache *cache,
-                                          CoglPangoGlyphCacheDirtyFunc func);
+_cogl_pango_glyph_cache_set_dirty_glyphs (CoglPangoGlyphCache *cache);
 
 G_END_DECLS
 
@@ -46,6 +46,10 @@ _cogl_pango_renderer_new (CoglContext *context);
 void
 _cogl_pango_renderer_clear_glyph_cache  (CoglPangoRenderer *renderer);
 
+void
+_cogl_pango_renderer_get_glyph_cache_stats (CoglPangoRenderer        *renderer,
+                                            CoglPangoGlyphCacheStats *stats);
+
 void
 _cogl_pango_renderer_set_use_mipmapping (CoglPangoRenderer *renderer,
                                          gboolean value);
@@ -117,6 +117,41 @@ cogl_pango_font_map_set_resolution (CoglPangoFontMap *font_map,
 COGL_EXPORT void
 cogl_pango_font_map_clear_glyph_cache (CoglPangoFontMap *font_map);
 
+/**
+ * CoglPangoGlyphCacheStats: (skip)
+ * @n_pages: number of atlas pages currently allocated
+ * @page_bytes: memory used by the pages, including their CPU-side copy
+ * @n_glyphs: number of glyphs currently cached
+ * @n_evicted_pages: number of pages that were evicted to make room
+ * @n_evicted_glyphs: number of glyphs that were dropped by evictions
+ * @n_uploads: number of texture uploads done to update the pages
+ * @uploaded_bytes: amount of glyph data uploaded to the pages
+ *
+ * Statistics about the glyph cache, useful to tune its size.
+ */
+typedef struct _CoglPangoGlyphCacheStats
+{
+  int n_pages;
+  size_t page_bytes;
+  int n_glyphs;
+  uint64_t n_evicted_pages;
+  uint64_t n_evicted_glyphs;
+  uint64_t n_uploads;
+  uint64_t uploaded_bytes;
+} CoglPangoGlyphCacheStats;
+
+/**
+ * cogl_pango_font_map_get_glyph_cache_stats: (skip)
+ * @font_map: a #CoglPangoFontMap
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Retrieves statistics about the glyph caches of @font_map, summed over
+ * the mipmapped and non-mipmapped caches.
+ */
+COGL_EXPORT void
+cogl_pango_font_map_get_glyph_cache_stats (CoglPangoFontMap         *font_map,
+                                           CoglPangoGlyphCacheStats *stats);
+
 /**
  * cogl_pango_ensure_glyph_cache_for_layout:
  * @layout: A #PangoLayout
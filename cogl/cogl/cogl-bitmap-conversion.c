@@ -32,10 +32,13 @@
 
 #include "cogl-private.h"
 #include "cogl-bitmap-private.h"
+#include "cogl-bitmap-kernels-private.h"
 #include "cogl-context-private.h"
+#include "cogl-debug.h"
 #include "cogl-texture-private.h"
 
 #include <string.h>
+#include <test-fixtures/test-unit.h>
 
 #define component_type uint8_t
 #define component_size 8
@@ -272,6 +275,8 @@ _cogl_bitmap_unpremult_unpacked_span_16 (uint16_t *data,
           data[1] = (data[1] * 65535) / alpha;
           data[2] = (data[2] * 65535) / alpha;
         }
+
+      data += 4;
     }
 }
 
@@ -286,6 +291,8 @@ _cogl_bitmap_premult_unpacked_span_16 (uint16_t *data,
       data[0] = (data[0] * alpha) / 65535;
       data[1] = (data[1] * alpha) / 65535;
       data[2] = (data[2] * alpha) / 65535;
+
+      data += 4;
     }
 }
 
@@ -370,40 +377,258 @@ _cogl_bitmap_needs_short_temp_buffer (CoglPixelFormat format)
   return FALSE;
 }
 
+/* Gets the byte offsets of the red, green, blue and alpha components of
+   a format with 8-bit components stored in 32-bit pixels */
+static gboolean
+_cogl_bitmap_get_8888_offsets (CoglPixelFormat format,
+                               uint8_t offsets[4])
+{
+  static const uint8_t rgba_offsets[4] = { 0, 1, 2, 3 };
+  static const uint8_t bgra_offsets[4] = { 2, 1, 0, 3 };
+  static const uint8_t argb_offsets[4] = { 1, 2, 3, 0 };
+  static const uint8_t abgr_offsets[4] = { 3, 2, 1, 0 };
+
+  switch (format & ~COGL_PREMULT_BIT)
+    {
+    case COGL_PIXEL_FORMAT_RGBA_8888:
+      memcpy (offsets, rgba_offsets, sizeof (rgba_offsets));
+      return TRUE;
+    case COGL_PIXEL_FORMAT_BGRA_8888:
+      memcpy (offsets, bgra_offsets, sizeof (bgra_offsets));
+      return TRUE;
+    case COGL_PIXEL_FORMAT_ARGB_8888:
+      memcpy (offsets, argb_offsets, sizeof (argb_offsets));
+      return TRUE;
+    case COGL_PIXEL_FORMAT_ABGR_8888:
+      memcpy (offsets, abgr_offsets, sizeof (abgr_offsets));
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+_cogl_bitmap_get_2101010_layout (CoglPixelFormat format,
+                                 CoglBitmap2101010Layout *layout)
+{
+  /* These match the unpacking functions in cogl-bitmap-packing.h */
+  switch (format)
+    {
+    case COGL_PIXEL_FORMAT_RGBA_1010102:
+    case COGL_PIXEL_FORMAT_RGBA_1010102_PRE:
+      *layout = (CoglBitmap2101010Layout) { 22, 12, 2, 0 };
+      return TRUE;
+    case COGL_PIXEL_FORMAT_BGRA_1010102:
+    case COGL_PIXEL_FORMAT_BGRA_1010102_PRE:
+      *layout = (CoglBitmap2101010Layout) { 2, 12, 22, 0 };
+      return TRUE;
+    case COGL_PIXEL_FORMAT_XRGB_2101010:
+    case COGL_PIXEL_FORMAT_ARGB_2101010:
+    case COGL_PIXEL_FORMAT_ARGB_2101010_PRE:
+      *layout = (CoglBitmap2101010Layout) { 20, 10, 0, 30 };
+      return TRUE;
+    case COGL_PIXEL_FORMAT_XBGR_2101010:
+    case COGL_PIXEL_FORMAT_ABGR_2101010:
+    case COGL_PIXEL_FORMAT_ABGR_2101010_PRE:
+      *layout = (CoglBitmap2101010Layout) { 0, 10, 20, 30 };
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static const CoglBitmapKernels *
+_cogl_bitmap_get_conversion_kernels (void)
+{
+  if (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_FAST_CONVERSION))
+    return NULL;
+
+  return _cogl_bitmap_get_kernels ();
+}
+
+typedef struct
+{
+  /* NULL to only use the generic conversion code */
+  const CoglBitmapKernels *kernels;
+
+  CoglPixelFormat src_format;
+  CoglPixelFormat dst_format;
+  const uint8_t *src_data;
+  uint8_t *dst_data;
+  int src_rowstride;
+  int dst_rowstride;
+  int width;
+
+  gboolean use_16;
+  gboolean need_premult;
+
+  /* Set if both formats are 8888 formats, in which case the bytes of
+     each pixel are reordered directly without unpacking them */
+  gboolean swizzle;
+  uint8_t swizzle_order[4];
+
+  /* Set if the source is a 2101010 format unpacked to 8 bits */
+  gboolean unpack_2101010;
+  CoglBitmap2101010Layout layout_2101010;
+} CoglBitmapConversion;
+
+static void
+_cogl_bitmap_convert_rows (int first_row,
+                           int n_rows,
+                           void *user_data)
+{
+  CoglBitmapConversion *conversion = user_data;
+  const CoglBitmapKernels *kernels = conversion->kernels;
+  CoglPixelFormat src_format = conversion->src_format;
+  CoglPixelFormat dst_format = conversion->dst_format;
+  gboolean use_16 = conversion->use_16;
+  int width = conversion->width;
+  const uint8_t *src;
+  uint8_t *dst;
+  void *tmp_row = NULL;
+  int y;
+
+  /* Allocate a buffer to hold a temporary RGBA row */
+  if (!conversion->swizzle)
+    tmp_row = g_malloc (width *
+                        (use_16 ? sizeof (uint16_t) : sizeof (uint8_t)) * 4);
+
+  for (y = first_row; y < first_row + n_rows; y++)
+    {
+      src = conversion->src_data + y * conversion->src_rowstride;
+      dst = conversion->dst_data + y * conversion->dst_rowstride;
+
+      if (conversion->swizzle)
+        {
+          gboolean alpha_first = (dst_format & COGL_AFIRST_BIT) != 0;
+
+          kernels->swizzle_8888 (src, dst, width, conversion->swizzle_order);
+
+          if (conversion->need_premult)
+            {
+              if (dst_format & COGL_PREMULT_BIT)
+                kernels->premult_8888 (dst, width, alpha_first);
+              else
+                kernels->unpremult_8888 (dst, width, alpha_first);
+            }
+
+          continue;
+        }
+
+      if (use_16)
+        _cogl_unpack_16 (src_format, src, tmp_row, width);
+      else if (conversion->unpack_2101010)
+        kernels->unpack_2101010 (src, tmp_row, width,
+                                 &conversion->layout_2101010);
+      else
+        _cogl_unpack_8 (src_format, src, tmp_row, width);
+
+      /* Handle premultiplication */
+      if (conversion->need_premult)
+        {
+          if (dst_format & COGL_PREMULT_BIT)
+            {
+              if (use_16)
+                _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
+              else if (kernels)
+                kernels->premult_8888 (tmp_row, width, FALSE);
+              else
+                _cogl_bitmap_premult_unpacked_span_8 (tmp_row, width);
+            }
+          else
+            {
+              if (use_16)
+                _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
+              else if (kernels)
+                kernels->unpremult_8888 (tmp_row, width, FALSE);
+              else
+                _cogl_bitmap_unpremult_unpacked_span_8 (tmp_row, width);
+            }
+        }
+
+      if (use_16)
+        _cogl_pack_16 (dst_format, tmp_row, dst, width);
+      else
+        _cogl_pack_8 (dst_format, tmp_row, dst, width);
+    }
+
+  g_free (tmp_row);
+}
+
+static gboolean
+_cogl_bitmap_needs_premult_conversion (CoglPixelFormat src_format,
+                                       CoglPixelFormat dst_format)
+{
+  return ((src_format & COGL_PREMULT_BIT) != (dst_format & COGL_PREMULT_BIT) &&
+          src_format != COGL_PIXEL_FORMAT_A_8 &&
+          dst_format != COGL_PIXEL_FORMAT_A_8 &&
+          (src_format & dst_format & COGL_A_BIT));
+}
+
+static void
+_cogl_bitmap_init_conversion (CoglBitmapConversion *conversion,
+                              const CoglBitmapKernels *kernels,
+                              CoglPixelFormat src_format,
+                              CoglPixelFormat dst_format,
+                              int width)
+{
+  uint8_t src_offsets[4];
+  uint8_t dst_offsets[4];
+  int i;
+
+  memset (conversion, 0, sizeof (CoglBitmapConversion));
+
+  conversion->kernels = kernels;
+  conversion->src_format = src_format;
+  conversion->dst_format = dst_format;
+  conversion->width = width;
+  conversion->use_16 = _cogl_bitmap_needs_short_temp_buffer (dst_format);
+  conversion->need_premult =
+    _cogl_bitmap_needs_premult_conversion (src_format, dst_format);
+
+  if (!kernels)
+    return;
+
+  if (_cogl_bitmap_get_8888_offsets (src_format, src_offsets) &&
+      _cogl_bitmap_get_8888_offsets (dst_format, dst_offsets))
+    {
+      conversion->swizzle = TRUE;
+      for (i = 0; i < 4; i++)
+        conversion->swizzle_order[dst_offsets[i]] = src_offsets[i];
+    }
+  else if (!conversion->use_16 &&
+           _cogl_bitmap_get_2101010_layout (src_format,
+                                            &conversion->layout_2101010))
+    {
+      conversion->unpack_2101010 = TRUE;
+    }
+}
+
 gboolean
 _cogl_bitmap_convert_into_bitmap (CoglBitmap *src_bmp,
                                   CoglBitmap *dst_bmp,
                                   GError **error)
 {
+  CoglBitmapConversion conversion;
   uint8_t *src_data;
   uint8_t *dst_data;
-  uint8_t *src;
-  uint8_t *dst;
-  void *tmp_row;
-  int src_rowstride;
-  int dst_rowstride;
-  int y;
   int width, height;
   CoglPixelFormat src_format;
   CoglPixelFormat dst_format;
-  gboolean use_16;
   gboolean need_premult;
 
   src_format = cogl_bitmap_get_format (src_bmp);
-  src_rowstride = cogl_bitmap_get_rowstride (src_bmp);
   dst_format = cogl_bitmap_get_format (dst_bmp);
-  dst_rowstride = cogl_bitmap_get_rowstride (dst_bmp);
   width = cogl_bitmap_get_width (src_bmp);
   height = cogl_bitmap_get_height (src_bmp);
 
   g_return_val_if_fail (width == cogl_bitmap_get_width (dst_bmp), FALSE);
   g_return_val_if_fail (height == cogl_bitmap_get_height (dst_bmp), FALSE);
 
-  need_premult
-    = ((src_format & COGL_PREMULT_BIT) != (dst_format & COGL_PREMULT_BIT) &&
-       src_format != COGL_PIXEL_FORMAT_A_8 &&
-       dst_format != COGL_PIXEL_FORMAT_A_8 &&
-       (src_format & dst_format & COGL_A_BIT));
+  need_premult = _cogl_bitmap_needs_premult_conversion (src_format,
+                                                       dst_format);
 
   /* If the base format is the same then we can just copy the bitmap
      instead */
@@ -447,53 +672,29 @@ _cogl_bitmap_convert_into_bitmap (CoglBitmap *src_bmp,
       return FALSE;
     }
 
-  use_16 = _cogl_bitmap_needs_short_temp_buffer (dst_format);
-
-  /* Allocate a buffer to hold a temporary RGBA row */
-  tmp_row = g_malloc (width *
-                      (use_16 ? sizeof (uint16_t) : sizeof (uint8_t)) * 4);
+  _cogl_bitmap_init_conversion (&conversion,
+                                _cogl_bitmap_get_conversion_kernels (),
+                                src_format, dst_format,
+                                width);
+  conversion.src_data = src_data;
+  conversion.dst_data = dst_data;
+  conversion.src_rowstride = cogl_bitmap_get_rowstride (src_bmp);
+  conversion.dst_rowstride = cogl_bitmap_get_rowstride (dst_bmp);
 
-  /* FIXME: Optimize */
-  for (y = 0; y < height; y++)
+  if (conversion.kernels)
     {
-      src = src_data + y * src_rowstride;
-      dst = dst_data + y * dst_rowstride;
-
-      if (use_16)
-        _cogl_unpack_16 (src_format, src, tmp_row, width);
-      else
-        _cogl_unpack_8 (src_format, src, tmp_row, width);
-
-      /* Handle premultiplication */
-      if (need_premult)
-        {
-          if (dst_format & COGL_PREMULT_BIT)
-            {
-              if (use_16)
-                _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
-              else
-                _cogl_bitmap_premult_unpacked_span_8 (tmp_row, width);
-            }
-          else
-            {
-              if (use_16)
-                _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
-              else
-                _cogl_bitmap_unpremult_unpacked_span_8 (tmp_row, width);
-            }
-        }
-
-      if (use_16)
-        _cogl_pack_16 (dst_format, tmp_row, dst, width);
-      else
-        _cogl_pack_8 (dst_format, tmp_row, dst, width);
+      _cogl_bitmap_foreach_row_band (width, height,
+                                     _cogl_bitmap_convert_rows,
+                                     &conversion);
+    }
+  else
+    {
+      _cogl_bitmap_convert_rows (0, height, &conversion);
     }
 
   _cogl_bitmap_unmap (src_bmp);
   _cogl_bitmap_unmap (dst_bmp);
 
-  g_free (tmp_row);
-
   return TRUE;
 }
 
@@ -555,17 +756,13 @@ driver_can_convert (CoglContext *ctx,
   return TRUE;
 }
 
-CoglBitmap *
-_cogl_bitmap_convert_for_upload (CoglBitmap *src_bmp,
-                                 CoglPixelFormat internal_format,
-                                 gboolean can_convert_in_place,
-                                 GError **error)
+CoglPixelFormat
+_cogl_bitmap_get_upload_format (CoglContext *ctx,
+                                CoglPixelFormat src_format,
+                                CoglPixelFormat internal_format)
 {
-  CoglContext *ctx = _cogl_bitmap_get_context (src_bmp);
-  CoglPixelFormat src_format = cogl_bitmap_get_format (src_bmp);
-  CoglBitmap *dst_bmp;
-
-  g_return_val_if_fail (internal_format != COGL_PIXEL_FORMAT_ANY, NULL);
+  g_return_val_if_fail (internal_format != COGL_PIXEL_FORMAT_ANY,
+                        COGL_PIXEL_FORMAT_ANY);
 
   /* OpenGL supports specifying a different format for the internal
      format when uploading texture data. We should use this to convert
@@ -581,73 +778,75 @@ _cogl_bitmap_convert_for_upload (CoglBitmap *src_bmp,
          internal_format then we need to copy and convert it */
       if (_cogl_texture_needs_premult_conversion (src_format,
                                                   internal_format))
-        {
-          if (can_convert_in_place)
-            {
-              if (_cogl_bitmap_convert_premult_status (src_bmp,
-                                                       (src_format ^
-                                                        COGL_PREMULT_BIT),
-                                                       error))
-                {
-                  dst_bmp = cogl_object_ref (src_bmp);
-                }
-              else
-                return NULL;
-            }
-          else
-            {
-              dst_bmp = _cogl_bitmap_convert (src_bmp,
-                                              src_format ^ COGL_PREMULT_BIT,
-                                              error);
-              if (dst_bmp == NULL)
-                return NULL;
-            }
-        }
+        return src_format ^ COGL_PREMULT_BIT;
       else
-        dst_bmp = cogl_object_ref (src_bmp);
+        return src_format;
     }
   else
     {
-      CoglPixelFormat closest_format;
+      return ctx->driver_vtable->pixel_format_to_gl (ctx,
+                                                     internal_format,
+                                                     NULL, /* ignore gl intformat */
+                                                     NULL, /* ignore gl format */
+                                                     NULL); /* ignore gl type */
+    }
+}
 
-      closest_format =
-        ctx->driver_vtable->pixel_format_to_gl (ctx,
-                                                internal_format,
-                                                NULL, /* ignore gl intformat */
-                                                NULL, /* ignore gl format */
-                                                NULL); /* ignore gl type */
+CoglBitmap *
+_cogl_bitmap_convert_for_upload (CoglBitmap *src_bmp,
+                                 CoglPixelFormat internal_format,
+                                 gboolean can_convert_in_place,
+                                 GError **error)
+{
+  CoglContext *ctx = _cogl_bitmap_get_context (src_bmp);
+  CoglPixelFormat src_format = cogl_bitmap_get_format (src_bmp);
+  CoglPixelFormat upload_format;
 
-      if (closest_format != src_format)
-        dst_bmp = _cogl_bitmap_convert (src_bmp, closest_format, error);
-      else
-        dst_bmp = cogl_object_ref (src_bmp);
+  g_return_val_if_fail (internal_format != COGL_PIXEL_FORMAT_ANY, NULL);
+
+  upload_format = _cogl_bitmap_get_upload_format (ctx,
+                                                  src_format,
+                                                  internal_format);
+
+  if (upload_format == src_format)
+    return cogl_object_ref (src_bmp);
+
+  if (can_convert_in_place &&
+      upload_format == (src_format ^ COGL_PREMULT_BIT))
+    {
+      if (!_cogl_bitmap_convert_premult_status (src_bmp,
+                                                upload_format,
+                                                error))
+        return NULL;
+
+      return cogl_object_ref (src_bmp);
     }
 
-  return dst_bmp;
+  return _cogl_bitmap_convert (src_bmp, upload_format, error);
 }
 
-gboolean
-_cogl_bitmap_unpremult (CoglBitmap *bmp,
-                        GError **error)
+typedef struct
 {
-  uint8_t *p, *data;
-  uint16_t *tmp_row;
-  int x,y;
+  /* NULL to only use the generic premultiplication code */
+  const CoglBitmapKernels *kernels;
+
   CoglPixelFormat format;
-  int width, height;
+  uint8_t *data;
   int rowstride;
+  int width;
+} CoglBitmapPremult;
 
-  format = cogl_bitmap_get_format (bmp);
-  width = cogl_bitmap_get_width (bmp);
-  height = cogl_bitmap_get_height (bmp);
-  rowstride = cogl_bitmap_get_rowstride (bmp);
-
-  if ((data = _cogl_bitmap_map (bmp,
-                                COGL_BUFFER_ACCESS_READ |
-                                COGL_BUFFER_ACCESS_WRITE,
-                                0,
-                                error)) == NULL)
-    return FALSE;
+static void
+_cogl_bitmap_unpremult_rows (int first_row,
+                             int n_rows,
+                             void *user_data)
+{
+  CoglBitmapPremult *premult = user_data;
+  CoglPixelFormat format = premult->format;
+  int width = premult->width;
+  uint16_t *tmp_row;
+  uint8_t *p;
+  int x, y;
 
   /* If we can't directly unpremult the data inline then we'll
      allocate a temporary row and unpack the data. This assumes if we
@@ -657,9 +856,9 @@ _cogl_bitmap_unpremult (CoglBitmap *bmp,
   else
     tmp_row = g_malloc (sizeof (uint16_t) * 4 * width);
 
-  for (y = 0; y < height; y++)
+  for (y = first_row; y < first_row + n_rows; y++)
     {
-      p = (uint8_t*) data + y * rowstride;
+      p = premult->data + y * premult->rowstride;
 
       if (tmp_row)
         {
@@ -667,6 +866,11 @@ _cogl_bitmap_unpremult (CoglBitmap *bmp,
           _cogl_bitmap_unpremult_unpacked_span_16 (tmp_row, width);
           _cogl_pack_16 (format, tmp_row, p, width);
         }
+      else if (premult->kernels)
+        {
+          premult->kernels->unpremult_8888 (p, width,
+                                            (format & COGL_AFIRST_BIT) != 0);
+        }
       else
         {
           if (format & COGL_AFIRST_BIT)
@@ -686,36 +890,19 @@ _cogl_bitmap_unpremult (CoglBitmap *bmp,
     }
 
   g_free (tmp_row);
-
-  _cogl_bitmap_unmap (bmp);
-
-  _cogl_bitmap_set_format (bmp, format & ~COGL_PREMULT_BIT);
-
-  return TRUE;
 }
 
-gboolean
-_cogl_bitmap_premult (CoglBitmap *bmp,
-                      GError **error)
+static void
+_cogl_bitmap_premult_rows (int first_row,
+                           int n_rows,
+                           void *user_data)
 {
-  uint8_t *p, *data;
+  CoglBitmapPremult *premult = user_data;
+  CoglPixelFormat format = premult->format;
+  int width = premult->width;
   uint16_t *tmp_row;
-  int x,y;
-  CoglPixelFormat format;
-  int width, height;
-  int rowstride;
-
-  format = cogl_bitmap_get_format (bmp);
-  width = cogl_bitmap_get_width (bmp);
-  height = cogl_bitmap_get_height (bmp);
-  rowstride = cogl_bitmap_get_rowstride (bmp);
-
-  if ((data = _cogl_bitmap_map (bmp,
-                                COGL_BUFFER_ACCESS_READ |
-                                COGL_BUFFER_ACCESS_WRITE,
-                                0,
-                                error)) == NULL)
-    return FALSE;
+  uint8_t *p;
+  int x, y;
 
   /* If we can't directly premult the data inline then we'll allocate
      a temporary row and unpack the data. */
@@ -724,9 +911,9 @@ _cogl_bitmap_premult (CoglBitmap *bmp,
   else
     tmp_row = g_malloc (sizeof (uint16_t) * 4 * width);
 
-  for (y = 0; y < height; y++)
+  for (y = first_row; y < first_row + n_rows; y++)
     {
-      p = (uint8_t*) data + y * rowstride;
+      p = premult->data + y * premult->rowstride;
 
       if (tmp_row)
         {
@@ -734,6 +921,11 @@ _cogl_bitmap_premult (CoglBitmap *bmp,
           _cogl_bitmap_premult_unpacked_span_16 (tmp_row, width);
           _cogl_pack_16 (format, tmp_row, p, width);
         }
+      else if (premult->kernels)
+        {
+          premult->kernels->premult_8888 (p, width,
+                                          (format & COGL_AFIRST_BIT) != 0);
+        }
       else
         {
           if (format & COGL_AFIRST_BIT)
@@ -750,10 +942,307 @@ _cogl_bitmap_premult (CoglBitmap *bmp,
     }
 
   g_free (tmp_row);
+}
+
+static gboolean
+_cogl_bitmap_process_premult (CoglBitmap *bmp,
+                              CoglBitmapRowsFunc rows_func,
+                              GError **error)
+{
+  CoglBitmapPremult premult;
+  int height;
+
+  premult.data = _cogl_bitmap_map (bmp,
+                                   COGL_BUFFER_ACCESS_READ |
+                                   COGL_BUFFER_ACCESS_WRITE,
+                                   0,
+                                   error);
+  if (premult.data == NULL)
+    return FALSE;
+
+  premult.kernels = _cogl_bitmap_get_conversion_kernels ();
+  premult.format = cogl_bitmap_get_format (bmp);
+  premult.rowstride = cogl_bitmap_get_rowstride (bmp);
+  premult.width = cogl_bitmap_get_width (bmp);
+  height = cogl_bitmap_get_height (bmp);
+
+  if (premult.kernels)
+    _cogl_bitmap_foreach_row_band (premult.width, height, rows_func, &premult);
+  else
+    rows_func (0, height, &premult);
 
   _cogl_bitmap_unmap (bmp);
 
-  _cogl_bitmap_set_format (bmp, format | COGL_PREMULT_BIT);
+  return TRUE;
+}
+
+gboolean
+_cogl_bitmap_unpremult (CoglBitmap *bmp,
+                        GError **error)
+{
+  if (!_cogl_bitmap_process_premult (bmp, _cogl_bitmap_unpremult_rows, error))
+    return FALSE;
+
+  _cogl_bitmap_set_format (bmp,
+                           cogl_bitmap_get_format (bmp) & ~COGL_PREMULT_BIT);
 
   return TRUE;
 }
+
+gboolean
+_cogl_bitmap_premult (CoglBitmap *bmp,
+                      GError **error)
+{
+  if (!_cogl_bitmap_process_premult (bmp, _cogl_bitmap_premult_rows, error))
+    return FALSE;
+
+  _cogl_bitmap_set_format (bmp,
+                           cogl_bitmap_get_format (bmp) | COGL_PREMULT_BIT);
+
+  return TRUE;
+}
+
+#ifdef ENABLE_UNIT_TESTS
+
+/* Enough pixels for every combination of a color component and an alpha
+   value, plus a few more so that the SIMD kernels have a tail to handle */
+#define TEST_WIDTH (256 * 256 + 7)
+
+static const CoglPixelFormat test_8888_formats[] = {
+  COGL_PIXEL_FORMAT_RGBA_8888,
+  COGL_PIXEL_FORMAT_BGRA_8888,
+  COGL_PIXEL_FORMAT_ARGB_8888,
+  COGL_PIXEL_FORMAT_ABGR_8888,
+  COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+  COGL_PIXEL_FORMAT_BGRA_8888_PRE,
+  COGL_PIXEL_FORMAT_ARGB_8888_PRE,
+  COGL_PIXEL_FORMAT_ABGR_8888_PRE,
+};
+
+static const CoglPixelFormat test_2101010_formats[] = {
+  COGL_PIXEL_FORMAT_RGBA_1010102,
+  COGL_PIXEL_FORMAT_BGRA_1010102,
+  COGL_PIXEL_FORMAT_XRGB_2101010,
+  COGL_PIXEL_FORMAT_ARGB_2101010,
+  COGL_PIXEL_FORMAT_XBGR_2101010,
+  COGL_PIXEL_FORMAT_ABGR_2101010,
+  COGL_PIXEL_FORMAT_RGBA_1010102_PRE,
+  COGL_PIXEL_FORMAT_BGRA_1010102_PRE,
+  COGL_PIXEL_FORMAT_ARGB_2101010_PRE,
+  COGL_PIXEL_FORMAT_ABGR_2101010_PRE,
+};
+
+/* The first and second byte of each pixel go through all the
+   combinations, and the last two bytes repeat them so that both the
+   alpha first and alpha last layouts see every pair */
+static uint8_t *
+create_test_pixels (void)
+{
+  uint8_t *data = g_malloc (TEST_WIDTH * 4);
+  int i;
+
+  for (i = 0; i < TEST_WIDTH; i++)
+    {
+      data[i * 4 + 0] = i & 0xff;
+      data[i * 4 + 1] = (i >> 8) & 0xff;
+      data[i * 4 + 2] = (i * 7) & 0xff;
+      data[i * 4 + 3] = (i >> 8) & 0xff;
+    }
+
+  return data;
+}
+
+static void
+check_convert_rows (const CoglBitmapKernels *kernels,
+                    CoglPixelFormat src_format,
+                    CoglPixelFormat dst_format,
+                    const uint8_t *src_data)
+{
+  CoglBitmapConversion conversion;
+  uint8_t *expected = g_malloc (TEST_WIDTH * 4);
+  uint8_t *result = g_malloc (TEST_WIDTH * 4);
+
+  _cogl_bitmap_init_conversion (&conversion, NULL,
+                                src_format, dst_format,
+                                TEST_WIDTH);
+  conversion.src_data = src_data;
+  conversion.dst_data = expected;
+  _cogl_bitmap_convert_rows (0, 1, &conversion);
+
+  _cogl_bitmap_init_conversion (&conversion, kernels,
+                                src_format, dst_format,
+                                TEST_WIDTH);
+  conversion.src_data = src_data;
+  conversion.dst_data = result;
+  _cogl_bitmap_convert_rows (0, 1, &conversion);
+
+  if (memcmp (expected, result, TEST_WIDTH * 4) != 0)
+    g_error ("%s kernels convert format 0x%x to 0x%x differently",
+             kernels->name, src_format, dst_format);
+
+  g_free (expected);
+  g_free (result);
+}
+
+static void
+check_premult_rows (const CoglBitmapKernels *kernels,
+                    CoglPixelFormat format,
+                    CoglBitmapRowsFunc rows_func,
+                    const uint8_t *src_data)
+{
+  CoglBitmapPremult premult = { 0, };
+  uint8_t *expected = g_memdup2 (src_data, TEST_WIDTH * 4);
+  uint8_t *result = g_memdup2 (src_data, TEST_WIDTH * 4);
+
+  premult.format = format;
+  premult.width = TEST_WIDTH;
+
+  premult.kernels = NULL;
+  premult.data = expected;
+  rows_func (0, 1, &premult);
+
+  premult.kernels = kernels;
+  premult.data = result;
+  rows_func (0, 1, &premult);
+
+  if (memcmp (expected, result, TEST_WIDTH * 4) != 0)
+    g_error ("%s kernels (un)premultiply format 0x%x differently",
+             kernels->name, format);
+
+  g_free (expected);
+  g_free (result);
+}
+
+UNIT_TEST (check_bitmap_conversion_kernels,
+           0, /* requirements */
+           0 /* no failure cases */)
+{
+  const CoglBitmapKernels * const *all_kernels;
+  uint8_t *src_data = create_test_pixels ();
+  int n_kernels;
+  int i, j, k;
+
+  all_kernels = _cogl_bitmap_get_all_kernels (&n_kernels);
+
+  for (k = 0; k < n_kernels; k++)
+    {
+      const CoglBitmapKernels *kernels = all_kernels[k];
+
+      for (i = 0; i < G_N_ELEMENTS (test_8888_formats); i++)
+        {
+          CoglPixelFormat format = test_8888_formats[i];
+
+          for (j = 0; j < G_N_ELEMENTS (test_8888_formats); j++)
+            check_convert_rows (kernels, format, test_8888_formats[j],
+                                src_data);
+
+          if (format & COGL_PREMULT_BIT)
+            check_premult_rows (kernels, format,
+                                _cogl_bitmap_unpremult_rows, src_data);
+          else
+            check_premult_rows (kernels, format,
+                                _cogl_bitmap_premult_rows, src_data);
+        }
+
+      for (i = 0; i < G_N_ELEMENTS (test_2101010_formats); i++)
+        {
+          for (j = 0; j < G_N_ELEMENTS (test_8888_formats); j++)
+            check_convert_rows (kernels, test_2101010_formats[i],
+                                test_8888_formats[j], src_data);
+        }
+
+      if (cogl_test_verbose ())
+        g_print ("%s kernels match the generic code\n", kernels->name);
+    }
+
+  g_free (src_data);
+}
+
+static CoglBitmap *
+convert_large_bitmap (CoglBitmap *src_bmp,
+                      CoglPixelFormat dst_format)
+{
+  CoglBitmap *dst_bmp;
+  GError *error = NULL;
+
+  dst_bmp = _cogl_bitmap_new_with_malloc_buffer (test_ctx,
+                                                 cogl_bitmap_get_width (src_bmp),
+                                                 cogl_bitmap_get_height (src_bmp),
+                                                 dst_format,
+                                                 &error);
+  g_assert_no_error (error);
+
+  _cogl_bitmap_convert_into_bitmap (src_bmp, dst_bmp, &error);
+  g_assert_no_error (error);
+
+  return dst_bmp;
+}
+
+static void
+check_large_bitmap_conversion (CoglPixelFormat src_format,
+                               CoglPixelFormat dst_format)
+{
+  /* Big enough to be split across several threads, with a number of
+     rows that doesn't divide evenly between them */
+  int width = 1021, height = 1031;
+  int rowstride = width * 4;
+  uint8_t *src_data = g_malloc (rowstride * height);
+  CoglBitmap *src_bmp;
+  CoglBitmap *expected_bmp;
+  CoglBitmap *result_bmp;
+  uint8_t *expected;
+  uint8_t *result;
+  gboolean was_disabled;
+  int i;
+
+  for (i = 0; i < rowstride * height; i++)
+    src_data[i] = g_test_rand_int_range (0, 256);
+
+  src_bmp = cogl_bitmap_new_for_data (test_ctx, width, height,
+                                      src_format, rowstride, src_data);
+
+  was_disabled = COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_FAST_CONVERSION);
+
+  COGL_DEBUG_SET_FLAG (COGL_DEBUG_DISABLE_FAST_CONVERSION);
+  expected_bmp = convert_large_bitmap (src_bmp, dst_format);
+  COGL_DEBUG_CLEAR_FLAG (COGL_DEBUG_DISABLE_FAST_CONVERSION);
+  result_bmp = convert_large_bitmap (src_bmp, dst_format);
+
+  if (was_disabled)
+    COGL_DEBUG_SET_FLAG (COGL_DEBUG_DISABLE_FAST_CONVERSION);
+
+  g_assert_cmpint (cogl_bitmap_get_rowstride (expected_bmp), ==,
+                   cogl_bitmap_get_rowstride (result_bmp));
+
+  expected = _cogl_bitmap_map (expected_bmp, COGL_BUFFER_ACCESS_READ, 0, NULL);
+  result = _cogl_bitmap_map (result_bmp, COGL_BUFFER_ACCESS_READ, 0, NULL);
+  g_assert_nonnull (expected);
+  g_assert_nonnull (result);
+
+  g_assert_cmpmem (expected,
+                   cogl_bitmap_get_rowstride (expected_bmp) * height,
+                   result,
+                   cogl_bitmap_get_rowstride (result_bmp) * height);
+
+  _cogl_bitmap_unmap (expected_bmp);
+  _cogl_bitmap_unmap (result_bmp);
+
+  cogl_object_unref (expected_bmp);
+  cogl_object_unref (result_bmp);
+  cogl_object_unref (src_bmp);
+  g_free (src_data);
+}
+
+UNIT_TEST (check_bitmap_conversion_threads,
+           0, /* requirements */
+           0 /* no failure cases */)
+{
+  check_large_bitmap_conversion (COGL_PIXEL_FORMAT_RGBA_8888,
+                                 COGL_PIXEL_FORMAT_BGRA_8888_PRE);
+  check_large_bitmap_conversion (COGL_PIXEL_FORMAT_ARGB_8888_PRE,
+                                 COGL_PIXEL_FORMAT_RGBA_8888);
+  check_large_bitmap_conversion (COGL_PIXEL_FORMAT_XRGB_2101010,
+                                 COGL_PIXEL_FORMAT_RGBA_8888);
+}
+
+#endif /* ENABLE_UNIT_TESTS */
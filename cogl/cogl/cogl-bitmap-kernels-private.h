@@ -0,0 +1,97 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COGL_BITMAP_KERNELS_PRIVATE_H
+#define COGL_BITMAP_KERNELS_PRIVATE_H
+
+#include <glib.h>
+#include <stdint.h>
+
+/* Bit offsets of the components of the packed 32-bit 10-bit-per-channel
+ * formats. The color components are 10 bits and alpha is 2 bits. */
+typedef struct _CoglBitmap2101010Layout
+{
+  int r_shift;
+  int g_shift;
+  int b_shift;
+  int a_shift;
+} CoglBitmap2101010Layout;
+
+/* Row kernels for the most common pixel conversions. All of them give
+ * exactly the same results as the generic unpacking and packing code in
+ * cogl-bitmap-packing.h and the premultiplication code in
+ * cogl-bitmap-conversion.c. */
+typedef struct _CoglBitmapKernels
+{
+  const char *name;
+
+  /* Reorders the bytes of each 32-bit pixel, so that byte i of a
+   * destination pixel is byte order[i] of the source pixel */
+  void (* swizzle_8888) (const uint8_t *src,
+                         uint8_t       *dst,
+                         int            width,
+                         const uint8_t  order[4]);
+
+  /* Premultiplies or unpremultiplies a row of 8888 pixels in place */
+  void (* premult_8888) (uint8_t  *data,
+                         int       width,
+                         gboolean  alpha_first);
+  void (* unpremult_8888) (uint8_t  *data,
+                           int       width,
+                           gboolean  alpha_first);
+
+  /* Unpacks a row of 2101010 or 1010102 pixels to 8-bit RGBA */
+  void (* unpack_2101010) (const uint8_t                 *src,
+                           uint8_t                       *dst,
+                           int                            width,
+                           const CoglBitmap2101010Layout *layout);
+} CoglBitmapKernels;
+
+typedef void (* CoglBitmapRowsFunc) (int   first_row,
+                                     int   n_rows,
+                                     void *user_data);
+
+/* Returns the fastest kernels supported by the CPU */
+const CoglBitmapKernels *
+_cogl_bitmap_get_kernels (void);
+
+/* Returns all the kernels supported by the CPU, starting with the
+ * plain C ones */
+const CoglBitmapKernels * const *
+_cogl_bitmap_get_all_kernels (int *n_kernels);
+
+/* Calls @func for bands of rows covering the whole bitmap. Large
+ * bitmaps are split across threads, in which case this only returns
+ * once all the bands are processed. */
+void
+_cogl_bitmap_foreach_row_band (int                width,
+                               int                height,
+                               CoglBitmapRowsFunc func,
+                               void              *user_data);
+
+#endif /* COGL_BITMAP_KERNELS_PRIVATE_H */
@@ -0,0 +1,621 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cogl-config.h"
+
+#include "cogl-bitmap-kernels-private.h"
+#include "cogl-parallel-private.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define COGL_BITMAP_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/* Bitmaps with fewer pixels than this are not worth splitting across
+ * threads */
+#define MIN_PIXELS_PER_BAND (512 * 1024)
+
+/* No division form of floor((c*a + 128)/255), see
+ * cogl-bitmap-conversion.c */
+#define MULT(d,a,t)                             \
+  G_STMT_START {                                \
+    t = d * a + 128;                            \
+    d = ((t >> 8) + t) >> 8;                    \
+  } G_STMT_END
+
+/* Same as UNPACK_10 and UNPACK_2 in cogl-bitmap-packing.h for 8-bit
+ * components */
+#define UNPACK_10_TO_8(b) (((b) * 255 + 0x1ff) / 0x3ff)
+#define UNPACK_2_TO_8(b) (((b) * 255 + 1) / 3)
+
+static void
+swizzle_8888_c (const uint8_t *src,
+                uint8_t       *dst,
+                int            width,
+                const uint8_t  order[4])
+{
+  while (width-- > 0)
+    {
+      dst[0] = src[order[0]];
+      dst[1] = src[order[1]];
+      dst[2] = src[order[2]];
+      dst[3] = src[order[3]];
+      src += 4;
+      dst += 4;
+    }
+}
+
+static void
+premult_8888_c (uint8_t  *data,
+                int       width,
+                gboolean  alpha_first)
+{
+  int a = alpha_first ? 0 : 3;
+  int c = alpha_first ? 1 : 0;
+
+  while (width-- > 0)
+    {
+      uint8_t alpha = data[a];
+      unsigned int t1, t2, t3;
+
+      MULT (data[c], alpha, t1);
+      MULT (data[c + 1], alpha, t2);
+      MULT (data[c + 2], alpha, t3);
+      data += 4;
+    }
+}
+
+static void
+unpremult_8888_c (uint8_t  *data,
+                  int       width,
+                  gboolean  alpha_first)
+{
+  int a = alpha_first ? 0 : 3;
+  int c = alpha_first ? 1 : 0;
+
+  while (width-- > 0)
+    {
+      uint8_t alpha = data[a];
+
+      if (alpha == 0)
+        {
+          data[0] = 0;
+          data[1] = 0;
+          data[2] = 0;
+          data[3] = 0;
+        }
+      else
+        {
+          data[c] = (data[c] * 255) / alpha;
+          data[c + 1] = (data[c + 1] * 255) / alpha;
+          data[c + 2] = (data[c + 2] * 255) / alpha;
+        }
+      data += 4;
+    }
+}
+
+static void
+unpack_2101010_c (const uint8_t                 *src,
+                  uint8_t                       *dst,
+                  int                            width,
+                  const CoglBitmap2101010Layout *layout)
+{
+  while (width-- > 0)
+    {
+      uint32_t v = *(const uint32_t *) src;
+
+      dst[0] = UNPACK_10_TO_8 ((v >> layout->r_shift) & 0x3ff);
+      dst[1] = UNPACK_10_TO_8 ((v >> layout->g_shift) & 0x3ff);
+      dst[2] = UNPACK_10_TO_8 ((v >> layout->b_shift) & 0x3ff);
+      dst[3] = UNPACK_2_TO_8 ((v >> layout->a_shift) & 3);
+      src += 4;
+      dst += 4;
+    }
+}
+
+static const CoglBitmapKernels kernels_c = {
+  .name = "c",
+  .swizzle_8888 = swizzle_8888_c,
+  .premult_8888 = premult_8888_c,
+  .unpremult_8888 = unpremult_8888_c,
+  .unpack_2101010 = unpack_2101010_c,
+};
+
+#ifdef COGL_BITMAP_KERNELS_X86
+
+/* The SSE2 and AVX2 kernels handle as many pixels as fit in a register
+ * at a time, and leave the remaining ones to the plain C kernels. */
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+alpha_mask_sse2 (gboolean alpha_first)
+{
+  return _mm_set1_epi32 (alpha_first ? 0x000000ff : (int) 0xff000000);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+swizzle_8888_sse2 (const uint8_t *src,
+                   uint8_t       *dst,
+                   int            width,
+                   const uint8_t  order[4])
+{
+  const __m128i byte_mask = _mm_set1_epi32 (0xff);
+  __m128i src_shifts[4];
+  __m128i dst_shifts[4];
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      src_shifts[i] = _mm_cvtsi32_si128 (order[i] * 8);
+      dst_shifts[i] = _mm_cvtsi32_si128 (i * 8);
+    }
+
+  while (width >= 4)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i result = _mm_setzero_si128 ();
+
+      for (i = 0; i < 4; i++)
+        {
+          __m128i component;
+
+          component = _mm_and_si128 (_mm_srl_epi32 (pixels, src_shifts[i]),
+                                     byte_mask);
+          result = _mm_or_si128 (result,
+                                 _mm_sll_epi32 (component, dst_shifts[i]));
+        }
+
+      _mm_storeu_si128 ((__m128i *) dst, result);
+      src += 4 * 4;
+      dst += 4 * 4;
+      width -= 4;
+    }
+
+  swizzle_8888_c (src, dst, width, order);
+}
+
+/* Premultiplies two pixels unpacked to 16-bit components */
+__attribute__ ((target ("sse2")))
+static inline __m128i
+premult_2_pixels_sse2 (__m128i  pixels,
+                       gboolean alpha_first)
+{
+  __m128i alpha;
+  __m128i t;
+
+  if (alpha_first)
+    {
+      alpha = _mm_shufflelo_epi16 (pixels, _MM_SHUFFLE (0, 0, 0, 0));
+      alpha = _mm_shufflehi_epi16 (alpha, _MM_SHUFFLE (0, 0, 0, 0));
+    }
+  else
+    {
+      alpha = _mm_shufflelo_epi16 (pixels, _MM_SHUFFLE (3, 3, 3, 3));
+      alpha = _mm_shufflehi_epi16 (alpha, _MM_SHUFFLE (3, 3, 3, 3));
+    }
+
+  t = _mm_add_epi16 (_mm_mullo_epi16 (pixels, alpha), _mm_set1_epi16 (128));
+
+  return _mm_srli_epi16 (_mm_add_epi16 (_mm_srli_epi16 (t, 8), t), 8);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+premult_8888_sse2 (uint8_t  *data,
+                   int       width,
+                   gboolean  alpha_first)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i alpha_mask = alpha_mask_sse2 (alpha_first);
+
+  while (width >= 4)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) data);
+      __m128i lo, hi, result;
+
+      lo = premult_2_pixels_sse2 (_mm_unpacklo_epi8 (pixels, zero),
+                                  alpha_first);
+      hi = premult_2_pixels_sse2 (_mm_unpackhi_epi8 (pixels, zero),
+                                  alpha_first);
+      result = _mm_packus_epi16 (lo, hi);
+
+      /* Keep the original alpha */
+      result = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, result),
+                             _mm_and_si128 (alpha_mask, pixels));
+
+      _mm_storeu_si128 ((__m128i *) data, result);
+      data += 4 * 4;
+      width -= 4;
+    }
+
+  premult_8888_c (data, width, alpha_first);
+}
+
+/* Unpremultiplies one pixel unpacked to 32-bit components. The division
+ * is done in single precision, which is exact here: the dividend is at
+ * most 255 * 255, so the quotient is known to well within the distance
+ * to the next integer when it isn't one. */
+__attribute__ ((target ("sse2")))
+static inline __m128i
+unpremult_pixel_sse2 (__m128i  pixel,
+                      gboolean alpha_first)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i alpha;
+  __m128i result;
+  __m128 quotient;
+
+  if (alpha_first)
+    alpha = _mm_shuffle_epi32 (pixel, _MM_SHUFFLE (0, 0, 0, 0));
+  else
+    alpha = _mm_shuffle_epi32 (pixel, _MM_SHUFFLE (3, 3, 3, 3));
+
+  quotient = _mm_div_ps (_mm_cvtepi32_ps (_mm_mullo_epi16 (pixel,
+                                                           _mm_set1_epi32 (255))),
+                         _mm_cvtepi32_ps (alpha));
+  result = _mm_cvttps_epi32 (quotient);
+
+  /* Like storing the result in a uint8_t, ignore the overflow from
+   * components bigger than the alpha, and clear pixels with a zero
+   * alpha */
+  result = _mm_and_si128 (result, _mm_set1_epi32 (0xff));
+
+  return _mm_andnot_si128 (_mm_cmpeq_epi32 (alpha, zero), result);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+unpremult_8888_sse2 (uint8_t  *data,
+                     int       width,
+                     gboolean  alpha_first)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i alpha_mask = alpha_mask_sse2 (alpha_first);
+
+  while (width >= 4)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) data);
+      __m128i lo = _mm_unpacklo_epi8 (pixels, zero);
+      __m128i hi = _mm_unpackhi_epi8 (pixels, zero);
+      __m128i p0, p1, p2, p3;
+      __m128i result;
+
+      p0 = unpremult_pixel_sse2 (_mm_unpacklo_epi16 (lo, zero), alpha_first);
+      p1 = unpremult_pixel_sse2 (_mm_unpackhi_epi16 (lo, zero), alpha_first);
+      p2 = unpremult_pixel_sse2 (_mm_unpacklo_epi16 (hi, zero), alpha_first);
+      p3 = unpremult_pixel_sse2 (_mm_unpackhi_epi16 (hi, zero), alpha_first);
+
+      result = _mm_packus_epi16 (_mm_packs_epi32 (p0, p1),
+                                 _mm_packs_epi32 (p2, p3));
+
+      /* Keep the original alpha, which is also zero where the color
+       * components were cleared */
+      result = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, result),
+                             _mm_and_si128 (alpha_mask, pixels));
+
+      _mm_storeu_si128 ((__m128i *) data, result);
+      data += 4 * 4;
+      width -= 4;
+    }
+
+  unpremult_8888_c (data, width, alpha_first);
+}
+
+/* Same as UNPACK_10_TO_8 () for four components. The division is exact
+ * for the same reason as in unpremult_pixel_sse2 () */
+__attribute__ ((target ("sse2")))
+static inline __m128i
+unpack_10_to_8_sse2 (__m128i pixels,
+                     __m128i shift)
+{
+  __m128i component;
+  __m128 value;
+
+  component = _mm_and_si128 (_mm_srl_epi32 (pixels, shift),
+                             _mm_set1_epi32 (0x3ff));
+  value = _mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (component),
+                                  _mm_set1_ps (255.0f)),
+                      _mm_set1_ps (511.0f));
+
+  return _mm_cvttps_epi32 (_mm_div_ps (value, _mm_set1_ps (1023.0f)));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+unpack_2101010_sse2 (const uint8_t                 *src,
+                     uint8_t                       *dst,
+                     int                            width,
+                     const CoglBitmap2101010Layout *layout)
+{
+  const __m128i r_shift = _mm_cvtsi32_si128 (layout->r_shift);
+  const __m128i g_shift = _mm_cvtsi32_si128 (layout->g_shift);
+  const __m128i b_shift = _mm_cvtsi32_si128 (layout->b_shift);
+  const __m128i a_shift = _mm_cvtsi32_si128 (layout->a_shift);
+
+  while (width >= 4)
+    {
+      __m128i pixels = _mm_loadu_si128 ((const __m128i *) src);
+      __m128i r, g, b, a;
+
+      r = unpack_10_to_8_sse2 (pixels, r_shift);
+      g = unpack_10_to_8_sse2 (pixels, g_shift);
+      b = unpack_10_to_8_sse2 (pixels, b_shift);
+
+      /* UNPACK_2_TO_8 () is the same as multiplying by 85 */
+      a = _mm_and_si128 (_mm_srl_epi32 (pixels, a_shift), _mm_set1_epi32 (3));
+      a = _mm_mullo_epi16 (a, _mm_set1_epi32 (85));
+
+      _mm_storeu_si128 ((__m128i *) dst,
+                        _mm_or_si128 (_mm_or_si128 (r,
+                                                    _mm_slli_epi32 (g, 8)),
+                                      _mm_or_si128 (_mm_slli_epi32 (b, 16),
+                                                    _mm_slli_epi32 (a, 24))));
+      src += 4 * 4;
+      dst += 4 * 4;
+      width -= 4;
+    }
+
+  unpack_2101010_c (src, dst, width, layout);
+}
+
+static const CoglBitmapKernels kernels_sse2 = {
+  .name = "sse2",
+  .swizzle_8888 = swizzle_8888_sse2,
+  .premult_8888 = premult_8888_sse2,
+  .unpremult_8888 = unpremult_8888_sse2,
+  .unpack_2101010 = unpack_2101010_sse2,
+};
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+alpha_mask_avx2 (gboolean alpha_first)
+{
+  return _mm256_set1_epi32 (alpha_first ? 0x000000ff : (int) 0xff000000);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+swizzle_8888_avx2 (const uint8_t *src,
+                   uint8_t       *dst,
+                   int            width,
+                   const uint8_t  order[4])
+{
+  uint8_t shuffle_bytes[32];
+  __m256i shuffle;
+  int i;
+
+  /* The shuffle works within each 128-bit lane, i.e. on 4 pixels */
+  for (i = 0; i < 32; i++)
+    shuffle_bytes[i] = (i & 0xc) + order[i & 3];
+  shuffle = _mm256_loadu_si256 ((const __m256i *) shuffle_bytes);
+
+  while (width >= 8)
+    {
+      __m256i pixels = _mm256_loadu_si256 ((const __m256i *) src);
+
+      _mm256_storeu_si256 ((__m256i *) dst,
+                           _mm256_shuffle_epi8 (pixels, shuffle));
+      src += 8 * 4;
+      dst += 8 * 4;
+      width -= 8;
+    }
+
+  swizzle_8888_c (src, dst, width, order);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+premult_4_pixels_avx2 (__m256i  pixels,
+                       gboolean alpha_first)
+{
+  __m256i alpha;
+  __m256i t;
+
+  if (alpha_first)
+    {
+      alpha = _mm256_shufflelo_epi16 (pixels, _MM_SHUFFLE (0, 0, 0, 0));
+      alpha = _mm256_shufflehi_epi16 (alpha, _MM_SHUFFLE (0, 0, 0, 0));
+    }
+  else
+    {
+      alpha = _mm256_shufflelo_epi16 (pixels, _MM_SHUFFLE (3, 3, 3, 3));
+      alpha = _mm256_shufflehi_epi16 (alpha, _MM_SHUFFLE (3, 3, 3, 3));
+    }
+
+  t = _mm256_add_epi16 (_mm256_mullo_epi16 (pixels, alpha),
+                        _mm256_set1_epi16 (128));
+
+  return _mm256_srli_epi16 (_mm256_add_epi16 (_mm256_srli_epi16 (t, 8), t), 8);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+premult_8888_avx2 (uint8_t  *data,
+                   int       width,
+                   gboolean  alpha_first)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i alpha_mask = alpha_mask_avx2 (alpha_first);
+
+  while (width >= 8)
+    {
+      __m256i pixels = _mm256_loadu_si256 ((const __m256i *) data);
+      __m256i lo, hi, result;
+
+      /* Unpacking and packing both work within 128-bit lanes, so the
+       * pixels end up back in their original order */
+      lo = premult_4_pixels_avx2 (_mm256_unpacklo_epi8 (pixels, zero),
+                                  alpha_first);
+      hi = premult_4_pixels_avx2 (_mm256_unpackhi_epi8 (pixels, zero),
+                                  alpha_first);
+      result = _mm256_packus_epi16 (lo, hi);
+
+      result = _mm256_or_si256 (_mm256_andnot_si256 (alpha_mask, result),
+                                _mm256_and_si256 (alpha_mask, pixels));
+
+      _mm256_storeu_si256 ((__m256i *) data, result);
+      data += 8 * 4;
+      width -= 8;
+    }
+
+  premult_8888_sse2 (data, width, alpha_first);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256i
+unpremult_2_pixels_avx2 (__m256i  pixels,
+                         gboolean alpha_first)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i alpha;
+  __m256i result;
+  __m256 quotient;
+
+  if (alpha_first)
+    alpha = _mm256_shuffle_epi32 (pixels, _MM_SHUFFLE (0, 0, 0, 0));
+  else
+    alpha = _mm256_shuffle_epi32 (pixels, _MM_SHUFFLE (3, 3, 3, 3));
+
+  quotient =
+    _mm256_div_ps (_mm256_cvtepi32_ps (_mm256_mullo_epi16 (pixels,
+                                                           _mm256_set1_epi32 (255))),
+                   _mm256_cvtepi32_ps (alpha));
+  result = _mm256_cvttps_epi32 (quotient);
+  result = _mm256_and_si256 (result, _mm256_set1_epi32 (0xff));
+
+  return _mm256_andnot_si256 (_mm256_cmpeq_epi32 (alpha, zero), result);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+unpremult_8888_avx2 (uint8_t  *data,
+                     int       width,
+                     gboolean  alpha_first)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i alpha_mask = alpha_mask_avx2 (alpha_first);
+
+  while (width >= 8)
+    {
+      __m256i pixels = _mm256_loadu_si256 ((const __m256i *) data);
+      __m256i lo = _mm256_unpacklo_epi8 (pixels, zero);
+      __m256i hi = _mm256_unpackhi_epi8 (pixels, zero);
+      __m256i p0, p1, p2, p3;
+      __m256i result;
+
+      p0 = unpremult_2_pixels_avx2 (_mm256_unpacklo_epi16 (lo, zero),
+                                    alpha_first);
+      p1 = unpremult_2_pixels_avx2 (_mm256_unpackhi_epi16 (lo, zero),
+                                    alpha_first);
+      p2 = unpremult_2_pixels_avx2 (_mm256_unpacklo_epi16 (hi, zero),
+                                    alpha_first);
+      p3 = unpremult_2_pixels_avx2 (_mm256_unpackhi_epi16 (hi, zero),
+                                    alpha_first);
+
+      result = _mm256_packus_epi16 (_mm256_packs_epi32 (p0, p1),
+                                    _mm256_packs_epi32 (p2, p3));
+
+      result = _mm256_or_si256 (_mm256_andnot_si256 (alpha_mask, result),
+                                _mm256_and_si256 (alpha_mask, pixels));
+
+      _mm256_storeu_si256 ((__m256i *) data, result);
+      data += 8 * 4;
+      width -= 8;
+    }
+
+  unpremult_8888_sse2 (data, width, alpha_first);
+}
+
+/* There is not enough arithmetic in unpacking 2101010 for wider
+ * registers to make a difference, so the AVX2 kernels reuse the SSE2
+ * one */
+static const CoglBitmapKernels kernels_avx2 = {
+  .name = "avx2",
+  .swizzle_8888 = swizzle_8888_avx2,
+  .premult_8888 = premult_8888_avx2,
+  .unpremult_8888 = unpremult_8888_avx2,
+  .unpack_2101010 = unpack_2101010_sse2,
+};
+
+#endif /* COGL_BITMAP_KERNELS_X86 */
+
+static gpointer
+init_all_kernels (gpointer data)
+{
+  GPtrArray *kernels = g_ptr_array_new ();
+
+  g_ptr_array_add (kernels, (gpointer) &kernels_c);
+
+#ifdef COGL_BITMAP_KERNELS_X86
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("sse2"))
+    g_ptr_array_add (kernels, (gpointer) &kernels_sse2);
+  if (__builtin_cpu_supports ("avx2"))
+    g_ptr_array_add (kernels, (gpointer) &kernels_avx2);
+#endif
+
+  return kernels;
+}
+
+const CoglBitmapKernels * const *
+_cogl_bitmap_get_all_kernels (int *n_kernels)
+{
+  static GOnce once = G_ONCE_INIT;
+  GPtrArray *kernels;
+
+  kernels = g_once (&once, init_all_kernels, NULL);
+
+  *n_kernels = kernels->len;
+  return (const CoglBitmapKernels * const *) kernels->pdata;
+}
+
+const CoglBitmapKernels *
+_cogl_bitmap_get_kernels (void)
+{
+  const CoglBitmapKernels * const *kernels;
+  int n_kernels;
+
+  kernels = _cogl_bitmap_get_all_kernels (&n_kernels);
+
+  return kernels[n_kernels - 1];
+}
+
+void
+_cogl_bitmap_foreach_row_band (int                width,
+                               int                height,
+                               CoglBitmapRowsFunc func,
+                               void              *user_data)
+{
+  int n_bands;
+
+  n_bands = ((int64_t) width * height) / MIN_PIXELS_PER_BAND;
+
+  _cogl_parallel_for (height, n_bands, func, user_data);
+}
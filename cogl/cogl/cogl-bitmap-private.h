@@ -106,13 +106,23 @@ _cogl_bitmap_convert (CoglBitmap *bmp,
                       CoglPixelFormat dst_format,
                       GError **error);
 
+CoglPixelFormat
+_cogl_bitmap_get_upload_format (CoglContext *ctx,
+                                CoglPixelFormat src_format,
+                                CoglPixelFormat internal_format);
+
 CoglBitmap *
 _cogl_bitmap_convert_for_upload (CoglBitmap *src_bmp,
                                  CoglPixelFormat internal_format,
                                  gboolean can_convert_in_place,
                                  GError **error);
 
-gboolean
+/*
+ * Only touches CPU memory as long as neither bitmap is backed by a
+ * #CoglBuffer, so it can be used from other threads for bitmaps that
+ * are not otherwise in use.
+ */
+COGL_EXPORT gboolean
 _cogl_bitmap_convert_into_bitmap (CoglBitmap *src_bmp,
                                   CoglBitmap *dst_bmp,
                                   GError **error);
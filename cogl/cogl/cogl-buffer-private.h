@@ -167,7 +167,8 @@ _cogl_buffer_map (CoglBuffer *buffer,
 void *
 _cogl_buffer_map_range_for_fill_or_fallback (CoglBuffer *buffer,
                                              size_t offset,
-                                             size_t size);
+                                             size_t size,
+                                             CoglBufferMapHint hints);
 COGL_EXPORT void *
 _cogl_buffer_map_for_fill_or_fallback (CoglBuffer *buffer);
 
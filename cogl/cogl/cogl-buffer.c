@@ -276,13 +276,15 @@ cogl_buffer_unmap (CoglBuffer *buffer)
 void *
 _cogl_buffer_map_for_fill_or_fallback (CoglBuffer *buffer)
 {
-  return _cogl_buffer_map_range_for_fill_or_fallback (buffer, 0, buffer->size);
+  return _cogl_buffer_map_range_for_fill_or_fallback (buffer, 0, buffer->size,
+                                                      COGL_BUFFER_MAP_HINT_DISCARD);
 }
 
 void *
 _cogl_buffer_map_range_for_fill_or_fallback (CoglBuffer *buffer,
                                              size_t offset,
-                                             size_t size)
+                                             size_t size,
+                                             CoglBufferMapHint hints)
 {
   CoglContext *ctx = buffer->context;
   void *ret;
@@ -296,7 +298,7 @@ _cogl_buffer_map_range_for_fill_or_fallback (CoglBuffer *buffer,
                                offset,
                                size,
                                COGL_BUFFER_ACCESS_WRITE,
-                               COGL_BUFFER_MAP_HINT_DISCARD,
+                               hints,
                                &ignore_error);
 
   if (ret)
@@ -203,6 +203,10 @@ typedef enum /*< prefix=COGL_BUFFER_ACCESS >*/
  *    replace all the contents of the mapped region. The contents of
  *    the region specified are undefined after this flag is used to
  *    map a buffer.
+ * @COGL_BUFFER_MAP_HINT_UNSYNCHRONIZED: Tells Cogl that the mapped
+ *    region isn't being used by pending rendering, so that the driver
+ *    doesn't need to wait for it. This is only useful when mapping a
+ *    sub-region, and is ignored when the driver can't map ranges.
  *
  * Hints to Cogl about how you are planning to modify the data once it
  * is mapped.
@@ -213,7 +217,8 @@ typedef enum /*< prefix=COGL_BUFFER_ACCESS >*/
 typedef enum /*< prefix=COGL_BUFFER_MAP_HINT >*/
 {
   COGL_BUFFER_MAP_HINT_DISCARD = 1 << 0,
-  COGL_BUFFER_MAP_HINT_DISCARD_RANGE = 1 << 1
+  COGL_BUFFER_MAP_HINT_DISCARD_RANGE = 1 << 1,
+  COGL_BUFFER_MAP_HINT_UNSYNCHRONIZED = 1 << 2
 } CoglBufferMapHint;
 
 /**
@@ -49,6 +49,7 @@
 #include "cogl-gl-header.h"
 #include "cogl-framebuffer-private.h"
 #include "cogl-offscreen-private.h"
+#include "cogl-offscreen-pool.h"
 #include "cogl-onscreen-private.h"
 #include "cogl-fence-private.h"
 #include "cogl-poll-private.h"
@@ -145,6 +146,16 @@ struct _CoglContext
   GArray           *journal_flush_attributes_array;
   GArray           *journal_clip_bounds;
 
+  /* Vertices of all journals are streamed into this buffer, one flush
+   * after another, and it is only discarded when it is full */
+  CoglAttributeBuffer *journal_vertex_ring;
+  size_t            journal_vertex_ring_offset;
+  /* Number of journal flushes in progress that are still drawing from
+   * the vertex ring, which must then not be discarded */
+  int               journal_vertex_ring_users;
+
+  CoglJournalStats  journal_stats;
+
   /* Some simple caching, to minimize state changes... */
   CoglPipeline     *current_pipeline;
   unsigned long     current_pipeline_changes_since_flush;
@@ -260,6 +271,8 @@ struct _CoglContext
 
   GHashTable *named_pipelines;
 
+  CoglOffscreenPool *offscreen_pool;
+
   /* This defines a list of function pointers that Cogl uses from
      either GL or GLES. All functions are accessed indirectly through
      these pointers rather than linking to them directly */
@@ -44,6 +44,7 @@
 #include "cogl-pipeline-private.h"
 #include "cogl-framebuffer-private.h"
 #include "cogl-onscreen-private.h"
+#include "cogl-offscreen-pool-private.h"
 #include "cogl-attribute-private.h"
 #include "cogl1-context.h"
 #include "cogl-gtype-private.h"
@@ -320,6 +321,8 @@ cogl_context_new (CoglDisplay *display,
   context->named_pipelines =
     g_hash_table_new_full (NULL, NULL, NULL, cogl_object_unref);
 
+  context->offscreen_pool = _cogl_offscreen_pool_new (context);
+
   return context;
 }
 
@@ -329,6 +332,9 @@ _cogl_context_free (CoglContext *context)
   const CoglWinsysVtable *winsys = _cogl_context_get_winsys (context);
   const CoglDriverVtable *driver = _cogl_context_get_driver (context);
 
+  g_clear_pointer (&context->offscreen_pool, _cogl_offscreen_pool_free);
+  cogl_clear_object (&context->journal_vertex_ring);
+
   winsys->context_deinit (context);
 
   if (context->default_gl_texture_2d_tex)
@@ -531,3 +537,10 @@ cogl_context_get_gpu_time_ns (CoglContext *context)
 
   return context->driver_vtable->get_gpu_time_ns (context);
 }
+
+void
+cogl_context_get_journal_stats (CoglContext      *context,
+                                CoglJournalStats *stats)
+{
+  *stats = context->journal_stats;
+}
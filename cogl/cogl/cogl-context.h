@@ -392,6 +392,38 @@ cogl_context_timestamp_query_get_time_ns (CoglContext        *context,
 COGL_EXPORT int64_t
 cogl_context_get_gpu_time_ns (CoglContext *context);
 
+/**
+ * CoglJournalStats: (skip)
+ * @n_flushes: number of journal flushes
+ * @n_quads: number of quads drawn from journals
+ * @n_batches: number of batches of quads drawn with the same pipeline state
+ * @n_draws: number of draw calls
+ * @uploaded_bytes: vertex data uploaded
+ * @n_vertex_ring_wraps: number of times vertex uploads started over at the
+ *   beginning of the vertex ring buffer
+ */
+typedef struct _CoglJournalStats
+{
+  int n_flushes;
+  int n_quads;
+  int n_batches;
+  int n_draws;
+  size_t uploaded_bytes;
+  int n_vertex_ring_wraps;
+} CoglJournalStats;
+
+/**
+ * cogl_context_get_journal_stats: (skip)
+ * @context: a #CoglContext pointer
+ * @stats: (out caller-allocates): return location for the statistics
+ *
+ * Retrieves statistics about the rendering batched in journals since the
+ * last time an onscreen framebuffer swapped its buffers.
+ */
+COGL_EXPORT void
+cogl_context_get_journal_stats (CoglContext      *context,
+                                CoglJournalStats *stats);
+
 G_END_DECLS
 
 #endif /* __COGL_CONTEXT_H__ */
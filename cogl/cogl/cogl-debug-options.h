@@ -195,3 +195,15 @@ OPT (STENCILLING,
      N_("Stencil every clip entry"),
      N_("Disables optimizations that usually avoid stencilling when it's not "
         "needed. This exercises more of the stencilling logic than usual."))
+OPT (DISABLE_OFFSCREEN_POOL,
+     N_("Root Cause"),
+     "disable-offscreen-pool",
+     N_("Disable the offscreen pool"),
+     N_("Allocate a new offscreen framebuffer every time one is acquired "
+        "from the pool, and free it when it is released."))
+OPT (DISABLE_FAST_CONVERSION,
+     N_("Root Cause"),
+     "disable-fast-conversion",
+     N_("Disable fast pixel conversion"),
+     N_("Convert pixel data one pixel at a time on a single thread instead "
+        "of using SIMD kernels and splitting large images across threads."))
@@ -86,6 +86,8 @@ static const GDebugKey cogl_behavioural_debug_keys[] = {
   { "sync-primitive", COGL_DEBUG_SYNC_PRIMITIVE },
   { "sync-frame", COGL_DEBUG_SYNC_FRAME},
   { "stencilling", COGL_DEBUG_STENCILLING },
+  { "disable-offscreen-pool", COGL_DEBUG_DISABLE_OFFSCREEN_POOL },
+  { "disable-fast-conversion", COGL_DEBUG_DISABLE_FAST_CONVERSION },
 };
 static const int n_cogl_behavioural_debug_keys =
   G_N_ELEMENTS (cogl_behavioural_debug_keys);
@@ -76,6 +76,8 @@ typedef enum
   COGL_DEBUG_SYNC_FRAME,
   COGL_DEBUG_TEXTURES,
   COGL_DEBUG_STENCILLING,
+  COGL_DEBUG_DISABLE_OFFSCREEN_POOL,
+  COGL_DEBUG_DISABLE_FAST_CONVERSION,
 
   COGL_DEBUG_N_FLAGS
 } CoglDebugFlags;
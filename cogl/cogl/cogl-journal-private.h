@@ -36,8 +36,6 @@
 #include "cogl-clip-stack.h"
 #include "cogl-fence-private.h"
 
-#define COGL_JOURNAL_VBO_POOL_SIZE 8
-
 typedef struct _CoglJournal
 {
   /* A pointer the framebuffer that is using this journal. This is
@@ -52,16 +50,6 @@ typedef struct _CoglJournal
   GArray *vertices;
   size_t needed_vbo_len;
 
-  /* A pool of attribute buffers is used so that we can avoid repeatedly
-     reallocating buffers. Only one of these buffers at a time will be
-     used by Cogl but we keep more than one alive anyway in case the
-     GL driver is internally using the buffer and it would have to
-     allocate a new one when we start writing to it */
-  CoglAttributeBuffer *vbo_pool[COGL_JOURNAL_VBO_POOL_SIZE];
-  /* The next vbo to use from the pool. We just cycle through them in
-     order */
-  unsigned int next_vbo_in_pool;
-
   int fast_read_pixel_count;
 
   CoglList pending_fences;
@@ -121,4 +109,7 @@ _cogl_journal_try_read_pixel (CoglJournal *journal,
 gboolean
 _cogl_is_journal (void *object);
 
+void
+_cogl_journal_end_frame (CoglContext *context);
+
 #endif /* __COGL_JOURNAL_PRIVATE_H */
@@ -42,6 +42,7 @@
 #include "cogl-attribute-private.h"
 #include "cogl-point-in-poly-private.h"
 #include "cogl-private.h"
+#include "cogl-trace.h"
 #include "cogl1-context.h"
 
 #include <string.h>
@@ -96,6 +97,12 @@
    to do the clip */
 #define COGL_JOURNAL_HARDWARE_CLIP_THRESHOLD 8
 
+/* The vertices of all journals are streamed into a single buffer of at
+   least this size. Each flush appends to the previous one, without
+   waiting for the GPU, and the buffer is only discarded when it is full */
+#define COGL_JOURNAL_VERTEX_RING_SIZE (1024 * 1024)
+#define COGL_JOURNAL_VERTEX_RING_ALIGNMENT 16
+
 typedef struct _CoglJournalFlushState
 {
   CoglContext *ctx;
@@ -125,17 +132,11 @@ typedef gboolean (*CoglJournalBatchTest) (CoglJournalEntry *entry0,
 void
 _cogl_journal_free (CoglJournal *journal)
 {
-  int i;
-
   if (journal->entries)
     g_array_free (journal->entries, TRUE);
   if (journal->vertices)
     g_array_free (journal->vertices, TRUE);
 
-  for (i = 0; i < COGL_JOURNAL_VBO_POOL_SIZE; i++)
-    if (journal->vbo_pool[i])
-      cogl_object_unref (journal->vbo_pool[i]);
-
   g_free (journal);
 }
 
@@ -293,6 +294,8 @@ _cogl_journal_flush_modelview_and_entries (CoglJournalEntry *batch_start,
   if (!_cogl_pipeline_get_real_blend_enabled (state->pipeline))
     draw_flags |= COGL_DRAW_COLOR_ATTRIBUTE_IS_OPAQUE;
 
+  ctx->journal_stats.n_draws++;
+
   if (batch_len > 1)
     {
       CoglVerticesMode mode = COGL_VERTICES_MODE_TRIANGLES;
@@ -402,6 +405,8 @@ _cogl_journal_flush_pipeline_and_entries (CoglJournalEntry *batch_start,
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING:    pipeline batch len = %d\n", batch_len);
 
+  state->ctx->journal_stats.n_batches++;
+
   state->pipeline = batch_start->pipeline;
 
   /* If we haven't transformed the quads in software then we need to also break
@@ -1110,32 +1115,87 @@ compare_entry_viewports (CoglJournalEntry *entry0, CoglJournalEntry *entry1)
   return memcmp (entry0->viewport, entry1->viewport, sizeof (float) * 4) == 0;
 }
 
-/* Gets a new vertex array from the pool. A reference is taken on the
-   array so it can be treated as if it was just newly allocated */
+/* Reserves @n_bytes in the vertex ring buffer, which is shared by the
+   journals of all framebuffers. The hints to map the reserved range with
+   are returned in @hints. A reference is taken on the buffer so it can be
+   treated as if it was just newly allocated */
 static CoglAttributeBuffer *
-create_attribute_buffer (CoglJournal *journal,
-                         size_t n_bytes)
+reserve_vertex_ring (CoglContext       *ctx,
+                     size_t             n_bytes,
+                     size_t            *offset,
+                     CoglBufferMapHint *hints)
 {
-  CoglContext *ctx = cogl_framebuffer_get_context (journal->framebuffer);
-  CoglAttributeBuffer *vbo;
+  CoglAttributeBuffer *vbo = ctx->journal_vertex_ring;
+  gboolean can_map_range;
+  gboolean is_full;
+  size_t ring_offset;
 
-  vbo = journal->vbo_pool[journal->next_vbo_in_pool];
+  ring_offset = ((ctx->journal_vertex_ring_offset +
+                  COGL_JOURNAL_VERTEX_RING_ALIGNMENT - 1) &
+                 ~(size_t) (COGL_JOURNAL_VERTEX_RING_ALIGNMENT - 1));
 
-  if (vbo == NULL)
+  if (vbo == NULL || cogl_buffer_get_size (COGL_BUFFER (vbo)) < n_bytes)
     {
-      vbo = cogl_attribute_buffer_new_with_size (ctx, n_bytes);
-      journal->vbo_pool[journal->next_vbo_in_pool] = vbo;
+      size_t size = COGL_JOURNAL_VERTEX_RING_SIZE;
+
+      /* If the buffer is too small then we'll just recreate it. A flush
+         that is still drawing from the old one holds a reference on it. */
+      while (size < n_bytes)
+        size *= 2;
+
+      g_clear_pointer (&ctx->journal_vertex_ring, cogl_object_unref);
+      vbo = cogl_attribute_buffer_new_with_size (ctx, size);
+      cogl_buffer_set_update_hint (COGL_BUFFER (vbo),
+                                   COGL_BUFFER_UPDATE_HINT_STREAM);
+      ctx->journal_vertex_ring = vbo;
+
+      ctx->journal_vertex_ring_offset = n_bytes;
+      *offset = 0;
+      *hints = COGL_BUFFER_MAP_HINT_DISCARD;
+
+      return cogl_object_ref (vbo);
     }
-  else if (cogl_buffer_get_size (COGL_BUFFER (vbo)) < n_bytes)
+
+  can_map_range =
+    _cogl_has_private_feature (ctx, COGL_PRIVATE_FEATURE_MAP_BUFFER_RANGE);
+  is_full = ring_offset + n_bytes > cogl_buffer_get_size (COGL_BUFFER (vbo));
+
+  if (can_map_range && !is_full)
     {
-      /* If the buffer is too small then we'll just recreate it */
-      cogl_object_unref (vbo);
+      /* Nothing was ever drawn from the range past the previous flushes
+         since the buffer was last discarded, so there is no need to wait */
+      *hints = (COGL_BUFFER_MAP_HINT_DISCARD_RANGE |
+                COGL_BUFFER_MAP_HINT_UNSYNCHRONIZED);
+    }
+  else if (ctx->journal_vertex_ring_users > 0)
+    {
+      /* A journal flush further up the stack, e.g. one that needed another
+         framebuffer flushed while drawing, still has draws to issue from
+         the ring. Discarding it would orphan the storage those draws refer
+         to, so use a buffer of our own instead. */
       vbo = cogl_attribute_buffer_new_with_size (ctx, n_bytes);
-      journal->vbo_pool[journal->next_vbo_in_pool] = vbo;
+      cogl_buffer_set_update_hint (COGL_BUFFER (vbo),
+                                   COGL_BUFFER_UPDATE_HINT_STREAM);
+
+      *offset = 0;
+      *hints = COGL_BUFFER_MAP_HINT_DISCARD;
+
+      return vbo;
+    }
+  else
+    {
+      /* Start over, letting the driver orphan the storage that may still
+         be in use by the GPU. Without mapping ranges that happens on every
+         flush, which isn't a wrap around of the ring though. */
+      ring_offset = 0;
+      *hints = COGL_BUFFER_MAP_HINT_DISCARD;
+
+      if (is_full)
+        ctx->journal_stats.n_vertex_ring_wraps++;
     }
 
-  journal->next_vbo_in_pool = ((journal->next_vbo_in_pool + 1) %
-                               COGL_JOURNAL_VBO_POOL_SIZE);
+  ctx->journal_vertex_ring_offset = ring_offset + n_bytes;
+  *offset = ring_offset;
 
   return cogl_object_ref (vbo);
 }
@@ -1145,9 +1205,12 @@ upload_vertices (CoglJournal *journal,
                  const CoglJournalEntry *entries,
                  int n_entries,
                  size_t needed_vbo_len,
-                 GArray *vertices)
+                 GArray *vertices,
+                 size_t *offset)
 {
+  CoglContext *ctx = cogl_framebuffer_get_context (journal->framebuffer);
   CoglAttributeBuffer *attribute_buffer;
+  CoglBufferMapHint hints;
   CoglBuffer *buffer;
   const float *vin;
   float *vout;
@@ -1158,13 +1221,16 @@ upload_vertices (CoglJournal *journal,
 
   g_assert (needed_vbo_len);
 
-  attribute_buffer = create_attribute_buffer (journal, needed_vbo_len * 4);
+  attribute_buffer = reserve_vertex_ring (ctx, needed_vbo_len * 4,
+                                          offset, &hints);
   buffer = COGL_BUFFER (attribute_buffer);
-  cogl_buffer_set_update_hint (buffer, COGL_BUFFER_UPDATE_HINT_DYNAMIC);
 
   vout = _cogl_buffer_map_range_for_fill_or_fallback (buffer,
-                                                      0, /* offset */
-                                                      needed_vbo_len * 4);
+                                                      *offset,
+                                                      needed_vbo_len * 4,
+                                                      hints);
+
+  ctx->journal_stats.uploaded_bytes += needed_vbo_len * 4;
   vin = &g_array_index (vertices, float, 0);
 
   /* Expand the number of vertices from 2 to 4 while uploading */
@@ -1387,6 +1453,9 @@ _cogl_journal_flush (CoglJournal *journal)
   if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
     g_print ("BATCHING: journal len = %d\n", journal->entries->len);
 
+  ctx->journal_stats.n_flushes++;
+  ctx->journal_stats.n_quads += journal->entries->len;
+
   /* NB: the journal deals with flushing the viewport, the modelview
    * stack and clip state manually */
   cogl_context_flush_framebuffer_state (ctx,
@@ -1428,8 +1497,9 @@ _cogl_journal_flush (CoglJournal *journal)
                      &g_array_index (journal->entries, CoglJournalEntry, 0),
                      journal->entries->len,
                      journal->needed_vbo_len,
-                     journal->vertices);
-  state.array_offset = 0;
+                     journal->vertices,
+                     &state.array_offset);
+  ctx->journal_vertex_ring_users++;
 
   /* batch_and_call() batches a list of journal entries according to some
    * given criteria and calls a callback once for each determined batch.
@@ -1458,6 +1528,8 @@ _cogl_journal_flush (CoglJournal *journal)
                   _cogl_journal_flush_viewport_and_entries,
                   &state);
 
+  ctx->journal_vertex_ring_users--;
+
   for (i = 0; i < state.attributes->len; i++)
     cogl_object_unref (g_array_index (state.attributes, CoglAttribute *, i));
   g_array_set_size (state.attributes, 0);
@@ -1473,6 +1545,35 @@ _cogl_journal_flush (CoglJournal *journal)
   COGL_TIMER_STOP (_cogl_uprof_context, flush_timer);
 }
 
+void
+_cogl_journal_end_frame (CoglContext *ctx)
+{
+  CoglJournalStats *stats = &ctx->journal_stats;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_BATCHING)))
+    g_print ("BATCHING: frame: %d flushes, %d quads, %d batches, %d draws, "
+             "%zu bytes uploaded, %d vertex ring wraps\n",
+             stats->n_flushes, stats->n_quads, stats->n_batches,
+             stats->n_draws, stats->uploaded_bytes,
+             stats->n_vertex_ring_wraps);
+
+  if (G_UNLIKELY (cogl_is_tracing_enabled ()))
+    {
+      g_autofree char *description = NULL;
+      COGL_TRACE_BEGIN_SCOPED (CoglJournalEndFrame, "Journal (end frame)");
+
+      description =
+        g_strdup_printf ("flushes: %d, quads: %d, batches: %d, draws: %d, "
+                         "uploaded: %zu bytes, vertex ring wraps: %d",
+                         stats->n_flushes, stats->n_quads, stats->n_batches,
+                         stats->n_draws, stats->uploaded_bytes,
+                         stats->n_vertex_ring_wraps);
+      COGL_TRACE_DESCRIBE (CoglJournalEndFrame, description);
+    }
+
+  memset (stats, 0, sizeof (CoglJournalStats));
+}
+
 static gboolean
 add_framebuffer_deps_cb (CoglPipelineLayer *layer, void *user_data)
 {
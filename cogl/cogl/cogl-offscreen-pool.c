@@ -0,0 +1,419 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cogl-config.h"
+
+#include "cogl-context-private.h"
+#include "cogl-debug.h"
+#include "cogl-framebuffer.h"
+#include "cogl-offscreen-pool-private.h"
+#include "cogl-texture-2d.h"
+#include "cogl-trace.h"
+
+#define DEFAULT_MAX_SIZE (64 * 1024 * 1024)
+#define MAX_UNUSED_FRAMES 60
+
+/* Sizes acquired with cogl_offscreen_pool_acquire_rounded() share buckets
+ * of this granularity, so e.g. resizing actors can keep reusing the same
+ * framebuffer. */
+#define BUCKET_SIZE 64
+#define ROUND_UP_TO_BUCKET(x) (((x) + BUCKET_SIZE - 1) / BUCKET_SIZE * BUCKET_SIZE)
+
+typedef struct _PoolEntry
+{
+  CoglOffscreen *offscreen;
+  uint64_t key;
+  size_t size;
+  int64_t last_used_frame;
+
+  /* In the bucket of its key, and in the LRU list, while available */
+  GList bucket_link;
+  GList lru_link;
+} PoolEntry;
+
+struct _CoglOffscreenPool
+{
+  CoglContext *context;
+
+  /* Key -> GQueue of available PoolEntry, most recently used first */
+  GHashTable *buckets;
+  /* Available entries, most recently used first */
+  GQueue lru;
+  /* Entries released since the last frame ended */
+  GQueue released;
+  /* CoglOffscreen -> PoolEntry, for acquired entries */
+  GHashTable *in_use;
+
+  int64_t frame_counter;
+  size_t max_size;
+
+  CoglOffscreenPoolStats stats;
+};
+
+static uint64_t
+make_key (int                   width,
+          int                   height,
+          CoglTextureComponents components)
+{
+  return ((uint64_t) components << 48 |
+          (uint64_t) (width & 0xffffff) << 24 |
+          (uint64_t) (height & 0xffffff));
+}
+
+static size_t
+estimate_size (int                   width,
+               int                   height,
+               CoglTextureComponents components)
+{
+  int bpp;
+
+  switch (components)
+    {
+    case COGL_TEXTURE_COMPONENTS_A:
+      bpp = 1;
+      break;
+    case COGL_TEXTURE_COMPONENTS_RG:
+      bpp = 2;
+      break;
+    default:
+      bpp = 4;
+      break;
+    }
+
+  return (size_t) width * height * bpp;
+}
+
+static void
+pool_entry_free (PoolEntry *entry)
+{
+  g_clear_object (&entry->offscreen);
+  g_free (entry);
+}
+
+static void
+remove_available_entry (CoglOffscreenPool *pool,
+                        PoolEntry         *entry)
+{
+  GQueue *bucket;
+
+  bucket = g_hash_table_lookup (pool->buckets, &entry->key);
+  g_queue_unlink (bucket, &entry->bucket_link);
+  if (g_queue_is_empty (bucket))
+    g_hash_table_remove (pool->buckets, &entry->key);
+
+  g_queue_unlink (&pool->lru, &entry->lru_link);
+
+  pool->stats.n_pooled--;
+  pool->stats.pooled_bytes -= entry->size;
+}
+
+static void
+evict_entry (CoglOffscreenPool *pool,
+             PoolEntry         *entry,
+             const char        *reason)
+{
+  COGL_NOTE (OFFSCREEN, "Evicting pooled %dx%d offscreen (%s)",
+             cogl_framebuffer_get_width (COGL_FRAMEBUFFER (entry->offscreen)),
+             cogl_framebuffer_get_height (COGL_FRAMEBUFFER (entry->offscreen)),
+             reason);
+
+  pool->stats.n_evictions++;
+  pool_entry_free (entry);
+}
+
+static void
+enforce_max_size (CoglOffscreenPool *pool)
+{
+  while (pool->stats.pooled_bytes > pool->max_size)
+    {
+      PoolEntry *entry;
+
+      if (!g_queue_is_empty (&pool->lru))
+        {
+          entry = g_queue_peek_tail (&pool->lru);
+          remove_available_entry (pool, entry);
+        }
+      else
+        {
+          /* Disposing the framebuffer flushes its journal, so whatever
+           * still samples from its texture sees the right contents. */
+          entry = g_queue_pop_tail (&pool->released);
+          pool->stats.n_pooled--;
+          pool->stats.pooled_bytes -= entry->size;
+        }
+
+      evict_entry (pool, entry, "over the size limit");
+    }
+}
+
+static void
+reset_framebuffer_state (CoglFramebuffer *framebuffer,
+                         int              width,
+                         int              height)
+{
+  cogl_framebuffer_set_viewport (framebuffer, 0, 0, width, height);
+  cogl_framebuffer_orthographic (framebuffer, 0, 0, width, height, 0, 1.0);
+  cogl_framebuffer_identity_matrix (framebuffer);
+}
+
+static CoglOffscreen *
+acquire_offscreen (CoglOffscreenPool      *pool,
+                   int                     width,
+                   int                     height,
+                   int                     texture_width,
+                   int                     texture_height,
+                   CoglTextureComponents   components,
+                   GError                **error)
+{
+  g_autoptr (CoglOffscreen) offscreen = NULL;
+  uint64_t key;
+  GQueue *bucket;
+  PoolEntry *entry;
+  CoglTexture2D *texture;
+
+  key = make_key (texture_width, texture_height, components);
+
+  bucket = g_hash_table_lookup (pool->buckets, &key);
+  if (bucket)
+    {
+      entry = g_queue_peek_head (bucket);
+      remove_available_entry (pool, entry);
+
+      pool->stats.n_hits++;
+      goto out;
+    }
+
+  texture = cogl_texture_2d_new_with_size (pool->context,
+                                           texture_width, texture_height);
+  cogl_texture_set_components (COGL_TEXTURE (texture), components);
+  offscreen = cogl_offscreen_new_with_texture (COGL_TEXTURE (texture));
+  cogl_object_unref (texture);
+
+  if (!cogl_framebuffer_allocate (COGL_FRAMEBUFFER (offscreen), error))
+    return NULL;
+
+  COGL_NOTE (OFFSCREEN, "Allocated %dx%d offscreen for the pool",
+             texture_width, texture_height);
+
+  entry = g_new0 (PoolEntry, 1);
+  entry->offscreen = g_steal_pointer (&offscreen);
+  entry->key = key;
+  entry->size = estimate_size (texture_width, texture_height, components);
+  entry->bucket_link.data = entry;
+  entry->lru_link.data = entry;
+
+  pool->stats.n_misses++;
+
+out:
+  reset_framebuffer_state (COGL_FRAMEBUFFER (entry->offscreen),
+                           width, height);
+
+  g_hash_table_insert (pool->in_use, entry->offscreen, entry);
+  pool->stats.n_in_use++;
+  pool->stats.in_use_bytes += entry->size;
+
+  return g_object_ref (entry->offscreen);
+}
+
+CoglOffscreen *
+cogl_offscreen_pool_acquire (CoglOffscreenPool      *pool,
+                             int                     width,
+                             int                     height,
+                             CoglTextureComponents   components,
+                             GError                **error)
+{
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  return acquire_offscreen (pool,
+                            width, height,
+                            width, height,
+                            components,
+                            error);
+}
+
+CoglOffscreen *
+cogl_offscreen_pool_acquire_rounded (CoglOffscreenPool      *pool,
+                                     int                     width,
+                                     int                     height,
+                                     CoglTextureComponents   components,
+                                     GError                **error)
+{
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  return acquire_offscreen (pool,
+                            width, height,
+                            ROUND_UP_TO_BUCKET (width),
+                            ROUND_UP_TO_BUCKET (height),
+                            components,
+                            error);
+}
+
+void
+cogl_offscreen_pool_release (CoglOffscreenPool *pool,
+                             CoglOffscreen     *offscreen)
+{
+  PoolEntry *entry;
+
+  entry = g_hash_table_lookup (pool->in_use, offscreen);
+  g_return_if_fail (entry);
+
+  g_hash_table_steal (pool->in_use, offscreen);
+  pool->stats.n_in_use--;
+  pool->stats.in_use_bytes -= entry->size;
+
+  /* The caller gives back its reference; the entry keeps its own. */
+  g_object_unref (offscreen);
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_OFFSCREEN_POOL)))
+    {
+      pool_entry_free (entry);
+      return;
+    }
+
+  g_queue_push_head (&pool->released, entry);
+  pool->stats.n_pooled++;
+  pool->stats.pooled_bytes += entry->size;
+
+  enforce_max_size (pool);
+}
+
+void
+cogl_offscreen_pool_end_frame (CoglOffscreenPool *pool)
+{
+  PoolEntry *entry;
+
+  COGL_TRACE_BEGIN_SCOPED (CoglOffscreenPoolEndFrame,
+                           "Offscreen pool (end frame)");
+
+  while ((entry = g_queue_pop_tail (&pool->released)))
+    {
+      GQueue *bucket;
+
+      bucket = g_hash_table_lookup (pool->buckets, &entry->key);
+      if (!bucket)
+        {
+          bucket = g_queue_new ();
+          g_hash_table_insert (pool->buckets,
+                               g_memdup2 (&entry->key, sizeof (entry->key)),
+                               bucket);
+        }
+
+      entry->last_used_frame = pool->frame_counter;
+      g_queue_push_head_link (bucket, &entry->bucket_link);
+      g_queue_push_head_link (&pool->lru, &entry->lru_link);
+    }
+
+  pool->frame_counter++;
+
+  while ((entry = g_queue_peek_tail (&pool->lru)) &&
+         pool->frame_counter - entry->last_used_frame > MAX_UNUSED_FRAMES)
+    {
+      remove_available_entry (pool, entry);
+      evict_entry (pool, entry, "unused");
+    }
+
+  if (G_UNLIKELY (cogl_is_tracing_enabled ()))
+    {
+      g_autofree char *description = NULL;
+
+      description =
+        g_strdup_printf ("hits: %" G_GUINT64_FORMAT ", "
+                         "misses: %" G_GUINT64_FORMAT ", "
+                         "evictions: %" G_GUINT64_FORMAT ", "
+                         "pooled: %d (%zu bytes), "
+                         "in use: %d (%zu bytes)",
+                         pool->stats.n_hits,
+                         pool->stats.n_misses,
+                         pool->stats.n_evictions,
+                         pool->stats.n_pooled,
+                         pool->stats.pooled_bytes,
+                         pool->stats.n_in_use,
+                         pool->stats.in_use_bytes);
+      COGL_TRACE_DESCRIBE (CoglOffscreenPoolEndFrame, description);
+    }
+}
+
+void
+cogl_offscreen_pool_set_max_size (CoglOffscreenPool *pool,
+                                  size_t             max_size)
+{
+  pool->max_size = max_size;
+  enforce_max_size (pool);
+}
+
+void
+cogl_offscreen_pool_get_stats (CoglOffscreenPool      *pool,
+                               CoglOffscreenPoolStats *stats)
+{
+  *stats = pool->stats;
+}
+
+CoglOffscreenPool *
+cogl_context_get_offscreen_pool (CoglContext *context)
+{
+  return context->offscreen_pool;
+}
+
+CoglOffscreenPool *
+_cogl_offscreen_pool_new (CoglContext *context)
+{
+  CoglOffscreenPool *pool;
+
+  pool = g_new0 (CoglOffscreenPool, 1);
+  pool->context = context;
+  pool->max_size = DEFAULT_MAX_SIZE;
+  pool->buckets = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                         g_free,
+                                         (GDestroyNotify) g_queue_free);
+  pool->in_use = g_hash_table_new_full (NULL, NULL,
+                                        NULL,
+                                        (GDestroyNotify) pool_entry_free);
+  g_queue_init (&pool->lru);
+  g_queue_init (&pool->released);
+
+  return pool;
+}
+
+void
+_cogl_offscreen_pool_free (CoglOffscreenPool *pool)
+{
+  PoolEntry *entry;
+
+  while ((entry = g_queue_peek_head (&pool->lru)))
+    {
+      remove_available_entry (pool, entry);
+      pool_entry_free (entry);
+    }
+
+  while ((entry = g_queue_pop_head (&pool->released)))
+    pool_entry_free (entry);
+
+  g_hash_table_destroy (pool->buckets);
+  g_hash_table_destroy (pool->in_use);
+  g_free (pool);
+}
@@ -0,0 +1,188 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#if !defined(__COGL_H_INSIDE__) && !defined(COGL_COMPILATION)
+#error "Only <cogl/cogl.h> can be included directly."
+#endif
+
+#ifndef __COGL_OFFSCREEN_POOL_H__
+#define __COGL_OFFSCREEN_POOL_H__
+
+#include <cogl/cogl-context.h>
+#include <cogl/cogl-offscreen.h>
+#include <cogl/cogl-texture.h>
+
+G_BEGIN_DECLS
+
+/**
+ * SECTION:cogl-offscreen-pool
+ * @short_description: Reuse offscreen framebuffers
+ *
+ * The offscreen pool keeps offscreen framebuffers, and the 2D textures they
+ * render into, around after their users are done with them, so that they can
+ * be handed out again instead of allocating new ones.
+ *
+ * Framebuffers are bucketed by size and texture components. A framebuffer
+ * that is released can still be sampled from by rendering that isn't flushed
+ * yet, so it is only handed out again after the next call to
+ * cogl_offscreen_pool_end_frame(). Framebuffers that weren't reused for a
+ * number of frames are freed, as are the least recently used ones when the
+ * pool holds more than its maximum size.
+ */
+
+typedef struct _CoglOffscreenPool CoglOffscreenPool;
+
+/**
+ * CoglOffscreenPoolStats: (skip)
+ * @n_hits: number of acquired framebuffers that were reused
+ * @n_misses: number of acquired framebuffers that had to be allocated
+ * @n_evictions: number of pooled framebuffers that were freed
+ * @n_pooled: number of framebuffers currently held by the pool
+ * @n_in_use: number of framebuffers currently acquired
+ * @pooled_bytes: estimated memory held by the pooled framebuffers
+ * @in_use_bytes: estimated memory used by the acquired framebuffers
+ */
+typedef struct _CoglOffscreenPoolStats
+{
+  uint64_t n_hits;
+  uint64_t n_misses;
+  uint64_t n_evictions;
+  int n_pooled;
+  int n_in_use;
+  size_t pooled_bytes;
+  size_t in_use_bytes;
+} CoglOffscreenPoolStats;
+
+/**
+ * cogl_context_get_offscreen_pool: (skip)
+ * @context: A #CoglContext
+ *
+ * Returns: (transfer none): the offscreen pool of @context
+ */
+COGL_EXPORT CoglOffscreenPool *
+cogl_context_get_offscreen_pool (CoglContext *context);
+
+/**
+ * cogl_offscreen_pool_acquire: (skip)
+ * @pool: A #CoglOffscreenPool
+ * @width: width of the framebuffer
+ * @height: height of the framebuffer
+ * @components: the components of the texture to render into
+ * @error: return location for a #GError
+ *
+ * Retrieves an allocated offscreen framebuffer rendering into a 2D texture
+ * of the given size, reusing a pooled one when possible. The contents of the
+ * framebuffer are undefined. Its viewport covers the whole framebuffer, with
+ * an orthographic projection mapping one unit to one pixel and an identity
+ * modelview matrix.
+ *
+ * Returns: (transfer full): an allocated #CoglOffscreen, or %NULL on failure.
+ *   Give it back with cogl_offscreen_pool_release().
+ */
+COGL_EXPORT CoglOffscreen *
+cogl_offscreen_pool_acquire (CoglOffscreenPool      *pool,
+                             int                     width,
+                             int                     height,
+                             CoglTextureComponents   components,
+                             GError                **error);
+
+/**
+ * cogl_offscreen_pool_acquire_rounded: (skip)
+ * @pool: A #CoglOffscreenPool
+ * @width: width of the area to render into
+ * @height: height of the area to render into
+ * @components: the components of the texture to render into
+ * @error: return location for a #GError
+ *
+ * Like cogl_offscreen_pool_acquire(), but the size of the texture is rounded
+ * up to a multiple of 64 pixels, so that framebuffers of similar sizes can be
+ * reused for each other. The viewport and projection only cover the
+ * @width by @height area at the top left corner of the framebuffer; when
+ * sampling the texture, callers must restrict themselves to that sub-region,
+ * e.g. using texture coordinates of (0, 0) to
+ * (@width / texture width, @height / texture height).
+ *
+ * Returns: (transfer full): an allocated #CoglOffscreen, or %NULL on failure.
+ *   Give it back with cogl_offscreen_pool_release().
+ */
+COGL_EXPORT CoglOffscreen *
+cogl_offscreen_pool_acquire_rounded (CoglOffscreenPool      *pool,
+                                     int                     width,
+                                     int                     height,
+                                     CoglTextureComponents   components,
+                                     GError                **error);
+
+/**
+ * cogl_offscreen_pool_release: (skip)
+ * @pool: A #CoglOffscreenPool
+ * @offscreen: (transfer full): A #CoglOffscreen acquired from @pool
+ *
+ * Gives @offscreen back to @pool. The caller may still hold references to
+ * its texture, e.g. in pipelines used by pending rendering, but must not
+ * render into it anymore.
+ */
+COGL_EXPORT void
+cogl_offscreen_pool_release (CoglOffscreenPool *pool,
+                             CoglOffscreen     *offscreen);
+
+/**
+ * cogl_offscreen_pool_end_frame: (skip)
+ * @pool: A #CoglOffscreenPool
+ *
+ * Notifies @pool that a frame was completed, and that all rendering which
+ * may sample from released framebuffers has been flushed. Released
+ * framebuffers become available again, and framebuffers unused for too long
+ * are freed.
+ */
+COGL_EXPORT void
+cogl_offscreen_pool_end_frame (CoglOffscreenPool *pool);
+
+/**
+ * cogl_offscreen_pool_set_max_size: (skip)
+ * @pool: A #CoglOffscreenPool
+ * @max_size: the maximum amount of memory to hold, in bytes
+ *
+ * Sets the maximum amount of memory the framebuffers held by @pool may use.
+ * Framebuffers currently acquired don't count towards it.
+ */
+COGL_EXPORT void
+cogl_offscreen_pool_set_max_size (CoglOffscreenPool *pool,
+                                  size_t             max_size);
+
+/**
+ * cogl_offscreen_pool_get_stats: (skip)
+ * @pool: A #CoglOffscreenPool
+ * @stats: (out caller-allocates): return location for the statistics
+ */
+COGL_EXPORT void
+cogl_offscreen_pool_get_stats (CoglOffscreenPool      *pool,
+                               CoglOffscreenPoolStats *stats);
+
+G_END_DECLS
+
+#endif /* __COGL_OFFSCREEN_POOL_H__ */
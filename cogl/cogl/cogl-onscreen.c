@@ -340,6 +340,8 @@ cogl_onscreen_swap_buffers_with_damage (CoglOnscreen *onscreen,
                                    info,
                                    user_data);
 
+  _cogl_journal_end_frame (cogl_framebuffer_get_context (framebuffer));
+
   cogl_framebuffer_discard_buffers (framebuffer,
                                     COGL_BUFFER_BIT_COLOR |
                                     COGL_BUFFER_BIT_DEPTH |
@@ -401,6 +403,8 @@ cogl_onscreen_swap_region (CoglOnscreen *onscreen,
                       info,
                       user_data);
 
+  _cogl_journal_end_frame (cogl_framebuffer_get_context (framebuffer));
+
   cogl_framebuffer_discard_buffers (framebuffer,
                                     COGL_BUFFER_BIT_COLOR |
                                     COGL_BUFFER_BIT_DEPTH |
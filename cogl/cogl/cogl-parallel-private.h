@@ -0,0 +1,52 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COGL_PARALLEL_PRIVATE_H
+#define COGL_PARALLEL_PRIVATE_H
+
+#include <glib.h>
+
+typedef void (* CoglParallelFunc) (int   first,
+                                   int   n_items,
+                                   void *user_data);
+
+/* Returns the number of tasks work can usefully be split into, including
+ * the one run by the calling thread */
+int
+_cogl_parallel_get_max_tasks (void);
+
+/* Splits @n_items into @n_tasks contiguous ranges and calls @func for each
+ * of them, the first one from the calling thread and the others from a
+ * shared thread pool. Returns once all the ranges are processed. */
+void
+_cogl_parallel_for (int              n_items,
+                    int              n_tasks,
+                    CoglParallelFunc func,
+                    void            *user_data);
+
+#endif /* COGL_PARALLEL_PRIVATE_H */
@@ -0,0 +1,143 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cogl-config.h"
+
+#include "cogl-parallel-private.h"
+
+#include <stdint.h>
+
+#define MAX_TASKS 8
+
+typedef struct
+{
+  CoglParallelFunc func;
+  void *user_data;
+
+  GMutex mutex;
+  GCond cond;
+  int n_pending;
+} ParallelJob;
+
+typedef struct
+{
+  ParallelJob *job;
+  int first;
+  int n_items;
+} ParallelTask;
+
+static void
+run_task (gpointer data,
+          gpointer user_data)
+{
+  ParallelTask *task = data;
+  ParallelJob *job = task->job;
+
+  job->func (task->first, task->n_items, job->user_data);
+
+  g_mutex_lock (&job->mutex);
+  if (--job->n_pending == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->mutex);
+}
+
+static GThreadPool *
+get_thread_pool (void)
+{
+  static GThreadPool *thread_pool = NULL;
+
+  if (g_once_init_enter (&thread_pool))
+    {
+      GThreadPool *new_thread_pool;
+
+      new_thread_pool = g_thread_pool_new (run_task, NULL,
+                                           MAX_TASKS - 1, FALSE,
+                                           NULL);
+      g_once_init_leave (&thread_pool, new_thread_pool);
+    }
+
+  return thread_pool;
+}
+
+int
+_cogl_parallel_get_max_tasks (void)
+{
+  return CLAMP ((int) g_get_num_processors (), 1, MAX_TASKS);
+}
+
+void
+_cogl_parallel_for (int              n_items,
+                    int              n_tasks,
+                    CoglParallelFunc func,
+                    void            *user_data)
+{
+  ParallelTask tasks[MAX_TASKS];
+  ParallelJob job;
+  GThreadPool *thread_pool;
+  int i;
+
+  n_tasks = MIN (n_tasks, _cogl_parallel_get_max_tasks ());
+  n_tasks = MIN (n_tasks, n_items);
+
+  if (n_tasks < 2)
+    {
+      if (n_items > 0)
+        func (0, n_items, user_data);
+      return;
+    }
+
+  job.func = func;
+  job.user_data = user_data;
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+  job.n_pending = n_tasks - 1;
+
+  thread_pool = get_thread_pool ();
+
+  for (i = 0; i < n_tasks; i++)
+    {
+      tasks[i].job = &job;
+      tasks[i].first = (int) (((int64_t) n_items * i) / n_tasks);
+      tasks[i].n_items =
+        (int) (((int64_t) n_items * (i + 1)) / n_tasks) - tasks[i].first;
+    }
+
+  /* The first task is run by the calling thread */
+  for (i = 1; i < n_tasks; i++)
+    g_thread_pool_push (thread_pool, &tasks[i], NULL);
+
+  func (tasks[0].first, tasks[0].n_items, user_data);
+
+  g_mutex_lock (&job.mutex);
+  while (job.n_pending > 0)
+    g_cond_wait (&job.cond, &job.mutex);
+  g_mutex_unlock (&job.mutex);
+
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+}
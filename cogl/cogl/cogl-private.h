@@ -58,6 +58,9 @@ typedef enum
   COGL_PRIVATE_FEATURE_TEXTURE_SWIZZLE,
   COGL_PRIVATE_FEATURE_TEXTURE_MAX_LEVEL,
   COGL_PRIVATE_FEATURE_OES_EGL_SYNC,
+  /* Sub-regions of buffers can be mapped without the driver waiting for
+   * pending rendering to complete */
+  COGL_PRIVATE_FEATURE_MAP_BUFFER_RANGE,
   /* If this is set then the winsys is responsible for queueing dirty
    * events. Otherwise a dirty event will be queued when the onscreen
    * is first allocated or when it is shown or resized */
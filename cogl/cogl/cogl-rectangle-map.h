@@ -45,12 +45,12 @@ struct _CoglRectangleMapEntry
   unsigned int width, height;
 };
 
-CoglRectangleMap *
+COGL_EXPORT CoglRectangleMap *
 _cogl_rectangle_map_new (unsigned int width,
                          unsigned int height,
                          GDestroyNotify value_destroy_func);
 
-gboolean
+COGL_EXPORT gboolean
 _cogl_rectangle_map_add (CoglRectangleMap *map,
                          unsigned int width,
                          unsigned int height,
@@ -78,7 +78,7 @@ _cogl_rectangle_map_foreach (CoglRectangleMap *map,
                              CoglRectangleMapCallback callback,
                              void *data);
 
-void
+COGL_EXPORT void
 _cogl_rectangle_map_free (CoglRectangleMap *map);
 
 #endif /* __COGL_RECTANGLE_MAP_H */
@@ -359,7 +359,7 @@ _cogl_texture_set_region (CoglTexture *texture,
                           int level,
                           GError **error);
 
-gboolean
+COGL_EXPORT gboolean
 _cogl_texture_set_region_from_bitmap (CoglTexture *texture,
                                       int src_x,
                                       int src_y,
@@ -398,6 +398,19 @@ _cogl_texture_set_allocated (CoglTexture *texture,
 COGL_EXPORT CoglPixelFormat
 _cogl_texture_get_format (CoglTexture *texture);
 
+/*
+ * _cogl_texture_get_upload_format:
+ * @texture: a #CoglTexture
+ * @src_format: the format of data to be uploaded
+ *
+ * Returns: the format that data in @src_format is converted to before
+ *   being handed to the driver. Uploading data that is already in this
+ *   format doesn't require any conversion by Cogl.
+ */
+COGL_EXPORT CoglPixelFormat
+_cogl_texture_get_upload_format (CoglTexture *texture,
+                                 CoglPixelFormat src_format);
+
 CoglTextureLoader *
 _cogl_texture_create_loader (void);
 
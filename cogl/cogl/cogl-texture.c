@@ -214,6 +214,15 @@ _cogl_texture_get_format (CoglTexture *texture)
   return texture->vtable->get_format (texture);
 }
 
+CoglPixelFormat
+_cogl_texture_get_upload_format (CoglTexture *texture,
+                                 CoglPixelFormat src_format)
+{
+  return _cogl_bitmap_get_upload_format (texture->context,
+                                         src_format,
+                                         _cogl_texture_get_format (texture));
+}
+
 int
 cogl_texture_get_max_waste (CoglTexture *texture)
 {
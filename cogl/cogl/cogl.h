@@ -113,6 +113,7 @@
 #include <cogl/cogl-pipeline-layer-state.h>
 #include <cogl/cogl-snippet.h>
 #include <cogl/cogl-framebuffer.h>
+#include <cogl/cogl-offscreen-pool.h>
 #include <cogl/cogl-onscreen.h>
 #include <cogl/cogl-frame-info.h>
 #include <cogl/cogl-poll.h>
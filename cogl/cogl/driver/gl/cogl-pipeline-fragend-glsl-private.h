@@ -41,5 +41,11 @@ extern const CoglPipelineFragend _cogl_pipeline_glsl_fragend;
 GLuint
 _cogl_pipeline_fragend_glsl_get_shader (CoglPipeline *pipeline);
 
+const char *
+_cogl_pipeline_fragend_glsl_get_source_checksum (CoglPipeline *pipeline);
+
+void
+_cogl_pipeline_fragend_glsl_ensure_compiled (CoglPipeline *pipeline);
+
 #endif /* __COGL_PIPELINE_FRAGEND_GLSL_PRIVATE_H */
 
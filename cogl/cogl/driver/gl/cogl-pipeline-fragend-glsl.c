@@ -89,6 +89,10 @@ typedef struct
   int ref_count;
 
   GLuint gl_shader;
+  gboolean compiled;
+  /* Checksum of the complete shader source, only computed when there is
+     a program binary cache */
+  char *source_checksum;
   GString *header, *source;
   UnitState *unit_state;
 
@@ -143,6 +147,7 @@ destroy_shader_state (void *user_data,
     {
       if (shader_state->gl_shader)
         GE( ctx, glDeleteShader (shader_state->gl_shader) );
+      g_free (shader_state->source_checksum);
 
       g_free (shader_state->unit_state);
 
@@ -190,6 +195,31 @@ _cogl_pipeline_fragend_glsl_get_shader (CoglPipeline *pipeline)
     return 0;
 }
 
+const char *
+_cogl_pipeline_fragend_glsl_get_source_checksum (CoglPipeline *pipeline)
+{
+  CoglPipelineShaderState *shader_state = get_shader_state (pipeline);
+
+  if (shader_state)
+    return shader_state->source_checksum;
+  else
+    return NULL;
+}
+
+void
+_cogl_pipeline_fragend_glsl_ensure_compiled (CoglPipeline *pipeline)
+{
+  CoglPipelineShaderState *shader_state = get_shader_state (pipeline);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  if (!shader_state || !shader_state->gl_shader || shader_state->compiled)
+    return;
+
+  _cogl_glsl_shader_compile (ctx, shader_state->gl_shader);
+  shader_state->compiled = TRUE;
+}
+
 static CoglPipelineSnippetList *
 get_fragment_snippets (CoglPipeline *pipeline)
 {
@@ -982,8 +1012,8 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
     {
       const char *source_strings[2];
       GLint lengths[2];
-      GLint compile_status;
       GLuint shader;
+      CoglProgramBinaryCache *binary_cache;
       CoglPipelineSnippetData snippet_data;
 
       COGL_STATIC_COUNTER (fragend_glsl_compile_counter,
@@ -1044,29 +1074,27 @@ _cogl_pipeline_fragend_glsl_end (CoglPipeline *pipeline,
       lengths[1] = shader_state->source->len;
       source_strings[1] = shader_state->source->str;
 
+      binary_cache = _cogl_driver_gl_context (ctx)->program_binary_cache;
+
+      g_clear_pointer (&shader_state->source_checksum, g_free);
       _cogl_glsl_shader_set_source_with_boilerplate (ctx,
                                                      shader, GL_FRAGMENT_SHADER,
                                                      pipeline,
                                                      2, /* count */
-                                                     source_strings, lengths);
-
-      GE( ctx, glCompileShader (shader) );
-      GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS, &compile_status) );
-
-      if (!compile_status)
-        {
-          GLint len = 0;
-          char *shader_log;
-
-          GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
-          shader_log = g_alloca (len);
-          GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
-          g_warning ("Shader compilation failed:\n%s", shader_log);
-        }
+                                                     source_strings, lengths,
+                                                     binary_cache ?
+                                                     &shader_state->source_checksum :
+                                                     NULL);
 
       shader_state->header = NULL;
       shader_state->source = NULL;
       shader_state->gl_shader = shader;
+      shader_state->compiled = FALSE;
+
+      /* With a program binary cache, compiling is left to the progend,
+       * which can skip it when the linked program is found in the cache */
+      if (!binary_cache)
+        _cogl_pipeline_fragend_glsl_ensure_compiled (pipeline);
     }
 
   return TRUE;
@@ -153,7 +153,13 @@ _cogl_glsl_shader_set_source_with_boilerplate (CoglContext *ctx,
                                                CoglPipeline *pipeline,
                                                GLsizei count_in,
                                                const char **strings_in,
-                                               const GLint *lengths_in);
+                                               const GLint *lengths_in,
+                                               char **source_checksum);
+
+/* Compiles the shader, and warns if compiling failed */
+void
+_cogl_glsl_shader_compile (CoglContext *ctx,
+                           GLuint shader_gl_handle);
 
 void
 _cogl_sampler_gl_init (CoglContext *context,
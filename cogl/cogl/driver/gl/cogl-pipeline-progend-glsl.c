@@ -51,8 +51,13 @@
 #include "driver/gl/cogl-pipeline-fragend-glsl-private.h"
 #include "driver/gl/cogl-pipeline-vertend-glsl-private.h"
 #include "driver/gl/cogl-pipeline-progend-glsl-private.h"
+#include "driver/gl/cogl-program-binary-cache-private.h"
 #include "deprecated/cogl-program-private.h"
 
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
 /* These are used to generalise updating some uniforms that are
    required when building for drivers missing some fixed function
    state that we use */
@@ -312,7 +317,7 @@ dirty_program_state (CoglPipeline *pipeline)
                              NULL);
 }
 
-static void
+static gboolean
 link_program (GLint gl_program)
 {
   GLint link_status;
@@ -341,6 +346,8 @@ link_program (GLint gl_program)
 
       g_free (log);
     }
+
+  return link_status;
 }
 
 typedef struct
@@ -687,6 +694,7 @@ _cogl_shader_compile_real (CoglHandle handle,
                                                  1,
                                                  (const char **)
                                                   &shader->source,
+                                                 NULL,
                                                  NULL);
   GE (ctx, glCompileShader (shader->gl_handle));
 
@@ -787,11 +795,41 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
 
   if (program_state->program == 0)
     {
+      CoglProgramBinaryCache *binary_cache =
+        _cogl_driver_gl_context (ctx)->program_binary_cache;
+      g_autofree char *binary_key = NULL;
       GLuint backend_shader;
       GSList *l;
 
       GE_RET( program_state->program, ctx, glCreateProgram () );
 
+      /* Programs using the deprecated CoglProgram API aren't cached, as
+       * their shaders are compiled from user sources on the fly */
+      if (binary_cache && !user_program)
+        {
+          const char *source_checksums[2];
+          int n_source_checksums = 0;
+          const char *source_checksum;
+
+          if ((source_checksum =
+               _cogl_pipeline_fragend_glsl_get_source_checksum (pipeline)))
+            source_checksums[n_source_checksums++] = source_checksum;
+          if ((source_checksum =
+               _cogl_pipeline_vertend_glsl_get_source_checksum (pipeline)))
+            source_checksums[n_source_checksums++] = source_checksum;
+
+          binary_key =
+            _cogl_program_binary_cache_compute_key (binary_cache,
+                                                    source_checksums,
+                                                    n_source_checksums);
+        }
+
+      if (binary_key &&
+          _cogl_program_binary_cache_load (binary_cache,
+                                           binary_key,
+                                           program_state->program))
+        goto linked;
+
       /* Attach all of the shader from the user program */
       if (user_program)
         {
@@ -808,7 +846,10 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
           program_state->user_program_age = user_program->age;
         }
 
-      /* Attach any shaders from the GLSL backends */
+      /* Attach any shaders from the GLSL backends, compiling them first
+       * if that was left until they're needed */
+      _cogl_pipeline_fragend_glsl_ensure_compiled (pipeline);
+      _cogl_pipeline_vertend_glsl_ensure_compiled (pipeline);
       if ((backend_shader = _cogl_pipeline_fragend_glsl_get_shader (pipeline)))
         GE( ctx, glAttachShader (program_state->program, backend_shader) );
       if ((backend_shader = _cogl_pipeline_vertend_glsl_get_shader (pipeline)))
@@ -821,8 +862,17 @@ _cogl_pipeline_progend_glsl_end (CoglPipeline *pipeline,
       GE( ctx, glBindAttribLocation (program_state->program,
                                      0, "cogl_position_in"));
 
-      link_program (program_state->program);
+      if (binary_key && ctx->glProgramParameteri)
+        GE( ctx, glProgramParameteri (program_state->program,
+                                      GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                      GL_TRUE) );
+
+      if (link_program (program_state->program) && binary_key)
+        _cogl_program_binary_cache_store (binary_cache,
+                                          binary_key,
+                                          program_state->program);
 
+    linked:
       program_changed = TRUE;
     }
 
@@ -56,6 +56,10 @@ typedef struct
   unsigned int ref_count;
 
   GLuint gl_shader;
+  gboolean compiled;
+  /* Checksum of the complete shader source, only computed when there is
+     a program binary cache */
+  char *source_checksum;
   GString *header, *source;
 
   CoglPipelineCacheEntry *cache_entry;
@@ -97,6 +101,7 @@ destroy_shader_state (void *user_data,
     {
       if (shader_state->gl_shader)
         GE( ctx, glDeleteShader (shader_state->gl_shader) );
+      g_free (shader_state->source_checksum);
 
       g_free (shader_state);
     }
@@ -169,7 +174,8 @@ _cogl_glsl_shader_set_source_with_boilerplate (CoglContext *ctx,
                                                CoglPipeline *pipeline,
                                                GLsizei count_in,
                                                const char **strings_in,
-                                               const GLint *lengths_in)
+                                               const GLint *lengths_in,
+                                               char **source_checksum)
 {
   const char *vertex_boilerplate;
   const char *fragment_boilerplate;
@@ -274,8 +280,46 @@ _cogl_glsl_shader_set_source_with_boilerplate (CoglContext *ctx,
   GE( ctx, glShaderSource (shader_gl_handle, count,
                            (const char **) strings, lengths) );
 
+  if (source_checksum)
+    {
+      GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA256);
+      int i;
+
+      g_checksum_update (checksum,
+                         (const guchar *) &shader_gl_type,
+                         sizeof (shader_gl_type));
+      for (i = 0; i < count; i++)
+        g_checksum_update (checksum, (const guchar *) strings[i], lengths[i]);
+
+      *source_checksum = g_strdup (g_checksum_get_string (checksum));
+      g_checksum_free (checksum);
+    }
+
   g_free (version_string);
 }
+
+void
+_cogl_glsl_shader_compile (CoglContext *ctx,
+                           GLuint shader_gl_handle)
+{
+  GLint compile_status;
+
+  GE( ctx, glCompileShader (shader_gl_handle) );
+  GE( ctx, glGetShaderiv (shader_gl_handle, GL_COMPILE_STATUS,
+                          &compile_status) );
+
+  if (!compile_status)
+    {
+      GLint len = 0;
+      char *shader_log;
+
+      GE( ctx, glGetShaderiv (shader_gl_handle, GL_INFO_LOG_LENGTH, &len) );
+      shader_log = g_alloca (len);
+      GE( ctx, glGetShaderInfoLog (shader_gl_handle, len, &len, shader_log) );
+      g_warning ("Shader compilation failed:\n%s", shader_log);
+    }
+}
+
 GLuint
 _cogl_pipeline_vertend_glsl_get_shader (CoglPipeline *pipeline)
 {
@@ -287,6 +331,31 @@ _cogl_pipeline_vertend_glsl_get_shader (CoglPipeline *pipeline)
     return 0;
 }
 
+const char *
+_cogl_pipeline_vertend_glsl_get_source_checksum (CoglPipeline *pipeline)
+{
+  CoglPipelineShaderState *shader_state = get_shader_state (pipeline);
+
+  if (shader_state)
+    return shader_state->source_checksum;
+  else
+    return NULL;
+}
+
+void
+_cogl_pipeline_vertend_glsl_ensure_compiled (CoglPipeline *pipeline)
+{
+  CoglPipelineShaderState *shader_state = get_shader_state (pipeline);
+
+  _COGL_GET_CONTEXT (ctx, NO_RETVAL);
+
+  if (!shader_state || !shader_state->gl_shader || shader_state->compiled)
+    return;
+
+  _cogl_glsl_shader_compile (ctx, shader_state->gl_shader);
+  shader_state->compiled = TRUE;
+}
+
 static CoglPipelineSnippetList *
 get_vertex_snippets (CoglPipeline *pipeline)
 {
@@ -554,8 +623,8 @@ _cogl_pipeline_vertend_glsl_end (CoglPipeline *pipeline,
     {
       const char *source_strings[2];
       GLint lengths[2];
-      GLint compile_status;
       GLuint shader;
+      CoglProgramBinaryCache *binary_cache;
       CoglPipelineSnippetData snippet_data;
       CoglPipelineSnippetList *vertex_snippets;
       gboolean has_per_vertex_point_size =
@@ -659,29 +728,27 @@ _cogl_pipeline_vertend_glsl_end (CoglPipeline *pipeline,
       lengths[1] = shader_state->source->len;
       source_strings[1] = shader_state->source->str;
 
+      binary_cache = _cogl_driver_gl_context (ctx)->program_binary_cache;
+
+      g_clear_pointer (&shader_state->source_checksum, g_free);
       _cogl_glsl_shader_set_source_with_boilerplate (ctx,
                                                      shader, GL_VERTEX_SHADER,
                                                      pipeline,
                                                      2, /* count */
-                                                     source_strings, lengths);
-
-      GE( ctx, glCompileShader (shader) );
-      GE( ctx, glGetShaderiv (shader, GL_COMPILE_STATUS, &compile_status) );
-
-      if (!compile_status)
-        {
-          GLint len = 0;
-          char *shader_log;
-
-          GE( ctx, glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &len) );
-          shader_log = g_alloca (len);
-          GE( ctx, glGetShaderInfoLog (shader, len, &len, shader_log) );
-          g_warning ("Shader compilation failed:\n%s", shader_log);
-        }
+                                                     source_strings, lengths,
+                                                     binary_cache ?
+                                                     &shader_state->source_checksum :
+                                                     NULL);
 
       shader_state->header = NULL;
       shader_state->source = NULL;
       shader_state->gl_shader = shader;
+      shader_state->compiled = FALSE;
+
+      /* With a program binary cache, compiling is left to the progend,
+       * which can skip it when the linked program is found in the cache */
+      if (!binary_cache)
+        _cogl_pipeline_vertend_glsl_ensure_compiled (pipeline);
     }
 
   return TRUE;
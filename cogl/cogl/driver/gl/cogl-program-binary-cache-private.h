@@ -0,0 +1,83 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __COGL_PROGRAM_BINARY_CACHE_PRIVATE_H
+#define __COGL_PROGRAM_BINARY_CACHE_PRIVATE_H
+
+#include "cogl-context.h"
+#include "cogl-gl-header.h"
+
+typedef struct _CoglProgramBinaryCache CoglProgramBinaryCache;
+
+/*
+ * Returns %NULL if the driver can't retrieve program binaries, or if the
+ * cache is disabled.
+ */
+CoglProgramBinaryCache *
+_cogl_program_binary_cache_new (CoglContext *context,
+                                const char  *path,
+                                uint64_t     max_size);
+
+void
+_cogl_program_binary_cache_free (CoglProgramBinaryCache *cache);
+
+/*
+ * Waits for the cache to be read from disk, and for all pending writes.
+ */
+void
+_cogl_program_binary_cache_flush (CoglProgramBinaryCache *cache);
+
+/*
+ * Computes the key identifying a program linked from shaders with the
+ * given source checksums, with the attribute bindings Cogl always sets up.
+ */
+char *
+_cogl_program_binary_cache_compute_key (CoglProgramBinaryCache  *cache,
+                                        const char             **source_checksums,
+                                        int                      n_source_checksums);
+
+/*
+ * Loads the binary stored for @key into @gl_program. Returns %TRUE if the
+ * program was successfully linked that way. This never waits for the disk;
+ * entries that haven't been read yet are not found.
+ */
+gboolean
+_cogl_program_binary_cache_load (CoglProgramBinaryCache *cache,
+                                 const char             *key,
+                                 GLuint                  gl_program);
+
+/*
+ * Retrieves the binary of the linked @gl_program, and queues writing it
+ * to disk.
+ */
+void
+_cogl_program_binary_cache_store (CoglProgramBinaryCache *cache,
+                                  const char             *key,
+                                  GLuint                  gl_program);
+
+#endif /* __COGL_PROGRAM_BINARY_CACHE_PRIVATE_H */
@@ -0,0 +1,1076 @@
+/*
+ * Cogl
+ *
+ * A Low Level GPU Graphics and Utilities API
+ *
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Linking GLSL programs is expensive, and most of the programs Cogl
+ * generates are the same from one session to the next. When the driver
+ * supports retrieving program binaries, the linked programs are stored
+ * on disk, keyed by a checksum of their shader sources and the identity
+ * of the driver, so that later sessions can load them instead of
+ * compiling and linking the shaders again.
+ *
+ * Each entry is a small header, followed by the binary as returned by the
+ * driver. The header carries a checksum of the binary, so that truncated
+ * or otherwise corrupted entries are detected and discarded. Drivers may
+ * still reject a binary (e.g. after an update that didn't change the
+ * version strings), in which case the entry is discarded as well and the
+ * program is linked from source.
+ *
+ * Pipelines are flushed from the thread painting, so all file access
+ * happens in a worker thread. It reads the entries into memory when the
+ * cache is created, and lookups only check what was read so far. Writing
+ * new entries, marking entries as used and eviction are queued to the
+ * worker as well.
+ */
+
+#include "cogl-config.h"
+
+#include "driver/gl/cogl-program-binary-cache-private.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <test-fixtures/test-unit.h>
+
+#include "cogl-context-private.h"
+#include "cogl-debug.h"
+#include "driver/gl/cogl-pipeline-opengl-private.h"
+#include "driver/gl/cogl-util-gl-private.h"
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+/* Bump when changing the entry format, or anything affecting how programs
+ * are linked that isn't part of the shader sources. */
+#define PROGRAM_BINARY_CACHE_VERSION 1
+
+#define PROGRAM_BINARY_MAGIC "CoglPBin"
+#define PROGRAM_BINARY_DIGEST_LENGTH 32
+#define PROGRAM_BINARY_SUFFIX ".bin"
+
+typedef struct _ProgramBinaryHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t binary_format;
+  uint32_t binary_length;
+  uint8_t digest[PROGRAM_BINARY_DIGEST_LENGTH];
+} ProgramBinaryHeader;
+
+typedef enum _JobType
+{
+  JOB_TYPE_LOAD,
+  JOB_TYPE_WRITE,
+  JOB_TYPE_TOUCH,
+  JOB_TYPE_REMOVE,
+} JobType;
+
+typedef struct _Job
+{
+  JobType type;
+  char *key;
+  GBytes *contents;
+} Job;
+
+struct _CoglProgramBinaryCache
+{
+  CoglContext *context;
+
+  char *path;
+  uint64_t max_size;
+
+  /* Checksum of everything about the driver that affects the binaries */
+  char *driver_checksum;
+
+  /* Only accessed from the worker thread */
+  gboolean size_known;
+  uint64_t total_size;
+
+  GThreadPool *thread_pool;
+
+  GMutex jobs_mutex;
+  GCond jobs_cond;
+  int n_pending_jobs;
+
+  GMutex entries_mutex;
+  /* Key -> GBytes with the contents of the entry, filled by the worker
+   * thread. Entries are handed over when they're used. */
+  GHashTable *loaded_entries;
+  /* Keys of the entries that are on disk, or are about to be written */
+  GHashTable *stored_keys;
+};
+
+typedef struct _CacheEntry
+{
+  char *path;
+  uint64_t size;
+  int64_t mtime;
+} CacheEntry;
+
+static void
+job_free (Job *job)
+{
+  g_free (job->key);
+  g_clear_pointer (&job->contents, g_bytes_unref);
+  g_free (job);
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_free (entry->path);
+  g_free (entry);
+}
+
+static char *
+compute_driver_checksum (CoglContext *ctx)
+{
+  g_autoptr (GChecksum) checksum = NULL;
+  const char *strings[3];
+  int i;
+
+  strings[0] = (const char *) ctx->glGetString (GL_VENDOR);
+  strings[1] = (const char *) ctx->glGetString (GL_RENDERER);
+  strings[2] = (const char *) ctx->glGetString (GL_VERSION);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+
+  for (i = 0; i < G_N_ELEMENTS (strings); i++)
+    {
+      if (!strings[i])
+        return NULL;
+
+      /* Include the terminator to keep the strings apart */
+      g_checksum_update (checksum,
+                         (const guchar *) strings[i],
+                         strlen (strings[i]) + 1);
+    }
+
+  g_checksum_update (checksum,
+                     (const guchar *) &ctx->driver,
+                     sizeof (ctx->driver));
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+static char *
+get_entry_path (CoglProgramBinaryCache *cache,
+                const char             *key)
+{
+  g_autofree char *file_name = NULL;
+
+  file_name = g_strconcat (key, PROGRAM_BINARY_SUFFIX, NULL);
+
+  return g_build_filename (cache->path, file_name, NULL);
+}
+
+static char *
+get_entry_key (const char *file_name)
+{
+  return g_strndup (file_name,
+                    strlen (file_name) - strlen (PROGRAM_BINARY_SUFFIX));
+}
+
+static void
+compute_binary_digest (const uint8_t *binary,
+                       size_t         binary_length,
+                       uint8_t       *digest)
+{
+  g_autoptr (GChecksum) checksum = NULL;
+  gsize digest_length = PROGRAM_BINARY_DIGEST_LENGTH;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, binary, binary_length);
+  g_checksum_get_digest (checksum, digest, &digest_length);
+}
+
+static GBytes *
+create_entry_contents (uint32_t       binary_format,
+                       const uint8_t *binary,
+                       size_t         binary_length)
+{
+  ProgramBinaryHeader header = { 0 };
+  uint8_t *contents;
+
+  memcpy (header.magic, PROGRAM_BINARY_MAGIC, sizeof (header.magic));
+  header.version = PROGRAM_BINARY_CACHE_VERSION;
+  header.binary_format = binary_format;
+  header.binary_length = binary_length;
+  compute_binary_digest (binary, binary_length, header.digest);
+
+  contents = g_malloc (sizeof (header) + binary_length);
+  memcpy (contents, &header, sizeof (header));
+  memcpy (contents + sizeof (header), binary, binary_length);
+
+  return g_bytes_new_take (contents, sizeof (header) + binary_length);
+}
+
+static gboolean
+is_entry_valid (const char *contents,
+                size_t      length)
+{
+  ProgramBinaryHeader header;
+  uint8_t digest[PROGRAM_BINARY_DIGEST_LENGTH];
+
+  if (length < sizeof (header))
+    return FALSE;
+
+  memcpy (&header, contents, sizeof (header));
+
+  if (memcmp (header.magic, PROGRAM_BINARY_MAGIC, sizeof (header.magic)) != 0)
+    return FALSE;
+
+  if (header.version != PROGRAM_BINARY_CACHE_VERSION)
+    return FALSE;
+
+  if (header.binary_length != length - sizeof (header))
+    return FALSE;
+
+  compute_binary_digest ((const uint8_t *) contents + sizeof (header),
+                         header.binary_length,
+                         digest);
+
+  return memcmp (digest, header.digest, sizeof (digest)) == 0;
+}
+
+static gint
+compare_entries_by_mtime (gconstpointer a,
+                          gconstpointer b)
+{
+  const CacheEntry *entry_a = *(const CacheEntry **) a;
+  const CacheEntry *entry_b = *(const CacheEntry **) b;
+
+  if (entry_a->mtime < entry_b->mtime)
+    return -1;
+  else if (entry_a->mtime > entry_b->mtime)
+    return 1;
+  else
+    return 0;
+}
+
+static gint
+compare_entries_by_mtime_reversed (gconstpointer a,
+                                   gconstpointer b)
+{
+  return compare_entries_by_mtime (b, a);
+}
+
+static GPtrArray *
+list_entries (CoglProgramBinaryCache *cache,
+              uint64_t               *out_total_size)
+{
+  GPtrArray *entries;
+  GDir *dir;
+  const char *name;
+  uint64_t total_size = 0;
+
+  entries = g_ptr_array_new_with_free_func ((GDestroyNotify) cache_entry_free);
+
+  dir = g_dir_open (cache->path, 0, NULL);
+  if (!dir)
+    goto out;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      CacheEntry *entry;
+      GStatBuf stat_buf;
+      char *path;
+
+      if (!g_str_has_suffix (name, PROGRAM_BINARY_SUFFIX))
+        continue;
+
+      path = g_build_filename (cache->path, name, NULL);
+      if (g_stat (path, &stat_buf) != 0)
+        {
+          g_free (path);
+          continue;
+        }
+
+      entry = g_new0 (CacheEntry, 1);
+      entry->path = path;
+      entry->size = stat_buf.st_size;
+      entry->mtime = stat_buf.st_mtime;
+      g_ptr_array_add (entries, entry);
+
+      total_size += entry->size;
+    }
+
+  g_dir_close (dir);
+
+out:
+  *out_total_size = total_size;
+  return entries;
+}
+
+static void
+remove_entry (CoglProgramBinaryCache *cache,
+              const char             *path,
+              uint64_t                size)
+{
+  g_autofree char *file_name = NULL;
+  g_autofree char *key = NULL;
+
+  if (g_unlink (path) != 0)
+    return;
+
+  cache->total_size -= MIN (size, cache->total_size);
+
+  file_name = g_path_get_basename (path);
+  key = get_entry_key (file_name);
+
+  g_mutex_lock (&cache->entries_mutex);
+  g_hash_table_remove (cache->loaded_entries, key);
+  g_hash_table_remove (cache->stored_keys, key);
+  g_mutex_unlock (&cache->entries_mutex);
+}
+
+static void
+load_entries (CoglProgramBinaryCache *cache)
+{
+  g_autoptr (GPtrArray) entries = NULL;
+  uint64_t loaded_size = 0;
+  unsigned int i;
+
+  entries = list_entries (cache, &cache->total_size);
+  cache->size_known = TRUE;
+
+  /* Read the most recently used entries first, in case the cache holds
+   * more than we're willing to keep in memory */
+  g_ptr_array_sort (entries, compare_entries_by_mtime_reversed);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      CacheEntry *entry = g_ptr_array_index (entries, i);
+      g_autofree char *file_name = NULL;
+      g_autofree char *key = NULL;
+      char *contents;
+      gsize length;
+
+      file_name = g_path_get_basename (entry->path);
+      key = get_entry_key (file_name);
+
+      if (loaded_size + entry->size > cache->max_size)
+        {
+          g_mutex_lock (&cache->entries_mutex);
+          g_hash_table_add (cache->stored_keys, g_steal_pointer (&key));
+          g_mutex_unlock (&cache->entries_mutex);
+          continue;
+        }
+
+      if (!g_file_get_contents (entry->path, &contents, &length, NULL))
+        continue;
+
+      if (!is_entry_valid (contents, length))
+        {
+          g_warning ("Discarding invalid program binary cache entry %s",
+                     entry->path);
+          g_free (contents);
+          remove_entry (cache, entry->path, entry->size);
+          continue;
+        }
+
+      loaded_size += length;
+
+      g_mutex_lock (&cache->entries_mutex);
+      g_hash_table_add (cache->stored_keys, g_strdup (key));
+      g_hash_table_insert (cache->loaded_entries,
+                           g_steal_pointer (&key),
+                           g_bytes_new_take (contents, length));
+      g_mutex_unlock (&cache->entries_mutex);
+    }
+}
+
+static void
+maybe_evict_entries (CoglProgramBinaryCache *cache,
+                     const char             *written_path)
+{
+  g_autoptr (GPtrArray) entries = NULL;
+  uint64_t target_size;
+  unsigned int i;
+
+  if (cache->size_known && cache->total_size <= cache->max_size)
+    return;
+
+  entries = list_entries (cache, &cache->total_size);
+  cache->size_known = TRUE;
+
+  if (cache->total_size <= cache->max_size)
+    return;
+
+  /* Leave some room, so that we don't have to evict on every store */
+  target_size = cache->max_size / 4 * 3;
+
+  g_ptr_array_sort (entries, compare_entries_by_mtime);
+
+  for (i = 0; i < entries->len && cache->total_size > target_size; i++)
+    {
+      CacheEntry *entry = g_ptr_array_index (entries, i);
+
+      /* Modification times are coarse, don't evict what was just written */
+      if (g_strcmp0 (entry->path, written_path) == 0)
+        continue;
+
+      remove_entry (cache, entry->path, entry->size);
+    }
+}
+
+static void
+write_entry (CoglProgramBinaryCache *cache,
+             Job                    *job)
+{
+  g_autofree char *path = NULL;
+  g_autoptr (GError) error = NULL;
+  GStatBuf stat_buf;
+  const char *contents;
+  gsize length;
+
+  path = get_entry_path (cache, job->key);
+  contents = g_bytes_get_data (job->contents, &length);
+
+  /* An existing entry is replaced, don't count it twice */
+  if (g_stat (path, &stat_buf) == 0)
+    cache->total_size -= MIN ((uint64_t) stat_buf.st_size, cache->total_size);
+
+  /* The entries carry a checksum, so a torn write is detected when reading
+   * it back. That makes syncing the file to disk unnecessary. */
+  if (!g_file_set_contents_full (path,
+                                 contents, length,
+                                 G_FILE_SET_CONTENTS_NONE,
+                                 0600,
+                                 &error))
+    {
+      g_warning ("Failed to store program binary: %s", error->message);
+
+      g_mutex_lock (&cache->entries_mutex);
+      g_hash_table_remove (cache->stored_keys, job->key);
+      g_mutex_unlock (&cache->entries_mutex);
+      return;
+    }
+
+  cache->total_size += length;
+
+  maybe_evict_entries (cache, path);
+}
+
+static void
+run_job_in_thread (Job                    *job,
+                   CoglProgramBinaryCache *cache)
+{
+  g_autofree char *path = NULL;
+  GStatBuf stat_buf;
+
+  switch (job->type)
+    {
+    case JOB_TYPE_LOAD:
+      load_entries (cache);
+      break;
+    case JOB_TYPE_WRITE:
+      write_entry (cache, job);
+      break;
+    case JOB_TYPE_TOUCH:
+      /* Mark the entry as recently used for the eviction */
+      path = get_entry_path (cache, job->key);
+      g_utime (path, NULL);
+      break;
+    case JOB_TYPE_REMOVE:
+      path = get_entry_path (cache, job->key);
+      if (g_stat (path, &stat_buf) == 0 && g_unlink (path) == 0)
+        cache->total_size -= MIN ((uint64_t) stat_buf.st_size,
+                                  cache->total_size);
+      break;
+    }
+
+  job_free (job);
+
+  g_mutex_lock (&cache->jobs_mutex);
+  cache->n_pending_jobs--;
+  g_cond_signal (&cache->jobs_cond);
+  g_mutex_unlock (&cache->jobs_mutex);
+}
+
+static void
+queue_job (CoglProgramBinaryCache *cache,
+           JobType                 type,
+           const char             *key,
+           GBytes                 *contents)
+{
+  Job *job;
+
+  job = g_new0 (Job, 1);
+  job->type = type;
+  job->key = g_strdup (key);
+  job->contents = contents ? g_bytes_ref (contents) : NULL;
+
+  g_mutex_lock (&cache->jobs_mutex);
+  cache->n_pending_jobs++;
+  g_mutex_unlock (&cache->jobs_mutex);
+
+  g_thread_pool_push (cache->thread_pool, job, NULL);
+}
+
+CoglProgramBinaryCache *
+_cogl_program_binary_cache_new (CoglContext *context,
+                                const char  *path,
+                                uint64_t     max_size)
+{
+  CoglProgramBinaryCache *cache;
+  GLint n_formats = 0;
+  char *driver_checksum;
+
+  if (G_UNLIKELY (COGL_DEBUG_ENABLED (COGL_DEBUG_DISABLE_PROGRAM_CACHES)))
+    return NULL;
+
+  if (!context->glGetProgramBinary || !context->glProgramBinary)
+    return NULL;
+
+  /* Drivers may implement the extension without supporting any format,
+   * e.g. Mesa when its own shader cache is disabled. */
+  GE (context, glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats));
+  if (n_formats < 1)
+    return NULL;
+
+  driver_checksum = compute_driver_checksum (context);
+  if (!driver_checksum)
+    return NULL;
+
+  if (g_mkdir_with_parents (path, 0700) != 0)
+    {
+      g_warning ("Failed to create program binary cache directory %s: %s",
+                 path, g_strerror (errno));
+      g_free (driver_checksum);
+      return NULL;
+    }
+
+  cache = g_new0 (CoglProgramBinaryCache, 1);
+  cache->context = context;
+  cache->path = g_strdup (path);
+  cache->max_size = max_size;
+  cache->driver_checksum = driver_checksum;
+
+  g_mutex_init (&cache->jobs_mutex);
+  g_cond_init (&cache->jobs_cond);
+
+  g_mutex_init (&cache->entries_mutex);
+  cache->loaded_entries =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free, (GDestroyNotify) g_bytes_unref);
+  cache->stored_keys = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, NULL);
+
+  /* A single thread serializes loading, writes and eviction */
+  cache->thread_pool = g_thread_pool_new ((GFunc) run_job_in_thread,
+                                          cache,
+                                          1,
+                                          FALSE,
+                                          NULL);
+
+  queue_job (cache, JOB_TYPE_LOAD, NULL, NULL);
+
+  return cache;
+}
+
+void
+_cogl_program_binary_cache_free (CoglProgramBinaryCache *cache)
+{
+  g_thread_pool_free (cache->thread_pool, FALSE, TRUE);
+
+  g_mutex_clear (&cache->jobs_mutex);
+  g_cond_clear (&cache->jobs_cond);
+
+  g_hash_table_destroy (cache->stored_keys);
+  g_hash_table_destroy (cache->loaded_entries);
+  g_mutex_clear (&cache->entries_mutex);
+
+  g_free (cache->driver_checksum);
+  g_free (cache->path);
+  g_free (cache);
+}
+
+void
+_cogl_program_binary_cache_flush (CoglProgramBinaryCache *cache)
+{
+  g_mutex_lock (&cache->jobs_mutex);
+  while (cache->n_pending_jobs > 0)
+    g_cond_wait (&cache->jobs_cond, &cache->jobs_mutex);
+  g_mutex_unlock (&cache->jobs_mutex);
+}
+
+char *
+_cogl_program_binary_cache_compute_key (CoglProgramBinaryCache  *cache,
+                                        const char             **source_checksums,
+                                        int                      n_source_checksums)
+{
+  g_autoptr (GChecksum) checksum = NULL;
+  uint32_t version = PROGRAM_BINARY_CACHE_VERSION;
+  int i;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum,
+                     (const guchar *) cache->driver_checksum, -1);
+  g_checksum_update (checksum, (const guchar *) &version, sizeof (version));
+
+  for (i = 0; i < n_source_checksums; i++)
+    {
+      /* Include the terminator to keep the checksums apart */
+      g_checksum_update (checksum,
+                         (const guchar *) source_checksums[i],
+                         strlen (source_checksums[i]) + 1);
+    }
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+gboolean
+_cogl_program_binary_cache_load (CoglProgramBinaryCache *cache,
+                                 const char             *key,
+                                 GLuint                  gl_program)
+{
+  CoglContext *ctx = cache->context;
+  g_autofree char *loaded_key = NULL;
+  g_autoptr (GBytes) contents = NULL;
+  ProgramBinaryHeader header;
+  const uint8_t *data;
+  GLint link_status = GL_FALSE;
+
+  g_mutex_lock (&cache->entries_mutex);
+  g_hash_table_steal_extended (cache->loaded_entries, key,
+                               (gpointer *) &loaded_key,
+                               (gpointer *) &contents);
+  g_mutex_unlock (&cache->entries_mutex);
+
+  /* The worker hasn't read the entry (yet), or there is none */
+  if (!contents)
+    return FALSE;
+
+  data = g_bytes_get_data (contents, NULL);
+  memcpy (&header, data, sizeof (header));
+
+  _cogl_gl_util_clear_gl_errors (ctx);
+  ctx->glProgramBinary (gl_program,
+                        header.binary_format,
+                        data + sizeof (header),
+                        header.binary_length);
+  if (_cogl_gl_util_get_error (ctx) == GL_NO_ERROR)
+    GE (ctx, glGetProgramiv (gl_program, GL_LINK_STATUS, &link_status));
+
+  if (!link_status)
+    {
+      /* Not an error; the driver changed in a way not reflected by the
+       * version strings. */
+      g_mutex_lock (&cache->entries_mutex);
+      g_hash_table_remove (cache->stored_keys, key);
+      g_mutex_unlock (&cache->entries_mutex);
+
+      queue_job (cache, JOB_TYPE_REMOVE, key, NULL);
+      return FALSE;
+    }
+
+  queue_job (cache, JOB_TYPE_TOUCH, key, NULL);
+
+  return TRUE;
+}
+
+void
+_cogl_program_binary_cache_store (CoglProgramBinaryCache *cache,
+                                  const char             *key,
+                                  GLuint                  gl_program)
+{
+  CoglContext *ctx = cache->context;
+  g_autofree uint8_t *binary = NULL;
+  g_autoptr (GBytes) contents = NULL;
+  GLint binary_length = 0;
+  GLsizei length = 0;
+  GLenum binary_format = 0;
+
+  g_mutex_lock (&cache->entries_mutex);
+  if (!g_hash_table_add (cache->stored_keys, g_strdup (key)))
+    {
+      g_mutex_unlock (&cache->entries_mutex);
+      return;
+    }
+  g_mutex_unlock (&cache->entries_mutex);
+
+  GE (ctx, glGetProgramiv (gl_program, GL_PROGRAM_BINARY_LENGTH,
+                           &binary_length));
+  if (binary_length < 1)
+    goto failed;
+
+  binary = g_malloc (binary_length);
+
+  _cogl_gl_util_clear_gl_errors (ctx);
+  ctx->glGetProgramBinary (gl_program,
+                           binary_length,
+                           &length,
+                           &binary_format,
+                           binary);
+  if (_cogl_gl_util_get_error (ctx) != GL_NO_ERROR || length < 1)
+    goto failed;
+
+  contents = create_entry_contents (binary_format, binary, length);
+  queue_job (cache, JOB_TYPE_WRITE, key, contents);
+
+  return;
+
+failed:
+  g_mutex_lock (&cache->entries_mutex);
+  g_hash_table_remove (cache->stored_keys, key);
+  g_mutex_unlock (&cache->entries_mutex);
+}
+
+#ifdef ENABLE_UNIT_TESTS
+
+static GLuint
+link_test_program (CoglContext *ctx)
+{
+  static const char *vertex_source =
+    "void main () { cogl_position_out = cogl_position_in; }\n";
+  static const char *fragment_source =
+    "void main () { cogl_color_out = vec4 (1.0, 0.0, 0.0, 1.0); }\n";
+  CoglPipeline *pipeline;
+  GLuint vertex_shader;
+  GLuint fragment_shader;
+  GLuint gl_program;
+  GLint link_status = GL_FALSE;
+
+  pipeline = cogl_pipeline_new (ctx);
+
+  GE_RET (vertex_shader, ctx, glCreateShader (GL_VERTEX_SHADER));
+  _cogl_glsl_shader_set_source_with_boilerplate (ctx,
+                                                 vertex_shader,
+                                                 GL_VERTEX_SHADER,
+                                                 pipeline,
+                                                 1, &vertex_source, NULL,
+                                                 NULL);
+  _cogl_glsl_shader_compile (ctx, vertex_shader);
+
+  GE_RET (fragment_shader, ctx, glCreateShader (GL_FRAGMENT_SHADER));
+  _cogl_glsl_shader_set_source_with_boilerplate (ctx,
+                                                 fragment_shader,
+                                                 GL_FRAGMENT_SHADER,
+                                                 pipeline,
+                                                 1, &fragment_source, NULL,
+                                                 NULL);
+  _cogl_glsl_shader_compile (ctx, fragment_shader);
+
+  GE_RET (gl_program, ctx, glCreateProgram ());
+  GE (ctx, glAttachShader (gl_program, vertex_shader));
+  GE (ctx, glAttachShader (gl_program, fragment_shader));
+  GE (ctx, glBindAttribLocation (gl_program, 0, "cogl_position_in"));
+  if (ctx->glProgramParameteri)
+    GE (ctx, glProgramParameteri (gl_program,
+                                  GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                  GL_TRUE));
+  GE (ctx, glLinkProgram (gl_program));
+  GE (ctx, glGetProgramiv (gl_program, GL_LINK_STATUS, &link_status));
+  g_assert_true (link_status);
+
+  GE (ctx, glDeleteShader (vertex_shader));
+  GE (ctx, glDeleteShader (fragment_shader));
+  cogl_object_unref (pipeline);
+
+  return gl_program;
+}
+
+static gboolean
+load_test_program (CoglProgramBinaryCache *cache,
+                   const char             *key)
+{
+  CoglContext *ctx = cache->context;
+  GLuint gl_program;
+  gboolean loaded;
+
+  GE_RET (gl_program, ctx, glCreateProgram ());
+  loaded = _cogl_program_binary_cache_load (cache, key, gl_program);
+  GE (ctx, glDeleteProgram (gl_program));
+
+  return loaded;
+}
+
+static char *
+compute_test_key (CoglProgramBinaryCache *cache,
+                  const char             *source_checksum)
+{
+  return _cogl_program_binary_cache_compute_key (cache, &source_checksum, 1);
+}
+
+static gboolean
+has_entry (const char *cache_path,
+           const char *key)
+{
+  g_autofree char *file_name = NULL;
+  g_autofree char *path = NULL;
+
+  file_name = g_strconcat (key, PROGRAM_BINARY_SUFFIX, NULL);
+  path = g_build_filename (cache_path, file_name, NULL);
+
+  return g_file_test (path, G_FILE_TEST_EXISTS);
+}
+
+static int
+count_entries (const char *cache_path)
+{
+  GDir *dir;
+  const char *name;
+  int n_entries = 0;
+
+  dir = g_dir_open (cache_path, 0, NULL);
+  g_assert_nonnull (dir);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      if (g_str_has_suffix (name, PROGRAM_BINARY_SUFFIX))
+        n_entries++;
+    }
+
+  g_dir_close (dir);
+
+  return n_entries;
+}
+
+static void
+remove_cache_dir (const char *cache_path)
+{
+  GDir *dir;
+  const char *name;
+
+  dir = g_dir_open (cache_path, 0, NULL);
+  g_assert_nonnull (dir);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      g_autofree char *path = NULL;
+
+      path = g_build_filename (cache_path, name, NULL);
+      g_unlink (path);
+    }
+
+  g_dir_close (dir);
+  g_rmdir (cache_path);
+}
+
+static CoglProgramBinaryCache *
+open_test_cache (const char *cache_path,
+                 uint64_t    max_size)
+{
+  CoglProgramBinaryCache *cache;
+
+  cache = _cogl_program_binary_cache_new (test_ctx, cache_path, max_size);
+  if (cache)
+    _cogl_program_binary_cache_flush (cache);
+
+  return cache;
+}
+
+UNIT_TEST (check_program_binary_cache_hit_and_miss,
+           TEST_REQUIREMENT_GLSL,
+           0 /* no failure cases */)
+{
+  g_autofree char *cache_path = NULL;
+  g_autofree char *key = NULL;
+  g_autofree char *other_key = NULL;
+  CoglProgramBinaryCache *cache;
+  GLuint gl_program;
+
+  cache_path = g_dir_make_tmp ("cogl-program-binary-cache-XXXXXX", NULL);
+  g_assert_nonnull (cache_path);
+
+  cache = open_test_cache (cache_path, 1024 * 1024);
+  if (!cache)
+    {
+      if (cogl_test_verbose ())
+        g_print ("Program binaries not supported, skipping\n");
+      remove_cache_dir (cache_path);
+      return;
+    }
+
+  key = compute_test_key (cache, "test-program");
+  other_key = compute_test_key (cache, "other-test-program");
+  g_assert_cmpstr (key, !=, other_key);
+
+  /* Nothing stored yet */
+  g_assert_false (load_test_program (cache, key));
+
+  gl_program = link_test_program (test_ctx);
+  _cogl_program_binary_cache_store (cache, key, gl_program);
+  GE (test_ctx, glDeleteProgram (gl_program));
+
+  _cogl_program_binary_cache_flush (cache);
+  g_assert_true (has_entry (cache_path, key));
+  _cogl_program_binary_cache_free (cache);
+
+  /* A new cache reads back the stored entry */
+  cache = open_test_cache (cache_path, 1024 * 1024);
+  g_assert_true (load_test_program (cache, key));
+  g_assert_false (load_test_program (cache, other_key));
+
+  _cogl_program_binary_cache_flush (cache);
+  g_assert_true (has_entry (cache_path, key));
+  _cogl_program_binary_cache_free (cache);
+
+  remove_cache_dir (cache_path);
+}
+
+UNIT_TEST (check_program_binary_cache_invalid_entries,
+           TEST_REQUIREMENT_GLSL,
+           0 /* no failure cases */)
+{
+  static const uint8_t bogus_binary[] = "not a program binary";
+  g_autofree char *cache_path = NULL;
+  g_autofree char *corrupt_key = NULL;
+  g_autofree char *corrupt_path = NULL;
+  g_autofree char *rejected_key = NULL;
+  g_autofree char *rejected_path = NULL;
+  g_autofree char *contents = NULL;
+  g_autoptr (GBytes) rejected_contents = NULL;
+  CoglProgramBinaryCache *cache;
+  GLuint gl_program;
+  gsize length;
+
+  cache_path = g_dir_make_tmp ("cogl-program-binary-cache-XXXXXX", NULL);
+  g_assert_nonnull (cache_path);
+
+  cache = open_test_cache (cache_path, 1024 * 1024);
+  if (!cache)
+    {
+      if (cogl_test_verbose ())
+        g_print ("Program binaries not supported, skipping\n");
+      remove_cache_dir (cache_path);
+      return;
+    }
+
+  corrupt_key = compute_test_key (cache, "corrupt-program");
+  rejected_key = compute_test_key (cache, "rejected-program");
+
+  /* Store a real binary, and then flip a byte of it on disk */
+  gl_program = link_test_program (test_ctx);
+  _cogl_program_binary_cache_store (cache, corrupt_key, gl_program);
+  GE (test_ctx, glDeleteProgram (gl_program));
+  _cogl_program_binary_cache_flush (cache);
+
+  corrupt_path = get_entry_path (cache, corrupt_key);
+  g_assert_true (g_file_get_contents (corrupt_path, &contents, &length, NULL));
+  g_assert_cmpuint (length, >, sizeof (ProgramBinaryHeader));
+  contents[length - 1] ^= 0xff;
+  g_assert_true (g_file_set_contents (corrupt_path, contents, length, NULL));
+
+  /* Store an entry that is intact, but that the driver can't load, like
+   * one written by a different driver version */
+  rejected_contents = create_entry_contents (0,
+                                             bogus_binary,
+                                             sizeof (bogus_binary));
+  rejected_path = get_entry_path (cache, rejected_key);
+  g_assert_true (g_file_set_contents (rejected_path,
+                                      g_bytes_get_data (rejected_contents,
+                                                        NULL),
+                                      g_bytes_get_size (rejected_contents),
+                                      NULL));
+
+  _cogl_program_binary_cache_free (cache);
+
+  cache = open_test_cache (cache_path, 1024 * 1024);
+
+  /* The corrupt entry is discarded when reading the cache */
+  g_assert_false (has_entry (cache_path, corrupt_key));
+  g_assert_false (load_test_program (cache, corrupt_key));
+
+  /* The rejected entry is discarded once the driver refused it */
+  g_assert_true (has_entry (cache_path, rejected_key));
+  g_assert_false (load_test_program (cache, rejected_key));
+  _cogl_program_binary_cache_flush (cache);
+  g_assert_false (has_entry (cache_path, rejected_key));
+
+  _cogl_program_binary_cache_free (cache);
+
+  remove_cache_dir (cache_path);
+}
+
+UNIT_TEST (check_program_binary_cache_eviction,
+           TEST_REQUIREMENT_GLSL,
+           0 /* no failure cases */)
+{
+  g_autofree char *cache_path = NULL;
+  g_autofree char *first_key = NULL;
+  g_autofree char *first_path = NULL;
+  g_autofree char *second_key = NULL;
+  g_autofree char *third_key = NULL;
+  CoglProgramBinaryCache *cache;
+  GStatBuf stat_buf;
+  GLuint gl_program;
+
+  cache_path = g_dir_make_tmp ("cogl-program-binary-cache-XXXXXX", NULL);
+  g_assert_nonnull (cache_path);
+
+  cache = open_test_cache (cache_path, 1024 * 1024);
+  if (!cache)
+    {
+      if (cogl_test_verbose ())
+        g_print ("Program binaries not supported, skipping\n");
+      remove_cache_dir (cache_path);
+      return;
+    }
+
+  first_key = compute_test_key (cache, "first-program");
+  second_key = compute_test_key (cache, "second-program");
+  third_key = compute_test_key (cache, "third-program");
+
+  gl_program = link_test_program (test_ctx);
+
+  /* Find out how large a single entry is */
+  _cogl_program_binary_cache_store (cache, first_key, gl_program);
+  _cogl_program_binary_cache_flush (cache);
+  first_path = get_entry_path (cache, first_key);
+  g_assert_cmpint (g_stat (first_path, &stat_buf), ==, 0);
+  _cogl_program_binary_cache_free (cache);
+
+  /* With room for two entries, storing a third one evicts down to three
+   * quarters of the limit, which only leaves the entry just written */
+  cache = open_test_cache (cache_path, stat_buf.st_size * 2);
+  _cogl_program_binary_cache_store (cache, second_key, gl_program);
+  _cogl_program_binary_cache_flush (cache);
+  g_assert_cmpint (count_entries (cache_path), ==, 2);
+
+  _cogl_program_binary_cache_store (cache, third_key, gl_program);
+  _cogl_program_binary_cache_flush (cache);
+  g_assert_cmpint (count_entries (cache_path), ==, 1);
+  g_assert_true (has_entry (cache_path, third_key));
+
+  _cogl_program_binary_cache_free (cache);
+  GE (test_ctx, glDeleteProgram (gl_program));
+
+  remove_cache_dir (cache_path);
+}
+
+#endif /* ENABLE_UNIT_TESTS */
@@ -36,6 +36,7 @@
 #include "cogl-context.h"
 #include "cogl-gl-header.h"
 #include "cogl-texture.h"
+#include "driver/gl/cogl-program-binary-cache-private.h"
 
 /* In OpenGL ES context, GL_CONTEXT_LOST has a _KHR prefix */
 #ifndef GL_CONTEXT_LOST
@@ -83,6 +84,9 @@ typedef struct _CoglGLContext {
   /* This is used for generated fake unique sampler object numbers
    when the sampler object extension is not supported */
   GLuint next_fake_sampler_object_number;
+
+  /* NULL if the driver can't retrieve program binaries */
+  CoglProgramBinaryCache *program_binary_cache;
 } CoglGLContext;
 
 CoglGLContext *
@@ -58,6 +58,8 @@
 #define GL_UNKNOWN_CONTEXT_RESET_ARB 0x8255
 #endif
 
+#define PROGRAM_BINARY_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
 #ifdef COGL_GL_DEBUG
 /* GL error to string conversion */
 static const struct {
@@ -106,6 +108,7 @@ gboolean
 _cogl_driver_gl_context_init (CoglContext *context)
 {
   CoglGLContext *gl_context;
+  g_autofree char *cache_path = NULL;
 
   if (!context->driver_context)
     context->driver_context = g_new0 (CoglContext, 1);
@@ -123,12 +126,25 @@ _cogl_driver_gl_context_init (CoglContext *context)
   gl_context->active_texture_unit = 1;
   GE (context, glActiveTexture (GL_TEXTURE1));
 
+  cache_path = g_build_filename (g_get_user_cache_dir (),
+                                 "mutter",
+                                 "program-binaries",
+                                 NULL);
+  gl_context->program_binary_cache =
+    _cogl_program_binary_cache_new (context,
+                                    cache_path,
+                                    PROGRAM_BINARY_CACHE_MAX_SIZE);
+
   return TRUE;
 }
 
 void
 _cogl_driver_gl_context_deinit (CoglContext *context)
 {
+  CoglGLContext *gl_context = _cogl_driver_gl_context (context);
+
+  g_clear_pointer (&gl_context->program_binary_cache,
+                   _cogl_program_binary_cache_free);
   _cogl_destroy_texture_units (context);
   g_free (context->driver_context);
 }
@@ -395,6 +395,8 @@ _cogl_driver_update_features (CoglContext *context,
                      COGL_FEATURE_ID_MAP_BUFFER_FOR_WRITE, TRUE);
       COGL_FLAGS_SET(context->features,
                      COGL_FEATURE_ID_MAP_BUFFER_FOR_READ, TRUE);
+      COGL_FLAGS_SET (private_features,
+                      COGL_PRIVATE_FEATURE_MAP_BUFFER_RANGE, TRUE);
     }
 
   if (context->glEGLImageTargetTexture2D)
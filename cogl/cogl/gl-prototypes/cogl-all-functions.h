@@ -275,3 +275,30 @@ COGL_EXT_FUNCTION (void, glGenQueries,
 COGL_EXT_FUNCTION (void, glDeleteQueries,
                    (GLsizei n, const GLuint *ids))
 COGL_EXT_END ()
+
+COGL_EXT_BEGIN (get_program_binary, 4, 1,
+                COGL_EXT_IN_GLES3,
+                "ARB:\0OES\0",
+                "get_program_binary\0")
+COGL_EXT_FUNCTION (void, glGetProgramBinary,
+                   (GLuint                program,
+                    GLsizei               bufSize,
+                    GLsizei              *length,
+                    GLenum               *binaryFormat,
+                    void                 *binary))
+COGL_EXT_FUNCTION (void, glProgramBinary,
+                   (GLuint                program,
+                    GLenum                binaryFormat,
+                    const void           *binary,
+                    GLsizei               length))
+COGL_EXT_END ()
+
+COGL_EXT_BEGIN (program_parameteri, 4, 1,
+                COGL_EXT_IN_GLES3,
+                "ARB:\0",
+                "get_program_binary\0")
+COGL_EXT_FUNCTION (void, glProgramParameteri,
+                   (GLuint                program,
+                    GLenum                pname,
+                    GLint                 value))
+COGL_EXT_END ()
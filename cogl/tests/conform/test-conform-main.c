@@ -98,7 +98,10 @@ main (int argc, char **argv)
   ADD_TEST (test_custom_attributes, TEST_REQUIREMENT_GLSL, 0);
 
   ADD_TEST (test_offscreen, 0, 0);
+  ADD_TEST (test_offscreen_pool, 0, 0);
   ADD_TEST (test_journal_unref_flush, 0, 0);
+  ADD_TEST (test_journal_vertex_ring, 0, 0);
+  ADD_TEST (test_journal_vertex_ring_wrap, 0, 0);
   ADD_TEST (test_framebuffer_get_bits,
             TEST_REQUIREMENT_OFFSCREEN | TEST_REQUIREMENT_GL,
             0);
@@ -28,7 +28,10 @@ void test_pipeline_uniforms (void);
 void test_snippets (void);
 void test_custom_attributes (void);
 void test_offscreen (void);
+void test_offscreen_pool (void);
 void test_journal_unref_flush (void);
+void test_journal_vertex_ring (void);
+void test_journal_vertex_ring_wrap (void);
 void test_framebuffer_get_bits (void);
 void test_point_size (void);
 void test_point_size_attribute (void);
@@ -44,3 +44,137 @@ test_journal_unref_flush (void)
 
   cogl_object_unref (texture);
 }
+
+/* Matches the size of the vertex ring of the journal */
+#define VERTEX_RING_SIZE (1024 * 1024)
+
+static void
+draw_quads (CoglTexture2D *texture,
+            CoglPipeline  *pipeline,
+            uint8_t        red,
+            int            n_quads)
+{
+  CoglOffscreen *offscreen;
+  CoglFramebuffer *framebuffer;
+  int i;
+
+  offscreen = cogl_offscreen_new_with_texture (COGL_TEXTURE (texture));
+  framebuffer = COGL_FRAMEBUFFER (offscreen);
+
+  cogl_pipeline_set_color4ub (pipeline, red, 0x00, 0x00, 0xff);
+
+  /* Quads with the same pipeline and color end up in the same batch */
+  for (i = 0; i < n_quads; i++)
+    cogl_framebuffer_draw_rectangle (framebuffer, pipeline,
+                                     -1 + (i % 4) * 0.5f, -1,
+                                     -0.5f + (i % 4) * 0.5f, 1);
+
+  cogl_framebuffer_flush (framebuffer);
+  g_object_unref (offscreen);
+}
+
+static void
+check_color (CoglTexture2D *texture,
+             uint8_t        red)
+{
+  uint8_t data[4 * 4];
+  int i;
+
+  cogl_texture_get_data (COGL_TEXTURE (texture),
+                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                         4 * 4, data);
+
+  for (i = 0; i < 4; i++)
+    {
+      g_assert_cmpuint (data[i * 4 + 0], ==, red);
+      g_assert_cmpuint (data[i * 4 + 1], ==, 0x00);
+      g_assert_cmpuint (data[i * 4 + 2], ==, 0x00);
+    }
+}
+
+void
+test_journal_vertex_ring (void)
+{
+  CoglJournalStats stats_before;
+  CoglJournalStats stats;
+  CoglTexture2D *texture1;
+  CoglTexture2D *texture2;
+  CoglPipeline *pipeline;
+
+  texture1 = cogl_texture_2d_new_with_size (test_ctx, 4, 1);
+  texture2 = cogl_texture_2d_new_with_size (test_ctx, 4, 1);
+  pipeline = cogl_pipeline_new (test_ctx);
+
+  cogl_context_get_journal_stats (test_ctx, &stats_before);
+
+  /* Flushes of different framebuffers append to the same vertex buffer, so
+   * the vertices of the second one must not overwrite the first before the
+   * GPU is done with them */
+  draw_quads (texture1, pipeline, 0x22, 4);
+  draw_quads (texture2, pipeline, 0x33, 4);
+  check_color (texture1, 0x22);
+  check_color (texture2, 0x33);
+
+  cogl_context_get_journal_stats (test_ctx, &stats);
+  g_assert_cmpint (stats.n_flushes, ==, stats_before.n_flushes + 2);
+  g_assert_cmpint (stats.n_quads, ==, stats_before.n_quads + 8);
+  g_assert_cmpint (stats.n_batches, ==, stats_before.n_batches + 2);
+  g_assert_cmpint (stats.n_draws, >=, stats_before.n_draws + 2);
+  g_assert_cmpuint (stats.uploaded_bytes, >, stats_before.uploaded_bytes);
+  /* The ring may have been about full already, but two small flushes
+   * can't run out of space twice */
+  g_assert_cmpint (stats.n_vertex_ring_wraps,
+                   <=,
+                   stats_before.n_vertex_ring_wraps + 1);
+
+  cogl_object_unref (pipeline);
+  cogl_object_unref (texture2);
+  cogl_object_unref (texture1);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
+
+void
+test_journal_vertex_ring_wrap (void)
+{
+  CoglJournalStats stats_before;
+  CoglJournalStats stats;
+  CoglTexture2D *texture;
+  CoglPipeline *pipeline;
+  size_t uploaded_bytes;
+  int n_wraps;
+  int i;
+
+  texture = cogl_texture_2d_new_with_size (test_ctx, 4, 1);
+  pipeline = cogl_pipeline_new (test_ctx);
+
+  cogl_context_get_journal_stats (test_ctx, &stats_before);
+
+  /* Upload enough vertices to go around the ring a few times, checking
+   * that starting over doesn't clobber vertices that are still needed */
+  for (i = 0; i < 24; i++)
+    {
+      uint8_t red = 0x10 + i;
+
+      draw_quads (texture, pipeline, red, 1024);
+      check_color (texture, red);
+    }
+
+  cogl_context_get_journal_stats (test_ctx, &stats);
+  uploaded_bytes = stats.uploaded_bytes - stats_before.uploaded_bytes;
+  n_wraps = stats.n_vertex_ring_wraps - stats_before.n_vertex_ring_wraps;
+
+  /* Only running out of space counts as a wrap, not every flush that
+   * discards the buffer */
+  g_assert_cmpuint (uploaded_bytes, >, 2 * VERTEX_RING_SIZE);
+  g_assert_cmpint (n_wraps, >=, 1);
+  g_assert_cmpint (n_wraps, <=, uploaded_bytes / VERTEX_RING_SIZE + 1);
+  g_assert_cmpint (n_wraps, <, 24);
+
+  cogl_object_unref (pipeline);
+  cogl_object_unref (texture);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -0,0 +1,128 @@
+#include <cogl/cogl.h>
+
+#include "test-declarations.h"
+#include "test-utils.h"
+
+#define SIZE 16
+
+static CoglOffscreen *
+acquire (CoglOffscreenPool     *pool,
+         CoglTextureComponents  components)
+{
+  CoglOffscreen *offscreen;
+  GError *error = NULL;
+
+  offscreen = cogl_offscreen_pool_acquire (pool, SIZE, SIZE, components,
+                                           &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (offscreen);
+
+  return offscreen;
+}
+
+void
+test_offscreen_pool (void)
+{
+  CoglOffscreenPool *pool = cogl_context_get_offscreen_pool (test_ctx);
+  CoglOffscreenPoolStats initial_stats;
+  CoglOffscreenPoolStats stats;
+  CoglOffscreen *offscreen1;
+  CoglOffscreen *offscreen2;
+  CoglOffscreen *offscreen3;
+  int i;
+
+  cogl_offscreen_pool_get_stats (pool, &initial_stats);
+
+  offscreen1 = acquire (pool, COGL_TEXTURE_COMPONENTS_RGBA);
+  cogl_offscreen_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.n_misses, ==, initial_stats.n_misses + 1);
+  g_assert_cmpint (stats.n_in_use, ==, initial_stats.n_in_use + 1);
+  g_assert_cmpuint (stats.in_use_bytes, ==,
+                    initial_stats.in_use_bytes + SIZE * SIZE * 4);
+  cogl_offscreen_pool_release (pool, offscreen1);
+
+  /* Released framebuffers aren't handed out before the frame ends */
+  offscreen2 = acquire (pool, COGL_TEXTURE_COMPONENTS_RGBA);
+  g_assert_true (offscreen2 != offscreen1);
+  cogl_offscreen_pool_release (pool, offscreen2);
+
+  cogl_offscreen_pool_get_stats (pool, &stats);
+  g_assert_cmpint (stats.n_pooled, ==, initial_stats.n_pooled + 2);
+  g_assert_cmpuint (stats.pooled_bytes, ==,
+                    initial_stats.pooled_bytes + 2 * SIZE * SIZE * 4);
+  g_assert_cmpint (stats.n_in_use, ==, initial_stats.n_in_use);
+
+  cogl_offscreen_pool_end_frame (pool);
+
+  /* Different components need a different framebuffer */
+  offscreen3 = acquire (pool, COGL_TEXTURE_COMPONENTS_RG);
+  g_assert_true (offscreen3 != offscreen1);
+  g_assert_true (offscreen3 != offscreen2);
+  cogl_offscreen_pool_release (pool, offscreen3);
+
+  offscreen3 = acquire (pool, COGL_TEXTURE_COMPONENTS_RGBA);
+  g_assert_true (offscreen3 == offscreen1 || offscreen3 == offscreen2);
+  g_assert_cmpint (cogl_framebuffer_get_viewport_width (COGL_FRAMEBUFFER (offscreen3)),
+                   ==, SIZE);
+  cogl_offscreen_pool_release (pool, offscreen3);
+
+  cogl_offscreen_pool_get_stats (pool, &stats);
+  g_assert_cmpuint (stats.n_hits, ==, initial_stats.n_hits + 1);
+  g_assert_cmpuint (stats.n_misses, ==, initial_stats.n_misses + 3);
+
+  /* Framebuffers that aren't reused are eventually freed */
+  for (i = 0; i < 100; i++)
+    cogl_offscreen_pool_end_frame (pool);
+
+  cogl_offscreen_pool_get_stats (pool, &stats);
+  g_assert_cmpint (stats.n_pooled, ==, 0);
+  g_assert_cmpuint (stats.pooled_bytes, ==, 0);
+  g_assert_cmpuint (stats.n_evictions, ==, initial_stats.n_evictions + 3);
+
+  /* Over the size limit, the oldest released framebuffers are freed */
+  cogl_offscreen_pool_set_max_size (pool, SIZE * SIZE * 4);
+  offscreen1 = acquire (pool, COGL_TEXTURE_COMPONENTS_RGBA);
+  offscreen2 = acquire (pool, COGL_TEXTURE_COMPONENTS_RGBA);
+  cogl_offscreen_pool_release (pool, offscreen1);
+  cogl_offscreen_pool_release (pool, offscreen2);
+
+  cogl_offscreen_pool_get_stats (pool, &stats);
+  g_assert_cmpint (stats.n_pooled, ==, 1);
+  g_assert_cmpuint (stats.pooled_bytes, ==, SIZE * SIZE * 4);
+
+  cogl_offscreen_pool_end_frame (pool);
+  cogl_offscreen_pool_set_max_size (pool, 0);
+
+  cogl_offscreen_pool_get_stats (pool, &stats);
+  g_assert_cmpint (stats.n_pooled, ==, 0);
+  g_assert_cmpuint (stats.n_evictions, ==, initial_stats.n_evictions + 5);
+
+  cogl_offscreen_pool_set_max_size (pool, 64 * 1024 * 1024);
+
+  /* Rounded sizes share a framebuffer, but keep their own viewport */
+  offscreen1 = cogl_offscreen_pool_acquire_rounded (pool, 100, 30,
+                                                    COGL_TEXTURE_COMPONENTS_RGBA,
+                                                    NULL);
+  g_assert_cmpint (cogl_framebuffer_get_width (COGL_FRAMEBUFFER (offscreen1)),
+                   ==, 128);
+  g_assert_cmpint (cogl_framebuffer_get_height (COGL_FRAMEBUFFER (offscreen1)),
+                   ==, 64);
+  g_assert_cmpint (cogl_framebuffer_get_viewport_width (COGL_FRAMEBUFFER (offscreen1)),
+                   ==, 100);
+  cogl_offscreen_pool_release (pool, offscreen1);
+  cogl_offscreen_pool_end_frame (pool);
+
+  offscreen2 = cogl_offscreen_pool_acquire_rounded (pool, 120, 40,
+                                                    COGL_TEXTURE_COMPONENTS_RGBA,
+                                                    NULL);
+  g_assert_true (offscreen2 == offscreen1);
+  g_assert_cmpint (cogl_framebuffer_get_viewport_width (COGL_FRAMEBUFFER (offscreen2)),
+                   ==, 120);
+  g_assert_cmpint (cogl_framebuffer_get_viewport_height (COGL_FRAMEBUFFER (offscreen2)),
+                   ==, 40);
+  cogl_offscreen_pool_release (pool, offscreen2);
+  cogl_offscreen_pool_end_frame (pool);
+
+  if (cogl_test_verbose ())
+    g_print ("OK\n");
+}
@@ -102,6 +102,7 @@ typedef struct _MetaOutputInfo
 
   gboolean supports_underscanning;
   gboolean supports_color_transform;
+  gboolean supports_vrr;
 
   /*
    * Get a new preferred mode on hotplug events, to handle dynamic guest
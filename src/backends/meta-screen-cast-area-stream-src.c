@@ -258,6 +258,8 @@ before_stage_painted (MetaStage           *stage,
   if (!clutter_stage_view_peek_scanout (view))
     return;
 
+  meta_screen_cast_stream_src_damage_all (src);
+
   area_src->maybe_record_idle_id = g_idle_add (maybe_record_frame_on_idle, src);
 }
 
@@ -274,13 +276,17 @@ stage_painted (MetaStage           *stage,
   MetaScreenCastAreaStream *area_stream = META_SCREEN_CAST_AREA_STREAM (stream);
   const cairo_region_t *redraw_clip;
   MetaRectangle *area;
-
-  if (area_src->maybe_record_idle_id)
-    return;
+  float scale;
 
   area = meta_screen_cast_area_stream_get_area (area_stream);
+  scale = meta_screen_cast_area_stream_get_scale (area_stream);
   redraw_clip = clutter_paint_context_get_redraw_clip (paint_context);
 
+  meta_screen_cast_stream_src_add_stage_damage (src, redraw_clip, area, scale);
+
+  if (area_src->maybe_record_idle_id)
+    return;
+
   if (redraw_clip)
     {
       switch (cairo_region_contains_rectangle (redraw_clip, area))
@@ -457,6 +463,7 @@ meta_screen_cast_area_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *src
                                                    int                       height,
                                                    int                       stride,
                                                    uint8_t                  *data,
+                                                   const cairo_region_t     *damage,
                                                    GError                  **error)
 {
   MetaScreenCastAreaStreamSrc *area_src =
@@ -483,20 +490,21 @@ meta_screen_cast_area_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *src
       break;
     }
 
-  if (!clutter_stage_paint_to_buffer (stage, area, scale,
-                                      data,
-                                      stride,
-                                      CLUTTER_CAIRO_FORMAT_ARGB32,
-                                      paint_flags,
-                                      error))
-    return FALSE;
-
-  return TRUE;
+  return meta_screen_cast_stream_src_paint_stage_damage_to_buffer (src,
+                                                                   stage,
+                                                                   damage,
+                                                                   area,
+                                                                   scale,
+                                                                   paint_flags,
+                                                                   data,
+                                                                   stride,
+                                                                   error);
 }
 
 static gboolean
 meta_screen_cast_area_stream_src_record_to_framebuffer (MetaScreenCastStreamSrc  *src,
                                                         CoglFramebuffer          *framebuffer,
+                                                        const cairo_region_t     *damage,
                                                         GError                  **error)
 {
   MetaScreenCastAreaStreamSrc *area_src =
@@ -523,6 +531,9 @@ meta_screen_cast_area_stream_src_record_to_framebuffer (MetaScreenCastStreamSrc
       paint_flags |= CLUTTER_PAINT_FLAG_FORCE_CURSORS;
       break;
     }
+
+  /* Painting the stage as a whole is cheaper than repainting each damaged
+   * rectangle, so the damage is ignored here. */
   clutter_stage_paint_to_framebuffer (stage, framebuffer,
                                       area, scale,
                                       paint_flags);
@@ -90,6 +90,19 @@ get_monitor (MetaScreenCastMonitorStreamSrc *monitor_src)
   return meta_screen_cast_monitor_stream_get_monitor (monitor_stream);
 }
 
+static float
+get_stream_scale (MetaScreenCastMonitorStreamSrc *monitor_src)
+{
+  MetaMonitor *monitor = get_monitor (monitor_src);
+  MetaLogicalMonitor *logical_monitor =
+    meta_monitor_get_logical_monitor (monitor);
+
+  if (meta_is_stage_views_scaled ())
+    return meta_logical_monitor_get_scale (logical_monitor);
+  else
+    return 1.0;
+}
+
 static gboolean
 meta_screen_cast_monitor_stream_src_get_specs (MetaScreenCastStreamSrc *src,
                                                int                     *width,
@@ -144,6 +157,16 @@ stage_painted (MetaStage           *stage,
   MetaScreenCastMonitorStreamSrc *monitor_src =
     META_SCREEN_CAST_MONITOR_STREAM_SRC (user_data);
   MetaScreenCastStreamSrc *src = META_SCREEN_CAST_STREAM_SRC (monitor_src);
+  MetaMonitor *monitor = get_monitor (monitor_src);
+  MetaLogicalMonitor *logical_monitor =
+    meta_monitor_get_logical_monitor (monitor);
+  const cairo_region_t *redraw_clip;
+
+  redraw_clip = clutter_paint_context_get_redraw_clip (paint_context);
+  meta_screen_cast_stream_src_add_stage_damage (src,
+                                                redraw_clip,
+                                                &logical_monitor->rect,
+                                                get_stream_scale (monitor_src));
 
   if (monitor_src->maybe_record_idle_id)
     return;
@@ -171,6 +194,9 @@ before_stage_painted (MetaStage           *stage,
   if (!clutter_stage_view_peek_scanout (view))
     return;
 
+  /* Nothing is painted while scanning out, so there is no damage to track */
+  meta_screen_cast_stream_src_damage_all (src);
+
   flags = META_SCREEN_CAST_RECORD_FLAG_DMABUF_ONLY;
   meta_screen_cast_stream_src_maybe_record_frame (src, flags);
 }
@@ -503,6 +529,7 @@ meta_screen_cast_monitor_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *
                                                       int                       height,
                                                       int                       stride,
                                                       uint8_t                  *data,
+                                                      const cairo_region_t     *damage,
                                                       GError                  **error)
 {
   MetaScreenCastMonitorStreamSrc *monitor_src =
@@ -517,11 +544,7 @@ meta_screen_cast_monitor_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *
   monitor = get_monitor (monitor_src);
   logical_monitor = meta_monitor_get_logical_monitor (monitor);
   stage = get_stage (monitor_src);
-
-  if (meta_is_stage_views_scaled ())
-    scale = meta_logical_monitor_get_scale (logical_monitor);
-  else
-    scale = 1.0;
+  scale = get_stream_scale (monitor_src);
 
   switch (meta_screen_cast_stream_get_cursor_mode (stream))
     {
@@ -534,20 +557,21 @@ meta_screen_cast_monitor_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *
       break;
     }
 
-  if (!clutter_stage_paint_to_buffer (stage, &logical_monitor->rect, scale,
-                                      data,
-                                      stride,
-                                      CLUTTER_CAIRO_FORMAT_ARGB32,
-                                      paint_flags,
-                                      error))
-    return FALSE;
-
-  return TRUE;
+  return meta_screen_cast_stream_src_paint_stage_damage_to_buffer (src,
+                                                                   stage,
+                                                                   damage,
+                                                                   &logical_monitor->rect,
+                                                                   scale,
+                                                                   paint_flags,
+                                                                   data,
+                                                                   stride,
+                                                                   error);
 }
 
 static gboolean
 meta_screen_cast_monitor_stream_src_record_to_framebuffer (MetaScreenCastStreamSrc  *src,
                                                            CoglFramebuffer          *framebuffer,
+                                                           const cairo_region_t     *damage,
                                                            GError                  **error)
 {
   MetaScreenCastMonitorStreamSrc *monitor_src =
@@ -597,13 +621,12 @@ meta_screen_cast_monitor_stream_src_record_to_framebuffer (MetaScreenCastStreamS
       else
         {
           view_framebuffer = clutter_stage_view_get_framebuffer (view);
-          if (!cogl_blit_framebuffer (view_framebuffer,
-                                      framebuffer,
-                                      0, 0,
-                                      x, y,
-                                      cogl_framebuffer_get_width (view_framebuffer),
-                                      cogl_framebuffer_get_height (view_framebuffer),
-                                      error))
+          if (!meta_screen_cast_stream_src_blit_damage (src,
+                                                        view_framebuffer,
+                                                        framebuffer,
+                                                        x, y,
+                                                        damage,
+                                                        error))
             return FALSE;
         }
     }
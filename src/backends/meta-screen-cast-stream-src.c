@@ -32,6 +32,7 @@
 #include <spa/param/video/format-utils.h>
 #include <spa/utils/result.h>
 #include <stdint.h>
+#include <string.h>
 #include <sys/mman.h>
 
 #ifdef HAVE_NATIVE_BACKEND
@@ -41,6 +42,7 @@
 #include "backends/meta-screen-cast-session.h"
 #include "backends/meta-screen-cast-stream.h"
 #include "clutter/clutter-mutter.h"
+#include "compositor/region-utils.h"
 #include "core/meta-fraction.h"
 #include "meta/boxes.h"
 
@@ -59,6 +61,14 @@
 #define MIN_FRAME_RATE SPA_FRACTION (1, 1)
 #define MAX_FRAME_RATE SPA_FRACTION (1000, 1)
 
+#define MAX_DAMAGE_RECTS 16
+
+/* Fraction of the stream area above which repainting the damaged
+ * rectangles one by one costs more than repainting the whole frame. */
+#define MAX_PARTIAL_DAMAGE_COVERAGE 0.75
+
+#define N_READBACKS 3
+
 enum
 {
   PROP_0,
@@ -84,6 +94,24 @@ typedef struct _MetaPipeWireSource
   struct pw_loop *pipewire_loop;
 } MetaPipeWireSource;
 
+typedef struct _MetaScreenCastReadback
+{
+  MetaScreenCastStreamSrc *src;
+
+  CoglFramebuffer *framebuffer;
+  /* The out of date parts of the framebuffer, or NULL for all of it */
+  cairo_region_t *framebuffer_damage;
+  CoglPixelBuffer *pixel_buffer;
+  CoglBitmap *bitmap;
+  int width;
+  int height;
+  int stride;
+
+  struct pw_buffer *buffer;
+  cairo_region_t *buffer_damage;
+  CoglFenceClosure *fence_closure;
+} MetaScreenCastReadback;
+
 typedef struct _MetaScreenCastStreamSrcPrivate
 {
   MetaScreenCastStream *stream;
@@ -107,6 +135,16 @@ typedef struct _MetaScreenCastStreamSrcPrivate
   guint follow_up_frame_source_id;
 
   GHashTable *dmabuf_handles;
+
+  cairo_region_t *damage;
+  gboolean damage_all;
+  GHashTable *buffer_damage;
+
+  MetaScreenCastReadback readbacks[N_READBACKS];
+  gboolean async_readback_disabled;
+  gboolean readback_map_disabled;
+  gboolean has_pending_record;
+  MetaScreenCastRecordFlag pending_record_flags;
 } MetaScreenCastStreamSrcPrivate;
 
 static struct spa_pod *
@@ -205,23 +243,26 @@ meta_screen_cast_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *src,
                                               int                       height,
                                               int                       stride,
                                               uint8_t                  *data,
+                                              const cairo_region_t     *damage,
                                               GError                  **error)
 {
   MetaScreenCastStreamSrcClass *klass =
     META_SCREEN_CAST_STREAM_SRC_GET_CLASS (src);
 
-  return klass->record_to_buffer (src, width, height, stride, data, error);
+  return klass->record_to_buffer (src, width, height, stride, data, damage,
+                                  error);
 }
 
 static gboolean
 meta_screen_cast_stream_src_record_to_framebuffer (MetaScreenCastStreamSrc  *src,
                                                    CoglFramebuffer          *framebuffer,
+                                                   const cairo_region_t     *damage,
                                                    GError                  **error)
 {
   MetaScreenCastStreamSrcClass *klass =
     META_SCREEN_CAST_STREAM_SRC_GET_CLASS (src);
 
-  return klass->record_to_framebuffer (src, framebuffer, error);
+  return klass->record_to_framebuffer (src, framebuffer, damage, error);
 }
 
 static void
@@ -487,6 +528,455 @@ maybe_record_cursor (MetaScreenCastStreamSrc *src,
   g_assert_not_reached ();
 }
 
+static void
+get_stream_rect (MetaScreenCastStreamSrc *src,
+                 cairo_rectangle_int_t   *stream_rect)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+
+  *stream_rect = (cairo_rectangle_int_t) {
+    .width = priv->video_format.size.width,
+    .height = priv->video_format.size.height,
+  };
+}
+
+void
+meta_screen_cast_stream_src_add_damage (MetaScreenCastStreamSrc *src,
+                                        const cairo_region_t    *damage)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+
+  if (priv->damage_all)
+    return;
+
+  cairo_region_union (priv->damage, damage);
+}
+
+void
+meta_screen_cast_stream_src_add_stage_damage (MetaScreenCastStreamSrc *src,
+                                              const cairo_region_t    *stage_damage,
+                                              const MetaRectangle     *area,
+                                              float                    scale)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  cairo_region_t *area_damage;
+  cairo_region_t *stream_damage;
+
+  if (!stage_damage)
+    {
+      meta_screen_cast_stream_src_damage_all (src);
+      return;
+    }
+
+  if (priv->damage_all)
+    return;
+
+  area_damage = cairo_region_copy (stage_damage);
+  cairo_region_intersect_rectangle (area_damage, area);
+  cairo_region_translate (area_damage, -area->x, -area->y);
+
+  stream_damage = meta_region_scale_double (area_damage, scale,
+                                            META_ROUNDING_STRATEGY_GROW);
+  meta_screen_cast_stream_src_add_damage (src, stream_damage);
+
+  cairo_region_destroy (stream_damage);
+  cairo_region_destroy (area_damage);
+}
+
+void
+meta_screen_cast_stream_src_damage_all (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+
+  priv->damage_all = TRUE;
+}
+
+/**
+ * meta_screen_cast_stream_src_calculate_stage_damage:
+ * @src: a #MetaScreenCastStreamSrc
+ * @damage: (nullable): the damage passed to record_to_buffer()
+ * @area: the stage area the stream captures
+ * @scale: the scale between stage and stream coordinates
+ *
+ * Translates buffer damage back into stage coordinates, so that a source can
+ * repaint only the damaged parts of a memfd buffer. The returned rectangles
+ * map to whole stream pixels.
+ *
+ * Returns: (nullable): the damage in stage coordinates, or %NULL if the
+ * whole frame should be repainted.
+ */
+cairo_region_t *
+meta_screen_cast_stream_src_calculate_stage_damage (MetaScreenCastStreamSrc *src,
+                                                    const cairo_region_t    *damage,
+                                                    const MetaRectangle     *area,
+                                                    float                    scale)
+{
+  cairo_rectangle_int_t stream_rect;
+  cairo_region_t *stage_damage;
+  int64_t damaged_area = 0;
+  int n_rects, i;
+
+  if (!damage)
+    return NULL;
+
+  /* Fractional scales don't map stage rectangles onto whole stream pixels. */
+  if (!G_APPROX_VALUE (scale, roundf (scale), FLT_EPSILON))
+    return NULL;
+
+  get_stream_rect (src, &stream_rect);
+
+  n_rects = cairo_region_num_rectangles (damage);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (damage, i, &rect);
+      damaged_area += (int64_t) rect.width * rect.height;
+    }
+
+  if (damaged_area >
+      MAX_PARTIAL_DAMAGE_COVERAGE * stream_rect.width * stream_rect.height)
+    return NULL;
+
+  stage_damage = meta_region_scale_double ((cairo_region_t *) damage,
+                                           1.0 / roundf (scale),
+                                           META_ROUNDING_STRATEGY_GROW);
+  cairo_region_translate (stage_damage, area->x, area->y);
+  cairo_region_intersect_rectangle (stage_damage, area);
+
+  if (cairo_region_num_rectangles (stage_damage) > MAX_DAMAGE_RECTS)
+    {
+      cairo_rectangle_int_t extents;
+
+      cairo_region_get_extents (stage_damage, &extents);
+      cairo_region_destroy (stage_damage);
+      stage_damage = cairo_region_create_rectangle (&extents);
+    }
+
+  return stage_damage;
+}
+
+/**
+ * meta_screen_cast_stream_src_record_damage_to_buffer:
+ * @src: a #MetaScreenCastStreamSrc
+ * @damage: (nullable): the damage passed to record_to_buffer()
+ * @area: the stage area the stream captures
+ * @scale: the scale between stage and stream coordinates
+ * @data: the buffer data, with @area at its origin
+ * @stride: the stride of @data
+ * @record_func: (scope call): records a stage rectangle into the buffer
+ * @user_data: user data passed to @record_func
+ * @error: return location for a #GError
+ *
+ * Records the damaged parts of @area into a memfd buffer, calling
+ * @record_func for each damaged stage rectangle with @data offset to where
+ * that rectangle goes. Falls back to a single call for the whole of @area
+ * when the damage can't be mapped to stream pixels, or covers most of it.
+ *
+ * Returns: %TRUE on success, %FALSE if @record_func failed.
+ */
+gboolean
+meta_screen_cast_stream_src_record_damage_to_buffer (MetaScreenCastStreamSrc              *src,
+                                                     const cairo_region_t                 *damage,
+                                                     const MetaRectangle                  *area,
+                                                     float                                 scale,
+                                                     uint8_t                              *data,
+                                                     int                                   stride,
+                                                     MetaScreenCastRecordStageRectFunc     record_func,
+                                                     gpointer                              user_data,
+                                                     GError                              **error)
+{
+  cairo_region_t *stage_damage;
+  const int bpp = 4;
+  int n_rects, i;
+
+  stage_damage = meta_screen_cast_stream_src_calculate_stage_damage (src,
+                                                                     damage,
+                                                                     area,
+                                                                     scale);
+  if (!stage_damage)
+    return record_func (src, area, data, stride, user_data, error);
+
+  n_rects = cairo_region_num_rectangles (stage_damage);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+      int x, y;
+
+      cairo_region_get_rectangle (stage_damage, i, &rect);
+      x = (int) roundf ((rect.x - area->x) * scale);
+      y = (int) roundf ((rect.y - area->y) * scale);
+
+      if (!record_func (src, &rect,
+                        data + y * stride + x * bpp,
+                        stride,
+                        user_data,
+                        error))
+        {
+          cairo_region_destroy (stage_damage);
+          return FALSE;
+        }
+    }
+
+  cairo_region_destroy (stage_damage);
+
+  return TRUE;
+}
+
+/**
+ * meta_screen_cast_stream_src_blit_damage:
+ * @src: a #MetaScreenCastStreamSrc
+ * @src_framebuffer: the framebuffer to blit from
+ * @dst_framebuffer: the framebuffer to blit to
+ * @dst_x: where @src_framebuffer goes in @dst_framebuffer
+ * @dst_y: where @src_framebuffer goes in @dst_framebuffer
+ * @damage: (nullable): the damage passed to record_to_framebuffer()
+ * @error: return location for a #GError
+ *
+ * Blits the whole of @src_framebuffer to @dst_framebuffer, or only the parts
+ * of it that are within @damage.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise.
+ */
+gboolean
+meta_screen_cast_stream_src_blit_damage (MetaScreenCastStreamSrc  *src,
+                                         CoglFramebuffer          *src_framebuffer,
+                                         CoglFramebuffer          *dst_framebuffer,
+                                         int                       dst_x,
+                                         int                       dst_y,
+                                         const cairo_region_t     *damage,
+                                         GError                  **error)
+{
+  cairo_rectangle_int_t src_rect;
+  cairo_region_t *blit_region;
+  int n_rects, i;
+
+  src_rect = (cairo_rectangle_int_t) {
+    .x = dst_x,
+    .y = dst_y,
+    .width = cogl_framebuffer_get_width (src_framebuffer),
+    .height = cogl_framebuffer_get_height (src_framebuffer),
+  };
+
+  if (!damage)
+    {
+      return cogl_blit_framebuffer (src_framebuffer,
+                                    dst_framebuffer,
+                                    0, 0,
+                                    dst_x, dst_y,
+                                    src_rect.width, src_rect.height,
+                                    error);
+    }
+
+  blit_region = cairo_region_copy (damage);
+  cairo_region_intersect_rectangle (blit_region, &src_rect);
+
+  n_rects = cairo_region_num_rectangles (blit_region);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (blit_region, i, &rect);
+      if (!cogl_blit_framebuffer (src_framebuffer,
+                                  dst_framebuffer,
+                                  rect.x - dst_x, rect.y - dst_y,
+                                  rect.x, rect.y,
+                                  rect.width, rect.height,
+                                  error))
+        {
+          cairo_region_destroy (blit_region);
+          return FALSE;
+        }
+    }
+
+  cairo_region_destroy (blit_region);
+
+  return TRUE;
+}
+
+typedef struct _PaintStageData
+{
+  ClutterStage *stage;
+  float scale;
+  ClutterPaintFlag paint_flags;
+} PaintStageData;
+
+static gboolean
+paint_stage_rect (MetaScreenCastStreamSrc  *src,
+                  const MetaRectangle      *rect,
+                  uint8_t                  *data,
+                  int                       stride,
+                  gpointer                  user_data,
+                  GError                  **error)
+{
+  PaintStageData *paint_data = user_data;
+
+  return clutter_stage_paint_to_buffer (paint_data->stage, rect,
+                                        paint_data->scale,
+                                        data,
+                                        stride,
+                                        CLUTTER_CAIRO_FORMAT_ARGB32,
+                                        paint_data->paint_flags,
+                                        error);
+}
+
+/**
+ * meta_screen_cast_stream_src_paint_stage_damage_to_buffer:
+ * @src: a #MetaScreenCastStreamSrc
+ * @stage: the stage to paint
+ * @damage: (nullable): the damage passed to record_to_buffer()
+ * @area: the stage area the stream captures
+ * @scale: the scale between stage and stream coordinates
+ * @paint_flags: the flags to paint the stage with
+ * @data: the buffer data, with @area at its origin
+ * @stride: the stride of @data
+ * @error: return location for a #GError
+ *
+ * Paints the damaged parts of @area of @stage into a memfd buffer; see
+ * meta_screen_cast_stream_src_record_damage_to_buffer().
+ *
+ * Returns: %TRUE on success, %FALSE otherwise.
+ */
+gboolean
+meta_screen_cast_stream_src_paint_stage_damage_to_buffer (MetaScreenCastStreamSrc  *src,
+                                                          ClutterStage             *stage,
+                                                          const cairo_region_t     *damage,
+                                                          const MetaRectangle      *area,
+                                                          float                     scale,
+                                                          ClutterPaintFlag          paint_flags,
+                                                          uint8_t                  *data,
+                                                          int                       stride,
+                                                          GError                  **error)
+{
+  PaintStageData paint_data = {
+    .stage = stage,
+    .scale = scale,
+    .paint_flags = paint_flags,
+  };
+
+  return meta_screen_cast_stream_src_record_damage_to_buffer (src,
+                                                              damage,
+                                                              area,
+                                                              scale,
+                                                              data,
+                                                              stride,
+                                                              paint_stage_rect,
+                                                              &paint_data,
+                                                              error);
+}
+
+static cairo_region_t *
+get_frame_damage (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  cairo_rectangle_int_t stream_rect;
+  cairo_region_t *frame_damage;
+
+  get_stream_rect (src, &stream_rect);
+
+  if (priv->damage_all || cairo_region_is_empty (priv->damage))
+    return cairo_region_create_rectangle (&stream_rect);
+
+  frame_damage = cairo_region_copy (priv->damage);
+  cairo_region_intersect_rectangle (frame_damage, &stream_rect);
+
+  return frame_damage;
+}
+
+static void
+clear_frame_damage (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+
+  g_clear_pointer (&priv->damage, cairo_region_destroy);
+  priv->damage = cairo_region_create ();
+  priv->damage_all = FALSE;
+}
+
+static void
+accumulate_buffer_damage (MetaScreenCastStreamSrc *src,
+                          const cairo_region_t    *frame_damage)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  GHashTableIter iter;
+  cairo_region_t *buffer_damage;
+
+  int i;
+
+  g_hash_table_iter_init (&iter, priv->buffer_damage);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &buffer_damage))
+    cairo_region_union (buffer_damage, frame_damage);
+
+  for (i = 0; i < N_READBACKS; i++)
+    {
+      MetaScreenCastReadback *readback = &priv->readbacks[i];
+
+      if (readback->framebuffer_damage)
+        cairo_region_union (readback->framebuffer_damage, frame_damage);
+    }
+}
+
+static void
+add_video_damage_metadata (MetaScreenCastStreamSrc *src,
+                           struct spa_buffer       *spa_buffer,
+                           const cairo_region_t    *damage)
+{
+  struct spa_meta *spa_meta_video_damage;
+  struct spa_meta_region *spa_meta_region;
+  int n_slots;
+  int n_rects;
+  int i = 0;
+
+  spa_meta_video_damage = spa_buffer_find_meta (spa_buffer,
+                                                SPA_META_VideoDamage);
+  if (!spa_meta_video_damage)
+    return;
+
+  n_slots = spa_meta_video_damage->size / sizeof (struct spa_meta_region);
+  n_rects = damage ? cairo_region_num_rectangles (damage) : 0;
+
+  spa_meta_for_each (spa_meta_region, spa_meta_video_damage)
+    {
+      cairo_rectangle_int_t rect;
+
+      if (i >= n_rects)
+        {
+          spa_meta_region->region = SPA_REGION (0, 0, 0, 0);
+          break;
+        }
+
+      /* Collapse whatever doesn't fit into the last slot. */
+      if (n_rects > n_slots && i == n_slots - 1)
+        {
+          cairo_region_get_rectangle (damage, i, &rect);
+          for (i++; i < n_rects; i++)
+            {
+              cairo_rectangle_int_t next_rect;
+
+              cairo_region_get_rectangle (damage, i, &next_rect);
+              meta_rectangle_union (&rect, &next_rect, &rect);
+            }
+        }
+      else
+        {
+          cairo_region_get_rectangle (damage, i, &rect);
+          i++;
+        }
+
+      spa_meta_region->region.position.x = rect.x;
+      spa_meta_region->region.position.y = rect.y;
+      spa_meta_region->region.size.width = rect.width;
+      spa_meta_region->region.size.height = rect.height;
+    }
+}
+
 static gboolean
 do_record_frame (MetaScreenCastStreamSrc  *src,
                  MetaScreenCastRecordFlag  flags,
@@ -506,13 +996,25 @@ do_record_frame (MetaScreenCastStreamSrc  *src,
       int width = priv->video_format.size.width;
       int height = priv->video_format.size.height;
       int stride = priv->video_stride;
+      cairo_region_t *buffer_damage;
+
+      buffer_damage = g_hash_table_lookup (priv->buffer_damage, spa_buffer);
+      if (!meta_screen_cast_stream_src_record_to_buffer (src,
+                                                         width,
+                                                         height,
+                                                         stride,
+                                                         data,
+                                                         buffer_damage,
+                                                         error))
+        return FALSE;
+
+      if (buffer_damage)
+        {
+          g_hash_table_insert (priv->buffer_damage, spa_buffer,
+                               cairo_region_create ());
+        }
 
-      return meta_screen_cast_stream_src_record_to_buffer (src,
-                                                           width,
-                                                           height,
-                                                           stride,
-                                                           data,
-                                                           error);
+      return TRUE;
     }
   else if (spa_buffer->datas[0].type == SPA_DATA_DmaBuf)
     {
@@ -524,6 +1026,7 @@ do_record_frame (MetaScreenCastStreamSrc  *src,
 
       return meta_screen_cast_stream_src_record_to_framebuffer (src,
                                                                 dmabuf_fbo,
+                                                                NULL,
                                                                 error);
     }
 
@@ -569,13 +1072,463 @@ maybe_schedule_follow_up_frame (MetaScreenCastStreamSrc *src,
                                                    src);
 }
 
+static void
+update_video_crop_metadata (MetaScreenCastStreamSrc *src,
+                            struct spa_buffer       *spa_buffer)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  struct spa_meta_region *spa_meta_video_crop;
+  MetaRectangle crop_rect;
+
+  spa_meta_video_crop =
+    spa_buffer_find_meta_data (spa_buffer, SPA_META_VideoCrop,
+                               sizeof (*spa_meta_video_crop));
+  if (!spa_meta_video_crop)
+    return;
+
+  if (meta_screen_cast_stream_src_get_videocrop (src, &crop_rect))
+    {
+      spa_meta_video_crop->region.position.x = crop_rect.x;
+      spa_meta_video_crop->region.position.y = crop_rect.y;
+      spa_meta_video_crop->region.size.width = crop_rect.width;
+      spa_meta_video_crop->region.size.height = crop_rect.height;
+    }
+  else
+    {
+      spa_meta_video_crop->region.position.x = 0;
+      spa_meta_video_crop->region.position.y = 0;
+      spa_meta_video_crop->region.size.width = priv->video_format.size.width;
+      spa_meta_video_crop->region.size.height = priv->video_format.size.height;
+    }
+}
+
+static CoglContext *
+get_cogl_context (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStream *stream = meta_screen_cast_stream_src_get_stream (src);
+  MetaScreenCastSession *session = meta_screen_cast_stream_get_session (stream);
+  MetaScreenCast *screen_cast =
+    meta_screen_cast_session_get_screen_cast (session);
+  MetaBackend *backend = meta_screen_cast_get_backend (screen_cast);
+  ClutterBackend *clutter_backend = meta_backend_get_clutter_backend (backend);
+
+  return clutter_backend_get_cogl_context (clutter_backend);
+}
+
+static gboolean
+can_readback_async (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  CoglContext *cogl_context;
+  CoglRenderer *cogl_renderer;
+
+  if (priv->async_readback_disabled)
+    return FALSE;
+
+  cogl_context = get_cogl_context (src);
+
+  /* GLES can't read back BGRA directly, so Cogl converts the pixels on the
+   * CPU, mapping the pixel buffer right away and stalling just like a
+   * synchronous readback would. */
+  cogl_renderer = cogl_context_get_renderer (cogl_context);
+  if (cogl_renderer_get_driver (cogl_renderer) == COGL_DRIVER_GLES2)
+    return FALSE;
+
+  return (cogl_has_feature (cogl_context, COGL_FEATURE_ID_FENCE) &&
+          cogl_has_feature (cogl_context, COGL_FEATURE_ID_MAP_BUFFER_FOR_READ));
+}
+
+static MetaScreenCastReadback *
+find_free_readback (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  int i;
+
+  for (i = 0; i < N_READBACKS; i++)
+    {
+      if (!priv->readbacks[i].buffer)
+        return &priv->readbacks[i];
+    }
+
+  return NULL;
+}
+
+static gboolean
+has_pending_readbacks (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  int i;
+
+  for (i = 0; i < N_READBACKS; i++)
+    {
+      if (priv->readbacks[i].buffer)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+clear_readback_buffers (MetaScreenCastReadback *readback)
+{
+  g_clear_pointer (&readback->framebuffer_damage, cairo_region_destroy);
+  g_clear_pointer (&readback->bitmap, cogl_object_unref);
+  g_clear_pointer (&readback->pixel_buffer, cogl_object_unref);
+  g_clear_object (&readback->framebuffer);
+}
+
+static gboolean
+ensure_readback_buffers (MetaScreenCastStreamSrc  *src,
+                         MetaScreenCastReadback   *readback,
+                         GError                  **error)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  CoglContext *cogl_context = get_cogl_context (src);
+  int width = priv->video_format.size.width;
+  int height = priv->video_format.size.height;
+  int stride = width * 4;
+  CoglTexture2D *texture;
+  CoglOffscreen *offscreen;
+  CoglFramebuffer *framebuffer;
+
+  if (readback->framebuffer &&
+      readback->width == width &&
+      readback->height == height)
+    return TRUE;
+
+  clear_readback_buffers (readback);
+
+  texture = cogl_texture_2d_new_with_size (cogl_context, width, height);
+  cogl_primitive_texture_set_auto_mipmap (COGL_PRIMITIVE_TEXTURE (texture),
+                                          FALSE);
+  if (!cogl_texture_allocate (COGL_TEXTURE (texture), error))
+    {
+      cogl_object_unref (texture);
+      return FALSE;
+    }
+
+  offscreen = cogl_offscreen_new_with_texture (COGL_TEXTURE (texture));
+  framebuffer = COGL_FRAMEBUFFER (offscreen);
+  cogl_object_unref (texture);
+  if (!cogl_framebuffer_allocate (framebuffer, error))
+    {
+      g_object_unref (framebuffer);
+      return FALSE;
+    }
+
+  readback->framebuffer = framebuffer;
+  readback->pixel_buffer = cogl_pixel_buffer_new (cogl_context,
+                                                  stride * height,
+                                                  NULL);
+  readback->bitmap =
+    cogl_bitmap_new_from_buffer (COGL_BUFFER (readback->pixel_buffer),
+                                 CLUTTER_CAIRO_FORMAT_ARGB32,
+                                 width, height,
+                                 stride,
+                                 0);
+  readback->width = width;
+  readback->height = height;
+  readback->stride = stride;
+
+  return TRUE;
+}
+
+static void
+copy_damaged_pixels (const uint8_t        *src_data,
+                     int                   src_stride,
+                     uint8_t              *dst_data,
+                     int                   dst_stride,
+                     int                   width,
+                     int                   height,
+                     const cairo_region_t *damage)
+{
+  const int bpp = 4;
+  int n_rects, i;
+
+  if (!damage && src_stride == dst_stride)
+    {
+      memcpy (dst_data, src_data, (size_t) dst_stride * height);
+      return;
+    }
+
+  if (!damage)
+    {
+      int y;
+
+      for (y = 0; y < height; y++)
+        {
+          memcpy (dst_data + y * dst_stride,
+                  src_data + y * src_stride,
+                  width * bpp);
+        }
+      return;
+    }
+
+  n_rects = cairo_region_num_rectangles (damage);
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+      int y;
+
+      cairo_region_get_rectangle (damage, i, &rect);
+      for (y = rect.y; y < rect.y + rect.height; y++)
+        {
+          memcpy (dst_data + y * dst_stride + rect.x * bpp,
+                  src_data + y * src_stride + rect.x * bpp,
+                  rect.width * bpp);
+        }
+    }
+}
+
+static void
+reset_buffer_damage (MetaScreenCastStreamSrc *src,
+                     struct spa_buffer       *spa_buffer)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  cairo_rectangle_int_t stream_rect;
+
+  if (!g_hash_table_contains (priv->buffer_damage, spa_buffer))
+    return;
+
+  get_stream_rect (src, &stream_rect);
+  g_hash_table_insert (priv->buffer_damage,
+                       spa_buffer,
+                       cairo_region_create_rectangle (&stream_rect));
+}
+
+static void
+cancel_readback (MetaScreenCastStreamSrc *src,
+                 MetaScreenCastReadback  *readback)
+{
+  if (readback->fence_closure)
+    {
+      cogl_framebuffer_cancel_fence_callback (readback->framebuffer,
+                                              readback->fence_closure);
+      readback->fence_closure = NULL;
+    }
+
+  /* The buffer never received the frame, so it must get a full one next */
+  if (readback->buffer)
+    reset_buffer_damage (src, readback->buffer->buffer);
+
+  g_clear_pointer (&readback->buffer_damage, cairo_region_destroy);
+  readback->buffer = NULL;
+}
+
+static void
+finish_readback (MetaScreenCastStreamSrc *src,
+                 MetaScreenCastReadback  *readback)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  struct pw_buffer *buffer;
+  struct spa_buffer *spa_buffer;
+  const uint8_t *pixels;
+  g_autoptr (GError) error = NULL;
+
+  COGL_TRACE_BEGIN_SCOPED (FinishReadback,
+                           "Screen cast (finish readback)");
+
+  buffer = g_steal_pointer (&readback->buffer);
+  spa_buffer = buffer->buffer;
+
+  if (priv->readback_map_disabled)
+    {
+      pixels = NULL;
+      g_set_error (&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Mapping readback buffers is disabled");
+    }
+  else
+    {
+      pixels = cogl_buffer_map_range (COGL_BUFFER (readback->pixel_buffer),
+                                      0,
+                                      readback->stride * readback->height,
+                                      COGL_BUFFER_ACCESS_READ,
+                                      0,
+                                      &error);
+    }
+
+  if (pixels)
+    {
+      copy_damaged_pixels (pixels, readback->stride,
+                           spa_buffer->datas[0].data, priv->video_stride,
+                           readback->width, readback->height,
+                           readback->buffer_damage);
+      cogl_buffer_unmap (COGL_BUFFER (readback->pixel_buffer));
+
+      spa_buffer->datas[0].chunk->size = spa_buffer->datas[0].maxsize;
+      spa_buffer->datas[0].chunk->stride = priv->video_stride;
+    }
+  else
+    {
+      meta_topic (META_DEBUG_SCREEN_CAST,
+                  "Failed to map readback buffer, falling back to "
+                  "synchronous readback: %s", error->message);
+      g_clear_error (&error);
+      priv->async_readback_disabled = TRUE;
+
+      /* The pixels that were read back are out of reach, so the buffer
+       * is recorded again as a whole, with the current stage contents. */
+      reset_buffer_damage (src, spa_buffer);
+      if (do_record_frame (src, META_SCREEN_CAST_RECORD_FLAG_NONE,
+                           spa_buffer, spa_buffer->datas[0].data,
+                           &error))
+        {
+          cairo_rectangle_int_t stream_rect;
+          cairo_region_t *frame_damage;
+
+          spa_buffer->datas[0].chunk->size = spa_buffer->datas[0].maxsize;
+          spa_buffer->datas[0].chunk->stride = priv->video_stride;
+
+          get_stream_rect (src, &stream_rect);
+          frame_damage = cairo_region_create_rectangle (&stream_rect);
+          add_video_damage_metadata (src, spa_buffer, frame_damage);
+          cairo_region_destroy (frame_damage);
+        }
+      else
+        {
+          g_warning ("Failed to record screen cast frame: %s",
+                     error->message);
+          spa_buffer->datas[0].chunk->size = 0;
+          add_video_damage_metadata (src, spa_buffer, NULL);
+          reset_buffer_damage (src, spa_buffer);
+          meta_screen_cast_stream_src_damage_all (src);
+        }
+    }
+
+  g_clear_pointer (&readback->buffer_damage, cairo_region_destroy);
+
+  /* Cursor metadata is filled in last so that it is as fresh as possible
+   * when the frame reaches the consumer. */
+  maybe_record_cursor (src, spa_buffer);
+
+  pw_stream_queue_buffer (priv->pipewire_stream, buffer);
+
+  if (priv->has_pending_record)
+    {
+      priv->has_pending_record = FALSE;
+      meta_screen_cast_stream_src_maybe_record_frame (src,
+                                                      priv->pending_record_flags);
+    }
+}
+
+static void
+on_readback_fence (CoglFence *fence,
+                   void      *user_data)
+{
+  MetaScreenCastReadback *readback = user_data;
+
+  readback->fence_closure = NULL;
+  finish_readback (readback->src, readback);
+}
+
+static gboolean
+start_readback (MetaScreenCastStreamSrc  *src,
+                struct pw_buffer         *buffer,
+                GError                  **error)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  MetaScreenCastReadback *readback;
+  cairo_region_t *buffer_damage;
+
+  COGL_TRACE_BEGIN_SCOPED (StartReadback,
+                           "Screen cast (start readback)");
+
+  readback = find_free_readback (src);
+  g_return_val_if_fail (readback, FALSE);
+
+  if (!ensure_readback_buffers (src, readback, error))
+    return FALSE;
+
+  /* Only repaint what changed since this framebuffer was last recorded */
+  if (!meta_screen_cast_stream_src_record_to_framebuffer (src,
+                                                          readback->framebuffer,
+                                                          readback->framebuffer_damage,
+                                                          error))
+    {
+      g_clear_pointer (&readback->framebuffer_damage, cairo_region_destroy);
+      return FALSE;
+    }
+
+  g_clear_pointer (&readback->framebuffer_damage, cairo_region_destroy);
+  readback->framebuffer_damage = cairo_region_create ();
+
+  if (!cogl_framebuffer_read_pixels_into_bitmap (readback->framebuffer,
+                                                 0, 0,
+                                                 COGL_READ_PIXELS_COLOR_BUFFER,
+                                                 readback->bitmap))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Failed to read back framebuffer");
+      return FALSE;
+    }
+
+  readback->fence_closure =
+    cogl_framebuffer_add_fence_callback (readback->framebuffer,
+                                         on_readback_fence,
+                                         readback);
+  if (!readback->fence_closure)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Failed to add readback fence");
+      return FALSE;
+    }
+
+  cogl_framebuffer_flush (readback->framebuffer);
+
+  readback->buffer = buffer;
+
+  /* Snapshot the area that is out of date in this buffer; damage from frames
+   * recorded while the readback is in flight must not be cleared by it. */
+  buffer_damage = g_hash_table_lookup (priv->buffer_damage, buffer->buffer);
+  if (buffer_damage)
+    {
+      readback->buffer_damage = cairo_region_copy (buffer_damage);
+      g_hash_table_insert (priv->buffer_damage, buffer->buffer,
+                           cairo_region_create ());
+    }
+
+  return TRUE;
+}
+
+static void
+cancel_readbacks (MetaScreenCastStreamSrc *src)
+{
+  MetaScreenCastStreamSrcPrivate *priv =
+    meta_screen_cast_stream_src_get_instance_private (src);
+  int i;
+
+  for (i = 0; i < N_READBACKS; i++)
+    {
+      MetaScreenCastReadback *readback = &priv->readbacks[i];
+      struct pw_buffer *buffer = readback->buffer;
+
+      if (!buffer)
+        continue;
+
+      cancel_readback (src, readback);
+
+      buffer->buffer->datas[0].chunk->size = 0;
+      if (priv->pipewire_stream)
+        pw_stream_queue_buffer (priv->pipewire_stream, buffer);
+    }
+
+  priv->has_pending_record = FALSE;
+}
+
 void
 meta_screen_cast_stream_src_maybe_record_frame (MetaScreenCastStreamSrc  *src,
                                                 MetaScreenCastRecordFlag  flags)
 {
   MetaScreenCastStreamSrcPrivate *priv =
     meta_screen_cast_stream_src_get_instance_private (src);
-  MetaRectangle crop_rect;
   struct pw_buffer *buffer;
   struct spa_buffer *spa_buffer;
   uint8_t *data = NULL;
@@ -607,6 +1560,24 @@ meta_screen_cast_stream_src_maybe_record_frame (MetaScreenCastStreamSrc  *src,
   if (!priv->pipewire_stream)
     return;
 
+  if (flags & META_SCREEN_CAST_RECORD_FLAG_CURSOR_ONLY)
+    {
+      /* A frame that is still being read back gets the latest cursor
+       * metadata when it is queued. */
+      if (has_pending_readbacks (src))
+        return;
+    }
+  else if (!find_free_readback (src))
+    {
+      meta_topic (META_DEBUG_SCREEN_CAST,
+                  "All readbacks of pipewire stream (node id %u) are busy, "
+                  "postponing frame",
+                  pw_stream_get_node_id (priv->pipewire_stream));
+      priv->pending_record_flags = flags;
+      priv->has_pending_record = TRUE;
+      return;
+    }
+
   buffer = pw_stream_dequeue_buffer (priv->pipewire_stream);
   if (!buffer)
     {
@@ -628,47 +1599,56 @@ meta_screen_cast_stream_src_maybe_record_frame (MetaScreenCastStreamSrc  *src,
 
   if (!(flags & META_SCREEN_CAST_RECORD_FLAG_CURSOR_ONLY))
     {
+      cairo_region_t *frame_damage;
+
       g_clear_handle_id (&priv->follow_up_frame_source_id, g_source_remove);
-      if (do_record_frame (src, flags, spa_buffer, data, &error))
+
+      frame_damage = get_frame_damage (src);
+      accumulate_buffer_damage (src, frame_damage);
+
+      if (spa_buffer->datas[0].type == SPA_DATA_MemFd &&
+          can_readback_async (src))
         {
-          struct spa_meta_region *spa_meta_video_crop;
+          if (start_readback (src, buffer, &error))
+            {
+              add_video_damage_metadata (src, spa_buffer, frame_damage);
+              update_video_crop_metadata (src, spa_buffer);
+              clear_frame_damage (src);
+              cairo_region_destroy (frame_damage);
 
+              priv->last_frame_timestamp_us = now_us;
+              return;
+            }
+
+          meta_topic (META_DEBUG_SCREEN_CAST,
+                      "Asynchronous readback failed, falling back to "
+                      "synchronous readback: %s", error->message);
+          g_clear_error (&error);
+          priv->async_readback_disabled = TRUE;
+        }
+
+      if (do_record_frame (src, flags, spa_buffer, data, &error))
+        {
           spa_buffer->datas[0].chunk->size = spa_buffer->datas[0].maxsize;
           spa_buffer->datas[0].chunk->stride = priv->video_stride;
 
-          /* Update VideoCrop if needed */
-          spa_meta_video_crop =
-            spa_buffer_find_meta_data (spa_buffer, SPA_META_VideoCrop,
-                                       sizeof (*spa_meta_video_crop));
-          if (spa_meta_video_crop)
-            {
-              if (meta_screen_cast_stream_src_get_videocrop (src, &crop_rect))
-                {
-                  spa_meta_video_crop->region.position.x = crop_rect.x;
-                  spa_meta_video_crop->region.position.y = crop_rect.y;
-                  spa_meta_video_crop->region.size.width = crop_rect.width;
-                  spa_meta_video_crop->region.size.height = crop_rect.height;
-                }
-              else
-                {
-                  spa_meta_video_crop->region.position.x = 0;
-                  spa_meta_video_crop->region.position.y = 0;
-                  spa_meta_video_crop->region.size.width =
-                    priv->video_format.size.width;
-                  spa_meta_video_crop->region.size.height =
-                    priv->video_format.size.height;
-                }
-            }
+          add_video_damage_metadata (src, spa_buffer, frame_damage);
+          update_video_crop_metadata (src, spa_buffer);
+          clear_frame_damage (src);
         }
       else
         {
           g_warning ("Failed to record screen cast frame: %s", error->message);
           spa_buffer->datas[0].chunk->size = 0;
+          add_video_damage_metadata (src, spa_buffer, NULL);
         }
+
+      cairo_region_destroy (frame_damage);
     }
   else
     {
       spa_buffer->datas[0].chunk->size = 0;
+      add_video_damage_metadata (src, spa_buffer, NULL);
     }
 
   maybe_record_cursor (src, spa_buffer);
@@ -693,6 +1673,8 @@ meta_screen_cast_stream_src_enable (MetaScreenCastStreamSrc *src)
   MetaScreenCastStreamSrcPrivate *priv =
     meta_screen_cast_stream_src_get_instance_private (src);
 
+  meta_screen_cast_stream_src_damage_all (src);
+
   META_SCREEN_CAST_STREAM_SRC_GET_CLASS (src)->enable (src);
 
   priv->is_enabled = TRUE;
@@ -707,6 +1689,7 @@ meta_screen_cast_stream_src_disable (MetaScreenCastStreamSrc *src)
   META_SCREEN_CAST_STREAM_SRC_GET_CLASS (src)->disable (src);
 
   g_clear_handle_id (&priv->follow_up_frame_source_id, g_source_remove);
+  cancel_readbacks (src);
 
   priv->is_enabled = FALSE;
 }
@@ -770,7 +1753,7 @@ on_stream_param_changed (void                 *data,
   uint8_t params_buffer[1024];
   int32_t width, height, stride, size;
   struct spa_pod_builder pod_builder;
-  const struct spa_pod *params[3];
+  const struct spa_pod *params[4];
   const int bpp = 4;
   int buffer_types;
 
@@ -815,6 +1798,17 @@ on_stream_param_changed (void                 *data,
     SPA_PARAM_META_type, SPA_POD_Id (SPA_META_Cursor),
     SPA_PARAM_META_size, SPA_POD_Int (CURSOR_META_SIZE (384, 384)));
 
+  params[3] = spa_pod_builder_add_object (
+    &pod_builder,
+    SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+    SPA_PARAM_META_type, SPA_POD_Id (SPA_META_VideoDamage),
+    SPA_PARAM_META_size, SPA_POD_CHOICE_RANGE_Int (
+      sizeof (struct spa_meta_region) * MAX_DAMAGE_RECTS,
+      sizeof (struct spa_meta_region) * 1,
+      sizeof (struct spa_meta_region) * MAX_DAMAGE_RECTS));
+
+  meta_screen_cast_stream_src_damage_all (src);
+
   pw_stream_update_params (priv->pipewire_stream, params, G_N_ELEMENTS (params));
 
   if (klass->notify_params_updated)
@@ -835,6 +1829,7 @@ on_stream_add_buffer (void             *data,
   CoglDmaBufHandle *dmabuf_handle;
   struct spa_buffer *spa_buffer = buffer->buffer;
   struct spa_data *spa_data = spa_buffer->datas;
+  cairo_rectangle_int_t stream_rect;
   const int bpp = 4;
   int stride;
 
@@ -923,6 +1918,12 @@ on_stream_add_buffer (void             *data,
           g_critical ("Failed to mmap memory: %m");
           return;
         }
+
+      /* A fresh buffer has no valid content yet */
+      get_stream_rect (src, &stream_rect);
+      g_hash_table_insert (priv->buffer_damage,
+                           spa_buffer,
+                           cairo_region_create_rectangle (&stream_rect));
     }
 }
 
@@ -935,6 +1936,13 @@ on_stream_remove_buffer (void             *data,
     meta_screen_cast_stream_src_get_instance_private (src);
   struct spa_buffer *spa_buffer = buffer->buffer;
   struct spa_data *spa_data = spa_buffer->datas;
+  int i;
+
+  for (i = 0; i < N_READBACKS; i++)
+    {
+      if (priv->readbacks[i].buffer == buffer)
+        cancel_readback (src, &priv->readbacks[i]);
+    }
 
   if (spa_data[0].type == SPA_DATA_DmaBuf)
     {
@@ -945,6 +1953,8 @@ on_stream_remove_buffer (void             *data,
     {
       g_warn_if_fail (spa_data[0].fd > 0 || !spa_data[0].data);
 
+      g_hash_table_remove (priv->buffer_damage, spa_buffer);
+
       if (spa_data[0].fd > 0)
         {
           munmap (spa_data[0].data, spa_data[0].maxsize);
@@ -1296,12 +2306,18 @@ meta_screen_cast_stream_src_dispose (GObject *object)
   MetaScreenCastStreamSrc *src = META_SCREEN_CAST_STREAM_SRC (object);
   MetaScreenCastStreamSrcPrivate *priv =
     meta_screen_cast_stream_src_get_instance_private (src);
+  int i;
 
   if (meta_screen_cast_stream_src_is_enabled (src))
     meta_screen_cast_stream_src_disable (src);
 
+  cancel_readbacks (src);
   g_clear_pointer (&priv->pipewire_stream, pw_stream_destroy);
+  for (i = 0; i < N_READBACKS; i++)
+    clear_readback_buffers (&priv->readbacks[i]);
   g_clear_pointer (&priv->dmabuf_handles, g_hash_table_destroy);
+  g_clear_pointer (&priv->buffer_damage, g_hash_table_destroy);
+  g_clear_pointer (&priv->damage, cairo_region_destroy);
   g_clear_pointer (&priv->pipewire_core, pw_core_disconnect);
   g_clear_pointer (&priv->pipewire_context, pw_context_destroy);
   g_clear_pointer (&priv->pipewire_source, g_source_destroy);
@@ -1354,10 +2370,21 @@ meta_screen_cast_stream_src_init (MetaScreenCastStreamSrc *src)
 {
   MetaScreenCastStreamSrcPrivate *priv =
     meta_screen_cast_stream_src_get_instance_private (src);
+  int i;
 
   priv->dmabuf_handles =
     g_hash_table_new_full (NULL, NULL, NULL,
                            (GDestroyNotify) cogl_dma_buf_handle_free);
+  priv->buffer_damage =
+    g_hash_table_new_full (NULL, NULL, NULL,
+                           (GDestroyNotify) cairo_region_destroy);
+  priv->damage = cairo_region_create ();
+
+  if (g_getenv ("MUTTER_DEBUG_DISABLE_SCREEN_CAST_READBACK_MAP"))
+    priv->readback_map_disabled = TRUE;
+
+  for (i = 0; i < N_READBACKS; i++)
+    priv->readbacks[i].src = src;
 }
 
 static void
@@ -65,9 +65,11 @@ struct _MetaScreenCastStreamSrcClass
                                  int                       height,
                                  int                       stride,
                                  uint8_t                  *data,
+                                 const cairo_region_t     *damage,
                                  GError                  **error);
   gboolean (* record_to_framebuffer) (MetaScreenCastStreamSrc  *src,
                                       CoglFramebuffer          *framebuffer,
+                                      const cairo_region_t     *damage,
                                       GError                  **error);
   void (* record_follow_up) (MetaScreenCastStreamSrc *src);
 
@@ -80,6 +82,13 @@ struct _MetaScreenCastStreamSrcClass
                                   struct spa_video_info_raw *video_format);
 };
 
+typedef gboolean (* MetaScreenCastRecordStageRectFunc) (MetaScreenCastStreamSrc  *src,
+                                                        const MetaRectangle      *rect,
+                                                        uint8_t                  *data,
+                                                        int                       stride,
+                                                        gpointer                  user_data,
+                                                        GError                  **error);
+
 void meta_screen_cast_stream_src_close (MetaScreenCastStreamSrc *src);
 
 gboolean meta_screen_cast_stream_src_is_enabled (MetaScreenCastStreamSrc *src);
@@ -91,6 +100,49 @@ gboolean meta_screen_cast_stream_src_pending_follow_up_frame (MetaScreenCastStre
 
 MetaScreenCastStream * meta_screen_cast_stream_src_get_stream (MetaScreenCastStreamSrc *src);
 
+void meta_screen_cast_stream_src_add_damage (MetaScreenCastStreamSrc *src,
+                                             const cairo_region_t    *damage);
+
+void meta_screen_cast_stream_src_add_stage_damage (MetaScreenCastStreamSrc *src,
+                                                   const cairo_region_t    *stage_damage,
+                                                   const MetaRectangle     *area,
+                                                   float                    scale);
+
+void meta_screen_cast_stream_src_damage_all (MetaScreenCastStreamSrc *src);
+
+cairo_region_t * meta_screen_cast_stream_src_calculate_stage_damage (MetaScreenCastStreamSrc *src,
+                                                                     const cairo_region_t    *damage,
+                                                                     const MetaRectangle     *area,
+                                                                     float                    scale);
+
+gboolean meta_screen_cast_stream_src_record_damage_to_buffer (MetaScreenCastStreamSrc              *src,
+                                                              const cairo_region_t                 *damage,
+                                                              const MetaRectangle                  *area,
+                                                              float                                 scale,
+                                                              uint8_t                              *data,
+                                                              int                                   stride,
+                                                              MetaScreenCastRecordStageRectFunc     record_func,
+                                                              gpointer                              user_data,
+                                                              GError                              **error);
+
+gboolean meta_screen_cast_stream_src_blit_damage (MetaScreenCastStreamSrc  *src,
+                                                  CoglFramebuffer          *src_framebuffer,
+                                                  CoglFramebuffer          *dst_framebuffer,
+                                                  int                       dst_x,
+                                                  int                       dst_y,
+                                                  const cairo_region_t     *damage,
+                                                  GError                  **error);
+
+gboolean meta_screen_cast_stream_src_paint_stage_damage_to_buffer (MetaScreenCastStreamSrc  *src,
+                                                                   ClutterStage             *stage,
+                                                                   const cairo_region_t     *damage,
+                                                                   const MetaRectangle      *area,
+                                                                   float                     scale,
+                                                                   ClutterPaintFlag          paint_flags,
+                                                                   uint8_t                  *data,
+                                                                   int                       stride,
+                                                                   GError                  **error);
+
 gboolean meta_screen_cast_stream_src_draw_cursor_into (MetaScreenCastStreamSrc  *src,
                                                        CoglTexture              *cursor_texture,
                                                        float                     scale,
@@ -189,6 +189,15 @@ actors_painted (MetaStage           *stage,
 {
   MetaScreenCastStreamSrc *src = META_SCREEN_CAST_STREAM_SRC (user_data);
   MetaScreenCastRecordFlag flags;
+  const cairo_region_t *redraw_clip;
+  MetaRectangle view_layout;
+
+  clutter_stage_view_get_layout (view, &view_layout);
+  redraw_clip = clutter_paint_context_get_redraw_clip (paint_context);
+  meta_screen_cast_stream_src_add_stage_damage (src,
+                                                redraw_clip,
+                                                &view_layout,
+                                                clutter_stage_view_get_scale (view));
 
   flags = META_SCREEN_CAST_RECORD_FLAG_NONE;
   meta_screen_cast_stream_src_maybe_record_frame (src, flags);
@@ -333,26 +342,55 @@ meta_screen_cast_virtual_stream_src_disable (MetaScreenCastStreamSrc *src)
     }
 }
 
+static gboolean
+capture_view_rect (MetaScreenCastStreamSrc  *src,
+                   const MetaRectangle      *rect,
+                   uint8_t                  *data,
+                   int                       stride,
+                   gpointer                  user_data,
+                   GError                  **error)
+{
+  ClutterStageView *view = user_data;
+
+  clutter_stage_capture_view_into (stage_from_src (src),
+                                   view,
+                                   (MetaRectangle *) rect,
+                                   data,
+                                   stride);
+  return TRUE;
+}
+
 static gboolean
 meta_screen_cast_virtual_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *src,
                                                       int                       width,
                                                       int                       height,
                                                       int                       stride,
                                                       uint8_t                  *data,
+                                                      const cairo_region_t     *damage,
                                                       GError                  **error)
 {
-  clutter_stage_capture_view_into (stage_from_src (src),
-                                   view_from_src (src),
-                                   NULL,
-                                   data,
-                                   stride);
+  ClutterStageView *view = view_from_src (src);
+  MetaRectangle view_layout;
+  float view_scale;
 
-  return TRUE;
+  clutter_stage_view_get_layout (view, &view_layout);
+  view_scale = clutter_stage_view_get_scale (view);
+
+  return meta_screen_cast_stream_src_record_damage_to_buffer (src,
+                                                              damage,
+                                                              &view_layout,
+                                                              view_scale,
+                                                              data,
+                                                              stride,
+                                                              capture_view_rect,
+                                                              view,
+                                                              error);
 }
 
 static gboolean
 meta_screen_cast_virtual_stream_src_record_to_framebuffer (MetaScreenCastStreamSrc  *src,
                                                            CoglFramebuffer          *framebuffer,
+                                                           const cairo_region_t     *damage,
                                                            GError                  **error)
 {
   ClutterStageView *view;
@@ -360,13 +398,12 @@ meta_screen_cast_virtual_stream_src_record_to_framebuffer (MetaScreenCastStreamS
 
   view = view_from_src (src);
   view_framebuffer = clutter_stage_view_get_framebuffer (view);
-  if (!cogl_blit_framebuffer (view_framebuffer,
-                              framebuffer,
-                              0, 0,
-                              0, 0,
-                              cogl_framebuffer_get_width (view_framebuffer),
-                              cogl_framebuffer_get_height (view_framebuffer),
-                              error))
+  if (!meta_screen_cast_stream_src_blit_damage (src,
+                                                view_framebuffer,
+                                                framebuffer,
+                                                0, 0,
+                                                damage,
+                                                error))
     return FALSE;
 
   cogl_framebuffer_flush (framebuffer);
@@ -361,6 +361,9 @@ screen_cast_window_damaged (MetaWindowActor               *actor,
   MetaScreenCastStreamSrc *src = META_SCREEN_CAST_STREAM_SRC (window_src);
   MetaScreenCastRecordFlag flags;
 
+  /* The window is captured as a whole, so damage covers the whole stream */
+  meta_screen_cast_stream_src_damage_all (src);
+
   flags = META_SCREEN_CAST_RECORD_FLAG_NONE;
   meta_screen_cast_stream_src_maybe_record_frame (src, flags);
 }
@@ -483,6 +486,7 @@ meta_screen_cast_window_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *s
                                                      int                       height,
                                                      int                       stride,
                                                      uint8_t                  *data,
+                                                     const cairo_region_t     *damage,
                                                      GError                  **error)
 {
   MetaScreenCastWindowStreamSrc *window_src =
@@ -496,6 +500,7 @@ meta_screen_cast_window_stream_src_record_to_buffer (MetaScreenCastStreamSrc  *s
 static gboolean
 meta_screen_cast_window_stream_src_record_to_framebuffer (MetaScreenCastStreamSrc  *src,
                                                           CoglFramebuffer          *framebuffer,
+                                                          const cairo_region_t     *damage,
                                                           GError                  **error)
 {
   MetaScreenCastWindowStreamSrc *window_src =
@@ -35,6 +35,11 @@ typedef enum _MetaExperimentalFeature
   META_EXPERIMENTAL_FEATURE_KMS_MODIFIERS  = (1 << 1),
   META_EXPERIMENTAL_FEATURE_RT_SCHEDULER = (1 << 2),
   META_EXPERIMENTAL_FEATURE_AUTOCLOSE_XWAYLAND  = (1 << 3),
+  META_EXPERIMENTAL_FEATURE_VARIABLE_REFRESH_RATE = (1 << 4),
+  META_EXPERIMENTAL_FEATURE_SHM_UDMABUF = (1 << 5),
+  META_EXPERIMENTAL_FEATURE_OVERLAY_PLANES = (1 << 6),
+  META_EXPERIMENTAL_FEATURE_FRAME_CALLBACK_PACING = (1 << 7),
+  META_EXPERIMENTAL_FEATURE_SHADOW_DISK_CACHE = (1 << 8),
 } MetaExperimentalFeature;
 
 typedef enum _MetaXwaylandExtension
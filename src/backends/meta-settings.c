@@ -296,6 +296,16 @@ experimental_features_handler (GVariant *features_variant,
         feature = META_EXPERIMENTAL_FEATURE_RT_SCHEDULER;
       else if (g_str_equal (feature_str, "autoclose-xwayland"))
         feature = META_EXPERIMENTAL_FEATURE_AUTOCLOSE_XWAYLAND;
+      else if (g_str_equal (feature_str, "variable-refresh-rate"))
+        feature = META_EXPERIMENTAL_FEATURE_VARIABLE_REFRESH_RATE;
+      else if (g_str_equal (feature_str, "shm-udmabuf"))
+        feature = META_EXPERIMENTAL_FEATURE_SHM_UDMABUF;
+      else if (g_str_equal (feature_str, "overlay-planes"))
+        feature = META_EXPERIMENTAL_FEATURE_OVERLAY_PLANES;
+      else if (g_str_equal (feature_str, "frame-callback-pacing"))
+        feature = META_EXPERIMENTAL_FEATURE_FRAME_CALLBACK_PACING;
+      else if (g_str_equal (feature_str, "shadow-disk-cache"))
+        feature = META_EXPERIMENTAL_FEATURE_SHADOW_DISK_CACHE;
 
       if (feature)
         g_message ("Enabling experimental feature '%s'", feature_str);
@@ -60,6 +60,9 @@ void meta_overlay_set_visible (MetaOverlay *overlay,
 
 gboolean meta_overlay_is_visible (MetaOverlay *overlay);
 
+gboolean meta_stage_overlays_intersect (MetaStage             *stage,
+                                        const graphene_rect_t *rect);
+
 void meta_stage_set_active (MetaStage *stage,
                             gboolean   is_active);
 
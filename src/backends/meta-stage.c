@@ -430,6 +430,34 @@ meta_overlay_is_visible (MetaOverlay *overlay)
   return overlay->is_visible;
 }
 
+/**
+ * meta_stage_overlays_intersect:
+ * @stage: A #MetaStage
+ * @rect: A rectangle in stage coordinates
+ *
+ * Returns: %TRUE if a visible overlay, such as a software cursor, is painted
+ *   on top of the stage within @rect.
+ */
+gboolean
+meta_stage_overlays_intersect (MetaStage             *stage,
+                               const graphene_rect_t *rect)
+{
+  GList *l;
+
+  for (l = stage->overlays; l; l = l->next)
+    {
+      MetaOverlay *overlay = l->data;
+
+      if (!overlay->is_visible || !overlay->texture)
+        continue;
+
+      if (graphene_rect_intersection (&overlay->current_rect, rect, NULL))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 void
 meta_stage_set_active (MetaStage *stage,
                        gboolean   is_active)
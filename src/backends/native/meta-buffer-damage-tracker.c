@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Keeps track of which parts of a set of buffers, that are updated in turns
+ * by copying only the damaged parts of each frame into them, are out of date.
+ * A buffer misses the damage of every frame written into the other buffers
+ * since it was last written itself, no matter how many frames that was.
+ */
+
+#include "config.h"
+
+#include "backends/native/meta-buffer-damage-tracker.h"
+
+struct _MetaBufferDamageTracker
+{
+  int n_buffers;
+
+  /* Damage each buffer missed since it was last updated, NULL if its
+   * content is entirely stale. */
+  cairo_region_t **missed_damage;
+};
+
+MetaBufferDamageTracker *
+meta_buffer_damage_tracker_new (int n_buffers)
+{
+  MetaBufferDamageTracker *tracker;
+
+  g_return_val_if_fail (n_buffers > 0, NULL);
+
+  tracker = g_new0 (MetaBufferDamageTracker, 1);
+  tracker->n_buffers = n_buffers;
+  tracker->missed_damage = g_new0 (cairo_region_t *, n_buffers);
+
+  return tracker;
+}
+
+void
+meta_buffer_damage_tracker_free (MetaBufferDamageTracker *tracker)
+{
+  int i;
+
+  for (i = 0; i < tracker->n_buffers; i++)
+    g_clear_pointer (&tracker->missed_damage[i], cairo_region_destroy);
+
+  g_free (tracker->missed_damage);
+  g_free (tracker);
+}
+
+/**
+ * meta_buffer_damage_tracker_get_update_region:
+ * @tracker: a #MetaBufferDamageTracker
+ * @index: the buffer that is about to be updated
+ * @damage: (nullable): the damage of the current frame, or %NULL if all of
+ *   it changed
+ *
+ * Returns: (transfer full) (nullable): the region of the buffer at @index
+ *   that needs to be updated for it to match the current frame, i.e. @damage
+ *   plus the damage of the frames it missed, or %NULL if the whole buffer
+ *   needs to be updated.
+ */
+cairo_region_t *
+meta_buffer_damage_tracker_get_update_region (MetaBufferDamageTracker *tracker,
+                                              int                      index,
+                                              const cairo_region_t    *damage)
+{
+  cairo_region_t *missed_damage;
+  cairo_region_t *update_region;
+
+  g_return_val_if_fail (index >= 0 && index < tracker->n_buffers, NULL);
+
+  missed_damage = tracker->missed_damage[index];
+  if (!missed_damage || !damage)
+    return NULL;
+
+  update_region = cairo_region_copy (missed_damage);
+  cairo_region_union (update_region, damage);
+
+  return update_region;
+}
+
+/**
+ * meta_buffer_damage_tracker_buffer_updated:
+ * @tracker: a #MetaBufferDamageTracker
+ * @index: the buffer that was updated
+ * @damage: (nullable): the damage of the current frame, or %NULL if all of
+ *   it changed
+ *
+ * Marks the buffer at @index as up to date, and all other buffers as missing
+ * @damage.
+ */
+void
+meta_buffer_damage_tracker_buffer_updated (MetaBufferDamageTracker *tracker,
+                                           int                      index,
+                                           const cairo_region_t    *damage)
+{
+  int i;
+
+  g_return_if_fail (index >= 0 && index < tracker->n_buffers);
+
+  for (i = 0; i < tracker->n_buffers; i++)
+    {
+      cairo_region_t **missed_damage = &tracker->missed_damage[i];
+
+      if (i == index)
+        {
+          g_clear_pointer (missed_damage, cairo_region_destroy);
+          *missed_damage = cairo_region_create ();
+        }
+      else if (!damage)
+        {
+          g_clear_pointer (missed_damage, cairo_region_destroy);
+        }
+      else if (*missed_damage)
+        {
+          cairo_region_union (*missed_damage, damage);
+        }
+    }
+}
+
+/**
+ * meta_buffer_damage_tracker_invalidate:
+ * @tracker: a #MetaBufferDamageTracker
+ * @index: the buffer with stale content
+ *
+ * Marks the whole buffer at @index as out of date, e.g. after a failed or
+ * partial update.
+ */
+void
+meta_buffer_damage_tracker_invalidate (MetaBufferDamageTracker *tracker,
+                                       int                      index)
+{
+  g_return_if_fail (index >= 0 && index < tracker->n_buffers);
+
+  g_clear_pointer (&tracker->missed_damage[index], cairo_region_destroy);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef META_BUFFER_DAMAGE_TRACKER_H
+#define META_BUFFER_DAMAGE_TRACKER_H
+
+#include <cairo.h>
+#include <glib.h>
+
+#include "core/util-private.h"
+
+typedef struct _MetaBufferDamageTracker MetaBufferDamageTracker;
+
+META_EXPORT_TEST
+MetaBufferDamageTracker * meta_buffer_damage_tracker_new (int n_buffers);
+
+META_EXPORT_TEST
+void meta_buffer_damage_tracker_free (MetaBufferDamageTracker *tracker);
+
+META_EXPORT_TEST
+cairo_region_t * meta_buffer_damage_tracker_get_update_region (MetaBufferDamageTracker *tracker,
+                                                               int                      index,
+                                                               const cairo_region_t    *damage);
+
+META_EXPORT_TEST
+void meta_buffer_damage_tracker_buffer_updated (MetaBufferDamageTracker *tracker,
+                                                int                      index,
+                                                const cairo_region_t    *damage);
+
+META_EXPORT_TEST
+void meta_buffer_damage_tracker_invalidate (MetaBufferDamageTracker *tracker,
+                                            int                      index);
+
+#endif /* META_BUFFER_DAMAGE_TRACKER_H */
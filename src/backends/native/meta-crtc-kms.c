@@ -272,6 +272,54 @@ meta_crtc_kms_set_mode (MetaCrtcKms   *crtc_kms,
                             meta_crtc_kms_get_kms_crtc (crtc_kms),
                             g_steal_pointer (&connectors),
                             kms_mode);
+
+  /* Variable refresh rate is enabled on demand, for a specific client;
+   * don't let it outlive a mode set.
+   */
+  if (meta_kms_crtc_get_current_state (crtc_kms->kms_crtc)->vrr_enabled)
+    meta_kms_update_set_vrr (kms_update, crtc_kms->kms_crtc, FALSE);
+}
+
+gboolean
+meta_crtc_kms_supports_vrr (MetaCrtcKms *crtc_kms)
+{
+  MetaCrtc *crtc = META_CRTC (crtc_kms);
+  const GList *l;
+
+  if (!meta_kms_crtc_supports_vrr (crtc_kms->kms_crtc))
+    return FALSE;
+
+  if (!meta_crtc_get_outputs (crtc))
+    return FALSE;
+
+  for (l = meta_crtc_get_outputs (crtc); l; l = l->next)
+    {
+      MetaOutput *output = l->data;
+
+      if (!meta_output_get_info (output)->supports_vrr)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+void
+meta_crtc_kms_set_vrr_enabled (MetaCrtcKms *crtc_kms,
+                               gboolean     enabled)
+{
+  MetaKmsDevice *kms_device = meta_kms_crtc_get_device (crtc_kms->kms_crtc);
+  MetaKms *kms = meta_kms_device_get_kms (kms_device);
+  MetaKmsUpdate *kms_update;
+
+  g_return_if_fail (meta_kms_crtc_supports_vrr (crtc_kms->kms_crtc));
+
+  meta_topic (META_DEBUG_KMS,
+              "%s variable refresh rate on CRTC (%" G_GUINT64_FORMAT ")",
+              enabled ? "Enabling" : "Disabling",
+              meta_crtc_get_id (META_CRTC (crtc_kms)));
+
+  kms_update = meta_kms_ensure_pending_update (kms, kms_device);
+  meta_kms_update_set_vrr (kms_update, crtc_kms->kms_crtc, enabled);
 }
 
 MetaKmsCrtc *
@@ -331,6 +379,42 @@ meta_crtc_kms_supports_format (MetaCrtcKms *crtc_kms,
                                              drm_format);
 }
 
+/**
+ * meta_crtc_kms_supports_overlay_format:
+ * @crtc_kms: a #MetaCrtcKms
+ * @drm_format: a DRM pixel format
+ * @drm_modifier: a DRM format modifier, or DRM_FORMAT_MOD_INVALID
+ *
+ * Returns true if any overlay plane usable with the CRTC supports the
+ * format and modifier.
+ */
+gboolean
+meta_crtc_kms_supports_overlay_format (MetaCrtcKms *crtc_kms,
+                                       uint32_t     drm_format,
+                                       uint64_t     drm_modifier)
+{
+  MetaKmsDevice *kms_device = meta_kms_crtc_get_device (crtc_kms->kms_crtc);
+  GList *l;
+
+  for (l = meta_kms_device_get_planes (kms_device); l; l = l->next)
+    {
+      MetaKmsPlane *plane = l->data;
+
+      if (meta_kms_plane_get_plane_type (plane) != META_KMS_PLANE_TYPE_OVERLAY)
+        continue;
+
+      if (!meta_kms_plane_is_usable_with (plane, crtc_kms->kms_crtc))
+        continue;
+
+      if (meta_kms_plane_is_modifier_supported (plane,
+                                                drm_format,
+                                                drm_modifier))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 void
 meta_crtc_kms_invalidate_gamma (MetaCrtcKms *crtc_kms)
 {
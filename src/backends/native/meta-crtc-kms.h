@@ -56,6 +56,11 @@ MetaKmsPlaneAssignment * meta_crtc_kms_assign_primary_plane (MetaCrtcKms   *crtc
 void meta_crtc_kms_set_mode (MetaCrtcKms   *crtc_kms,
                              MetaKmsUpdate *kms_update);
 
+gboolean meta_crtc_kms_supports_vrr (MetaCrtcKms *crtc_kms);
+
+void meta_crtc_kms_set_vrr_enabled (MetaCrtcKms *crtc_kms,
+                                    gboolean     enabled);
+
 void meta_crtc_kms_set_is_underscanning (MetaCrtcKms *crtc_kms,
                                          gboolean     is_underscanning);
 
@@ -72,6 +77,11 @@ gboolean
 meta_crtc_kms_supports_format (MetaCrtcKms *crtc_kms,
                                uint32_t     drm_format);
 
+gboolean
+meta_crtc_kms_supports_overlay_format (MetaCrtcKms *crtc_kms,
+                                       uint32_t     drm_format,
+                                       uint64_t     drm_modifier);
+
 void meta_crtc_kms_invalidate_gamma (MetaCrtcKms *crtc_kms);
 
 void meta_crtc_kms_maybe_set_gamma (MetaCrtcKms   *crtc_kms,
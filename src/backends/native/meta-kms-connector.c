@@ -294,6 +294,9 @@ state_set_properties (MetaKmsConnectorState *state,
       else if ((prop->flags & DRM_MODE_PROP_RANGE) &&
                strcmp (prop->name, "non-desktop") == 0)
         state->non_desktop = drm_connector->prop_values[i];
+      else if ((prop->flags & DRM_MODE_PROP_RANGE) &&
+               strcmp (prop->name, "vrr_capable") == 0)
+        state->vrr_capable = drm_connector->prop_values[i];
       else if (prop->prop_id == meta_kms_connector_get_prop_id (connector,
                 META_KMS_CONNECTOR_PROP_PRIVACY_SCREEN_HW_STATE))
         set_privacy_screen (state, connector, prop,
@@ -610,6 +613,9 @@ meta_kms_connector_state_changes (MetaKmsConnectorState *state,
   if (state->non_desktop != new_state->non_desktop)
     return META_KMS_UPDATE_CHANGE_FULL;
 
+  if (state->vrr_capable != new_state->vrr_capable)
+    return META_KMS_UPDATE_CHANGE_FULL;
+
   if (state->subpixel_order != new_state->subpixel_order)
     return META_KMS_UPDATE_CHANGE_FULL;
 
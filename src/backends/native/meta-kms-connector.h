@@ -50,6 +50,7 @@ typedef struct _MetaKmsConnectorState
 
   gboolean has_scaling;
   gboolean non_desktop;
+  gboolean vrr_capable;
   MetaPrivacyScreenState privacy_screen_state;
 
   CoglSubpixelOrder subpixel_order;
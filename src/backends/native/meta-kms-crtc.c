@@ -99,6 +99,12 @@ meta_kms_crtc_has_gamma (MetaKmsCrtc *crtc)
   return crtc->current_state.gamma.size > 0;
 }
 
+gboolean
+meta_kms_crtc_supports_vrr (MetaKmsCrtc *crtc)
+{
+  return crtc->prop_table.props[META_KMS_CRTC_PROP_VRR_ENABLED].prop_id != 0;
+}
+
 static void
 read_gamma_state (MetaKmsCrtc       *crtc,
                   MetaKmsCrtcState  *crtc_state,
@@ -193,6 +199,8 @@ meta_kms_crtc_read_state (MetaKmsCrtc             *crtc,
   MetaKmsUpdateChanges changes = META_KMS_UPDATE_CHANGE_NONE;
   MetaKmsProp *active_prop;
   int active_idx;
+  MetaKmsProp *vrr_enabled_prop;
+  int vrr_enabled_idx;
 
   crtc_state.rect = (MetaRectangle) {
     .x = drm_crtc->x,
@@ -217,6 +225,19 @@ meta_kms_crtc_read_state (MetaKmsCrtc             *crtc,
       crtc_state.is_active = drm_crtc->mode_valid;
     }
 
+  vrr_enabled_prop = &crtc->prop_table.props[META_KMS_CRTC_PROP_VRR_ENABLED];
+  if (vrr_enabled_prop->prop_id)
+    {
+      vrr_enabled_idx = find_prop_idx (vrr_enabled_prop,
+                                       drm_props->props,
+                                       drm_props->count_props);
+      if (vrr_enabled_idx >= 0)
+        {
+          crtc_state.vrr_enabled =
+            !!drm_props->prop_values[vrr_enabled_idx];
+        }
+    }
+
   read_gamma_state (crtc, &crtc_state, impl_device, drm_crtc);
 
   if (!crtc_state.is_active)
@@ -233,11 +254,12 @@ meta_kms_crtc_read_state (MetaKmsCrtc             *crtc,
   crtc->current_state = crtc_state;
 
   meta_topic (META_DEBUG_KMS,
-              "Read CRTC %u state: active: %d, mode: %s, changed: %s",
+              "Read CRTC %u state: active: %d, mode: %s, vrr: %d, changed: %s",
               crtc->id, crtc->current_state.is_active,
               crtc->current_state.is_drm_mode_valid
                 ? crtc->current_state.drm_mode.name
                 : "(nil)",
+              crtc->current_state.vrr_enabled,
               changes == META_KMS_UPDATE_CHANGE_NONE
                 ? "no"
                 : "yes");
@@ -293,6 +315,7 @@ meta_kms_crtc_predict_state (MetaKmsCrtc   *crtc,
 {
   GList *mode_sets;
   GList *crtc_gammas;
+  GList *crtc_updates;
   GList *l;
 
   mode_sets = meta_kms_update_get_mode_sets (update);
@@ -348,6 +371,32 @@ meta_kms_crtc_predict_state (MetaKmsCrtc   *crtc,
 
       break;
     }
+
+  crtc_updates = meta_kms_update_get_crtc_updates (update);
+  for (l = crtc_updates; l; l = l->next)
+    {
+      MetaKmsCrtcUpdate *crtc_update = l->data;
+
+      if (crtc_update->crtc != crtc)
+        continue;
+
+      if (crtc_update->vrr.has_update)
+        crtc->current_state.vrr_enabled = crtc_update->vrr.is_enabled;
+
+      break;
+    }
+}
+
+static void
+parse_vrr_enabled (MetaKmsImplDevice  *impl_device,
+                   MetaKmsProp        *prop,
+                   drmModePropertyPtr  drm_prop,
+                   uint64_t            drm_prop_value,
+                   gpointer            user_data)
+{
+  MetaKmsCrtc *crtc = user_data;
+
+  crtc->current_state.vrr_enabled = !!drm_prop_value;
 }
 
 static void
@@ -390,6 +439,12 @@ init_properties (MetaKmsCrtc       *crtc,
           .name = "GAMMA_LUT",
           .type = DRM_MODE_PROP_BLOB,
         },
+      [META_KMS_CRTC_PROP_VRR_ENABLED] =
+        {
+          .name = "VRR_ENABLED",
+          .type = DRM_MODE_PROP_RANGE,
+          .parse = parse_vrr_enabled,
+        },
     }
   };
 
@@ -43,6 +43,8 @@ typedef struct _MetaKmsCrtcState
 
     int size;
   } gamma;
+
+  gboolean vrr_enabled;
 } MetaKmsCrtcState;
 
 typedef struct _MetaKmsCrtcGamma
@@ -73,6 +75,8 @@ int meta_kms_crtc_get_idx (MetaKmsCrtc *crtc);
 
 gboolean meta_kms_crtc_has_gamma (MetaKmsCrtc *crtc);
 
+gboolean meta_kms_crtc_supports_vrr (MetaKmsCrtc *crtc);
+
 META_EXPORT_TEST
 gboolean meta_kms_crtc_is_active (MetaKmsCrtc *crtc);
 
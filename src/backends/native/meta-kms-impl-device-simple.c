@@ -521,6 +521,57 @@ process_crtc_gamma (MetaKmsImplDevice  *impl_device,
   return TRUE;
 }
 
+static gboolean
+process_crtc_update (MetaKmsImplDevice  *impl_device,
+                     MetaKmsUpdate      *update,
+                     gpointer            update_entry,
+                     GError            **error)
+{
+  MetaKmsCrtcUpdate *crtc_update = update_entry;
+  MetaKmsCrtc *crtc = crtc_update->crtc;
+
+  if (crtc_update->vrr.has_update)
+    {
+      uint32_t prop_id;
+      int fd;
+      int ret;
+
+      prop_id = meta_kms_crtc_get_prop_id (crtc,
+                                           META_KMS_CRTC_PROP_VRR_ENABLED);
+      if (!prop_id)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "VRR_ENABLED property not found on CRTC %u",
+                       meta_kms_crtc_get_id (crtc));
+          return FALSE;
+        }
+
+      meta_topic (META_DEBUG_KMS,
+                  "[simple] Setting VRR to %d on CRTC %u (%s)",
+                  crtc_update->vrr.is_enabled,
+                  meta_kms_crtc_get_id (crtc),
+                  meta_kms_impl_device_get_path (impl_device));
+
+      fd = meta_kms_impl_device_get_fd (impl_device);
+      ret = drmModeObjectSetProperty (fd,
+                                      meta_kms_crtc_get_id (crtc),
+                                      DRM_MODE_OBJECT_CRTC,
+                                      prop_id,
+                                      crtc_update->vrr.is_enabled);
+      if (ret != 0)
+        {
+          g_set_error (error, G_IO_ERROR, g_io_error_from_errno (-ret),
+                       "Failed to set CRTC %u property %u: %s",
+                       meta_kms_crtc_get_id (crtc),
+                       prop_id,
+                       g_strerror (-ret));
+          return FALSE;
+        }
+    }
+
+  return TRUE;
+}
+
 static gboolean
 is_timestamp_earlier_than (uint64_t ts1,
                            uint64_t ts2)
@@ -1499,6 +1550,13 @@ meta_kms_impl_device_simple_process_update (MetaKmsImplDevice *impl_device,
                         &error))
     goto err;
 
+  if (!process_entries (impl_device,
+                        update,
+                        meta_kms_update_get_crtc_updates (update),
+                        process_crtc_update,
+                        &error))
+    goto err;
+
   if (!process_plane_assignments (impl_device, update, &failed_planes, &error))
     goto err;
 
@@ -181,6 +181,43 @@ meta_kms_plane_is_format_supported (MetaKmsPlane *plane,
                                        NULL, NULL);
 }
 
+/**
+ * meta_kms_plane_is_modifier_supported:
+ * @plane: a #MetaKmsPlane
+ * @drm_format: a DRM pixel format
+ * @drm_modifier: a DRM format modifier, or DRM_FORMAT_MOD_INVALID
+ *
+ * Returns true if the plane supports @drm_format with @drm_modifier. An
+ * invalid modifier stands for an implicit one, only requiring the format to
+ * be supported, as does a plane not advertising modifiers for the format.
+ */
+gboolean
+meta_kms_plane_is_modifier_supported (MetaKmsPlane *plane,
+                                      uint32_t      drm_format,
+                                      uint64_t      drm_modifier)
+{
+  GArray *modifiers;
+  unsigned int i;
+
+  if (!meta_kms_plane_is_format_supported (plane, drm_format))
+    return FALSE;
+
+  if (drm_modifier == DRM_FORMAT_MOD_INVALID)
+    return TRUE;
+
+  modifiers = meta_kms_plane_get_modifiers_for_format (plane, drm_format);
+  if (!modifiers)
+    return TRUE;
+
+  for (i = 0; i < modifiers->len; i++)
+    {
+      if (g_array_index (modifiers, uint64_t, i) == drm_modifier)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
 gboolean
 meta_kms_plane_is_usable_with (MetaKmsPlane *plane,
                                MetaKmsCrtc  *crtc)
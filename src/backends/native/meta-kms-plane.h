@@ -57,6 +57,10 @@ GArray * meta_kms_plane_copy_drm_format_list (MetaKmsPlane *plane);
 gboolean meta_kms_plane_is_format_supported (MetaKmsPlane *plane,
                                              uint32_t      format);
 
+gboolean meta_kms_plane_is_modifier_supported (MetaKmsPlane *plane,
+                                               uint32_t      drm_format,
+                                               uint64_t      drm_modifier);
+
 META_EXPORT_TEST
 gboolean meta_kms_plane_is_usable_with (MetaKmsPlane *plane,
                                         MetaKmsCrtc  *crtc);
@@ -43,6 +43,11 @@ gpointer meta_kms_run_impl_task_sync (MetaKms              *kms,
                                       gpointer              user_data,
                                       GError              **error);
 
+void meta_kms_run_impl_task_async (MetaKms             *kms,
+                                   MetaKmsImplTaskFunc  func,
+                                   gpointer             user_data,
+                                   GDestroyNotify       user_data_destroy);
+
 GSource * meta_kms_add_source_in_impl (MetaKms        *kms,
                                        GSourceFunc     func,
                                        gpointer        user_data,
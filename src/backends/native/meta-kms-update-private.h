@@ -84,6 +84,16 @@ typedef struct _MetaKmsConnectorUpdate
   } privacy_screen;
 } MetaKmsConnectorUpdate;
 
+typedef struct _MetaKmsCrtcUpdate
+{
+  MetaKmsCrtc *crtc;
+
+  struct {
+    gboolean has_update;
+    gboolean is_enabled;
+  } vrr;
+} MetaKmsCrtcUpdate;
+
 typedef struct _MetaKmsPageFlipListener
 {
   MetaKmsCrtc *crtc;
@@ -154,17 +164,25 @@ GList * meta_kms_update_get_page_flip_listeners (MetaKmsUpdate *update);
 
 void meta_kms_update_drop_defunct_page_flip_listeners (MetaKmsUpdate *update);
 
+void meta_kms_update_discard_unhandled_page_flip_listeners (MetaKmsUpdate *update,
+                                                            const GError  *error);
+
 META_EXPORT_TEST
 GList * meta_kms_update_get_connector_updates (MetaKmsUpdate *update);
 
 META_EXPORT_TEST
 GList * meta_kms_update_get_crtc_gammas (MetaKmsUpdate *update);
 
+META_EXPORT_TEST
+GList * meta_kms_update_get_crtc_updates (MetaKmsUpdate *update);
+
 MetaKmsCustomPageFlip * meta_kms_update_take_custom_page_flip_func (MetaKmsUpdate *update);
 
 void meta_kms_update_drop_plane_assignment (MetaKmsUpdate *update,
                                             MetaKmsPlane  *plane);
 
+gboolean meta_kms_update_needs_sync_processing (MetaKmsUpdate *update);
+
 GList * meta_kms_update_take_result_listeners (MetaKmsUpdate *update);
 
 void meta_kms_result_listener_notify (MetaKmsResultListener *listener,
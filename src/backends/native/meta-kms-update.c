@@ -39,6 +39,7 @@ struct _MetaKmsUpdate
   GList *plane_assignments;
   GList *connector_updates;
   GList *crtc_gammas;
+  GList *crtc_updates;
 
   MetaKmsCustomPageFlip *custom_page_flip;
 
@@ -404,6 +405,44 @@ meta_kms_update_set_crtc_gamma (MetaKmsUpdate  *update,
   update->crtc_gammas = g_list_prepend (update->crtc_gammas, gamma);
 }
 
+static MetaKmsCrtcUpdate *
+ensure_crtc_update (MetaKmsUpdate *update,
+                    MetaKmsCrtc   *crtc)
+{
+  GList *l;
+  MetaKmsCrtcUpdate *crtc_update;
+
+  for (l = update->crtc_updates; l; l = l->next)
+    {
+      crtc_update = l->data;
+
+      if (crtc_update->crtc == crtc)
+        return crtc_update;
+    }
+
+  crtc_update = g_new0 (MetaKmsCrtcUpdate, 1);
+  crtc_update->crtc = crtc;
+
+  update->crtc_updates = g_list_prepend (update->crtc_updates, crtc_update);
+
+  return crtc_update;
+}
+
+void
+meta_kms_update_set_vrr (MetaKmsUpdate *update,
+                         MetaKmsCrtc   *crtc,
+                         gboolean       enabled)
+{
+  MetaKmsCrtcUpdate *crtc_update;
+
+  g_assert (!meta_kms_update_is_locked (update));
+  g_assert (meta_kms_crtc_get_device (crtc) == update->device);
+
+  crtc_update = ensure_crtc_update (update, crtc);
+  crtc_update->vrr.has_update = TRUE;
+  crtc_update->vrr.is_enabled = enabled;
+}
+
 void
 meta_kms_update_add_page_flip_listener (MetaKmsUpdate                       *update,
                                         MetaKmsCrtc                         *crtc,
@@ -452,6 +491,32 @@ meta_kms_update_drop_defunct_page_flip_listeners (MetaKmsUpdate *update)
     }
 }
 
+/*
+ * Listeners that were handed over to page flip data while processing the
+ * update have had their user data stolen, and are notified from there. Any
+ * remaining ones were never reached because the update failed early, so
+ * discard them here to not leave their owners waiting for a flip.
+ */
+void
+meta_kms_update_discard_unhandled_page_flip_listeners (MetaKmsUpdate *update,
+                                                       const GError  *error)
+{
+  GList *l;
+
+  for (l = update->page_flip_listeners; l; l = l->next)
+    {
+      MetaKmsPageFlipListener *listener = l->data;
+
+      if (!listener->user_data)
+        continue;
+
+      listener->vtable->discarded (listener->crtc,
+                                   listener->user_data,
+                                   error);
+      g_clear_pointer (&listener->user_data, listener->destroy_notify);
+    }
+}
+
 void
 meta_kms_update_set_custom_page_flip (MetaKmsUpdate             *update,
                                       MetaKmsCustomPageFlipFunc  func,
@@ -554,6 +619,21 @@ meta_kms_update_remove_result_listeners (MetaKmsUpdate             *update,
     }
 }
 
+/*
+ * Updates changing state that is mirrored in the main context, or that
+ * call back into the main context while being processed, must be processed
+ * while the main context is waiting for the impl context.
+ */
+gboolean
+meta_kms_update_needs_sync_processing (MetaKmsUpdate *update)
+{
+  return (update->mode_sets ||
+          update->connector_updates ||
+          update->crtc_gammas ||
+          update->crtc_updates ||
+          update->custom_page_flip);
+}
+
 GList *
 meta_kms_update_take_result_listeners (MetaKmsUpdate *update)
 {
@@ -641,6 +721,12 @@ meta_kms_update_get_crtc_gammas (MetaKmsUpdate *update)
   return update->crtc_gammas;
 }
 
+GList *
+meta_kms_update_get_crtc_updates (MetaKmsUpdate *update)
+{
+  return update->crtc_updates;
+}
+
 void
 meta_kms_update_lock (MetaKmsUpdate *update)
 {
@@ -709,6 +795,7 @@ meta_kms_update_free (MetaKmsUpdate *update)
                     (GDestroyNotify) meta_kms_page_flip_listener_free);
   g_list_free_full (update->connector_updates, g_free);
   g_list_free_full (update->crtc_gammas, (GDestroyNotify) meta_kms_crtc_gamma_free);
+  g_list_free_full (update->crtc_updates, g_free);
   g_clear_pointer (&update->custom_page_flip, meta_kms_custom_page_flip_free);
 
   g_free (update);
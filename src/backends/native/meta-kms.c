@@ -22,9 +22,15 @@
 
 #include "backends/native/meta-kms-private.h"
 
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include "backends/native/meta-backend-native.h"
 #include "backends/native/meta-kms-device-private.h"
 #include "backends/native/meta-kms-impl.h"
+#include "backends/native/meta-kms-impl-device.h"
 #include "backends/native/meta-kms-update-private.h"
 #include "backends/native/meta-udev.h"
 #include "cogl/cogl.h"
@@ -45,9 +51,19 @@
  * runs in. It uses the main GLib main loop and main context and always runs in
  * the main thread.
  *
- * The impl context is where all underlying API is being executed. While in the
- * current state, it always runs in the main thread, the aim is to be able to
- * execute the impl context in a dedicated thread.
+ * The impl context is where all underlying API is being executed. By default
+ * it runs in a dedicated thread, "KMS thread", with its own main context, and
+ * if possible with real-time scheduling, so that page flips and cursor updates
+ * are not delayed by stalls in the main thread. Setting the environment
+ * variable MUTTER_DEBUG_KMS_THREAD_TYPE to "main" makes the impl context run
+ * in the main thread, and setting it to "user" disables the request for
+ * real-time scheduling.
+ *
+ * Tasks are passed to the impl context via a FIFO queue, either synchronously
+ * (meta_kms_run_impl_task_sync()), where the main thread blocks until the task
+ * has been processed, or asynchronously (meta_kms_run_impl_task_async()).
+ * Results are passed back to the main context using
+ * meta_kms_queue_callback().
  *
  * The public facing MetaKms API is always assumed to be executed from the main
  * context.
@@ -130,6 +146,13 @@ enum
   N_SIGNALS
 };
 
+typedef enum _MetaKmsThreadType
+{
+  META_KMS_THREAD_TYPE_MAIN,
+  META_KMS_THREAD_TYPE_USER,
+  META_KMS_THREAD_TYPE_REALTIME,
+} MetaKmsThreadType;
+
 static int signals[N_SIGNALS];
 
 typedef struct _MetaKmsCallbackData
@@ -156,6 +179,18 @@ typedef struct _MetaKmsFdImplSource
   gpointer user_data;
 } MetaKmsFdImplSource;
 
+typedef struct _MetaKmsImplTask
+{
+  MetaKmsImplTaskFunc func;
+  gpointer user_data;
+  GDestroyNotify user_data_destroy;
+
+  gboolean is_sync;
+  gboolean is_done;
+  gpointer retval;
+  GError **error;
+} MetaKmsImplTask;
+
 struct _MetaKms
 {
   GObject parent;
@@ -171,10 +206,22 @@ struct _MetaKms
   gboolean in_impl_task;
   gboolean waiting_for_impl_task;
 
+  MetaKmsThreadType thread_type;
+  GThread *impl_thread;
+  GMainContext *impl_context;
+  GMainLoop *impl_loop;
+  GSource *impl_task_source;
+
+  GMutex impl_task_mutex;
+  GCond impl_task_cond;
+  GQueue impl_tasks;
+  gboolean impl_thread_initialized;
+
   GList *devices;
 
   GList *pending_updates;
 
+  GMutex callback_mutex;
   GList *pending_callbacks;
   guint callback_source_id;
 };
@@ -305,6 +352,123 @@ meta_kms_post_pending_update_sync (MetaKms           *kms,
   return feedback;
 }
 
+typedef struct _PostUpdateData
+{
+  MetaKmsUpdate *update;
+  MetaKmsUpdateFlag flags;
+  MetaKmsFeedback *feedback;
+} PostUpdateData;
+
+static void
+post_update_data_free (PostUpdateData *data)
+{
+  meta_kms_update_free (data->update);
+  g_clear_pointer (&data->feedback, meta_kms_feedback_free);
+  g_free (data);
+}
+
+static void
+notify_update_result (MetaKms  *kms,
+                      gpointer  user_data)
+{
+  PostUpdateData *data = user_data;
+  GList *result_listeners;
+  GList *l;
+
+  if (meta_kms_feedback_get_result (data->feedback) == META_KMS_FEEDBACK_FAILED)
+    {
+      const GError *error = meta_kms_feedback_get_error (data->feedback);
+
+      meta_kms_update_discard_unhandled_page_flip_listeners (data->update,
+                                                             error);
+    }
+
+  result_listeners = meta_kms_update_take_result_listeners (data->update);
+
+  for (l = result_listeners; l; l = l->next)
+    {
+      MetaKmsResultListener *listener = l->data;
+
+      meta_kms_result_listener_notify (listener, data->feedback);
+      meta_kms_result_listener_free (listener);
+    }
+  g_list_free (result_listeners);
+}
+
+static gpointer
+process_update_in_impl (MetaKmsImpl  *impl,
+                        gpointer      user_data,
+                        GError      **error)
+{
+  PostUpdateData *data = user_data;
+  MetaKms *kms = meta_kms_impl_get_kms (impl);
+  MetaKmsDevice *device = meta_kms_update_get_device (data->update);
+  MetaKmsImplDevice *impl_device = meta_kms_device_get_impl_device (device);
+
+  COGL_TRACE_BEGIN_SCOPED (MetaKmsProcessUpdate,
+                           "KMS (process update)");
+
+  data->feedback = meta_kms_impl_device_process_update (impl_device,
+                                                        data->update,
+                                                        data->flags);
+
+  meta_kms_queue_callback (kms,
+                           notify_update_result,
+                           data,
+                           (GDestroyNotify) post_update_data_free);
+
+  return GINT_TO_POINTER (TRUE);
+}
+
+/**
+ * meta_kms_post_pending_update:
+ * @kms: a #MetaKms
+ * @device: the #MetaKmsDevice the pending update belongs to
+ * @flags: update flags
+ *
+ * Posts the pending update for @device without waiting for it to be
+ * processed. The feedback is passed to the result listeners of the update
+ * from the main context once the impl context has processed it.
+ *
+ * Updates that change state mirrored in the main context (mode sets,
+ * connector properties, gamma) are still processed synchronously.
+ */
+void
+meta_kms_post_pending_update (MetaKms           *kms,
+                              MetaKmsDevice     *device,
+                              MetaKmsUpdateFlag  flags)
+{
+  MetaKmsUpdate *update;
+  PostUpdateData *data;
+
+  g_return_if_fail (!(flags & META_KMS_UPDATE_FLAG_PRESERVE_ON_ERROR));
+  g_return_if_fail (!(flags & META_KMS_UPDATE_FLAG_TEST_ONLY));
+
+  meta_assert_not_in_kms_impl (kms);
+
+  update = meta_kms_get_pending_update (kms, device);
+  if (!update)
+    return;
+
+  if (meta_kms_update_needs_sync_processing (update))
+    {
+      g_autoptr (MetaKmsFeedback) feedback = NULL;
+
+      feedback = meta_kms_post_pending_update_sync (kms, device, flags);
+      return;
+    }
+
+  update = meta_kms_take_pending_update (kms, device);
+  meta_kms_update_lock (update);
+
+  data = g_new0 (PostUpdateData, 1);
+  *data = (PostUpdateData) {
+    .update = update,
+    .flags = flags,
+  };
+  meta_kms_run_impl_task_async (kms, process_update_in_impl, data, NULL);
+}
+
 MetaKmsFeedback *
 meta_kms_post_test_update_sync (MetaKms       *kms,
                                 MetaKmsUpdate *update)
@@ -369,14 +533,18 @@ meta_kms_callback_data_free (MetaKmsCallbackData *callback_data)
 static int
 flush_callbacks (MetaKms *kms)
 {
+  GList *pending_callbacks;
   GList *l;
   int callback_count = 0;
 
   meta_assert_not_in_kms_impl (kms);
 
+  g_mutex_lock (&kms->callback_mutex);
   g_clear_handle_id (&kms->callback_source_id, g_source_remove);
+  pending_callbacks = g_steal_pointer (&kms->pending_callbacks);
+  g_mutex_unlock (&kms->callback_mutex);
 
-  for (l = kms->pending_callbacks; l; l = l->next)
+  for (l = pending_callbacks; l; l = l->next)
     {
       MetaKmsCallbackData *callback_data = l->data;
 
@@ -385,8 +553,7 @@ flush_callbacks (MetaKms *kms)
       callback_count++;
     }
 
-  g_list_free (kms->pending_callbacks);
-  kms->pending_callbacks = NULL;
+  g_list_free (pending_callbacks);
 
   return callback_count;
 }
@@ -395,10 +562,24 @@ static gboolean
 callback_idle (gpointer user_data)
 {
   MetaKms *kms = user_data;
+  GList *pending_callbacks;
+  GList *l;
 
-  flush_callbacks (kms);
-
+  g_mutex_lock (&kms->callback_mutex);
   kms->callback_source_id = 0;
+  pending_callbacks = g_steal_pointer (&kms->pending_callbacks);
+  g_mutex_unlock (&kms->callback_mutex);
+
+  for (l = pending_callbacks; l; l = l->next)
+    {
+      MetaKmsCallbackData *callback_data = l->data;
+
+      callback_data->callback (kms, callback_data->user_data);
+      meta_kms_callback_data_free (callback_data);
+    }
+
+  g_list_free (pending_callbacks);
+
   return G_SOURCE_REMOVE;
 }
 
@@ -416,10 +597,29 @@ meta_kms_queue_callback (MetaKms         *kms,
     .user_data = user_data,
     .user_data_destroy = user_data_destroy,
   };
+
+  g_mutex_lock (&kms->callback_mutex);
   kms->pending_callbacks = g_list_append (kms->pending_callbacks,
                                           callback_data);
   if (!kms->callback_source_id)
     kms->callback_source_id = g_idle_add (callback_idle, kms);
+  g_mutex_unlock (&kms->callback_mutex);
+}
+
+static void
+impl_task_free (MetaKmsImplTask *task)
+{
+  if (task->user_data_destroy)
+    task->user_data_destroy (task->user_data);
+  g_free (task);
+}
+
+static void
+queue_impl_task (MetaKms         *kms,
+                 MetaKmsImplTask *task)
+{
+  g_queue_push_tail (&kms->impl_tasks, task);
+  g_source_set_ready_time (kms->impl_task_source, 0);
 }
 
 gpointer
@@ -428,17 +628,126 @@ meta_kms_run_impl_task_sync (MetaKms              *kms,
                              gpointer              user_data,
                              GError              **error)
 {
+  MetaKmsImplTask task;
   gpointer ret;
 
-  kms->in_impl_task = TRUE;
+  if (!kms->impl_thread)
+    {
+      kms->in_impl_task = TRUE;
+      kms->waiting_for_impl_task = TRUE;
+      ret = func (kms->impl, user_data, error);
+      kms->waiting_for_impl_task = FALSE;
+      kms->in_impl_task = FALSE;
+
+      return ret;
+    }
+
+  if (meta_kms_in_impl_task (kms))
+    return func (kms->impl, user_data, error);
+
+  task = (MetaKmsImplTask) {
+    .func = func,
+    .user_data = user_data,
+    .is_sync = TRUE,
+    .error = error,
+  };
+
+  g_mutex_lock (&kms->impl_task_mutex);
   kms->waiting_for_impl_task = TRUE;
-  ret = func (kms->impl, user_data, error);
+  queue_impl_task (kms, &task);
+  while (!task.is_done)
+    g_cond_wait (&kms->impl_task_cond, &kms->impl_task_mutex);
   kms->waiting_for_impl_task = FALSE;
-  kms->in_impl_task = FALSE;
+  g_mutex_unlock (&kms->impl_task_mutex);
 
-  return ret;
+  return task.retval;
+}
+
+void
+meta_kms_run_impl_task_async (MetaKms             *kms,
+                              MetaKmsImplTaskFunc  func,
+                              gpointer             user_data,
+                              GDestroyNotify       user_data_destroy)
+{
+  MetaKmsImplTask *task;
+
+  task = g_new0 (MetaKmsImplTask, 1);
+  *task = (MetaKmsImplTask) {
+    .func = func,
+    .user_data = user_data,
+    .user_data_destroy = user_data_destroy,
+  };
+
+  if (!kms->impl_thread)
+    {
+      g_autoptr (GError) error = NULL;
+
+      kms->in_impl_task = TRUE;
+      if (!func (kms->impl, user_data, &error))
+        g_warning ("KMS impl task failed: %s", error->message);
+      kms->in_impl_task = FALSE;
+
+      impl_task_free (task);
+      return;
+    }
+
+  g_mutex_lock (&kms->impl_task_mutex);
+  queue_impl_task (kms, task);
+  g_mutex_unlock (&kms->impl_task_mutex);
 }
 
+static gboolean
+impl_task_source_dispatch (GSource     *source,
+                           GSourceFunc  callback,
+                           gpointer     user_data)
+{
+  MetaKmsSimpleImplSource *simple_impl_source =
+    (MetaKmsSimpleImplSource *) source;
+  MetaKms *kms = simple_impl_source->kms;
+
+  g_source_set_ready_time (source, -1);
+
+  while (TRUE)
+    {
+      MetaKmsImplTask *task;
+
+      g_mutex_lock (&kms->impl_task_mutex);
+      task = g_queue_pop_head (&kms->impl_tasks);
+      g_mutex_unlock (&kms->impl_task_mutex);
+
+      if (!task)
+        break;
+
+      if (task->is_sync)
+        {
+          gpointer retval;
+
+          retval = task->func (kms->impl, task->user_data, task->error);
+
+          g_mutex_lock (&kms->impl_task_mutex);
+          task->retval = retval;
+          task->is_done = TRUE;
+          g_cond_broadcast (&kms->impl_task_cond);
+          g_mutex_unlock (&kms->impl_task_mutex);
+        }
+      else
+        {
+          g_autoptr (GError) error = NULL;
+
+          if (!task->func (kms->impl, task->user_data, &error))
+            g_warning ("KMS impl task failed: %s", error->message);
+
+          impl_task_free (task);
+        }
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs impl_task_source_funcs = {
+  .dispatch = impl_task_source_dispatch,
+};
+
 static gboolean
 simple_impl_source_dispatch (GSource     *source,
                              GSourceFunc  callback,
@@ -551,7 +860,10 @@ meta_kms_register_fd_in_impl (MetaKms             *kms,
 gboolean
 meta_kms_in_impl_task (MetaKms *kms)
 {
-  return kms->in_impl_task;
+  if (kms->impl_thread)
+    return g_thread_self () == kms->impl_thread;
+  else
+    return kms->in_impl_task;
 }
 
 gboolean
@@ -708,6 +1020,205 @@ meta_kms_create_device (MetaKms            *kms,
   return device;
 }
 
+static void
+request_realtime_scheduling (void)
+{
+  g_autoptr (GDBusConnection) connection = NULL;
+  g_autoptr (GVariant) max_priority_ret = NULL;
+  g_autoptr (GVariant) max_rttime_ret = NULL;
+  g_autoptr (GVariant) max_priority_variant = NULL;
+  g_autoptr (GVariant) max_rttime_variant = NULL;
+  g_autoptr (GVariant) ret = NULL;
+  g_autoptr (GError) error = NULL;
+  int32_t max_priority;
+  int64_t max_rttime_usec;
+  struct rlimit rlimit;
+  uint64_t thread_id;
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+  if (!connection)
+    {
+      g_warning ("Failed to connect to system bus for real-time "
+                 "scheduling: %s", error->message);
+      return;
+    }
+
+  max_priority_ret =
+    g_dbus_connection_call_sync (connection,
+                                 "org.freedesktop.RealtimeKit1",
+                                 "/org/freedesktop/RealtimeKit1",
+                                 "org.freedesktop.DBus.Properties",
+                                 "Get",
+                                 g_variant_new ("(ss)",
+                                                "org.freedesktop.RealtimeKit1",
+                                                "MaxRealtimePriority"),
+                                 G_VARIANT_TYPE ("(v)"),
+                                 G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                 -1, NULL, &error);
+  if (!max_priority_ret)
+    goto err;
+
+  max_rttime_ret =
+    g_dbus_connection_call_sync (connection,
+                                 "org.freedesktop.RealtimeKit1",
+                                 "/org/freedesktop/RealtimeKit1",
+                                 "org.freedesktop.DBus.Properties",
+                                 "Get",
+                                 g_variant_new ("(ss)",
+                                                "org.freedesktop.RealtimeKit1",
+                                                "RTTimeUSecMax"),
+                                 G_VARIANT_TYPE ("(v)"),
+                                 G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                 -1, NULL, &error);
+  if (!max_rttime_ret)
+    goto err;
+
+  g_variant_get (max_priority_ret, "(v)", &max_priority_variant);
+  g_variant_get (max_rttime_ret, "(v)", &max_rttime_variant);
+  max_priority = g_variant_get_int32 (max_priority_variant);
+  max_rttime_usec = g_variant_get_int64 (max_rttime_variant);
+
+  /* RealtimeKit refuses to make threads real-time unless RLIMIT_RTTIME is
+   * limited to what it allows. */
+  rlimit.rlim_cur = max_rttime_usec;
+  rlimit.rlim_max = max_rttime_usec;
+  if (setrlimit (RLIMIT_RTTIME, &rlimit) != 0)
+    {
+      g_warning ("Failed to set RLIMIT_RTTIME: %s", g_strerror (errno));
+      return;
+    }
+
+  thread_id = (uint64_t) syscall (SYS_gettid);
+  ret = g_dbus_connection_call_sync (connection,
+                                     "org.freedesktop.RealtimeKit1",
+                                     "/org/freedesktop/RealtimeKit1",
+                                     "org.freedesktop.RealtimeKit1",
+                                     "MakeThreadRealtime",
+                                     g_variant_new ("(tu)",
+                                                    thread_id,
+                                                    MIN (max_priority, 20)),
+                                     NULL,
+                                     G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                     -1, NULL, &error);
+  if (!ret)
+    goto err;
+
+  meta_topic (META_DEBUG_KMS, "Made KMS thread real-time with priority %d",
+              MIN (max_priority, 20));
+  return;
+
+err:
+  g_message ("Failed to make KMS thread real-time: %s", error->message);
+}
+
+static gpointer
+impl_thread_func (gpointer user_data)
+{
+  MetaKms *kms = user_data;
+
+  g_main_context_push_thread_default (kms->impl_context);
+
+  if (kms->thread_type == META_KMS_THREAD_TYPE_REALTIME)
+    request_realtime_scheduling ();
+
+  kms->impl_loop = g_main_loop_new (kms->impl_context, FALSE);
+
+  g_mutex_lock (&kms->impl_task_mutex);
+  kms->impl_thread_initialized = TRUE;
+  g_cond_broadcast (&kms->impl_task_cond);
+  g_mutex_unlock (&kms->impl_task_mutex);
+
+  g_main_loop_run (kms->impl_loop);
+  g_main_loop_unref (kms->impl_loop);
+
+  g_main_context_pop_thread_default (kms->impl_context);
+
+  return NULL;
+}
+
+static gboolean
+start_impl_thread (MetaKms  *kms,
+                   GError  **error)
+{
+  MetaKmsSimpleImplSource *simple_impl_source;
+
+  kms->impl_context = g_main_context_new ();
+
+  kms->impl_task_source = g_source_new (&impl_task_source_funcs,
+                                        sizeof (MetaKmsSimpleImplSource));
+  g_source_set_name (kms->impl_task_source, "[mutter] KMS impl tasks");
+  g_source_set_priority (kms->impl_task_source, G_PRIORITY_HIGH);
+  simple_impl_source = (MetaKmsSimpleImplSource *) kms->impl_task_source;
+  simple_impl_source->kms = kms;
+  g_source_attach (kms->impl_task_source, kms->impl_context);
+
+  kms->impl_thread = g_thread_try_new ("KMS thread",
+                                       impl_thread_func,
+                                       kms,
+                                       error);
+  if (!kms->impl_thread)
+    {
+      g_source_destroy (kms->impl_task_source);
+      g_clear_pointer (&kms->impl_task_source, g_source_unref);
+      g_clear_pointer (&kms->impl_context, g_main_context_unref);
+      return FALSE;
+    }
+
+  g_mutex_lock (&kms->impl_task_mutex);
+  while (!kms->impl_thread_initialized)
+    g_cond_wait (&kms->impl_task_cond, &kms->impl_task_mutex);
+  g_mutex_unlock (&kms->impl_task_mutex);
+
+  return TRUE;
+}
+
+static gpointer
+quit_impl_thread_in_impl (MetaKmsImpl  *impl,
+                          gpointer      user_data,
+                          GError      **error)
+{
+  MetaKms *kms = meta_kms_impl_get_kms (impl);
+
+  g_main_loop_quit (kms->impl_loop);
+
+  return GINT_TO_POINTER (TRUE);
+}
+
+static void
+stop_impl_thread (MetaKms *kms)
+{
+  if (!kms->impl_thread)
+    return;
+
+  meta_kms_run_impl_task_async (kms, quit_impl_thread_in_impl, NULL, NULL);
+  g_thread_join (kms->impl_thread);
+  kms->impl_thread = NULL;
+
+  g_source_destroy (kms->impl_task_source);
+  g_clear_pointer (&kms->impl_task_source, g_source_unref);
+  g_clear_pointer (&kms->impl_context, g_main_context_unref);
+}
+
+static MetaKmsThreadType
+get_thread_type (void)
+{
+  const char *thread_type_env;
+
+  thread_type_env = g_getenv ("MUTTER_DEBUG_KMS_THREAD_TYPE");
+  if (!thread_type_env)
+    return META_KMS_THREAD_TYPE_REALTIME;
+
+  if (g_strcmp0 (thread_type_env, "main") == 0)
+    return META_KMS_THREAD_TYPE_MAIN;
+  else if (g_strcmp0 (thread_type_env, "user") == 0)
+    return META_KMS_THREAD_TYPE_USER;
+  else if (g_strcmp0 (thread_type_env, "realtime") == 0)
+    return META_KMS_THREAD_TYPE_REALTIME;
+
+  g_warning ("Unknown KMS thread type '%s'", thread_type_env);
+  return META_KMS_THREAD_TYPE_REALTIME;
+}
+
 MetaKms *
 meta_kms_new (MetaBackend   *backend,
               MetaKmsFlags   flags,
@@ -727,6 +1238,14 @@ meta_kms_new (MetaBackend   *backend,
       return NULL;
     }
 
+  kms->thread_type = get_thread_type ();
+  if (kms->thread_type != META_KMS_THREAD_TYPE_MAIN &&
+      !start_impl_thread (kms, error))
+    {
+      g_object_unref (kms);
+      return NULL;
+    }
+
   if (!(flags & META_KMS_FLAG_NO_MODE_SETTING))
     {
       kms->hotplug_handler_id =
@@ -762,25 +1281,35 @@ meta_kms_finalize (GObject *object)
   MetaKms *kms = META_KMS (object);
   MetaBackendNative *backend_native = META_BACKEND_NATIVE (kms->backend);
   MetaUdev *udev = meta_backend_native_get_udev (backend_native);
-  GList *l;
 
-  for (l = kms->pending_callbacks; l; l = l->next)
-    meta_kms_callback_data_free (l->data);
-  g_list_free (kms->pending_callbacks);
-
-  g_clear_handle_id (&kms->callback_source_id, g_source_remove);
+  /* Updates may still be in flight in the impl thread; let it finish them
+   * before the devices they refer to go away. */
+  stop_impl_thread (kms);
 
   g_list_free_full (kms->devices, g_object_unref);
 
+  g_list_free_full (kms->pending_callbacks,
+                    (GDestroyNotify) meta_kms_callback_data_free);
+
+  g_clear_handle_id (&kms->callback_source_id, g_source_remove);
+
   g_clear_signal_handler (&kms->hotplug_handler_id, udev);
   g_clear_signal_handler (&kms->removed_handler_id, udev);
 
+  g_mutex_clear (&kms->impl_task_mutex);
+  g_cond_clear (&kms->impl_task_cond);
+  g_mutex_clear (&kms->callback_mutex);
+
   G_OBJECT_CLASS (meta_kms_parent_class)->finalize (object);
 }
 
 static void
 meta_kms_init (MetaKms *kms)
 {
+  g_mutex_init (&kms->impl_task_mutex);
+  g_cond_init (&kms->impl_task_cond);
+  g_queue_init (&kms->impl_tasks);
+  g_mutex_init (&kms->callback_mutex);
 }
 
 static void
@@ -36,9 +36,11 @@ G_DECLARE_FINAL_TYPE (MetaKms, meta_kms, META, KMS, GObject)
 
 void meta_kms_discard_pending_updates (MetaKms *kms);
 
+META_EXPORT_TEST
 MetaKmsUpdate * meta_kms_ensure_pending_update (MetaKms       *kms,
                                                 MetaKmsDevice *device);
 
+META_EXPORT_TEST
 MetaKmsUpdate * meta_kms_get_pending_update (MetaKms       *kms,
                                              MetaKmsDevice *device);
 
@@ -46,6 +48,11 @@ MetaKmsFeedback * meta_kms_post_pending_update_sync (MetaKms           *kms,
                                                      MetaKmsDevice     *device,
                                                      MetaKmsUpdateFlag  flags);
 
+META_EXPORT_TEST
+void meta_kms_post_pending_update (MetaKms           *kms,
+                                   MetaKmsDevice     *device,
+                                   MetaKmsUpdateFlag  flags);
+
 MetaKmsFeedback * meta_kms_post_test_update_sync (MetaKms       *kms,
                                                   MetaKmsUpdate *update);
 
@@ -61,6 +68,7 @@ GList * meta_kms_get_devices (MetaKms *kms);
 
 void meta_kms_resume (MetaKms *kms);
 
+META_EXPORT_TEST
 MetaKmsDevice * meta_kms_create_device (MetaKms            *kms,
                                         const char         *path,
                                         MetaKmsDeviceFlag   flags,
@@ -68,6 +76,7 @@ MetaKmsDevice * meta_kms_create_device (MetaKms            *kms,
 
 void meta_kms_prepare_shutdown (MetaKms *kms);
 
+META_EXPORT_TEST
 MetaKms * meta_kms_new (MetaBackend   *backend,
                         MetaKmsFlags   flags,
                         GError       **error);
@@ -30,8 +30,10 @@
 #include "backends/native/meta-onscreen-native.h"
 
 #include <drm_fourcc.h>
+#include <string.h>
 
 #include "backends/meta-egl-ext.h"
+#include "backends/native/meta-buffer-damage-tracker.h"
 #include "backends/native/meta-cogl-utils.h"
 #include "backends/native/meta-crtc-kms.h"
 #include "backends/native/meta-device-pool.h"
@@ -40,6 +42,7 @@
 #include "backends/native/meta-drm-buffer-import.h"
 #include "backends/native/meta-drm-buffer.h"
 #include "backends/native/meta-kms-device.h"
+#include "backends/native/meta-kms-plane.h"
 #include "backends/native/meta-kms-utils.h"
 #include "backends/native/meta-kms.h"
 #include "backends/native/meta-output-kms.h"
@@ -48,6 +51,9 @@
 #include "backends/native/meta-renderer-native-gles3.h"
 #include "backends/native/meta-renderer-native-private.h"
 
+/* Limit the number of individual copies to the secondary GPU to 16 */
+#define MAX_RECTS 16
+
 typedef enum _MetaSharedFramebufferImportStatus
 {
   /* Not tried importing yet. */
@@ -74,6 +80,7 @@ typedef struct _MetaOnscreenNativeSecondaryGpuState
   struct {
     MetaDrmBufferDumb *current_dumb_fb;
     MetaDrmBufferDumb *dumb_fbs[2];
+    MetaBufferDamageTracker *damage_tracker;
   } cpu;
 
   gboolean noted_primary_gpu_copy_ok;
@@ -81,6 +88,31 @@ typedef struct _MetaOnscreenNativeSecondaryGpuState
   MetaSharedFramebufferImportStatus import_status;
 } MetaOnscreenNativeSecondaryGpuState;
 
+typedef struct _MetaOnscreenNativeOverlay
+{
+  MetaKmsPlane *plane;
+  MetaDrmBuffer *buffer;
+  MetaRectangle dst_rect;
+} MetaOnscreenNativeOverlay;
+
+typedef struct _MetaOnscreenNativeOverlayConfig
+{
+  MetaKmsPlane *plane;
+  uint32_t format;
+  uint64_t modifier;
+  int width;
+  int height;
+  MetaFixed16Rectangle src_rect;
+  MetaRectangle dst_rect;
+} MetaOnscreenNativeOverlayConfig;
+
+typedef struct _MetaOnscreenNativeOverlayTest
+{
+  MetaOnscreenNativeOverlayConfig primary_config;
+  GArray *configs;
+  gboolean passed;
+} MetaOnscreenNativeOverlayTest;
+
 struct _MetaOnscreenNative
 {
   CoglOnscreenEgl parent;
@@ -98,6 +130,29 @@ struct _MetaOnscreenNative
     MetaDrmBuffer *next_fb;
   } gbm;
 
+  /* Overlay planes assigned for the frame being painted, the frame posted
+   * to KMS, and the frame currently on screen. */
+  struct {
+    GList *pending;
+    GList *next;
+    GList *current;
+
+    /* The outcome of the last test commit that added an overlay to each
+     * plane, keyed by the plane. */
+    GHashTable *tests;
+  } overlays;
+
+  /* How often client buffers were tried for scanout, and how often that
+   * failed because no plane supported the format and modifier. The last
+   * mismatching format and modifier are kept so that each is only logged
+   * once. */
+  struct {
+    uint64_t n_attempts;
+    uint64_t n_format_mismatches;
+    uint32_t last_mismatch_format;
+    uint64_t last_mismatch_modifier;
+  } scanout_stats;
+
 #ifdef HAVE_EGL_DEVICE
   struct {
     EGLStreamKHR stream;
@@ -145,12 +200,40 @@ free_current_secondary_bo (CoglOnscreen *onscreen)
   g_clear_object (&secondary_gpu_state->gbm.current_fb);
 }
 
+static void
+meta_onscreen_native_overlay_free (MetaOnscreenNativeOverlay *overlay)
+{
+  g_clear_object (&overlay->buffer);
+  g_free (overlay);
+}
+
+static void
+clear_overlays (GList **overlays)
+{
+  g_list_free_full (g_steal_pointer (overlays),
+                    (GDestroyNotify) meta_onscreen_native_overlay_free);
+}
+
+static void
+meta_onscreen_native_overlay_test_free (MetaOnscreenNativeOverlayTest *test)
+{
+  g_array_unref (test->configs);
+  g_free (test);
+}
+
+static void
+clear_tested_overlays (MetaOnscreenNative *onscreen_native)
+{
+  g_clear_pointer (&onscreen_native->overlays.tests, g_hash_table_unref);
+}
+
 static void
 free_current_bo (CoglOnscreen *onscreen)
 {
   MetaOnscreenNative *onscreen_native = META_ONSCREEN_NATIVE (onscreen);
 
   g_clear_object (&onscreen_native->gbm.current_fb);
+  clear_overlays (&onscreen_native->overlays.current);
   free_current_secondary_bo (onscreen);
 }
 
@@ -167,6 +250,9 @@ meta_onscreen_native_swap_drm_fb (CoglOnscreen *onscreen)
   g_set_object (&onscreen_native->gbm.current_fb, onscreen_native->gbm.next_fb);
   g_clear_object (&onscreen_native->gbm.next_fb);
 
+  onscreen_native->overlays.current =
+    g_steal_pointer (&onscreen_native->overlays.next);
+
   swap_secondary_drm_fb (onscreen);
 }
 
@@ -341,6 +427,9 @@ page_flip_feedback_discarded (MetaKmsCrtc  *kms_crtc,
                         G_IO_ERROR_PERMISSION_DENIED))
     g_warning ("Page flip discarded: %s", error->message);
 
+  /* Don't trust earlier test commits to still reflect what works */
+  clear_tested_overlays (META_ONSCREEN_NATIVE (onscreen));
+
   frame_info = cogl_onscreen_peek_head_frame_info (onscreen);
   frame_info->flags |= COGL_FRAME_INFO_FLAG_SYMBOLIC;
 
@@ -355,6 +444,22 @@ static const MetaKmsPageFlipListenerVtable page_flip_listener_vtable = {
   .discarded = page_flip_feedback_discarded,
 };
 
+static void
+on_kms_update_result (const MetaKmsFeedback *kms_feedback,
+                      gpointer               user_data)
+{
+  const GError *error;
+
+  if (meta_kms_feedback_get_result (kms_feedback) == META_KMS_FEEDBACK_PASSED)
+    return;
+
+  error = meta_kms_feedback_get_error (kms_feedback);
+  if (!g_error_matches (error,
+                        G_IO_ERROR,
+                        G_IO_ERROR_PERMISSION_DENIED))
+    g_warning ("Failed to post KMS update: %s", error->message);
+}
+
 static MetaEgl *
 meta_onscreen_native_get_egl (MetaOnscreenNative *onscreen_native)
 {
@@ -418,6 +523,71 @@ meta_onscreen_native_dummy_power_save_page_flip (CoglOnscreen *onscreen)
   meta_onscreen_native_notify_frame_complete (onscreen);
 }
 
+static MetaFixed16Rectangle
+get_overlay_src_rect (MetaOnscreenNativeOverlay *overlay)
+{
+  return (MetaFixed16Rectangle) {
+    .x = meta_fixed_16_from_int (0),
+    .y = meta_fixed_16_from_int (0),
+    .width = meta_fixed_16_from_int (overlay->dst_rect.width),
+    .height = meta_fixed_16_from_int (overlay->dst_rect.height),
+  };
+}
+
+static MetaKmsPlaneAssignment *
+assign_overlay_plane (MetaKmsUpdate             *kms_update,
+                      MetaKmsCrtc               *kms_crtc,
+                      MetaOnscreenNativeOverlay *overlay)
+{
+  return meta_kms_update_assign_plane (kms_update,
+                                       kms_crtc,
+                                       overlay->plane,
+                                       overlay->buffer,
+                                       get_overlay_src_rect (overlay),
+                                       overlay->dst_rect,
+                                       META_KMS_ASSIGN_PLANE_FLAG_NONE);
+}
+
+static gboolean
+has_overlay_plane (GList        *overlays,
+                   MetaKmsPlane *plane)
+{
+  GList *l;
+
+  for (l = overlays; l; l = l->next)
+    {
+      MetaOnscreenNativeOverlay *overlay = l->data;
+
+      if (overlay->plane == plane)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+flip_overlays (MetaOnscreenNative *onscreen_native,
+               MetaKmsCrtc        *kms_crtc,
+               MetaKmsUpdate      *kms_update)
+{
+  GList *l;
+
+  clear_overlays (&onscreen_native->overlays.next);
+  onscreen_native->overlays.next =
+    g_steal_pointer (&onscreen_native->overlays.pending);
+
+  for (l = onscreen_native->overlays.next; l; l = l->next)
+    assign_overlay_plane (kms_update, kms_crtc, l->data);
+
+  for (l = onscreen_native->overlays.current; l; l = l->next)
+    {
+      MetaOnscreenNativeOverlay *overlay = l->data;
+
+      if (!has_overlay_plane (onscreen_native->overlays.next, overlay->plane))
+        meta_kms_update_unassign_plane (kms_update, kms_crtc, overlay->plane);
+    }
+}
+
 static void
 meta_onscreen_native_flip_crtc (CoglOnscreen                *onscreen,
                                 MetaRendererView            *view,
@@ -474,6 +644,9 @@ meta_onscreen_native_flip_crtc (CoglOnscreen                *onscreen,
           meta_kms_plane_assignment_set_fb_damage (plane_assignment,
                                                    rectangles, n_rectangles);
         }
+
+      if (gpu_kms == render_gpu)
+        flip_overlays (onscreen_native, kms_crtc, kms_update);
       break;
     case META_RENDERER_NATIVE_MODE_SURFACELESS:
       g_assert_not_reached ();
@@ -542,6 +715,9 @@ secondary_gpu_release_dumb (MetaOnscreenNativeSecondaryGpuState *secondary_gpu_s
 
   for (i = 0; i < G_N_ELEMENTS (secondary_gpu_state->cpu.dumb_fbs); i++)
     g_clear_object (&secondary_gpu_state->cpu.dumb_fbs[i]);
+
+  g_clear_pointer (&secondary_gpu_state->cpu.damage_tracker,
+                   meta_buffer_damage_tracker_free);
 }
 
 static void
@@ -721,16 +897,50 @@ copy_shared_framebuffer_gpu (CoglOnscreen                        *onscreen,
   secondary_gpu_state->gbm.next_fb = META_DRM_BUFFER (buffer_gbm);
 }
 
-static MetaDrmBufferDumb *
-secondary_gpu_get_next_dumb_buffer (MetaOnscreenNativeSecondaryGpuState *secondary_gpu_state)
+static int
+secondary_gpu_get_next_dumb_buffer_index (MetaOnscreenNativeSecondaryGpuState *secondary_gpu_state)
 {
   MetaDrmBufferDumb *current_dumb_fb;
 
   current_dumb_fb = secondary_gpu_state->cpu.current_dumb_fb;
   if (current_dumb_fb == secondary_gpu_state->cpu.dumb_fbs[0])
-    return secondary_gpu_state->cpu.dumb_fbs[1];
+    return 1;
   else
-    return secondary_gpu_state->cpu.dumb_fbs[0];
+    return 0;
+}
+
+static cairo_region_t *
+create_damage_region (MetaDrmBuffer *buffer,
+                      const int     *rectangles,
+                      int            n_rectangles)
+{
+  cairo_region_t *damage_region;
+  cairo_rectangle_int_t buffer_rect;
+  int i;
+
+  if (n_rectangles == 0)
+    return NULL;
+
+  damage_region = cairo_region_create ();
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cairo_rectangle_int_t rect = {
+        .x = rectangles[i * 4],
+        .y = rectangles[i * 4 + 1],
+        .width = rectangles[i * 4 + 2],
+        .height = rectangles[i * 4 + 3],
+      };
+
+      cairo_region_union_rectangle (damage_region, &rect);
+    }
+
+  buffer_rect = (cairo_rectangle_int_t) {
+    .width = meta_drm_buffer_get_width (buffer),
+    .height = meta_drm_buffer_get_height (buffer),
+  };
+  cairo_region_intersect_rectangle (damage_region, &buffer_rect);
+
+  return damage_region;
 }
 
 static gboolean
@@ -746,12 +956,16 @@ copy_shared_framebuffer_primary_gpu (CoglOnscreen                        *onscre
   MetaRendererNativeGpuData *primary_gpu_data;
   MetaDrmBufferDumb *buffer_dumb;
   MetaDrmBuffer *buffer;
+  int dumb_fb_index;
   int width, height, stride;
   uint32_t drm_format;
   CoglFramebuffer *dmabuf_fb;
   int dmabuf_fd;
   g_autoptr (GError) error = NULL;
   CoglPixelFormat cogl_format;
+  cairo_region_t *damage_region;
+  cairo_region_t *update_region;
+  gboolean blit_failed = FALSE;
   int ret;
 
   COGL_TRACE_BEGIN_SCOPED (CopySharedFramebufferPrimaryGpu,
@@ -767,7 +981,8 @@ copy_shared_framebuffer_primary_gpu (CoglOnscreen                        *onscre
   if (!primary_gpu_data->secondary.has_EGL_EXT_image_dma_buf_import_modifiers)
     return FALSE;
 
-  buffer_dumb = secondary_gpu_get_next_dumb_buffer (secondary_gpu_state);
+  dumb_fb_index = secondary_gpu_get_next_dumb_buffer_index (secondary_gpu_state);
+  buffer_dumb = secondary_gpu_state->cpu.dumb_fbs[dumb_fb_index];
   buffer = META_DRM_BUFFER (buffer_dumb);
 
   width = meta_drm_buffer_get_width (buffer);
@@ -808,67 +1023,160 @@ copy_shared_framebuffer_primary_gpu (CoglOnscreen                        *onscre
                   error->message);
       return FALSE;
     }
-  /* Limit the number of individual copies to 16 */
-#define MAX_RECTS 16
 
-  if (n_rectangles == 0 || n_rectangles > MAX_RECTS)
+  damage_region = create_damage_region (buffer, rectangles, n_rectangles);
+  update_region =
+    meta_buffer_damage_tracker_get_update_region (secondary_gpu_state->cpu.damage_tracker,
+                                                  dumb_fb_index,
+                                                  damage_region);
+
+  if (!update_region ||
+      cairo_region_num_rectangles (update_region) > MAX_RECTS)
     {
       if (!cogl_blit_framebuffer (framebuffer, COGL_FRAMEBUFFER (dmabuf_fb),
                                   0, 0, 0, 0,
                                   width, height,
                                   &error))
-        {
-          g_object_unref (dmabuf_fb);
-          return FALSE;
-        }
+        blit_failed = TRUE;
     }
   else
     {
-      int i;
+      int n_rects, i;
 
-      for (i = 0; i < n_rectangles; ++i)
+      n_rects = cairo_region_num_rectangles (update_region);
+      for (i = 0; i < n_rects; i++)
         {
+          cairo_rectangle_int_t rect;
+
+          cairo_region_get_rectangle (update_region, i, &rect);
           if (!cogl_blit_framebuffer (framebuffer, COGL_FRAMEBUFFER (dmabuf_fb),
-                                      rectangles[i * 4], rectangles[i * 4 + 1],
-                                      rectangles[i * 4], rectangles[i * 4 + 1],
-                                      rectangles[i * 4 + 2],
-                                      rectangles[i * 4 + 3],
+                                      rect.x, rect.y,
+                                      rect.x, rect.y,
+                                      rect.width, rect.height,
                                       &error))
             {
-              g_object_unref (dmabuf_fb);
-              return FALSE;
+              blit_failed = TRUE;
+              break;
             }
         }
     }
 
+  g_clear_pointer (&update_region, cairo_region_destroy);
   g_object_unref (dmabuf_fb);
 
+  if (blit_failed)
+    {
+      /* Part of the buffer may have been updated already, so leave it to
+       * the CPU copy fallback to refresh all of it. */
+      meta_buffer_damage_tracker_invalidate (secondary_gpu_state->cpu.damage_tracker,
+                                             dumb_fb_index);
+      g_clear_pointer (&damage_region, cairo_region_destroy);
+      return FALSE;
+    }
+
+  meta_buffer_damage_tracker_buffer_updated (secondary_gpu_state->cpu.damage_tracker,
+                                             dumb_fb_index,
+                                             damage_region);
+  g_clear_pointer (&damage_region, cairo_region_destroy);
+
   g_set_object (&secondary_gpu_state->gbm.next_fb, buffer);
   secondary_gpu_state->cpu.current_dumb_fb = buffer_dumb;
 
   return TRUE;
 }
 
+static gboolean
+read_pixels_into_dumb_buffer (CoglFramebuffer             *framebuffer,
+                              uint8_t                     *buffer_data,
+                              int                          stride,
+                              CoglPixelFormat              cogl_format,
+                              const cairo_rectangle_int_t *rect)
+{
+  CoglContext *cogl_context = cogl_framebuffer_get_context (framebuffer);
+  int bpp = cogl_pixel_format_get_bytes_per_pixel (cogl_format, 0);
+  int row_size = rect->width * bpp;
+  g_autofree uint8_t *pixels = NULL;
+  CoglBitmap *bitmap;
+  gboolean ret;
+  int y;
+
+  /* Full rows can be read in place. Otherwise, the in-place vertical flip
+   * done when reading back would touch the whole rowstride, i.e. pixels
+   * outside of the rectangle, so read into tightly packed memory first.
+   */
+  if (rect->x == 0 && rect->width == cogl_framebuffer_get_width (framebuffer))
+    {
+      bitmap = cogl_bitmap_new_for_data (cogl_context,
+                                         rect->width,
+                                         rect->height,
+                                         cogl_format,
+                                         stride,
+                                         buffer_data + rect->y * stride);
+
+      ret = cogl_framebuffer_read_pixels_into_bitmap (framebuffer,
+                                                      rect->x,
+                                                      rect->y,
+                                                      COGL_READ_PIXELS_COLOR_BUFFER,
+                                                      bitmap);
+      cogl_object_unref (bitmap);
+
+      return ret;
+    }
+
+  pixels = g_malloc (row_size * rect->height);
+  bitmap = cogl_bitmap_new_for_data (cogl_context,
+                                     rect->width,
+                                     rect->height,
+                                     cogl_format,
+                                     row_size,
+                                     pixels);
+
+  ret = cogl_framebuffer_read_pixels_into_bitmap (framebuffer,
+                                                  rect->x,
+                                                  rect->y,
+                                                  COGL_READ_PIXELS_COLOR_BUFFER,
+                                                  bitmap);
+  cogl_object_unref (bitmap);
+
+  if (!ret)
+    return FALSE;
+
+  for (y = 0; y < rect->height; y++)
+    {
+      memcpy (buffer_data + (rect->y + y) * stride + rect->x * bpp,
+              pixels + y * row_size,
+              row_size);
+    }
+
+  return TRUE;
+}
+
 static void
 copy_shared_framebuffer_cpu (CoglOnscreen                        *onscreen,
                              MetaOnscreenNativeSecondaryGpuState *secondary_gpu_state,
-                             MetaRendererNativeGpuData           *renderer_gpu_data)
+                             MetaRendererNativeGpuData           *renderer_gpu_data,
+                             const int                           *rectangles,
+                             int                                  n_rectangles)
 {
   CoglFramebuffer *framebuffer = COGL_FRAMEBUFFER (onscreen);
-  CoglContext *cogl_context = cogl_framebuffer_get_context (framebuffer);
   MetaDrmBufferDumb *buffer_dumb;
   MetaDrmBuffer *buffer;
+  int dumb_fb_index;
   int width, height, stride;
   uint32_t drm_format;
-  void *buffer_data;
-  CoglBitmap *dumb_bitmap;
+  uint8_t *buffer_data;
   CoglPixelFormat cogl_format;
+  cairo_region_t *damage_region;
+  cairo_region_t *update_region;
+  cairo_rectangle_int_t rect;
+  gboolean read_failed = FALSE;
   gboolean ret;
 
   COGL_TRACE_BEGIN_SCOPED (CopySharedFramebufferCpu,
                            "FB Copy (CPU)");
 
-  buffer_dumb = secondary_gpu_get_next_dumb_buffer (secondary_gpu_state);
+  dumb_fb_index = secondary_gpu_get_next_dumb_buffer_index (secondary_gpu_state);
+  buffer_dumb = secondary_gpu_state->cpu.dumb_fbs[dumb_fb_index];
   buffer = META_DRM_BUFFER (buffer_dumb);
 
   width = meta_drm_buffer_get_width (buffer);
@@ -885,21 +1193,83 @@ copy_shared_framebuffer_cpu (CoglOnscreen                        *onscreen,
                                                 NULL);
   g_assert (ret);
 
-  dumb_bitmap = cogl_bitmap_new_for_data (cogl_context,
-                                          width,
-                                          height,
-                                          cogl_format,
-                                          stride,
-                                          buffer_data);
-
-  if (!cogl_framebuffer_read_pixels_into_bitmap (framebuffer,
-                                                 0 /* x */,
-                                                 0 /* y */,
-                                                 COGL_READ_PIXELS_COLOR_BUFFER,
-                                                 dumb_bitmap))
+  damage_region = create_damage_region (buffer, rectangles, n_rectangles);
+  update_region =
+    meta_buffer_damage_tracker_get_update_region (secondary_gpu_state->cpu.damage_tracker,
+                                                  dumb_fb_index,
+                                                  damage_region);
+
+  if (!update_region)
+    {
+      rect = (cairo_rectangle_int_t) {
+        .width = width,
+        .height = height,
+      };
+
+      read_failed = !read_pixels_into_dumb_buffer (framebuffer,
+                                                   buffer_data, stride,
+                                                   cogl_format,
+                                                   &rect);
+    }
+  else if (cairo_region_num_rectangles (update_region) > MAX_RECTS)
+    {
+      cairo_region_get_extents (update_region, &rect);
+      read_failed = !read_pixels_into_dumb_buffer (framebuffer,
+                                                   buffer_data, stride,
+                                                   cogl_format,
+                                                   &rect);
+    }
+  else
+    {
+      int n_rects, i;
+
+      n_rects = cairo_region_num_rectangles (update_region);
+      for (i = 0; i < n_rects; i++)
+        {
+          cairo_region_get_rectangle (update_region, i, &rect);
+          if (!read_pixels_into_dumb_buffer (framebuffer,
+                                             buffer_data, stride,
+                                             cogl_format,
+                                             &rect))
+            {
+              read_failed = TRUE;
+              break;
+            }
+        }
+    }
+
+#ifdef COGL_HAS_TRACING
+  if (G_UNLIKELY (cogl_is_tracing_enabled ()))
+    {
+      g_autofree char *description = NULL;
+
+      if (update_region)
+        {
+          cairo_region_get_extents (update_region, &rect);
+          description = g_strdup_printf ("%d rects, extents %dx%d",
+                                         cairo_region_num_rectangles (update_region),
+                                         rect.width, rect.height);
+        }
+      else
+        {
+          description = g_strdup_printf ("full, %dx%d", width, height);
+        }
+      COGL_TRACE_DESCRIBE (CopySharedFramebufferCpu, description);
+    }
+#endif
+
+  if (read_failed)
     g_warning ("Failed to CPU-copy to a secondary GPU output");
 
-  cogl_object_unref (dumb_bitmap);
+  meta_buffer_damage_tracker_buffer_updated (secondary_gpu_state->cpu.damage_tracker,
+                                             dumb_fb_index,
+                                             damage_region);
+  if (read_failed)
+    meta_buffer_damage_tracker_invalidate (secondary_gpu_state->cpu.damage_tracker,
+                                           dumb_fb_index);
+
+  g_clear_pointer (&update_region, cairo_region_destroy);
+  g_clear_pointer (&damage_region, cairo_region_destroy);
 
   g_set_object (&secondary_gpu_state->gbm.next_fb, buffer);
   secondary_gpu_state->cpu.current_dumb_fb = buffer_dumb;
@@ -952,7 +1322,9 @@ update_secondary_gpu_state_pre_swap_buffers (CoglOnscreen *onscreen,
 
               copy_shared_framebuffer_cpu (onscreen,
                                            secondary_gpu_state,
-                                           renderer_gpu_data);
+                                           renderer_gpu_data,
+                                           rectangles,
+                                           n_rectangles);
             }
           else if (!secondary_gpu_state->noted_primary_gpu_copy_ok)
             {
@@ -1057,8 +1429,7 @@ meta_onscreen_native_swap_buffers_with_damage (CoglOnscreen  *onscreen,
   MetaKmsCrtc *kms_crtc;
   MetaKmsDevice *kms_device;
   MetaKmsUpdateFlag flags;
-  g_autoptr (MetaKmsFeedback) kms_feedback = NULL;
-  const GError *feedback_error;
+  MetaKmsUpdate *kms_update;
 
   COGL_TRACE_BEGIN_SCOPED (MetaRendererNativeSwapBuffers,
                            "Onscreen (swap-buffers)");
@@ -1197,26 +1568,54 @@ meta_onscreen_native_swap_buffers_with_damage (CoglOnscreen  *onscreen,
               meta_kms_crtc_get_id (kms_crtc),
               meta_kms_device_get_path (kms_device));
 
+  kms_update = meta_kms_ensure_pending_update (kms, kms_device);
+  meta_kms_update_add_result_listener (kms_update,
+                                       on_kms_update_result,
+                                       NULL);
+
   flags = META_KMS_UPDATE_FLAG_NONE;
-  kms_feedback = meta_kms_post_pending_update_sync (kms, kms_device, flags);
+  meta_kms_post_pending_update (kms, kms_device, flags);
 
-  switch (meta_kms_feedback_get_result (kms_feedback))
-    {
-    case META_KMS_FEEDBACK_PASSED:
-      clutter_frame_set_result (frame,
-                                CLUTTER_FRAME_RESULT_PENDING_PRESENTED);
-      break;
-    case META_KMS_FEEDBACK_FAILED:
-      clutter_frame_set_result (frame,
-                                CLUTTER_FRAME_RESULT_PENDING_PRESENTED);
+  clutter_frame_set_result (frame,
+                            CLUTTER_FRAME_RESULT_PENDING_PRESENTED);
+}
 
-      feedback_error = meta_kms_feedback_get_error (kms_feedback);
-      if (!g_error_matches (feedback_error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_PERMISSION_DENIED))
-        g_warning ("Failed to post KMS update: %s", feedback_error->message);
-      break;
-    }
+static void
+record_scanout_attempt (MetaOnscreenNative *onscreen_native,
+                        MetaDrmBuffer      *buffer,
+                        gboolean            format_supported,
+                        const char         *plane_type)
+{
+  MetaDrmFormatBuf tmp;
+  uint32_t format;
+  uint64_t modifier;
+
+  onscreen_native->scanout_stats.n_attempts++;
+  if (format_supported)
+    return;
+
+  onscreen_native->scanout_stats.n_format_mismatches++;
+
+  format = meta_drm_buffer_get_format (buffer);
+  modifier = meta_drm_buffer_get_modifier (buffer);
+  if (format == onscreen_native->scanout_stats.last_mismatch_format &&
+      modifier == onscreen_native->scanout_stats.last_mismatch_modifier)
+    return;
+
+  onscreen_native->scanout_stats.last_mismatch_format = format;
+  onscreen_native->scanout_stats.last_mismatch_modifier = modifier;
+
+  meta_topic (META_DEBUG_KMS,
+              "No %s plane of CRTC %" G_GUINT64_FORMAT " supports %s with "
+              "modifier 0x%" G_GINT64_MODIFIER "x for scanout "
+              "(%" G_GUINT64_FORMAT " format mismatches "
+              "in %" G_GUINT64_FORMAT " attempts)",
+              plane_type,
+              meta_crtc_get_id (onscreen_native->crtc),
+              meta_drm_format_to_string (&tmp, format),
+              modifier,
+              onscreen_native->scanout_stats.n_format_mismatches,
+              onscreen_native->scanout_stats.n_attempts);
 }
 
 gboolean
@@ -1229,6 +1628,8 @@ meta_onscreen_native_is_buffer_scanout_compatible (CoglOnscreen  *onscreen,
   MetaGpuKms *gpu_kms;
   MetaKmsDevice *kms_device;
   MetaKms *kms;
+  MetaKmsPlane *primary_plane;
+  gboolean format_supported;
   MetaKmsUpdate *test_update;
   g_autoptr (MetaKmsFeedback) kms_feedback = NULL;
   MetaKmsFeedbackResult result;
@@ -1236,6 +1637,18 @@ meta_onscreen_native_is_buffer_scanout_compatible (CoglOnscreen  *onscreen,
   gpu_kms = META_GPU_KMS (meta_crtc_get_gpu (crtc));
   kms_device = meta_gpu_kms_get_kms_device (gpu_kms);
   kms = meta_kms_device_get_kms (kms_device);
+
+  primary_plane =
+    meta_kms_device_get_primary_plane_for (kms_device,
+                                           meta_crtc_kms_get_kms_crtc (crtc_kms));
+  format_supported =
+    meta_kms_plane_is_modifier_supported (primary_plane,
+                                          meta_drm_buffer_get_format (fb),
+                                          meta_drm_buffer_get_modifier (fb));
+  record_scanout_attempt (onscreen_native, fb, format_supported, "primary");
+  if (!format_supported)
+    return FALSE;
+
   test_update = meta_kms_update_new (kms_device);
 
   meta_crtc_kms_assign_primary_plane (crtc_kms, fb, test_update);
@@ -1246,6 +1659,257 @@ meta_onscreen_native_is_buffer_scanout_compatible (CoglOnscreen  *onscreen,
   return result == META_KMS_FEEDBACK_PASSED;
 }
 
+void
+meta_onscreen_native_reset_overlays (CoglOnscreen *onscreen)
+{
+  MetaOnscreenNative *onscreen_native = META_ONSCREEN_NATIVE (onscreen);
+
+  clear_overlays (&onscreen_native->overlays.pending);
+}
+
+static void
+init_overlay_config (MetaOnscreenNativeOverlayConfig *config,
+                     MetaKmsPlane                    *plane,
+                     MetaDrmBuffer                   *buffer)
+{
+  *config = (MetaOnscreenNativeOverlayConfig) {
+    .plane = plane,
+    .format = meta_drm_buffer_get_format (buffer),
+    .modifier = meta_drm_buffer_get_modifier (buffer),
+    .width = meta_drm_buffer_get_width (buffer),
+    .height = meta_drm_buffer_get_height (buffer),
+  };
+}
+
+static gboolean
+fixed_16_rectangle_equal (const MetaFixed16Rectangle *rect,
+                          const MetaFixed16Rectangle *other_rect)
+{
+  return (rect->x == other_rect->x &&
+          rect->y == other_rect->y &&
+          rect->width == other_rect->width &&
+          rect->height == other_rect->height);
+}
+
+static gboolean
+overlay_config_equal (const MetaOnscreenNativeOverlayConfig *config,
+                      const MetaOnscreenNativeOverlayConfig *other_config)
+{
+  return (config->plane == other_config->plane &&
+          config->format == other_config->format &&
+          config->modifier == other_config->modifier &&
+          config->width == other_config->width &&
+          config->height == other_config->height &&
+          fixed_16_rectangle_equal (&config->src_rect,
+                                    &other_config->src_rect) &&
+          meta_rectangle_equal (&config->dst_rect, &other_config->dst_rect));
+}
+
+static GArray *
+get_pending_overlay_configs (MetaOnscreenNative               *onscreen_native,
+                             MetaOnscreenNativeOverlayConfig  *primary_config)
+{
+  GArray *configs;
+  GList *l;
+
+  init_overlay_config (primary_config, NULL, onscreen_native->gbm.current_fb);
+
+  configs = g_array_new (FALSE, FALSE,
+                         sizeof (MetaOnscreenNativeOverlayConfig));
+  for (l = onscreen_native->overlays.pending; l; l = l->next)
+    {
+      MetaOnscreenNativeOverlay *overlay = l->data;
+      MetaOnscreenNativeOverlayConfig config;
+
+      init_overlay_config (&config, overlay->plane, overlay->buffer);
+      config.src_rect = get_overlay_src_rect (overlay);
+      config.dst_rect = overlay->dst_rect;
+      g_array_append_val (configs, config);
+    }
+
+  return configs;
+}
+
+static gboolean
+overlay_test_matches (MetaOnscreenNativeOverlayTest         *test,
+                      GArray                                *configs,
+                      const MetaOnscreenNativeOverlayConfig *primary_config)
+{
+  unsigned int i;
+
+  if (!overlay_config_equal (primary_config, &test->primary_config))
+    return FALSE;
+
+  if (configs->len != test->configs->len)
+    return FALSE;
+
+  for (i = 0; i < configs->len; i++)
+    {
+      if (!overlay_config_equal (&g_array_index (configs,
+                                                 MetaOnscreenNativeOverlayConfig,
+                                                 i),
+                                 &g_array_index (test->configs,
+                                                 MetaOnscreenNativeOverlayConfig,
+                                                 i)))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+test_overlays (MetaOnscreenNative *onscreen_native)
+{
+  MetaCrtcKms *crtc_kms = META_CRTC_KMS (onscreen_native->crtc);
+  MetaKmsCrtc *kms_crtc = meta_crtc_kms_get_kms_crtc (crtc_kms);
+  MetaKmsDevice *kms_device = meta_kms_crtc_get_device (kms_crtc);
+  MetaKms *kms = meta_kms_device_get_kms (kms_device);
+  MetaKmsUpdate *test_update;
+  g_autoptr (MetaKmsFeedback) kms_feedback = NULL;
+  MetaOnscreenNativeOverlay *tested_overlay;
+  MetaOnscreenNativeOverlayTest *test;
+  g_autoptr (GArray) configs = NULL;
+  MetaOnscreenNativeOverlayConfig primary_config;
+  gboolean passed;
+  GList *l;
+
+  /* Test commits block until the kernel replied, so avoid repeating them
+   * every frame, whether they passed or not, while the same kind of buffers
+   * stay on the same planes. Overlays are tested one at a time, so the
+   * outcome is remembered for the plane of the overlay that was added last,
+   * until a different configuration is tested on that plane. */
+  tested_overlay = g_list_last (onscreen_native->overlays.pending)->data;
+  configs = get_pending_overlay_configs (onscreen_native, &primary_config);
+
+  if (!onscreen_native->overlays.tests)
+    {
+      onscreen_native->overlays.tests =
+        g_hash_table_new_full (NULL, NULL, NULL,
+                               (GDestroyNotify) meta_onscreen_native_overlay_test_free);
+    }
+
+  test = g_hash_table_lookup (onscreen_native->overlays.tests,
+                              tested_overlay->plane);
+  if (test && overlay_test_matches (test, configs, &primary_config))
+    return test->passed;
+
+  test_update = meta_kms_update_new (kms_device);
+
+  meta_crtc_kms_assign_primary_plane (crtc_kms,
+                                      onscreen_native->gbm.current_fb,
+                                      test_update);
+  for (l = onscreen_native->overlays.pending; l; l = l->next)
+    assign_overlay_plane (test_update, kms_crtc, l->data);
+
+  kms_feedback = meta_kms_post_test_update_sync (kms, test_update);
+  meta_kms_update_free (test_update);
+
+  passed =
+    meta_kms_feedback_get_result (kms_feedback) == META_KMS_FEEDBACK_PASSED;
+
+  test = g_new0 (MetaOnscreenNativeOverlayTest, 1);
+  test->primary_config = primary_config;
+  test->configs = g_steal_pointer (&configs);
+  test->passed = passed;
+  g_hash_table_replace (onscreen_native->overlays.tests,
+                        tested_overlay->plane,
+                        test);
+
+  return passed;
+}
+
+/**
+ * meta_onscreen_native_assign_overlay:
+ * @onscreen: A #CoglOnscreen
+ * @buffer: The buffer to scan out
+ * @dst_rect: Where to place @buffer, in CRTC coordinates
+ *
+ * Tries to put @buffer on a free overlay plane for the next frame, on top
+ * of the primary plane. Overlays assigned this way are only kept until
+ * meta_onscreen_native_reset_overlays() is called, and must not overlap
+ * each other, as their stacking order is left to the driver.
+ *
+ * Returns: %TRUE if @buffer was assigned an overlay plane that passed a
+ *   test commit together with the other assigned overlays.
+ */
+gboolean
+meta_onscreen_native_assign_overlay (CoglOnscreen        *onscreen,
+                                     MetaDrmBuffer       *buffer,
+                                     const MetaRectangle *dst_rect)
+{
+  MetaOnscreenNative *onscreen_native = META_ONSCREEN_NATIVE (onscreen);
+  MetaRendererNative *renderer_native = onscreen_native->renderer_native;
+  MetaRendererNativeGpuData *renderer_gpu_data;
+  MetaCrtcKms *crtc_kms = META_CRTC_KMS (onscreen_native->crtc);
+  MetaKmsCrtc *kms_crtc = meta_crtc_kms_get_kms_crtc (crtc_kms);
+  MetaKmsDevice *kms_device = meta_kms_crtc_get_device (kms_crtc);
+  uint32_t format = meta_drm_buffer_get_format (buffer);
+  uint64_t modifier = meta_drm_buffer_get_modifier (buffer);
+  gboolean format_supported = FALSE;
+  MetaOnscreenNativeOverlay *overlay;
+  GList *l;
+
+  renderer_gpu_data =
+    meta_renderer_native_get_gpu_data (renderer_native,
+                                       onscreen_native->render_gpu);
+  if (renderer_gpu_data->mode != META_RENDERER_NATIVE_MODE_GBM)
+    return FALSE;
+
+  if (onscreen_native->secondary_gpu_state)
+    return FALSE;
+
+  if (!onscreen_native->gbm.current_fb)
+    return FALSE;
+
+  if (meta_renderer_native_has_pending_mode_set (renderer_native))
+    {
+      clear_tested_overlays (onscreen_native);
+      return FALSE;
+    }
+
+  for (l = meta_kms_device_get_planes (kms_device); l; l = l->next)
+    {
+      MetaKmsPlane *plane = l->data;
+
+      if (meta_kms_plane_get_plane_type (plane) != META_KMS_PLANE_TYPE_OVERLAY)
+        continue;
+
+      if (!meta_kms_plane_is_usable_with (plane, kms_crtc))
+        continue;
+
+      if (has_overlay_plane (onscreen_native->overlays.pending, plane))
+        continue;
+
+      if (!meta_kms_plane_is_modifier_supported (plane, format, modifier))
+        continue;
+
+      format_supported = TRUE;
+
+      overlay = g_new0 (MetaOnscreenNativeOverlay, 1);
+      overlay->plane = plane;
+      overlay->buffer = g_object_ref (buffer);
+      overlay->dst_rect = *dst_rect;
+
+      onscreen_native->overlays.pending =
+        g_list_append (onscreen_native->overlays.pending, overlay);
+
+      if (test_overlays (onscreen_native))
+        {
+          record_scanout_attempt (onscreen_native, buffer, TRUE, "overlay");
+          return TRUE;
+        }
+
+      onscreen_native->overlays.pending =
+        g_list_remove (onscreen_native->overlays.pending, overlay);
+      meta_onscreen_native_overlay_free (overlay);
+    }
+
+  record_scanout_attempt (onscreen_native, buffer, format_supported,
+                          "overlay");
+
+  return FALSE;
+}
+
 static gboolean
 meta_onscreen_native_direct_scanout (CoglOnscreen   *onscreen,
                                      CoglScanout    *scanout,
@@ -1395,8 +2059,6 @@ meta_onscreen_native_finish_frame (CoglOnscreen *onscreen,
   MetaKms *kms = meta_kms_device_get_kms (kms_device);
   MetaKmsUpdateFlag flags;
   MetaKmsUpdate *kms_update;
-  g_autoptr (MetaKmsFeedback) kms_feedback = NULL;
-  const GError *error;
 
   kms_update = meta_kms_get_pending_update (kms, kms_device);
   if (!kms_update)
@@ -1412,29 +2074,16 @@ meta_onscreen_native_finish_frame (CoglOnscreen *onscreen,
                                           g_object_ref (onscreen_native->view),
                                           g_object_unref);
 
+  meta_kms_update_add_result_listener (kms_update,
+                                       on_kms_update_result,
+                                       NULL);
+
   flags = META_KMS_UPDATE_FLAG_NONE;
-  kms_feedback = meta_kms_post_pending_update_sync (kms,
-                                                    kms_device,
-                                                    flags);
-  switch (meta_kms_feedback_get_result (kms_feedback))
-    {
-    case META_KMS_FEEDBACK_PASSED:
-      add_onscreen_frame_info (crtc);
-      clutter_frame_set_result (frame,
-                                CLUTTER_FRAME_RESULT_PENDING_PRESENTED);
-      break;
-    case META_KMS_FEEDBACK_FAILED:
-      add_onscreen_frame_info (crtc);
-      clutter_frame_set_result (frame,
-                                CLUTTER_FRAME_RESULT_PENDING_PRESENTED);
+  meta_kms_post_pending_update (kms, kms_device, flags);
 
-      error = meta_kms_feedback_get_error (kms_feedback);
-      if (!g_error_matches (error,
-                            G_IO_ERROR,
-                            G_IO_ERROR_PERMISSION_DENIED))
-        g_warning ("Failed to post KMS update: %s", error->message);
-      break;
-    }
+  add_onscreen_frame_info (crtc);
+  clutter_frame_set_result (frame,
+                            CLUTTER_FRAME_RESULT_PENDING_PRESENTED);
 }
 
 static gboolean
@@ -2043,6 +2692,9 @@ init_secondary_gpu_state_cpu_copy_mode (MetaRendererNative         *renderer_nat
       secondary_gpu_state->cpu.dumb_fbs[i] = META_DRM_BUFFER_DUMB (dumb_buffer);
     }
 
+  secondary_gpu_state->cpu.damage_tracker =
+    meta_buffer_damage_tracker_new (G_N_ELEMENTS (secondary_gpu_state->cpu.dumb_fbs));
+
   /*
    * This function initializes everything needed for
    * META_SHARED_FRAMEBUFFER_COPY_MODE_ZERO as well.
@@ -2151,6 +2803,9 @@ meta_onscreen_native_dispose (GObject *object)
     {
     case META_RENDERER_NATIVE_MODE_GBM:
       g_clear_object (&onscreen_native->gbm.next_fb);
+      clear_overlays (&onscreen_native->overlays.pending);
+      clear_overlays (&onscreen_native->overlays.next);
+      clear_tested_overlays (onscreen_native);
       free_current_bo (onscreen);
       break;
     case META_RENDERER_NATIVE_MODE_SURFACELESS:
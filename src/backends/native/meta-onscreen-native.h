@@ -45,6 +45,12 @@ void meta_onscreen_native_dummy_power_save_page_flip (CoglOnscreen *onscreen);
 gboolean meta_onscreen_native_is_buffer_scanout_compatible (CoglOnscreen  *onscreen,
                                                             MetaDrmBuffer *fb);
 
+void meta_onscreen_native_reset_overlays (CoglOnscreen *onscreen);
+
+gboolean meta_onscreen_native_assign_overlay (CoglOnscreen        *onscreen,
+                                              MetaDrmBuffer       *buffer,
+                                              const MetaRectangle *dst_rect);
+
 void meta_onscreen_native_set_view (CoglOnscreen     *onscreen,
                                     MetaRendererView *view);
 
@@ -404,6 +404,7 @@ meta_output_kms_new (MetaGpuKms        *gpu_kms,
   output_info->hotplug_mode_update = connector_state->hotplug_mode_update;
   output_info->supports_underscanning =
     meta_kms_connector_is_underscanning_supported (kms_connector);
+  output_info->supports_vrr = connector_state->vrr_capable;
 
   meta_output_info_parse_edid (output_info, connector_state->edid_data);
 
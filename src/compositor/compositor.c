@@ -60,8 +60,11 @@
 #include "backends/x11/meta-event-x11.h"
 #include "backends/x11/meta-stage-x11.h"
 #include "clutter/clutter-mutter.h"
+#include "clutter/clutter-pipeline-prewarm.h"
 #include "cogl/cogl.h"
+#include "compositor/meta-background-content-private.h"
 #include "compositor/meta-later-private.h"
+#include "compositor/meta-shaped-texture-private.h"
 #include "compositor/meta-window-actor-x11.h"
 #include "compositor/meta-window-actor-private.h"
 #include "compositor/meta-window-group-private.h"
@@ -132,6 +135,8 @@ typedef struct _MetaCompositorPrivate
   MetaPluginManager *plugin_mgr;
 
   MetaLaters *laters;
+
+  ClutterPipelinePrewarm *pipeline_prewarm;
 } MetaCompositorPrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (MetaCompositor, meta_compositor,
@@ -439,6 +444,9 @@ meta_compositor_do_manage (MetaCompositor  *compositor,
   priv->plugin_mgr = meta_plugin_manager_new (compositor);
   meta_plugin_manager_start (priv->plugin_mgr);
 
+  if (priv->pipeline_prewarm)
+    clutter_pipeline_prewarm_start (priv->pipeline_prewarm);
+
   return TRUE;
 }
 
@@ -1135,6 +1143,23 @@ meta_compositor_constructed (GObject *object)
 
   priv->laters = meta_laters_new (compositor);
 
+  if (!g_getenv ("MUTTER_DEBUG_DISABLE_PIPELINE_PREWARM"))
+    {
+      g_autofree char *shapes_path = NULL;
+
+      shapes_path = g_build_filename (g_get_user_cache_dir (),
+                                      "mutter", "pipeline-shapes", NULL);
+      priv->pipeline_prewarm = clutter_pipeline_prewarm_new (priv->context,
+                                                             shapes_path);
+      clutter_pipeline_prewarm_register_shape (priv->pipeline_prewarm,
+                                               "meta-shaped-texture",
+                                               meta_shaped_texture_create_prewarm_pipeline);
+      clutter_pipeline_prewarm_register_shape (priv->pipeline_prewarm,
+                                               "meta-background",
+                                               meta_background_content_create_prewarm_pipeline);
+      clutter_pipeline_prewarm_set_default (priv->pipeline_prewarm);
+    }
+
   G_OBJECT_CLASS (meta_compositor_parent_class)->constructed (object);
 }
 
@@ -1147,6 +1172,7 @@ meta_compositor_dispose (GObject *object)
   ClutterActor *stage = meta_backend_get_stage (priv->backend);
 
   g_clear_pointer (&priv->laters, meta_laters_free);
+  g_clear_pointer (&priv->pipeline_prewarm, clutter_pipeline_prewarm_free);
 
   g_clear_signal_handler (&priv->stage_presented_id, stage);
   g_clear_signal_handler (&priv->before_paint_handler_id, stage);
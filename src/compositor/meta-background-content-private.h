@@ -13,4 +13,7 @@ void meta_background_content_cull_out (MetaBackgroundContent *self,
 
 void meta_background_content_reset_culling (MetaBackgroundContent *self);
 
+CoglPipeline * meta_background_content_create_prewarm_pipeline (CoglContext *ctx,
+                                                                const char  *variant);
+
 #endif /* META_BACKGROUND_CONTENT_PRIVATE_H */
@@ -79,6 +79,7 @@
 
 #include "backends/meta-backend-private.h"
 #include "clutter/clutter.h"
+#include "clutter/clutter-pipeline-prewarm.h"
 #include "compositor/clutter-utils.h"
 #include "compositor/cogl-utils.h"
 #include "compositor/meta-background-private.h"
@@ -310,6 +311,7 @@ make_pipeline (PipelineFlags pipeline_flags)
 {
   static CoglPipeline *templates[PIPELINE_ALL + 1];
   CoglPipeline **templatep;
+  char variant[4];
 
   g_assert (pipeline_flags < G_N_ELEMENTS (templates));
 
@@ -380,11 +382,27 @@ make_pipeline (PipelineFlags pipeline_flags)
 
       if ((pipeline_flags & PIPELINE_BLEND) == 0)
         cogl_pipeline_set_blend (*templatep, "RGBA = ADD (SRC_COLOR, 0)", NULL);
+
+      g_snprintf (variant, sizeof (variant), "%u", pipeline_flags);
+      clutter_pipeline_prewarm_record_default ("meta-background", variant);
     }
 
   return cogl_pipeline_copy (*templatep);
 }
 
+CoglPipeline *
+meta_background_content_create_prewarm_pipeline (CoglContext *ctx,
+                                                 const char  *variant)
+{
+  guint64 pipeline_flags;
+
+  if (!g_ascii_string_to_unsigned (variant, 10, 0, PIPELINE_ALL,
+                                   &pipeline_flags, NULL))
+    return NULL;
+
+  return make_pipeline (pipeline_flags);
+}
+
 static void
 setup_pipeline (MetaBackgroundContent *self,
                 ClutterActor          *actor,
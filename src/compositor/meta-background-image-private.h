@@ -0,0 +1,32 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+#ifndef META_BACKGROUND_IMAGE_PRIVATE_H
+#define META_BACKGROUND_IMAGE_PRIVATE_H
+
+#include "core/util-private.h"
+#include "meta/meta-background-image.h"
+
+META_EXPORT_TEST
+void         meta_background_image_request_scaled     (MetaBackgroundImage *image,
+                                                       int                  target_width,
+                                                       int                  target_height);
+
+META_EXPORT_TEST
+void         meta_background_image_release_scaled     (MetaBackgroundImage *image,
+                                                       int                  target_width,
+                                                       int                  target_height);
+
+META_EXPORT_TEST
+CoglTexture *meta_background_image_get_scaled_texture (MetaBackgroundImage *image,
+                                                       int                  target_width,
+                                                       int                  target_height);
+
+META_EXPORT_TEST
+gboolean     meta_background_image_calculate_scaled_size (int  image_width,
+                                                          int  image_height,
+                                                          int  target_width,
+                                                          int  target_height,
+                                                          int *width,
+                                                          int *height);
+
+#endif /* META_BACKGROUND_IMAGE_PRIVATE_H */
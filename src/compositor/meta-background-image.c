@@ -24,36 +24,63 @@
 
 #include "config.h"
 
-#include "meta/meta-background-image.h"
+#include "compositor/meta-background-image-private.h"
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gio/gio.h>
+#include <math.h>
 
 #include "clutter/clutter.h"
 #include "compositor/cogl-utils.h"
+#include "meta/meta-later.h"
+
+/* Maximum amount of pixel data uploaded to background textures per frame */
+#define UPLOAD_BYTES_PER_FRAME (8 * 1024 * 1024)
+
+/* Scaled images are only created when they are noticeably smaller than the
+ * image itself, otherwise the full size texture is good enough */
+#define MAX_SCALED_IMAGE_RATIO 0.75
 
 enum
 {
   LOADED,
+  SCALED_TEXTURE_READY,
   LAST_SIGNAL
 };
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+typedef struct _MetaBackgroundImageContent MetaBackgroundImageContent;
+
 /**
  * MetaBackgroundImageCache:
  *
  * #MetaBackgroundImageCache caches loading of textures for backgrounds; there's actually
  * nothing background specific about it, other than it is tuned to work well for
  * large images as typically are used for backgrounds.
+ *
+ * Images are decoded in a thread, and uploaded over several frames so that
+ * large images don't stall the compositor. Files with the same contents share
+ * their textures.
  */
 struct _MetaBackgroundImageCache
 {
   GObject parent_instance;
 
   GHashTable *images;
+  GHashTable *contents;
+
+  GQueue uploads;
+  unsigned int upload_later_id;
 };
 
+typedef struct _MetaBackgroundImageSize
+{
+  int width;
+  int height;
+  int ref_count;
+} MetaBackgroundImageSize;
+
 /**
  * MetaBackgroundImage:
  *
@@ -66,15 +93,95 @@ struct _MetaBackgroundImage
   MetaBackgroundImageCache *cache;
   gboolean in_cache;
   gboolean loaded;
+  MetaBackgroundImageContent *content;
+
+  /* Sizes of the scaled images that were requested, read by the loading
+   * thread to scale the image right after decoding it */
+  GMutex scaled_sizes_lock;
+  GArray *scaled_sizes;
+};
+
+typedef struct _MetaBackgroundScaledImage
+{
+  int target_width;
+  int target_height;
+  int ref_count;
+
+  gboolean pending;
+  CoglTexture *texture;
+} MetaBackgroundScaledImage;
+
+/* The decoded contents of a file, shared by all the images whose files have
+ * the same contents */
+struct _MetaBackgroundImageContent
+{
+  int ref_count;
+
+  MetaBackgroundImageCache *cache;
+  gboolean in_cache;
+  char *hash;
+  GFile *file;
+
+  int width;
+  int height;
+  gboolean loaded;
   CoglTexture *texture;
+
+  GPtrArray *scaled_images;
+
+  /* Images using this content, not owned */
+  GList *images;
 };
 
+typedef struct _MetaBackgroundUpload
+{
+  MetaBackgroundImageContent *content;
+
+  /* The size the image was scaled for, or 0 for the full size image */
+  int target_width;
+  int target_height;
+
+  GdkPixbuf *pixbuf;
+  CoglTexture *texture;
+  int n_uploaded_rows;
+} MetaBackgroundUpload;
+
+typedef struct _MetaBackgroundScaledPixbuf
+{
+  int target_width;
+  int target_height;
+  GdkPixbuf *pixbuf;
+} MetaBackgroundScaledPixbuf;
+
+typedef struct _MetaBackgroundLoadResult
+{
+  char *hash;
+  GdkPixbuf *pixbuf;
+  GArray *scaled_pixbufs;
+} MetaBackgroundLoadResult;
+
+typedef struct _MetaBackgroundScaleRequest
+{
+  MetaBackgroundImageContent *content;
+  GFile *file;
+  int target_width;
+  int target_height;
+  int width;
+  int height;
+} MetaBackgroundScaleRequest;
+
 G_DEFINE_TYPE (MetaBackgroundImageCache, meta_background_image_cache, G_TYPE_OBJECT);
 
+static void queue_upload (MetaBackgroundImageContent *content,
+                          GdkPixbuf                  *pixbuf,
+                          int                         target_width,
+                          int                         target_height);
+
 static void
 meta_background_image_cache_init (MetaBackgroundImageCache *cache)
 {
   cache->images = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+  cache->contents = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 static void
@@ -91,7 +198,15 @@ meta_background_image_cache_finalize (GObject *object)
       image->in_cache = FALSE;
     }
 
+  g_hash_table_iter_init (&iter, cache->contents);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      MetaBackgroundImageContent *content = value;
+      content->in_cache = FALSE;
+    }
+
   g_hash_table_destroy (cache->images);
+  g_hash_table_destroy (cache->contents);
 
   G_OBJECT_CLASS (meta_background_image_cache_parent_class)->finalize (object);
 }
@@ -120,6 +235,115 @@ meta_background_image_cache_get_default (void)
   return cache;
 }
 
+/**
+ * meta_background_image_calculate_scaled_size:
+ * @image_width: width of the image
+ * @image_height: height of the image
+ * @target_width: width of the area the image is drawn into
+ * @target_height: height of the area the image is drawn into
+ * @width: (out): return location for the width of the scaled image
+ * @height: (out): return location for the height of the scaled image
+ *
+ * Calculates the size of the smallest image with the same aspect ratio
+ * which still covers @target_width x @target_height, so that the scaled
+ * image is never magnified when drawn into that area, whatever the
+ * background style.
+ *
+ * Returns: %TRUE if the scaled image is sufficiently smaller than the
+ *   image to be worth creating
+ */
+gboolean
+meta_background_image_calculate_scaled_size (int  image_width,
+                                             int  image_height,
+                                             int  target_width,
+                                             int  target_height,
+                                             int *width,
+                                             int *height)
+{
+  double scale;
+
+  scale = MAX ((double) target_width / image_width,
+               (double) target_height / image_height);
+  if (scale > MAX_SCALED_IMAGE_RATIO)
+    return FALSE;
+
+  *width = CLAMP ((int) ceil (image_width * scale), 1, image_width);
+  *height = CLAMP ((int) ceil (image_height * scale), 1, image_height);
+
+  return TRUE;
+}
+
+static GdkPixbuf *
+decode_pixbuf (GBytes  *bytes,
+               GError **error)
+{
+  g_autoptr (GInputStream) stream = NULL;
+  g_autoptr (GdkPixbuf) pixbuf = NULL;
+
+  stream = g_memory_input_stream_new_from_bytes (bytes);
+  pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, error);
+  if (pixbuf == NULL)
+    return NULL;
+
+  return gdk_pixbuf_apply_embedded_orientation (pixbuf);
+}
+
+/* Premultiplies the pixels the same way Cogl would do it while uploading */
+static void
+premultiply_pixbuf (GdkPixbuf *pixbuf)
+{
+  int width, height, rowstride;
+  guchar *pixels;
+  int x, y;
+
+  if (!gdk_pixbuf_get_has_alpha (pixbuf))
+    return;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+
+  for (y = 0; y < height; y++)
+    {
+      guchar *p = pixels + y * rowstride;
+
+      for (x = 0; x < width; x++)
+        {
+          unsigned int alpha = p[3];
+          int i;
+
+          for (i = 0; i < 3; i++)
+            {
+              unsigned int t = p[i] * alpha + 128;
+
+              p[i] = ((t >> 8) + t) >> 8;
+            }
+
+          p += 4;
+        }
+    }
+}
+
+static void
+meta_background_load_result_free (MetaBackgroundLoadResult *result)
+{
+  int i;
+
+  for (i = 0; i < result->scaled_pixbufs->len; i++)
+    {
+      MetaBackgroundScaledPixbuf *scaled_pixbuf =
+        &g_array_index (result->scaled_pixbufs, MetaBackgroundScaledPixbuf, i);
+
+      g_object_unref (scaled_pixbuf->pixbuf);
+    }
+
+  g_array_free (result->scaled_pixbufs, TRUE);
+  g_clear_object (&result->pixbuf);
+  g_free (result->hash);
+  g_free (result);
+}
+
 static void
 load_file (GTask               *task,
            MetaBackgroundImage *image,
@@ -127,26 +351,494 @@ load_file (GTask               *task,
            GCancellable        *cancellable)
 {
   GError *error = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GArray) scaled_sizes = NULL;
+  MetaBackgroundLoadResult *result;
   GdkPixbuf *pixbuf;
-  GFileInputStream *stream;
+  int width, height;
+  int i;
 
-  stream = g_file_read (image->file, NULL, &error);
-  if (stream == NULL)
+  bytes = g_file_load_bytes (image->file, NULL, NULL, &error);
+  if (bytes == NULL)
     {
       g_task_return_error (task, error);
       return;
     }
 
-  pixbuf = gdk_pixbuf_new_from_stream (G_INPUT_STREAM (stream), NULL, &error);
-  g_object_unref (stream);
+  pixbuf = decode_pixbuf (bytes, &error);
+  if (pixbuf == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  result = g_new0 (MetaBackgroundLoadResult, 1);
+  result->hash = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+  result->pixbuf = pixbuf;
+  result->scaled_pixbufs = g_array_new (FALSE, FALSE,
+                                        sizeof (MetaBackgroundScaledPixbuf));
+
+  g_mutex_lock (&image->scaled_sizes_lock);
+  scaled_sizes = g_array_copy (image->scaled_sizes);
+  g_mutex_unlock (&image->scaled_sizes_lock);
+
+  /* Scale before premultiplying, gdk-pixbuf expects unpremultiplied data */
+  for (i = 0; i < scaled_sizes->len; i++)
+    {
+      MetaBackgroundImageSize *size =
+        &g_array_index (scaled_sizes, MetaBackgroundImageSize, i);
+      MetaBackgroundScaledPixbuf scaled_pixbuf;
+
+      if (!meta_background_image_calculate_scaled_size (gdk_pixbuf_get_width (pixbuf),
+                                                        gdk_pixbuf_get_height (pixbuf),
+                                                        size->width,
+                                                        size->height,
+                                                        &width, &height))
+        continue;
+
+      scaled_pixbuf.target_width = size->width;
+      scaled_pixbuf.target_height = size->height;
+      scaled_pixbuf.pixbuf = gdk_pixbuf_scale_simple (pixbuf, width, height,
+                                                      GDK_INTERP_BILINEAR);
+      if (scaled_pixbuf.pixbuf == NULL)
+        continue;
+
+      premultiply_pixbuf (scaled_pixbuf.pixbuf);
+      g_array_append_val (result->scaled_pixbufs, scaled_pixbuf);
+    }
+
+  premultiply_pixbuf (pixbuf);
+
+  g_task_return_pointer (task, result,
+                         (GDestroyNotify) meta_background_load_result_free);
+}
+
+static MetaBackgroundImageContent *
+meta_background_image_content_new (MetaBackgroundImageCache *cache,
+                                   const char               *hash,
+                                   GFile                    *file,
+                                   int                       width,
+                                   int                       height)
+{
+  MetaBackgroundImageContent *content;
+
+  content = g_new0 (MetaBackgroundImageContent, 1);
+  content->ref_count = 1;
+  content->cache = cache;
+  content->hash = g_strdup (hash);
+  content->file = g_object_ref (file);
+  content->width = width;
+  content->height = height;
+  content->scaled_images = g_ptr_array_new_with_free_func (g_free);
+
+  content->in_cache = TRUE;
+  g_hash_table_insert (cache->contents, content->hash, content);
+
+  return content;
+}
+
+static MetaBackgroundImageContent *
+meta_background_image_content_ref (MetaBackgroundImageContent *content)
+{
+  content->ref_count++;
+
+  return content;
+}
+
+static void
+meta_background_image_content_unref (MetaBackgroundImageContent *content)
+{
+  int i;
+
+  if (--content->ref_count > 0)
+    return;
+
+  if (content->in_cache)
+    g_hash_table_remove (content->cache->contents, content->hash);
+
+  for (i = 0; i < content->scaled_images->len; i++)
+    {
+      MetaBackgroundScaledImage *scaled_image =
+        g_ptr_array_index (content->scaled_images, i);
+
+      cogl_clear_object (&scaled_image->texture);
+    }
+
+  g_ptr_array_free (content->scaled_images, TRUE);
+  cogl_clear_object (&content->texture);
+  g_object_unref (content->file);
+  g_free (content->hash);
+  g_free (content);
+}
+
+static MetaBackgroundScaledImage *
+find_scaled_image (MetaBackgroundImageContent *content,
+                   int                         target_width,
+                   int                         target_height)
+{
+  int i;
+
+  for (i = 0; i < content->scaled_images->len; i++)
+    {
+      MetaBackgroundScaledImage *scaled_image =
+        g_ptr_array_index (content->scaled_images, i);
+
+      if (scaled_image->target_width == target_width &&
+          scaled_image->target_height == target_height)
+        return scaled_image;
+    }
+
+  return NULL;
+}
+
+static void
+scale_file (GTask        *task,
+            gpointer      source_object,
+            gpointer      task_data,
+            GCancellable *cancellable)
+{
+  MetaBackgroundScaleRequest *request = task_data;
+  GError *error = NULL;
+  g_autoptr (GBytes) bytes = NULL;
+  g_autoptr (GdkPixbuf) pixbuf = NULL;
+  GdkPixbuf *scaled_pixbuf;
+
+  bytes = g_file_load_bytes (request->file, NULL, NULL, &error);
+  if (bytes == NULL)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
 
+  pixbuf = decode_pixbuf (bytes, &error);
   if (pixbuf == NULL)
     {
       g_task_return_error (task, error);
       return;
     }
 
-  g_task_return_pointer (task, pixbuf, (GDestroyNotify) g_object_unref);
+  scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
+                                           request->width, request->height,
+                                           GDK_INTERP_BILINEAR);
+  if (scaled_pixbuf == NULL)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               "Not enough memory to scale the image");
+      return;
+    }
+
+  premultiply_pixbuf (scaled_pixbuf);
+
+  g_task_return_pointer (task, scaled_pixbuf, g_object_unref);
+}
+
+static void
+meta_background_scale_request_free (MetaBackgroundScaleRequest *request)
+{
+  meta_background_image_content_unref (request->content);
+  g_object_unref (request->file);
+  g_free (request);
+}
+
+static void
+file_scaled (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  MetaBackgroundScaleRequest *request =
+    g_task_get_task_data (G_TASK (result));
+  MetaBackgroundImageContent *content = request->content;
+  MetaBackgroundScaledImage *scaled_image;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GdkPixbuf) pixbuf = NULL;
+
+  scaled_image = find_scaled_image (content,
+                                    request->target_width,
+                                    request->target_height);
+
+  pixbuf = g_task_propagate_pointer (G_TASK (result), &error);
+  if (pixbuf == NULL)
+    {
+      g_autofree char *uri = g_file_get_uri (request->file);
+
+      g_warning ("Failed to scale background '%s': %s",
+                 uri, error->message);
+
+      if (scaled_image)
+        scaled_image->pending = FALSE;
+      return;
+    }
+
+  /* Only upload it if it's still wanted */
+  if (scaled_image && scaled_image->pending)
+    queue_upload (content, pixbuf,
+                  request->target_width, request->target_height);
+}
+
+static void
+meta_background_image_content_ref_scaled (MetaBackgroundImageContent *content,
+                                          int                         target_width,
+                                          int                         target_height,
+                                          GArray                     *scaled_pixbufs)
+{
+  MetaBackgroundScaledImage *scaled_image;
+  MetaBackgroundScaleRequest *request;
+  GTask *task;
+  int width, height;
+  int i;
+
+  scaled_image = find_scaled_image (content, target_width, target_height);
+  if (scaled_image)
+    {
+      scaled_image->ref_count++;
+      return;
+    }
+
+  scaled_image = g_new0 (MetaBackgroundScaledImage, 1);
+  scaled_image->target_width = target_width;
+  scaled_image->target_height = target_height;
+  scaled_image->ref_count = 1;
+  g_ptr_array_add (content->scaled_images, scaled_image);
+
+  if (!meta_background_image_calculate_scaled_size (content->width,
+                                                    content->height,
+                                                    target_width,
+                                                    target_height,
+                                                    &width, &height))
+    return;
+
+  scaled_image->pending = TRUE;
+
+  for (i = 0; scaled_pixbufs && i < scaled_pixbufs->len; i++)
+    {
+      MetaBackgroundScaledPixbuf *scaled_pixbuf =
+        &g_array_index (scaled_pixbufs, MetaBackgroundScaledPixbuf, i);
+
+      if (scaled_pixbuf->target_width == target_width &&
+          scaled_pixbuf->target_height == target_height)
+        {
+          queue_upload (content, scaled_pixbuf->pixbuf,
+                        target_width, target_height);
+          return;
+        }
+    }
+
+  /* The size was requested after the image was decoded, decode it again
+   * rather than keeping the full size image around */
+  request = g_new0 (MetaBackgroundScaleRequest, 1);
+  request->content = meta_background_image_content_ref (content);
+  request->file = g_object_ref (content->file);
+  request->target_width = target_width;
+  request->target_height = target_height;
+  request->width = width;
+  request->height = height;
+
+  task = g_task_new (NULL, NULL, file_scaled, NULL);
+  g_task_set_task_data (task, request,
+                        (GDestroyNotify) meta_background_scale_request_free);
+  g_task_run_in_thread (task, scale_file);
+  g_object_unref (task);
+}
+
+static void
+meta_background_image_content_unref_scaled (MetaBackgroundImageContent *content,
+                                            int                         target_width,
+                                            int                         target_height)
+{
+  MetaBackgroundScaledImage *scaled_image;
+
+  scaled_image = find_scaled_image (content, target_width, target_height);
+  g_return_if_fail (scaled_image);
+
+  if (--scaled_image->ref_count > 0)
+    return;
+
+  cogl_clear_object (&scaled_image->texture);
+  g_ptr_array_remove_fast (content->scaled_images, scaled_image);
+}
+
+static void
+meta_background_upload_free (MetaBackgroundUpload *upload)
+{
+  cogl_clear_object (&upload->texture);
+  g_object_unref (upload->pixbuf);
+  meta_background_image_content_unref (upload->content);
+  g_free (upload);
+}
+
+static void
+finish_upload (MetaBackgroundUpload *upload)
+{
+  MetaBackgroundImageContent *content = upload->content;
+  MetaBackgroundScaledImage *scaled_image;
+  GList *l;
+
+  if (upload->target_width == 0)
+    {
+      content->texture = g_steal_pointer (&upload->texture);
+      content->loaded = TRUE;
+
+      if (!content->texture && content->in_cache)
+        {
+          g_hash_table_remove (content->cache->contents, content->hash);
+          content->in_cache = FALSE;
+        }
+
+      for (l = content->images; l; l = l->next)
+        {
+          MetaBackgroundImage *image = l->data;
+
+          image->loaded = TRUE;
+          g_signal_emit (image, signals[LOADED], 0);
+        }
+
+      return;
+    }
+
+  scaled_image = find_scaled_image (content,
+                                    upload->target_width,
+                                    upload->target_height);
+  if (!scaled_image || !scaled_image->pending)
+    return;
+
+  scaled_image->pending = FALSE;
+  scaled_image->texture = g_steal_pointer (&upload->texture);
+
+  /* Scaled images created while loading are ready before it completes */
+  if (!content->loaded)
+    return;
+
+  for (l = content->images; l; l = l->next)
+    g_signal_emit (l->data, signals[SCALED_TEXTURE_READY], 0);
+}
+
+/* Uploads a band of rows of @upload, returns the number of bytes uploaded,
+ * or -1 if the upload failed */
+static int
+upload_rows (MetaBackgroundUpload *upload,
+             int                   max_bytes)
+{
+  g_autoptr (GError) error = NULL;
+  GdkPixbuf *pixbuf = upload->pixbuf;
+  int width = gdk_pixbuf_get_width (pixbuf);
+  int height = gdk_pixbuf_get_height (pixbuf);
+  int rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  gboolean has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+  const guchar *pixels = gdk_pixbuf_read_pixels (pixbuf);
+  int n_rows;
+
+  if (upload->texture == NULL)
+    {
+      upload->texture =
+        meta_create_texture (width, height,
+                             has_alpha ? COGL_TEXTURE_COMPONENTS_RGBA : COGL_TEXTURE_COMPONENTS_RGB,
+                             META_TEXTURE_ALLOW_SLICING);
+    }
+
+  n_rows = CLAMP (max_bytes / rowstride, 1, height - upload->n_uploaded_rows);
+
+  if (!cogl_texture_set_region (upload->texture,
+                                0, 0,
+                                0, upload->n_uploaded_rows,
+                                width, n_rows,
+                                width, n_rows,
+                                has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888_PRE : COGL_PIXEL_FORMAT_RGB_888,
+                                rowstride,
+                                pixels + upload->n_uploaded_rows * rowstride))
+    {
+      g_warning ("Failed to upload background texture");
+      return -1;
+    }
+
+  upload->n_uploaded_rows += n_rows;
+
+  return n_rows * rowstride;
+}
+
+static gboolean
+process_uploads (gpointer user_data)
+{
+  MetaBackgroundImageCache *cache = user_data;
+  int budget = UPLOAD_BYTES_PER_FRAME;
+
+  while (budget > 0 && !g_queue_is_empty (&cache->uploads))
+    {
+      MetaBackgroundUpload *upload = g_queue_peek_head (&cache->uploads);
+      GdkPixbuf *pixbuf = upload->pixbuf;
+      int n_bytes;
+
+      n_bytes = upload_rows (upload, budget);
+      if (n_bytes < 0)
+        cogl_clear_object (&upload->texture);
+      else
+        budget -= n_bytes;
+
+      if (n_bytes < 0 ||
+          upload->n_uploaded_rows == gdk_pixbuf_get_height (pixbuf))
+        {
+          g_queue_pop_head (&cache->uploads);
+          finish_upload (upload);
+          meta_background_upload_free (upload);
+        }
+    }
+
+  if (g_queue_is_empty (&cache->uploads))
+    {
+      cache->upload_later_id = 0;
+      return G_SOURCE_REMOVE;
+    }
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+queue_upload (MetaBackgroundImageContent *content,
+              GdkPixbuf                  *pixbuf,
+              int                         target_width,
+              int                         target_height)
+{
+  MetaBackgroundImageCache *cache = content->cache;
+  MetaBackgroundUpload *upload;
+
+  upload = g_new0 (MetaBackgroundUpload, 1);
+  upload->content = meta_background_image_content_ref (content);
+  upload->pixbuf = g_object_ref (pixbuf);
+  upload->target_width = target_width;
+  upload->target_height = target_height;
+
+  /* Scaled images are needed first to draw the monitor backgrounds */
+  if (target_width != 0)
+    g_queue_push_head (&cache->uploads, upload);
+  else
+    g_queue_push_tail (&cache->uploads, upload);
+
+  if (!cache->upload_later_id)
+    {
+      cache->upload_later_id = meta_later_add (META_LATER_BEFORE_REDRAW,
+                                               process_uploads,
+                                               cache, NULL);
+    }
+}
+
+static void
+set_content (MetaBackgroundImage        *image,
+             MetaBackgroundImageContent *content,
+             GArray                     *scaled_pixbufs)
+{
+  int i;
+
+  image->content = content;
+  content->images = g_list_prepend (content->images, image);
+
+  for (i = 0; i < image->scaled_sizes->len; i++)
+    {
+      MetaBackgroundImageSize *size =
+        &g_array_index (image->scaled_sizes, MetaBackgroundImageSize, i);
+
+      meta_background_image_content_ref_scaled (content,
+                                                size->width, size->height,
+                                                scaled_pixbufs);
+    }
 }
 
 static void
@@ -155,63 +847,52 @@ file_loaded (GObject      *source_object,
              gpointer      user_data)
 {
   MetaBackgroundImage *image = META_BACKGROUND_IMAGE (source_object);
+  MetaBackgroundImageCache *cache = image->cache;
   g_autoptr (GError) error = NULL;
-  g_autoptr (GError) local_error = NULL;
+  MetaBackgroundLoadResult *load_result;
+  MetaBackgroundImageContent *content;
   GTask *task;
-  CoglTexture *texture;
-  GdkPixbuf *pixbuf, *rotated;
-  int width, height, row_stride;
-  guchar *pixels;
-  gboolean has_alpha;
 
   task = G_TASK (result);
-  pixbuf = g_task_propagate_pointer (task, &error);
+  load_result = g_task_propagate_pointer (task, &error);
 
-  if (pixbuf == NULL)
+  if (load_result == NULL)
     {
       char *uri = g_file_get_uri (image->file);
       g_warning ("Failed to load background '%s': %s",
                  uri, error->message);
       g_free (uri);
-      goto out;
+
+      image->loaded = TRUE;
+      g_signal_emit (image, signals[LOADED], 0);
+      return;
     }
 
-  rotated = gdk_pixbuf_apply_embedded_orientation (pixbuf);
-  if (rotated != NULL)
+  content = g_hash_table_lookup (cache->contents, load_result->hash);
+  if (content)
     {
-      g_object_unref (pixbuf);
-      pixbuf = rotated;
+      set_content (image, meta_background_image_content_ref (content),
+                   load_result->scaled_pixbufs);
     }
-
-  width = gdk_pixbuf_get_width (pixbuf);
-  height = gdk_pixbuf_get_height (pixbuf);
-  row_stride = gdk_pixbuf_get_rowstride (pixbuf);
-  pixels = gdk_pixbuf_get_pixels (pixbuf);
-  has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
-
-  texture = meta_create_texture (width, height,
-                                 has_alpha ? COGL_TEXTURE_COMPONENTS_RGBA : COGL_TEXTURE_COMPONENTS_RGB,
-                                 META_TEXTURE_ALLOW_SLICING);
-
-  if (!cogl_texture_set_data (texture,
-                              has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 : COGL_PIXEL_FORMAT_RGB_888,
-                              row_stride,
-                              pixels, 0,
-                              &local_error))
+  else
     {
-      g_warning ("Failed to create texture for background: %s",
-                 local_error->message);
-      cogl_clear_object (&texture);
+      content =
+        meta_background_image_content_new (cache,
+                                           load_result->hash,
+                                           image->file,
+                                           gdk_pixbuf_get_width (load_result->pixbuf),
+                                           gdk_pixbuf_get_height (load_result->pixbuf));
+      set_content (image, content, load_result->scaled_pixbufs);
+      queue_upload (content, load_result->pixbuf, 0, 0);
     }
 
-  image->texture = texture;
-
-out:
-  if (pixbuf != NULL)
-    g_object_unref (pixbuf);
+  meta_background_load_result_free (load_result);
 
-  image->loaded = TRUE;
-  g_signal_emit (image, signals[LOADED], 0);
+  if (content->loaded)
+    {
+      image->loaded = TRUE;
+      g_signal_emit (image, signals[LOADED], 0);
+    }
 }
 
 /**
@@ -270,6 +951,7 @@ meta_background_image_cache_purge (MetaBackgroundImageCache *cache,
                                    GFile                    *file)
 {
   MetaBackgroundImage *image;
+  MetaBackgroundImageContent *content;
 
   g_return_if_fail (META_IS_BACKGROUND_IMAGE_CACHE (cache));
   g_return_if_fail (file != NULL);
@@ -280,6 +962,15 @@ meta_background_image_cache_purge (MetaBackgroundImageCache *cache,
 
   g_hash_table_remove (cache->images, image->file);
   image->in_cache = FALSE;
+
+  /* Don't share the textures with images loaded later on either, they may
+   * have been invalidated */
+  content = image->content;
+  if (content && content->in_cache)
+    {
+      g_hash_table_remove (cache->contents, content->hash);
+      content->in_cache = FALSE;
+    }
 }
 
 G_DEFINE_TYPE (MetaBackgroundImage, meta_background_image, G_TYPE_OBJECT);
@@ -287,6 +978,9 @@ G_DEFINE_TYPE (MetaBackgroundImage, meta_background_image, G_TYPE_OBJECT);
 static void
 meta_background_image_init (MetaBackgroundImage *image)
 {
+  g_mutex_init (&image->scaled_sizes_lock);
+  image->scaled_sizes = g_array_new (FALSE, FALSE,
+                                     sizeof (MetaBackgroundImageSize));
 }
 
 static void
@@ -297,8 +991,28 @@ meta_background_image_finalize (GObject *object)
   if (image->in_cache)
     g_hash_table_remove (image->cache->images, image->file);
 
-  if (image->texture)
-    cogl_object_unref (image->texture);
+  if (image->content)
+    {
+      MetaBackgroundImageContent *content = image->content;
+      int i;
+
+      for (i = 0; i < image->scaled_sizes->len; i++)
+        {
+          MetaBackgroundImageSize *size =
+            &g_array_index (image->scaled_sizes, MetaBackgroundImageSize, i);
+
+          meta_background_image_content_unref_scaled (content,
+                                                      size->width,
+                                                      size->height);
+        }
+
+      content->images = g_list_remove (content->images, image);
+      meta_background_image_content_unref (content);
+    }
+
+  g_array_free (image->scaled_sizes, TRUE);
+  g_mutex_clear (&image->scaled_sizes_lock);
+
   if (image->file)
     g_object_unref (image->file);
 
@@ -319,6 +1033,21 @@ meta_background_image_class_init (MetaBackgroundImageClass *klass)
                   0,
                   NULL, NULL, NULL,
                   G_TYPE_NONE, 0);
+
+  /**
+   * MetaBackgroundImage::scaled-texture-ready:
+   *
+   * Emitted when a scaled texture requested with
+   * meta_background_image_request_scaled() after the image was loaded
+   * becomes available.
+   */
+  signals[SCALED_TEXTURE_READY] =
+    g_signal_new ("scaled-texture-ready",
+                  G_TYPE_FROM_CLASS (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
 }
 
 /**
@@ -350,7 +1079,7 @@ meta_background_image_get_success (MetaBackgroundImage *image)
 {
   g_return_val_if_fail (META_IS_BACKGROUND_IMAGE (image), FALSE);
 
-  return image->texture != NULL;
+  return meta_background_image_get_texture (image) != NULL;
 }
 
 /**
@@ -365,5 +1094,143 @@ meta_background_image_get_texture (MetaBackgroundImage *image)
 {
   g_return_val_if_fail (META_IS_BACKGROUND_IMAGE (image), NULL);
 
-  return image->texture;
+  if (!image->loaded || !image->content)
+    return NULL;
+
+  return image->content->texture;
+}
+
+/**
+ * meta_background_image_request_scaled:
+ * @image: a #MetaBackgroundImage
+ * @target_width: width of the area the image will be drawn into
+ * @target_height: height of the area the image will be drawn into
+ *
+ * Asks for a scaled down copy of the image, suitable for drawing it into
+ * an area of the given size, to be created. When requested before the
+ * image is loaded, the image is scaled right after being decoded;
+ * otherwise MetaBackgroundImage::scaled-texture-ready is emitted once the
+ * scaled texture is ready. Each request must be balanced by a call to
+ * meta_background_image_release_scaled().
+ */
+void
+meta_background_image_request_scaled (MetaBackgroundImage *image,
+                                      int                  target_width,
+                                      int                  target_height)
+{
+  MetaBackgroundImageSize new_size;
+  int i;
+
+  g_return_if_fail (META_IS_BACKGROUND_IMAGE (image));
+  g_return_if_fail (target_width > 0 && target_height > 0);
+
+  g_mutex_lock (&image->scaled_sizes_lock);
+
+  for (i = 0; i < image->scaled_sizes->len; i++)
+    {
+      MetaBackgroundImageSize *size =
+        &g_array_index (image->scaled_sizes, MetaBackgroundImageSize, i);
+
+      if (size->width == target_width && size->height == target_height)
+        {
+          size->ref_count++;
+          g_mutex_unlock (&image->scaled_sizes_lock);
+          return;
+        }
+    }
+
+  new_size.width = target_width;
+  new_size.height = target_height;
+  new_size.ref_count = 1;
+  g_array_append_val (image->scaled_sizes, new_size);
+
+  g_mutex_unlock (&image->scaled_sizes_lock);
+
+  if (image->content)
+    {
+      meta_background_image_content_ref_scaled (image->content,
+                                                target_width, target_height,
+                                                NULL);
+    }
+}
+
+/**
+ * meta_background_image_release_scaled:
+ * @image: a #MetaBackgroundImage
+ * @target_width: width passed to meta_background_image_request_scaled()
+ * @target_height: height passed to meta_background_image_request_scaled()
+ *
+ * Releases a request made with meta_background_image_request_scaled().
+ */
+void
+meta_background_image_release_scaled (MetaBackgroundImage *image,
+                                      int                  target_width,
+                                      int                  target_height)
+{
+  gboolean released = FALSE;
+  int i;
+
+  g_return_if_fail (META_IS_BACKGROUND_IMAGE (image));
+
+  g_mutex_lock (&image->scaled_sizes_lock);
+
+  for (i = 0; i < image->scaled_sizes->len; i++)
+    {
+      MetaBackgroundImageSize *size =
+        &g_array_index (image->scaled_sizes, MetaBackgroundImageSize, i);
+
+      if (size->width != target_width || size->height != target_height)
+        continue;
+
+      if (--size->ref_count == 0)
+        {
+          g_array_remove_index_fast (image->scaled_sizes, i);
+          released = TRUE;
+        }
+
+      g_mutex_unlock (&image->scaled_sizes_lock);
+
+      if (released && image->content)
+        {
+          meta_background_image_content_unref_scaled (image->content,
+                                                      target_width,
+                                                      target_height);
+        }
+
+      return;
+    }
+
+  g_mutex_unlock (&image->scaled_sizes_lock);
+
+  g_warn_if_reached ();
+}
+
+/**
+ * meta_background_image_get_scaled_texture:
+ * @image: a #MetaBackgroundImage
+ * @target_width: width passed to meta_background_image_request_scaled()
+ * @target_height: height passed to meta_background_image_request_scaled()
+ *
+ * Return value: (transfer none): the scaled texture for drawing the image
+ *  into an area of the given size, or %NULL if it isn't ready yet or if
+ *  the full size texture should be used.
+ */
+CoglTexture *
+meta_background_image_get_scaled_texture (MetaBackgroundImage *image,
+                                          int                  target_width,
+                                          int                  target_height)
+{
+  MetaBackgroundScaledImage *scaled_image;
+
+  g_return_val_if_fail (META_IS_BACKGROUND_IMAGE (image), NULL);
+
+  if (!image->content)
+    return NULL;
+
+  scaled_image = find_scaled_image (image->content,
+                                    target_width, target_height);
+  if (!scaled_image)
+    return NULL;
+
+  return scaled_image->texture;
 }
@@ -25,6 +25,7 @@
 
 #include "backends/meta-backend-private.h"
 #include "compositor/cogl-utils.h"
+#include "compositor/meta-background-image-private.h"
 #include "meta/display.h"
 #include "meta/meta-background-image.h"
 #include "meta/meta-background.h"
@@ -46,6 +47,11 @@ struct _MetaBackgroundMonitor
   gboolean dirty;
   CoglTexture *texture;
   CoglFramebuffer *fbo;
+
+  /* Size the images are scaled to for this monitor, or 0 if the style
+   * draws them at their own size */
+  int scaled_width;
+  int scaled_height;
 };
 
 struct _MetaBackground
@@ -83,6 +89,7 @@ enum
 G_DEFINE_TYPE (MetaBackground, meta_background, G_TYPE_OBJECT)
 
 static gboolean texture_has_alpha (CoglTexture *texture);
+static void update_scaled_images (MetaBackground *self);
 
 static GSList *all_backgrounds = NULL;
 
@@ -114,9 +121,52 @@ free_wallpaper_texture (MetaBackground *self)
   self->wallpaper_allocation_failed = FALSE;
 }
 
+static void
+request_scaled_images (MetaBackground      *self,
+                       MetaBackgroundImage *image)
+{
+  int i;
+
+  if (!image)
+    return;
+
+  for (i = 0; i < self->n_monitors; i++)
+    {
+      MetaBackgroundMonitor *monitor = &self->monitors[i];
+
+      if (monitor->scaled_width > 0)
+        meta_background_image_request_scaled (image,
+                                              monitor->scaled_width,
+                                              monitor->scaled_height);
+    }
+}
+
+static void
+release_scaled_images (MetaBackground      *self,
+                       MetaBackgroundImage *image)
+{
+  int i;
+
+  if (!image)
+    return;
+
+  for (i = 0; i < self->n_monitors; i++)
+    {
+      MetaBackgroundMonitor *monitor = &self->monitors[i];
+
+      if (monitor->scaled_width > 0)
+        meta_background_image_release_scaled (image,
+                                              monitor->scaled_width,
+                                              monitor->scaled_height);
+    }
+}
+
 static void
 invalidate_monitor_backgrounds (MetaBackground *self)
 {
+  release_scaled_images (self, self->background_image1);
+  release_scaled_images (self, self->background_image2);
+
   free_fbos (self);
   g_clear_pointer (&self->monitors, g_free);
   self->n_monitors = 0;
@@ -130,6 +180,8 @@ invalidate_monitor_backgrounds (MetaBackground *self)
 
       for (i = 0; i < self->n_monitors; i++)
         self->monitors[i].dirty = TRUE;
+
+      update_scaled_images (self);
     }
 }
 
@@ -220,6 +272,13 @@ on_background_loaded (MetaBackgroundImage *image,
   mark_changed (self);
 }
 
+static void
+on_scaled_texture_ready (MetaBackgroundImage *image,
+                         MetaBackground      *self)
+{
+  mark_changed (self);
+}
+
 static gboolean
 file_equal0 (GFile *file1,
              GFile *file2)
@@ -247,6 +306,10 @@ set_file (MetaBackground       *self,
           g_signal_handlers_disconnect_by_func (*imagep,
                                                 (gpointer)on_background_loaded,
                                                 self);
+          g_signal_handlers_disconnect_by_func (*imagep,
+                                                (gpointer)on_scaled_texture_ready,
+                                                self);
+          release_scaled_images (self, *imagep);
           g_clear_object (imagep);
         }
 
@@ -259,6 +322,9 @@ set_file (MetaBackground       *self,
           *imagep = meta_background_image_cache_load (cache, file);
           g_signal_connect (*imagep, "loaded",
                             G_CALLBACK (on_background_loaded), self);
+          g_signal_connect (*imagep, "scaled-texture-ready",
+                            G_CALLBACK (on_scaled_texture_ready), self);
+          request_scaled_images (self, *imagep);
         }
     }
 }
@@ -377,6 +443,110 @@ set_texture_area_from_monitor_area (cairo_rectangle_int_t *monitor_area,
   texture_area->height = monitor_area->height;
 }
 
+static void
+get_monitor_texture_size (MetaBackground *self,
+                          int             monitor_index,
+                          int            *texture_width,
+                          int            *texture_height)
+{
+  MetaRectangle geometry;
+  float monitor_scale;
+
+  meta_display_get_monitor_geometry (self->display, monitor_index, &geometry);
+  monitor_scale = meta_display_get_monitor_scale (self->display, monitor_index);
+
+  if (meta_is_stage_views_scaled ())
+    {
+      *texture_width = geometry.width * monitor_scale;
+      *texture_height = geometry.height * monitor_scale;
+    }
+  else
+    {
+      *texture_width = geometry.width;
+      *texture_height = geometry.height;
+    }
+}
+
+/* Gets the size in pixels of the area the images are drawn into on the
+ * monitor texture, for the styles that scale them */
+static gboolean
+get_scaled_image_size (MetaBackground *self,
+                       int             monitor_index,
+                       int            *width,
+                       int            *height)
+{
+  MetaRectangle geometry;
+  int texture_width, texture_height;
+  int screen_width, screen_height;
+
+  get_monitor_texture_size (self, monitor_index,
+                            &texture_width, &texture_height);
+
+  switch (self->style)
+    {
+    case G_DESKTOP_BACKGROUND_STYLE_STRETCHED:
+    case G_DESKTOP_BACKGROUND_STYLE_SCALED:
+    case G_DESKTOP_BACKGROUND_STYLE_ZOOM:
+      *width = texture_width;
+      *height = texture_height;
+      return TRUE;
+    case G_DESKTOP_BACKGROUND_STYLE_SPANNED:
+      meta_display_get_monitor_geometry (self->display, monitor_index,
+                                         &geometry);
+      meta_display_get_size (self->display, &screen_width, &screen_height);
+
+      *width = (int64_t) screen_width * texture_width / geometry.width;
+      *height = (int64_t) screen_height * texture_height / geometry.height;
+      return TRUE;
+    case G_DESKTOP_BACKGROUND_STYLE_NONE:
+    case G_DESKTOP_BACKGROUND_STYLE_WALLPAPER:
+    case G_DESKTOP_BACKGROUND_STYLE_CENTERED:
+    default:
+      return FALSE;
+    }
+}
+
+static void
+update_scaled_images (MetaBackground *self)
+{
+  int i;
+
+  release_scaled_images (self, self->background_image1);
+  release_scaled_images (self, self->background_image2);
+
+  for (i = 0; i < self->n_monitors; i++)
+    {
+      MetaBackgroundMonitor *monitor = &self->monitors[i];
+
+      if (!get_scaled_image_size (self, i,
+                                  &monitor->scaled_width,
+                                  &monitor->scaled_height))
+        {
+          monitor->scaled_width = 0;
+          monitor->scaled_height = 0;
+        }
+    }
+
+  request_scaled_images (self, self->background_image1);
+  request_scaled_images (self, self->background_image2);
+}
+
+/* Picks the texture to draw @image with into the texture of @monitor */
+static CoglTexture *
+get_image_texture (MetaBackgroundMonitor *monitor,
+                   MetaBackgroundImage   *image,
+                   CoglTexture           *texture)
+{
+  CoglTexture *scaled_texture = NULL;
+
+  if (monitor->scaled_width > 0)
+    scaled_texture = meta_background_image_get_scaled_texture (image,
+                                                               monitor->scaled_width,
+                                                               monitor->scaled_height);
+
+  return scaled_texture ? scaled_texture : texture;
+}
+
 static void
 get_texture_area (MetaBackground          *self,
                   cairo_rectangle_int_t   *monitor_rect,
@@ -803,16 +973,8 @@ meta_background_get_texture (MetaBackground         *self,
       gboolean bare_region_visible = FALSE;
       int texture_width, texture_height;
 
-      if (meta_is_stage_views_scaled ())
-        {
-          texture_width = monitor_area.width * monitor_scale;
-          texture_height = monitor_area.height * monitor_scale;
-        }
-      else
-        {
-          texture_width = monitor_area.width;
-          texture_height = monitor_area.height;
-        }
+      get_monitor_texture_size (self, monitor_index,
+                                &texture_width, &texture_height);
 
       if (monitor->texture == NULL)
         {
@@ -855,6 +1017,9 @@ meta_background_get_texture (MetaBackground         *self,
           CoglPipeline *pipeline = create_pipeline (PIPELINE_REPLACE);
           int mipmap_level;
 
+          texture2 = get_image_texture (monitor, self->background_image2,
+                                        texture2);
+
           mipmap_level = get_best_mipmap_level (texture2,
                                                 texture_width,
                                                 texture_height);
@@ -884,6 +1049,9 @@ meta_background_get_texture (MetaBackground         *self,
           CoglPipeline *pipeline = create_pipeline (PIPELINE_ADD);
           int mipmap_level;
 
+          texture1 = get_image_texture (monitor, self->background_image1,
+                                        texture1);
+
           mipmap_level = get_best_mipmap_level (texture1,
                                                 texture_width,
                                                 texture_height);
@@ -1004,6 +1172,8 @@ meta_background_set_blend (MetaBackground          *self,
   self->blend_factor = blend_factor;
   self->style = style;
 
+  update_scaled_images (self);
+
   free_wallpaper_texture (self);
   mark_changed (self);
 }
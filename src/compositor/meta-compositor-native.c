@@ -23,14 +23,24 @@
 #include "compositor/meta-compositor-native.h"
 
 #include "backends/meta-logical-monitor.h"
+#include "backends/meta-settings-private.h"
+#include "backends/meta-stage-private.h"
 #include "backends/native/meta-crtc-kms.h"
+#include "backends/native/meta-drm-buffer.h"
+#include "backends/native/meta-onscreen-native.h"
+#include "clutter/clutter-mutter.h"
+#include "compositor/clutter-utils.h"
+#include "compositor/meta-shaped-texture-private.h"
 #include "compositor/meta-surface-actor-wayland.h"
+#include "compositor/meta-window-actor-private.h"
 
 struct _MetaCompositorNative
 {
   MetaCompositorServer parent;
 
   MetaWaylandSurface *current_scanout_candidate;
+
+  MetaRendererView *vrr_view;
 };
 
 G_DEFINE_TYPE (MetaCompositorNative, meta_compositor_native,
@@ -64,6 +74,33 @@ get_window_view (MetaRenderer *renderer,
   return view_found;
 }
 
+static gboolean
+should_enable_vrr (MetaBackend *backend,
+                   MetaCrtc    *crtc)
+{
+  MetaSettings *settings = meta_backend_get_settings (backend);
+
+  if (!meta_settings_is_experimental_feature_enabled (
+        settings, META_EXPERIMENTAL_FEATURE_VARIABLE_REFRESH_RATE))
+    return FALSE;
+
+  return meta_crtc_kms_supports_vrr (META_CRTC_KMS (crtc));
+}
+
+static void
+set_view_vrr_enabled (MetaRendererView *view,
+                      gboolean          enabled)
+{
+  MetaCrtc *crtc = meta_renderer_view_get_crtc (view);
+  ClutterFrameClock *frame_clock =
+    clutter_stage_view_get_frame_clock (CLUTTER_STAGE_VIEW (view));
+
+  meta_crtc_kms_set_vrr_enabled (META_CRTC_KMS (crtc), enabled);
+  clutter_frame_clock_set_mode (frame_clock,
+                                enabled ? CLUTTER_FRAME_CLOCK_MODE_VARIABLE
+                                        : CLUTTER_FRAME_CLOCK_MODE_FIXED);
+}
+
 static void
 maybe_assign_primary_plane (MetaCompositor *compositor)
 {
@@ -83,6 +120,7 @@ maybe_assign_primary_plane (MetaCompositor *compositor)
   MetaWaylandSurface *old_candidate =
     compositor_native->current_scanout_candidate;
   MetaWaylandSurface *new_candidate = NULL;
+  MetaRendererView *new_vrr_view = NULL;
   g_autoptr (CoglScanout) scanout = NULL;
 
   if (meta_compositor_is_unredirect_inhibited (compositor))
@@ -138,8 +176,26 @@ maybe_assign_primary_plane (MetaCompositor *compositor)
 
   clutter_stage_view_assign_next_scanout (CLUTTER_STAGE_VIEW (view), scanout);
 
+  /*
+   * With the client scanned out directly, its commits translate one to one
+   * into page flips; let the display refresh whenever the client has a new
+   * frame ready, instead of holding it back until the next vblank.
+   */
+  if (should_enable_vrr (backend, crtc))
+    new_vrr_view = view;
+
 done:
 
+  if (compositor_native->vrr_view != new_vrr_view)
+    {
+      if (compositor_native->vrr_view)
+        set_view_vrr_enabled (compositor_native->vrr_view, FALSE);
+      if (new_vrr_view)
+        set_view_vrr_enabled (new_vrr_view, TRUE);
+
+      g_set_weak_pointer (&compositor_native->vrr_view, new_vrr_view);
+    }
+
   if (old_candidate && old_candidate != new_candidate)
     {
       meta_wayland_surface_set_scanout_candidate (old_candidate, NULL);
@@ -153,6 +209,308 @@ done:
                           surface);
     }
 }
+
+static gboolean
+get_untransformed_stage_rect (ClutterActor  *actor,
+                              MetaRectangle *rect)
+{
+  graphene_point3d_t verts[4];
+  int x, y;
+
+  clutter_actor_get_abs_allocation_vertices (actor, verts);
+  if (!meta_actor_vertices_are_untransformed (verts,
+                                              verts[1].x - verts[0].x,
+                                              verts[2].y - verts[0].y,
+                                              &x, &y))
+    return FALSE;
+
+  *rect = (MetaRectangle) {
+    .x = x,
+    .y = y,
+    .width = roundf (verts[1].x - verts[0].x),
+    .height = roundf (verts[2].y - verts[0].y),
+  };
+
+  return rect->width > 0 && rect->height > 0;
+}
+
+static gboolean
+actor_overlaps (ClutterActor          *actor,
+                const graphene_rect_t *rect)
+{
+  ClutterActorBox paint_box;
+  graphene_rect_t paint_rect;
+
+  if (!clutter_actor_is_mapped (actor))
+    return FALSE;
+
+  /* Without a paint box, the actor could be painting anywhere */
+  if (!clutter_actor_get_paint_box (actor, &paint_box))
+    return TRUE;
+
+  graphene_rect_init (&paint_rect,
+                      paint_box.x1, paint_box.y1,
+                      paint_box.x2 - paint_box.x1,
+                      paint_box.y2 - paint_box.y1);
+
+  return graphene_rect_intersection (&paint_rect, rect, NULL);
+}
+
+static gboolean
+is_actor_occluded (ClutterActor          *actor,
+                   const graphene_rect_t *rect)
+{
+  ClutterActor *child;
+  ClutterActor *parent;
+
+  for (child = clutter_actor_get_first_child (actor);
+       child;
+       child = clutter_actor_get_next_sibling (child))
+    {
+      if (actor_overlaps (child, rect))
+        return TRUE;
+    }
+
+  /* Anything painted after the actor and intersecting with it would end up
+   * below the overlay plane. */
+  for (parent = clutter_actor_get_parent (actor);
+       parent;
+       actor = parent, parent = clutter_actor_get_parent (parent))
+    {
+      ClutterActor *sibling;
+
+      for (sibling = clutter_actor_get_next_sibling (actor);
+           sibling;
+           sibling = clutter_actor_get_next_sibling (sibling))
+        {
+          if (actor_overlaps (sibling, rect))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static gboolean
+is_overlay_candidate (MetaCompositor   *compositor,
+                      MetaWindowActor  *window_actor,
+                      MetaSurfaceActor *surface_actor,
+                      ClutterStageView *stage_view,
+                      MetaRectangle    *crtc_rect)
+{
+  ClutterActor *actor = CLUTTER_ACTOR (surface_actor);
+  ClutterStage *stage = meta_compositor_get_stage (compositor);
+  MetaShapedTexture *stex = meta_surface_actor_get_texture (surface_actor);
+  MetaWaylandSurface *surface;
+  MetaRectangle view_layout;
+  float view_scale;
+  MetaRectangle stage_rect;
+  graphene_rect_t stage_graphene_rect;
+  float crtc_x, crtc_y;
+
+  if (!clutter_actor_is_mapped (actor))
+    return FALSE;
+
+  if (meta_window_actor_effect_in_progress (window_actor))
+    return FALSE;
+
+  if (clutter_actor_has_transitions (CLUTTER_ACTOR (window_actor)))
+    return FALSE;
+
+  if (clutter_actor_get_paint_opacity (actor) != 0xff)
+    return FALSE;
+
+  if (!meta_shaped_texture_is_opaque (stex))
+    return FALSE;
+
+  surface =
+    meta_surface_actor_wayland_get_surface (META_SURFACE_ACTOR_WAYLAND (actor));
+  if (!surface || !meta_wayland_surface_get_buffer (surface))
+    return FALSE;
+
+  if (!get_untransformed_stage_rect (actor, &stage_rect))
+    return FALSE;
+
+  clutter_stage_view_get_layout (stage_view, &view_layout);
+  if (!meta_rectangle_contains_rect (&view_layout, &stage_rect))
+    return FALSE;
+
+  view_scale = clutter_stage_view_get_scale (stage_view);
+  crtc_x = (stage_rect.x - view_layout.x) * view_scale;
+  crtc_y = (stage_rect.y - view_layout.y) * view_scale;
+  if (crtc_x != floorf (crtc_x) || crtc_y != floorf (crtc_y))
+    return FALSE;
+
+  *crtc_rect = (MetaRectangle) {
+    .x = crtc_x,
+    .y = crtc_y,
+    .width = roundf (stage_rect.width * view_scale),
+    .height = roundf (stage_rect.height * view_scale),
+  };
+  if (!meta_wayland_surface_can_scanout_unscaled (surface,
+                                                  crtc_rect->width,
+                                                  crtc_rect->height))
+    return FALSE;
+
+  stage_graphene_rect = meta_rectangle_to_graphene_rect (&stage_rect);
+  if (is_actor_occluded (actor, &stage_graphene_rect))
+    return FALSE;
+
+  if (meta_stage_overlays_intersect (META_STAGE (stage), &stage_graphene_rect))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+try_assign_overlay_plane (MetaSurfaceActor    *surface_actor,
+                          CoglOnscreen        *onscreen,
+                          const MetaRectangle *crtc_rect)
+{
+  MetaWaylandSurface *surface;
+  g_autoptr (CoglScanout) scanout = NULL;
+
+  surface =
+    meta_surface_actor_wayland_get_surface (META_SURFACE_ACTOR_WAYLAND (surface_actor));
+
+  scanout = meta_wayland_surface_try_acquire_scanout (surface, NULL);
+  if (!scanout)
+    return FALSE;
+
+  return meta_onscreen_native_assign_overlay (onscreen,
+                                              META_DRM_BUFFER (scanout),
+                                              crtc_rect);
+}
+
+static void
+update_overlay_candidate (MetaSurfaceActor *surface_actor,
+                          MetaCrtc         *crtc,
+                          gboolean          is_candidate)
+{
+  MetaWaylandSurface *surface;
+
+  surface =
+    meta_surface_actor_wayland_get_surface (META_SURFACE_ACTOR_WAYLAND (surface_actor));
+  if (!surface)
+    return;
+
+  if (is_candidate)
+    meta_wayland_surface_set_overlay_candidate (surface, crtc);
+  else if (meta_wayland_surface_get_overlay_candidate (surface) == crtc)
+    meta_wayland_surface_set_overlay_candidate (surface, NULL);
+}
+
+static void
+update_overlay_view (MetaSurfaceActor *surface_actor,
+                     ClutterStageView *stage_view,
+                     gboolean          assigned)
+{
+  ClutterActor *actor = CLUTTER_ACTOR (surface_actor);
+  MetaShapedTexture *stex = meta_surface_actor_get_texture (surface_actor);
+  ClutterStageView *overlay_view = meta_shaped_texture_get_overlay_view (stex);
+  ClutterActorBox paint_box;
+
+  if (assigned)
+    {
+      meta_shaped_texture_set_overlay_view (stex, stage_view);
+      return;
+    }
+
+  if (overlay_view != stage_view)
+    return;
+
+  meta_shaped_texture_set_overlay_view (stex, NULL);
+
+  /* The primary plane has not been painted with the surface content while
+   * it was on an overlay plane; make sure it is in the frame about to be
+   * painted. */
+  if (clutter_actor_get_paint_box (actor, &paint_box))
+    {
+      cairo_rectangle_int_t clip;
+
+      clip = (cairo_rectangle_int_t) {
+        .x = floorf (paint_box.x1),
+        .y = floorf (paint_box.y1),
+        .width = ceilf (paint_box.x2) - floorf (paint_box.x1),
+        .height = ceilf (paint_box.y2) - floorf (paint_box.y1),
+      };
+      clutter_stage_view_add_redraw_clip (stage_view, &clip);
+    }
+  else
+    {
+      clutter_stage_view_add_redraw_clip (stage_view, NULL);
+    }
+}
+
+static void
+maybe_assign_overlay_planes (MetaCompositor   *compositor,
+                             ClutterStageView *stage_view)
+{
+  MetaBackend *backend = meta_get_backend ();
+  MetaSettings *settings = meta_backend_get_settings (backend);
+  MetaDisplay *display = meta_compositor_get_display (compositor);
+  CoglFramebuffer *framebuffer;
+  CoglOnscreen *onscreen = NULL;
+  MetaCrtc *crtc;
+  GList *l;
+
+  crtc = meta_renderer_view_get_crtc (META_RENDERER_VIEW (stage_view));
+  framebuffer = clutter_stage_view_get_onscreen (stage_view);
+  if (META_IS_ONSCREEN_NATIVE (framebuffer))
+    {
+      onscreen = COGL_ONSCREEN (framebuffer);
+      meta_onscreen_native_reset_overlays (onscreen);
+    }
+
+  if (!onscreen ||
+      !meta_settings_is_experimental_feature_enabled (
+        settings, META_EXPERIMENTAL_FEATURE_OVERLAY_PLANES) ||
+      meta_compositor_is_unredirect_inhibited (compositor) ||
+      clutter_stage_view_peek_scanout (stage_view) ||
+      clutter_stage_view_get_framebuffer (stage_view) != framebuffer ||
+      meta_renderer_view_get_transform (META_RENDERER_VIEW (stage_view)) !=
+      META_MONITOR_TRANSFORM_NORMAL)
+    onscreen = NULL;
+
+  for (l = meta_get_window_actors (display); l; l = l->next)
+    {
+      MetaWindowActor *window_actor = l->data;
+      ClutterActor *child;
+
+      for (child = clutter_actor_get_first_child (CLUTTER_ACTOR (window_actor));
+           child;
+           child = clutter_actor_get_next_sibling (child))
+        {
+          MetaSurfaceActor *surface_actor;
+          MetaRectangle crtc_rect;
+          gboolean is_candidate = FALSE;
+          gboolean assigned = FALSE;
+
+          if (!META_IS_SURFACE_ACTOR_WAYLAND (child))
+            continue;
+
+          surface_actor = META_SURFACE_ACTOR (child);
+          if (onscreen)
+            {
+              is_candidate = is_overlay_candidate (compositor,
+                                                   window_actor,
+                                                   surface_actor,
+                                                   stage_view,
+                                                   &crtc_rect);
+            }
+
+          if (is_candidate)
+            {
+              assigned = try_assign_overlay_plane (surface_actor,
+                                                   onscreen,
+                                                   &crtc_rect);
+            }
+
+          update_overlay_view (surface_actor, stage_view, assigned);
+          update_overlay_candidate (surface_actor, crtc, is_candidate);
+        }
+    }
+}
 #endif /* HAVE_WAYLAND */
 
 static void
@@ -163,6 +521,7 @@ meta_compositor_native_before_paint (MetaCompositor   *compositor,
 
 #ifdef HAVE_WAYLAND
   maybe_assign_primary_plane (compositor);
+  maybe_assign_overlay_planes (compositor, stage_view);
 #endif
 
   parent_class = META_COMPOSITOR_CLASS (meta_compositor_native_parent_class);
@@ -185,6 +544,7 @@ meta_compositor_native_finalize (GObject *object)
   MetaCompositorNative *compositor_native = META_COMPOSITOR_NATIVE (object);
 
   g_clear_weak_pointer (&compositor_native->current_scanout_candidate);
+  g_clear_weak_pointer (&compositor_native->vrr_view);
 
   G_OBJECT_CLASS (meta_compositor_native_parent_class)->finalize (object);
 }
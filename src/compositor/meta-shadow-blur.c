@@ -0,0 +1,777 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright 2010, 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "compositor/meta-shadow-blur.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "compositor/region-utils.h"
+#include "core/meta-parallel.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_INTRINSICS 1
+#include <immintrin.h>
+#endif
+
+#define MIN_PIXELS_PER_JOB (256 * 1024)
+
+/* Number of adjacent columns blurred together; one SSE2 register */
+#define COLUMN_BATCH_SIZE 16
+
+/* The vectorized kernel keeps the sliding sums in 16 bit lanes, so the
+ * filter width is limited to what fits; 255 * 256 + 128 < 65536.
+ */
+#define MAX_SIMD_FILTER_SIZE 256
+
+typedef void (* BlurColumnBatchFunc) (uint8_t *buffer,
+                                      int      stride,
+                                      int      height,
+                                      int      x,
+                                      int      n_columns,
+                                      int      y0,
+                                      int      y1,
+                                      int      d,
+                                      int      shift,
+                                      uint8_t *tmp_buffer);
+
+typedef struct _BlurJob
+{
+  MetaShadowBlur *blur;
+
+  uint8_t *buffer;
+  int stride;
+  int height;
+  int d;
+
+  int x0;
+  int x1;
+  int y0;
+  int y1;
+} BlurJob;
+
+struct _MetaShadowBlur
+{
+  MetaShadowBlurFlags flags;
+
+  BlurColumnBatchFunc blur_column_batch;
+  const char *impl_name;
+};
+
+/* We emulate a 1D Gaussian blur by using 3 consecutive box blurs;
+ * this produces a result that's within 3% of the original and can be
+ * implemented much faster for large filter sizes because of the
+ * efficiency of implementation of a box blur. Idea and formula
+ * for choosing the box blur size come from:
+ *
+ * http://www.w3.org/TR/SVG/filters.html#feGaussianBlurElement
+ *
+ * The 2D blur is then done by blurring the columns, flipping the
+ * image and blurring the columns again. (This is possible because the
+ * Gaussian kernel is separable - it's the product of a horizontal
+ * blur and a vertical blur.) Blurring columns rather than rows lets
+ * us run the sliding window over many adjacent columns at once, which
+ * keeps memory access linear and maps well onto SIMD registers.
+ */
+static int
+get_box_filter_size (int radius)
+{
+  return (int)(0.5 + radius * (0.75 * sqrt(2*M_PI)));
+}
+
+/* The "spread" of the filter is the number of pixels from an original
+ * pixel that it's blurred image extends. (A no-op blur that doesn't
+ * blur would have a spread of 0.) See comment in blur_rows() for why the
+ * odd and even cases are different
+ */
+int
+meta_shadow_blur_get_spread (int radius)
+{
+  int d;
+
+  if (radius == 0)
+    return 0;
+
+  d = get_box_filter_size (radius);
+
+  if (d % 2 == 1)
+    return 3 * (d / 2);
+  else
+    return 3 * (d / 2) - 1;
+}
+
+/* This applies a single box blur pass to a horizontal range of pixels;
+ * since the box blur has the same weight for all pixels, we can
+ * implement an efficient sliding window algorithm where we add
+ * in pixels coming into the window from the right and remove
+ * them when they leave the windw to the left.
+ *
+ * d is the filter width; for even d shift indicates how the blurred
+ * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
+ * or 'yy ' (shift=-1)
+ */
+static void
+blur_xspan (guchar *row,
+            guchar *tmp_buffer,
+            int     row_width,
+            int     x0,
+            int     x1,
+            int     d,
+            int     shift)
+{
+  int offset;
+  int sum = 0;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  /* All the conditionals in here look slow, but the branches will
+   * be well predicted and there are enough different possibilities
+   * that trying to write this as a series of unconditional loops
+   * is hard and not an obvious win. The main slow down here seems
+   * to be the integer division per pixel; one possible optimization
+   * would be to accumulate into two 16-bit integer buffers and
+   * only divide down after all three passes. (SSE parallel implementation
+   * of the divide step is possible.)
+   */
+  for (i = x0 - d + offset; i < x1 + offset; i++)
+    {
+      if (i >= 0 && i < row_width)
+        sum += row[i];
+
+      if (i >= x0 + offset)
+        {
+          if (i >= d)
+            sum -= row[i - d];
+
+          tmp_buffer[i - offset] = (sum + d / 2) / d;
+        }
+    }
+
+  memcpy (row + x0, tmp_buffer + x0, x1 - x0);
+}
+
+static void
+blur_rows (cairo_region_t   *convolve_region,
+           int               x_offset,
+           int               y_offset,
+           guchar           *buffer,
+           int               buffer_width,
+           int               buffer_height,
+           int               d)
+{
+  int i, j;
+  int n_rectangles;
+  guchar *tmp_buffer;
+
+  tmp_buffer = g_malloc (buffer_width);
+
+  n_rectangles = cairo_region_num_rectangles (convolve_region);
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (convolve_region, i, &rect);
+
+      for (j = y_offset + rect.y; j < y_offset + rect.y + rect.height; j++)
+        {
+          guchar *row = buffer + j * buffer_width;
+          int x0 = x_offset + rect.x;
+          int x1 = x0 + rect.width;
+
+          /* We want to produce a symmetric blur that spreads a pixel
+           * equally far to the left and right. If d is odd that happens
+           * naturally, but for d even, we approximate by using a blur
+           * on either side and then a centered blur of size d + 1.
+           * (technique also from the SVG specification)
+           */
+          if (d % 2 == 1)
+            {
+              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 0);
+              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 0);
+              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 0);
+            }
+          else
+            {
+              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 1);
+              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, -1);
+              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d + 1, 0);
+            }
+        }
+    }
+
+  g_free (tmp_buffer);
+}
+
+
+/* Swaps width and height. Either swaps in-place and returns the original
+ * buffer or allocates a new buffer, frees the original buffer and returns
+ * the new buffer.
+ */
+static guchar *
+flip_buffer (guchar *buffer,
+             int     width,
+             int     height)
+{
+  /* Working in blocks increases cache efficiency, compared to reading
+   * or writing an entire column at once */
+#define BLOCK_SIZE 16
+
+  if (width == height)
+    {
+      int i0, j0;
+
+      for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
+        for (i0 = 0; i0 <= j0; i0 += BLOCK_SIZE)
+          {
+            int max_j = MIN(j0 + BLOCK_SIZE, height);
+            int max_i = MIN(i0 + BLOCK_SIZE, width);
+            int i, j;
+
+            if (i0 == j0)
+              {
+                for (j = j0; j < max_j; j++)
+                  for (i = i0; i < j; i++)
+                    {
+                      guchar tmp = buffer[j * width + i];
+                      buffer[j * width + i] = buffer[i * width + j];
+                      buffer[i * width + j] = tmp;
+                    }
+              }
+            else
+              {
+                for (j = j0; j < max_j; j++)
+                  for (i = i0; i < max_i; i++)
+                    {
+                      guchar tmp = buffer[j * width + i];
+                      buffer[j * width + i] = buffer[i * width + j];
+                      buffer[i * width + j] = tmp;
+                    }
+              }
+          }
+
+      return buffer;
+    }
+  else
+    {
+      guchar *new_buffer = g_malloc (height * width);
+      int i0, j0;
+
+      for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
+        for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
+          {
+            int max_j = MIN(j0 + BLOCK_SIZE, height);
+            int max_i = MIN(i0 + BLOCK_SIZE, width);
+            int i, j;
+
+            for (i = i0; i < max_i; i++)
+              for (j = j0; j < max_j; j++)
+                new_buffer[i * height + j] = buffer[j * width + i];
+          }
+
+      g_free (buffer);
+
+      return new_buffer;
+    }
+#undef BLOCK_SIZE
+}
+
+
+static void
+blur_column_batch_scalar (uint8_t *buffer,
+                          int      stride,
+                          int      height,
+                          int      x,
+                          int      n_columns,
+                          int      y0,
+                          int      y1,
+                          int      d,
+                          int      shift,
+                          uint8_t *tmp_buffer)
+{
+  int sums[COLUMN_BATCH_SIZE] = { 0 };
+  int offset;
+  int i, k;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = y0 - d + offset; i < y1 + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          const uint8_t *row = buffer + (size_t) i * stride + x;
+
+          for (k = 0; k < n_columns; k++)
+            sums[k] += row[k];
+        }
+
+      if (i >= y0 + offset)
+        {
+          uint8_t *out = tmp_buffer + (size_t) (i - offset) * COLUMN_BATCH_SIZE;
+
+          if (i >= d)
+            {
+              const uint8_t *row = buffer + (size_t) (i - d) * stride + x;
+
+              for (k = 0; k < n_columns; k++)
+                sums[k] -= row[k];
+            }
+
+          for (k = 0; k < n_columns; k++)
+            out[k] = (sums[k] + d / 2) / d;
+        }
+    }
+
+  for (i = y0; i < y1; i++)
+    {
+      memcpy (buffer + (size_t) i * stride + x,
+              tmp_buffer + (size_t) i * COLUMN_BATCH_SIZE,
+              n_columns);
+    }
+}
+
+#ifdef HAVE_X86_INTRINSICS
+/* Unsigned 16 bit division by an invariant d >= 2, as described in
+ * Granlund and Montgomery, "Division by Invariant Integers using
+ * Multiplication", figure 4.1. Exact for every 16 bit numerator.
+ */
+static void
+calculate_division_magic (int       d,
+                          uint16_t *multiplier,
+                          int      *post_shift)
+{
+  int l = g_bit_storage (d - 1);
+
+  *multiplier = (uint16_t) ((65536u * ((1u << l) - d)) / d + 1);
+  *post_shift = l - 1;
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+divide_epu16 (__m128i n,
+              __m128i multiplier,
+              __m128i post_shift)
+{
+  __m128i t = _mm_mulhi_epu16 (n, multiplier);
+  __m128i q = _mm_add_epi16 (t, _mm_srli_epi16 (_mm_sub_epi16 (n, t), 1));
+
+  return _mm_srl_epi16 (q, post_shift);
+}
+
+/* Same arithmetic as blur_column_batch_scalar(), for exactly
+ * COLUMN_BATCH_SIZE columns and 2 <= d <= MAX_SIMD_FILTER_SIZE.
+ */
+__attribute__ ((target ("sse2")))
+static void
+blur_column_batch_sse2 (uint8_t *buffer,
+                        int      stride,
+                        int      height,
+                        int      x,
+                        int      n_columns,
+                        int      y0,
+                        int      y1,
+                        int      d,
+                        int      shift,
+                        uint8_t *tmp_buffer)
+{
+  __m128i zero = _mm_setzero_si128 ();
+  __m128i sum_lo = zero;
+  __m128i sum_hi = zero;
+  __m128i rounding;
+  __m128i multiplier;
+  __m128i post_shift;
+  uint16_t magic_multiplier;
+  int magic_post_shift;
+  int offset;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  calculate_division_magic (d, &magic_multiplier, &magic_post_shift);
+  rounding = _mm_set1_epi16 ((short) (d / 2));
+  multiplier = _mm_set1_epi16 ((short) magic_multiplier);
+  post_shift = _mm_cvtsi32_si128 (magic_post_shift);
+
+  for (i = y0 - d + offset; i < y1 + offset; i++)
+    {
+      if (i >= 0 && i < height)
+        {
+          const uint8_t *row = buffer + (size_t) i * stride + x;
+          __m128i pixels = _mm_loadu_si128 ((const __m128i *) row);
+
+          sum_lo = _mm_add_epi16 (sum_lo, _mm_unpacklo_epi8 (pixels, zero));
+          sum_hi = _mm_add_epi16 (sum_hi, _mm_unpackhi_epi8 (pixels, zero));
+        }
+
+      if (i >= y0 + offset)
+        {
+          uint8_t *out = tmp_buffer + (size_t) (i - offset) * COLUMN_BATCH_SIZE;
+          __m128i q_lo;
+          __m128i q_hi;
+
+          if (i >= d)
+            {
+              const uint8_t *row = buffer + (size_t) (i - d) * stride + x;
+              __m128i pixels = _mm_loadu_si128 ((const __m128i *) row);
+
+              sum_lo = _mm_sub_epi16 (sum_lo, _mm_unpacklo_epi8 (pixels, zero));
+              sum_hi = _mm_sub_epi16 (sum_hi, _mm_unpackhi_epi8 (pixels, zero));
+            }
+
+          q_lo = divide_epu16 (_mm_add_epi16 (sum_lo, rounding),
+                               multiplier, post_shift);
+          q_hi = divide_epu16 (_mm_add_epi16 (sum_hi, rounding),
+                               multiplier, post_shift);
+          _mm_storeu_si128 ((__m128i *) out, _mm_packus_epi16 (q_lo, q_hi));
+        }
+    }
+
+  for (i = y0; i < y1; i++)
+    {
+      const uint8_t *in = tmp_buffer + (size_t) i * COLUMN_BATCH_SIZE;
+
+      _mm_storeu_si128 ((__m128i *) (buffer + (size_t) i * stride + x),
+                        _mm_loadu_si128 ((const __m128i *) in));
+    }
+}
+#endif /* HAVE_X86_INTRINSICS */
+
+static void
+blur_column_range (BlurJob *job)
+{
+  MetaShadowBlur *blur = job->blur;
+  g_autofree uint8_t *tmp_buffer = NULL;
+  int d = job->d;
+  int x;
+
+  tmp_buffer = g_malloc ((size_t) job->height * COLUMN_BATCH_SIZE);
+
+  for (x = job->x0; x < job->x1; x += COLUMN_BATCH_SIZE)
+    {
+      int n_columns = MIN (COLUMN_BATCH_SIZE, job->x1 - x);
+      BlurColumnBatchFunc blur_column_batch = blur_column_batch_scalar;
+
+      /* For even d the last pass is d + 1 wide, see blur_rows() */
+      if (n_columns == COLUMN_BATCH_SIZE &&
+          d >= 2 && d < MAX_SIMD_FILTER_SIZE)
+        blur_column_batch = blur->blur_column_batch;
+
+      if (d % 2 == 1)
+        {
+          blur_column_batch (job->buffer, job->stride, job->height,
+                             x, n_columns, job->y0, job->y1,
+                             d, 0, tmp_buffer);
+          blur_column_batch (job->buffer, job->stride, job->height,
+                             x, n_columns, job->y0, job->y1,
+                             d, 0, tmp_buffer);
+          blur_column_batch (job->buffer, job->stride, job->height,
+                             x, n_columns, job->y0, job->y1,
+                             d, 0, tmp_buffer);
+        }
+      else
+        {
+          blur_column_batch (job->buffer, job->stride, job->height,
+                             x, n_columns, job->y0, job->y1,
+                             d, 1, tmp_buffer);
+          blur_column_batch (job->buffer, job->stride, job->height,
+                             x, n_columns, job->y0, job->y1,
+                             d, -1, tmp_buffer);
+          blur_column_batch (job->buffer, job->stride, job->height,
+                             x, n_columns, job->y0, job->y1,
+                             d + 1, 0, tmp_buffer);
+        }
+    }
+}
+
+static void
+blur_column_batch_range (int      first,
+                         int      n_items,
+                         gpointer user_data)
+{
+  const BlurJob *template_job = user_data;
+  BlurJob job = *template_job;
+
+  job.x0 = template_job->x0 + first * COLUMN_BATCH_SIZE;
+  job.x1 = MIN (job.x0 + n_items * COLUMN_BATCH_SIZE, template_job->x1);
+
+  blur_column_range (&job);
+}
+
+static int
+calculate_n_jobs (MetaShadowBlur *blur,
+                  int             n_columns,
+                  int             n_rows)
+{
+  int n_batches;
+  size_t n_pixels;
+
+  if (blur->flags & META_SHADOW_BLUR_FLAG_NO_THREADS)
+    return 1;
+
+  n_batches = (n_columns + COLUMN_BATCH_SIZE - 1) / COLUMN_BATCH_SIZE;
+  n_pixels = (size_t) n_columns * n_rows;
+
+  return (int) CLAMP (n_pixels / MIN_PIXELS_PER_JOB,
+                      1, (size_t) MIN (meta_parallel_get_max_tasks (),
+                                       n_batches));
+}
+
+/* Columns never read from each other, so a rectangle can be split into
+ * column ranges that are blurred in parallel. Separate rectangles are
+ * still blurred one after the other: the sliding window may extend into
+ * a neighbouring rectangle, and the result must not depend on which one
+ * of them was blurred first.
+ */
+static void
+blur_columns_in_rect (MetaShadowBlur *blur,
+                      const BlurJob  *template_job)
+{
+  int n_batches;
+  int n_jobs;
+
+  n_jobs = calculate_n_jobs (blur,
+                             template_job->x1 - template_job->x0,
+                             template_job->y1 - template_job->y0);
+  n_batches = ((template_job->x1 - template_job->x0 + COLUMN_BATCH_SIZE - 1) /
+               COLUMN_BATCH_SIZE);
+
+  meta_parallel_for (n_batches, n_jobs,
+                     blur_column_batch_range,
+                     (gpointer) template_job);
+}
+
+/* The convolve region is in flipped coordinates, like what blur_rows()
+ * expects after flip_buffer(): rect.y runs along the buffer rows and
+ * rect.x along the columns.
+ */
+static void
+blur_columns (MetaShadowBlur *blur,
+              cairo_region_t *convolve_region,
+              int             column_offset,
+              int             row_offset,
+              uint8_t        *buffer,
+              int             buffer_width,
+              int             buffer_height,
+              int             d)
+{
+  int n_rectangles;
+  int i;
+
+  n_rectangles = cairo_region_num_rectangles (convolve_region);
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cairo_rectangle_int_t rect;
+      BlurJob job;
+
+      cairo_region_get_rectangle (convolve_region, i, &rect);
+
+      job = (BlurJob) {
+        .blur = blur,
+        .buffer = buffer,
+        .stride = buffer_width,
+        .height = buffer_height,
+        .d = d,
+        .x0 = column_offset + rect.y,
+        .x1 = column_offset + rect.y + rect.height,
+        .y0 = row_offset + rect.x,
+        .y1 = row_offset + rect.x + rect.width,
+      };
+      blur_columns_in_rect (blur, &job);
+    }
+}
+
+MetaShadowBlur *
+meta_shadow_blur_new (MetaShadowBlurFlags flags)
+{
+  MetaShadowBlur *blur;
+
+  blur = g_new0 (MetaShadowBlur, 1);
+  blur->flags = flags;
+  blur->blur_column_batch = blur_column_batch_scalar;
+  blur->impl_name = "scalar";
+
+#ifdef HAVE_X86_INTRINSICS
+  if (!(flags & META_SHADOW_BLUR_FLAG_NO_SIMD))
+    {
+      __builtin_cpu_init ();
+
+      if (__builtin_cpu_supports ("sse2"))
+        {
+          blur->blur_column_batch = blur_column_batch_sse2;
+          blur->impl_name = "sse2";
+        }
+    }
+#endif
+
+  if (flags & META_SHADOW_BLUR_FLAG_REFERENCE)
+    blur->impl_name = "reference";
+
+  return blur;
+}
+
+void
+meta_shadow_blur_free (MetaShadowBlur *blur)
+{
+  g_free (blur);
+}
+
+const char *
+meta_shadow_blur_get_impl_name (MetaShadowBlur *blur)
+{
+  return blur->impl_name;
+}
+
+/**
+ * meta_shadow_blur_region:
+ * @blur: a #MetaShadowBlur
+ * @region: the shape to blur, with its extents starting at 0,0
+ * @radius: the blur radius
+ * @out_width: (out): return location for the buffer width
+ * @out_height: (out): return location for the buffer height
+ *
+ * Renders @region into an 8 bit alpha buffer and blurs it. The buffer
+ * extends at least meta_shadow_blur_get_spread() pixels beyond each edge
+ * of @region, and @region is placed that far from the top left corner.
+ *
+ * Returns: (transfer full): the blurred buffer, free with g_free()
+ */
+uint8_t *
+meta_shadow_blur_region (MetaShadowBlur *blur,
+                         cairo_region_t *region,
+                         int             radius,
+                         int            *out_width,
+                         int            *out_height)
+{
+  int d = get_box_filter_size (radius);
+  int spread = meta_shadow_blur_get_spread (radius);
+  cairo_rectangle_int_t extents;
+  cairo_region_t *row_convolve_region;
+  cairo_region_t *column_convolve_region;
+  uint8_t *buffer;
+  int buffer_width;
+  int buffer_height;
+  int x_offset;
+  int y_offset;
+  int n_rectangles, j, k;
+
+  cairo_region_get_extents (region, &extents);
+
+  /* In the case where top_fade >= 0 and the portion above the top
+   * edge of the shape will be cropped, it seems like we could create
+   * a smaller buffer and omit the top portion, but actually, in our
+   * multi-pass blur algorithm, the blur into the area above the window
+   * in the first pass will contribute back to the final pixel values
+   * for the top pixels, so we create a buffer as if we weren't cropping
+   * and only crop when creating the CoglTexture.
+   */
+
+  buffer_width = extents.width + 2 * spread;
+  buffer_height = extents.height + 2 * spread;
+
+  /* Round up so we have aligned rows/columns */
+  buffer_width = (buffer_width + 3) & ~3;
+  buffer_height = (buffer_height + 3) & ~3;
+
+  /* Square buffer allows in-place swaps, which are roughly 70% faster, but we
+   * don't want to over-allocate too much memory.
+   */
+  if (buffer_height < buffer_width && buffer_height > (3 * buffer_width) / 4)
+    buffer_height = buffer_width;
+  if (buffer_width < buffer_height && buffer_width > (3 * buffer_height) / 4)
+    buffer_width = buffer_height;
+
+  buffer = g_malloc0 (buffer_width * buffer_height);
+
+  /* Blurring with multiple box-blur passes is fast, but (especially for
+   * large shadow sizes) we can improve efficiency by restricting the blur
+   * to the region that actually needs to be blurred.
+   */
+  row_convolve_region = meta_make_border_region (region, spread, spread, FALSE);
+  column_convolve_region = meta_make_border_region (region, 0, spread, TRUE);
+
+  /* Offsets between coordinates of the regions and coordinates in the buffer */
+  x_offset = spread;
+  y_offset = spread;
+
+  /* Step 1: unblurred image */
+  n_rectangles = cairo_region_num_rectangles (region);
+  for (k = 0; k < n_rectangles; k++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (region, k, &rect);
+      for (j = y_offset + rect.y; j < y_offset + rect.y + rect.height; j++)
+        memset (buffer + buffer_width * j + x_offset + rect.x, 255, rect.width);
+    }
+
+  if (blur->flags & META_SHADOW_BLUR_FLAG_REFERENCE)
+    {
+      /* Step 2: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_width, buffer_height);
+
+      /* Step 3: blur rows (really columns) */
+      blur_rows (column_convolve_region, y_offset, x_offset,
+                 buffer, buffer_height, buffer_width,
+                 d);
+
+      /* Step 4: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_height, buffer_width);
+
+      /* Step 5: blur rows */
+      blur_rows (row_convolve_region, x_offset, y_offset,
+                 buffer, buffer_width, buffer_height,
+                 d);
+    }
+  else
+    {
+      /* Step 2: blur columns */
+      blur_columns (blur, column_convolve_region, x_offset, y_offset,
+                    buffer, buffer_width, buffer_height,
+                    d);
+
+      /* Step 3: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_width, buffer_height);
+
+      /* Step 4: blur columns (really rows) */
+      blur_columns (blur, row_convolve_region, y_offset, x_offset,
+                    buffer, buffer_height, buffer_width,
+                    d);
+
+      /* Step 5: swap rows and columns */
+      buffer = flip_buffer (buffer, buffer_height, buffer_width);
+    }
+
+  cairo_region_destroy (row_convolve_region);
+  cairo_region_destroy (column_convolve_region);
+
+  *out_width = buffer_width;
+  *out_height = buffer_height;
+
+  return buffer;
+}
@@ -0,0 +1,59 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright 2010, 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef META_SHADOW_BLUR_H
+#define META_SHADOW_BLUR_H
+
+#include <cairo.h>
+#include <glib.h>
+#include <stdint.h>
+
+#include "core/util-private.h"
+
+typedef enum _MetaShadowBlurFlags
+{
+  META_SHADOW_BLUR_FLAG_NONE = 0,
+  META_SHADOW_BLUR_FLAG_NO_SIMD = 1 << 0,
+  META_SHADOW_BLUR_FLAG_NO_THREADS = 1 << 1,
+  META_SHADOW_BLUR_FLAG_REFERENCE = 1 << 2,
+} MetaShadowBlurFlags;
+
+typedef struct _MetaShadowBlur MetaShadowBlur;
+
+META_EXPORT_TEST
+MetaShadowBlur * meta_shadow_blur_new (MetaShadowBlurFlags flags);
+
+META_EXPORT_TEST
+void meta_shadow_blur_free (MetaShadowBlur *blur);
+
+META_EXPORT_TEST
+const char * meta_shadow_blur_get_impl_name (MetaShadowBlur *blur);
+
+META_EXPORT_TEST
+int meta_shadow_blur_get_spread (int radius);
+
+META_EXPORT_TEST
+uint8_t * meta_shadow_blur_region (MetaShadowBlur *blur,
+                                   cairo_region_t *region,
+                                   int             radius,
+                                   int            *out_width,
+                                   int            *out_height);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MetaShadowBlur, meta_shadow_blur_free)
+
+#endif /* META_SHADOW_BLUR_H */
@@ -0,0 +1,665 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Stores blurred shadow alpha masks on disk, so that they don't need to
+ * be blurred again after a restart. Each entry is a single zlib
+ * compressed file named after its key. All file access happens on a
+ * worker thread: when the cache is created, the most recently used
+ * entries are read and decompressed into memory, where lookups find them
+ * without blocking. When the cache grows over its size limit, the least
+ * recently used entries, going by their modification time, are removed.
+ */
+
+#include "config.h"
+
+#include "compositor/meta-shadow-disk-cache.h"
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "core/meta-parallel.h"
+#include "meta/util.h"
+
+#define SHADOW_FILE_MAGIC "MTRSHDW"
+#define SHADOW_FILE_VERSION 1
+#define SHADOW_FILE_SUFFIX ".shadow"
+
+typedef struct _ShadowFileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t compressed_size;
+} ShadowFileHeader;
+
+typedef enum _JobType
+{
+  JOB_TYPE_LOAD,
+  JOB_TYPE_WRITE,
+  JOB_TYPE_TOUCH,
+} JobType;
+
+typedef struct _Job
+{
+  JobType type;
+  char *key;
+  uint8_t *data;
+  int width;
+  int height;
+} Job;
+
+typedef struct _LoadedEntry
+{
+  uint8_t *data;
+  int width;
+  int height;
+} LoadedEntry;
+
+typedef struct _CacheEntry
+{
+  char *path;
+  uint64_t size;
+  int64_t last_used_us;
+} CacheEntry;
+
+struct _MetaShadowDiskCache
+{
+  char *path;
+  uint64_t max_size;
+
+  /* Only accessed from the worker thread */
+  gboolean size_known;
+  uint64_t total_size;
+
+  MetaJobQueue *job_queue;
+
+  /* Key -> LoadedEntry, filled by the worker thread */
+  GMutex loaded_mutex;
+  GHashTable *loaded_entries;
+};
+
+static char *
+get_entry_path (MetaShadowDiskCache *cache,
+                const char          *key)
+{
+  g_autofree char *filename = NULL;
+
+  filename = g_strconcat (key, SHADOW_FILE_SUFFIX, NULL);
+  return g_build_filename (cache->path, filename, NULL);
+}
+
+static void
+job_free (Job *job)
+{
+  g_free (job->key);
+  g_free (job->data);
+  g_free (job);
+}
+
+static void
+loaded_entry_free (LoadedEntry *entry)
+{
+  g_free (entry->data);
+  g_free (entry);
+}
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  g_free (entry->path);
+  g_free (entry);
+}
+
+static int
+compare_entries_by_last_use (gconstpointer a,
+                             gconstpointer b)
+{
+  const CacheEntry *entry_a = *(const CacheEntry **) a;
+  const CacheEntry *entry_b = *(const CacheEntry **) b;
+
+  if (entry_a->last_used_us < entry_b->last_used_us)
+    return -1;
+  else if (entry_a->last_used_us > entry_b->last_used_us)
+    return 1;
+  else
+    return 0;
+}
+
+static int
+compare_entries_by_last_use_reversed (gconstpointer a,
+                                      gconstpointer b)
+{
+  return compare_entries_by_last_use (b, a);
+}
+
+static GBytes *
+compress_data (const uint8_t  *data,
+               size_t          size,
+               GError        **error)
+{
+  g_autoptr (GZlibCompressor) compressor = NULL;
+  g_autoptr (GOutputStream) memory_stream = NULL;
+  g_autoptr (GOutputStream) converter_stream = NULL;
+
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1);
+  memory_stream = g_memory_output_stream_new_resizable ();
+  converter_stream = g_converter_output_stream_new (memory_stream,
+                                                    G_CONVERTER (compressor));
+
+  if (!g_output_stream_write_all (converter_stream, data, size,
+                                  NULL, NULL, error))
+    return NULL;
+
+  if (!g_output_stream_close (converter_stream, NULL, error))
+    return NULL;
+
+  return g_memory_output_stream_steal_as_bytes (
+    G_MEMORY_OUTPUT_STREAM (memory_stream));
+}
+
+static gboolean
+decompress_data (const uint8_t  *compressed_data,
+                 size_t          compressed_size,
+                 uint8_t        *data,
+                 size_t          size,
+                 GError        **error)
+{
+  g_autoptr (GZlibDecompressor) decompressor = NULL;
+  g_autoptr (GInputStream) memory_stream = NULL;
+  g_autoptr (GInputStream) converter_stream = NULL;
+  gsize bytes_read;
+
+  decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+  memory_stream = g_memory_input_stream_new_from_data (compressed_data,
+                                                       compressed_size,
+                                                       NULL);
+  converter_stream = g_converter_input_stream_new (memory_stream,
+                                                   G_CONVERTER (decompressor));
+
+  if (!g_input_stream_read_all (converter_stream, data, size, &bytes_read,
+                                NULL, error))
+    return FALSE;
+
+  if (bytes_read != size)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Truncated shadow data");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static GPtrArray *
+list_entries (MetaShadowDiskCache  *cache,
+              uint64_t             *out_total_size,
+              GError              **error)
+{
+  g_autoptr (GFile) directory = NULL;
+  g_autoptr (GFileEnumerator) enumerator = NULL;
+  g_autoptr (GPtrArray) entries = NULL;
+  uint64_t total_size = 0;
+
+  directory = g_file_new_for_path (cache->path);
+  enumerator = g_file_enumerate_children (directory,
+                                          G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                          G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                          NULL, error);
+  if (!enumerator)
+    return NULL;
+
+  entries = g_ptr_array_new_with_free_func ((GDestroyNotify) cache_entry_free);
+
+  while (TRUE)
+    {
+      GFileInfo *info;
+      const char *name;
+      CacheEntry *entry;
+
+      if (!g_file_enumerator_iterate (enumerator, &info, NULL, NULL, error))
+        return NULL;
+
+      if (!info)
+        break;
+
+      name = g_file_info_get_name (info);
+      if (!g_str_has_suffix (name, SHADOW_FILE_SUFFIX))
+        continue;
+
+      entry = g_new0 (CacheEntry, 1);
+      entry->path = g_build_filename (cache->path, name, NULL);
+      entry->size = g_file_info_get_size (info);
+      entry->last_used_us =
+        (g_file_info_get_attribute_uint64 (info,
+                                           G_FILE_ATTRIBUTE_TIME_MODIFIED) *
+         G_USEC_PER_SEC +
+         g_file_info_get_attribute_uint32 (info,
+                                           G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+      g_ptr_array_add (entries, entry);
+
+      total_size += entry->size;
+    }
+
+  *out_total_size = total_size;
+  return g_steal_pointer (&entries);
+}
+
+static void
+maybe_evict_entries (MetaShadowDiskCache *cache,
+                     const char          *written_path)
+{
+  g_autoptr (GPtrArray) entries = NULL;
+  g_autoptr (GError) error = NULL;
+  uint64_t total_size;
+  uint64_t target_size;
+  unsigned int i;
+
+  if (cache->size_known && cache->total_size <= cache->max_size)
+    return;
+
+  entries = list_entries (cache, &total_size, &error);
+  if (!entries)
+    {
+      meta_topic (META_DEBUG_RENDER, "Failed to list shadow cache: %s",
+                  error->message);
+      return;
+    }
+
+  cache->total_size = total_size;
+  cache->size_known = TRUE;
+
+  if (total_size <= cache->max_size)
+    return;
+
+  /* Leave some room, so that we don't have to evict on every write */
+  target_size = (cache->max_size / 4) * 3;
+
+  g_ptr_array_sort (entries, compare_entries_by_last_use);
+
+  for (i = 0; i < entries->len && cache->total_size > target_size; i++)
+    {
+      CacheEntry *entry = g_ptr_array_index (entries, i);
+
+      /* Modification times are coarse, don't evict what was just written */
+      if (g_strcmp0 (entry->path, written_path) == 0)
+        continue;
+
+      if (g_unlink (entry->path) != 0)
+        continue;
+
+      cache->total_size -= entry->size;
+    }
+
+  meta_topic (META_DEBUG_RENDER,
+              "Evicted shadow cache entries, %" G_GUINT64_FORMAT " bytes left",
+              cache->total_size);
+}
+
+static gboolean
+write_entry (MetaShadowDiskCache  *cache,
+             Job                  *job,
+             const char           *path,
+             GError              **error)
+{
+  g_autoptr (GBytes) compressed_bytes = NULL;
+  g_autoptr (GByteArray) contents = NULL;
+  ShadowFileHeader header = { 0 };
+  const uint8_t *compressed_data;
+  size_t compressed_size;
+  GStatBuf stat_buf;
+
+  if (g_mkdir_with_parents (cache->path, 0700) != 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to create %s: %s", cache->path, g_strerror (errsv));
+      return FALSE;
+    }
+
+  compressed_bytes = compress_data (job->data,
+                                    (size_t) job->width * job->height,
+                                    error);
+  if (!compressed_bytes)
+    return FALSE;
+
+  compressed_data = g_bytes_get_data (compressed_bytes, &compressed_size);
+
+  memcpy (header.magic, SHADOW_FILE_MAGIC, sizeof (header.magic));
+  header.version = SHADOW_FILE_VERSION;
+  header.width = job->width;
+  header.height = job->height;
+  header.compressed_size = compressed_size;
+
+  contents = g_byte_array_sized_new (sizeof (header) + compressed_size);
+  g_byte_array_append (contents, (const uint8_t *) &header, sizeof (header));
+  g_byte_array_append (contents, compressed_data, compressed_size);
+
+  /* An existing entry is replaced, don't count it twice */
+  if (g_stat (path, &stat_buf) == 0)
+    cache->total_size -= MIN ((uint64_t) stat_buf.st_size, cache->total_size);
+
+  if (!g_file_set_contents (path,
+                            (const char *) contents->data, contents->len,
+                            error))
+    return FALSE;
+
+  cache->total_size += contents->len;
+
+  return TRUE;
+}
+
+static uint8_t *
+read_entry (const char  *path,
+            int         *out_width,
+            int         *out_height,
+            GError     **error)
+{
+  g_autofree char *contents = NULL;
+  g_autofree uint8_t *data = NULL;
+  ShadowFileHeader header;
+  gsize length;
+  size_t size;
+
+  if (!g_file_get_contents (path, &contents, &length, error))
+    return NULL;
+
+  if (length < sizeof (header))
+    goto invalid;
+
+  memcpy (&header, contents, sizeof (header));
+  if (memcmp (header.magic, SHADOW_FILE_MAGIC, sizeof (header.magic)) != 0 ||
+      header.version != SHADOW_FILE_VERSION ||
+      header.width == 0 || header.width > G_MAXINT16 ||
+      header.height == 0 || header.height > G_MAXINT16 ||
+      header.compressed_size != length - sizeof (header))
+    goto invalid;
+
+  size = (size_t) header.width * header.height;
+  data = g_malloc (size);
+  if (!decompress_data ((const uint8_t *) contents + sizeof (header),
+                        header.compressed_size,
+                        data, size,
+                        error))
+    return NULL;
+
+  *out_width = header.width;
+  *out_height = header.height;
+  return g_steal_pointer (&data);
+
+invalid:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Invalid shadow cache entry");
+  return NULL;
+}
+
+static void
+load_entries (MetaShadowDiskCache *cache)
+{
+  g_autoptr (GPtrArray) entries = NULL;
+  g_autoptr (GError) error = NULL;
+  uint64_t total_size;
+  uint64_t loaded_size = 0;
+  unsigned int i;
+
+  entries = list_entries (cache, &total_size, &error);
+  if (!entries)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        {
+          meta_topic (META_DEBUG_RENDER, "Failed to list shadow cache: %s",
+                      error->message);
+        }
+      return;
+    }
+
+  cache->total_size = total_size;
+  cache->size_known = TRUE;
+
+  /* The masks are much larger than their compressed files, so only load
+   * the most recently used ones, up to the size limit of the cache. */
+  g_ptr_array_sort (entries, compare_entries_by_last_use_reversed);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      CacheEntry *entry = g_ptr_array_index (entries, i);
+      g_autoptr (GError) read_error = NULL;
+      g_autofree char *basename = NULL;
+      LoadedEntry *loaded_entry;
+      uint8_t *data;
+      int width;
+      int height;
+
+      data = read_entry (entry->path, &width, &height, &read_error);
+      if (!data)
+        {
+          meta_topic (META_DEBUG_RENDER,
+                      "Removing shadow cache entry %s: %s",
+                      entry->path, read_error->message);
+          if (g_unlink (entry->path) == 0)
+            cache->total_size -= MIN (entry->size, cache->total_size);
+          continue;
+        }
+
+      loaded_size += (uint64_t) width * height;
+      if (loaded_size > cache->max_size)
+        {
+          g_free (data);
+          break;
+        }
+
+      basename = g_path_get_basename (entry->path);
+
+      loaded_entry = g_new0 (LoadedEntry, 1);
+      loaded_entry->data = data;
+      loaded_entry->width = width;
+      loaded_entry->height = height;
+
+      g_mutex_lock (&cache->loaded_mutex);
+      g_hash_table_insert (cache->loaded_entries,
+                           g_strndup (basename,
+                                      strlen (basename) -
+                                      strlen (SHADOW_FILE_SUFFIX)),
+                           loaded_entry);
+      g_mutex_unlock (&cache->loaded_mutex);
+    }
+
+  meta_topic (META_DEBUG_RENDER,
+              "Loaded %" G_GUINT64_FORMAT " bytes of cached shadows",
+              loaded_size);
+}
+
+static void
+run_job_in_thread (Job                 *job,
+                   MetaShadowDiskCache *cache)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree char *path = NULL;
+
+  switch (job->type)
+    {
+    case JOB_TYPE_LOAD:
+      load_entries (cache);
+      break;
+    case JOB_TYPE_WRITE:
+      path = get_entry_path (cache, job->key);
+      if (write_entry (cache, job, path, &error))
+        maybe_evict_entries (cache, path);
+      else
+        meta_topic (META_DEBUG_RENDER, "Failed to write shadow cache entry: %s",
+                    error->message);
+      break;
+    case JOB_TYPE_TOUCH:
+      /* Mark the entry as recently used for the eviction */
+      path = get_entry_path (cache, job->key);
+      g_utime (path, NULL);
+      break;
+    }
+
+  job_free (job);
+}
+
+static void
+queue_job (MetaShadowDiskCache *cache,
+           Job                 *job)
+{
+  meta_job_queue_push (cache->job_queue, job);
+}
+
+MetaShadowDiskCache *
+meta_shadow_disk_cache_new (const char *path,
+                            uint64_t    max_size)
+{
+  MetaShadowDiskCache *cache;
+  Job *job;
+
+  cache = g_new0 (MetaShadowDiskCache, 1);
+  cache->path = g_strdup (path);
+  cache->max_size = max_size;
+
+  g_mutex_init (&cache->loaded_mutex);
+  cache->loaded_entries =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free, (GDestroyNotify) loaded_entry_free);
+
+  /* A single thread serializes loading, writes and eviction */
+  cache->job_queue = meta_job_queue_new ((GFunc) run_job_in_thread, cache);
+
+  job = g_new0 (Job, 1);
+  job->type = JOB_TYPE_LOAD;
+  queue_job (cache, job);
+
+  return cache;
+}
+
+void
+meta_shadow_disk_cache_free (MetaShadowDiskCache *cache)
+{
+  meta_job_queue_free (cache->job_queue);
+
+  g_hash_table_destroy (cache->loaded_entries);
+  g_mutex_clear (&cache->loaded_mutex);
+
+  g_free (cache->path);
+  g_free (cache);
+}
+
+/**
+ * meta_shadow_disk_cache_lookup:
+ * @cache: a #MetaShadowDiskCache
+ * @key: the key the mask was stored with
+ * @width: the expected width of the mask
+ * @height: the expected height of the mask
+ *
+ * Looks up a mask among the entries loaded from disk so far. This never
+ * blocks on file access; entries that haven't been loaded yet are not
+ * found. A found entry is handed over to the caller and removed from
+ * memory.
+ *
+ * Returns: (transfer full) (nullable): the cached alpha mask, with a
+ *   rowstride of @width, or %NULL if there is no usable entry.
+ */
+uint8_t *
+meta_shadow_disk_cache_lookup (MetaShadowDiskCache *cache,
+                               const char          *key,
+                               int                  width,
+                               int                  height)
+{
+  LoadedEntry *entry;
+  uint8_t *data = NULL;
+  Job *job;
+
+  g_mutex_lock (&cache->loaded_mutex);
+  entry = g_hash_table_lookup (cache->loaded_entries, key);
+  if (entry && entry->width == width && entry->height == height)
+    {
+      data = g_steal_pointer (&entry->data);
+      g_hash_table_remove (cache->loaded_entries, key);
+    }
+  g_mutex_unlock (&cache->loaded_mutex);
+
+  if (!data)
+    return NULL;
+
+  job = g_new0 (Job, 1);
+  job->type = JOB_TYPE_TOUCH;
+  job->key = g_strdup (key);
+  queue_job (cache, job);
+
+  return data;
+}
+
+/**
+ * meta_shadow_disk_cache_store:
+ * @cache: a #MetaShadowDiskCache
+ * @key: a key identifying the mask; used as a file name
+ * @data: the alpha mask
+ * @width: the width of the mask
+ * @height: the height of the mask
+ * @rowstride: the rowstride of @data
+ *
+ * Copies the mask and writes it to disk asynchronously.
+ */
+void
+meta_shadow_disk_cache_store (MetaShadowDiskCache *cache,
+                              const char          *key,
+                              const uint8_t       *data,
+                              int                  width,
+                              int                  height,
+                              int                  rowstride)
+{
+  Job *job;
+  int y;
+
+  g_return_if_fail (strchr (key, G_DIR_SEPARATOR) == NULL);
+
+  job = g_new0 (Job, 1);
+  job->type = JOB_TYPE_WRITE;
+  job->key = g_strdup (key);
+  job->width = width;
+  job->height = height;
+  job->data = g_malloc ((size_t) width * height);
+
+  for (y = 0; y < height; y++)
+    {
+      memcpy (job->data + (size_t) y * width,
+              data + (size_t) y * rowstride,
+              width);
+    }
+
+  queue_job (cache, job);
+}
+
+/**
+ * meta_shadow_disk_cache_flush:
+ * @cache: a #MetaShadowDiskCache
+ *
+ * Waits until entries have been loaded from disk and pending writes have
+ * finished.
+ */
+void
+meta_shadow_disk_cache_flush (MetaShadowDiskCache *cache)
+{
+  meta_job_queue_flush (cache->job_queue);
+}
@@ -0,0 +1,55 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef META_SHADOW_DISK_CACHE_H
+#define META_SHADOW_DISK_CACHE_H
+
+#include <glib.h>
+#include <stdint.h>
+
+#include "core/util-private.h"
+
+typedef struct _MetaShadowDiskCache MetaShadowDiskCache;
+
+META_EXPORT_TEST
+MetaShadowDiskCache * meta_shadow_disk_cache_new (const char *path,
+                                                  uint64_t    max_size);
+
+META_EXPORT_TEST
+void meta_shadow_disk_cache_free (MetaShadowDiskCache *cache);
+
+META_EXPORT_TEST
+uint8_t * meta_shadow_disk_cache_lookup (MetaShadowDiskCache *cache,
+                                         const char          *key,
+                                         int                  width,
+                                         int                  height);
+
+META_EXPORT_TEST
+void meta_shadow_disk_cache_store (MetaShadowDiskCache *cache,
+                                   const char          *key,
+                                   const uint8_t       *data,
+                                   int                  width,
+                                   int                  height,
+                                   int                  rowstride);
+
+META_EXPORT_TEST
+void meta_shadow_disk_cache_flush (MetaShadowDiskCache *cache);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MetaShadowDiskCache, meta_shadow_disk_cache_free)
+
+#endif /* META_SHADOW_DISK_CACHE_H */
@@ -24,11 +24,11 @@
 
 #include "config.h"
 
-#include <math.h>
-#include <string.h>
-
+#include "backends/meta-backend-private.h"
+#include "backends/meta-settings-private.h"
 #include "compositor/cogl-utils.h"
-#include "compositor/region-utils.h"
+#include "compositor/meta-shadow-blur.h"
+#include "compositor/meta-shadow-disk-cache.h"
 #include "meta/meta-shadow-factory.h"
 #include "meta/util.h"
 
@@ -46,12 +46,21 @@
  *   2D blur as 1D blur of the rows followed by a 1D blur of the
  *   columns.
  *
- * - For better cache efficiency, we blur rows, transpose the image
- *   in blocks, blur rows again, and then transpose back.
+ * - For better cache efficiency, we blur columns 16 at a time (with
+ *   SSE2 where available), transpose the image in blocks, blur columns
+ *   again, and then transpose back. Large blurs are split across a few
+ *   worker threads.
  *
  * - We approximate the 1D gaussian blur as 3 successive box filters.
+ *
+ * - Blurred shadows are also kept in a size limited cache on disk, so
+ *   that they don't have to be computed again after a restart.
  */
 
+/* Bump when the shadow pixels produced for a given key change */
+#define SHADOW_DISK_CACHE_KEY_VERSION 1
+#define SHADOW_DISK_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
 typedef struct _MetaShadowCacheKey  MetaShadowCacheKey;
 typedef struct _MetaShadowClassInfo MetaShadowClassInfo;
 
@@ -104,6 +113,9 @@ struct _MetaShadowFactory
 
   /* class name => MetaShadowClassInfo */
   GHashTable *shadow_classes;
+
+  MetaShadowBlur *blur;
+  MetaShadowDiskCache *disk_cache;
 };
 
 enum
@@ -390,6 +402,19 @@ meta_shadow_class_info_free (MetaShadowClassInfo *class_info)
   g_free (class_info);
 }
 
+static gboolean
+is_shadow_disk_cache_enabled (void)
+{
+  MetaBackend *backend = meta_get_backend ();
+
+  if (!backend)
+    return FALSE;
+
+  return meta_settings_is_experimental_feature_enabled (
+    meta_backend_get_settings (backend),
+    META_EXPERIMENTAL_FEATURE_SHADOW_DISK_CACHE);
+}
+
 static void
 meta_shadow_factory_init (MetaShadowFactory *factory)
 {
@@ -413,6 +438,18 @@ meta_shadow_factory_init (MetaShadowFactory *factory)
       g_hash_table_insert (factory->shadow_classes,
                            (char *)class_info->name, class_info);
     }
+
+  factory->blur = meta_shadow_blur_new (META_SHADOW_BLUR_FLAG_NONE);
+
+  if (is_shadow_disk_cache_enabled ())
+    {
+      g_autofree char *cache_path = NULL;
+
+      cache_path = g_build_filename (g_get_user_cache_dir (),
+                                     "mutter", "shadows", NULL);
+      factory->disk_cache =
+        meta_shadow_disk_cache_new (cache_path, SHADOW_DISK_CACHE_MAX_SIZE);
+    }
 }
 
 static void
@@ -433,6 +470,8 @@ meta_shadow_factory_finalize (GObject *object)
 
   g_hash_table_destroy (factory->shadows);
   g_hash_table_destroy (factory->shadow_classes);
+  g_clear_pointer (&factory->blur, meta_shadow_blur_free);
+  g_clear_pointer (&factory->disk_cache, meta_shadow_disk_cache_free);
 
   G_OBJECT_CLASS (meta_shadow_factory_parent_class)->finalize (object);
 }
@@ -475,152 +514,6 @@ meta_shadow_factory_get_default (void)
   return factory;
 }
 
-/* We emulate a 1D Gaussian blur by using 3 consecutive box blurs;
- * this produces a result that's within 3% of the original and can be
- * implemented much faster for large filter sizes because of the
- * efficiency of implementation of a box blur. Idea and formula
- * for choosing the box blur size come from:
- *
- * http://www.w3.org/TR/SVG/filters.html#feGaussianBlurElement
- *
- * The 2D blur is then done by blurring the rows, flipping the
- * image and blurring the columns. (This is possible because the
- * Gaussian kernel is separable - it's the product of a horizontal
- * blur and a vertical blur.)
- */
-static int
-get_box_filter_size (int radius)
-{
-  return (int)(0.5 + radius * (0.75 * sqrt(2*M_PI)));
-}
-
-/* The "spread" of the filter is the number of pixels from an original
- * pixel that it's blurred image extends. (A no-op blur that doesn't
- * blur would have a spread of 0.) See comment in blur_rows() for why the
- * odd and even cases are different
- */
-static int
-get_shadow_spread (int radius)
-{
-  int d;
-
-  if (radius == 0)
-    return 0;
-
-  d = get_box_filter_size (radius);
-
-  if (d % 2 == 1)
-    return 3 * (d / 2);
-  else
-    return 3 * (d / 2) - 1;
-}
-
-/* This applies a single box blur pass to a horizontal range of pixels;
- * since the box blur has the same weight for all pixels, we can
- * implement an efficient sliding window algorithm where we add
- * in pixels coming into the window from the right and remove
- * them when they leave the windw to the left.
- *
- * d is the filter width; for even d shift indicates how the blurred
- * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
- * or 'yy ' (shift=-1)
- */
-static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     x0,
-            int     x1,
-            int     d,
-            int     shift)
-{
-  int offset;
-  int sum = 0;
-  int i;
-
-  if (d % 2 == 1)
-    offset = d / 2;
-  else
-    offset = (d - shift) / 2;
-
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
-   */
-  for (i = x0 - d + offset; i < x1 + offset; i++)
-    {
-      if (i >= 0 && i < row_width)
-        sum += row[i];
-
-      if (i >= x0 + offset)
-        {
-          if (i >= d)
-            sum -= row[i - d];
-
-          tmp_buffer[i - offset] = (sum + d / 2) / d;
-        }
-    }
-
-  memcpy (row + x0, tmp_buffer + x0, x1 - x0);
-}
-
-static void
-blur_rows (cairo_region_t   *convolve_region,
-           int               x_offset,
-           int               y_offset,
-           guchar           *buffer,
-           int               buffer_width,
-           int               buffer_height,
-           int               d)
-{
-  int i, j;
-  int n_rectangles;
-  guchar *tmp_buffer;
-
-  tmp_buffer = g_malloc (buffer_width);
-
-  n_rectangles = cairo_region_num_rectangles (convolve_region);
-  for (i = 0; i < n_rectangles; i++)
-    {
-      cairo_rectangle_int_t rect;
-
-      cairo_region_get_rectangle (convolve_region, i, &rect);
-
-      for (j = y_offset + rect.y; j < y_offset + rect.y + rect.height; j++)
-        {
-          guchar *row = buffer + j * buffer_width;
-          int x0 = x_offset + rect.x;
-          int x1 = x0 + rect.width;
-
-          /* We want to produce a symmetric blur that spreads a pixel
-           * equally far to the left and right. If d is odd that happens
-           * naturally, but for d even, we approximate by using a blur
-           * on either side and then a centered blur of size d + 1.
-           * (technique also from the SVG specification)
-           */
-          if (d % 2 == 1)
-            {
-              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 0);
-              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 0);
-              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 0);
-            }
-          else
-            {
-              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, 1);
-              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d, -1);
-              blur_xspan (row, tmp_buffer, buffer_width, x0, x1, d + 1, 0);
-            }
-        }
-    }
-
-  g_free (tmp_buffer);
-}
-
 static void
 fade_bytes (guchar *bytes,
             int     width,
@@ -634,182 +527,132 @@ fade_bytes (guchar *bytes,
     bytes[i] = (bytes[i] * multiplier) >> 16;
 }
 
-/* Swaps width and height. Either swaps in-place and returns the original
- * buffer or allocates a new buffer, frees the original buffer and returns
- * the new buffer.
+/* The key covers everything that affects the shadow pixels: the region
+ * that gets blurred, which already has the center size applied, and
+ * the shadow parameters.
  */
-static guchar *
-flip_buffer (guchar *buffer,
-             int     width,
-             int     height)
+static char *
+get_disk_cache_key (MetaShadow     *shadow,
+                    cairo_region_t *region)
 {
-  /* Working in blocks increases cache efficiency, compared to reading
-   * or writing an entire column at once */
-#define BLOCK_SIZE 16
-
-  if (width == height)
-    {
-      int i0, j0;
-
-      for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
-        for (i0 = 0; i0 <= j0; i0 += BLOCK_SIZE)
-          {
-            int max_j = MIN(j0 + BLOCK_SIZE, height);
-            int max_i = MIN(i0 + BLOCK_SIZE, width);
-            int i, j;
-
-            if (i0 == j0)
-              {
-                for (j = j0; j < max_j; j++)
-                  for (i = i0; i < j; i++)
-                    {
-                      guchar tmp = buffer[j * width + i];
-                      buffer[j * width + i] = buffer[i * width + j];
-                      buffer[i * width + j] = tmp;
-                    }
-              }
-            else
-              {
-                for (j = j0; j < max_j; j++)
-                  for (i = i0; i < max_i; i++)
-                    {
-                      guchar tmp = buffer[j * width + i];
-                      buffer[j * width + i] = buffer[i * width + j];
-                      buffer[i * width + j] = tmp;
-                    }
-              }
-          }
-
-      return buffer;
-    }
-  else
-    {
-      guchar *new_buffer = g_malloc (height * width);
-      int i0, j0;
-
-      for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
-        for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
-          {
-            int max_j = MIN(j0 + BLOCK_SIZE, height);
-            int max_i = MIN(i0 + BLOCK_SIZE, width);
-            int i, j;
+  g_autoptr (GChecksum) checksum = NULL;
+  int32_t params[] = {
+    SHADOW_DISK_CACHE_KEY_VERSION,
+    shadow->key.radius,
+    shadow->key.top_fade,
+    shadow->outer_border_top,
+    shadow->outer_border_right,
+    shadow->outer_border_bottom,
+    shadow->outer_border_left,
+  };
+  int n_rectangles;
+  int i;
 
-            for (i = i0; i < max_i; i++)
-              for (j = j0; j < max_j; j++)
-                new_buffer[i * height + j] = buffer[j * width + i];
-          }
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) params, sizeof (params));
 
-      g_free (buffer);
+  n_rectangles = cairo_region_num_rectangles (region);
+  for (i = 0; i < n_rectangles; i++)
+    {
+      cairo_rectangle_int_t rect;
 
-      return new_buffer;
+      cairo_region_get_rectangle (region, i, &rect);
+      g_checksum_update (checksum, (const guchar *) &rect, sizeof (rect));
     }
-#undef BLOCK_SIZE
+
+  return g_strdup (g_checksum_get_string (checksum));
 }
 
 static void
 make_shadow (MetaShadow     *shadow,
              cairo_region_t *region)
 {
+  MetaShadowFactory *factory = shadow->factory;
   ClutterBackend *backend = clutter_get_default_backend ();
   CoglContext *ctx = clutter_backend_get_cogl_context (backend);
   GError *error = NULL;
-  int d = get_box_filter_size (shadow->key.radius);
-  int spread = get_shadow_spread (shadow->key.radius);
+  g_autofree char *disk_cache_key = NULL;
   cairo_rectangle_int_t extents;
-  cairo_region_t *row_convolve_region;
-  cairo_region_t *column_convolve_region;
-  guchar *buffer;
-  int buffer_width;
-  int buffer_height;
-  int x_offset;
-  int y_offset;
-  int n_rectangles, j, k;
+  guchar *buffer = NULL;
+  const guchar *data;
+  int rowstride;
+  int texture_width;
+  int texture_height;
 
   cairo_region_get_extents (region, &extents);
 
-  /* In the case where top_fade >= 0 and the portion above the top
-   * edge of the shape will be cropped, it seems like we could create
-   * a smaller buffer and omit the top portion, but actually, in our
-   * multi-pass blur algorithm, the blur into the area above the window
-   * in the first pass will contribute back to the final pixel values
-   * for the top pixels, so we create a buffer as if we weren't cropping
-   * and only crop when creating the CoglTexture.
-   */
-
-  buffer_width = extents.width + 2 * spread;
-  buffer_height = extents.height + 2 * spread;
-
-  /* Round up so we have aligned rows/columns */
-  buffer_width = (buffer_width + 3) & ~3;
-  buffer_height = (buffer_height + 3) & ~3;
-
-  /* Square buffer allows in-place swaps, which are roughly 70% faster, but we
-   * don't want to over-allocate too much memory.
-   */
-  if (buffer_height < buffer_width && buffer_height > (3 * buffer_width) / 4)
-    buffer_height = buffer_width;
-  if (buffer_width < buffer_height && buffer_width > (3 * buffer_height) / 4)
-    buffer_width = buffer_height;
+  texture_width = (shadow->outer_border_left + extents.width +
+                   shadow->outer_border_right);
+  texture_height = (shadow->outer_border_top + extents.height +
+                    shadow->outer_border_bottom);
 
-  buffer = g_malloc0 (buffer_width * buffer_height);
-
-  /* Blurring with multiple box-blur passes is fast, but (especially for
-   * large shadow sizes) we can improve efficiency by restricting the blur
-   * to the region that actually needs to be blurred.
-   */
-  row_convolve_region = meta_make_border_region (region, spread, spread, FALSE);
-  column_convolve_region = meta_make_border_region (region, 0, spread, TRUE);
-
-  /* Offsets between coordinates of the regions and coordinates in the buffer */
-  x_offset = spread;
-  y_offset = spread;
-
-  /* Step 1: unblurred image */
-  n_rectangles = cairo_region_num_rectangles (region);
-  for (k = 0; k < n_rectangles; k++)
+  if (factory->disk_cache)
     {
-      cairo_rectangle_int_t rect;
-
-      cairo_region_get_rectangle (region, k, &rect);
-      for (j = y_offset + rect.y; j < y_offset + rect.y + rect.height; j++)
-        memset (buffer + buffer_width * j + x_offset + rect.x, 255, rect.width);
+      disk_cache_key = get_disk_cache_key (shadow, region);
+      buffer = meta_shadow_disk_cache_lookup (factory->disk_cache,
+                                              disk_cache_key,
+                                              texture_width,
+                                              texture_height);
     }
 
-  /* Step 2: swap rows and columns */
-  buffer = flip_buffer (buffer, buffer_width, buffer_height);
-
-  /* Step 3: blur rows (really columns) */
-  blur_rows (column_convolve_region, y_offset, x_offset,
-             buffer, buffer_height, buffer_width,
-             d);
-
-  /* Step 4: swap rows and columns */
-  buffer = flip_buffer (buffer, buffer_height, buffer_width);
+  if (buffer)
+    {
+      data = buffer;
+      rowstride = texture_width;
+    }
+  else
+    {
+      int spread = meta_shadow_blur_get_spread (shadow->key.radius);
+      int buffer_width;
+      int buffer_height;
+      int x_offset;
+      int y_offset;
+      int j;
+
+      /* Steps 1-5: render the shape and blur it */
+      buffer = meta_shadow_blur_region (factory->blur,
+                                        region,
+                                        shadow->key.radius,
+                                        &buffer_width,
+                                        &buffer_height);
+
+      /* Offsets between coordinates of the region and coordinates in the buffer */
+      x_offset = spread;
+      y_offset = spread;
+
+      /* Step 6: fade out the top, if applicable */
+      if (shadow->key.top_fade >= 0)
+        {
+          for (j = y_offset; j < y_offset + MIN (shadow->key.top_fade, extents.height + shadow->outer_border_bottom); j++)
+            fade_bytes(buffer + j * buffer_width, buffer_width, j - y_offset, shadow->key.top_fade);
+        }
 
-  /* Step 5: blur rows */
-  blur_rows (row_convolve_region, x_offset, y_offset,
-             buffer, buffer_width, buffer_height,
-             d);
+      /* We offset the passed in pixels to crop off the extra area we allocated at the top
+       * in the case of top_fade >= 0. We also account for padding at the left for symmetry
+       * though that doesn't currently occur.
+       */
+      data = (buffer +
+              (y_offset - shadow->outer_border_top) * buffer_width +
+              (x_offset - shadow->outer_border_left));
+      rowstride = buffer_width;
 
-  /* Step 6: fade out the top, if applicable */
-  if (shadow->key.top_fade >= 0)
-    {
-      for (j = y_offset; j < y_offset + MIN (shadow->key.top_fade, extents.height + shadow->outer_border_bottom); j++)
-        fade_bytes(buffer + j * buffer_width, buffer_width, j - y_offset, shadow->key.top_fade);
+      if (disk_cache_key)
+        {
+          meta_shadow_disk_cache_store (factory->disk_cache,
+                                        disk_cache_key,
+                                        data,
+                                        texture_width,
+                                        texture_height,
+                                        rowstride);
+        }
     }
 
-  /* We offset the passed in pixels to crop off the extra area we allocated at the top
-   * in the case of top_fade >= 0. We also account for padding at the left for symmetry
-   * though that doesn't currently occur.
-   */
   shadow->texture = COGL_TEXTURE (cogl_texture_2d_new_from_data (ctx,
-                                                                 shadow->outer_border_left + extents.width + shadow->outer_border_right,
-                                                                 shadow->outer_border_top + extents.height + shadow->outer_border_bottom,
+                                                                 texture_width,
+                                                                 texture_height,
                                                                  COGL_PIXEL_FORMAT_A_8,
-                                                                 buffer_width,
-                                                                 (buffer +
-                                                                  (y_offset - shadow->outer_border_top) * buffer_width +
-                                                                  (x_offset - shadow->outer_border_left)),
+                                                                 rowstride,
+                                                                 data,
                                                                  &error));
 
   if (error)
@@ -818,8 +661,6 @@ make_shadow (MetaShadow     *shadow,
       g_error_free (error);
     }
 
-  cairo_region_destroy (row_convolve_region);
-  cairo_region_destroy (column_convolve_region);
   g_free (buffer);
 
   shadow->pipeline = meta_create_texture_pipeline (shadow->texture);
@@ -923,7 +764,7 @@ meta_shadow_factory_get_shadow (MetaShadowFactory *factory,
 
   params = get_shadow_params (factory, class_name, focused, FALSE);
 
-  spread = get_shadow_spread (params->radius);
+  spread = meta_shadow_blur_get_spread (params->radius);
   meta_window_shape_get_borders (shape,
                                  &shape_border_top,
                                  &shape_border_right,
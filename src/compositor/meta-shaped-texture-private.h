@@ -28,9 +28,12 @@
 #define __META_SHAPED_TEXTURE_PRIVATE_H__
 
 #include "backends/meta-monitor-manager-private.h"
+#include "core/util-private.h"
 #include "meta/meta-shaped-texture.h"
 
+META_EXPORT_TEST
 MetaShapedTexture * meta_shaped_texture_new (void);
+META_EXPORT_TEST
 void meta_shaped_texture_set_texture (MetaShapedTexture *stex,
                                       CoglTexture       *texture);
 void meta_shaped_texture_set_is_y_inverted (MetaShapedTexture *stex,
@@ -55,6 +58,10 @@ void meta_shaped_texture_reset_viewport_dst_size (MetaShapedTexture *stex);
 void meta_shaped_texture_set_buffer_scale (MetaShapedTexture *stex,
                                            int                buffer_scale);
 int meta_shaped_texture_get_buffer_scale (MetaShapedTexture *stex);
+META_EXPORT_TEST
+void meta_shaped_texture_set_overlay_view (MetaShapedTexture *stex,
+                                           ClutterStageView  *view);
+ClutterStageView * meta_shaped_texture_get_overlay_view (MetaShapedTexture *stex);
 
 gboolean meta_shaped_texture_update_area (MetaShapedTexture     *stex,
                                           int                    x,
@@ -75,4 +82,7 @@ void meta_shaped_texture_ensure_size_valid (MetaShapedTexture *stex);
 
 gboolean meta_shaped_texture_should_get_via_offscreen (MetaShapedTexture *stex);
 
+CoglPipeline * meta_shaped_texture_create_prewarm_pipeline (CoglContext *ctx,
+                                                            const char  *variant);
+
 #endif
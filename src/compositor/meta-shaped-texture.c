@@ -39,6 +39,7 @@
 #include <gdk/gdk.h>
 #include <math.h>
 
+#include "clutter/clutter-pipeline-prewarm.h"
 #include "cogl/cogl.h"
 #include "compositor/clutter-utils.h"
 #include "compositor/meta-texture-tower.h"
@@ -119,10 +120,14 @@ struct _MetaShapedTexture
   gint64 prev_invalidation, last_invalidation;
   guint fast_updates;
   guint remipmap_timeout_id;
+  guint mipmap_update_id;
   gint64 earliest_remipmap;
 
   int buffer_scale;
 
+  /* View on which the texture is scanned out on an overlay plane */
+  ClutterStageView *overlay_view;
+
   guint create_mipmaps : 1;
 };
 
@@ -258,6 +263,7 @@ meta_shaped_texture_dispose (GObject *object)
   MetaShapedTexture *stex = (MetaShapedTexture *) object;
 
   g_clear_handle_id (&stex->remipmap_timeout_id, g_source_remove);
+  g_clear_handle_id (&stex->mipmap_update_id, g_source_remove);
 
   if (stex->paint_tower)
     meta_texture_tower_free (stex->paint_tower);
@@ -273,18 +279,15 @@ meta_shaped_texture_dispose (GObject *object)
 
   g_clear_pointer (&stex->snippet, cogl_object_unref);
 
+  g_clear_weak_pointer (&stex->overlay_view);
+
   G_OBJECT_CLASS (meta_shaped_texture_parent_class)->dispose (object);
 }
 
 static CoglPipeline *
-get_base_pipeline (MetaShapedTexture *stex,
-                   CoglContext       *ctx)
+create_base_pipeline (CoglContext *ctx)
 {
   CoglPipeline *pipeline;
-  graphene_matrix_t matrix;
-
-  if (stex->base_pipeline)
-    return stex->base_pipeline;
 
   pipeline = cogl_pipeline_new (ctx);
   cogl_pipeline_set_layer_wrap_mode_s (pipeline, 0,
@@ -296,6 +299,75 @@ get_base_pipeline (MetaShapedTexture *stex,
   cogl_pipeline_set_layer_wrap_mode_t (pipeline, 1,
                                        COGL_PIPELINE_WRAP_MODE_CLAMP_TO_EDGE);
 
+  return pipeline;
+}
+
+static void
+setup_masked_pipeline (CoglPipeline *pipeline)
+{
+  cogl_pipeline_set_layer_combine (pipeline, 1,
+                                   "RGBA = MODULATE (PREVIOUS, TEXTURE[A])",
+                                   NULL);
+}
+
+static void
+setup_unblended_pipeline (CoglPipeline *pipeline)
+{
+  cogl_pipeline_set_layer_combine (pipeline, 0,
+                                   "RGBA = REPLACE (TEXTURE)",
+                                   NULL);
+}
+
+static void
+record_pipeline_shape (MetaShapedTexture *stex,
+                       const char        *variant)
+{
+  /* Snippets come from the buffers, and can't be recreated without them */
+  if (stex->snippet)
+    return;
+
+  clutter_pipeline_prewarm_record_default ("meta-shaped-texture", variant);
+}
+
+CoglPipeline *
+meta_shaped_texture_create_prewarm_pipeline (CoglContext *ctx,
+                                             const char  *variant)
+{
+  CoglPipeline *pipeline;
+
+  pipeline = create_base_pipeline (ctx);
+  cogl_pipeline_set_layer_null_texture (pipeline, 0);
+
+  if (g_strcmp0 (variant, "masked") == 0)
+    {
+      cogl_pipeline_set_layer_null_texture (pipeline, 1);
+      setup_masked_pipeline (pipeline);
+    }
+  else if (g_strcmp0 (variant, "unblended") == 0)
+    {
+      setup_unblended_pipeline (pipeline);
+    }
+  else if (g_strcmp0 (variant, "unmasked") != 0)
+    {
+      cogl_object_unref (pipeline);
+      return NULL;
+    }
+
+  return pipeline;
+}
+
+static CoglPipeline *
+get_base_pipeline (MetaShapedTexture *stex,
+                   CoglContext       *ctx)
+{
+  CoglPipeline *pipeline;
+  graphene_matrix_t matrix;
+
+  if (stex->base_pipeline)
+    return stex->base_pipeline;
+
+  pipeline = create_base_pipeline (ctx);
+
   graphene_matrix_init_identity (&matrix);
 
   if (stex->has_viewport_src_rect)
@@ -407,6 +479,8 @@ get_unmasked_pipeline (MetaShapedTexture *stex,
       if (stex->snippet)
         cogl_pipeline_add_layer_snippet (pipeline, 0, stex->snippet);
 
+      record_pipeline_shape (stex, "unmasked");
+
       stex->unmasked_pipeline = pipeline;
       return pipeline;
     }
@@ -436,12 +510,12 @@ get_masked_pipeline (MetaShapedTexture *stex,
         return stex->masked_pipeline;
 
       pipeline = cogl_pipeline_copy (get_base_pipeline (stex, ctx));
-      cogl_pipeline_set_layer_combine (pipeline, 1,
-                                       "RGBA = MODULATE (PREVIOUS, TEXTURE[A])",
-                                       NULL);
+      setup_masked_pipeline (pipeline);
       if (stex->snippet)
         cogl_pipeline_add_layer_snippet (pipeline, 0, stex->snippet);
 
+      record_pipeline_shape (stex, "masked");
+
       stex->masked_pipeline = pipeline;
       return pipeline;
     }
@@ -453,9 +527,7 @@ get_masked_pipeline (MetaShapedTexture *stex,
         return stex->masked_tower_pipeline;
 
       pipeline = cogl_pipeline_copy (get_base_pipeline (stex, ctx));
-      cogl_pipeline_set_layer_combine (pipeline, 1,
-                                       "RGBA = MODULATE (PREVIOUS, TEXTURE[A])",
-                                       NULL);
+      setup_masked_pipeline (pipeline);
 
       stex->masked_tower_pipeline = pipeline;
       return pipeline;
@@ -475,12 +547,12 @@ get_unblended_pipeline (MetaShapedTexture *stex,
         return stex->unblended_pipeline;
 
       pipeline = cogl_pipeline_copy (get_base_pipeline (stex, ctx));
-      cogl_pipeline_set_layer_combine (pipeline, 0,
-                                       "RGBA = REPLACE (TEXTURE)",
-                                       NULL);
+      setup_unblended_pipeline (pipeline);
       if (stex->snippet)
         cogl_pipeline_add_layer_snippet (pipeline, 0, stex->snippet);
 
+      record_pipeline_shape (stex, "unblended");
+
       stex->unblended_pipeline = pipeline;
       return pipeline;
     }
@@ -492,9 +564,7 @@ get_unblended_pipeline (MetaShapedTexture *stex,
         return stex->unblended_tower_pipeline;
 
       pipeline = cogl_pipeline_copy (get_base_pipeline (stex, ctx));
-      cogl_pipeline_set_layer_combine (pipeline, 0,
-                                       "RGBA = REPLACE (TEXTURE)",
-                                       NULL);
+      setup_unblended_pipeline (pipeline);
 
       stex->unblended_tower_pipeline = pipeline;
       return pipeline;
@@ -641,6 +711,17 @@ texture_is_idle_and_not_mipmapped (gpointer user_data)
   return G_SOURCE_REMOVE;
 }
 
+static gboolean
+continue_mipmap_update (gpointer user_data)
+{
+  MetaShapedTexture *stex = META_SHAPED_TEXTURE (user_data);
+
+  stex->mipmap_update_id = 0;
+  clutter_content_invalidate (CLUTTER_CONTENT (stex));
+
+  return G_SOURCE_REMOVE;
+}
+
 static inline void
 flip_ints (int *x,
            int *y)
@@ -915,6 +996,13 @@ select_texture_for_paint (MetaShapedTexture   *stex,
         {
           texture = meta_texture_tower_get_paint_texture (stex->paint_tower,
                                                           paint_context);
+
+          if (meta_texture_tower_has_pending_update (stex->paint_tower) &&
+              !stex->mipmap_update_id)
+            {
+              stex->mipmap_update_id = g_idle_add (continue_mipmap_update,
+                                                   stex);
+            }
         }
     }
 
@@ -938,6 +1026,33 @@ select_texture_for_paint (MetaShapedTexture   *stex,
   return texture;
 }
 
+/* Only the painting of the actor itself onto the view is replaced by the
+ * overlay plane; clones, or ancestors redirected offscreen, still need the
+ * content painted.
+ */
+static gboolean
+is_painted_by_overlay (MetaShapedTexture   *stex,
+                       ClutterActor        *actor,
+                       ClutterPaintContext *paint_context)
+{
+  CoglFramebuffer *framebuffer;
+
+  if (!stex->overlay_view)
+    return FALSE;
+
+  if (stex->overlay_view != clutter_paint_context_get_stage_view (paint_context))
+    return FALSE;
+
+  if (clutter_actor_is_in_clone_paint (actor))
+    return FALSE;
+
+  framebuffer = clutter_paint_context_get_framebuffer (paint_context);
+  if (framebuffer != clutter_stage_view_get_framebuffer (stex->overlay_view))
+    return FALSE;
+
+  return TRUE;
+}
+
 static void
 meta_shaped_texture_paint_content (ClutterContent      *content,
                                    ClutterActor        *actor,
@@ -952,6 +1067,9 @@ meta_shaped_texture_paint_content (ClutterContent      *content,
   if (stex->clip_region && cairo_region_is_empty (stex->clip_region))
     return;
 
+  if (is_painted_by_overlay (stex, actor, paint_context))
+    return;
+
   /* The GL EXT_texture_from_pixmap extension does allow for it to be
    * used together with SGIS_generate_mipmap, however this is very
    * rarely supported. Also, even when it is supported there
@@ -1577,6 +1695,31 @@ meta_shaped_texture_get_buffer_scale (MetaShapedTexture *stex)
   return stex->buffer_scale;
 }
 
+/**
+ * meta_shaped_texture_set_overlay_view:
+ * @stex: A #MetaShapedTexture
+ * @view: (nullable): The view the texture is on an overlay plane of
+ *
+ * Sets the stage view on which the content of @stex is scanned out on an
+ * overlay plane, and thus must not be painted.
+ */
+void
+meta_shaped_texture_set_overlay_view (MetaShapedTexture *stex,
+                                      ClutterStageView  *view)
+{
+  g_return_if_fail (META_IS_SHAPED_TEXTURE (stex));
+
+  g_set_weak_pointer (&stex->overlay_view, view);
+}
+
+ClutterStageView *
+meta_shaped_texture_get_overlay_view (MetaShapedTexture *stex)
+{
+  g_return_val_if_fail (META_IS_SHAPED_TEXTURE (stex), NULL);
+
+  return stex->overlay_view;
+}
+
 /**
  * meta_shaped_texture_get_width:
  * @stex: A #MetaShapedTexture
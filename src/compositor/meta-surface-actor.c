@@ -20,6 +20,7 @@
 #include "compositor/meta-surface-actor.h"
 
 #include "clutter/clutter.h"
+#include "clutter/clutter-mutter.h"
 #include "compositor/clutter-utils.h"
 #include "compositor/meta-cullable.h"
 #include "compositor/meta-shaped-texture-private.h"
@@ -519,6 +520,7 @@ meta_surface_actor_set_input_region (MetaSurfaceActor *self,
 {
   MetaSurfaceActorPrivate *priv =
     meta_surface_actor_get_instance_private (self);
+  ClutterActor *stage;
 
   if (priv->input_region)
     cairo_region_destroy (priv->input_region);
@@ -527,6 +529,10 @@ meta_surface_actor_set_input_region (MetaSurfaceActor *self,
     priv->input_region = cairo_region_reference (region);
   else
     priv->input_region = NULL;
+
+  stage = clutter_actor_get_stage (CLUTTER_ACTOR (self));
+  if (stage)
+    clutter_stage_invalidate_pick (CLUTTER_STAGE (stage));
 }
 
 void
@@ -47,24 +47,62 @@
 #define TEXTURE_FORMAT COGL_PIXEL_FORMAT_ARGB_8888_PRE
 #endif
 
-typedef struct
-{
-  guint16 x1;
-  guint16 y1;
-  guint16 x2;
-  guint16 y2;
-} Box;
+/* Levels are regenerated from the level two levels up, sampling 4x4 texels
+ * per destination pixel with four bilinear lookups. The result is the same
+ * as two successive 2x2 box filters, with half the draws. */
+static const char *downsample_glsl_declarations =
+"uniform vec2 pixel_step;\n";
+
+static const char *downsample_glsl =
+"  vec2 uv = vec2 (cogl_tex_coord.st);\n"
+"  cogl_texel = 0.25 * (texture2D (cogl_sampler, uv + pixel_step * vec2 (-1.0, -1.0)) +\n"
+"                       texture2D (cogl_sampler, uv + pixel_step * vec2 (1.0, -1.0)) +\n"
+"                       texture2D (cogl_sampler, uv + pixel_step * vec2 (-1.0, 1.0)) +\n"
+"                       texture2D (cogl_sampler, uv + pixel_step * vec2 (1.0, 1.0)));\n";
+
+/* Invalid regions are simplified to their extents past this */
+#define MAX_INVALID_RECTANGLES 16
+
+/* Number of destination pixels regenerated per paint; what doesn't fit is
+ * regenerated on the following paints */
+#define UPDATE_BUDGET_PIXELS (1024 * 1024)
 
 struct _MetaTextureTower
 {
   int n_levels;
   CoglTexture *textures[MAX_TEXTURE_LEVELS];
   CoglOffscreen *fbos[MAX_TEXTURE_LEVELS];
-  Box invalid[MAX_TEXTURE_LEVELS];
+  CoglPipeline *pipelines[MAX_TEXTURE_LEVELS];
+  cairo_region_t *invalid[MAX_TEXTURE_LEVELS];
+  gboolean is_complete[MAX_TEXTURE_LEVELS];
+  gboolean has_pending_update;
   CoglPipeline *pipeline_template;
+  CoglPipeline *downsample_pipeline_template;
   CoglSnippet *snippet;
 };
 
+static void
+texture_tower_clear_levels (MetaTextureTower *tower)
+{
+  int i;
+
+  for (i = 1; i < MAX_TEXTURE_LEVELS; i++)
+    {
+      cogl_clear_object (&tower->textures[i]);
+      if (tower->fbos[i])
+        {
+          CoglFramebuffer *fb = COGL_FRAMEBUFFER (tower->fbos[i]);
+          CoglContext *ctx = cogl_framebuffer_get_context (fb);
+
+          cogl_offscreen_pool_release (cogl_context_get_offscreen_pool (ctx),
+                                       g_steal_pointer (&tower->fbos[i]));
+        }
+      cogl_clear_object (&tower->pipelines[i]);
+      g_clear_pointer (&tower->invalid[i], cairo_region_destroy);
+      tower->is_complete[i] = FALSE;
+    }
+}
+
 /**
  * meta_texture_tower_new:
  *
@@ -96,6 +134,7 @@ meta_texture_tower_free (MetaTextureTower *tower)
 
   if (tower->pipeline_template != NULL)
     cogl_object_unref (tower->pipeline_template);
+  cogl_clear_object (&tower->downsample_pipeline_template);
 
   meta_texture_tower_set_base_texture (tower, NULL);
   cogl_clear_object (&tower->snippet);
@@ -117,8 +156,6 @@ void
 meta_texture_tower_set_base_texture (MetaTextureTower *tower,
                                      CoglTexture      *texture)
 {
-  int i;
-
   g_return_if_fail (tower != NULL);
 
   if (texture == tower->textures[0])
@@ -126,12 +163,7 @@ meta_texture_tower_set_base_texture (MetaTextureTower *tower,
 
   if (tower->textures[0] != NULL)
     {
-      for (i = 1; i < tower->n_levels; i++)
-        {
-          cogl_clear_object (&tower->textures[i]);
-          g_clear_object (&tower->fbos[i]);
-        }
-
+      texture_tower_clear_levels (tower);
       cogl_object_unref (tower->textures[0]);
     }
 
@@ -157,6 +189,25 @@ meta_texture_tower_set_base_texture (MetaTextureTower *tower,
     }
 }
 
+static void
+get_level_size (MetaTextureTower *tower,
+                int               level,
+                int              *width,
+                int              *height)
+{
+  int i;
+
+  *width = cogl_texture_get_width (tower->textures[0]);
+  *height = cogl_texture_get_height (tower->textures[0]);
+
+  /* Use "floor" convention here to be consistent with the NPOT texture extension */
+  for (i = 1; i <= level; i++)
+    {
+      *width = MAX (1, *width / 2);
+      *height = MAX (1, *height / 2);
+    }
+}
+
 /**
  * meta_texture_tower_update_area:
  * @tower: a #MetaTextureTower
@@ -176,8 +227,7 @@ meta_texture_tower_update_area (MetaTextureTower *tower,
                                 int               width,
                                 int               height)
 {
-  int texture_width, texture_height;
-  Box invalid;
+  int x1, y1, x2, y2;
   int i;
 
   g_return_if_fail (tower != NULL);
@@ -185,35 +235,48 @@ meta_texture_tower_update_area (MetaTextureTower *tower,
   if (tower->textures[0] == NULL)
     return;
 
-  texture_width = cogl_texture_get_width (tower->textures[0]);
-  texture_height = cogl_texture_get_height (tower->textures[0]);
+  x1 = MAX (x, 0);
+  y1 = MAX (y, 0);
+  x2 = x + width;
+  y2 = y + height;
 
-  invalid.x1 = x;
-  invalid.y1 = y;
-  invalid.x2 = x + width;
-  invalid.y2 = y + height;
+  if (x2 <= x1 || y2 <= y1)
+    return;
 
   for (i = 1; i < tower->n_levels; i++)
     {
-      texture_width = MAX (1, texture_width / 2);
-      texture_height = MAX (1, texture_height / 2);
+      cairo_rectangle_int_t rect;
+      int level_width, level_height;
 
-      invalid.x1 = invalid.x1 / 2;
-      invalid.y1 = invalid.y1 / 2;
-      invalid.x2 = MIN (texture_width, (invalid.x2 + 1) / 2);
-      invalid.y2 = MIN (texture_height, (invalid.y2 + 1) / 2);
+      if (!tower->textures[i])
+        continue;
 
-      if (tower->invalid[i].x1 == tower->invalid[i].x2 ||
-          tower->invalid[i].y1 == tower->invalid[i].y2)
-        {
-          tower->invalid[i] = invalid;
-        }
-      else
+      /* A pixel of level i is generated from at most the 2^i x 2^i base
+       * pixels it covers, fewer where the level size was clamped or
+       * rounded down. Round outward, so that pixels only partially covered
+       * by the changed area, at the right and bottom edges of odd sized
+       * levels, are regenerated too. */
+      get_level_size (tower, i, &level_width, &level_height);
+
+      rect.x = x1 >> i;
+      rect.y = y1 >> i;
+      rect.width = MIN (level_width, (x2 + (1 << i) - 1) >> i) - rect.x;
+      rect.height = MIN (level_height, (y2 + (1 << i) - 1) >> i) - rect.y;
+
+      if (rect.width <= 0 || rect.height <= 0)
+        continue;
+
+      if (!tower->invalid[i])
+        tower->invalid[i] = cairo_region_create ();
+
+      cairo_region_union_rectangle (tower->invalid[i], &rect);
+
+      if (cairo_region_num_rectangles (tower->invalid[i]) >
+          MAX_INVALID_RECTANGLES)
         {
-          tower->invalid[i].x1 = MIN (tower->invalid[i].x1, invalid.x1);
-          tower->invalid[i].y1 = MIN (tower->invalid[i].y1, invalid.y1);
-          tower->invalid[i].x2 = MAX (tower->invalid[i].x2, invalid.x2);
-          tower->invalid[i].y2 = MAX (tower->invalid[i].y2, invalid.y2);
+          cairo_region_get_extents (tower->invalid[i], &rect);
+          cairo_region_destroy (tower->invalid[i]);
+          tower->invalid[i] = cairo_region_create_rectangle (&rect);
         }
     }
 }
@@ -222,8 +285,6 @@ void
 meta_texture_tower_set_snippet (MetaTextureTower *tower,
                                 CoglSnippet      *snippet)
 {
-  int i;
-
   if (tower->snippet == snippet)
     return;
 
@@ -232,14 +293,26 @@ meta_texture_tower_set_snippet (MetaTextureTower *tower,
   if (snippet)
     tower->snippet = cogl_object_ref (snippet);
 
-  for (i = 1; i < tower->n_levels; i++)
-    {
-      cogl_clear_object (&tower->textures[i]);
-      g_clear_object (&tower->fbos[i]);
-    }
+  texture_tower_clear_levels (tower);
   cogl_clear_object (&tower->pipeline_template);
 }
 
+/**
+ * meta_texture_tower_has_pending_update:
+ * @tower: a #MetaTextureTower
+ *
+ * Gets whether the last call to meta_texture_tower_get_paint_texture()
+ * left part of the requested level out of date, to stay within its update
+ * budget. The caller should paint again to continue the update.
+ *
+ * Return value: %TRUE if the texture should be painted again
+ */
+gboolean
+meta_texture_tower_has_pending_update (MetaTextureTower *tower)
+{
+  return tower->has_pending_update;
+}
+
 /* It generally looks worse if we scale up a window texture by even a
  * small amount than if we scale it down using bilinear filtering, so
  * we always pick the *larger* adjacent level. */
@@ -377,78 +450,223 @@ get_paint_level (ClutterPaintContext *paint_context,
     return (int)(0.5 + lambda);
 }
 
-static void
+static int
+get_source_level (MetaTextureTower *tower,
+                  int               level)
+{
+  /* The snippet only applies to the base texture, and can't be combined
+   * with the downsampling snippet */
+  if (level > 2 || (level == 2 && !tower->snippet))
+    return level - 2;
+  else
+    return level - 1;
+}
+
+static gboolean
 texture_tower_create_texture (MetaTextureTower *tower,
-                              int               level,
-                              int               width,
-                              int               height)
+                              int               level)
 {
   CoglContext *ctx =
     clutter_backend_get_cogl_context (clutter_get_default_backend ());
+  CoglOffscreenPool *pool = cogl_context_get_offscreen_pool (ctx);
+  cairo_rectangle_int_t rect = { 0 };
+  g_autoptr (GError) error = NULL;
+
+  get_level_size (tower, level, &rect.width, &rect.height);
+
+  /* Levels come and go with windows being scaled, e.g. in the overview, so
+   * draw their framebuffers from the pool rather than allocating new ones */
+  tower->fbos[level] = cogl_offscreen_pool_acquire (pool,
+                                                    rect.width, rect.height,
+                                                    COGL_TEXTURE_COMPONENTS_RGBA,
+                                                    &error);
+  if (!tower->fbos[level])
+    {
+      g_warning ("Failed to create texture tower level: %s", error->message);
+      return FALSE;
+    }
 
   tower->textures[level] =
-    COGL_TEXTURE (cogl_texture_2d_new_with_size (ctx, width, height));
+    cogl_object_ref (cogl_offscreen_get_texture (tower->fbos[level]));
+
+  g_clear_pointer (&tower->invalid[level], cairo_region_destroy);
+  tower->invalid[level] = cairo_region_create_rectangle (&rect);
+  tower->is_complete[level] = FALSE;
 
-  tower->invalid[level].x1 = 0;
-  tower->invalid[level].y1 = 0;
-  tower->invalid[level].x2 = width;
-  tower->invalid[level].y2 = height;
+  return TRUE;
 }
 
-static void
+static gboolean
+texture_tower_ensure_textures (MetaTextureTower *tower,
+                               int               level)
+{
+  while (level > 0)
+    {
+      if (tower->textures[level] == NULL &&
+          !texture_tower_create_texture (tower, level))
+        return FALSE;
+
+      level = get_source_level (tower, level);
+    }
+
+  return TRUE;
+}
+
+static CoglPipeline *
+get_level_pipeline (MetaTextureTower *tower,
+                    int               level)
+{
+  CoglContext *ctx =
+    clutter_backend_get_cogl_context (clutter_get_default_backend ());
+  int source_level = get_source_level (tower, level);
+  CoglPipeline *pipeline;
+
+  if (tower->pipelines[level])
+    return tower->pipelines[level];
+
+  if (level - source_level == 2)
+    {
+      int source_width, source_height;
+      float pixel_step[2];
+
+      if (!tower->downsample_pipeline_template)
+        {
+          CoglSnippet *snippet;
+
+          tower->downsample_pipeline_template = cogl_pipeline_new (ctx);
+          cogl_pipeline_set_blend (tower->downsample_pipeline_template,
+                                   "RGBA = ADD (SRC_COLOR, 0)", NULL);
+
+          snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_TEXTURE_LOOKUP,
+                                      downsample_glsl_declarations,
+                                      NULL);
+          cogl_snippet_set_replace (snippet, downsample_glsl);
+          cogl_pipeline_add_layer_snippet (tower->downsample_pipeline_template,
+                                           0, snippet);
+          cogl_object_unref (snippet);
+        }
+
+      pipeline = cogl_pipeline_copy (tower->downsample_pipeline_template);
+
+      get_level_size (tower, source_level, &source_width, &source_height);
+      pixel_step[0] = 1.0f / source_width;
+      pixel_step[1] = 1.0f / source_height;
+      cogl_pipeline_set_uniform_float (pipeline,
+                                       cogl_pipeline_get_uniform_location (pipeline,
+                                                                           "pixel_step"),
+                                       2, 1, pixel_step);
+    }
+  else
+    {
+      if (!tower->pipeline_template)
+        {
+          tower->pipeline_template = cogl_pipeline_new (ctx);
+          cogl_pipeline_set_blend (tower->pipeline_template,
+                                   "RGBA = ADD (SRC_COLOR, 0)", NULL);
+        }
+
+      pipeline = cogl_pipeline_copy (tower->pipeline_template);
+
+      if (tower->snippet && source_level == 0)
+        cogl_pipeline_add_layer_snippet (pipeline, 0, tower->snippet);
+    }
+
+  cogl_pipeline_set_layer_texture (pipeline, 0, tower->textures[source_level]);
+
+  tower->pipelines[level] = pipeline;
+  return pipeline;
+}
+
+static gboolean
 texture_tower_revalidate (MetaTextureTower *tower,
-                          int               level)
+                          int               level,
+                          int              *budget)
 {
-  CoglTexture *source_texture = tower->textures[level - 1];
-  int source_texture_width = cogl_texture_get_width (source_texture);
-  int source_texture_height = cogl_texture_get_height (source_texture);
-  CoglTexture *dest_texture = tower->textures[level];
-  int dest_texture_width = cogl_texture_get_width (dest_texture);
-  int dest_texture_height = cogl_texture_get_height (dest_texture);
-  Box *invalid = &tower->invalid[level];
+  int source_level;
+  int source_width, source_height;
+  int dest_width, dest_height;
+  float scale_x, scale_y;
+  cairo_region_t *invalid = tower->invalid[level];
+  g_autofree float *coords = NULL;
   CoglFramebuffer *fb;
-  GError *catch_error = NULL;
   CoglPipeline *pipeline;
+  int n_rects, n_drawn_rects;
+  int i;
+
+  if (level == 0 || !invalid || cairo_region_is_empty (invalid))
+    return TRUE;
+
+  /* The whole source needs to be up to date, as its invalid region might
+   * extend past the scaled up invalid region of this level */
+  source_level = get_source_level (tower, level);
+  if (!texture_tower_revalidate (tower, source_level, budget))
+    return FALSE;
 
-  if (tower->fbos[level] == NULL)
-    tower->fbos[level] = cogl_offscreen_new_with_texture (dest_texture);
+  if (*budget <= 0)
+    return FALSE;
 
   fb = COGL_FRAMEBUFFER (tower->fbos[level]);
 
-  if (!cogl_framebuffer_allocate (fb, &catch_error))
-    {
-      g_error_free (catch_error);
-      return;
-    }
+  get_level_size (tower, source_level, &source_width, &source_height);
+  get_level_size (tower, level, &dest_width, &dest_height);
+
+  cogl_framebuffer_orthographic (fb, 0, 0, dest_width, dest_height, -1., 1.);
 
-  cogl_framebuffer_orthographic (fb, 0, 0, dest_texture_width, dest_texture_height, -1., 1.);
+  pipeline = get_level_pipeline (tower, level);
 
-  if (!tower->pipeline_template)
+  /* Where a level size was clamped to 1, its pixels cover less than the
+   * full scale factor of the source, and sampling past it would wrap */
+  scale_x = MIN (1 << (level - source_level),
+                 (float) source_width / dest_width);
+  scale_y = MIN (1 << (level - source_level),
+                 (float) source_height / dest_height);
+
+  /* Draw as many rectangles as the budget allows, in one batch */
+  n_rects = cairo_region_num_rectangles (invalid);
+  coords = g_new (float, n_rects * 8);
+
+  for (n_drawn_rects = 0; n_drawn_rects < n_rects; n_drawn_rects++)
     {
-      CoglContext *ctx =
-        clutter_backend_get_cogl_context (clutter_get_default_backend ());
-      tower->pipeline_template = cogl_pipeline_new (ctx);
-      cogl_pipeline_set_blend (tower->pipeline_template, "RGBA = ADD (SRC_COLOR, 0)", NULL);
-    }
+      cairo_rectangle_int_t rect;
+      float *rect_coords = &coords[n_drawn_rects * 8];
+
+      if (*budget <= 0)
+        break;
 
-  pipeline = cogl_pipeline_copy (tower->pipeline_template);
-  cogl_pipeline_set_layer_texture (pipeline, 0, tower->textures[level - 1]);
+      cairo_region_get_rectangle (invalid, n_drawn_rects, &rect);
+
+      rect_coords[0] = rect.x;
+      rect_coords[1] = rect.y;
+      rect_coords[2] = rect.x + rect.width;
+      rect_coords[3] = rect.y + rect.height;
+      rect_coords[4] = (scale_x * rect.x) / source_width;
+      rect_coords[5] = (scale_y * rect.y) / source_height;
+      rect_coords[6] = (scale_x * (rect.x + rect.width)) / source_width;
+      rect_coords[7] = (scale_y * (rect.y + rect.height)) / source_height;
+
+      *budget -= rect.width * rect.height;
+    }
 
-  if (tower->snippet && level == 1)
-    cogl_pipeline_add_layer_snippet (pipeline, 0, tower->snippet);
+  cogl_framebuffer_draw_textured_rectangles (fb, pipeline,
+                                             coords, n_drawn_rects);
 
-  cogl_framebuffer_draw_textured_rectangle (fb, pipeline,
-                                            invalid->x1, invalid->y1,
-                                            invalid->x2, invalid->y2,
-                                            (2. * invalid->x1) / source_texture_width,
-                                            (2. * invalid->y1) / source_texture_height,
-                                            (2. * invalid->x2) / source_texture_width,
-                                            (2. * invalid->y2) / source_texture_height);
+  for (i = 0; i < n_drawn_rects; i++)
+    {
+      cairo_rectangle_int_t rect = {
+        .x = coords[i * 8 + 0],
+        .y = coords[i * 8 + 1],
+        .width = coords[i * 8 + 2] - coords[i * 8 + 0],
+        .height = coords[i * 8 + 3] - coords[i * 8 + 1],
+      };
+
+      cairo_region_subtract_rectangle (invalid, &rect);
+    }
 
-  cogl_object_unref (pipeline);
+  if (!cairo_region_is_empty (invalid))
+    return FALSE;
 
-  tower->invalid[level].x1 = tower->invalid[level].x2 = 0;
-  tower->invalid[level].y1 = tower->invalid[level].y2 = 0;
+  tower->is_complete[level] = TRUE;
+  return TRUE;
 }
 
 /**
@@ -485,27 +703,25 @@ meta_texture_tower_get_paint_texture (MetaTextureTower    *tower,
     return NULL;
   level = MIN (level, tower->n_levels - 1);
 
-  if (tower->textures[level] == NULL ||
-      (tower->invalid[level].x2 != tower->invalid[level].x1 &&
-       tower->invalid[level].y2 != tower->invalid[level].y1))
-    {
-      int i;
+  tower->has_pending_update = FALSE;
 
-      for (i = 1; i <= level; i++)
-        {
-          /* Use "floor" convention here to be consistent with the NPOT texture extension */
-          texture_width = MAX (1, texture_width / 2);
-          texture_height = MAX (1, texture_height / 2);
+  if (level > 0)
+    {
+      int budget = UPDATE_BUDGET_PIXELS;
 
-          if (tower->textures[i] == NULL)
-            texture_tower_create_texture (tower, i, texture_width, texture_height);
-        }
+      /* Without all the levels needed to generate this one, paint the
+       * base texture scaled down instead */
+      if (!texture_tower_ensure_textures (tower, level))
+        return tower->textures[0];
 
-      for (i = 1; i <= level; i++)
+      if (!texture_tower_revalidate (tower, level, &budget))
         {
-          if (tower->invalid[level].x2 != tower->invalid[level].x1 &&
-              tower->invalid[level].y2 != tower->invalid[level].y1)
-            texture_tower_revalidate (tower, i);
+          /* If out of budget, continue on the next paint, and paint what
+           * was there before in the meantime */
+          tower->has_pending_update = budget <= 0;
+
+          if (!tower->is_complete[level])
+            return NULL;
         }
     }
 
@@ -24,6 +24,7 @@
 #define __META_TEXTURE_TOWER_H__
 
 #include "clutter/clutter.h"
+#include "core/util-private.h"
 
 G_BEGIN_DECLS
 
@@ -47,25 +48,38 @@ G_BEGIN_DECLS
  * that best matches the scale we are rendering at. (Since we aren't
  * typically using perspective transforms, we'll frequently have a single
  * scale for the entire texture.)
+ *
+ * Each level keeps track of the region that changed since it was last
+ * updated, and only that region is regenerated, from the level two levels
+ * up where possible. To avoid stalls when a lot changed at once, updates
+ * are spread over several paints; see meta_texture_tower_has_pending_update().
  */
 
 typedef struct _MetaTextureTower MetaTextureTower;
 
+META_EXPORT_TEST
 MetaTextureTower *meta_texture_tower_new               (void);
+META_EXPORT_TEST
 void              meta_texture_tower_free              (MetaTextureTower *tower);
+META_EXPORT_TEST
 void              meta_texture_tower_set_base_texture  (MetaTextureTower *tower,
                                                         CoglTexture      *texture);
+META_EXPORT_TEST
 void              meta_texture_tower_update_area       (MetaTextureTower *tower,
                                                         int               x,
                                                         int               y,
                                                         int               width,
                                                         int               height);
+META_EXPORT_TEST
 CoglTexture      *meta_texture_tower_get_paint_texture (MetaTextureTower    *tower,
                                                         ClutterPaintContext *paint_context);
 
 void meta_texture_tower_set_snippet (MetaTextureTower *tower,
                                      CoglSnippet      *snippet);
 
+META_EXPORT_TEST
+gboolean meta_texture_tower_has_pending_update (MetaTextureTower *tower);
+
 G_END_DECLS
 
 #endif /* __META_TEXTURE_TOWER_H__ */
@@ -1429,6 +1429,7 @@ meta_window_actor_notify_damaged (MetaWindowActor *window_actor)
 static CoglFramebuffer *
 create_framebuffer_from_window_actor (MetaWindowActor  *self,
                                       MetaRectangle    *clip,
+                                      gboolean          pooled,
                                       GError          **error)
 {
   ClutterActor *actor = CLUTTER_ACTOR (self);
@@ -1445,24 +1446,41 @@ create_framebuffer_from_window_actor (MetaWindowActor  *self,
 
   resource_scale = clutter_actor_get_resource_scale (actor);
 
-  texture = cogl_texture_2d_new_with_size (cogl_context,
-                                           clip->width * resource_scale,
-                                           clip->height * resource_scale);
-  if (!texture)
-    return NULL;
+  if (pooled)
+    {
+      CoglOffscreenPool *pool = cogl_context_get_offscreen_pool (cogl_context);
 
-  cogl_primitive_texture_set_auto_mipmap (COGL_PRIMITIVE_TEXTURE (texture),
-                                          FALSE);
+      offscreen = cogl_offscreen_pool_acquire (pool,
+                                               clip->width * resource_scale,
+                                               clip->height * resource_scale,
+                                               COGL_TEXTURE_COMPONENTS_RGBA,
+                                               error);
+      if (!offscreen)
+        return NULL;
 
-  offscreen = cogl_offscreen_new_with_texture (COGL_TEXTURE (texture));
-  framebuffer = COGL_FRAMEBUFFER (offscreen);
+      framebuffer = COGL_FRAMEBUFFER (offscreen);
+    }
+  else
+    {
+      texture = cogl_texture_2d_new_with_size (cogl_context,
+                                               clip->width * resource_scale,
+                                               clip->height * resource_scale);
+      if (!texture)
+        return NULL;
 
-  cogl_object_unref (texture);
+      cogl_primitive_texture_set_auto_mipmap (COGL_PRIMITIVE_TEXTURE (texture),
+                                              FALSE);
 
-  if (!cogl_framebuffer_allocate (framebuffer, error))
-    {
-      g_object_unref (framebuffer);
-      return NULL;
+      offscreen = cogl_offscreen_new_with_texture (COGL_TEXTURE (texture));
+      framebuffer = COGL_FRAMEBUFFER (offscreen);
+
+      cogl_object_unref (texture);
+
+      if (!cogl_framebuffer_allocate (framebuffer, error))
+        {
+          g_object_unref (framebuffer);
+          return NULL;
+        }
     }
 
   cogl_color_init_from_4ub (&clear_color, 0, 0, 0, 0);
@@ -1501,6 +1519,7 @@ meta_window_actor_get_image (MetaWindowActor *self,
   ClutterActor *actor = CLUTTER_ACTOR (self);
   MetaShapedTexture *stex;
   cairo_surface_t *surface = NULL;
+  CoglContext *cogl_context;
   CoglFramebuffer *framebuffer;
   MetaRectangle framebuffer_clip;
   float resource_scale;
@@ -1564,8 +1583,11 @@ meta_window_actor_get_image (MetaWindowActor *self,
       framebuffer_clip = intersected_clip;
     }
 
+  /* The framebuffer is only read back, so it can be reused by later
+   * captures, e.g. every frame of a window screencast */
   framebuffer = create_framebuffer_from_window_actor (self,
                                                       &framebuffer_clip,
+                                                      TRUE,
                                                       NULL);
   if (!framebuffer)
     goto out;
@@ -1583,7 +1605,9 @@ meta_window_actor_get_image (MetaWindowActor *self,
                                 CLUTTER_CAIRO_FORMAT_ARGB32,
                                 cairo_image_surface_get_data (surface));
 
-  g_object_unref (framebuffer);
+  cogl_context = cogl_framebuffer_get_context (framebuffer);
+  cogl_offscreen_pool_release (cogl_context_get_offscreen_pool (cogl_context),
+                               COGL_OFFSCREEN (framebuffer));
 
   cairo_surface_mark_dirty (surface);
 
@@ -1644,8 +1668,10 @@ meta_window_actor_paint_to_content (MetaWindowActor  *self,
       framebuffer_clip = tmp_clip;
     }
 
+  /* The texture outlives the framebuffer, so don't use the pool */
   framebuffer = create_framebuffer_from_window_actor (self,
                                                       &framebuffer_clip,
+                                                      FALSE,
                                                       error);
   if (!framebuffer)
     goto out;
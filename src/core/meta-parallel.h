@@ -0,0 +1,48 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * Copyright 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef META_PARALLEL_H
+#define META_PARALLEL_H
+
+#include <glib.h>
+
+typedef void (* MetaParallelFunc) (int      first,
+                                   int      n_items,
+                                   gpointer user_data);
+
+typedef struct _MetaJobQueue MetaJobQueue;
+
+int meta_parallel_get_max_tasks (void);
+
+void meta_parallel_for (int              n_items,
+                        int              n_tasks,
+                        MetaParallelFunc func,
+                        gpointer         user_data);
+
+MetaJobQueue * meta_job_queue_new (GFunc    func,
+                                   gpointer user_data);
+
+void meta_job_queue_free (MetaJobQueue *queue);
+
+void meta_job_queue_push (MetaJobQueue *queue,
+                          gpointer      job);
+
+void meta_job_queue_flush (MetaJobQueue *queue);
+
+#endif /* META_PARALLEL_H */
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "tests/background-image-tests.h"
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib/gstdio.h>
+
+#include "compositor/meta-background-image-private.h"
+
+#define IMAGE_WIDTH 256
+#define IMAGE_HEIGHT 128
+
+static GFile *
+create_image_file (const char *dir,
+                   const char *name)
+{
+  g_autoptr (GdkPixbuf) pixbuf = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *path = NULL;
+  guchar *pixels;
+  int rowstride;
+  int x, y;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                           IMAGE_WIDTH, IMAGE_HEIGHT);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  for (y = 0; y < IMAGE_HEIGHT; y++)
+    {
+      for (x = 0; x < IMAGE_WIDTH; x++)
+        {
+          guchar *p = pixels + y * rowstride + x * 4;
+
+          p[0] = x;
+          p[1] = y;
+          p[2] = x ^ y;
+          p[3] = 0xff - y;
+        }
+    }
+
+  path = g_build_filename (dir, name, NULL);
+  gdk_pixbuf_save (pixbuf, path, "png", &error, NULL);
+  g_assert_no_error (error);
+
+  return g_file_new_for_path (path);
+}
+
+static void
+wait_for_loaded (MetaBackgroundImage *image)
+{
+  while (!meta_background_image_is_loaded (image))
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+on_scaled_texture_ready (MetaBackgroundImage *image,
+                         gboolean            *ready)
+{
+  *ready = TRUE;
+}
+
+static void
+assert_texture_size (CoglTexture *texture,
+                     int          width,
+                     int          height)
+{
+  g_assert_nonnull (texture);
+  g_assert_cmpint (cogl_texture_get_width (texture), ==, width);
+  g_assert_cmpint (cogl_texture_get_height (texture), ==, height);
+}
+
+static void
+meta_test_background_image_scaled_size (void)
+{
+  int width, height;
+
+  /* A 6K image on a 1080p monitor covers it without being magnified */
+  g_assert_true (meta_background_image_calculate_scaled_size (6016, 3384,
+                                                              1920, 1080,
+                                                              &width, &height));
+  g_assert_cmpint (width, ==, 1920);
+  g_assert_cmpint (height, ==, 1080);
+
+  g_assert_true (meta_background_image_calculate_scaled_size (6000, 4000,
+                                                              1920, 1080,
+                                                              &width, &height));
+  g_assert_cmpint (width, ==, 1920);
+  g_assert_cmpint (height, ==, 1280);
+
+  /* Barely larger images aren't worth scaling */
+  g_assert_false (meta_background_image_calculate_scaled_size (2560, 1440,
+                                                               2048, 1152,
+                                                               &width, &height));
+  g_assert_false (meta_background_image_calculate_scaled_size (1024, 768,
+                                                               3840, 2160,
+                                                               &width, &height));
+}
+
+static void
+meta_test_background_image_cache (void)
+{
+  MetaBackgroundImageCache *cache = meta_background_image_cache_get_default ();
+  g_autoptr (GError) error = NULL;
+  g_autofree char *dir = NULL;
+  g_autoptr (GFile) file1 = NULL;
+  g_autoptr (GFile) file2 = NULL;
+  MetaBackgroundImage *image1;
+  MetaBackgroundImage *image2;
+  CoglTexture *texture;
+  gboolean scaled_texture_ready = FALSE;
+
+  dir = g_dir_make_tmp ("mutter-background-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  file1 = create_image_file (dir, "image1.png");
+  file2 = create_image_file (dir, "image2.png");
+
+  /* Sizes requested while loading are usually scaled by the loading thread,
+   * unless it already got past that point */
+  image1 = meta_background_image_cache_load (cache, file1);
+  meta_background_image_request_scaled (image1, 64, 16);
+  wait_for_loaded (image1);
+
+  g_assert_true (meta_background_image_get_success (image1));
+  texture = meta_background_image_get_texture (image1);
+  assert_texture_size (texture, IMAGE_WIDTH, IMAGE_HEIGHT);
+
+  while (!meta_background_image_get_scaled_texture (image1, 64, 16))
+    g_main_context_iteration (NULL, TRUE);
+
+  assert_texture_size (meta_background_image_get_scaled_texture (image1,
+                                                                 64, 16),
+                       64, 32);
+
+  /* Files with the same contents share their textures */
+  image2 = meta_background_image_cache_load (cache, file2);
+  wait_for_loaded (image2);
+  g_assert_true (meta_background_image_get_texture (image2) == texture);
+
+  /* Sizes requested later are scaled asynchronously */
+  g_signal_connect (image2, "scaled-texture-ready",
+                    G_CALLBACK (on_scaled_texture_ready),
+                    &scaled_texture_ready);
+  meta_background_image_request_scaled (image2, 32, 96);
+  g_assert_null (meta_background_image_get_scaled_texture (image2, 32, 96));
+
+  while (!scaled_texture_ready)
+    g_main_context_iteration (NULL, TRUE);
+
+  assert_texture_size (meta_background_image_get_scaled_texture (image2,
+                                                                 32, 96),
+                       192, 96);
+  assert_texture_size (meta_background_image_get_scaled_texture (image2,
+                                                                 64, 16),
+                       64, 32);
+
+  /* Sizes close to the image size use the full size texture */
+  meta_background_image_request_scaled (image1, 250, 100);
+  g_assert_null (meta_background_image_get_scaled_texture (image1, 250, 100));
+  meta_background_image_release_scaled (image1, 250, 100);
+
+  meta_background_image_release_scaled (image1, 64, 16);
+  meta_background_image_release_scaled (image2, 32, 96);
+  g_assert_null (meta_background_image_get_scaled_texture (image2, 32, 96));
+
+  meta_background_image_cache_purge (cache, file1);
+  meta_background_image_cache_purge (cache, file2);
+  g_object_unref (image1);
+  g_object_unref (image2);
+
+  g_assert_cmpint (g_unlink (g_file_peek_path (file1)), ==, 0);
+  g_assert_cmpint (g_unlink (g_file_peek_path (file2)), ==, 0);
+  g_assert_cmpint (g_rmdir (dir), ==, 0);
+}
+
+void
+init_background_image_tests (void)
+{
+  g_test_add_func ("/compositor/background-image/scaled-size",
+                   meta_test_background_image_scaled_size);
+  g_test_add_func ("/compositor/background-image/cache",
+                   meta_test_background_image_cache);
+}
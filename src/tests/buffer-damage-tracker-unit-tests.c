@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "backends/native/meta-buffer-damage-tracker.h"
+
+static cairo_region_t *
+create_region (int x,
+               int y,
+               int width,
+               int height)
+{
+  cairo_rectangle_int_t rect = {
+    .x = x,
+    .y = y,
+    .width = width,
+    .height = height,
+  };
+
+  return cairo_region_create_rectangle (&rect);
+}
+
+static void
+assert_update_region (MetaBufferDamageTracker *tracker,
+                      int                      index,
+                      const cairo_region_t    *damage,
+                      const cairo_region_t    *expected_region)
+{
+  cairo_region_t *update_region;
+
+  update_region = meta_buffer_damage_tracker_get_update_region (tracker,
+                                                                index,
+                                                                damage);
+  if (!expected_region)
+    {
+      g_assert_null (update_region);
+      return;
+    }
+
+  g_assert_nonnull (update_region);
+  g_assert_true (cairo_region_equal (update_region, expected_region));
+  cairo_region_destroy (update_region);
+}
+
+static void
+meta_test_buffer_damage_tracker_initial (void)
+{
+  MetaBufferDamageTracker *tracker;
+  cairo_region_t *damage;
+
+  tracker = meta_buffer_damage_tracker_new (2);
+  damage = create_region (10, 10, 20, 20);
+
+  /* Nothing was written into the buffers yet */
+  assert_update_region (tracker, 0, damage, NULL);
+  assert_update_region (tracker, 1, damage, NULL);
+
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, NULL);
+
+  assert_update_region (tracker, 0, NULL, NULL);
+  assert_update_region (tracker, 0, damage, damage);
+  assert_update_region (tracker, 1, damage, NULL);
+
+  cairo_region_destroy (damage);
+  meta_buffer_damage_tracker_free (tracker);
+}
+
+static void
+meta_test_buffer_damage_tracker_buffer_ages (void)
+{
+  MetaBufferDamageTracker *tracker;
+  cairo_region_t *no_damage;
+  cairo_region_t *damages[4];
+  cairo_region_t *expected_region;
+  int i;
+
+  tracker = meta_buffer_damage_tracker_new (3);
+  no_damage = cairo_region_create ();
+
+  for (i = 0; i < G_N_ELEMENTS (damages); i++)
+    damages[i] = create_region (i * 10, i * 5, 10, 5);
+
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, NULL);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 1, no_damage);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 2, no_damage);
+
+  /* Age 1: the buffer was written by the previous frame, so only the
+   * current damage is out of date */
+  assert_update_region (tracker, 2, damages[0], damages[0]);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 2, damages[0]);
+
+  /* Age 2: it missed the previous frame */
+  expected_region = cairo_region_copy (damages[0]);
+  cairo_region_union (expected_region, damages[1]);
+  assert_update_region (tracker, 1, damages[1], expected_region);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 1, damages[1]);
+  cairo_region_destroy (expected_region);
+
+  /* Age 4: it missed the last three frames */
+  meta_buffer_damage_tracker_buffer_updated (tracker, 2, damages[2]);
+
+  expected_region = cairo_region_copy (damages[0]);
+  cairo_region_union (expected_region, damages[1]);
+  cairo_region_union (expected_region, damages[2]);
+  cairo_region_union (expected_region, damages[3]);
+  assert_update_region (tracker, 0, damages[3], expected_region);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, damages[3]);
+  cairo_region_destroy (expected_region);
+
+  /* Age 3, after having been written itself in between */
+  expected_region = cairo_region_copy (damages[2]);
+  cairo_region_union (expected_region, damages[3]);
+  cairo_region_union (expected_region, damages[0]);
+  assert_update_region (tracker, 1, damages[0], expected_region);
+  cairo_region_destroy (expected_region);
+
+  for (i = 0; i < G_N_ELEMENTS (damages); i++)
+    cairo_region_destroy (damages[i]);
+  cairo_region_destroy (no_damage);
+  meta_buffer_damage_tracker_free (tracker);
+}
+
+static void
+meta_test_buffer_damage_tracker_full_damage (void)
+{
+  MetaBufferDamageTracker *tracker;
+  cairo_region_t *no_damage;
+  cairo_region_t *damage;
+
+  tracker = meta_buffer_damage_tracker_new (2);
+  no_damage = cairo_region_create ();
+  damage = create_region (0, 0, 10, 10);
+
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, NULL);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 1, no_damage);
+  assert_update_region (tracker, 0, damage, damage);
+
+  /* A frame without damage information makes every other buffer entirely
+   * stale, until it is written as a whole again */
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, NULL);
+  assert_update_region (tracker, 1, damage, NULL);
+
+  meta_buffer_damage_tracker_buffer_updated (tracker, 1, damage);
+  assert_update_region (tracker, 1, damage, damage);
+  assert_update_region (tracker, 0, damage, damage);
+
+  cairo_region_destroy (damage);
+  cairo_region_destroy (no_damage);
+  meta_buffer_damage_tracker_free (tracker);
+}
+
+static void
+meta_test_buffer_damage_tracker_invalidate (void)
+{
+  MetaBufferDamageTracker *tracker;
+  cairo_region_t *no_damage;
+  cairo_region_t *damages[2];
+  cairo_region_t *expected_region;
+
+  tracker = meta_buffer_damage_tracker_new (2);
+  no_damage = cairo_region_create ();
+  damages[0] = create_region (0, 0, 10, 10);
+  damages[1] = create_region (20, 20, 10, 10);
+
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, NULL);
+  meta_buffer_damage_tracker_buffer_updated (tracker, 1, no_damage);
+
+  /* A failed update leaves the buffer entirely stale, while the damage it
+   * carried is still missed by the other buffer */
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, damages[0]);
+  meta_buffer_damage_tracker_invalidate (tracker, 0);
+  assert_update_region (tracker, 0, damages[1], NULL);
+
+  expected_region = cairo_region_copy (damages[0]);
+  cairo_region_union (expected_region, damages[1]);
+  assert_update_region (tracker, 1, damages[1], expected_region);
+  cairo_region_destroy (expected_region);
+
+  /* Once written as a whole, it is tracked again */
+  meta_buffer_damage_tracker_buffer_updated (tracker, 0, damages[1]);
+  assert_update_region (tracker, 0, damages[0], damages[0]);
+
+  cairo_region_destroy (damages[0]);
+  cairo_region_destroy (damages[1]);
+  cairo_region_destroy (no_damage);
+  meta_buffer_damage_tracker_free (tracker);
+}
+
+static void
+init_buffer_damage_tracker_tests (void)
+{
+  g_test_add_func ("/backends/native/buffer-damage-tracker/initial",
+                   meta_test_buffer_damage_tracker_initial);
+  g_test_add_func ("/backends/native/buffer-damage-tracker/buffer-ages",
+                   meta_test_buffer_damage_tracker_buffer_ages);
+  g_test_add_func ("/backends/native/buffer-damage-tracker/full-damage",
+                   meta_test_buffer_damage_tracker_full_damage);
+  g_test_add_func ("/backends/native/buffer-damage-tracker/invalidate",
+                   meta_test_buffer_damage_tracker_invalidate);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+  init_buffer_damage_tracker_tests ();
+  return g_test_run ();
+}
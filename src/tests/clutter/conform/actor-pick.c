@@ -22,6 +22,47 @@ struct _State
   GList *actor_list;
 };
 
+typedef struct _PickCounter
+{
+  ClutterActor parent;
+
+  int n_picks;
+} PickCounter;
+
+typedef struct _PickCounterClass
+{
+  ClutterActorClass parent_class;
+} PickCounterClass;
+
+static GType pick_counter_get_type (void);
+
+G_DEFINE_TYPE (PickCounter, pick_counter, CLUTTER_TYPE_ACTOR)
+
+static void
+pick_counter_pick (ClutterActor       *actor,
+                   ClutterPickContext *pick_context)
+{
+  PickCounter *counter = (PickCounter *) actor;
+
+  counter->n_picks++;
+
+  CLUTTER_ACTOR_CLASS (pick_counter_parent_class)->pick (actor, pick_context);
+}
+
+static void
+pick_counter_class_init (PickCounterClass *klass)
+{
+  ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
+
+  actor_class->pick = pick_counter_pick;
+}
+
+static void
+pick_counter_init (PickCounter *counter)
+{
+  clutter_actor_set_reactive (CLUTTER_ACTOR (counter), TRUE);
+}
+
 static const char *test_passes[] = {
   "No covering actor",
   "Invisible covering actor",
@@ -223,6 +264,84 @@ actor_pick (void)
   g_list_free_full (state.actor_list, (GDestroyNotify) clutter_actor_destroy);
 }
 
+static ClutterActor *
+pick_at (ClutterActor *stage,
+         float         x,
+         float         y)
+{
+  return clutter_stage_get_actor_at_pos (CLUTTER_STAGE (stage),
+                                         CLUTTER_PICK_REACTIVE,
+                                         x, y);
+}
+
+static gboolean
+on_retained_idle (gpointer data)
+{
+  PickCounter *counter = data;
+  ClutterActor *actor = CLUTTER_ACTOR (counter);
+  ClutterActor *stage = clutter_actor_get_stage (actor);
+  int i;
+
+  g_assert_true (pick_at (stage, 10, 10) == actor);
+  g_assert_cmpint (counter->n_picks, ==, 1);
+
+  /* An actor that keeps redrawing without changing anything that affects
+   * picking doesn't make the stage traverse the scene again */
+  for (i = 0; i < 10; i++)
+    {
+      clutter_actor_queue_redraw (actor);
+      g_assert_true (pick_at (stage, 10, 10) == actor);
+    }
+  g_assert_cmpint (counter->n_picks, ==, 1);
+
+  clutter_actor_set_translation (actor, 100, 100, 0);
+  g_assert_true (pick_at (stage, 10, 10) == stage);
+  g_assert_true (pick_at (stage, 110, 110) == actor);
+  g_assert_cmpint (counter->n_picks, ==, 2);
+
+  clutter_actor_set_clip (actor, 0, 0, 5, 5);
+  g_assert_true (pick_at (stage, 110, 110) == stage);
+  g_assert_cmpint (counter->n_picks, ==, 3);
+  clutter_actor_remove_clip (actor);
+
+  clutter_actor_set_reactive (actor, FALSE);
+  g_assert_true (pick_at (stage, 110, 110) == stage);
+  g_assert_cmpint (counter->n_picks, ==, 4);
+  clutter_actor_set_reactive (actor, TRUE);
+
+  clutter_actor_hide (actor);
+  g_assert_true (pick_at (stage, 110, 110) == stage);
+  g_assert_cmpint (counter->n_picks, ==, 4);
+
+  clutter_actor_show (actor);
+  g_assert_true (pick_at (stage, 110, 110) == actor);
+  g_assert_cmpint (counter->n_picks, ==, 5);
+
+  clutter_test_quit ();
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+actor_pick_retained (void)
+{
+  ClutterActor *stage = clutter_test_get_stage ();
+  ClutterActor *actor;
+
+  actor = g_object_new (pick_counter_get_type (), NULL);
+  clutter_actor_set_size (actor, 50, 50);
+  clutter_actor_add_child (stage, actor);
+
+  clutter_actor_show (stage);
+
+  clutter_threads_add_idle (on_retained_idle, actor);
+
+  clutter_test_main ();
+
+  clutter_actor_destroy (actor);
+}
+
 CLUTTER_TEST_SUITE (
   CLUTTER_TEST_UNIT ("/actor/pick", actor_pick)
+  CLUTTER_TEST_UNIT ("/actor/pick/retained", actor_pick_retained)
 )
@@ -0,0 +1,168 @@
+#include <clutter/clutter.h>
+
+#include "clutter/clutter-blur-private.h"
+#include "tests/clutter-test-utils.h"
+
+#define MAX_OFFSET 2.5f
+#define TEXTURE_SIZE 32
+
+static void
+blur_dual_kawase_levels (void)
+{
+  float offset;
+  float sigma;
+  int prev_n_levels = 0;
+  int n_levels;
+
+  n_levels = clutter_blur_calculate_dual_kawase_levels (0.f, 3840, 2160,
+                                                        &offset);
+  g_assert_cmpint (n_levels, ==, 0);
+  g_assert_cmpfloat (offset, ==, 0.f);
+
+  /* Levels grow with sigma, and the approximated sigma matches */
+  for (sigma = 0.5f; sigma <= 60.f; sigma += 0.5f)
+    {
+      n_levels = clutter_blur_calculate_dual_kawase_levels (sigma, 3840, 2160,
+                                                            &offset);
+
+      g_assert_cmpint (n_levels, >=, 1);
+      g_assert_cmpint (n_levels, >=, prev_n_levels);
+      g_assert_cmpfloat (offset, >, 0.f);
+      g_assert_cmpfloat (offset, <=, MAX_OFFSET);
+      g_assert_cmpfloat_with_epsilon (clutter_blur_get_dual_kawase_sigma (n_levels,
+                                                                          offset),
+                                      sigma, 0.001f);
+
+      prev_n_levels = n_levels;
+    }
+
+  /* Too small to be downsampled */
+  n_levels = clutter_blur_calculate_dual_kawase_levels (10.f, 15, 1000,
+                                                        &offset);
+  g_assert_cmpint (n_levels, ==, 0);
+
+  /* The smallest level of a 64x64 texture is 8x8, and the offset is clamped
+   * when the sigma can't be reached */
+  n_levels = clutter_blur_calculate_dual_kawase_levels (1000.f, 64, 64,
+                                                        &offset);
+  g_assert_cmpint (n_levels, ==, 3);
+  g_assert_cmpfloat (offset, ==, MAX_OFFSET);
+}
+
+static void
+end_frame (void)
+{
+  ClutterBackend *backend = clutter_get_default_backend ();
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (backend);
+
+  cogl_offscreen_pool_end_frame (cogl_context_get_offscreen_pool (cogl_context));
+}
+
+static CoglTexture *
+create_source_texture (CoglFramebuffer **framebuffer)
+{
+  ClutterBackend *backend = clutter_get_default_backend ();
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (backend);
+  CoglTexture2D *texture;
+
+  texture = cogl_texture_2d_new_with_size (cogl_context,
+                                           TEXTURE_SIZE, TEXTURE_SIZE);
+  *framebuffer =
+    COGL_FRAMEBUFFER (cogl_offscreen_new_with_texture (COGL_TEXTURE (texture)));
+
+  return COGL_TEXTURE (texture);
+}
+
+static void
+fill_source (CoglFramebuffer *framebuffer,
+             float            red,
+             float            blue)
+{
+  cogl_framebuffer_clear4f (framebuffer, COGL_BUFFER_BIT_COLOR,
+                            red, 0.f, blue, 1.f);
+}
+
+static void
+assert_center_pixel (CoglTexture *texture,
+                     uint8_t      red,
+                     uint8_t      blue)
+{
+  g_autofree uint8_t *data = NULL;
+  int rowstride = TEXTURE_SIZE * 4;
+  uint8_t *pixel;
+
+  data = g_malloc (rowstride * TEXTURE_SIZE);
+  cogl_texture_get_data (texture, COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                         rowstride, data);
+
+  pixel = data + (TEXTURE_SIZE / 2) * rowstride + (TEXTURE_SIZE / 2) * 4;
+  g_assert_cmpuint (pixel[0], ==, red);
+  g_assert_cmpuint (pixel[2], ==, blue);
+}
+
+static void
+blur_reapply (void)
+{
+  g_autoptr (CoglFramebuffer) framebuffer = NULL;
+  CoglTexture *texture;
+  ClutterBlur *blur;
+
+  texture = create_source_texture (&framebuffer);
+  blur = clutter_blur_new_full (texture, 2.f, CLUTTER_BLUR_MODE_DUAL_KAWASE);
+  g_assert_nonnull (blur);
+  g_assert_true (clutter_blur_get_texture (blur) != texture);
+
+  fill_source (framebuffer, 1.f, 0.f);
+  clutter_blur_apply (blur);
+  assert_center_pixel (clutter_blur_get_texture (blur), 0xff, 0x00);
+
+  /* Applying the same blur again picks up the new source contents */
+  fill_source (framebuffer, 0.f, 1.f);
+  clutter_blur_apply (blur);
+  assert_center_pixel (clutter_blur_get_texture (blur), 0x00, 0xff);
+
+  clutter_blur_free (blur);
+  cogl_object_unref (texture);
+  end_frame ();
+}
+
+static void
+blur_framebuffer_pool (void)
+{
+  g_autoptr (CoglFramebuffer) framebuffer = NULL;
+  CoglTexture *blurred_texture1;
+  CoglTexture *blurred_texture2;
+  CoglTexture *blurred_texture3;
+  CoglTexture *texture;
+  ClutterBlur *blur;
+
+  texture = create_source_texture (&framebuffer);
+
+  /* A single level, so that the result is the only full size framebuffer */
+  blur = clutter_blur_new_full (texture, 1.f, CLUTTER_BLUR_MODE_DUAL_KAWASE);
+  blurred_texture1 = clutter_blur_get_texture (blur);
+  clutter_blur_free (blur);
+
+  /* Released framebuffers aren't reused before the frame ends */
+  blur = clutter_blur_new_full (texture, 1.f, CLUTTER_BLUR_MODE_DUAL_KAWASE);
+  blurred_texture2 = clutter_blur_get_texture (blur);
+  g_assert_true (blurred_texture2 != blurred_texture1);
+  clutter_blur_free (blur);
+
+  end_frame ();
+
+  blur = clutter_blur_new_full (texture, 1.f, CLUTTER_BLUR_MODE_DUAL_KAWASE);
+  blurred_texture3 = clutter_blur_get_texture (blur);
+  g_assert_true (blurred_texture3 == blurred_texture1 ||
+                 blurred_texture3 == blurred_texture2);
+  clutter_blur_free (blur);
+
+  cogl_object_unref (texture);
+  end_frame ();
+}
+
+CLUTTER_TEST_SUITE (
+  CLUTTER_TEST_UNIT ("/blur/dual-kawase-levels", blur_dual_kawase_levels)
+  CLUTTER_TEST_UNIT ("/blur/reapply", blur_reapply)
+  CLUTTER_TEST_UNIT ("/blur/framebuffer-pool", blur_framebuffer_pool)
+)
@@ -0,0 +1,156 @@
+#include <clutter/clutter.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clutter/clutter-damage-tiles.h"
+#include "tests/clutter-test-utils.h"
+
+#define WIDTH 333
+#define HEIGHT 217
+#define BPP 4
+#define STRIDE (WIDTH * BPP + 12)
+
+static cairo_region_t *
+find_changed_tiles_reference (const uint8_t        *current_data,
+                              const uint8_t        *prev_data,
+                              int                   tile_size,
+                              const cairo_region_t *damage_region)
+{
+  cairo_region_t *region;
+  int tile_x, tile_y;
+
+  region = cairo_region_create ();
+
+  for (tile_y = 0; tile_y * tile_size < HEIGHT; tile_y++)
+    {
+      for (tile_x = 0; tile_x * tile_size < WIDTH; tile_x++)
+        {
+          cairo_rectangle_int_t tile = {
+            .x = tile_x * tile_size,
+            .y = tile_y * tile_size,
+            .width = MIN (tile_size, WIDTH - tile_x * tile_size),
+            .height = MIN (tile_size, HEIGHT - tile_y * tile_size),
+          };
+          int y;
+
+          if (cairo_region_contains_rectangle (damage_region, &tile) ==
+              CAIRO_REGION_OVERLAP_OUT)
+            continue;
+
+          for (y = tile.y; y < tile.y + tile.height; y++)
+            {
+              size_t offset = y * STRIDE + tile.x * BPP;
+
+              if (memcmp (current_data + offset, prev_data + offset,
+                          tile.width * BPP) != 0)
+                {
+                  cairo_region_union_rectangle (region, &tile);
+                  break;
+                }
+            }
+        }
+    }
+
+  cairo_region_intersect (region, damage_region);
+
+  return region;
+}
+
+static void
+damage_tiles_compare_reference (void)
+{
+  g_autofree uint8_t *prev_data = NULL;
+  g_autofree uint8_t *current_data = NULL;
+  const ClutterDamageTilesFlags flags[] = {
+    CLUTTER_DAMAGE_TILES_FLAG_NO_SIMD | CLUTTER_DAMAGE_TILES_FLAG_NO_THREADS,
+    CLUTTER_DAMAGE_TILES_FLAG_NO_THREADS,
+    CLUTTER_DAMAGE_TILES_FLAG_NONE,
+  };
+  const int tile_sizes[] = { 8, 16, 31, 64 };
+  const cairo_rectangle_int_t damage_rects[] = {
+    { 0, 0, WIDTH, HEIGHT },
+    { 10, 20, 100, 50 },
+    { 200, 100, 300, 300 },
+  };
+  cairo_region_t *damage_region;
+  int i, j;
+
+  prev_data = g_malloc0 (STRIDE * HEIGHT);
+  current_data = g_malloc0 (STRIDE * HEIGHT);
+
+  srand (0);
+  for (i = 0; i < 50; i++)
+    {
+      int x = rand () % WIDTH;
+      int y = rand () % HEIGHT;
+
+      current_data[y * STRIDE + x * BPP + rand () % BPP] = 0xff;
+    }
+
+  damage_region = cairo_region_create_rectangles (damage_rects,
+                                                  G_N_ELEMENTS (damage_rects));
+
+  for (i = 0; i < G_N_ELEMENTS (tile_sizes); i++)
+    {
+      cairo_region_t *expected;
+
+      expected = find_changed_tiles_reference (current_data, prev_data,
+                                               tile_sizes[i], damage_region);
+
+      for (j = 0; j < G_N_ELEMENTS (flags); j++)
+        {
+          g_autoptr (ClutterDamageTiles) damage_tiles = NULL;
+          cairo_region_t *changed;
+
+          damage_tiles = clutter_damage_tiles_new (tile_sizes[i], flags[j]);
+          changed = clutter_damage_tiles_find_changed (damage_tiles,
+                                                       current_data,
+                                                       prev_data,
+                                                       WIDTH, HEIGHT,
+                                                       STRIDE, BPP,
+                                                       damage_region);
+
+          if (!g_test_quiet ())
+            g_print ("Tile size %d, %s: %d rectangles\n",
+                     tile_sizes[i],
+                     clutter_damage_tiles_get_impl_name (damage_tiles),
+                     cairo_region_num_rectangles (changed));
+
+          g_assert_true (cairo_region_equal (changed, expected));
+          cairo_region_destroy (changed);
+        }
+
+      cairo_region_destroy (expected);
+    }
+
+  cairo_region_destroy (damage_region);
+}
+
+static void
+damage_tiles_unchanged (void)
+{
+  g_autoptr (ClutterDamageTiles) damage_tiles = NULL;
+  g_autofree uint8_t *data = NULL;
+  cairo_rectangle_int_t full_damage = { 0, 0, WIDTH, HEIGHT };
+  cairo_region_t *damage_region;
+  cairo_region_t *changed;
+
+  data = g_malloc0 (STRIDE * HEIGHT);
+  damage_region = cairo_region_create_rectangle (&full_damage);
+  damage_tiles = clutter_damage_tiles_new (CLUTTER_DAMAGE_TILES_DEFAULT_TILE_SIZE,
+                                           CLUTTER_DAMAGE_TILES_FLAG_NONE);
+
+  changed = clutter_damage_tiles_find_changed (damage_tiles,
+                                               data, data,
+                                               WIDTH, HEIGHT, STRIDE, BPP,
+                                               damage_region);
+  g_assert_true (cairo_region_is_empty (changed));
+
+  cairo_region_destroy (changed);
+  cairo_region_destroy (damage_region);
+}
+
+CLUTTER_TEST_SUITE (
+  CLUTTER_TEST_UNIT ("/damage-tiles/compare-reference", damage_tiles_compare_reference)
+  CLUTTER_TEST_UNIT ("/damage-tiles/unchanged", damage_tiles_unchanged)
+)
@@ -247,6 +247,83 @@ frame_clock_immediate_present (void)
   clutter_frame_clock_destroy (frame_clock);
 }
 
+static ClutterFrameResult
+adaptive_frame_clock_frame (ClutterFrameClock *frame_clock,
+                            int64_t            frame_count,
+                            gpointer           user_data)
+{
+  GMainLoop *main_loop = user_data;
+  ClutterFrameInfo frame_info;
+  int64_t now_us;
+
+  g_assert_cmpint (frame_count, ==, expected_frame_count);
+
+  expected_frame_count++;
+
+  if (test_frame_count == 0)
+    {
+      g_main_loop_quit (main_loop);
+      return CLUTTER_FRAME_RESULT_IDLE;
+    }
+
+  test_frame_count--;
+
+  now_us = g_get_monotonic_time ();
+  init_frame_info (&frame_info, now_us);
+  frame_info.cpu_time_before_buffer_swap_us = now_us;
+  frame_info.gpu_rendering_duration_ns = 1000 * 1000;
+  clutter_frame_clock_notify_presented (frame_clock, &frame_info);
+  g_idle_add (schedule_update_idle, frame_clock);
+
+  return CLUTTER_FRAME_RESULT_PENDING_PRESENTED;
+}
+
+static int64_t
+adaptive_frame_clock_get_pending_damage_area (ClutterFrameClock *frame_clock,
+                                              gpointer           user_data)
+{
+  return 1920 * 1080;
+}
+
+static const ClutterFrameListenerIface adaptive_frame_listener_iface = {
+  .frame = adaptive_frame_clock_frame,
+  .get_pending_damage_area = adaptive_frame_clock_get_pending_damage_area,
+};
+
+static void
+frame_clock_adaptive_scheduling (void)
+{
+  GMainLoop *main_loop;
+  ClutterFrameClock *frame_clock;
+  ClutterFrameClockStats stats;
+
+  test_frame_count = 10;
+  expected_frame_count = 0;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+  frame_clock = clutter_frame_clock_new (refresh_rate,
+                                         0,
+                                         &adaptive_frame_listener_iface,
+                                         main_loop);
+  clutter_frame_clock_set_scheduling (frame_clock,
+                                      CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE);
+  g_assert_cmpint (clutter_frame_clock_get_scheduling (frame_clock), ==,
+                   CLUTTER_FRAME_CLOCK_SCHEDULING_ADAPTIVE);
+
+  clutter_frame_clock_schedule_update (frame_clock);
+  g_main_loop_run (main_loop);
+
+  clutter_frame_clock_get_stats (frame_clock, &stats);
+  g_assert_cmpint (stats.n_measured_frames, ==, 10);
+  g_assert_cmpint (stats.last_render_time_us, >=, 1000);
+  g_assert_cmpint (stats.last_predicted_render_time_us, >=, 0);
+  g_assert_cmpint (stats.last_predicted_render_time_us, <=,
+                   refresh_interval_us);
+
+  g_main_loop_unref (main_loop);
+  clutter_frame_clock_destroy (frame_clock);
+}
+
 static gboolean
 schedule_update_timeout (gpointer user_data)
 {
@@ -330,6 +407,99 @@ frame_clock_delayed_damage (void)
   g_source_unref (source);
 }
 
+typedef struct _VariableRefreshRateTest
+{
+  GMainLoop *main_loop;
+  ClutterFrameClock *frame_clock;
+
+  int64_t schedule_time_us;
+  int64_t total_latency_us;
+} VariableRefreshRateTest;
+
+static gboolean
+variable_schedule_update_timeout (gpointer user_data)
+{
+  VariableRefreshRateTest *test = user_data;
+
+  test->schedule_time_us = g_get_monotonic_time ();
+  clutter_frame_clock_schedule_update (test->frame_clock);
+
+  return G_SOURCE_REMOVE;
+}
+
+static ClutterFrameResult
+variable_frame_clock_frame (ClutterFrameClock *frame_clock,
+                            int64_t            frame_count,
+                            gpointer           user_data)
+{
+  VariableRefreshRateTest *test = user_data;
+  ClutterFrameInfo frame_info;
+  int64_t now_us;
+
+  g_assert_cmpint (frame_count, ==, expected_frame_count);
+
+  expected_frame_count++;
+
+  now_us = g_get_monotonic_time ();
+  if (test->schedule_time_us)
+    test->total_latency_us += now_us - test->schedule_time_us;
+
+  if (test_frame_count == 0)
+    {
+      g_main_loop_quit (test->main_loop);
+      return CLUTTER_FRAME_RESULT_IDLE;
+    }
+
+  test_frame_count--;
+
+  init_frame_info (&frame_info, now_us);
+  frame_info.cpu_time_before_buffer_swap_us = now_us;
+  frame_info.gpu_rendering_duration_ns = 1000 * 1000;
+  clutter_frame_clock_notify_presented (frame_clock, &frame_info);
+
+  /* Emulate a client committing at 48 Hz, i.e. off the 60 Hz grid. */
+  g_timeout_add (G_USEC_PER_SEC / 48 / 1000,
+                 variable_schedule_update_timeout,
+                 test);
+
+  return CLUTTER_FRAME_RESULT_PENDING_PRESENTED;
+}
+
+static const ClutterFrameListenerIface variable_frame_listener_iface = {
+  .frame = variable_frame_clock_frame,
+};
+
+static void
+frame_clock_variable_refresh_rate (void)
+{
+  VariableRefreshRateTest test = { 0 };
+  ClutterFrameClock *frame_clock;
+
+  test_frame_count = 10;
+  expected_frame_count = 0;
+
+  test.main_loop = g_main_loop_new (NULL, FALSE);
+  frame_clock = clutter_frame_clock_new (refresh_rate,
+                                         0,
+                                         &variable_frame_listener_iface,
+                                         &test);
+  test.frame_clock = frame_clock;
+  clutter_frame_clock_set_mode (frame_clock, CLUTTER_FRAME_CLOCK_MODE_VARIABLE);
+  g_assert_cmpint (clutter_frame_clock_get_mode (frame_clock), ==,
+                   CLUTTER_FRAME_CLOCK_MODE_VARIABLE);
+
+  clutter_frame_clock_schedule_update (frame_clock);
+  g_main_loop_run (test.main_loop);
+
+  /* With a fixed refresh rate, each update would have been delayed until
+   * shortly before the next refresh interval boundary, about 10 ms.
+   */
+  g_assert_cmpint (test.total_latency_us, <, 10 * refresh_interval_us / 4);
+
+  g_main_loop_unref (test.main_loop);
+  clutter_frame_clock_destroy (frame_clock);
+}
+
 static ClutterFrameResult
 no_damage_frame_clock_frame (ClutterFrameClock *frame_clock,
                              int64_t            frame_count,
@@ -823,10 +993,159 @@ frame_clock_notify_ready (void)
   clutter_frame_clock_destroy (frame_clock);
 }
 
+typedef struct _NextUpdateTimeTest
+{
+  FrameClockTest base;
+
+  int64_t dispatch_time_us;
+} NextUpdateTimeTest;
+
+static ClutterFrameResult
+next_update_time_frame_clock_frame (ClutterFrameClock *frame_clock,
+                                    int64_t            frame_count,
+                                    gpointer           user_data)
+{
+  NextUpdateTimeTest *test = user_data;
+
+  test->dispatch_time_us = g_get_monotonic_time ();
+
+  return frame_clock_frame (frame_clock, frame_count, &test->base);
+}
+
+static const ClutterFrameListenerIface next_update_time_listener_iface = {
+  .frame = next_update_time_frame_clock_frame,
+};
+
+static ClutterFrameClock *
+run_next_update_time_frames (NextUpdateTimeTest    *test,
+                             ClutterFrameClockMode  mode)
+{
+  ClutterFrameClock *frame_clock;
+  FakeHwClock *fake_hw_clock;
+  GSource *source;
+
+  test_frame_count = 3;
+  expected_frame_count = 0;
+
+  test->base.main_loop = g_main_loop_new (NULL, FALSE);
+  frame_clock = clutter_frame_clock_new (refresh_rate,
+                                         0,
+                                         &next_update_time_listener_iface,
+                                         test);
+  clutter_frame_clock_set_mode (frame_clock, mode);
+
+  /* Nothing was presented yet, so there is nothing to predict from */
+  g_assert_cmpint (clutter_frame_clock_get_next_update_time_us (frame_clock),
+                   ==, -1);
+
+  fake_hw_clock = fake_hw_clock_new (frame_clock,
+                                     schedule_update_hw_callback,
+                                     frame_clock);
+  source = &fake_hw_clock->source;
+  g_source_attach (source, NULL);
+
+  test->base.fake_hw_clock = fake_hw_clock;
+
+  clutter_frame_clock_schedule_update (frame_clock);
+  g_main_loop_run (test->base.main_loop);
+
+  test->base.fake_hw_clock = NULL;
+  g_source_destroy (source);
+  g_source_unref (source);
+
+  return frame_clock;
+}
+
+static void
+assert_next_update_time_predicted (ClutterFrameClock  *frame_clock,
+                                   NextUpdateTimeTest *test)
+{
+  int64_t now_us;
+  int64_t next_update_time_us;
+
+  /* Idle, the next frame is the first one still ahead of us */
+  now_us = g_get_monotonic_time ();
+  next_update_time_us =
+    clutter_frame_clock_get_next_update_time_us (frame_clock);
+  g_assert_cmpint (next_update_time_us, >=, now_us);
+  g_assert_cmpint (next_update_time_us, <=, now_us + refresh_interval_us);
+
+  /* Scheduled, it's the time the frame will be dispatched at */
+  test_frame_count = 0;
+  clutter_frame_clock_schedule_update (frame_clock);
+  next_update_time_us =
+    clutter_frame_clock_get_next_update_time_us (frame_clock);
+  g_assert_cmpint (next_update_time_us, >=, now_us);
+
+  g_main_loop_run (test->base.main_loop);
+
+  g_assert_cmpint (test->dispatch_time_us, >=, next_update_time_us);
+  g_assert_cmpint (test->dispatch_time_us - next_update_time_us,
+                   <, refresh_interval_us);
+}
+
+static void
+frame_clock_next_update_time_fixed (void)
+{
+  NextUpdateTimeTest test = { 0 };
+  ClutterFrameClock *frame_clock;
+
+  frame_clock = run_next_update_time_frames (&test,
+                                             CLUTTER_FRAME_CLOCK_MODE_FIXED);
+  assert_next_update_time_predicted (frame_clock, &test);
+
+  g_main_loop_unref (test.base.main_loop);
+  clutter_frame_clock_destroy (frame_clock);
+}
+
+static void
+frame_clock_next_update_time_variable (void)
+{
+  NextUpdateTimeTest test = { 0 };
+  ClutterFrameClock *frame_clock;
+
+  frame_clock = run_next_update_time_frames (&test,
+                                             CLUTTER_FRAME_CLOCK_MODE_VARIABLE);
+
+  /* Without a grid of presentation times, there is nothing to predict */
+  g_assert_cmpint (clutter_frame_clock_get_next_update_time_us (frame_clock),
+                   ==, -1);
+
+  test_frame_count = 0;
+  clutter_frame_clock_schedule_update (frame_clock);
+  g_assert_cmpint (clutter_frame_clock_get_next_update_time_us (frame_clock),
+                   ==, -1);
+  g_main_loop_run (test.base.main_loop);
+
+  g_main_loop_unref (test.base.main_loop);
+  clutter_frame_clock_destroy (frame_clock);
+}
+
+static void
+frame_clock_next_update_time_idle (void)
+{
+  NextUpdateTimeTest test = { 0 };
+  ClutterFrameClock *frame_clock;
+
+  frame_clock = run_next_update_time_frames (&test,
+                                             CLUTTER_FRAME_CLOCK_MODE_FIXED);
+
+  /* Skip a few refresh cycles, so that the last presentation is no longer
+   * a good enough base for the prediction */
+  g_usleep (3 * refresh_interval_us);
+
+  assert_next_update_time_predicted (frame_clock, &test);
+
+  g_main_loop_unref (test.base.main_loop);
+  clutter_frame_clock_destroy (frame_clock);
+}
+
 CLUTTER_TEST_SUITE (
   CLUTTER_TEST_UNIT ("/frame-clock/schedule-update", frame_clock_schedule_update)
   CLUTTER_TEST_UNIT ("/frame-clock/immediate-present", frame_clock_immediate_present)
+  CLUTTER_TEST_UNIT ("/frame-clock/adaptive-scheduling", frame_clock_adaptive_scheduling)
   CLUTTER_TEST_UNIT ("/frame-clock/delayed-damage", frame_clock_delayed_damage)
+  CLUTTER_TEST_UNIT ("/frame-clock/variable-refresh-rate", frame_clock_variable_refresh_rate)
   CLUTTER_TEST_UNIT ("/frame-clock/no-damage", frame_clock_no_damage)
   CLUTTER_TEST_UNIT ("/frame-clock/schedule-update-now", frame_clock_schedule_update_now)
   CLUTTER_TEST_UNIT ("/frame-clock/before-frame", frame_clock_before_frame)
@@ -834,4 +1153,7 @@ CLUTTER_TEST_SUITE (
   CLUTTER_TEST_UNIT ("/frame-clock/reschedule-on-idle", frame_clock_reschedule_on_idle)
   CLUTTER_TEST_UNIT ("/frame-clock/destroy-signal", frame_clock_destroy_signal)
   CLUTTER_TEST_UNIT ("/frame-clock/notify-ready", frame_clock_notify_ready)
+  CLUTTER_TEST_UNIT ("/frame-clock/next-update-time/fixed", frame_clock_next_update_time_fixed)
+  CLUTTER_TEST_UNIT ("/frame-clock/next-update-time/variable", frame_clock_next_update_time_variable)
+  CLUTTER_TEST_UNIT ("/frame-clock/next-update-time/idle", frame_clock_next_update_time_idle)
 )
@@ -0,0 +1,198 @@
+#include <clutter/clutter.h>
+#include <cogl-pango/cogl-pango.h>
+
+#include "tests/clutter-test-utils.h"
+
+/* Glyphs this big don't fit in a regular page, so each of them ends
+ * up in a page of its own and the page limit is reached quickly */
+#define TEST_FONT "Sans 2000px"
+
+#define MAX_TEST_GLYPHS 26
+
+static PangoLayout *
+create_layout (PangoContext *context,
+               char          c)
+{
+  PangoLayout *layout;
+  char text[2] = { c, '\0' };
+
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, text, -1);
+
+  return layout;
+}
+
+static void
+get_glyph_cache_stats (CoglPangoGlyphCacheStats *stats)
+{
+  CoglPangoFontMap *font_map = COGL_PANGO_FONT_MAP (clutter_get_font_map ());
+
+  cogl_pango_font_map_get_glyph_cache_stats (font_map, stats);
+}
+
+static void
+glyph_cache_evict (void)
+{
+  ClutterBackend *backend = clutter_get_default_backend ();
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (backend);
+  ClutterActor *stage = clutter_test_get_stage ();
+  g_autoptr (PangoContext) context = NULL;
+  PangoFontDescription *font_desc;
+  g_autoptr (PangoLayout) first_layout = NULL;
+  CoglPangoGlyphCacheStats stats;
+  CoglTexture *texture;
+  CoglOffscreen *offscreen;
+  CoglFramebuffer *framebuffer;
+  CoglColor color;
+  uint64_t n_uploads;
+  int i;
+
+  texture = cogl_texture_2d_new_with_size (cogl_context, 64, 64);
+  offscreen = cogl_offscreen_new_with_texture (texture);
+  framebuffer = COGL_FRAMEBUFFER (offscreen);
+  g_assert_true (cogl_framebuffer_allocate (framebuffer, NULL));
+
+  cogl_color_init_from_4ub (&color, 0xff, 0xff, 0xff, 0xff);
+
+  context = clutter_actor_create_pango_context (stage);
+  font_desc = pango_font_description_from_string (TEST_FONT);
+  pango_context_set_font_description (context, font_desc);
+  pango_font_description_free (font_desc);
+
+  /* Build the display list of the first layout, which adds its glyph
+   * to the least recently used page from then on */
+  first_layout = create_layout (context, 'A');
+  cogl_pango_show_layout (framebuffer, first_layout, 0, 0, &color);
+
+  get_glyph_cache_stats (&stats);
+  g_assert_cmpuint (stats.n_evicted_pages, ==, 0);
+  n_uploads = stats.n_uploads;
+  g_assert_cmpuint (n_uploads, >, 0);
+
+  /* Showing the first layout again reuses its display list, so nothing
+   * is looked up or uploaded */
+  cogl_pango_show_layout (framebuffer, first_layout, 0, 0, &color);
+
+  get_glyph_cache_stats (&stats);
+  g_assert_cmpuint (stats.n_uploads, ==, n_uploads);
+
+  /* Add new glyphs until the page of the first glyph is evicted */
+  for (i = 1; i < MAX_TEST_GLYPHS && stats.n_evicted_pages == 0; i++)
+    {
+      g_autoptr (PangoLayout) layout = NULL;
+
+      layout = create_layout (context, 'A' + i);
+      cogl_pango_show_layout (framebuffer, layout, 0, 0, &color);
+
+      get_glyph_cache_stats (&stats);
+    }
+
+  g_assert_cmpuint (stats.n_evicted_pages, ==, 1);
+  g_assert_cmpuint (stats.n_evicted_glyphs, >=, 1);
+  n_uploads = stats.n_uploads;
+
+  /* The eviction invalidated the display list of the first layout, so
+   * showing it again has to add its glyph to the cache again */
+  cogl_pango_show_layout (framebuffer, first_layout, 0, 0, &color);
+
+  get_glyph_cache_stats (&stats);
+  g_assert_cmpuint (stats.n_uploads, >, n_uploads);
+
+  g_object_unref (offscreen);
+  cogl_object_unref (texture);
+}
+
+static uint64_t
+get_layout_glyph_bytes (PangoLayout *layout)
+{
+  PangoLayoutIter *iter;
+  uint64_t n_bytes = 0;
+
+  iter = pango_layout_get_iter (layout);
+  do
+    {
+      PangoLayoutRun *run = pango_layout_iter_get_run_readonly (iter);
+      int i;
+
+      if (!run)
+        continue;
+
+      for (i = 0; i < run->glyphs->num_glyphs; i++)
+        {
+          PangoRectangle ink_rect;
+
+          pango_font_get_glyph_extents (run->item->analysis.font,
+                                        run->glyphs->glyphs[i].glyph,
+                                        &ink_rect, NULL);
+          pango_extents_to_pixels (&ink_rect, NULL);
+
+          /* Glyphs are uploaded with one pixel of padding */
+          if (ink_rect.width > 0 && ink_rect.height > 0)
+            n_bytes += (ink_rect.width + 1) * (ink_rect.height + 1);
+        }
+    }
+  while (pango_layout_iter_next_run (iter));
+  pango_layout_iter_free (iter);
+
+  return n_bytes;
+}
+
+static void
+glyph_cache_upload_new_glyphs (void)
+{
+  ClutterBackend *backend = clutter_get_default_backend ();
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (backend);
+  ClutterActor *stage = clutter_test_get_stage ();
+  g_autoptr (PangoContext) context = NULL;
+  PangoFontDescription *font_desc;
+  g_autoptr (PangoLayout) layout = NULL;
+  CoglPangoGlyphCacheStats stats;
+  CoglTexture *texture;
+  CoglOffscreen *offscreen;
+  CoglFramebuffer *framebuffer;
+  CoglColor color;
+  uint64_t n_uploads;
+  uint64_t uploaded_bytes;
+
+  texture = cogl_texture_2d_new_with_size (cogl_context, 64, 64);
+  offscreen = cogl_offscreen_new_with_texture (texture);
+  framebuffer = COGL_FRAMEBUFFER (offscreen);
+  g_assert_true (cogl_framebuffer_allocate (framebuffer, NULL));
+
+  cogl_color_init_from_4ub (&color, 0xff, 0xff, 0xff, 0xff);
+
+  context = clutter_actor_create_pango_context (stage);
+  font_desc = pango_font_description_from_string ("Sans 20px");
+  pango_context_set_font_description (context, font_desc);
+  pango_font_description_free (font_desc);
+
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "abcdefghijklm", -1);
+  cogl_pango_show_layout (framebuffer, layout, 0, 0, &color);
+  g_clear_object (&layout);
+
+  get_glyph_cache_stats (&stats);
+  n_uploads = stats.n_uploads;
+  uploaded_bytes = stats.uploaded_bytes;
+
+  /* Glyphs added next to, or around, glyphs that are already in the
+   * page only upload themselves */
+  layout = pango_layout_new (context);
+  pango_layout_set_text (layout, "nz", -1);
+  cogl_pango_show_layout (framebuffer, layout, 0, 0, &color);
+
+  get_glyph_cache_stats (&stats);
+  g_assert_cmpuint (stats.n_uploads - n_uploads, ==, 2);
+  g_assert_cmpuint (stats.uploaded_bytes - uploaded_bytes,
+                    ==,
+                    get_layout_glyph_bytes (layout));
+
+  g_object_unref (offscreen);
+  cogl_object_unref (texture);
+}
+
+CLUTTER_TEST_SUITE (
+  CLUTTER_TEST_UNIT ("/glyph-cache/evict", glyph_cache_evict)
+  CLUTTER_TEST_UNIT ("/glyph-cache/upload-new-glyphs",
+                     glyph_cache_upload_new_glyphs)
+)
@@ -0,0 +1,147 @@
+#include <clutter/clutter.h>
+#include <glib/gstdio.h>
+
+#include "clutter/clutter-pipeline-prewarm.h"
+#include "tests/clutter-test-utils.h"
+
+static int n_created_pipelines;
+
+static CoglPipeline *
+create_test_pipeline (CoglContext *cogl_context,
+                      const char  *variant)
+{
+  CoglPipeline *pipeline;
+  CoglSnippet *snippet;
+  g_autofree char *code = NULL;
+
+  n_created_pipelines++;
+
+  /* Use the variant in the source, so that every variant needs its own
+   * program */
+  code = g_strdup_printf ("cogl_color_out.r = %s.0 / 10.0;\n", variant);
+
+  pipeline = cogl_pipeline_new (cogl_context);
+  cogl_pipeline_set_layer_null_texture (pipeline, 0);
+  snippet = cogl_snippet_new (COGL_SNIPPET_HOOK_FRAGMENT, NULL, code);
+  cogl_pipeline_add_snippet (pipeline, snippet);
+  cogl_object_unref (snippet);
+
+  return pipeline;
+}
+
+static char *
+create_shapes_path (void)
+{
+  g_autofree char *dir = NULL;
+  g_autoptr (GError) error = NULL;
+
+  dir = g_dir_make_tmp ("clutter-pipeline-prewarm-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  return g_build_filename (dir, "pipeline-shapes", NULL);
+}
+
+static void
+remove_shapes_path (const char *path)
+{
+  g_autofree char *dir = NULL;
+
+  dir = g_path_get_dirname (path);
+  g_unlink (path);
+  g_rmdir (dir);
+}
+
+static ClutterPipelinePrewarm *
+create_prewarm (const char *path)
+{
+  ClutterBackend *backend = clutter_get_default_backend ();
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (backend);
+  ClutterPipelinePrewarm *prewarm;
+
+  prewarm = clutter_pipeline_prewarm_new (cogl_context, path);
+  clutter_pipeline_prewarm_register_shape (prewarm,
+                                           "test-shape",
+                                           create_test_pipeline);
+
+  return prewarm;
+}
+
+static void
+pipeline_prewarm_record_replay (void)
+{
+  g_autoptr (ClutterPipelinePrewarm) prewarm = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *path = NULL;
+  int64_t start_time_us;
+  int n_pipelines;
+
+  path = create_shapes_path ();
+
+  /* Nothing stored by a previous session */
+  prewarm = create_prewarm (path);
+  g_assert_true (clutter_pipeline_prewarm_is_done (prewarm));
+  g_assert_cmpint (clutter_pipeline_prewarm_run (prewarm), ==, 0);
+
+  clutter_pipeline_prewarm_record (prewarm, "test-shape", "1");
+  clutter_pipeline_prewarm_record (prewarm, "test-shape", "2");
+  clutter_pipeline_prewarm_record (prewarm, "test-shape", "1");
+  clutter_pipeline_prewarm_record (prewarm, "unknown-shape", "1");
+  clutter_pipeline_prewarm_save (prewarm, &error);
+  g_assert_no_error (error);
+  g_clear_pointer (&prewarm, clutter_pipeline_prewarm_free);
+
+  /* Replay what was recorded; shapes without a function aren't stored */
+  n_created_pipelines = 0;
+  prewarm = create_prewarm (path);
+  g_assert_false (clutter_pipeline_prewarm_is_done (prewarm));
+
+  start_time_us = g_get_monotonic_time ();
+  n_pipelines = clutter_pipeline_prewarm_run (prewarm);
+  g_test_message ("Prewarmed %d pipelines in %" G_GINT64_FORMAT " us",
+                  n_pipelines, g_get_monotonic_time () - start_time_us);
+
+  g_assert_cmpint (n_pipelines, ==, 2);
+  g_assert_cmpint (n_created_pipelines, ==, 2);
+  g_assert_true (clutter_pipeline_prewarm_is_done (prewarm));
+  g_assert_cmpint (clutter_pipeline_prewarm_run (prewarm), ==, 0);
+
+  g_clear_pointer (&prewarm, clutter_pipeline_prewarm_free);
+  remove_shapes_path (path);
+}
+
+static void
+pipeline_prewarm_idle (void)
+{
+  g_autoptr (ClutterPipelinePrewarm) prewarm = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree char *path = NULL;
+
+  path = create_shapes_path ();
+
+  g_file_set_contents (path,
+                       "test-shape:1\n"
+                       "invalid line\n"
+                       "test-shape:\n"
+                       "test-shape:2\n"
+                       "test-shape:3\n",
+                       -1, &error);
+  g_assert_no_error (error);
+
+  n_created_pipelines = 0;
+  prewarm = create_prewarm (path);
+  clutter_pipeline_prewarm_start (prewarm);
+  g_assert_cmpint (n_created_pipelines, ==, 0);
+
+  while (!clutter_pipeline_prewarm_is_done (prewarm))
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpint (n_created_pipelines, ==, 3);
+
+  g_clear_pointer (&prewarm, clutter_pipeline_prewarm_free);
+  remove_shapes_path (path);
+}
+
+CLUTTER_TEST_SUITE (
+  CLUTTER_TEST_UNIT ("/pipeline-prewarm/record-replay", pipeline_prewarm_record_replay)
+  CLUTTER_TEST_UNIT ("/pipeline-prewarm/idle", pipeline_prewarm_idle)
+)
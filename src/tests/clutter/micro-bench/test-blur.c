@@ -0,0 +1,184 @@
+#include <clutter-build-config.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <clutter/clutter.h>
+#include <cogl/cogl.h>
+
+#include "clutter/clutter-blur-private.h"
+#include "tests/clutter-test-utils.h"
+
+#define N_ITERATIONS 20
+
+typedef struct _TextureSize
+{
+  const char *name;
+  int width;
+  int height;
+} TextureSize;
+
+static const TextureSize texture_sizes[] = {
+  { "1080p", 1920, 1080 },
+  { "4K", 3840, 2160 },
+};
+
+static const float sigmas[] = { 5.f, 15.f, 40.f };
+
+typedef enum _BenchmarkFlag
+{
+  BENCHMARK_FLAG_NONE = 0,
+  BENCHMARK_FLAG_NO_RECYCLE = 1 << 0,
+  BENCHMARK_FLAG_REUSE = 1 << 1,
+} BenchmarkFlag;
+
+static void
+end_frame (void)
+{
+  ClutterBackend *backend = clutter_get_default_backend ();
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (backend);
+
+  cogl_offscreen_pool_end_frame (cogl_context_get_offscreen_pool (cogl_context));
+}
+
+static void
+draw_result (CoglFramebuffer *sink,
+             CoglPipeline    *pipeline,
+             ClutterBlur     *blur)
+{
+  cogl_pipeline_set_layer_texture (pipeline, 0,
+                                   clutter_blur_get_texture (blur));
+  cogl_framebuffer_draw_rectangle (sink, pipeline, 0, 0, 1, 1);
+}
+
+/* Returns the average time it takes to blur @texture, in ms. Like
+ * ClutterBlurNode, a new blur is created for every frame, unless
+ * BENCHMARK_FLAG_REUSE is passed, in which case the same blur is reapplied
+ * every frame.
+ */
+static double
+run_benchmark (CoglTexture     *texture,
+               CoglFramebuffer *sink,
+               CoglPipeline    *pipeline,
+               float            sigma,
+               ClutterBlurMode  mode,
+               BenchmarkFlag    flags)
+{
+  ClutterBlur *blur = NULL;
+  int64_t start_us;
+  int i;
+
+  /* Warm up shaders and the framebuffer pool */
+  blur = clutter_blur_new_full (texture, sigma, mode);
+  clutter_blur_apply (blur);
+  draw_result (sink, pipeline, blur);
+  cogl_framebuffer_finish (sink);
+
+  if (!(flags & BENCHMARK_FLAG_REUSE))
+    {
+      g_clear_pointer (&blur, clutter_blur_free);
+      end_frame ();
+    }
+
+  start_us = g_get_monotonic_time ();
+
+  for (i = 0; i < N_ITERATIONS; i++)
+    {
+      if (!blur)
+        blur = clutter_blur_new_full (texture, sigma, mode);
+
+      clutter_blur_apply (blur);
+      draw_result (sink, pipeline, blur);
+      cogl_framebuffer_finish (sink);
+
+      if (!(flags & BENCHMARK_FLAG_REUSE))
+        g_clear_pointer (&blur, clutter_blur_free);
+      if (!(flags & BENCHMARK_FLAG_NO_RECYCLE))
+        end_frame ();
+    }
+
+  g_clear_pointer (&blur, clutter_blur_free);
+  end_frame ();
+
+  return (g_get_monotonic_time () - start_us) / (1000.0 * N_ITERATIONS);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_autoptr (CoglFramebuffer) sink = NULL;
+  g_autoptr (GError) error = NULL;
+  CoglContext *cogl_context;
+  CoglTexture2D *sink_texture;
+  CoglPipeline *pipeline;
+  int i, j;
+
+  clutter_test_init (&argc, &argv);
+
+  cogl_context =
+    clutter_backend_get_cogl_context (clutter_get_default_backend ());
+
+  sink_texture = cogl_texture_2d_new_with_size (cogl_context, 1, 1);
+  sink = COGL_FRAMEBUFFER (
+    cogl_offscreen_new_with_texture (COGL_TEXTURE (sink_texture)));
+  cogl_object_unref (sink_texture);
+  if (!cogl_framebuffer_allocate (sink, &error))
+    {
+      g_printerr ("Failed to allocate framebuffer: %s\n", error->message);
+      return EXIT_FAILURE;
+    }
+  cogl_framebuffer_orthographic (sink, 0, 0, 1, 1, 0, 1);
+
+  pipeline = cogl_pipeline_new (cogl_context);
+
+  g_print ("%d iterations\n", N_ITERATIONS);
+
+  for (i = 0; i < G_N_ELEMENTS (texture_sizes); i++)
+    {
+      const TextureSize *size = &texture_sizes[i];
+      CoglTexture2D *texture;
+
+      texture = cogl_texture_2d_new_with_size (cogl_context,
+                                               size->width, size->height);
+      cogl_texture_allocate (COGL_TEXTURE (texture), NULL);
+
+      for (j = 0; j < G_N_ELEMENTS (sigmas); j++)
+        {
+          float sigma = sigmas[j];
+          float offset;
+          int n_levels;
+
+          n_levels = clutter_blur_calculate_dual_kawase_levels (sigma,
+                                                                size->width,
+                                                                size->height,
+                                                                &offset);
+
+          g_print ("%-5s sigma %4.1f gaussian: %7.3f ms "
+                   "(unpooled: %7.3f ms), "
+                   "dual kawase (%d levels, offset %.2f): %7.3f ms "
+                   "(unpooled: %7.3f ms, reused: %7.3f ms)\n",
+                   size->name, sigma,
+                   run_benchmark (COGL_TEXTURE (texture), sink, pipeline,
+                                  sigma, CLUTTER_BLUR_MODE_GAUSSIAN,
+                                  BENCHMARK_FLAG_NONE),
+                   run_benchmark (COGL_TEXTURE (texture), sink, pipeline,
+                                  sigma, CLUTTER_BLUR_MODE_GAUSSIAN,
+                                  BENCHMARK_FLAG_NO_RECYCLE),
+                   n_levels, offset,
+                   run_benchmark (COGL_TEXTURE (texture), sink, pipeline,
+                                  sigma, CLUTTER_BLUR_MODE_DUAL_KAWASE,
+                                  BENCHMARK_FLAG_NONE),
+                   run_benchmark (COGL_TEXTURE (texture), sink, pipeline,
+                                  sigma, CLUTTER_BLUR_MODE_DUAL_KAWASE,
+                                  BENCHMARK_FLAG_NO_RECYCLE),
+                   run_benchmark (COGL_TEXTURE (texture), sink, pipeline,
+                                  sigma, CLUTTER_BLUR_MODE_DUAL_KAWASE,
+                                  BENCHMARK_FLAG_REUSE));
+        }
+
+      cogl_object_unref (texture);
+    }
+
+  cogl_object_unref (pipeline);
+
+  return EXIT_SUCCESS;
+}
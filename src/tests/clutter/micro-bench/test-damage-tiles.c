@@ -0,0 +1,143 @@
+#include <clutter-build-config.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clutter/clutter-damage-tiles.h"
+
+#define BPP 4
+#define N_ITERATIONS 20
+
+typedef struct _BufferSize
+{
+  const char *name;
+  int width;
+  int height;
+} BufferSize;
+
+static const BufferSize buffer_sizes[] = {
+  { "1080p", 1920, 1080 },
+  { "4K", 3840, 2160 },
+  { "8K", 7680, 4320 },
+};
+
+static void
+change_pixels (uint8_t *data,
+               int      width,
+               int      height,
+               int      stride,
+               int      n_changes)
+{
+  int i;
+
+  for (i = 0; i < n_changes; i++)
+    {
+      int x = rand () % width;
+      int y = rand () % height;
+
+      data[y * stride + x * BPP] ^= 0xff;
+    }
+}
+
+static double
+run_benchmark (ClutterDamageTiles   *damage_tiles,
+               const uint8_t        *current_data,
+               const uint8_t        *prev_data,
+               int                   width,
+               int                   height,
+               int                   stride,
+               const cairo_region_t *damage_region)
+{
+  int64_t start_us;
+  int i;
+
+  start_us = g_get_monotonic_time ();
+
+  for (i = 0; i < N_ITERATIONS; i++)
+    {
+      cairo_region_t *changed_region;
+
+      changed_region = clutter_damage_tiles_find_changed (damage_tiles,
+                                                          current_data,
+                                                          prev_data,
+                                                          width, height,
+                                                          stride, BPP,
+                                                          damage_region);
+      cairo_region_destroy (changed_region);
+    }
+
+  return (g_get_monotonic_time () - start_us) / (1000.0 * N_ITERATIONS);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  int tile_size = CLUTTER_DAMAGE_TILES_DEFAULT_TILE_SIZE;
+  int n_changes = 100;
+  int i;
+
+  if (argc > 1)
+    tile_size = atoi (argv[1]);
+  if (argc > 2)
+    n_changes = atoi (argv[2]);
+
+  if (tile_size <= 0 || n_changes < 0)
+    {
+      g_printerr ("Usage: test-damage-tiles [TILE_SIZE] [N_CHANGED_PIXELS]\n");
+      return EXIT_FAILURE;
+    }
+
+  g_print ("Tile size %d, %d changed pixels, %d iterations\n",
+           tile_size, n_changes, N_ITERATIONS);
+
+  for (i = 0; i < G_N_ELEMENTS (buffer_sizes); i++)
+    {
+      const BufferSize *size = &buffer_sizes[i];
+      int stride = size->width * BPP;
+      g_autofree uint8_t *prev_data = NULL;
+      g_autofree uint8_t *current_data = NULL;
+      g_autoptr (ClutterDamageTiles) scalar = NULL;
+      g_autoptr (ClutterDamageTiles) simd = NULL;
+      g_autoptr (ClutterDamageTiles) threaded = NULL;
+      cairo_rectangle_int_t full_damage;
+      cairo_region_t *damage_region;
+
+      prev_data = g_malloc0 ((size_t) stride * size->height);
+      current_data = g_malloc0 ((size_t) stride * size->height);
+      change_pixels (current_data, size->width, size->height, stride,
+                     n_changes);
+
+      full_damage = (cairo_rectangle_int_t) {
+        .width = size->width,
+        .height = size->height,
+      };
+      damage_region = cairo_region_create_rectangle (&full_damage);
+
+      scalar = clutter_damage_tiles_new (tile_size,
+                                         CLUTTER_DAMAGE_TILES_FLAG_NO_SIMD |
+                                         CLUTTER_DAMAGE_TILES_FLAG_NO_THREADS);
+      simd = clutter_damage_tiles_new (tile_size,
+                                       CLUTTER_DAMAGE_TILES_FLAG_NO_THREADS);
+      threaded = clutter_damage_tiles_new (tile_size,
+                                           CLUTTER_DAMAGE_TILES_FLAG_NONE);
+
+      g_print ("%-6s scalar: %7.3f ms, %s: %7.3f ms, %s threaded: %7.3f ms\n",
+               size->name,
+               run_benchmark (scalar, current_data, prev_data,
+                              size->width, size->height, stride,
+                              damage_region),
+               clutter_damage_tiles_get_impl_name (simd),
+               run_benchmark (simd, current_data, prev_data,
+                              size->width, size->height, stride,
+                              damage_region),
+               clutter_damage_tiles_get_impl_name (threaded),
+               run_benchmark (threaded, current_data, prev_data,
+                              size->width, size->height, stride,
+                              damage_region));
+
+      cairo_region_destroy (damage_region);
+    }
+
+  return EXIT_SUCCESS;
+}
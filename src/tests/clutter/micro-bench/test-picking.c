@@ -7,6 +7,10 @@
 
 #define N_ACTORS 100
 #define N_EVENTS 5
+#define N_FRAMES_PER_REPORT 500
+
+static int64_t pick_time_us = 0;
+static int n_picked_frames = 0;
 
 static gboolean
 motion_event_cb (ClutterActor *actor, ClutterEvent *event, gpointer user_data)
@@ -14,11 +18,17 @@ motion_event_cb (ClutterActor *actor, ClutterEvent *event, gpointer user_data)
   return FALSE;
 }
 
+/* Run with CLUTTER_PICK=disable-pick-index to compare against picking by
+ * traversing the actor tree on every event.
+ */
 static void
 do_events (ClutterActor *stage)
 {
   glong i;
   static gdouble angle = 0;
+  int64_t start_us;
+
+  start_us = g_get_monotonic_time ();
 
   for (i = 0; i < N_EVENTS; i++)
     {
@@ -34,6 +44,17 @@ do_events (ClutterActor *stage)
 				      256.0 + 206.0 * cos (angle),
 				      256.0 + 206.0 * sin (angle));
     }
+
+  pick_time_us += g_get_monotonic_time () - start_us;
+  n_picked_frames++;
+
+  if (n_picked_frames == N_FRAMES_PER_REPORT)
+    {
+      printf ("%.3f us per frame picking %d events\n",
+              (double) pick_time_us / n_picked_frames, N_EVENTS);
+      pick_time_us = 0;
+      n_picked_frames = 0;
+    }
 }
 
 static void
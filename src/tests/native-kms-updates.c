@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include "backends/native/meta-backend-native.h"
 #include "backends/native/meta-kms-connector.h"
 #include "backends/native/meta-kms-crtc.h"
 #include "backends/native/meta-kms-device.h"
@@ -50,6 +51,7 @@ meta_test_kms_update_sanity (void)
   g_assert_null (meta_kms_update_get_page_flip_listeners (update));
   g_assert_null (meta_kms_update_get_connector_updates (update));
   g_assert_null (meta_kms_update_get_crtc_gammas (update));
+  g_assert_null (meta_kms_update_get_crtc_updates (update));
   meta_kms_update_free (update);
 }
 
@@ -217,6 +219,195 @@ meta_test_kms_update_mode_sets (void)
   meta_kms_update_free (update);
 }
 
+static void
+meta_test_kms_update_vrr (void)
+{
+  MetaKmsDevice *device;
+  MetaKmsUpdate *update;
+  MetaKmsCrtc *crtc;
+  GList *crtc_updates;
+  MetaKmsCrtcUpdate *crtc_update;
+
+  device = meta_get_test_kms_device (test_context);
+  update = meta_kms_update_new (device);
+  crtc = meta_get_test_kms_crtc (device);
+
+  meta_kms_update_set_vrr (update, crtc, TRUE);
+  meta_kms_update_set_vrr (update, crtc, FALSE);
+
+  crtc_updates = meta_kms_update_get_crtc_updates (update);
+  g_assert_cmpuint (g_list_length (crtc_updates), ==, 1);
+  crtc_update = crtc_updates->data;
+
+  g_assert (crtc_update->crtc == crtc);
+  g_assert_true (crtc_update->vrr.has_update);
+  g_assert_false (crtc_update->vrr.is_enabled);
+
+  meta_kms_update_free (update);
+}
+
+typedef struct
+{
+  int n_flipped;
+  int n_discarded;
+  int n_results;
+  MetaKmsFeedbackResult result;
+} AsyncUpdateData;
+
+static void
+async_page_flip_flipped (MetaKmsCrtc  *crtc,
+                         unsigned int  sequence,
+                         unsigned int  tv_sec,
+                         unsigned int  tv_usec,
+                         gpointer      user_data)
+{
+  AsyncUpdateData *data = user_data;
+
+  data->n_flipped++;
+}
+
+static void
+async_page_flip_ready (MetaKmsCrtc *crtc,
+                       gpointer     user_data)
+{
+}
+
+static void
+async_page_flip_mode_set_fallback (MetaKmsCrtc *crtc,
+                                   gpointer     user_data)
+{
+  g_assert_not_reached ();
+}
+
+static void
+async_page_flip_discarded (MetaKmsCrtc  *crtc,
+                           gpointer      user_data,
+                           const GError *error)
+{
+  AsyncUpdateData *data = user_data;
+
+  data->n_discarded++;
+}
+
+static const MetaKmsPageFlipListenerVtable async_page_flip_listener_vtable = {
+  .flipped = async_page_flip_flipped,
+  .ready = async_page_flip_ready,
+  .mode_set_fallback = async_page_flip_mode_set_fallback,
+  .discarded = async_page_flip_discarded,
+};
+
+static void
+on_async_update_result (const MetaKmsFeedback *kms_feedback,
+                        gpointer               user_data)
+{
+  AsyncUpdateData *data = user_data;
+
+  g_assert_true (g_main_context_is_owner (g_main_context_default ()));
+
+  data->n_results++;
+  data->result = meta_kms_feedback_get_result (kms_feedback);
+}
+
+static void
+meta_test_kms_update_async_failure (void)
+{
+  MetaBackend *backend = meta_context_get_backend (test_context);
+  MetaKms *kms = meta_backend_native_get_kms (META_BACKEND_NATIVE (backend));
+  MetaKmsDevice *device;
+  MetaKmsCrtc *crtc;
+  MetaKmsPlane *primary_plane;
+  MetaKmsUpdate *update;
+  g_autoptr (MetaDrmBuffer) buffer = NULL;
+  AsyncUpdateData data = { 0 };
+
+  device = meta_get_test_kms_device (test_context);
+  crtc = meta_get_test_kms_crtc (device);
+  primary_plane = meta_kms_device_get_primary_plane_for (device, crtc);
+
+  g_assert_null (meta_kms_get_pending_update (kms, device));
+
+  /* Sample outside of the buffer, which the kernel always rejects */
+  buffer = meta_create_test_dumb_buffer (device, 16, 16);
+  update = meta_kms_ensure_pending_update (kms, device);
+  meta_kms_update_assign_plane (update,
+                                crtc,
+                                primary_plane,
+                                buffer,
+                                META_FIXED_16_RECTANGLE_INIT_INT (0, 0, 32, 32),
+                                (MetaRectangle) { 0, 0, 32, 32 },
+                                META_KMS_ASSIGN_PLANE_FLAG_NONE);
+  meta_kms_update_add_page_flip_listener (update,
+                                          crtc,
+                                          &async_page_flip_listener_vtable,
+                                          META_KMS_PAGE_FLIP_LISTENER_FLAG_NONE,
+                                          &data,
+                                          NULL);
+  meta_kms_update_add_result_listener (update,
+                                       on_async_update_result,
+                                       &data);
+
+  meta_kms_post_pending_update (kms, device, META_KMS_UPDATE_FLAG_NONE);
+
+  /* Posting doesn't wait for the impl thread */
+  g_assert_cmpint (data.n_results, ==, 0);
+
+  while (data.n_results == 0 || data.n_discarded == 0)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpint (data.result, ==, META_KMS_FEEDBACK_FAILED);
+  g_assert_cmpint (data.n_results, ==, 1);
+  g_assert_cmpint (data.n_discarded, ==, 1);
+  g_assert_cmpint (data.n_flipped, ==, 0);
+}
+
+static void
+meta_test_kms_update_async_shutdown (void)
+{
+  MetaBackend *backend = meta_context_get_backend (test_context);
+  MetaKmsDevice *test_device;
+  MetaKms *kms;
+  MetaKmsDevice *device;
+  MetaKmsUpdate *update;
+  g_autoptr (GError) error = NULL;
+  AsyncUpdateData data = { 0 };
+  int i;
+
+  test_device = meta_get_test_kms_device (test_context);
+
+  kms = meta_kms_new (backend, META_KMS_FLAG_NO_MODE_SETTING, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (kms);
+  g_object_add_weak_pointer (G_OBJECT (kms), (gpointer *) &kms);
+
+  device = meta_kms_create_device (kms,
+                                   meta_kms_device_get_path (test_device),
+                                   META_KMS_DEVICE_FLAG_NONE,
+                                   &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (device);
+
+  /* Leave a few updates in flight in the impl thread while finalizing; they
+   * must be processed before the device they belong to is freed. */
+  for (i = 0; i < 10; i++)
+    {
+      update = meta_kms_ensure_pending_update (kms, device);
+      meta_kms_update_add_result_listener (update,
+                                           on_async_update_result,
+                                           &data);
+      meta_kms_post_pending_update (kms, device, META_KMS_UPDATE_FLAG_NONE);
+    }
+
+  g_assert_cmpint (data.n_results, ==, 0);
+
+  g_object_unref (kms);
+  g_assert_null (kms);
+
+  /* Results that didn't reach the main context before finalizing are
+   * dropped */
+  while (g_main_context_iteration (NULL, FALSE));
+  g_assert_cmpint (data.n_results, ==, 0);
+}
+
 static void
 init_tests (void)
 {
@@ -228,6 +419,12 @@ init_tests (void)
                    meta_test_kms_update_plane_assignments);
   g_test_add_func ("/backends/native/kms/update/mode-sets",
                    meta_test_kms_update_mode_sets);
+  g_test_add_func ("/backends/native/kms/update/vrr",
+                   meta_test_kms_update_vrr);
+  g_test_add_func ("/backends/native/kms/update/async-failure",
+                   meta_test_kms_update_async_failure);
+  g_test_add_func ("/backends/native/kms/update/async-shutdown",
+                   meta_test_kms_update_async_shutdown);
 }
 
 int
@@ -237,6 +434,10 @@ main (int    argc,
   g_autoptr (MetaContext) context = NULL;
   g_autoptr (GError) error = NULL;
 
+  /* Process updates in a KMS thread, without depending on real-time
+   * scheduling being available */
+  g_setenv ("MUTTER_DEBUG_KMS_THREAD_TYPE", "user", FALSE);
+
   context = test_context =
     meta_create_test_context (META_CONTEXT_TEST_TYPE_VKMS,
                               META_CONTEXT_TEST_FLAG_NO_X11);
@@ -42,7 +42,7 @@ test_client_exited (GObject      *source_object,
 }
 
 static void
-meta_test_screen_cast_record_virtual (void)
+run_screen_cast_client (void)
 {
   GSubprocessLauncher *launcher;
   g_autofree char *test_client_path = NULL;
@@ -78,9 +78,27 @@ meta_test_screen_cast_record_virtual (void)
   g_object_unref (subprocess);
 }
 
+static void
+meta_test_screen_cast_record_virtual (void)
+{
+  run_screen_cast_client ();
+}
+
+static void
+meta_test_screen_cast_record_virtual_readback_fallback (void)
+{
+  /* Readback buffers that can't be mapped make the stream fall back to
+   * synchronous readbacks, without dropping any frame. */
+  g_setenv ("MUTTER_DEBUG_DISABLE_SCREEN_CAST_READBACK_MAP", "1", TRUE);
+  run_screen_cast_client ();
+  g_unsetenv ("MUTTER_DEBUG_DISABLE_SCREEN_CAST_READBACK_MAP");
+}
+
 void
 init_screen_cast_tests (void)
 {
   g_test_add_func ("/backends/native/screen-cast/record-virtual",
                    meta_test_screen_cast_record_virtual);
+  g_test_add_func ("/backends/native/screen-cast/record-virtual-readback-fallback",
+                   meta_test_screen_cast_record_virtual_readback_fallback);
 }
@@ -41,6 +41,8 @@
  (sizeof(struct spa_meta_cursor) + \
   sizeof(struct spa_meta_bitmap) + width * height * 4)
 
+#define MAX_DAMAGE_REGIONS 16
+
 enum
   {
     CURSOR_MODE_HIDDEN = 0,
@@ -63,6 +65,9 @@ typedef struct _Stream
 
   int cursor_x;
   int cursor_y;
+
+  int damaged_width;
+  int damaged_height;
 } Stream;
 
 typedef struct _Session
@@ -237,7 +242,7 @@ on_stream_param_changed (void                 *user_data,
   Stream *stream = user_data;
   uint8_t params_buffer[1024];
   struct spa_pod_builder pod_builder;
-  const struct spa_pod *params[3];
+  const struct spa_pod *params[4];
 
   if (!format || id != SPA_PARAM_Format)
     return;
@@ -270,6 +275,16 @@ on_stream_param_changed (void                 *user_data,
                                                    CURSOR_META_SIZE (384, 384)),
     0);
 
+  params[3] = spa_pod_builder_add_object (
+    &pod_builder,
+    SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+    SPA_PARAM_META_type, SPA_POD_Id (SPA_META_VideoDamage),
+    SPA_PARAM_META_size, SPA_POD_CHOICE_RANGE_Int (
+      sizeof (struct spa_meta_region) * MAX_DAMAGE_REGIONS,
+      sizeof (struct spa_meta_region) * 1,
+      sizeof (struct spa_meta_region) * MAX_DAMAGE_REGIONS),
+    0);
+
   pw_stream_update_params (stream->pipewire_stream,
                            params, G_N_ELEMENTS (params));
 }
@@ -292,6 +307,53 @@ process_buffer_metadata (Stream            *stream,
   stream->cursor_y = spa_meta_cursor->position.y;
 }
 
+static void
+process_buffer_damage (Stream            *stream,
+                       struct spa_buffer *buffer)
+{
+  struct spa_meta *spa_meta_video_damage;
+  struct spa_meta_region *spa_meta_region;
+  int width = stream->spa_format.size.width;
+  int height = stream->spa_format.size.height;
+  int n_regions = 0;
+  gboolean is_fully_damaged = FALSE;
+
+  spa_meta_video_damage = spa_buffer_find_meta (buffer, SPA_META_VideoDamage);
+  g_assert_nonnull (spa_meta_video_damage);
+
+  spa_meta_for_each (spa_meta_region, spa_meta_video_damage)
+    {
+      struct spa_region *region = &spa_meta_region->region;
+
+      if (!spa_meta_region_is_valid (spa_meta_region))
+        break;
+
+      g_assert_cmpint (region->position.x, >=, 0);
+      g_assert_cmpint (region->position.y, >=, 0);
+      g_assert_cmpint (region->position.x + region->size.width, <=, width);
+      g_assert_cmpint (region->position.y + region->size.height, <=, height);
+
+      if (region->size.width == width && region->size.height == height)
+        is_fully_damaged = TRUE;
+
+      n_regions++;
+    }
+
+  /* A frame with content always comes with damage */
+  g_assert_cmpint (n_regions, >, 0);
+
+  /* The first frame, and the first one after a resize, have nothing to be
+   * incremental to */
+  if (stream->damaged_width != width || stream->damaged_height != height)
+    {
+      g_assert_true (is_fully_damaged);
+      g_assert_cmpint (n_regions, ==, 1);
+
+      stream->damaged_width = width;
+      stream->damaged_height = height;
+    }
+}
+
 static void
 sanity_check_memfd (struct spa_buffer *buffer)
 {
@@ -324,7 +386,10 @@ process_buffer (Stream            *stream,
 
   if (buffer->datas[0].chunk->size == 0)
     g_assert_not_reached ();
-  else if (buffer->datas[0].type == SPA_DATA_MemFd)
+
+  process_buffer_damage (stream, buffer);
+
+  if (buffer->datas[0].type == SPA_DATA_MemFd)
     sanity_check_memfd (buffer);
   else if (buffer->datas[0].type == SPA_DATA_DmaBuf)
     g_assert_not_reached ();
@@ -348,7 +413,11 @@ on_stream_process (void *user_data)
       next_buffer = pw_stream_dequeue_buffer (stream->pipewire_stream);
 
       if (next_buffer)
-        pw_stream_queue_buffer (stream->pipewire_stream, buffer);
+        {
+          if (buffer->buffer->datas[0].chunk->size > 0)
+            process_buffer_damage (stream, buffer->buffer);
+          pw_stream_queue_buffer (stream->pipewire_stream, buffer);
+        }
     }
   if (!buffer)
     return;
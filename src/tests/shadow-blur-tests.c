@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "tests/shadow-blur-tests.h"
+
+#include <string.h>
+
+#include "compositor/meta-shadow-blur.h"
+
+#define N_BENCHMARK_ITERATIONS 10
+
+static cairo_region_t *
+create_rounded_rect_region (int width,
+                            int height,
+                            int corner_radius)
+{
+  cairo_region_t *region;
+  int y;
+
+  region = cairo_region_create ();
+
+  for (y = 0; y < height; y++)
+    {
+      cairo_rectangle_int_t row;
+      int inset = 0;
+
+      if (y < corner_radius)
+        inset = corner_radius - y;
+      else if (y >= height - corner_radius)
+        inset = y - (height - corner_radius) + 1;
+
+      row = (cairo_rectangle_int_t) {
+        .x = inset,
+        .y = y,
+        .width = width - 2 * inset,
+        .height = 1,
+      };
+      cairo_region_union_rectangle (region, &row);
+    }
+
+  return region;
+}
+
+static cairo_region_t *
+create_split_region (void)
+{
+  cairo_rectangle_int_t rects[] = {
+    { 0, 0, 37, 50 },
+    { 41, 0, 59, 50 },
+    { 0, 50, 100, 9 },
+    { 20, 59, 9, 30 },
+  };
+
+  return cairo_region_create_rectangles (rects, G_N_ELEMENTS (rects));
+}
+
+static void
+assert_blur_matches_reference (cairo_region_t *region,
+                               int             radius)
+{
+  g_autoptr (MetaShadowBlur) reference = NULL;
+  g_autofree uint8_t *expected = NULL;
+  int expected_width;
+  int expected_height;
+  MetaShadowBlurFlags flags[] = {
+    META_SHADOW_BLUR_FLAG_NO_SIMD | META_SHADOW_BLUR_FLAG_NO_THREADS,
+    META_SHADOW_BLUR_FLAG_NO_THREADS,
+    META_SHADOW_BLUR_FLAG_NO_SIMD,
+    META_SHADOW_BLUR_FLAG_NONE,
+  };
+  int i;
+
+  reference = meta_shadow_blur_new (META_SHADOW_BLUR_FLAG_REFERENCE);
+  expected = meta_shadow_blur_region (reference, region, radius,
+                                      &expected_width, &expected_height);
+
+  for (i = 0; i < G_N_ELEMENTS (flags); i++)
+    {
+      g_autoptr (MetaShadowBlur) blur = NULL;
+      g_autofree uint8_t *result = NULL;
+      int width;
+      int height;
+
+      blur = meta_shadow_blur_new (flags[i]);
+      result = meta_shadow_blur_region (blur, region, radius, &width, &height);
+
+      g_assert_cmpint (width, ==, expected_width);
+      g_assert_cmpint (height, ==, expected_height);
+      if (memcmp (result, expected, (size_t) width * height) != 0)
+        {
+          g_error ("%s blur (flags 0x%x) differs from reference for radius %d",
+                   meta_shadow_blur_get_impl_name (blur), flags[i], radius);
+        }
+    }
+}
+
+static void
+meta_test_shadow_blur_bit_exact (void)
+{
+  int radii[] = { 1, 2, 3, 5, 8, 12, 20, 40, 140 };
+  cairo_rectangle_int_t rect = { 0, 0, 53, 31 };
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (radii); i++)
+    {
+      cairo_region_t *region;
+
+      region = cairo_region_create_rectangle (&rect);
+      assert_blur_matches_reference (region, radii[i]);
+      cairo_region_destroy (region);
+
+      region = create_rounded_rect_region (67, 45, 12);
+      assert_blur_matches_reference (region, radii[i]);
+      cairo_region_destroy (region);
+
+      region = create_split_region ();
+      assert_blur_matches_reference (region, radii[i]);
+      cairo_region_destroy (region);
+    }
+}
+
+static void
+meta_test_shadow_blur_bit_exact_large (void)
+{
+  cairo_region_t *region;
+
+  /* Large enough for the blur to be split across threads */
+  region = create_rounded_rect_region (2560, 1440, 16);
+  assert_blur_matches_reference (region, 10);
+  assert_blur_matches_reference (region, 40);
+  cairo_region_destroy (region);
+}
+
+static double
+run_benchmark (MetaShadowBlur *blur,
+               cairo_region_t *region,
+               int             radius)
+{
+  int64_t start_us;
+  int i;
+
+  start_us = g_get_monotonic_time ();
+
+  for (i = 0; i < N_BENCHMARK_ITERATIONS; i++)
+    {
+      g_autofree uint8_t *buffer = NULL;
+      int width;
+      int height;
+
+      buffer = meta_shadow_blur_region (blur, region, radius, &width, &height);
+    }
+
+  return (g_get_monotonic_time () - start_us) / (1000.0 * N_BENCHMARK_ITERATIONS);
+}
+
+static void
+meta_test_shadow_blur_benchmark (void)
+{
+  struct
+  {
+    int width;
+    int height;
+    int radius;
+  } cases[] = {
+    { 800, 600, 10 },
+    { 1920, 1080, 10 },
+    { 1920, 1080, 40 },
+    { 3840, 2160, 40 },
+  };
+  g_autoptr (MetaShadowBlur) reference = NULL;
+  g_autoptr (MetaShadowBlur) simd = NULL;
+  g_autoptr (MetaShadowBlur) threaded = NULL;
+  int i;
+
+  if (!g_test_perf ())
+    {
+      g_test_skip ("Only runs in perf mode");
+      return;
+    }
+
+  reference = meta_shadow_blur_new (META_SHADOW_BLUR_FLAG_REFERENCE);
+  simd = meta_shadow_blur_new (META_SHADOW_BLUR_FLAG_NO_THREADS);
+  threaded = meta_shadow_blur_new (META_SHADOW_BLUR_FLAG_NONE);
+
+  for (i = 0; i < G_N_ELEMENTS (cases); i++)
+    {
+      cairo_region_t *region;
+
+      region = create_rounded_rect_region (cases[i].width, cases[i].height, 8);
+
+      g_test_message ("%dx%d radius %d: reference %.3f ms, "
+                      "%s %.3f ms, %s threaded %.3f ms",
+                      cases[i].width, cases[i].height, cases[i].radius,
+                      run_benchmark (reference, region, cases[i].radius),
+                      meta_shadow_blur_get_impl_name (simd),
+                      run_benchmark (simd, region, cases[i].radius),
+                      meta_shadow_blur_get_impl_name (threaded),
+                      run_benchmark (threaded, region, cases[i].radius));
+
+      cairo_region_destroy (region);
+    }
+}
+
+void
+init_shadow_blur_tests (void)
+{
+  g_test_add_func ("/compositor/shadow-blur/bit-exact",
+                   meta_test_shadow_blur_bit_exact);
+  g_test_add_func ("/compositor/shadow-blur/bit-exact-large",
+                   meta_test_shadow_blur_bit_exact_large);
+  g_test_add_func ("/compositor/shadow-blur/benchmark",
+                   meta_test_shadow_blur_benchmark);
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "tests/shadow-disk-cache-tests.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "compositor/meta-shadow-disk-cache.h"
+
+#define MASK_WIDTH 64
+#define MASK_HEIGHT 48
+
+static char *
+create_cache_dir (void)
+{
+  g_autoptr (GError) error = NULL;
+  char *path;
+
+  path = g_dir_make_tmp ("mutter-shadow-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  return path;
+}
+
+static void
+remove_cache_dir (const char *path)
+{
+  g_autoptr (GDir) dir = NULL;
+  const char *name;
+
+  dir = g_dir_open (path, 0, NULL);
+  g_assert_nonnull (dir);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      g_autofree char *file_path = NULL;
+
+      file_path = g_build_filename (path, name, NULL);
+      g_assert_cmpint (g_unlink (file_path), ==, 0);
+    }
+
+  g_assert_cmpint (g_rmdir (path), ==, 0);
+}
+
+static uint64_t
+get_cache_dir_size (const char *path)
+{
+  g_autoptr (GDir) dir = NULL;
+  const char *name;
+  uint64_t size = 0;
+
+  dir = g_dir_open (path, 0, NULL);
+  g_assert_nonnull (dir);
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      g_autofree char *file_path = NULL;
+      GStatBuf stat_buf;
+
+      file_path = g_build_filename (path, name, NULL);
+      g_assert_cmpint (g_stat (file_path, &stat_buf), ==, 0);
+      size += stat_buf.st_size;
+    }
+
+  return size;
+}
+
+static int
+count_cache_entries (const char *path)
+{
+  g_autoptr (GDir) dir = NULL;
+  int n_entries = 0;
+
+  dir = g_dir_open (path, 0, NULL);
+  g_assert_nonnull (dir);
+
+  while (g_dir_read_name (dir))
+    n_entries++;
+
+  return n_entries;
+}
+
+static uint8_t *
+create_mask (int seed)
+{
+  uint8_t *mask;
+  int x, y;
+
+  mask = g_malloc (MASK_WIDTH * MASK_HEIGHT);
+  for (y = 0; y < MASK_HEIGHT; y++)
+    {
+      for (x = 0; x < MASK_WIDTH; x++)
+        mask[y * MASK_WIDTH + x] = (x * y + seed * 7) & 0xff;
+    }
+
+  return mask;
+}
+
+static void
+meta_test_shadow_disk_cache_roundtrip (void)
+{
+  g_autofree char *path = NULL;
+  g_autofree uint8_t *mask = NULL;
+  g_autofree uint8_t *padded = NULL;
+  g_autofree uint8_t *result = NULL;
+  MetaShadowDiskCache *cache;
+  int y;
+
+  path = create_cache_dir ();
+  cache = meta_shadow_disk_cache_new (path, 1024 * 1024);
+
+  g_assert_null (meta_shadow_disk_cache_lookup (cache, "missing",
+                                                MASK_WIDTH, MASK_HEIGHT));
+
+  /* Store from a buffer with padding, the cache packs the rows */
+  mask = create_mask (1);
+  padded = g_malloc0 ((MASK_WIDTH + 16) * MASK_HEIGHT);
+  for (y = 0; y < MASK_HEIGHT; y++)
+    memcpy (padded + y * (MASK_WIDTH + 16), mask + y * MASK_WIDTH, MASK_WIDTH);
+
+  meta_shadow_disk_cache_store (cache, "entry", padded,
+                                MASK_WIDTH, MASK_HEIGHT, MASK_WIDTH + 16);
+  meta_shadow_disk_cache_flush (cache);
+  meta_shadow_disk_cache_free (cache);
+
+  /* A new cache on the same directory finds the entry once loaded */
+  cache = meta_shadow_disk_cache_new (path, 1024 * 1024);
+  meta_shadow_disk_cache_flush (cache);
+
+  g_assert_null (meta_shadow_disk_cache_lookup (cache, "entry",
+                                                MASK_WIDTH + 1, MASK_HEIGHT));
+
+  result = meta_shadow_disk_cache_lookup (cache, "entry",
+                                          MASK_WIDTH, MASK_HEIGHT);
+  g_assert_nonnull (result);
+  g_assert_cmpmem (result, MASK_WIDTH * MASK_HEIGHT,
+                   mask, MASK_WIDTH * MASK_HEIGHT);
+
+  /* Found entries are handed over */
+  g_assert_null (meta_shadow_disk_cache_lookup (cache, "entry",
+                                                MASK_WIDTH, MASK_HEIGHT));
+
+  meta_shadow_disk_cache_free (cache);
+  remove_cache_dir (path);
+}
+
+static void
+meta_test_shadow_disk_cache_corrupt (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree char *path = NULL;
+  g_autofree char *entry_path = NULL;
+  g_autofree uint8_t *mask = NULL;
+  g_autofree char *contents = NULL;
+  MetaShadowDiskCache *cache;
+  gsize length;
+
+  path = create_cache_dir ();
+  cache = meta_shadow_disk_cache_new (path, 1024 * 1024);
+
+  mask = create_mask (2);
+  meta_shadow_disk_cache_store (cache, "entry", mask,
+                                MASK_WIDTH, MASK_HEIGHT, MASK_WIDTH);
+  meta_shadow_disk_cache_flush (cache);
+  meta_shadow_disk_cache_free (cache);
+
+  entry_path = g_build_filename (path, "entry.shadow", NULL);
+  g_file_get_contents (entry_path, &contents, &length, &error);
+  g_assert_no_error (error);
+
+  g_file_set_contents (entry_path, contents, length - 4, &error);
+  g_assert_no_error (error);
+
+  cache = meta_shadow_disk_cache_new (path, 1024 * 1024);
+  meta_shadow_disk_cache_flush (cache);
+
+  g_assert_null (meta_shadow_disk_cache_lookup (cache, "entry",
+                                                MASK_WIDTH, MASK_HEIGHT));
+  g_assert_false (g_file_test (entry_path, G_FILE_TEST_EXISTS));
+
+  meta_shadow_disk_cache_free (cache);
+  remove_cache_dir (path);
+}
+
+static void
+meta_test_shadow_disk_cache_eviction (void)
+{
+  g_autofree char *path = NULL;
+  g_autofree uint8_t *newest = NULL;
+  MetaShadowDiskCache *cache;
+  uint64_t max_size = 4096;
+  int n_entries;
+  int i;
+
+  path = create_cache_dir ();
+  cache = meta_shadow_disk_cache_new (path, max_size);
+
+  for (i = 0; i < 64; i++)
+    {
+      g_autofree uint8_t *mask = NULL;
+      g_autofree char *key = NULL;
+
+      mask = create_mask (i);
+      key = g_strdup_printf ("entry-%d", i);
+      meta_shadow_disk_cache_store (cache, key, mask,
+                                    MASK_WIDTH, MASK_HEIGHT, MASK_WIDTH);
+    }
+  meta_shadow_disk_cache_flush (cache);
+
+  g_assert_cmpuint (get_cache_dir_size (path), <=, max_size);
+  n_entries = count_cache_entries (path);
+
+  /* Rewriting an entry doesn't count its old size twice, which would make
+   * it evict the others */
+  for (i = 0; i < 16; i++)
+    {
+      g_autofree uint8_t *mask = NULL;
+
+      mask = create_mask (63);
+      meta_shadow_disk_cache_store (cache, "entry-63", mask,
+                                    MASK_WIDTH, MASK_HEIGHT, MASK_WIDTH);
+    }
+  meta_shadow_disk_cache_flush (cache);
+  meta_shadow_disk_cache_free (cache);
+
+  g_assert_cmpint (count_cache_entries (path), ==, n_entries);
+
+  cache = meta_shadow_disk_cache_new (path, 1024 * 1024);
+  meta_shadow_disk_cache_flush (cache);
+
+  newest = meta_shadow_disk_cache_lookup (cache, "entry-63",
+                                          MASK_WIDTH, MASK_HEIGHT);
+  g_assert_nonnull (newest);
+
+  meta_shadow_disk_cache_free (cache);
+  remove_cache_dir (path);
+}
+
+void
+init_shadow_disk_cache_tests (void)
+{
+  g_test_add_func ("/compositor/shadow-disk-cache/roundtrip",
+                   meta_test_shadow_disk_cache_roundtrip);
+  g_test_add_func ("/compositor/shadow-disk-cache/corrupt",
+                   meta_test_shadow_disk_cache_corrupt);
+  g_test_add_func ("/compositor/shadow-disk-cache/eviction",
+                   meta_test_shadow_disk_cache_eviction);
+}
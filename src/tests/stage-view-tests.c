@@ -17,8 +17,10 @@
 
 #include "config.h"
 
+#include "backends/meta-stage-private.h"
 #include "clutter/clutter.h"
 #include "clutter/clutter-stage-view-private.h"
+#include "compositor/meta-shaped-texture-private.h"
 #include "compositor/meta-window-actor-private.h"
 #include "meta-test/meta-context-test.h"
 #include "meta/meta-window-actor.h"
@@ -1319,6 +1321,107 @@ meta_test_timeline_actor_tree_clear (void)
   clutter_actor_destroy (container2);
 }
 
+typedef struct
+{
+  MetaStageWatch *watch;
+  uint8_t overlaid_pixel[4];
+  uint8_t clone_pixel[4];
+} OverlayPaintData;
+
+static void
+on_overlay_after_paint (MetaStage           *stage,
+                        ClutterStageView    *view,
+                        ClutterPaintContext *paint_context,
+                        gpointer             user_data)
+{
+  OverlayPaintData *data = user_data;
+  CoglFramebuffer *framebuffer = clutter_stage_view_get_framebuffer (view);
+
+  meta_stage_remove_watch (stage, data->watch);
+  data->watch = NULL;
+
+  cogl_framebuffer_read_pixels (framebuffer, 32, 32, 1, 1,
+                                COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                data->overlaid_pixel);
+  cogl_framebuffer_read_pixels (framebuffer, 132, 32, 1, 1,
+                                COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                data->clone_pixel);
+}
+
+static void
+meta_test_shaped_texture_overlay_clone (void)
+{
+  MetaBackend *backend = meta_get_backend ();
+  ClutterBackend *clutter_backend = clutter_get_default_backend ();
+  CoglContext *cogl_context =
+    clutter_backend_get_cogl_context (clutter_backend);
+  ClutterActor *stage = meta_backend_get_stage (backend);
+  ClutterStageView *view;
+  g_autofree uint8_t *pixels = NULL;
+  CoglTexture *texture;
+  MetaShapedTexture *stex;
+  ClutterActor *actor;
+  ClutterActor *clone;
+  OverlayPaintData data = { 0 };
+  int i;
+
+  ensure_view_count (1);
+  view = clutter_stage_peek_stage_views (CLUTTER_STAGE (stage))->data;
+
+  pixels = g_malloc (64 * 64 * 4);
+  for (i = 0; i < 64 * 64; i++)
+    {
+      pixels[i * 4 + 0] = 0x12;
+      pixels[i * 4 + 1] = 0xb4;
+      pixels[i * 4 + 2] = 0x56;
+      pixels[i * 4 + 3] = 0xff;
+    }
+  texture = COGL_TEXTURE (cogl_texture_2d_new_from_data (cogl_context,
+                                                         64, 64,
+                                                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                         64 * 4,
+                                                         pixels,
+                                                         NULL));
+  g_assert_nonnull (texture);
+
+  stex = meta_shaped_texture_new ();
+  meta_shaped_texture_set_texture (stex, texture);
+
+  actor = clutter_actor_new ();
+  clutter_actor_set_content (actor, CLUTTER_CONTENT (stex));
+  clutter_actor_set_size (actor, 64, 64);
+  clutter_actor_add_child (stage, actor);
+
+  clone = clutter_clone_new (actor);
+  clutter_actor_set_position (clone, 100, 0);
+  clutter_actor_add_child (stage, clone);
+
+  /* The actor itself is shown by an overlay plane, the clone isn't. */
+  meta_shaped_texture_set_overlay_view (stex, view);
+
+  data.watch = meta_stage_watch_view (META_STAGE (stage), view,
+                                      META_STAGE_WATCH_AFTER_PAINT,
+                                      on_overlay_after_paint,
+                                      &data);
+  clutter_stage_view_add_redraw_clip (view, NULL);
+  clutter_stage_view_schedule_update (view);
+
+  while (data.watch)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (data.clone_pixel[0], ==, 0x12);
+  g_assert_cmpuint (data.clone_pixel[1], ==, 0xb4);
+  g_assert_cmpuint (data.clone_pixel[2], ==, 0x56);
+  g_assert_false (data.overlaid_pixel[0] == 0x12 &&
+                  data.overlaid_pixel[1] == 0xb4 &&
+                  data.overlaid_pixel[2] == 0x56);
+
+  clutter_actor_destroy (clone);
+  clutter_actor_destroy (actor);
+  g_object_unref (stex);
+  cogl_object_unref (texture);
+}
+
 static void
 on_before_tests (MetaContext *context)
 {
@@ -1358,6 +1461,8 @@ init_tests (void)
                    meta_test_timeline_actor_destroyed);
   g_test_add_func ("/stage-views/timeline/tree-clear",
                    meta_test_timeline_actor_tree_clear);
+  g_test_add_func ("/stage-views/shaped-texture/overlay-clone",
+                   meta_test_shaped_texture_overlay_clone);
 }
 
 int
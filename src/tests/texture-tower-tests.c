@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2022 Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "tests/texture-tower-tests.h"
+
+#include "compositor/meta-texture-tower.h"
+
+/* Levels generated incrementally are drawn with different geometry than
+ * levels generated in one go, so allow for rounding differences */
+#define PIXEL_TOLERANCE 2
+
+static CoglContext *
+get_cogl_context (void)
+{
+  return clutter_backend_get_cogl_context (clutter_get_default_backend ());
+}
+
+static uint8_t *
+create_pattern (int      width,
+                int      height,
+                uint32_t seed)
+{
+  uint8_t *pixels;
+  int i;
+
+  pixels = g_malloc (width * height * 4);
+  for (i = 0; i < width * height; i++)
+    {
+      uint32_t value = (i + seed) * 2654435761u;
+
+      pixels[i * 4 + 0] = value >> 24;
+      pixels[i * 4 + 1] = value >> 16;
+      pixels[i * 4 + 2] = value >> 8;
+      pixels[i * 4 + 3] = 0xff;
+    }
+
+  return pixels;
+}
+
+static CoglTexture *
+create_base_texture (int width,
+                     int height)
+{
+  g_autofree uint8_t *pixels = NULL;
+  CoglTexture *texture;
+
+  pixels = create_pattern (width, height, 0);
+  texture = COGL_TEXTURE (cogl_texture_2d_new_from_data (get_cogl_context (),
+                                                         width, height,
+                                                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                                         width * 4,
+                                                         pixels,
+                                                         NULL));
+  g_assert_nonnull (texture);
+
+  return texture;
+}
+
+static void
+change_base_texture (MetaTextureTower            *tower,
+                     CoglTexture                 *texture,
+                     const cairo_rectangle_int_t *rect,
+                     uint32_t                     seed)
+{
+  g_autofree uint8_t *pixels = NULL;
+
+  pixels = create_pattern (rect->width, rect->height, seed);
+  g_assert_true (cogl_texture_set_region (texture,
+                                          rect->width, rect->height,
+                                          COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                          rect->width * 4,
+                                          pixels,
+                                          rect->x, rect->y,
+                                          0,
+                                          NULL));
+
+  meta_texture_tower_update_area (tower,
+                                  rect->x, rect->y,
+                                  rect->width, rect->height);
+}
+
+static uint8_t *
+get_level_pixels (MetaTextureTower *tower,
+                  int               level,
+                  int              *width,
+                  int              *height)
+{
+  g_autoptr (CoglOffscreen) offscreen = NULL;
+  CoglFramebuffer *framebuffer;
+  ClutterPaintContext *paint_context;
+  CoglTexture *target;
+  CoglTexture *texture = NULL;
+  uint8_t *pixels;
+  int i;
+
+  /* Paint at the scale the level is meant for */
+  target = COGL_TEXTURE (cogl_texture_2d_new_with_size (get_cogl_context (),
+                                                        16, 16));
+  offscreen = cogl_offscreen_new_with_texture (target);
+  cogl_object_unref (target);
+  framebuffer = COGL_FRAMEBUFFER (offscreen);
+  g_assert_true (cogl_framebuffer_allocate (framebuffer, NULL));
+  cogl_framebuffer_orthographic (framebuffer, 0, 0, 16, 16, -1, 1);
+  cogl_framebuffer_scale (framebuffer,
+                          1.0f / (1 << level), 1.0f / (1 << level), 1.0f);
+
+  paint_context = clutter_paint_context_new_for_framebuffer (framebuffer,
+                                                             NULL,
+                                                             CLUTTER_PAINT_FLAG_NONE);
+
+  for (i = 0; i < 100; i++)
+    {
+      texture = meta_texture_tower_get_paint_texture (tower, paint_context);
+      if (!meta_texture_tower_has_pending_update (tower))
+        break;
+    }
+  g_assert_false (meta_texture_tower_has_pending_update (tower));
+  g_assert_nonnull (texture);
+
+  clutter_paint_context_destroy (paint_context);
+
+  *width = cogl_texture_get_width (texture);
+  *height = cogl_texture_get_height (texture);
+
+  pixels = g_malloc (*width * *height * 4);
+  cogl_texture_get_data (texture,
+                         COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                         *width * 4,
+                         pixels);
+
+  return pixels;
+}
+
+static void
+assert_levels_equal (MetaTextureTower *tower,
+                     MetaTextureTower *reference_tower,
+                     int               n_levels)
+{
+  int level;
+
+  for (level = 1; level < n_levels; level++)
+    {
+      g_autofree uint8_t *pixels = NULL;
+      g_autofree uint8_t *reference_pixels = NULL;
+      int width, height;
+      int reference_width, reference_height;
+      int i;
+
+      pixels = get_level_pixels (tower, level, &width, &height);
+      reference_pixels = get_level_pixels (reference_tower, level,
+                                           &reference_width,
+                                           &reference_height);
+
+      g_assert_cmpint (width, ==, reference_width);
+      g_assert_cmpint (height, ==, reference_height);
+
+      for (i = 0; i < width * height * 4; i++)
+        {
+          if (ABS (pixels[i] - reference_pixels[i]) > PIXEL_TOLERANCE)
+            {
+              g_error ("Level %d differs at (%d, %d): 0x%02x != 0x%02x",
+                       level,
+                       (i / 4) % width, (i / 4) / width,
+                       pixels[i], reference_pixels[i]);
+            }
+        }
+    }
+}
+
+static int
+get_n_levels (int width,
+              int height)
+{
+  int size = MAX (width, height);
+  int n_levels = 0;
+
+  while (size > 1 && n_levels < 6)
+    {
+      size /= 2;
+      n_levels++;
+    }
+
+  return n_levels;
+}
+
+static void
+check_partial_updates (int                          width,
+                       int                          height,
+                       const cairo_rectangle_int_t *rects,
+                       int                          n_rects)
+{
+  CoglTexture *texture;
+  MetaTextureTower *tower;
+  int n_levels;
+  int i;
+
+  texture = create_base_texture (width, height);
+  n_levels = get_n_levels (width, height);
+
+  tower = meta_texture_tower_new ();
+  meta_texture_tower_set_base_texture (tower, texture);
+
+  /* Generate all levels, so that the changes only invalidate parts */
+  for (i = 1; i < n_levels; i++)
+    {
+      int level_width, level_height;
+
+      g_free (get_level_pixels (tower, i, &level_width, &level_height));
+    }
+
+  for (i = 0; i < n_rects; i++)
+    {
+      MetaTextureTower *reference_tower;
+
+      change_base_texture (tower, texture, &rects[i], i + 1);
+
+      /* A new tower regenerates each level from scratch */
+      reference_tower = meta_texture_tower_new ();
+      meta_texture_tower_set_base_texture (reference_tower, texture);
+
+      assert_levels_equal (tower, reference_tower, n_levels);
+
+      meta_texture_tower_free (reference_tower);
+    }
+
+  meta_texture_tower_free (tower);
+  cogl_object_unref (texture);
+}
+
+static void
+meta_test_texture_tower_partial_update (void)
+{
+  cairo_rectangle_int_t rects[] = {
+    { 0, 0, 1, 1 },
+    { 17, 9, 5, 3 },
+    { 32, 32, 32, 32 },
+    { 63, 0, 1, 64 },
+    { 3, 60, 50, 4 },
+  };
+
+  check_partial_updates (64, 64, rects, G_N_ELEMENTS (rects));
+}
+
+static void
+meta_test_texture_tower_odd_size (void)
+{
+  cairo_rectangle_int_t rects[] = {
+    /* The last column and row are only covered by some of the levels */
+    { 36, 0, 1, 23 },
+    { 0, 22, 37, 1 },
+    { 35, 21, 2, 2 },
+    { 13, 7, 3, 5 },
+  };
+  cairo_rectangle_int_t narrow_rects[] = {
+    /* Levels are clamped to a single column early on */
+    { 2, 0, 1, 1 },
+    { 0, 40, 3, 9 },
+    { 1, 128, 2, 1 },
+  };
+
+  check_partial_updates (37, 23, rects, G_N_ELEMENTS (rects));
+  check_partial_updates (3, 129, narrow_rects, G_N_ELEMENTS (narrow_rects));
+}
+
+void
+init_texture_tower_tests (void)
+{
+  g_test_add_func ("/compositor/texture-tower/partial-update",
+                   meta_test_texture_tower_partial_update);
+  g_test_add_func ("/compositor/texture-tower/odd-size",
+                   meta_test_texture_tower_odd_size);
+}
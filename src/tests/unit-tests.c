@@ -30,12 +30,16 @@
 #include "core/boxes-private.h"
 #include "meta-test/meta-context-test.h"
 #include "meta/meta-context.h"
+#include "tests/background-image-tests.h"
 #include "tests/boxes-tests.h"
 #include "tests/monitor-config-migration-unit-tests.h"
 #include "tests/monitor-store-unit-tests.h"
 #include "tests/monitor-transform-tests.h"
 #include "tests/meta-test-utils.h"
 #include "tests/orientation-manager-unit-tests.h"
+#include "tests/shadow-blur-tests.h"
+#include "tests/shadow-disk-cache-tests.h"
+#include "tests/texture-tower-tests.h"
 
 MetaContext *test_context;
 
@@ -231,6 +235,10 @@ init_tests (void)
   init_boxes_tests ();
   init_monitor_transform_tests ();
   init_orientation_manager_tests ();
+  init_shadow_blur_tests ();
+  init_shadow_disk_cache_tests ();
+  init_background_image_tests ();
+  init_texture_tower_tests ();
 }
 
 int
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "wayland-test-client-utils.h"
+
+/* Enough frames for the compositor to measure the drawing time, and then
+ * pace a good number of frame callbacks */
+#define N_FRAMES 40
+
+static WaylandDisplay *display;
+
+static struct wl_surface *surface;
+static struct xdg_surface *xdg_surface;
+static struct xdg_toplevel *xdg_toplevel;
+
+static gboolean waiting_for_configure = TRUE;
+static int n_frames;
+
+static void draw_frame (void);
+
+static void
+handle_frame_callback (void               *data,
+                       struct wl_callback *callback,
+                       uint32_t            time)
+{
+  wl_callback_destroy (callback);
+
+  /* Report when the frame callback was sent */
+  test_driver_sync_point (display->test_driver, time, surface);
+
+  if (++n_frames == N_FRAMES)
+    {
+      wl_display_roundtrip (display->display);
+      exit (EXIT_SUCCESS);
+    }
+
+  /* Draw right away, i.e. as quickly as possible */
+  draw_frame ();
+}
+
+static const struct wl_callback_listener frame_listener = {
+  handle_frame_callback,
+};
+
+static void
+draw_frame (void)
+{
+  struct wl_callback *callback;
+
+  draw_surface (display, surface, 100, 100,
+                n_frames % 2 ? 0xff00ff00 : 0xff0000ff);
+
+  callback = wl_surface_frame (surface);
+  wl_callback_add_listener (callback, &frame_listener, NULL);
+  wl_surface_commit (surface);
+  wl_display_flush (display->display);
+}
+
+static void
+handle_xdg_toplevel_configure (void                *data,
+                               struct xdg_toplevel *xdg_toplevel,
+                               int32_t              width,
+                               int32_t              height,
+                               struct wl_array     *state)
+{
+}
+
+static void
+handle_xdg_toplevel_close (void                *data,
+                           struct xdg_toplevel *xdg_toplevel)
+{
+  g_assert_not_reached ();
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+  handle_xdg_toplevel_configure,
+  handle_xdg_toplevel_close,
+};
+
+static void
+handle_xdg_surface_configure (void               *data,
+                              struct xdg_surface *xdg_surface,
+                              uint32_t            serial)
+{
+  xdg_surface_ack_configure (xdg_surface, serial);
+
+  if (!waiting_for_configure)
+    {
+      wl_surface_commit (surface);
+      return;
+    }
+
+  waiting_for_configure = FALSE;
+  draw_frame ();
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+  handle_xdg_surface_configure,
+};
+
+int
+main (int    argc,
+      char **argv)
+{
+  display = wayland_display_new (WAYLAND_DISPLAY_CAPABILITY_TEST_DRIVER);
+
+  surface = wl_compositor_create_surface (display->compositor);
+  xdg_surface = xdg_wm_base_get_xdg_surface (display->xdg_wm_base, surface);
+  xdg_surface_add_listener (xdg_surface, &xdg_surface_listener, NULL);
+  xdg_toplevel = xdg_surface_get_toplevel (xdg_surface);
+  xdg_toplevel_add_listener (xdg_toplevel, &xdg_toplevel_listener, NULL);
+  xdg_toplevel_set_title (xdg_toplevel, "frame-callback-pacing");
+  wl_surface_commit (surface);
+
+  while (TRUE)
+    {
+      if (wl_display_dispatch (display->display) == -1)
+        return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
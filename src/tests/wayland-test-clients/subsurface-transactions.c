@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <wayland-client.h>
+
+#include "wayland-test-client-utils.h"
+
+typedef enum _State
+{
+  STATE_INIT = 0,
+  STATE_WAIT_FOR_CONFIGURE,
+  STATE_WAIT_FOR_FRAME,
+} State;
+
+static WaylandDisplay *display;
+
+static struct wl_surface *surface;
+static struct xdg_surface *xdg_surface;
+static struct xdg_toplevel *xdg_toplevel;
+
+static struct wl_surface *subsurface_surface;
+static struct wl_subsurface *subsurface;
+
+static gboolean running;
+
+static State state;
+
+static void
+draw_main (void)
+{
+  draw_surface (display, surface, 200, 200, 0xff00ff00);
+}
+
+static void
+test_subsurface_ordering (void)
+{
+  /* The compositor holds back transactions from here on. */
+  test_driver_sync_point (display->test_driver, 0, NULL);
+
+  wl_subsurface_set_position (subsurface, 20, 20);
+  draw_surface (display, subsurface_surface, 50, 50, 0xff0000ff);
+  wl_surface_commit (subsurface_surface);
+  wl_surface_commit (surface);
+
+  /* Committed while the previous parent commit is still queued, must not
+   * be applied along with it. */
+  wl_subsurface_set_position (subsurface, 30, 30);
+  draw_surface (display, subsurface_surface, 30, 30, 0xffff0000);
+  wl_surface_commit (subsurface_surface);
+
+  test_driver_sync_point (display->test_driver, 1, subsurface_surface);
+
+  wl_surface_commit (surface);
+  test_driver_sync_point (display->test_driver, 2, subsurface_surface);
+}
+
+static void
+test_destroy_while_queued (void)
+{
+  test_driver_sync_point (display->test_driver, 3, NULL);
+
+  draw_surface (display, subsurface_surface, 40, 40, 0xff00ffff);
+  wl_surface_commit (subsurface_surface);
+  wl_surface_commit (surface);
+
+  wl_subsurface_destroy (subsurface);
+  wl_surface_destroy (subsurface_surface);
+
+  test_driver_sync_point (display->test_driver, 4, NULL);
+
+  test_driver_sync_point (display->test_driver, 5, NULL);
+
+  draw_main ();
+  wl_surface_commit (surface);
+
+  xdg_toplevel_destroy (xdg_toplevel);
+  xdg_surface_destroy (xdg_surface);
+  wl_surface_destroy (surface);
+
+  test_driver_sync_point (display->test_driver, 6, NULL);
+}
+
+static void
+handle_xdg_toplevel_configure (void                *data,
+                               struct xdg_toplevel *xdg_toplevel,
+                               int32_t              width,
+                               int32_t              height,
+                               struct wl_array     *state)
+{
+}
+
+static void
+handle_xdg_toplevel_close (void                *data,
+                           struct xdg_toplevel *xdg_toplevel)
+{
+  g_assert_not_reached ();
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+  handle_xdg_toplevel_configure,
+  handle_xdg_toplevel_close,
+};
+
+static void
+handle_frame_callback (void               *data,
+                       struct wl_callback *callback,
+                       uint32_t            time)
+{
+  g_assert_cmpint (state, ==, STATE_WAIT_FOR_FRAME);
+
+  wl_callback_destroy (callback);
+
+  test_subsurface_ordering ();
+  test_destroy_while_queued ();
+
+  wl_display_roundtrip (display->display);
+  running = FALSE;
+}
+
+static const struct wl_callback_listener frame_listener = {
+  handle_frame_callback,
+};
+
+static void
+handle_xdg_surface_configure (void               *data,
+                              struct xdg_surface *xdg_surface,
+                              uint32_t            serial)
+{
+  struct wl_callback *frame_callback;
+
+  switch (state)
+    {
+    case STATE_INIT:
+      g_assert_not_reached ();
+    case STATE_WAIT_FOR_CONFIGURE:
+      draw_main ();
+      state = STATE_WAIT_FOR_FRAME;
+      break;
+    case STATE_WAIT_FOR_FRAME:
+      /* ignore */
+      return;
+    }
+
+  xdg_surface_ack_configure (xdg_surface, serial);
+  frame_callback = wl_surface_frame (surface);
+  wl_callback_add_listener (frame_callback, &frame_listener, NULL);
+  wl_surface_commit (surface);
+  wl_display_flush (display->display);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+  handle_xdg_surface_configure,
+};
+
+int
+main (int    argc,
+      char **argv)
+{
+  display = wayland_display_new (WAYLAND_DISPLAY_CAPABILITY_TEST_DRIVER);
+
+  surface = wl_compositor_create_surface (display->compositor);
+  xdg_surface = xdg_wm_base_get_xdg_surface (display->xdg_wm_base, surface);
+  xdg_surface_add_listener (xdg_surface, &xdg_surface_listener, NULL);
+  xdg_toplevel = xdg_surface_get_toplevel (xdg_surface);
+  xdg_toplevel_add_listener (xdg_toplevel, &xdg_toplevel_listener, NULL);
+
+  subsurface_surface = wl_compositor_create_surface (display->compositor);
+  subsurface = wl_subcompositor_get_subsurface (display->subcompositor,
+                                                subsurface_surface,
+                                                surface);
+  wl_subsurface_set_position (subsurface, 10, 10);
+  draw_surface (display, subsurface_surface, 100, 100, 0xff007f00);
+  wl_surface_commit (subsurface_surface);
+
+  xdg_toplevel_set_title (xdg_toplevel, "subsurface-transactions");
+  wl_surface_commit (surface);
+  state = STATE_WAIT_FOR_CONFIGURE;
+
+  running = TRUE;
+  while (running)
+    {
+      if (wl_display_dispatch (display->display) == -1)
+        return EXIT_FAILURE;
+    }
+
+  g_clear_object (&display);
+
+  return EXIT_SUCCESS;
+}
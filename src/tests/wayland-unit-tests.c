@@ -19,6 +19,7 @@
 
 #include <gio/gio.h>
 
+#include "backends/meta-settings-private.h"
 #include "backends/meta-virtual-monitor.h"
 #include "compositor/meta-window-actor-private.h"
 #include "core/display-private.h"
@@ -29,7 +30,11 @@
 #include "meta/meta-workspace-manager.h"
 #include "tests/meta-wayland-test-driver.h"
 #include "tests/meta-wayland-test-utils.h"
+#include "wayland/meta-wayland-shm-udmabuf.h"
+#include "wayland/meta-wayland-shm-upload.h"
+#include "wayland/meta-wayland-private.h"
 #include "wayland/meta-wayland-surface.h"
+#include "wayland/meta-wayland-transaction.h"
 
 static MetaContext *test_context;
 static MetaWaylandTestDriver *test_driver;
@@ -75,6 +80,143 @@ buffer_transform (void)
   meta_wayland_test_client_finish (wayland_test_client);
 }
 
+static void
+assert_rects_cover_region (GArray         *rects,
+                           cairo_region_t *region)
+{
+  cairo_region_t *covered;
+  int i;
+
+  covered = cairo_region_create ();
+  for (i = 0; i < rects->len; i++)
+    {
+      cairo_region_union_rectangle (covered,
+                                    &g_array_index (rects,
+                                                    cairo_rectangle_int_t,
+                                                    i));
+    }
+
+  cairo_region_subtract (region, covered);
+  g_assert_true (cairo_region_is_empty (region));
+  cairo_region_destroy (covered);
+}
+
+static void
+shm_upload_coalesce (void)
+{
+  cairo_region_t *region;
+  g_autoptr (GArray) rects = NULL;
+  int i;
+
+  /* A row of glyph sized cells is uploaded at once */
+  region = cairo_region_create ();
+  for (i = 0; i < 100; i++)
+    {
+      cairo_rectangle_int_t rect = {
+        .x = i * 10,
+        .y = 100,
+        .width = 8,
+        .height = 16,
+      };
+
+      cairo_region_union_rectangle (region, &rect);
+    }
+
+  rects = meta_wayland_shm_coalesce_damage (region, 4);
+  g_assert_cmpuint (rects->len, ==, 1);
+  assert_rects_cover_region (rects, region);
+  cairo_region_destroy (region);
+  g_clear_pointer (&rects, g_array_unref);
+
+  /* Far apart rectangles are not */
+  region = cairo_region_create ();
+  cairo_region_union_rectangle (region,
+                                &(cairo_rectangle_int_t) { 0, 0, 64, 64 });
+  cairo_region_union_rectangle (region,
+                                &(cairo_rectangle_int_t) { 2000, 1000, 64, 64 });
+  cairo_region_union_rectangle (region,
+                                &(cairo_rectangle_int_t) { 0, 1000, 64, 64 });
+
+  rects = meta_wayland_shm_coalesce_damage (region, 4);
+  g_assert_cmpuint (rects->len, ==, 3);
+  assert_rects_cover_region (rects, region);
+  cairo_region_destroy (region);
+  g_clear_pointer (&rects, g_array_unref);
+
+  /* Scattered pixels are merged into rows */
+  region = cairo_region_create ();
+  for (i = 0; i < 1000; i++)
+    {
+      cairo_rectangle_int_t rect = {
+        .x = (i % 40) * 32,
+        .y = (i / 40) * 32,
+        .width = 1,
+        .height = 1,
+      };
+
+      cairo_region_union_rectangle (region, &rect);
+    }
+
+  rects = meta_wayland_shm_coalesce_damage (region, 4);
+  g_assert_cmpuint (rects->len, ==, 25);
+  assert_rects_cover_region (rects, region);
+  cairo_region_destroy (region);
+}
+
+static void
+shm_udmabuf_range (void)
+{
+  uint64_t udmabuf_offset;
+  uint64_t udmabuf_size;
+  uint32_t plane_offset;
+
+  /* Page aligned buffers are wrapped as is */
+  g_assert_true (meta_wayland_shm_udmabuf_calculate_range (8192, 4096 * 3,
+                                                           8192 * 4, 4096,
+                                                           &udmabuf_offset,
+                                                           &udmabuf_size,
+                                                           &plane_offset));
+  g_assert_cmpuint (udmabuf_offset, ==, 8192);
+  g_assert_cmpuint (udmabuf_size, ==, 4096 * 3);
+  g_assert_cmpuint (plane_offset, ==, 0);
+
+  /* Others are wrapped with the surrounding pages */
+  g_assert_true (meta_wayland_shm_udmabuf_calculate_range (5000, 100,
+                                                           8192 * 4, 4096,
+                                                           &udmabuf_offset,
+                                                           &udmabuf_size,
+                                                           &plane_offset));
+  g_assert_cmpuint (udmabuf_offset, ==, 4096);
+  g_assert_cmpuint (udmabuf_size, ==, 4096);
+  g_assert_cmpuint (plane_offset, ==, 5000 - 4096);
+
+  g_assert_true (meta_wayland_shm_udmabuf_calculate_range (4000, 200,
+                                                           8192 * 4, 4096,
+                                                           &udmabuf_offset,
+                                                           &udmabuf_size,
+                                                           &plane_offset));
+  g_assert_cmpuint (udmabuf_offset, ==, 0);
+  g_assert_cmpuint (udmabuf_size, ==, 8192);
+  g_assert_cmpuint (plane_offset, ==, 4000);
+
+  /* Buffers must be within the pool, including their last page */
+  g_assert_false (meta_wayland_shm_udmabuf_calculate_range (8192, 8192,
+                                                            12288, 4096,
+                                                            &udmabuf_offset,
+                                                            &udmabuf_size,
+                                                            &plane_offset));
+  g_assert_false (meta_wayland_shm_udmabuf_calculate_range (0, 5000,
+                                                            5000, 4096,
+                                                            &udmabuf_offset,
+                                                            &udmabuf_size,
+                                                            &plane_offset));
+  g_assert_false (meta_wayland_shm_udmabuf_calculate_range (-4096, 4096,
+                                                            8192, 4096,
+                                                            &udmabuf_offset,
+                                                            &udmabuf_size,
+                                                            &plane_offset));
+}
+
 static void
 subsurface_reparenting (void)
 {
@@ -295,6 +437,78 @@ subsurface_parent_unmapped (void)
   g_signal_handler_disconnect (display->stack, window_added_id);
 }
 
+static void
+assert_subsurface_state (MetaWaylandSurface *surface,
+                         int                 x,
+                         int                 y,
+                         int                 width,
+                         int                 height)
+{
+  g_assert_cmpint (surface->sub.x, ==, x);
+  g_assert_cmpint (surface->sub.y, ==, y);
+  g_assert_cmpint (meta_wayland_surface_get_width (surface), ==, width);
+  g_assert_cmpint (meta_wayland_surface_get_height (surface), ==, height);
+}
+
+static void
+on_transactions_sync_point (MetaWaylandTestDriver *test_driver,
+                            unsigned int           sequence,
+                            struct wl_resource    *surface_resource,
+                            struct wl_client      *wl_client)
+{
+  MetaWaylandCompositor *compositor =
+    meta_context_get_wayland_compositor (test_context);
+  MetaWaylandSurface *surface = NULL;
+
+  if (surface_resource)
+    surface = wl_resource_get_user_data (surface_resource);
+
+  switch (sequence)
+    {
+    case 0:
+    case 3:
+    case 5:
+      meta_wayland_transaction_inhibit (compositor);
+      break;
+    case 1:
+      /* The parent commit is queued, so is the subsurface state and
+       * position committed before it. */
+      assert_subsurface_state (surface, 10, 10, 100, 100);
+      meta_wayland_transaction_uninhibit (compositor);
+      assert_subsurface_state (surface, 20, 20, 50, 50);
+      break;
+    case 2:
+      assert_subsurface_state (surface, 30, 30, 30, 30);
+      break;
+    case 4:
+    case 6:
+      /* The subsurface, then the toplevel, were destroyed meanwhile. */
+      meta_wayland_transaction_uninhibit (compositor);
+      g_assert_true (g_queue_is_empty (&compositor->transactions.committed_queue));
+      break;
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+subsurface_transactions (void)
+{
+  MetaWaylandTestClient *wayland_test_client;
+  gulong sync_point_id;
+
+  wayland_test_client =
+    meta_wayland_test_client_new ("subsurface-transactions");
+  sync_point_id =
+    g_signal_connect (test_driver, "sync-point",
+                      G_CALLBACK (on_transactions_sync_point),
+                      NULL);
+
+  meta_wayland_test_client_finish (wayland_test_client);
+
+  g_signal_handler_disconnect (test_driver, sync_point_id);
+}
+
 typedef enum _ApplyLimitState
 {
   APPLY_LIMIT_STATE_INIT,
@@ -645,6 +859,117 @@ toplevel_bounds_monitors (void)
   meta_wayland_test_client_finish (wayland_test_client);
 }
 
+typedef struct _FrameCallbackPacingTest
+{
+  MetaWaylandCompositor *compositor;
+
+  int64_t paced_time_us;
+  int n_callbacks;
+  int n_paced_callbacks;
+} FrameCallbackPacingTest;
+
+static void
+on_frame_callback_pacing_after_update (ClutterStage            *stage,
+                                       ClutterStageView        *stage_view,
+                                       FrameCallbackPacingTest *test)
+{
+  ClutterFrameClock *frame_clock;
+  GList *surfaces;
+  MetaWaylandSurface *surface;
+  int64_t paced_time_us;
+  int64_t next_update_time_us;
+
+  surfaces = test->compositor->frame_callback_pacing.surfaces;
+  if (!surfaces)
+    return;
+
+  g_assert_cmpuint (g_list_length (surfaces), ==, 1);
+  surface = surfaces->data;
+  paced_time_us = surface->presentation_time.paced_frame_callback_time_us;
+  if (paced_time_us == test->paced_time_us)
+    return;
+
+  /* The frame callbacks are held back, but sent early enough for the
+   * client to draw before the next frame is dispatched */
+  frame_clock = clutter_stage_view_get_frame_clock (stage_view);
+  next_update_time_us =
+    clutter_frame_clock_get_next_update_time_us (frame_clock);
+
+  g_assert_cmpint (next_update_time_us, >, 0);
+  g_assert_cmpint (paced_time_us, <, next_update_time_us);
+
+  test->paced_time_us = paced_time_us;
+}
+
+static void
+on_frame_callback_pacing_sync_point (MetaWaylandTestDriver   *test_driver,
+                                     unsigned int             sequence,
+                                     struct wl_resource      *surface_resource,
+                                     struct wl_client        *wl_client,
+                                     FrameCallbackPacingTest *test)
+{
+  uint32_t callback_time_ms = sequence;
+
+  test->n_callbacks++;
+
+  if (!test->paced_time_us)
+    return;
+
+  /* Paced frame callbacks are sent once the paced time is reached, not
+   * when the stage updated */
+  g_assert_cmpint ((int32_t) (callback_time_ms -
+                              (uint32_t) (test->paced_time_us / 1000)),
+                   >=, 0);
+
+  test->paced_time_us = 0;
+  test->n_paced_callbacks++;
+}
+
+static void
+frame_callback_pacing (void)
+{
+  MetaBackend *backend = meta_context_get_backend (test_context);
+  MetaSettings *settings = meta_backend_get_settings (backend);
+  ClutterActor *stage = meta_backend_get_stage (backend);
+  MetaWaylandTestClient *wayland_test_client;
+  FrameCallbackPacingTest test = { 0 };
+  gulong after_update_handler_id;
+  gulong sync_point_handler_id;
+
+  meta_settings_enable_experimental_feature (
+    settings,
+    META_EXPERIMENTAL_FEATURE_FRAME_CALLBACK_PACING);
+
+  test.compositor = meta_context_get_wayland_compositor (test_context);
+
+  after_update_handler_id =
+    g_signal_connect (stage, "after-update",
+                      G_CALLBACK (on_frame_callback_pacing_after_update),
+                      &test);
+  sync_point_handler_id =
+    g_signal_connect (test_driver, "sync-point",
+                      G_CALLBACK (on_frame_callback_pacing_sync_point),
+                      &test);
+
+  wayland_test_client = meta_wayland_test_client_new ("frame-callback-pacing");
+  meta_wayland_test_client_finish (wayland_test_client);
+
+  g_signal_handler_disconnect (stage, after_update_handler_id);
+  g_signal_handler_disconnect (test_driver, sync_point_handler_id);
+
+  /* The client draws right away, so once its drawing time is known, its
+   * frame callbacks are paced */
+  g_assert_cmpint (test.n_callbacks, ==, 40);
+  g_assert_cmpint (test.n_paced_callbacks, >,
+                   test.n_callbacks - META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES -
+                   10);
+
+  meta_settings_override_experimental_features (settings);
+  meta_settings_enable_experimental_feature (
+    settings,
+    META_EXPERIMENTAL_FEATURE_SCALE_MONITOR_FRAMEBUFFER);
+}
+
 static void
 on_before_tests (void)
 {
@@ -668,6 +993,12 @@ init_tests (void)
 {
   g_test_add_func ("/wayland/buffer/transform",
                    buffer_transform);
+  g_test_add_func ("/wayland/frame-callback/pacing",
+                   frame_callback_pacing);
+  g_test_add_func ("/wayland/shm-upload/coalesce",
+                   shm_upload_coalesce);
+  g_test_add_func ("/wayland/shm-udmabuf/range",
+                   shm_udmabuf_range);
   g_test_add_func ("/wayland/subsurface/remap-toplevel",
                    subsurface_remap_toplevel);
   g_test_add_func ("/wayland/subsurface/reparent",
@@ -678,6 +1009,8 @@ init_tests (void)
                    subsurface_invalid_xdg_shell_actions);
   g_test_add_func ("/wayland/subsurface/parent-unmapped",
                    subsurface_parent_unmapped);
+  g_test_add_func ("/wayland/subsurface/transactions",
+                   subsurface_transactions);
   g_test_add_func ("/wayland/toplevel/apply-limits",
                    toplevel_apply_limits);
   g_test_add_func ("/wayland/toplevel/activation",
@@ -58,6 +58,7 @@
 #include "meta/util.h"
 #include "wayland/meta-wayland-dma-buf.h"
 #include "wayland/meta-wayland-private.h"
+#include "wayland/meta-wayland-shm-udmabuf.h"
 
 #ifdef HAVE_NATIVE_BACKEND
 #include "backends/native/meta-drm-buffer-gbm.h"
@@ -326,6 +327,40 @@ shm_format_to_string (MetaDrmFormatBuf *format_buf,
   return result;
 }
 
+static gboolean
+try_attach_shm_udmabuf (MetaWaylandBuffer  *buffer,
+                        CoglTexture       **texture)
+{
+  MetaWaylandShmUdmabuf *shm_udmabuf = buffer->compositor->shm_udmabuf;
+  g_autoptr (GError) error = NULL;
+
+  if (!shm_udmabuf || buffer->shm.udmabuf_failed)
+    return FALSE;
+
+  if (!buffer->shm.texture)
+    {
+      buffer->shm.texture =
+        meta_wayland_shm_udmabuf_import (shm_udmabuf, buffer->resource,
+                                         &error);
+      if (!buffer->shm.texture)
+        {
+          meta_topic (META_DEBUG_WAYLAND,
+                      "[wl-shm] wl_buffer@%u can't be imported through "
+                      "udmabuf, copying instead: %s",
+                      wl_resource_get_id (buffer->resource),
+                      error->message);
+          buffer->shm.udmabuf_failed = TRUE;
+          return FALSE;
+        }
+    }
+
+  cogl_clear_object (texture);
+  *texture = cogl_object_ref (buffer->shm.texture);
+  buffer->is_y_inverted = TRUE;
+
+  return TRUE;
+}
+
 static gboolean
 shm_buffer_attach (MetaWaylandBuffer  *buffer,
                    CoglTexture       **texture,
@@ -342,6 +377,9 @@ shm_buffer_attach (MetaWaylandBuffer  *buffer,
   CoglTexture *new_texture;
   MetaDrmFormatBuf format_buf;
 
+  if (try_attach_shm_udmabuf (buffer, texture))
+    return TRUE;
+
   shm_buffer = wl_shm_buffer_get (buffer->resource);
   stride = wl_shm_buffer_get_stride (shm_buffer);
   width = wl_shm_buffer_get_width (shm_buffer);
@@ -360,7 +398,11 @@ shm_buffer_attach (MetaWaylandBuffer  *buffer,
                                     wl_shm_buffer_get_format (shm_buffer)),
               cogl_pixel_format_to_string (format));
 
+  /* Textures imported through udmabuf sample from another buffer's memory,
+   * so they can't be updated in place with this buffer's contents.
+   */
   if (*texture &&
+      !meta_wayland_shm_udmabuf_is_imported_texture (*texture) &&
       cogl_texture_get_width (*texture) == width &&
       cogl_texture_get_height (*texture) == height &&
       cogl_texture_get_components (*texture) == components &&
@@ -613,6 +655,20 @@ meta_wayland_buffer_is_y_inverted (MetaWaylandBuffer *buffer)
   return buffer->is_y_inverted;
 }
 
+/**
+ * meta_wayland_buffer_is_copied:
+ * @buffer: A #MetaWaylandBuffer object
+ *
+ * Returns: %TRUE if the contents of @buffer were copied when it was attached,
+ *   meaning that the client may reuse it right away, or %FALSE if the texture
+ *   keeps accessing the buffer memory.
+ */
+gboolean
+meta_wayland_buffer_is_copied (MetaWaylandBuffer *buffer)
+{
+  return buffer->type == META_WAYLAND_BUFFER_TYPE_SHM && !buffer->shm.texture;
+}
+
 static gboolean
 process_shm_buffer_damage (MetaWaylandBuffer *buffer,
                            CoglTexture       *texture,
@@ -620,46 +676,23 @@ process_shm_buffer_damage (MetaWaylandBuffer *buffer,
                            GError           **error)
 {
   struct wl_shm_buffer *shm_buffer;
-  int i, n_rectangles;
-  gboolean set_texture_failed = FALSE;
   CoglPixelFormat format;
 
-  n_rectangles = cairo_region_num_rectangles (region);
+  /* Textures imported through udmabuf already show the new contents */
+  if (buffer->shm.texture)
+    return TRUE;
 
   shm_buffer = wl_shm_buffer_get (buffer->resource);
 
   shm_buffer_get_cogl_pixel_format (shm_buffer, &format, NULL);
   g_return_val_if_fail (cogl_pixel_format_get_n_planes (format) == 1, FALSE);
 
-  wl_shm_buffer_begin_access (shm_buffer);
-
-  for (i = 0; i < n_rectangles; i++)
-    {
-      const uint8_t *data = wl_shm_buffer_get_data (shm_buffer);
-      int32_t stride = wl_shm_buffer_get_stride (shm_buffer);
-      cairo_rectangle_int_t rect;
-      int bpp;
-
-      bpp = cogl_pixel_format_get_bytes_per_pixel (format, 0);
-      cairo_region_get_rectangle (region, i, &rect);
-
-      if (!_cogl_texture_set_region (texture,
-                                     rect.width, rect.height,
-                                     format,
-                                     stride,
-                                     data + rect.x * bpp + rect.y * stride,
-                                     rect.x, rect.y,
-                                     0,
-                                     error))
-        {
-          set_texture_failed = TRUE;
-          break;
-        }
-    }
-
-  wl_shm_buffer_end_access (shm_buffer);
-
-  return !set_texture_failed;
+  return meta_wayland_shm_uploader_upload (buffer->compositor->shm_uploader,
+                                           shm_buffer,
+                                           format,
+                                           texture,
+                                           region,
+                                           error);
 }
 
 void
@@ -737,7 +770,8 @@ try_acquire_egl_image_scanout (MetaWaylandBuffer *buffer,
       return NULL;
     }
 
-  if (!meta_onscreen_native_is_buffer_scanout_compatible (onscreen,
+  if (onscreen &&
+      !meta_onscreen_native_is_buffer_scanout_compatible (onscreen,
                                                           META_DRM_BUFFER (fb)))
     return NULL;
 
@@ -788,6 +822,7 @@ meta_wayland_buffer_finalize (GObject *object)
 {
   MetaWaylandBuffer *buffer = META_WAYLAND_BUFFER (object);
 
+  g_clear_pointer (&buffer->shm.texture, cogl_object_unref);
   g_clear_pointer (&buffer->egl_image.texture, cogl_object_unref);
 #ifdef HAVE_WAYLAND_EGLSTREAM
   g_clear_pointer (&buffer->egl_stream.texture, cogl_object_unref);
@@ -865,4 +900,19 @@ meta_wayland_init_shm (MetaWaylandCompositor *compositor)
 
       wl_display_add_shm_format (compositor->wayland_display, shm_formats[i]);
     }
+
+  compositor->shm_uploader = meta_wayland_shm_uploader_new (cogl_context);
+
+  if (meta_settings_is_experimental_feature_enabled (
+        meta_backend_get_settings (backend),
+        META_EXPERIMENTAL_FEATURE_SHM_UDMABUF))
+    {
+      g_autoptr (GError) error = NULL;
+
+      compositor->shm_udmabuf = meta_wayland_shm_udmabuf_new (compositor,
+                                                              &error);
+      if (!compositor->shm_udmabuf)
+        g_warning ("Failed to enable zero-copy shm buffers: %s",
+                   error->message);
+    }
 }
@@ -56,6 +56,11 @@ struct _MetaWaylandBuffer
 
   MetaWaylandBufferType type;
 
+  struct {
+    CoglTexture *texture;
+    gboolean udmabuf_failed;
+  } shm;
+
   struct {
     CoglTexture *texture;
   } egl_image;
@@ -87,6 +92,7 @@ gboolean                meta_wayland_buffer_attach              (MetaWaylandBuff
                                                                  GError               **error);
 CoglSnippet *           meta_wayland_buffer_create_snippet      (MetaWaylandBuffer     *buffer);
 gboolean                meta_wayland_buffer_is_y_inverted       (MetaWaylandBuffer     *buffer);
+gboolean                meta_wayland_buffer_is_copied           (MetaWaylandBuffer     *buffer);
 void                    meta_wayland_buffer_process_damage      (MetaWaylandBuffer     *buffer,
                                                                  CoglTexture           *texture,
                                                                  cairo_region_t        *region);
@@ -40,6 +40,11 @@
 #include "wayland/meta-wayland-dma-buf.h"
 
 #include <drm_fourcc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -96,6 +101,7 @@ typedef struct _MetaWaylandDmaBufTranche
   GArray *formats;
   MetaWaylandDmaBufTrancheFlags flags;
   uint64_t scanout_crtc_id;
+  gboolean scanout_overlay;
 } MetaWaylandDmaBufTranche;
 
 typedef struct _MetaWaylandDmaBufFeedback
@@ -111,6 +117,7 @@ typedef struct _MetaWaylandDmaBufSurfaceFeedback
   MetaWaylandDmaBufFeedback *feedback;
   GList *resources;
   gulong scanout_candidate_changed_id;
+  gulong overlay_candidate_changed_id;
 } MetaWaylandDmaBufSurfaceFeedback;
 
 struct _MetaWaylandDmaBufManager
@@ -588,7 +595,8 @@ meta_wayland_dma_buf_try_acquire_scanout (MetaWaylandDmaBufBuffer *dma_buf,
       return NULL;
     }
 
-  if (!meta_onscreen_native_is_buffer_scanout_compatible (onscreen,
+  if (onscreen &&
+      !meta_onscreen_native_is_buffer_scanout_compatible (onscreen,
                                                           META_DRM_BUFFER (fb)))
     return NULL;
 
@@ -598,6 +606,183 @@ meta_wayland_dma_buf_try_acquire_scanout (MetaWaylandDmaBufBuffer *dma_buf,
 #endif
 }
 
+typedef struct _MetaWaylandDmaBufSource
+{
+  GSource base;
+
+  MetaWaylandDmaBufSourceDispatch dispatch;
+  MetaWaylandBuffer *buffer;
+  gpointer user_data;
+
+  gpointer fd_tags[META_WAYLAND_DMA_BUF_MAX_FDS];
+  int fds[META_WAYLAND_DMA_BUF_MAX_FDS];
+} MetaWaylandDmaBufSource;
+
+static gboolean
+is_fd_readable (int fd)
+{
+  struct pollfd poll_fd = { .fd = fd, .events = POLLIN };
+  int ret;
+
+  do
+    ret = poll (&poll_fd, 1, 0);
+  while (ret < 0 && errno == EINTR);
+
+  /* Errors are treated as ready, there is nothing sensible to wait for */
+  return ret != 0;
+}
+
+static int
+export_read_fence_fd (int dma_buf_fd)
+{
+#ifdef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+  struct dma_buf_export_sync_file export_sync_file = {
+    .flags = DMA_BUF_SYNC_READ,
+    .fd = -1,
+  };
+  int ret;
+
+  do
+    ret = ioctl (dma_buf_fd, DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &export_sync_file);
+  while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+
+  if (ret == 0)
+    return export_sync_file.fd;
+#endif
+
+  /* Without sync_file export, poll the dma-buf itself; this also waits for
+   * rendering the client submits after the commit, but is still correct.
+   */
+  return fcntl (dma_buf_fd, F_DUPFD_CLOEXEC, 0);
+}
+
+static gboolean
+meta_wayland_dma_buf_source_dispatch (GSource     *base,
+                                      GSourceFunc  callback,
+                                      gpointer     user_data)
+{
+  MetaWaylandDmaBufSource *source = (MetaWaylandDmaBufSource *) base;
+  gboolean ready = TRUE;
+  int i;
+
+  for (i = 0; i < META_WAYLAND_DMA_BUF_MAX_FDS; i++)
+    {
+      gpointer fd_tag = source->fd_tags[i];
+      GIOCondition condition;
+
+      if (!fd_tag)
+        continue;
+
+      condition = g_source_query_unix_fd (&source->base, fd_tag);
+      if (!(condition & (G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL)))
+        {
+          ready = FALSE;
+          continue;
+        }
+
+      g_source_remove_unix_fd (&source->base, fd_tag);
+      source->fd_tags[i] = NULL;
+      close (source->fds[i]);
+      source->fds[i] = -1;
+    }
+
+  if (!ready)
+    return G_SOURCE_CONTINUE;
+
+  source->dispatch (source->buffer, source->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+meta_wayland_dma_buf_source_finalize (GSource *base)
+{
+  MetaWaylandDmaBufSource *source = (MetaWaylandDmaBufSource *) base;
+  int i;
+
+  for (i = 0; i < META_WAYLAND_DMA_BUF_MAX_FDS; i++)
+    {
+      if (source->fd_tags[i])
+        {
+          g_source_remove_unix_fd (&source->base, source->fd_tags[i]);
+          source->fd_tags[i] = NULL;
+        }
+
+      if (source->fds[i] >= 0)
+        close (source->fds[i]);
+    }
+
+  g_clear_object (&source->buffer);
+}
+
+static GSourceFuncs meta_wayland_dma_buf_source_funcs = {
+  .dispatch = meta_wayland_dma_buf_source_dispatch,
+  .finalize = meta_wayland_dma_buf_source_finalize,
+};
+
+/**
+ * meta_wayland_dma_buf_create_source:
+ * @buffer: A #MetaWaylandBuffer object
+ * @dispatch: Function called once all planes of @buffer can be read
+ * @user_data: Data passed to @dispatch
+ *
+ * Creates a source waiting for the implicit fences attached to the dma-buf
+ * planes of @buffer, i.e. for the rendering that was submitted to it before
+ * the call, to signal.
+ *
+ * Returns: (transfer full) (nullable): A new #GSource, or %NULL if @buffer
+ * isn't a dma-buf based buffer or can already be read without stalling.
+ */
+GSource *
+meta_wayland_dma_buf_create_source (MetaWaylandBuffer               *buffer,
+                                    MetaWaylandDmaBufSourceDispatch  dispatch,
+                                    gpointer                         user_data)
+{
+  MetaWaylandDmaBufBuffer *dma_buf;
+  MetaWaylandDmaBufSource *source = NULL;
+  int i;
+
+  dma_buf = meta_wayland_dma_buf_from_buffer (buffer);
+  if (!dma_buf)
+    return NULL;
+
+  for (i = 0; i < META_WAYLAND_DMA_BUF_MAX_FDS; i++)
+    {
+      int fence_fd;
+
+      if (dma_buf->fds[i] < 0)
+        break;
+
+      if (is_fd_readable (dma_buf->fds[i]))
+        continue;
+
+      fence_fd = export_read_fence_fd (dma_buf->fds[i]);
+      if (fence_fd < 0)
+        continue;
+
+      if (!source)
+        {
+          int j;
+
+          source =
+            (MetaWaylandDmaBufSource *) g_source_new (&meta_wayland_dma_buf_source_funcs,
+                                                      sizeof (MetaWaylandDmaBufSource));
+          g_source_set_name (&source->base, "[mutter] DmaBuf readiness");
+          for (j = 0; j < META_WAYLAND_DMA_BUF_MAX_FDS; j++)
+            source->fds[j] = -1;
+          source->dispatch = dispatch;
+          source->buffer = g_object_ref (buffer);
+          source->user_data = user_data;
+        }
+
+      source->fds[i] = fence_fd;
+      source->fd_tags[i] = g_source_add_unix_fd (&source->base, fence_fd,
+                                                 G_IO_IN);
+    }
+
+  return (GSource *) source;
+}
+
 static void
 buffer_params_add (struct wl_client   *client,
                    struct wl_resource *resource,
@@ -958,9 +1143,37 @@ crtc_supports_modifier (MetaCrtcKms *crtc_kms,
   return has_modifier (crtc_modifiers, drm_modifier);
 }
 
+static gboolean
+crtc_supports_scanout_format (MetaCrtcKms             *crtc_kms,
+                              MetaWaylandDmaBufFormat *format,
+                              gboolean                 overlay)
+{
+  if (overlay)
+    {
+      return meta_crtc_kms_supports_overlay_format (crtc_kms,
+                                                    format->drm_format,
+                                                    format->drm_modifier);
+    }
+  else if (format->drm_modifier == DRM_FORMAT_MOD_INVALID)
+    {
+      return !!meta_crtc_kms_get_modifiers (crtc_kms, format->drm_format);
+    }
+  else
+    {
+      return crtc_supports_modifier (crtc_kms,
+                                     format->drm_format,
+                                     format->drm_modifier);
+    }
+}
+
+/*
+ * Adds a tranche with the formats that can be scanned out on either the
+ * primary plane, for fullscreen surfaces, or on an overlay plane of @crtc.
+ */
 static void
 ensure_scanout_tranche (MetaWaylandDmaBufSurfaceFeedback *surface_feedback,
-                        MetaCrtc                         *crtc)
+                        MetaCrtc                         *crtc,
+                        gboolean                          overlay)
 {
   MetaWaylandDmaBufManager *dma_buf_manager = surface_feedback->dma_buf_manager;
   MetaWaylandDmaBufFeedback *feedback = surface_feedback->feedback;
@@ -980,7 +1193,8 @@ ensure_scanout_tranche (MetaWaylandDmaBufSurfaceFeedback *surface_feedback,
     {
       tranche = el->data;
 
-      if (tranche->scanout_crtc_id == meta_crtc_get_id (crtc))
+      if (tranche->scanout_crtc_id == meta_crtc_get_id (crtc) &&
+          tranche->scanout_overlay == overlay)
         return;
 
       meta_wayland_dma_buf_tranche_free (tranche);
@@ -997,9 +1211,12 @@ ensure_scanout_tranche (MetaWaylandDmaBufSurfaceFeedback *surface_feedback,
                            MetaWaylandDmaBufFormat,
                            i);
 
-          if (!crtc_supports_modifier (crtc_kms,
-                                       format.drm_format,
-                                       format.drm_modifier))
+          /* An implicit modifier doesn't tell whether the buffer can be
+           * scanned out, so only list explicit ones when clients use them. */
+          if (format.drm_modifier == DRM_FORMAT_MOD_INVALID)
+            continue;
+
+          if (!crtc_supports_scanout_format (crtc_kms, &format, overlay))
             continue;
 
           g_array_append_val (formats, format);
@@ -1020,7 +1237,7 @@ ensure_scanout_tranche (MetaWaylandDmaBufSurfaceFeedback *surface_feedback,
           if (format.drm_modifier != DRM_FORMAT_MOD_INVALID)
             continue;
 
-          if (!meta_crtc_kms_get_modifiers (crtc_kms, format.drm_format))
+          if (!crtc_supports_scanout_format (crtc_kms, &format, overlay))
             continue;
 
           g_array_append_val (formats, format);
@@ -1037,6 +1254,7 @@ ensure_scanout_tranche (MetaWaylandDmaBufSurfaceFeedback *surface_feedback,
                                               priority,
                                               flags);
   tranche->scanout_crtc_id = meta_crtc_get_id (crtc);
+  tranche->scanout_overlay = overlay;
   meta_wayland_dma_buf_feedback_add_tranche (feedback, tranche);
 }
 
@@ -1065,7 +1283,14 @@ update_surface_feedback_tranches (MetaWaylandDmaBufSurfaceFeedback *surface_feed
 
   crtc = meta_wayland_surface_get_scanout_candidate (surface_feedback->surface);
   if (crtc)
-    ensure_scanout_tranche (surface_feedback, crtc);
+    {
+      ensure_scanout_tranche (surface_feedback, crtc, FALSE);
+      return;
+    }
+
+  crtc = meta_wayland_surface_get_overlay_candidate (surface_feedback->surface);
+  if (crtc)
+    ensure_scanout_tranche (surface_feedback, crtc, TRUE);
   else
     clear_scanout_tranche (surface_feedback);
 #endif /* HAVE_NATIVE_BACKEND */
@@ -1124,6 +1349,10 @@ ensure_surface_feedback (MetaWaylandDmaBufManager *dma_buf_manager,
     g_signal_connect (surface, "notify::scanout-candidate",
                       G_CALLBACK (on_scanout_candidate_changed),
                       surface_feedback);
+  surface_feedback->overlay_candidate_changed_id =
+    g_signal_connect (surface, "notify::overlay-candidate",
+                      G_CALLBACK (on_scanout_candidate_changed),
+                      surface_feedback);
 
   g_object_set_qdata_full (G_OBJECT (surface),
                            quark_dma_buf_surface_feedback,
@@ -1148,6 +1377,8 @@ surface_feedback_destructor (struct wl_resource *resource)
     {
       g_clear_signal_handler (&surface_feedback->scanout_candidate_changed_id,
                               surface_feedback->surface);
+      g_clear_signal_handler (&surface_feedback->overlay_candidate_changed_id,
+                              surface_feedback->surface);
       g_object_set_qdata (G_OBJECT (surface_feedback->surface),
                           quark_dma_buf_surface_feedback, NULL);
     }
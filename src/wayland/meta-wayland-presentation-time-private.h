@@ -64,4 +64,12 @@ void meta_wayland_presentation_time_cursor_painted (MetaWaylandPresentationTime
                                                     ClutterStageView            *stage_view,
                                                     MetaWaylandCursorSurface    *cursor_surface);
 
+void meta_wayland_presentation_time_frame_callbacks_sent (MetaWaylandSurface *surface,
+                                                          int64_t             time_us);
+
+void meta_wayland_presentation_time_content_ready (MetaWaylandSurface *surface,
+                                                   int64_t             time_us);
+
+int64_t meta_wayland_presentation_time_get_client_frame_time_us (MetaWaylandSurface *surface);
+
 #endif /* META_WAYLAND_PRESENTATION_TIME_PRIVATE_H */
@@ -415,3 +415,81 @@ meta_wayland_presentation_time_cursor_painted (MetaWaylandPresentationTime *pres
       surface->presentation_time.needs_sequence_update = TRUE;
     }
 }
+
+/* Longer durations mean the client wasn't busy drawing all along, but idle
+ * until something else made it update; they say nothing about its drawing
+ * time.
+ */
+#define MAX_CLIENT_FRAME_TIME_US (G_USEC_PER_SEC / 10)
+
+void
+meta_wayland_presentation_time_frame_callbacks_sent (MetaWaylandSurface *surface,
+                                                     int64_t             time_us)
+{
+  surface->presentation_time.frame_callback_time_us = time_us;
+}
+
+/**
+ * meta_wayland_presentation_time_content_ready:
+ * @surface: A #MetaWaylandSurface
+ * @time_us: The time the new content got ready, in the monotonic time base
+ *
+ * Measures the time @surface took from being sent frame callbacks to having
+ * new content applied, i.e. committed, with any dma-buf the client rendered
+ * to done being rendered to.
+ */
+void
+meta_wayland_presentation_time_content_ready (MetaWaylandSurface *surface,
+                                              int64_t             time_us)
+{
+  int64_t client_frame_time_us;
+  int i;
+
+  if (!surface->presentation_time.frame_callback_time_us)
+    return;
+
+  client_frame_time_us =
+    time_us - surface->presentation_time.frame_callback_time_us;
+  surface->presentation_time.frame_callback_time_us = 0;
+
+  if (client_frame_time_us < 0 ||
+      client_frame_time_us > MAX_CLIENT_FRAME_TIME_US)
+    return;
+
+  i = surface->presentation_time.next_client_frame_time;
+  surface->presentation_time.client_frame_times_us[i] = client_frame_time_us;
+  surface->presentation_time.next_client_frame_time =
+    (i + 1) % META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES;
+  surface->presentation_time.n_client_frame_times =
+    MIN (surface->presentation_time.n_client_frame_times + 1,
+         META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES);
+}
+
+/**
+ * meta_wayland_presentation_time_get_client_frame_time_us:
+ * @surface: A #MetaWaylandSurface
+ *
+ * Returns: how long @surface should be given between being sent frame
+ *   callbacks and its new content having to be ready, or -1 if not known
+ *   yet. The longest recent duration is used, missing a frame is worse
+ *   than a bit of latency.
+ */
+int64_t
+meta_wayland_presentation_time_get_client_frame_time_us (MetaWaylandSurface *surface)
+{
+  int64_t max_client_frame_time_us = 0;
+  int i;
+
+  if (surface->presentation_time.n_client_frame_times <
+      META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES)
+    return -1;
+
+  for (i = 0; i < META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES; i++)
+    {
+      max_client_frame_time_us =
+        MAX (max_client_frame_time_us,
+             surface->presentation_time.client_frame_times_us[i]);
+    }
+
+  return max_client_frame_time_us;
+}
@@ -29,6 +29,8 @@
 #include "wayland/meta-wayland-pointer-gestures.h"
 #include "wayland/meta-wayland-presentation-time-private.h"
 #include "wayland/meta-wayland-seat.h"
+#include "wayland/meta-wayland-shm-udmabuf.h"
+#include "wayland/meta-wayland-shm-upload.h"
 #include "wayland/meta-wayland-surface.h"
 #include "wayland/meta-wayland-tablet-manager.h"
 #include "wayland/meta-wayland-versions.h"
@@ -90,6 +92,11 @@ struct _MetaWaylandCompositor
   GHashTable *outputs;
   GList *frame_callback_surfaces;
 
+  struct {
+    GList *surfaces;
+    GSource *source;
+  } frame_callback_pacing;
+
   MetaXWaylandManager xwayland_manager;
 
   MetaWaylandSeat *seat;
@@ -100,6 +107,14 @@ struct _MetaWaylandCompositor
 
   MetaWaylandPresentationTime presentation_time;
   MetaWaylandDmaBufManager *dma_buf_manager;
+  MetaWaylandShmUploader *shm_uploader;
+  MetaWaylandShmUdmabuf *shm_udmabuf;
+
+  struct {
+    GQueue committed_queue;
+    gboolean wait_for_buffers;
+    int inhibit_count;
+  } transactions;
 };
 
 #define META_TYPE_WAYLAND_COMPOSITOR (meta_wayland_compositor_get_type ())
@@ -0,0 +1,667 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MetaWaylandShmUdmabuf turns wl_shm buffers into textures without copying
+ * them, by wrapping the pages of the memfd backing their pool into a dma-buf
+ * using /dev/udmabuf, and importing that as an EGLImage.
+ *
+ * libwayland-server doesn't give access to the file descriptor of a wl_shm
+ * pool, so the wl_shm.create_pool and wl_shm_pool.create_buffer requests are
+ * observed using a protocol logger, and the file descriptor and the buffer
+ * offsets are associated with the wl_shm_pool and wl_buffer resources when
+ * they are created. Only pools backed by a memfd sealed against shrinking
+ * are tracked, as udmabuf requires it; buffers from other pools, or that
+ * fail to be imported, are copied as usual.
+ *
+ * The resulting textures sample directly from client memory, so buffers
+ * using them must not be released before being replaced.
+ */
+
+#include "config.h"
+
+#include "wayland/meta-wayland-shm-udmabuf.h"
+
+#include <drm_fourcc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_UDMABUF
+#include <linux/udmabuf.h>
+#endif
+
+#include "backends/meta-backend-private.h"
+#include "backends/meta-egl-ext.h"
+#include "backends/meta-egl.h"
+#include "cogl/cogl-egl.h"
+#include "meta/util.h"
+#include "wayland/meta-wayland-private.h"
+
+typedef struct _MetaShmPool
+{
+  grefcount ref_count;
+  int fd;
+} MetaShmPool;
+
+typedef struct _TrackedResource
+{
+  MetaWaylandShmUdmabuf *shm_udmabuf;
+  struct wl_list link;
+  struct wl_listener destroy_listener;
+
+  MetaShmPool *pool;
+  int32_t offset;
+} TrackedResource;
+
+typedef struct _ClientTracker
+{
+  MetaWaylandShmUdmabuf *shm_udmabuf;
+  struct wl_list link;
+  struct wl_listener resource_created_listener;
+  struct wl_listener destroy_listener;
+} ClientTracker;
+
+struct _MetaWaylandShmUdmabuf
+{
+  MetaWaylandCompositor *compositor;
+
+  int udmabuf_fd;
+  int64_t page_size;
+
+  struct wl_protocol_logger *protocol_logger;
+  struct wl_listener client_created_listener;
+  struct wl_list clients;
+  struct wl_list resources;
+
+  /* Requests are logged right before being dispatched, so at most one pool
+   * or buffer is waiting for its resource to be created at a time.
+   */
+  struct {
+    struct wl_client *client;
+    uint32_t id;
+    int fd;
+  } pending_pool;
+
+  struct {
+    struct wl_client *client;
+    uint32_t id;
+    MetaShmPool *pool;
+    int32_t offset;
+  } pending_buffer;
+};
+
+static CoglUserDataKey udmabuf_texture_key;
+
+static MetaShmPool *
+meta_shm_pool_new (int fd)
+{
+  MetaShmPool *pool;
+
+  pool = g_new0 (MetaShmPool, 1);
+  g_ref_count_init (&pool->ref_count);
+  pool->fd = fd;
+
+  return pool;
+}
+
+static MetaShmPool *
+meta_shm_pool_ref (MetaShmPool *pool)
+{
+  g_ref_count_inc (&pool->ref_count);
+  return pool;
+}
+
+static void
+meta_shm_pool_unref (MetaShmPool *pool)
+{
+  if (g_ref_count_dec (&pool->ref_count))
+    {
+      close (pool->fd);
+      g_free (pool);
+    }
+}
+
+static void
+clear_pending (MetaWaylandShmUdmabuf *shm_udmabuf)
+{
+  if (shm_udmabuf->pending_pool.fd >= 0)
+    {
+      close (shm_udmabuf->pending_pool.fd);
+      shm_udmabuf->pending_pool.fd = -1;
+    }
+  shm_udmabuf->pending_pool.client = NULL;
+
+  g_clear_pointer (&shm_udmabuf->pending_buffer.pool, meta_shm_pool_unref);
+  shm_udmabuf->pending_buffer.client = NULL;
+}
+
+static void
+tracked_resource_free (TrackedResource *tracked)
+{
+  wl_list_remove (&tracked->link);
+  wl_list_remove (&tracked->destroy_listener.link);
+  meta_shm_pool_unref (tracked->pool);
+  g_free (tracked);
+}
+
+static void
+on_tracked_resource_destroyed (struct wl_listener *listener,
+                               void               *data)
+{
+  TrackedResource *tracked = wl_container_of (listener, tracked,
+                                              destroy_listener);
+
+  tracked_resource_free (tracked);
+}
+
+static void
+track_resource (MetaWaylandShmUdmabuf *shm_udmabuf,
+                struct wl_resource    *resource,
+                MetaShmPool           *pool,
+                int32_t                offset)
+{
+  TrackedResource *tracked;
+
+  tracked = g_new0 (TrackedResource, 1);
+  tracked->shm_udmabuf = shm_udmabuf;
+  tracked->pool = meta_shm_pool_ref (pool);
+  tracked->offset = offset;
+  tracked->destroy_listener.notify = on_tracked_resource_destroyed;
+  wl_resource_add_destroy_listener (resource, &tracked->destroy_listener);
+  wl_list_insert (&shm_udmabuf->resources, &tracked->link);
+}
+
+static TrackedResource *
+get_tracked_resource (struct wl_resource *resource)
+{
+  struct wl_listener *listener;
+  TrackedResource *tracked;
+
+  listener = wl_resource_get_destroy_listener (resource,
+                                               on_tracked_resource_destroyed);
+  if (!listener)
+    return NULL;
+
+  return wl_container_of (listener, tracked, destroy_listener);
+}
+
+static gboolean
+is_sealed_memfd (int fd)
+{
+  int seals;
+
+  seals = fcntl (fd, F_GET_SEALS);
+  if (seals == -1)
+    return FALSE;
+
+  return !!(seals & F_SEAL_SHRINK);
+}
+
+static void
+protocol_logger_func (void                                    *user_data,
+                      enum wl_protocol_logger_type             type,
+                      const struct wl_protocol_logger_message *message)
+{
+  MetaWaylandShmUdmabuf *shm_udmabuf = user_data;
+  struct wl_resource *resource = message->resource;
+  const char *interface_name;
+
+  if (type != WL_PROTOCOL_LOGGER_REQUEST)
+    return;
+
+  interface_name = wl_resource_get_class (resource);
+
+  if (g_str_equal (interface_name, "wl_shm") &&
+      g_str_equal (message->message->name, "create_pool"))
+    {
+      int fd = message->arguments[1].h;
+
+      clear_pending (shm_udmabuf);
+
+      if (!is_sealed_memfd (fd))
+        return;
+
+      shm_udmabuf->pending_pool.fd = fcntl (fd, F_DUPFD_CLOEXEC, 0);
+      if (shm_udmabuf->pending_pool.fd == -1)
+        return;
+
+      shm_udmabuf->pending_pool.client = wl_resource_get_client (resource);
+      shm_udmabuf->pending_pool.id = message->arguments[0].n;
+    }
+  else if (g_str_equal (interface_name, "wl_shm_pool") &&
+           g_str_equal (message->message->name, "create_buffer"))
+    {
+      TrackedResource *tracked;
+
+      clear_pending (shm_udmabuf);
+
+      tracked = get_tracked_resource (resource);
+      if (!tracked)
+        return;
+
+      shm_udmabuf->pending_buffer.client = wl_resource_get_client (resource);
+      shm_udmabuf->pending_buffer.id = message->arguments[0].n;
+      shm_udmabuf->pending_buffer.pool = meta_shm_pool_ref (tracked->pool);
+      shm_udmabuf->pending_buffer.offset = message->arguments[1].i;
+    }
+}
+
+static void
+on_resource_created (struct wl_listener *listener,
+                     void               *data)
+{
+  ClientTracker *client_tracker = wl_container_of (listener, client_tracker,
+                                                   resource_created_listener);
+  MetaWaylandShmUdmabuf *shm_udmabuf = client_tracker->shm_udmabuf;
+  struct wl_resource *resource = data;
+  struct wl_client *client = wl_resource_get_client (resource);
+  uint32_t id = wl_resource_get_id (resource);
+
+  if (shm_udmabuf->pending_pool.client == client &&
+      shm_udmabuf->pending_pool.id == id &&
+      g_str_equal (wl_resource_get_class (resource), "wl_shm_pool"))
+    {
+      MetaShmPool *pool;
+
+      pool = meta_shm_pool_new (shm_udmabuf->pending_pool.fd);
+      shm_udmabuf->pending_pool.fd = -1;
+      track_resource (shm_udmabuf, resource, pool, 0);
+      meta_shm_pool_unref (pool);
+
+      clear_pending (shm_udmabuf);
+    }
+  else if (shm_udmabuf->pending_buffer.client == client &&
+           shm_udmabuf->pending_buffer.id == id &&
+           g_str_equal (wl_resource_get_class (resource), "wl_buffer"))
+    {
+      track_resource (shm_udmabuf, resource,
+                      shm_udmabuf->pending_buffer.pool,
+                      shm_udmabuf->pending_buffer.offset);
+
+      clear_pending (shm_udmabuf);
+    }
+}
+
+static void
+client_tracker_free (ClientTracker *client_tracker)
+{
+  wl_list_remove (&client_tracker->link);
+  wl_list_remove (&client_tracker->resource_created_listener.link);
+  wl_list_remove (&client_tracker->destroy_listener.link);
+  g_free (client_tracker);
+}
+
+static void
+on_client_destroyed (struct wl_listener *listener,
+                     void               *data)
+{
+  ClientTracker *client_tracker = wl_container_of (listener, client_tracker,
+                                                   destroy_listener);
+  MetaWaylandShmUdmabuf *shm_udmabuf = client_tracker->shm_udmabuf;
+  struct wl_client *client = data;
+
+  if (shm_udmabuf->pending_pool.client == client ||
+      shm_udmabuf->pending_buffer.client == client)
+    clear_pending (shm_udmabuf);
+
+  client_tracker_free (client_tracker);
+}
+
+static void
+on_client_created (struct wl_listener *listener,
+                   void               *data)
+{
+  MetaWaylandShmUdmabuf *shm_udmabuf = wl_container_of (listener, shm_udmabuf,
+                                                        client_created_listener);
+  struct wl_client *client = data;
+  ClientTracker *client_tracker;
+
+  client_tracker = g_new0 (ClientTracker, 1);
+  client_tracker->shm_udmabuf = shm_udmabuf;
+  client_tracker->resource_created_listener.notify = on_resource_created;
+  wl_client_add_resource_created_listener (client,
+                                           &client_tracker->resource_created_listener);
+  client_tracker->destroy_listener.notify = on_client_destroyed;
+  wl_client_add_destroy_listener (client, &client_tracker->destroy_listener);
+  wl_list_insert (&shm_udmabuf->clients, &client_tracker->link);
+}
+
+static gboolean
+shm_format_to_drm_format (enum wl_shm_format  shm_format,
+                          uint32_t           *drm_format_out,
+                          CoglPixelFormat    *cogl_format_out)
+{
+  uint32_t drm_format;
+  CoglPixelFormat cogl_format;
+
+  /* Apart from the first two, wl_shm formats are DRM fourcc codes. As for
+   * dma-buf buffers, the Cogl format only determines how the color channels
+   * are swizzled, as memory is accessed according to the DRM format.
+   */
+  switch (shm_format)
+    {
+    case WL_SHM_FORMAT_ARGB8888:
+      drm_format = DRM_FORMAT_ARGB8888;
+      cogl_format = COGL_PIXEL_FORMAT_ARGB_8888_PRE;
+      break;
+    case WL_SHM_FORMAT_XRGB8888:
+      drm_format = DRM_FORMAT_XRGB8888;
+      cogl_format = COGL_PIXEL_FORMAT_RGB_888;
+      break;
+    case WL_SHM_FORMAT_ABGR8888:
+      drm_format = DRM_FORMAT_ABGR8888;
+      cogl_format = COGL_PIXEL_FORMAT_ABGR_8888_PRE;
+      break;
+    case WL_SHM_FORMAT_XBGR8888:
+      drm_format = DRM_FORMAT_XBGR8888;
+      cogl_format = COGL_PIXEL_FORMAT_BGR_888;
+      break;
+    case WL_SHM_FORMAT_ARGB2101010:
+      drm_format = DRM_FORMAT_ARGB2101010;
+      cogl_format = COGL_PIXEL_FORMAT_ARGB_2101010_PRE;
+      break;
+    case WL_SHM_FORMAT_XRGB2101010:
+      drm_format = DRM_FORMAT_XRGB2101010;
+      cogl_format = COGL_PIXEL_FORMAT_XRGB_2101010;
+      break;
+    case WL_SHM_FORMAT_ABGR2101010:
+      drm_format = DRM_FORMAT_ABGR2101010;
+      cogl_format = COGL_PIXEL_FORMAT_ABGR_2101010_PRE;
+      break;
+    case WL_SHM_FORMAT_XBGR2101010:
+      drm_format = DRM_FORMAT_XBGR2101010;
+      cogl_format = COGL_PIXEL_FORMAT_XBGR_2101010;
+      break;
+    case WL_SHM_FORMAT_RGB565:
+      drm_format = DRM_FORMAT_RGB565;
+      cogl_format = COGL_PIXEL_FORMAT_RGB_565;
+      break;
+    default:
+      return FALSE;
+    }
+
+  *drm_format_out = drm_format;
+  *cogl_format_out = cogl_format;
+
+  return TRUE;
+}
+
+/*
+ * udmabuf only accepts page aligned ranges within the memfd, so the buffer
+ * data is wrapped with the surrounding pages, and then found in the dma-buf
+ * at @plane_offset.
+ */
+gboolean
+meta_wayland_shm_udmabuf_calculate_range (int64_t   offset,
+                                          int64_t   size,
+                                          int64_t   file_size,
+                                          int64_t   page_size,
+                                          uint64_t *udmabuf_offset,
+                                          uint64_t *udmabuf_size,
+                                          uint32_t *plane_offset)
+{
+  int64_t start;
+  int64_t end;
+
+  if (offset < 0 || size <= 0 || offset + size > file_size)
+    return FALSE;
+
+  start = (offset / page_size) * page_size;
+  end = ((offset + size + page_size - 1) / page_size) * page_size;
+  if (end > file_size)
+    return FALSE;
+
+  if (offset - start > UINT32_MAX)
+    return FALSE;
+
+  *udmabuf_offset = start;
+  *udmabuf_size = end - start;
+  *plane_offset = offset - start;
+
+  return TRUE;
+}
+
+static int
+create_udmabuf (MetaWaylandShmUdmabuf  *shm_udmabuf,
+                MetaShmPool            *pool,
+                uint64_t                offset,
+                uint64_t                size,
+                GError                **error)
+{
+#ifdef HAVE_LINUX_UDMABUF
+  struct udmabuf_create create = {
+    .memfd = pool->fd,
+    .flags = UDMABUF_FLAGS_CLOEXEC,
+    .offset = offset,
+    .size = size,
+  };
+  int fd;
+
+  fd = ioctl (shm_udmabuf->udmabuf_fd, UDMABUF_CREATE, &create);
+  if (fd == -1)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to create udmabuf: %s", g_strerror (errsv));
+      return -1;
+    }
+
+  return fd;
+#else
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               "Built without udmabuf support");
+  return -1;
+#endif
+}
+
+CoglTexture *
+meta_wayland_shm_udmabuf_import (MetaWaylandShmUdmabuf  *shm_udmabuf,
+                                 struct wl_resource     *buffer_resource,
+                                 GError                **error)
+{
+  MetaBackend *backend = meta_get_backend ();
+  MetaEgl *egl = meta_backend_get_egl (backend);
+  ClutterBackend *clutter_backend = meta_backend_get_clutter_backend (backend);
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (clutter_backend);
+  EGLDisplay egl_display = cogl_egl_context_get_egl_display (cogl_context);
+  struct wl_shm_buffer *shm_buffer;
+  TrackedResource *tracked;
+  uint32_t drm_format;
+  CoglPixelFormat cogl_format;
+  int width, height;
+  uint32_t stride;
+  struct stat pool_stat;
+  uint64_t udmabuf_offset;
+  uint64_t udmabuf_size;
+  uint32_t plane_offset;
+  int dmabuf_fd;
+  EGLImageKHR egl_image;
+  CoglTexture2D *texture;
+
+  tracked = get_tracked_resource (buffer_resource);
+  if (!tracked)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Buffer pool is not a sealed memfd");
+      return NULL;
+    }
+
+  shm_buffer = wl_shm_buffer_get (buffer_resource);
+  if (!shm_format_to_drm_format (wl_shm_buffer_get_format (shm_buffer),
+                                 &drm_format, &cogl_format))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Unsupported shm format");
+      return NULL;
+    }
+
+  width = wl_shm_buffer_get_width (shm_buffer);
+  height = wl_shm_buffer_get_height (shm_buffer);
+  stride = wl_shm_buffer_get_stride (shm_buffer);
+
+  if (fstat (tracked->pool->fd, &pool_stat) == -1)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to stat pool: %s", g_strerror (errsv));
+      return NULL;
+    }
+
+  if (!meta_wayland_shm_udmabuf_calculate_range (tracked->offset,
+                                                 (int64_t) stride * height,
+                                                 pool_stat.st_size,
+                                                 shm_udmabuf->page_size,
+                                                 &udmabuf_offset,
+                                                 &udmabuf_size,
+                                                 &plane_offset))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Buffer is not within page aligned pool bounds");
+      return NULL;
+    }
+
+  dmabuf_fd = create_udmabuf (shm_udmabuf, tracked->pool,
+                              udmabuf_offset, udmabuf_size,
+                              error);
+  if (dmabuf_fd == -1)
+    return NULL;
+
+  egl_image = meta_egl_create_dmabuf_image (egl,
+                                            egl_display,
+                                            width,
+                                            height,
+                                            drm_format,
+                                            1,
+                                            &dmabuf_fd,
+                                            &stride,
+                                            &plane_offset,
+                                            NULL,
+                                            error);
+  close (dmabuf_fd);
+  if (egl_image == EGL_NO_IMAGE_KHR)
+    return NULL;
+
+  texture = cogl_egl_texture_2d_new_from_image (cogl_context,
+                                                width, height,
+                                                cogl_format,
+                                                egl_image,
+                                                COGL_EGL_IMAGE_FLAG_NO_GET_DATA,
+                                                error);
+
+  meta_egl_destroy_image (egl, egl_display, egl_image, NULL);
+
+  if (!texture)
+    return NULL;
+
+  cogl_object_set_user_data (COGL_OBJECT (texture), &udmabuf_texture_key,
+                             GINT_TO_POINTER (TRUE), NULL);
+
+  meta_topic (META_DEBUG_WAYLAND,
+              "[wl-shm] Imported wl_buffer@%u (%dx%d) through udmabuf",
+              wl_resource_get_id (buffer_resource), width, height);
+
+  return COGL_TEXTURE (texture);
+}
+
+gboolean
+meta_wayland_shm_udmabuf_is_imported_texture (CoglTexture *texture)
+{
+  return !!cogl_object_get_user_data (COGL_OBJECT (texture),
+                                      &udmabuf_texture_key);
+}
+
+MetaWaylandShmUdmabuf *
+meta_wayland_shm_udmabuf_new (MetaWaylandCompositor  *compositor,
+                              GError                **error)
+{
+  MetaBackend *backend = meta_get_backend ();
+  MetaEgl *egl = meta_backend_get_egl (backend);
+  ClutterBackend *clutter_backend = meta_backend_get_clutter_backend (backend);
+  CoglContext *cogl_context = clutter_backend_get_cogl_context (clutter_backend);
+  EGLDisplay egl_display;
+  MetaWaylandShmUdmabuf *shm_udmabuf;
+  int udmabuf_fd;
+
+#ifndef HAVE_LINUX_UDMABUF
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               "Built without udmabuf support");
+  return NULL;
+#endif
+
+  egl_display = cogl_egl_context_get_egl_display (cogl_context);
+  if (!meta_egl_has_extensions (egl, egl_display, NULL,
+                                "EGL_EXT_image_dma_buf_import",
+                                NULL))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Missing 'EGL_EXT_image_dma_buf_import'");
+      return NULL;
+    }
+
+  udmabuf_fd = open ("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+  if (udmabuf_fd == -1)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to open /dev/udmabuf: %s", g_strerror (errsv));
+      return NULL;
+    }
+
+  shm_udmabuf = g_new0 (MetaWaylandShmUdmabuf, 1);
+  shm_udmabuf->compositor = compositor;
+  shm_udmabuf->udmabuf_fd = udmabuf_fd;
+  shm_udmabuf->page_size = sysconf (_SC_PAGESIZE);
+  shm_udmabuf->pending_pool.fd = -1;
+  wl_list_init (&shm_udmabuf->clients);
+  wl_list_init (&shm_udmabuf->resources);
+
+  shm_udmabuf->client_created_listener.notify = on_client_created;
+  wl_display_add_client_created_listener (compositor->wayland_display,
+                                          &shm_udmabuf->client_created_listener);
+  shm_udmabuf->protocol_logger =
+    wl_display_add_protocol_logger (compositor->wayland_display,
+                                    protocol_logger_func,
+                                    shm_udmabuf);
+
+  return shm_udmabuf;
+}
+
+void
+meta_wayland_shm_udmabuf_free (MetaWaylandShmUdmabuf *shm_udmabuf)
+{
+  TrackedResource *tracked, *tmp_tracked;
+  ClientTracker *client_tracker, *tmp_client_tracker;
+
+  wl_protocol_logger_destroy (shm_udmabuf->protocol_logger);
+  wl_list_remove (&shm_udmabuf->client_created_listener.link);
+
+  wl_list_for_each_safe (tracked, tmp_tracked, &shm_udmabuf->resources, link)
+    tracked_resource_free (tracked);
+  wl_list_for_each_safe (client_tracker, tmp_client_tracker,
+                         &shm_udmabuf->clients, link)
+    client_tracker_free (client_tracker);
+
+  clear_pending (shm_udmabuf);
+  close (shm_udmabuf->udmabuf_fd);
+  g_free (shm_udmabuf);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef META_WAYLAND_SHM_UDMABUF_H
+#define META_WAYLAND_SHM_UDMABUF_H
+
+#include <glib.h>
+#include <wayland-server.h>
+
+#include "cogl/cogl.h"
+#include "core/util-private.h"
+#include "wayland/meta-wayland-types.h"
+
+typedef struct _MetaWaylandShmUdmabuf MetaWaylandShmUdmabuf;
+
+MetaWaylandShmUdmabuf * meta_wayland_shm_udmabuf_new (MetaWaylandCompositor  *compositor,
+                                                      GError                **error);
+
+void meta_wayland_shm_udmabuf_free (MetaWaylandShmUdmabuf *shm_udmabuf);
+
+CoglTexture * meta_wayland_shm_udmabuf_import (MetaWaylandShmUdmabuf  *shm_udmabuf,
+                                               struct wl_resource     *buffer_resource,
+                                               GError                **error);
+
+gboolean meta_wayland_shm_udmabuf_is_imported_texture (CoglTexture *texture);
+
+META_EXPORT_TEST
+gboolean meta_wayland_shm_udmabuf_calculate_range (int64_t   offset,
+                                                   int64_t   size,
+                                                   int64_t   file_size,
+                                                   int64_t   page_size,
+                                                   uint64_t *udmabuf_offset,
+                                                   uint64_t *udmabuf_size,
+                                                   uint32_t *plane_offset);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MetaWaylandShmUdmabuf,
+                               meta_wayland_shm_udmabuf_free)
+
+#endif /* META_WAYLAND_SHM_UDMABUF_H */
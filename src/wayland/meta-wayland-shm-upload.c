@@ -0,0 +1,543 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * MetaWaylandShmUploader uploads the damaged parts of wl_shm buffers to
+ * textures.
+ *
+ * Damage rectangles are first coalesced using a simple cost model, where
+ * each upload costs a fixed overhead plus the number of bytes transferred,
+ * so that clients posting many small rectangles don't result in just as
+ * many tiny texture uploads.
+ *
+ * Small rectangles already in a format the driver accepts are uploaded
+ * directly. Everything else is copied, and converted if needed, into a
+ * ring of pixel buffers, split into bands that are processed in parallel,
+ * and then uploaded from there.
+ */
+
+#include "config.h"
+
+#include "wayland/meta-wayland-shm-upload.h"
+
+#include <string.h>
+
+#include "core/meta-parallel.h"
+#include "meta/boxes.h"
+
+#define UPLOAD_OVERHEAD_BYTES (32 * 1024)
+#define MAX_COALESCE_RECTS 256
+#define MIN_STAGED_UPLOAD_BYTES (256 * 1024)
+#define MAX_STAGING_BUFFER_SIZE (8 * 1024 * 1024)
+#define N_STAGING_BUFFERS 3
+#define MIN_BYTES_PER_JOB (1024 * 1024)
+
+typedef struct _CopyJob
+{
+  MetaWaylandShmUploader *uploader;
+  struct wl_shm_buffer *shm_buffer;
+
+  /* Only set when converting */
+  CoglBitmap *src_bitmap;
+  CoglBitmap *dst_bitmap;
+
+  const uint8_t *src;
+  int src_stride;
+  uint8_t *dst;
+  int dst_stride;
+  int row_size;
+  int n_rows;
+
+  GError *error;
+} CopyJob;
+
+struct _MetaWaylandShmUploader
+{
+  CoglContext *cogl_context;
+
+  CoglPixelBuffer *staging_buffers[N_STAGING_BUFFERS];
+  int next_staging_buffer;
+
+  int max_jobs;
+};
+
+static int64_t
+calculate_upload_cost (const cairo_rectangle_int_t *rect,
+                       int                          bpp)
+{
+  return UPLOAD_OVERHEAD_BYTES + (int64_t) rect->width * rect->height * bpp;
+}
+
+static gboolean
+maybe_merge_rects (cairo_rectangle_int_t       *rect,
+                   const cairo_rectangle_int_t *other,
+                   int                          bpp)
+{
+  cairo_rectangle_int_t bounds;
+
+  meta_rectangle_union (rect, other, &bounds);
+
+  if (calculate_upload_cost (&bounds, bpp) >
+      calculate_upload_cost (rect, bpp) + calculate_upload_cost (other, bpp))
+    return FALSE;
+
+  *rect = bounds;
+  return TRUE;
+}
+
+/**
+ * meta_wayland_shm_coalesce_damage:
+ * @region: the damaged region
+ * @bpp: bytes per pixel of the buffer
+ *
+ * Returns: (transfer full): an array of #cairo_rectangle_int_t covering
+ *   @region, where rectangles are merged whenever uploading their bounding
+ *   box is estimated to be cheaper than uploading them separately.
+ */
+GArray *
+meta_wayland_shm_coalesce_damage (const cairo_region_t *region,
+                                  int                   bpp)
+{
+  GArray *rects;
+  cairo_rectangle_int_t extents;
+  int64_t total_cost = 0;
+  int n_rects;
+  int i;
+
+  n_rects = cairo_region_num_rectangles (region);
+  rects = g_array_sized_new (FALSE, FALSE, sizeof (cairo_rectangle_int_t),
+                             n_rects);
+
+  /* Region rectangles are sorted in y-x order, so merging each rectangle
+   * with the previous one catches the common case of rows of glyphs or
+   * cells cheaply.
+   */
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t rect;
+
+      cairo_region_get_rectangle (region, i, &rect);
+
+      if (rects->len > 0 &&
+          maybe_merge_rects (&g_array_index (rects, cairo_rectangle_int_t,
+                                             rects->len - 1),
+                             &rect, bpp))
+        continue;
+
+      g_array_append_val (rects, rect);
+    }
+
+  if (rects->len <= MAX_COALESCE_RECTS)
+    {
+      gboolean merged;
+
+      do
+        {
+          int j;
+
+          merged = FALSE;
+
+          for (i = 0; i < rects->len; i++)
+            {
+              cairo_rectangle_int_t *rect =
+                &g_array_index (rects, cairo_rectangle_int_t, i);
+
+              for (j = i + 1; j < rects->len; j++)
+                {
+                  if (maybe_merge_rects (rect,
+                                         &g_array_index (rects,
+                                                         cairo_rectangle_int_t,
+                                                         j),
+                                         bpp))
+                    {
+                      g_array_remove_index_fast (rects, j);
+                      merged = TRUE;
+                      j = i;
+                    }
+                }
+            }
+        }
+      while (merged);
+    }
+
+  if (rects->len <= 1)
+    return rects;
+
+  for (i = 0; i < rects->len; i++)
+    {
+      total_cost +=
+        calculate_upload_cost (&g_array_index (rects, cairo_rectangle_int_t, i),
+                               bpp);
+    }
+
+  cairo_region_get_extents (region, &extents);
+  if (calculate_upload_cost (&extents, bpp) <= total_cost)
+    {
+      g_array_set_size (rects, 1);
+      g_array_index (rects, cairo_rectangle_int_t, 0) = extents;
+    }
+
+  return rects;
+}
+
+static void
+copy_rows (CopyJob *job)
+{
+  int y;
+
+  if (job->src_bitmap)
+    {
+      _cogl_bitmap_convert_into_bitmap (job->src_bitmap, job->dst_bitmap,
+                                        &job->error);
+      return;
+    }
+
+  for (y = 0; y < job->n_rows; y++)
+    {
+      memcpy (job->dst + (size_t) y * job->dst_stride,
+              job->src + (size_t) y * job->src_stride,
+              job->row_size);
+    }
+}
+
+static void
+run_copy_jobs (int      first,
+               int      n_items,
+               gpointer user_data)
+{
+  CopyJob *jobs = user_data;
+  int i;
+
+  for (i = first; i < first + n_items; i++)
+    {
+      /* SIGBUS protection is per thread. */
+      wl_shm_buffer_begin_access (jobs[i].shm_buffer);
+      copy_rows (&jobs[i]);
+      wl_shm_buffer_end_access (jobs[i].shm_buffer);
+    }
+}
+
+static int
+calculate_n_jobs (MetaWaylandShmUploader *uploader,
+                  size_t                  n_bytes,
+                  int                     n_rows)
+{
+  return (int) CLAMP (n_bytes / MIN_BYTES_PER_JOB,
+                      1, (size_t) MIN (uploader->max_jobs, n_rows));
+}
+
+static gboolean
+copy_into_staging_buffer (MetaWaylandShmUploader *uploader,
+                          struct wl_shm_buffer   *shm_buffer,
+                          const uint8_t          *src,
+                          int                     src_stride,
+                          CoglPixelFormat         src_format,
+                          uint8_t                *dst,
+                          int                     dst_stride,
+                          CoglPixelFormat         dst_format,
+                          int                     width,
+                          int                     height,
+                          GError                **error)
+{
+  g_autofree CopyJob *jobs = NULL;
+  gboolean needs_conversion = src_format != dst_format;
+  gboolean ret = TRUE;
+  int n_jobs;
+  int i;
+
+  n_jobs = calculate_n_jobs (uploader, (size_t) dst_stride * height, height);
+  jobs = g_new0 (CopyJob, n_jobs);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      CopyJob *job = &jobs[i];
+      int first_row = (height * i) / n_jobs;
+
+      job->uploader = uploader;
+      job->shm_buffer = shm_buffer;
+      job->src = src + (size_t) first_row * src_stride;
+      job->src_stride = src_stride;
+      job->dst = dst + (size_t) first_row * dst_stride;
+      job->dst_stride = dst_stride;
+      job->row_size = width * cogl_pixel_format_get_bytes_per_pixel (src_format,
+                                                                    0);
+      job->n_rows = (height * (i + 1)) / n_jobs - first_row;
+
+      if (needs_conversion)
+        {
+          job->src_bitmap = cogl_bitmap_new_for_data (uploader->cogl_context,
+                                                      width, job->n_rows,
+                                                      src_format,
+                                                      src_stride,
+                                                      (uint8_t *) job->src);
+          job->dst_bitmap = cogl_bitmap_new_for_data (uploader->cogl_context,
+                                                      width, job->n_rows,
+                                                      dst_format,
+                                                      dst_stride,
+                                                      job->dst);
+        }
+    }
+
+  meta_parallel_for (n_jobs, n_jobs, run_copy_jobs, jobs);
+
+  for (i = 0; i < n_jobs; i++)
+    {
+      g_clear_pointer (&jobs[i].src_bitmap, cogl_object_unref);
+      g_clear_pointer (&jobs[i].dst_bitmap, cogl_object_unref);
+
+      if (!jobs[i].error)
+        continue;
+
+      if (ret)
+        g_propagate_error (error, g_steal_pointer (&jobs[i].error));
+      else
+        g_clear_error (&jobs[i].error);
+
+      ret = FALSE;
+    }
+
+  return ret;
+}
+
+static CoglPixelBuffer *
+get_staging_buffer (MetaWaylandShmUploader *uploader,
+                    size_t                  size)
+{
+  CoglPixelBuffer **pixel_buffer;
+
+  pixel_buffer = &uploader->staging_buffers[uploader->next_staging_buffer];
+  uploader->next_staging_buffer =
+    (uploader->next_staging_buffer + 1) % N_STAGING_BUFFERS;
+
+  if (*pixel_buffer &&
+      cogl_buffer_get_size (COGL_BUFFER (*pixel_buffer)) < size)
+    g_clear_pointer (pixel_buffer, cogl_object_unref);
+
+  if (!*pixel_buffer)
+    {
+      *pixel_buffer = cogl_pixel_buffer_new (uploader->cogl_context,
+                                             size, NULL);
+      cogl_buffer_set_update_hint (COGL_BUFFER (*pixel_buffer),
+                                   COGL_BUFFER_UPDATE_HINT_STREAM);
+    }
+
+  return *pixel_buffer;
+}
+
+static gboolean
+upload_direct (CoglTexture                 *texture,
+               const uint8_t               *data,
+               int                          stride,
+               CoglPixelFormat              format,
+               const cairo_rectangle_int_t *rect,
+               GError                     **error)
+{
+  int bpp = cogl_pixel_format_get_bytes_per_pixel (format, 0);
+
+  return _cogl_texture_set_region (texture,
+                                   rect->width, rect->height,
+                                   format,
+                                   stride,
+                                   data + rect->x * bpp + rect->y * stride,
+                                   rect->x, rect->y,
+                                   0,
+                                   error);
+}
+
+static gboolean
+upload_staged (MetaWaylandShmUploader      *uploader,
+               struct wl_shm_buffer        *shm_buffer,
+               CoglTexture                 *texture,
+               const uint8_t               *data,
+               int                          stride,
+               CoglPixelFormat              format,
+               CoglPixelFormat              upload_format,
+               const cairo_rectangle_int_t *rect,
+               GError                     **error)
+{
+  int src_bpp = cogl_pixel_format_get_bytes_per_pixel (format, 0);
+  int dst_bpp = cogl_pixel_format_get_bytes_per_pixel (upload_format, 0);
+  int dst_stride = rect->width * dst_bpp;
+  int rows_per_band;
+  int y;
+
+  rows_per_band = MAX (1, MAX_STAGING_BUFFER_SIZE / dst_stride);
+
+  for (y = 0; y < rect->height; y += rows_per_band)
+    {
+      int height = MIN (rows_per_band, rect->height - y);
+      size_t size = (size_t) dst_stride * height;
+      const uint8_t *src;
+      CoglPixelBuffer *pixel_buffer;
+      CoglBitmap *bitmap;
+      uint8_t *dst;
+      gboolean ret;
+
+      src = data + (size_t) (rect->y + y) * stride + rect->x * src_bpp;
+
+      pixel_buffer = get_staging_buffer (uploader, size);
+      dst = cogl_buffer_map_range (COGL_BUFFER (pixel_buffer),
+                                   0, size,
+                                   COGL_BUFFER_ACCESS_WRITE,
+                                   COGL_BUFFER_MAP_HINT_DISCARD,
+                                   NULL);
+      if (!dst)
+        {
+          cairo_rectangle_int_t band_rect;
+
+          band_rect = (cairo_rectangle_int_t) {
+            .x = rect->x,
+            .y = rect->y + y,
+            .width = rect->width,
+            .height = height,
+          };
+
+          if (!upload_direct (texture, data, stride, format, &band_rect,
+                              error))
+            return FALSE;
+
+          continue;
+        }
+
+      ret = copy_into_staging_buffer (uploader, shm_buffer,
+                                      src, stride, format,
+                                      dst, dst_stride, upload_format,
+                                      rect->width, height,
+                                      error);
+      cogl_buffer_unmap (COGL_BUFFER (pixel_buffer));
+      if (!ret)
+        return FALSE;
+
+      bitmap = cogl_bitmap_new_from_buffer (COGL_BUFFER (pixel_buffer),
+                                            upload_format,
+                                            rect->width, height,
+                                            dst_stride,
+                                            0);
+      ret = _cogl_texture_set_region_from_bitmap (texture,
+                                                  0, 0,
+                                                  rect->width, height,
+                                                  bitmap,
+                                                  rect->x, rect->y + y,
+                                                  0,
+                                                  error);
+      cogl_object_unref (bitmap);
+      if (!ret)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+gboolean
+meta_wayland_shm_uploader_upload (MetaWaylandShmUploader *uploader,
+                                  struct wl_shm_buffer   *shm_buffer,
+                                  CoglPixelFormat         format,
+                                  CoglTexture            *texture,
+                                  const cairo_region_t   *region,
+                                  GError                **error)
+{
+  g_autoptr (GArray) rects = NULL;
+  CoglPixelFormat upload_format;
+  const uint8_t *data;
+  int32_t stride;
+  int bpp;
+  size_t n_bytes = 0;
+  int n_uploads = 0;
+  gboolean ret = TRUE;
+  int i;
+
+  COGL_TRACE_BEGIN_SCOPED (MetaWaylandShmUpload,
+                           "WaylandShmUpload (upload)");
+
+  bpp = cogl_pixel_format_get_bytes_per_pixel (format, 0);
+  upload_format = _cogl_texture_get_upload_format (texture, format);
+  rects = meta_wayland_shm_coalesce_damage (region, bpp);
+
+  wl_shm_buffer_begin_access (shm_buffer);
+
+  data = wl_shm_buffer_get_data (shm_buffer);
+  stride = wl_shm_buffer_get_stride (shm_buffer);
+
+  for (i = 0; i < rects->len; i++)
+    {
+      cairo_rectangle_int_t *rect =
+        &g_array_index (rects, cairo_rectangle_int_t, i);
+      size_t rect_bytes = (size_t) rect->width * rect->height * bpp;
+
+      if (upload_format == format && rect_bytes < MIN_STAGED_UPLOAD_BYTES)
+        {
+          ret = upload_direct (texture, data, stride, format, rect, error);
+        }
+      else
+        {
+          ret = upload_staged (uploader, shm_buffer, texture,
+                               data, stride, format, upload_format,
+                               rect, error);
+        }
+
+      if (!ret)
+        break;
+
+      n_bytes += rect_bytes;
+      n_uploads++;
+    }
+
+  wl_shm_buffer_end_access (shm_buffer);
+
+#ifdef COGL_HAS_TRACING
+  if (G_UNLIKELY (cogl_is_tracing_enabled ()))
+    {
+      g_autofree char *description = NULL;
+
+      description =
+        g_strdup_printf ("%d rects, %d uploads, %zu bytes%s",
+                         cairo_region_num_rectangles (region),
+                         n_uploads, n_bytes,
+                         upload_format != format ? ", converted" : "");
+      COGL_TRACE_DESCRIBE (MetaWaylandShmUpload, description);
+    }
+#endif
+
+  return ret;
+}
+
+MetaWaylandShmUploader *
+meta_wayland_shm_uploader_new (CoglContext *cogl_context)
+{
+  MetaWaylandShmUploader *uploader;
+
+  uploader = g_new0 (MetaWaylandShmUploader, 1);
+  uploader->cogl_context = cogl_context;
+
+  if (g_getenv ("MUTTER_DEBUG_DISABLE_THREADED_SHM_UPLOAD"))
+    uploader->max_jobs = 1;
+  else
+    uploader->max_jobs = meta_parallel_get_max_tasks ();
+
+  return uploader;
+}
+
+void
+meta_wayland_shm_uploader_free (MetaWaylandShmUploader *uploader)
+{
+  int i;
+
+  for (i = 0; i < N_STAGING_BUFFERS; i++)
+    g_clear_pointer (&uploader->staging_buffers[i], cogl_object_unref);
+
+  g_free (uploader);
+}
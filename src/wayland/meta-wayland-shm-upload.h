@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef META_WAYLAND_SHM_UPLOAD_H
+#define META_WAYLAND_SHM_UPLOAD_H
+
+#include <cairo.h>
+#include <glib.h>
+#include <wayland-server.h>
+
+#include "cogl/cogl.h"
+#include "core/util-private.h"
+
+typedef struct _MetaWaylandShmUploader MetaWaylandShmUploader;
+
+MetaWaylandShmUploader * meta_wayland_shm_uploader_new (CoglContext *cogl_context);
+
+void meta_wayland_shm_uploader_free (MetaWaylandShmUploader *uploader);
+
+gboolean meta_wayland_shm_uploader_upload (MetaWaylandShmUploader *uploader,
+                                           struct wl_shm_buffer   *shm_buffer,
+                                           CoglPixelFormat         format,
+                                           CoglTexture            *texture,
+                                           const cairo_region_t   *region,
+                                           GError                **error);
+
+META_EXPORT_TEST
+GArray * meta_wayland_shm_coalesce_damage (const cairo_region_t *region,
+                                           int                   bpp);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (MetaWaylandShmUploader,
+                               meta_wayland_shm_uploader_free)
+
+#endif /* META_WAYLAND_SHM_UPLOAD_H */
@@ -477,7 +477,7 @@ wl_subsurface_set_desync (struct wl_client   *client,
     is_surface_effectively_synchronized (surface->sub.parent);
 
   if (!is_parent_effectively_synchronized)
-    meta_wayland_surface_apply_cached_state (surface);
+    meta_wayland_surface_commit_cached_state (surface);
 
   surface->sub.synchronous = FALSE;
 }
@@ -48,6 +48,7 @@
 #include "wayland/meta-wayland-region.h"
 #include "wayland/meta-wayland-seat.h"
 #include "wayland/meta-wayland-subsurface.h"
+#include "wayland/meta-wayland-transaction.h"
 #include "wayland/meta-wayland-viewporter.h"
 #include "wayland/meta-wayland-xdg-shell.h"
 #include "wayland/meta-window-wayland.h"
@@ -80,6 +81,7 @@ enum
   PROP_0,
 
   PROP_SCANOUT_CANDIDATE,
+  PROP_OVERLAY_CANDIDATE,
 
   N_PROPS
 };
@@ -541,7 +543,7 @@ meta_wayland_surface_state_reset (MetaWaylandSurfaceState *state)
   meta_wayland_surface_state_set_default (state);
 }
 
-static void
+void
 meta_wayland_surface_state_merge_into (MetaWaylandSurfaceState *from,
                                        MetaWaylandSurfaceState *to)
 {
@@ -710,7 +712,7 @@ meta_wayland_surface_discard_presentation_feedback (MetaWaylandSurface *surface)
     }
 }
 
-static void
+void
 meta_wayland_surface_apply_state (MetaWaylandSurface      *surface,
                                   MetaWaylandSurfaceState *state)
 {
@@ -769,6 +771,9 @@ meta_wayland_surface_apply_state (MetaWaylandSurface      *surface,
               g_error_free (error);
               goto cleanup;
             }
+
+          meta_wayland_presentation_time_content_ready (surface,
+                                                        g_get_monotonic_time ());
         }
       else
         {
@@ -776,12 +781,12 @@ meta_wayland_surface_apply_state (MetaWaylandSurface      *surface,
         }
 
       /* If the newly attached buffer is going to be accessed directly without
-       * making a copy, such as an EGL buffer, mark it as in-use don't release
-       * it until is replaced by a subsequent wl_surface.commit or when the
-       * wl_surface is destroyed.
+       * making a copy, such as an EGL buffer or a shm buffer imported through
+       * udmabuf, mark it as in-use don't release it until is replaced by a
+       * subsequent wl_surface.commit or when the wl_surface is destroyed.
        */
       surface->buffer_held = (state->buffer &&
-                              !wl_shm_buffer_get (state->buffer->resource));
+                              !meta_wayland_buffer_is_copied (state->buffer));
     }
 
   if (state->scale > 0)
@@ -991,6 +996,60 @@ meta_wayland_surface_get_pending_state (MetaWaylandSurface *surface)
   return surface->pending_state;
 }
 
+static void
+add_subsurface_states (MetaWaylandSurface     *surface,
+                       MetaWaylandTransaction *transaction)
+{
+  MetaWaylandSurface *subsurface_surface;
+
+  META_WAYLAND_SURFACE_FOREACH_SUBSURFACE (surface, subsurface_surface)
+    {
+      if (subsurface_surface->sub.pending_pos)
+        {
+          meta_wayland_transaction_add_subsurface_position (transaction,
+                                                            subsurface_surface);
+        }
+
+      if (!meta_wayland_surface_should_cache_state (subsurface_surface))
+        continue;
+
+      /* Add a state even when nothing was committed, so that anything the
+       * subsurface commits while this transaction is waiting isn't applied
+       * along with it.
+       */
+      ensure_cached_state (subsurface_surface);
+      meta_wayland_transaction_add_state (transaction,
+                                          subsurface_surface,
+                                          g_steal_pointer (&subsurface_surface->cached_state));
+
+      add_subsurface_states (subsurface_surface, transaction);
+    }
+}
+
+static void
+commit_state (MetaWaylandSurface      *surface,
+              MetaWaylandSurfaceState *state)
+{
+  MetaWaylandTransaction *transaction;
+
+  transaction = meta_wayland_transaction_new (surface->compositor, surface);
+  meta_wayland_transaction_add_state (transaction, surface, state);
+  add_subsurface_states (surface, transaction);
+  meta_wayland_transaction_commit (transaction);
+}
+
+/*
+ * Like meta_wayland_surface_apply_cached_state(), but the state is only
+ * applied once the buffers it attaches are ready, and after any state
+ * committed before it.
+ */
+void
+meta_wayland_surface_commit_cached_state (MetaWaylandSurface *surface)
+{
+  ensure_cached_state (surface);
+  commit_state (surface, g_steal_pointer (&surface->cached_state));
+}
+
 static void
 meta_wayland_surface_commit (MetaWaylandSurface *surface)
 {
@@ -1025,7 +1084,9 @@ meta_wayland_surface_commit (MetaWaylandSurface *surface)
     }
   else
     {
-      meta_wayland_surface_apply_state (surface, surface->pending_state);
+      surface->pending_state = g_object_new (META_TYPE_WAYLAND_SURFACE_STATE,
+                                             NULL);
+      commit_state (surface, pending);
     }
 }
 
@@ -1457,7 +1518,10 @@ wl_surface_destructor (struct wl_resource *resource)
 
   g_signal_emit (surface, surface_signals[SURFACE_DESTROY], 0);
 
+  meta_wayland_transaction_drop_surface (compositor, surface);
+
   g_clear_object (&surface->scanout_candidate);
+  g_clear_object (&surface->overlay_candidate);
   g_clear_object (&surface->role);
 
   if (surface->unassigned.buffer)
@@ -1750,6 +1814,9 @@ meta_wayland_surface_get_property (GObject    *object,
     case PROP_SCANOUT_CANDIDATE:
       g_value_set_object (value, surface->scanout_candidate);
       break;
+    case PROP_OVERLAY_CANDIDATE:
+      g_value_set_object (value, surface->overlay_candidate);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1770,6 +1837,13 @@ meta_wayland_surface_class_init (MetaWaylandSurfaceClass *klass)
                          META_TYPE_CRTC,
                          G_PARAM_READABLE |
                          G_PARAM_STATIC_STRINGS);
+  obj_props[PROP_OVERLAY_CANDIDATE] =
+    g_param_spec_object ("overlay-candidate",
+                         "overlay-candidate",
+                         "Overlay plane candidate for given CRTC",
+                         META_TYPE_CRTC,
+                         G_PARAM_READABLE |
+                         G_PARAM_STATIC_STRINGS);
   g_object_class_install_properties (object_class, N_PROPS, obj_props);
 
   surface_signals[SURFACE_DESTROY] =
@@ -2150,6 +2224,19 @@ scanout_destroyed (gpointer  data,
   meta_wayland_buffer_ref_unref (buffer_ref);
 }
 
+/**
+ * meta_wayland_surface_try_acquire_scanout:
+ * @surface: A #MetaWaylandSurface
+ * @onscreen: (nullable): The onscreen to scan out the buffer on
+ *
+ * Imports the current buffer of @surface for scanout. If @onscreen is
+ * passed, the buffer is also tested for being scanned out on its primary
+ * plane; otherwise the caller is responsible for testing the plane it
+ * assigns it to.
+ *
+ * Returns: (transfer full) (nullable): The scanout, keeping the buffer in
+ *   use until it is destroyed.
+ */
 CoglScanout *
 meta_wayland_surface_try_acquire_scanout (MetaWaylandSurface *surface,
                                           CoglOnscreen       *onscreen)
@@ -2193,6 +2280,24 @@ meta_wayland_surface_set_scanout_candidate (MetaWaylandSurface *surface,
                             obj_props[PROP_SCANOUT_CANDIDATE]);
 }
 
+MetaCrtc *
+meta_wayland_surface_get_overlay_candidate (MetaWaylandSurface *surface)
+{
+  return surface->overlay_candidate;
+}
+
+void
+meta_wayland_surface_set_overlay_candidate (MetaWaylandSurface *surface,
+                                            MetaCrtc           *crtc)
+{
+  if (surface->overlay_candidate == crtc)
+    return;
+
+  g_set_object (&surface->overlay_candidate, crtc);
+  g_object_notify_by_pspec (G_OBJECT (surface),
+                            obj_props[PROP_OVERLAY_CANDIDATE]);
+}
+
 gboolean
 meta_wayland_surface_can_scanout_untransformed (MetaWaylandSurface *surface,
                                                 MetaRendererView   *view,
@@ -2257,3 +2362,28 @@ meta_wayland_surface_can_scanout_untransformed (MetaWaylandSurface *surface,
 
   return TRUE;
 }
+
+/**
+ * meta_wayland_surface_can_scanout_unscaled:
+ * @surface: A #MetaWaylandSurface
+ * @width: Width of the area covered by @surface, in physical pixels
+ * @height: Height of the area covered by @surface, in physical pixels
+ *
+ * Returns: %TRUE if the current buffer of @surface can be scanned out as is
+ *   to cover a @width x @height area, without being cropped, scaled or
+ *   transformed.
+ */
+gboolean
+meta_wayland_surface_can_scanout_unscaled (MetaWaylandSurface *surface,
+                                           int                 width,
+                                           int                 height)
+{
+  if (surface->buffer_transform != META_MONITOR_TRANSFORM_NORMAL)
+    return FALSE;
+
+  if (surface->viewport.has_src_rect)
+    return FALSE;
+
+  return get_buffer_width (surface) == width &&
+         get_buffer_height (surface) == height;
+}
@@ -33,6 +33,8 @@
 #include "wayland/meta-wayland-pointer-constraints.h"
 #include "wayland/meta-wayland-types.h"
 
+#define META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES 8
+
 #define META_TYPE_WAYLAND_SURFACE (meta_wayland_surface_get_type ())
 G_DECLARE_FINAL_TYPE (MetaWaylandSurface,
                       meta_wayland_surface,
@@ -246,10 +248,24 @@ struct _MetaWaylandSurface
      * delta to update our own 64-bit sequence.
      */
     uint64_t sequence;
+
+    /*
+     * Time the frame callbacks were last sent, until content committed in
+     * response becomes ready, and the last few durations from one to the
+     * other, used to pace frame callbacks.
+     */
+    int64_t frame_callback_time_us;
+    int64_t client_frame_times_us[META_WAYLAND_CLIENT_FRAME_TIME_SAMPLES];
+    int n_client_frame_times;
+    int next_client_frame_time;
+
+    /* Time the frame callbacks are delayed to, or 0. */
+    int64_t paced_frame_callback_time_us;
   } presentation_time;
 
   /* dma-buf feedback */
   MetaCrtc *scanout_candidate;
+  MetaCrtc *overlay_candidate;
 };
 
 void                meta_wayland_shell_init     (MetaWaylandCompositor *compositor);
@@ -262,8 +278,16 @@ MetaWaylandSurface *meta_wayland_surface_create (MetaWaylandCompositor *composit
 MetaWaylandSurfaceState *
                     meta_wayland_surface_get_pending_state (MetaWaylandSurface *surface);
 
+void                meta_wayland_surface_state_merge_into (MetaWaylandSurfaceState *from,
+                                                           MetaWaylandSurfaceState *to);
+
+void                meta_wayland_surface_apply_state (MetaWaylandSurface      *surface,
+                                                      MetaWaylandSurfaceState *state);
+
 void                meta_wayland_surface_apply_cached_state (MetaWaylandSurface *surface);
 
+void                meta_wayland_surface_commit_cached_state (MetaWaylandSurface *surface);
+
 gboolean            meta_wayland_surface_is_effectively_synchronized (MetaWaylandSurface *surface);
 
 gboolean            meta_wayland_surface_assign_role (MetaWaylandSurface *surface,
@@ -358,7 +382,9 @@ void                meta_wayland_surface_notify_subsurface_state_changed (MetaWa
 
 void                meta_wayland_surface_notify_unmapped (MetaWaylandSurface *surface);
 
+META_EXPORT_TEST
 int                 meta_wayland_surface_get_width (MetaWaylandSurface *surface);
+META_EXPORT_TEST
 int                 meta_wayland_surface_get_height (MetaWaylandSurface *surface);
 
 CoglScanout *       meta_wayland_surface_try_acquire_scanout (MetaWaylandSurface *surface,
@@ -369,11 +395,21 @@ MetaCrtc * meta_wayland_surface_get_scanout_candidate (MetaWaylandSurface *surfa
 void meta_wayland_surface_set_scanout_candidate (MetaWaylandSurface *surface,
                                                  MetaCrtc           *crtc);
 
+MetaCrtc * meta_wayland_surface_get_overlay_candidate (MetaWaylandSurface *surface);
+
+void meta_wayland_surface_set_overlay_candidate (MetaWaylandSurface *surface,
+                                                 MetaCrtc           *crtc);
+
 gboolean
 meta_wayland_surface_can_scanout_untransformed (MetaWaylandSurface *surface,
                                                 MetaRendererView   *view,
                                                 int                 geometry_scale);
 
+gboolean
+meta_wayland_surface_can_scanout_unscaled (MetaWaylandSurface *surface,
+                                           int                 width,
+                                           int                 height);
+
 static inline GNode *
 meta_get_next_subsurface_sibling (GNode *n)
 {
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A MetaWaylandTransaction holds the state of a wl_surface.commit, together
+ * with the cached state of the synchronized subsurfaces it applies, until
+ * all the dma-buf buffers it attaches are done being rendered to by the
+ * client. Applying it before that would make the next frame of the
+ * compositor wait on the client's GPU work through implicit
+ * synchronization, so that one slow client could make the whole desktop
+ * drop frames.
+ *
+ * Committed transactions are queued per compositor. A ready transaction is
+ * applied as soon as no transaction committed before it touching any of
+ * the same surfaces is still waiting, which keeps the content updates of a
+ * surface in commit order.
+ */
+
+#include "config.h"
+
+#include "wayland/meta-wayland-transaction.h"
+
+#include "wayland/meta-wayland-buffer.h"
+#include "wayland/meta-wayland-dma-buf.h"
+#include "wayland/meta-wayland-private.h"
+#include "wayland/meta-wayland-surface.h"
+
+typedef struct _MetaWaylandTransactionEntry
+{
+  MetaWaylandSurface *surface;
+  MetaWaylandSurfaceState *state;
+} MetaWaylandTransactionEntry;
+
+typedef struct _MetaWaylandTransactionPosition
+{
+  MetaWaylandSurface *surface;
+  gboolean pending;
+  int x;
+  int y;
+} MetaWaylandTransactionPosition;
+
+struct _MetaWaylandTransaction
+{
+  MetaWaylandCompositor *compositor;
+
+  /* The surface that was committed, the other entries are its synchronized
+   * subsurfaces, whose states are applied through it. */
+  MetaWaylandSurface *surface;
+
+  GList *entries;
+  GList *positions;
+  GList *buffer_sources;
+};
+
+MetaWaylandTransaction *
+meta_wayland_transaction_new (MetaWaylandCompositor *compositor,
+                              MetaWaylandSurface    *surface)
+{
+  MetaWaylandTransaction *transaction;
+
+  transaction = g_new0 (MetaWaylandTransaction, 1);
+  transaction->compositor = compositor;
+  transaction->surface = surface;
+
+  return transaction;
+}
+
+static void
+meta_wayland_transaction_entry_free (MetaWaylandTransactionEntry *entry)
+{
+  g_clear_object (&entry->state);
+  g_free (entry);
+}
+
+static void
+meta_wayland_transaction_free (MetaWaylandTransaction *transaction)
+{
+  GList *l;
+
+  for (l = transaction->buffer_sources; l; l = l->next)
+    {
+      GSource *source = l->data;
+
+      g_source_destroy (source);
+      g_source_unref (source);
+    }
+  g_list_free (transaction->buffer_sources);
+
+  g_list_free_full (transaction->entries,
+                    (GDestroyNotify) meta_wayland_transaction_entry_free);
+  g_list_free_full (transaction->positions, g_free);
+  g_free (transaction);
+}
+
+/**
+ * meta_wayland_transaction_add_state:
+ * @transaction: A #MetaWaylandTransaction
+ * @surface: The surface @state belongs to
+ * @state: (transfer full): The state to apply to @surface
+ *
+ * Adds @state to @transaction. The state of the committed surface itself
+ * must be added first; states of other surfaces are applied as the cached
+ * state of @surface when its parent gets its state applied.
+ */
+void
+meta_wayland_transaction_add_state (MetaWaylandTransaction  *transaction,
+                                    MetaWaylandSurface      *surface,
+                                    MetaWaylandSurfaceState *state)
+{
+  MetaWaylandTransactionEntry *entry;
+
+  g_return_if_fail ((surface == transaction->surface) ==
+                    (transaction->entries == NULL));
+
+  entry = g_new0 (MetaWaylandTransactionEntry, 1);
+  entry->surface = surface;
+  entry->state = state;
+
+  transaction->entries = g_list_append (transaction->entries, entry);
+}
+
+/**
+ * meta_wayland_transaction_add_subsurface_position:
+ * @transaction: A #MetaWaylandTransaction
+ * @surface: A subsurface of a surface with state in @transaction
+ *
+ * Moves the pending wl_subsurface.set_position of @surface to
+ * @transaction, as it is applied together with the state of its parent.
+ */
+void
+meta_wayland_transaction_add_subsurface_position (MetaWaylandTransaction *transaction,
+                                                  MetaWaylandSurface     *surface)
+{
+  MetaWaylandTransactionPosition *position;
+
+  g_return_if_fail (surface->sub.pending_pos);
+
+  position = g_new0 (MetaWaylandTransactionPosition, 1);
+  position->surface = surface;
+  position->pending = TRUE;
+  position->x = surface->sub.pending_x;
+  position->y = surface->sub.pending_y;
+
+  surface->sub.pending_pos = FALSE;
+
+  transaction->positions = g_list_append (transaction->positions, position);
+}
+
+static void
+swap_subsurface_position (MetaWaylandTransactionPosition *position)
+{
+  MetaWaylandSurface *surface = position->surface;
+  gboolean pending = surface->sub.pending_pos;
+  int x = surface->sub.pending_x;
+  int y = surface->sub.pending_y;
+
+  surface->sub.pending_pos = position->pending;
+  surface->sub.pending_x = position->x;
+  surface->sub.pending_y = position->y;
+
+  position->pending = pending;
+  position->x = x;
+  position->y = y;
+}
+
+static gboolean
+is_ready (MetaWaylandTransaction *transaction)
+{
+  return transaction->buffer_sources == NULL;
+}
+
+static void
+meta_wayland_transaction_apply (MetaWaylandTransaction *transaction)
+{
+  MetaWaylandTransactionEntry *surface_entry = transaction->entries->data;
+  GList *l;
+
+  /* Subsurfaces get their state applied by their parent as their cached
+   * state; swap in the states of this transaction for the duration of it,
+   * as anything in the cached state was committed after it.
+   */
+  for (l = transaction->entries->next; l; l = l->next)
+    {
+      MetaWaylandTransactionEntry *entry = l->data;
+      MetaWaylandSurfaceState *cached_state = entry->surface->cached_state;
+
+      entry->surface->cached_state = entry->state;
+      entry->state = cached_state;
+    }
+
+  /* The same goes for subsurface positions set after this was committed. */
+  g_list_foreach (transaction->positions,
+                  (GFunc) swap_subsurface_position, NULL);
+
+  meta_wayland_surface_apply_state (transaction->surface,
+                                    surface_entry->state);
+
+  g_list_foreach (transaction->positions,
+                  (GFunc) swap_subsurface_position, NULL);
+
+  for (l = transaction->entries->next; l; l = l->next)
+    {
+      MetaWaylandTransactionEntry *entry = l->data;
+      MetaWaylandSurface *surface = entry->surface;
+      MetaWaylandSurfaceState *newer_state = g_steal_pointer (&entry->state);
+
+      /* The subsurface was made desynchronized while this transaction was
+       * waiting, so its parent left the state alone; apply it on its own.
+       */
+      if (!meta_wayland_surface_should_cache_state (surface))
+        meta_wayland_surface_apply_cached_state (surface);
+
+      if (newer_state)
+        {
+          meta_wayland_surface_state_merge_into (newer_state,
+                                                 surface->cached_state);
+          g_object_unref (newer_state);
+        }
+    }
+}
+
+static gboolean
+has_surface (MetaWaylandTransaction *transaction,
+             MetaWaylandSurface     *surface)
+{
+  GList *l;
+
+  for (l = transaction->entries; l; l = l->next)
+    {
+      MetaWaylandTransactionEntry *entry = l->data;
+
+      if (entry->surface == surface)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+is_blocked (MetaWaylandTransaction *transaction,
+            GHashTable             *blocked_surfaces)
+{
+  GList *l;
+
+  for (l = transaction->entries; l; l = l->next)
+    {
+      MetaWaylandTransactionEntry *entry = l->data;
+
+      if (g_hash_table_contains (blocked_surfaces, entry->surface))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+block_surfaces (MetaWaylandTransaction *transaction,
+                GHashTable             *blocked_surfaces)
+{
+  GList *l;
+
+  for (l = transaction->entries; l; l = l->next)
+    {
+      MetaWaylandTransactionEntry *entry = l->data;
+
+      g_hash_table_add (blocked_surfaces, entry->surface);
+    }
+}
+
+static void
+process_committed_transactions (MetaWaylandCompositor *compositor)
+{
+  GQueue *committed_queue = &compositor->transactions.committed_queue;
+  g_autoptr (GHashTable) blocked_surfaces = NULL;
+  GList *l;
+
+  if (compositor->transactions.inhibit_count > 0)
+    return;
+
+  l = committed_queue->head;
+  while (l)
+    {
+      MetaWaylandTransaction *transaction = l->data;
+      GList *next = l->next;
+
+      if (is_ready (transaction) &&
+          (!blocked_surfaces || !is_blocked (transaction, blocked_surfaces)))
+        {
+          g_queue_delete_link (committed_queue, l);
+          meta_wayland_transaction_apply (transaction);
+          meta_wayland_transaction_free (transaction);
+        }
+      else
+        {
+          if (!blocked_surfaces)
+            blocked_surfaces = g_hash_table_new (NULL, NULL);
+
+          block_surfaces (transaction, blocked_surfaces);
+        }
+
+      l = next;
+    }
+}
+
+static void
+buffer_ready (MetaWaylandBuffer *buffer,
+              gpointer           user_data)
+{
+  MetaWaylandTransaction *transaction = user_data;
+  GSource *source = g_main_current_source ();
+  GList *l;
+
+  l = g_list_find (transaction->buffer_sources, source);
+  g_return_if_fail (l);
+
+  transaction->buffer_sources =
+    g_list_delete_link (transaction->buffer_sources, l);
+  g_source_unref (source);
+
+  if (is_ready (transaction))
+    process_committed_transactions (transaction->compositor);
+}
+
+static void
+add_buffer_source (MetaWaylandTransaction  *transaction,
+                   MetaWaylandSurfaceState *state)
+{
+  GSource *source;
+
+  if (!state->newly_attached || !state->buffer)
+    return;
+
+  source = meta_wayland_dma_buf_create_source (state->buffer,
+                                               buffer_ready,
+                                               transaction);
+  if (!source)
+    return;
+
+  g_source_attach (source, NULL);
+  transaction->buffer_sources = g_list_prepend (transaction->buffer_sources,
+                                                source);
+}
+
+void
+meta_wayland_transaction_commit (MetaWaylandTransaction *transaction)
+{
+  MetaWaylandCompositor *compositor = transaction->compositor;
+
+  g_return_if_fail (transaction->entries);
+
+  if (compositor->transactions.wait_for_buffers)
+    {
+      GList *l;
+
+      for (l = transaction->entries; l; l = l->next)
+        {
+          MetaWaylandTransactionEntry *entry = l->data;
+
+          add_buffer_source (transaction, entry->state);
+        }
+    }
+
+  g_queue_push_tail (&compositor->transactions.committed_queue, transaction);
+  process_committed_transactions (compositor);
+}
+
+/**
+ * meta_wayland_transaction_drop_surface:
+ * @compositor: A #MetaWaylandCompositor
+ * @surface: A surface being destroyed
+ *
+ * Removes any state of @surface from committed transactions. Transactions
+ * committed by @surface are discarded altogether, the same way the cached
+ * state of its subsurfaces would never have been applied.
+ */
+void
+meta_wayland_transaction_drop_surface (MetaWaylandCompositor *compositor,
+                                       MetaWaylandSurface    *surface)
+{
+  GQueue *committed_queue = &compositor->transactions.committed_queue;
+  gboolean dropped_any = FALSE;
+  GList *l;
+
+  l = committed_queue->head;
+  while (l)
+    {
+      MetaWaylandTransaction *transaction = l->data;
+      GList *l_cur = l;
+      GList *e;
+
+      l = l->next;
+
+      if (transaction->surface == surface)
+        {
+          g_queue_delete_link (committed_queue, l_cur);
+          meta_wayland_transaction_free (transaction);
+          dropped_any = TRUE;
+          continue;
+        }
+
+      for (e = transaction->positions; e; e = e->next)
+        {
+          MetaWaylandTransactionPosition *position = e->data;
+
+          if (position->surface != surface)
+            continue;
+
+          transaction->positions =
+            g_list_delete_link (transaction->positions, e);
+          g_free (position);
+          break;
+        }
+
+      if (!has_surface (transaction, surface))
+        continue;
+
+      for (e = transaction->entries->next; e; e = e->next)
+        {
+          MetaWaylandTransactionEntry *entry = e->data;
+
+          if (entry->surface != surface)
+            continue;
+
+          transaction->entries =
+            g_list_delete_link (transaction->entries, e);
+          meta_wayland_transaction_entry_free (entry);
+          break;
+        }
+
+      dropped_any = TRUE;
+    }
+
+  if (dropped_any)
+    process_committed_transactions (compositor);
+}
+
+/*
+ * Keeps committed transactions queued as if they were waiting for buffers,
+ * for tests to check what happens meanwhile.
+ */
+void
+meta_wayland_transaction_inhibit (MetaWaylandCompositor *compositor)
+{
+  compositor->transactions.inhibit_count++;
+}
+
+void
+meta_wayland_transaction_uninhibit (MetaWaylandCompositor *compositor)
+{
+  g_return_if_fail (compositor->transactions.inhibit_count > 0);
+
+  compositor->transactions.inhibit_count--;
+  process_committed_transactions (compositor);
+}
+
+void
+meta_wayland_transaction_init (MetaWaylandCompositor *compositor)
+{
+  g_queue_init (&compositor->transactions.committed_queue);
+
+  compositor->transactions.wait_for_buffers =
+    !g_getenv ("MUTTER_DEBUG_DISABLE_BUFFER_READINESS");
+}
+
+void
+meta_wayland_transaction_finalize (MetaWaylandCompositor *compositor)
+{
+  g_queue_clear_full (&compositor->transactions.committed_queue,
+                      (GDestroyNotify) meta_wayland_transaction_free);
+}
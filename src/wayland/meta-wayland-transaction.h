@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2022 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef META_WAYLAND_TRANSACTION_H
+#define META_WAYLAND_TRANSACTION_H
+
+#include <glib.h>
+
+#include "core/util-private.h"
+#include "wayland/meta-wayland-types.h"
+
+typedef struct _MetaWaylandTransaction MetaWaylandTransaction;
+
+MetaWaylandTransaction * meta_wayland_transaction_new (MetaWaylandCompositor *compositor,
+                                                       MetaWaylandSurface    *surface);
+
+void meta_wayland_transaction_add_state (MetaWaylandTransaction  *transaction,
+                                         MetaWaylandSurface      *surface,
+                                         MetaWaylandSurfaceState *state);
+
+void meta_wayland_transaction_add_subsurface_position (MetaWaylandTransaction *transaction,
+                                                       MetaWaylandSurface     *surface);
+
+void meta_wayland_transaction_commit (MetaWaylandTransaction *transaction);
+
+void meta_wayland_transaction_drop_surface (MetaWaylandCompositor *compositor,
+                                            MetaWaylandSurface    *surface);
+
+META_EXPORT_TEST
+void meta_wayland_transaction_inhibit (MetaWaylandCompositor *compositor);
+
+META_EXPORT_TEST
+void meta_wayland_transaction_uninhibit (MetaWaylandCompositor *compositor);
+
+void meta_wayland_transaction_init (MetaWaylandCompositor *compositor);
+
+void meta_wayland_transaction_finalize (MetaWaylandCompositor *compositor);
+
+#endif /* META_WAYLAND_TRANSACTION_H */
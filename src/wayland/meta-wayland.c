@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <wayland-server.h>
 
+#include "backends/meta-settings-private.h"
 #include "clutter/clutter.h"
 #include "cogl/cogl-egl.h"
 #include "compositor/meta-surface-actor-wayland.h"
@@ -46,6 +47,7 @@
 #include "wayland/meta-wayland-seat.h"
 #include "wayland/meta-wayland-subsurface.h"
 #include "wayland/meta-wayland-tablet-manager.h"
+#include "wayland/meta-wayland-transaction.h"
 #include "wayland/meta-wayland-xdg-foreign.h"
 #include "wayland/meta-xwayland-grab-keyboard.h"
 #include "wayland/meta-xwayland-private.h"
@@ -207,6 +209,152 @@ meta_wayland_compositor_update (MetaWaylandCompositor *compositor,
     meta_wayland_seat_update (compositor->seat, event);
 }
 
+/* Time, besides the measured drawing time, given to clients to commit and
+ * for the commit to be processed before the frame clock dispatches.
+ */
+#define FRAME_CALLBACK_PACING_MARGIN_US 1000
+
+static void
+emit_frame_callbacks (MetaWaylandSurface *surface,
+                      int64_t             now_us)
+{
+  MetaWaylandActorSurface *actor_surface =
+    META_WAYLAND_ACTOR_SURFACE (surface->role);
+
+  meta_wayland_actor_surface_emit_frame_callbacks (actor_surface,
+                                                   now_us / 1000);
+  meta_wayland_presentation_time_frame_callbacks_sent (surface, now_us);
+}
+
+static gboolean
+is_frame_callback_pacing_enabled (MetaWaylandCompositor *compositor)
+{
+  MetaBackend *backend = meta_context_get_backend (compositor->context);
+
+  return meta_settings_is_experimental_feature_enabled (
+    meta_backend_get_settings (backend),
+    META_EXPERIMENTAL_FEATURE_FRAME_CALLBACK_PACING);
+}
+
+/*
+ * Clients start drawing when getting their frame callbacks. Sending them
+ * right after the compositor updated means a client that draws quickly is
+ * done long before the next frame is dispatched, and its content is then
+ * almost a frame old when presented. Instead, send them late enough that
+ * the client, given its recent drawing times, is just done in time.
+ */
+static int64_t
+calculate_paced_frame_callback_time_us (MetaWaylandSurface *surface,
+                                        ClutterStageView   *stage_view)
+{
+  ClutterFrameClock *frame_clock;
+  int64_t client_frame_time_us;
+  int64_t next_update_time_us;
+
+  client_frame_time_us =
+    meta_wayland_presentation_time_get_client_frame_time_us (surface);
+  if (client_frame_time_us < 0)
+    return -1;
+
+  frame_clock = clutter_stage_view_get_frame_clock (stage_view);
+  next_update_time_us =
+    clutter_frame_clock_get_next_update_time_us (frame_clock);
+  if (next_update_time_us < 0)
+    return -1;
+
+  return (next_update_time_us -
+          client_frame_time_us -
+          FRAME_CALLBACK_PACING_MARGIN_US);
+}
+
+static void
+update_frame_callback_pacing_source (MetaWaylandCompositor *compositor)
+{
+  int64_t ready_time_us = -1;
+  GList *l;
+
+  for (l = compositor->frame_callback_pacing.surfaces; l; l = l->next)
+    {
+      MetaWaylandSurface *surface = l->data;
+      int64_t paced_time_us =
+        surface->presentation_time.paced_frame_callback_time_us;
+
+      if (ready_time_us < 0 || paced_time_us < ready_time_us)
+        ready_time_us = paced_time_us;
+    }
+
+  g_source_set_ready_time (compositor->frame_callback_pacing.source,
+                           ready_time_us);
+}
+
+static gboolean
+emit_paced_frame_callbacks (gpointer user_data)
+{
+  MetaWaylandCompositor *compositor = user_data;
+  GList *l;
+  int64_t now_us;
+
+  now_us = g_get_monotonic_time ();
+
+  l = compositor->frame_callback_pacing.surfaces;
+  while (l)
+    {
+      GList *l_cur = l;
+      MetaWaylandSurface *surface = l->data;
+
+      l = l->next;
+
+      if (surface->presentation_time.paced_frame_callback_time_us > now_us)
+        continue;
+
+      surface->presentation_time.paced_frame_callback_time_us = 0;
+      compositor->frame_callback_pacing.surfaces =
+        g_list_delete_link (compositor->frame_callback_pacing.surfaces,
+                            l_cur);
+
+      emit_frame_callbacks (surface, now_us);
+    }
+
+  update_frame_callback_pacing_source (compositor);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+frame_callback_pacing_source_dispatch (GSource     *source,
+                                       GSourceFunc  callback,
+                                       gpointer     user_data)
+{
+  g_source_set_ready_time (source, -1);
+
+  return callback (user_data);
+}
+
+static GSourceFuncs frame_callback_pacing_source_funcs =
+{
+  NULL,
+  NULL,
+  frame_callback_pacing_source_dispatch,
+  NULL
+};
+
+static void
+init_frame_callback_pacing (MetaWaylandCompositor *compositor)
+{
+  GSource *source;
+
+  source = g_source_new (&frame_callback_pacing_source_funcs,
+                         sizeof (GSource));
+  g_source_set_name (source, "[mutter] Paced frame callbacks");
+  g_source_set_priority (source, G_PRIORITY_HIGH);
+  g_source_set_callback (source, emit_paced_frame_callbacks,
+                         compositor, NULL);
+  g_source_set_ready_time (source, -1);
+  g_source_attach (source, NULL);
+
+  compositor->frame_callback_pacing.source = source;
+}
+
 static void
 on_after_update (ClutterStage          *stage,
                  ClutterStageView      *stage_view,
@@ -214,8 +362,11 @@ on_after_update (ClutterStage          *stage,
 {
   GList *l;
   int64_t now_us;
+  gboolean pacing_enabled;
+  gboolean paced_any = FALSE;
 
   now_us = g_get_monotonic_time ();
+  pacing_enabled = is_frame_callback_pacing_enabled (compositor);
 
   l = compositor->frame_callback_surfaces;
   while (l)
@@ -223,8 +374,8 @@ on_after_update (ClutterStage          *stage,
       GList *l_cur = l;
       MetaWaylandSurface *surface = l->data;
       MetaSurfaceActor *actor;
-      MetaWaylandActorSurface *actor_surface;
       ClutterStageView *surface_primary_view;
+      int64_t paced_time_us;
 
       l = l->next;
 
@@ -237,13 +388,34 @@ on_after_update (ClutterStage          *stage,
       if (stage_view != surface_primary_view)
         continue;
 
-      actor_surface = META_WAYLAND_ACTOR_SURFACE (surface->role);
-      meta_wayland_actor_surface_emit_frame_callbacks (actor_surface,
-                                                       now_us / 1000);
-
       compositor->frame_callback_surfaces =
         g_list_delete_link (compositor->frame_callback_surfaces, l_cur);
+
+      /* Frame callbacks added while waiting are sent along with the ones
+       * that were already paced.
+       */
+      if (surface->presentation_time.paced_frame_callback_time_us)
+        continue;
+
+      paced_time_us = pacing_enabled ?
+        calculate_paced_frame_callback_time_us (surface, stage_view) : -1;
+
+      if (paced_time_us > now_us)
+        {
+          surface->presentation_time.paced_frame_callback_time_us =
+            paced_time_us;
+          compositor->frame_callback_pacing.surfaces =
+            g_list_prepend (compositor->frame_callback_pacing.surfaces,
+                            surface);
+          paced_any = TRUE;
+          continue;
+        }
+
+      emit_frame_callbacks (surface, now_us);
     }
+
+  if (paced_any)
+    update_frame_callback_pacing_source (compositor);
 }
 
 static MetaWaylandOutput *
@@ -350,6 +522,14 @@ meta_wayland_compositor_remove_frame_callback_surface (MetaWaylandCompositor *co
 {
   compositor->frame_callback_surfaces =
     g_list_remove (compositor->frame_callback_surfaces, surface);
+
+  if (surface->presentation_time.paced_frame_callback_time_us)
+    {
+      surface->presentation_time.paced_frame_callback_time_us = 0;
+      compositor->frame_callback_pacing.surfaces =
+        g_list_remove (compositor->frame_callback_pacing.surfaces, surface);
+      update_frame_callback_pacing_source (compositor);
+    }
 }
 
 void
@@ -447,6 +627,17 @@ meta_wayland_compositor_finalize (GObject *object)
   MetaWaylandCompositor *compositor = META_WAYLAND_COMPOSITOR (object);
 
   g_clear_object (&compositor->dma_buf_manager);
+  g_clear_pointer (&compositor->shm_uploader, meta_wayland_shm_uploader_free);
+  g_clear_pointer (&compositor->shm_udmabuf, meta_wayland_shm_udmabuf_free);
+  meta_wayland_transaction_finalize (compositor);
+
+  g_clear_pointer (&compositor->frame_callback_pacing.surfaces, g_list_free);
+  if (compositor->frame_callback_pacing.source)
+    {
+      g_source_destroy (compositor->frame_callback_pacing.source);
+      g_clear_pointer (&compositor->frame_callback_pacing.source,
+                       g_source_unref);
+    }
 
   g_clear_pointer (&compositor->seat, meta_wayland_seat_free);
 
@@ -462,6 +653,8 @@ meta_wayland_compositor_init (MetaWaylandCompositor *compositor)
 {
   compositor->scheduled_surface_associations = g_hash_table_new (NULL, NULL);
 
+  meta_wayland_transaction_init (compositor);
+
   wl_log_set_handler_server (meta_wayland_log_func);
 
   compositor->wayland_display = wl_display_create ();
@@ -589,6 +782,8 @@ meta_wayland_compositor_new (MetaContext *context)
   compositor->source = wayland_event_source;
   g_source_unref (wayland_event_source);
 
+  init_frame_callback_pacing (compositor);
+
   g_signal_connect (stage, "after-update",
                     G_CALLBACK (on_after_update), compositor);
   g_signal_connect (stage, "presented",